@@ -67,6 +67,21 @@ namespace Foundation
          */
         virtual bool RequestAsset(const std::string& asset_id, const std::string& asset_type, request_tag_t tag) = 0;
 
+        //! Sets how soon an asset requested for download is needed
+        /*! Providers that queue their transfers start the ones with the highest priority first. Does nothing by default.
+            \param asset_id Asset ID
+            \param priority Priority, 0 by default. Typically the approximate fraction of the screen the asset covers, from 0 to 1
+         */
+        virtual void SetAssetPriority(const std::string& asset_id, f32 priority) {}
+
+        //! Withdraws one request of an asset
+        /*! When no requests remain, the transfer should be dropped if possible. No events are sent for the withdrawn tag.
+            \param asset_id Asset ID
+            \param tag Request tag given to RequestAsset()
+            \return true if the request was found and withdrawn. Does nothing and returns false by default
+         */
+        virtual bool CancelAssetRequest(const std::string& asset_id, request_tag_t tag) { return false; }
+
         //! Returns whether a certain asset is already being downloaded
         /*! \param asset_id Asset ID
          */           
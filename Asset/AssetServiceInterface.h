@@ -78,6 +78,19 @@ namespace Foundation
          */
         virtual bool IsValidId(const std::string& asset_id, const std::string& asset_type) = 0;
 
+        //! Sets how soon a requested asset is needed, so that the downloads most relevant to the view go first
+        /*! Can be called again as the view changes. Downloads whose priority is never set have priority 0.
+            \param asset_id Asset ID
+            \param priority Approximate fraction of the screen the asset covers, from 0 to 1
+         */
+        virtual void SetAssetPriority(const std::string& asset_id, f32 priority) = 0;
+
+        //! Withdraws an asset request. The download is dropped if no other requests are waiting for it
+        /*! \param asset_id Asset ID
+            \param tag Request tag returned by RequestAsset()
+         */
+        virtual void CancelAssetRequest(const std::string& asset_id, request_tag_t tag) = 0;
+
         //! Queries status of asset download
         /*! If asset has been already fully received, size, received & received_continuous will be the same
         
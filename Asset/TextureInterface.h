@@ -36,7 +36,8 @@ namespace Foundation
         virtual int GetLevel() const = 0;
 
         //! returns data
-        /*! each pixel of each component should be encoded as a u8, so data size should be width * height * components
+        /*! each pixel of each component should be encoded as a u8, so data size should be width * height * components.
+            Compressed formats instead hold the full size image followed by each mipmap level, see GetNumMipmaps()
          */
         virtual u8* GetData() = 0;
 
@@ -45,6 +46,9 @@ namespace Foundation
 
         //! Get ogre image pixel format
         virtual int GetFormat() = 0;
+
+        //! Get number of mipmap levels in the data after the full size image
+        virtual uint GetNumMipmaps() { return 0; }
     };
 }
 
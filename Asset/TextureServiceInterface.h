@@ -30,13 +30,23 @@ namespace Foundation
         //! Requests a texture to be received and decoded
         /*! When texture data becomes available, an event will be sent for each quality level decoded
             \param asset_id texture ID, UUID for legacy UDP assets
+            \param allow_compressed Whether the texture may be returned DXT compressed with mipmaps from the texture cache,
+                   for uploading as is. If false, it is always returned as uncompressed pixels
             \return request tag, will be sent back along with RESOURCE_READY event
          */
-        virtual request_tag_t RequestTexture(const std::string& asset_id) = 0;
+        virtual request_tag_t RequestTexture(const std::string& asset_id, bool allow_compressed = false) = 0;
+
+        //! Sets how relevant a requested texture is on screen, so that the most relevant textures are decoded first
+        /*! The coarse quality levels of all textures are decoded before the finer levels of any, and among the
+            same quality level, the more relevant textures go first. Textures whose priority is never set have priority 0.
+            \param asset_id texture ID
+            \param priority Approximate fraction of the screen the texture covers, from 0 to 1
+         */
+        virtual void SetTexturePriority(const std::string& asset_id, f32 priority) = 0;
 
         //! Gets a texture rousource from cache
         //! @param texture_id as std::string
-        //! @return valid ptr if found, 0 ptr if not
+        //! @return valid ptr if found, 0 ptr if not. Always uncompressed
         virtual TextureDecoder::TextureResource *GetFromCache(const std::string &texture_id) = 0;
 
         //! Removes a texture from the disk cache with the texture id
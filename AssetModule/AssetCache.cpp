@@ -2,6 +2,7 @@
 
 #include "StableHeaders.h"
 #include "AssetCache.h"
+#include "DiskAssetCache.h"
 #include "RexAsset.h"
 #include "AssetModule.h"
 #include "AssetEvents.h"
@@ -15,25 +16,38 @@
 #include <QString>
 #include <QSettings>
 #include <QMessageBox>
+#include <QDir>
+#include <QFile>
 
 namespace Asset
 {
     const char *DEFAULT_ASSET_CACHE_PATH = "/assetcache";
+    const char *DISK_CACHE_PACK_PATH = "/pack";
+    const char *DISK_CACHE_EXPORT_PATH = "/files";
     const int DEFAULT_MEMORY_CACHE_SIZE = 32 * 1024 * 1024;
     const f64 CACHE_CHECK_INTERVAL = 1.0;
     const int CACHE_MAX_DELETES = 10;
+    //! Number of disk cache index slots to sweep per check when over the size limit
+    const uint DISK_CACHE_MAX_SWEEP = 4096;
+    //! Space to free in addition when over the disk cache size limit
+    const u64 DISK_CACHE_EXTRA_SPACE = 2 * 1024 * 1024;
+    //! Number of bytes of assets to move per check when compacting the disk cache
+    const u64 DISK_CACHE_MAX_COMPACT_BYTES = 1024 * 1024;
+    //! Number of disk cache index slots to sweep per check when compacting
+    const uint DISK_CACHE_MAX_COMPACT_SWEEP = 16384;
 
     AssetCache::AssetCache(Foundation::Framework* framework) :
         framework_(framework),
         memory_cache_size_(DEFAULT_MEMORY_CACHE_SIZE),
         update_time_(0.0),
-        disk_changes_after_last_check_(false),
         disk_cache_max_size_(0)
     {
         // Create asset cache directory
         cache_path_ = framework_->GetPlatform()->GetApplicationDataDirectory() + DEFAULT_ASSET_CACHE_PATH;
         if (boost::filesystem::exists(cache_path_) == false)
             boost::filesystem::create_directory(cache_path_);
+        if (boost::filesystem::exists(cache_path_ + DISK_CACHE_EXPORT_PATH) == false)
+            boost::filesystem::create_directory(cache_path_ + DISK_CACHE_EXPORT_PATH);
 
         // Set size of memory cache
         memory_cache_size_ = framework_->GetDefaultConfig().DeclareSetting("AssetSystem", "memory_cache_size", DEFAULT_MEMORY_CACHE_SIZE);
@@ -44,8 +58,13 @@ namespace Asset
         // Init disk
         InitDiskCaching();
 
-        // Read both disk caches 
-        CheckDiskCache(cache_path_);
+        // Open the disk cache. If it is new, the files of the earlier cache format are of no use anymore
+        disk_cache_.reset(new DiskAssetCache(cache_path_ + DISK_CACHE_PACK_PATH));
+        if (disk_cache_->IsNew())
+            RemoveLegacyCacheFiles();
+        RemoveExportedFiles();
+
+        // Read the local cache
         CheckDiskCache(local_cache_path);
     }
 
@@ -67,9 +86,6 @@ namespace Asset
             }
         }
 
-        // Init Qt asset cache working dir
-        cache_dir_ = QDir(cache_path_.c_str());
-
         // Read initial values from config
         QSettings cache_settings(QSettings::IniFormat, QSettings::UserScope, APPLICATION_NAME, "configuration/CacheSettings");
         disk_cache_max_size_ = cache_settings.value("AssetCache/MaxSize", QVariant(0)).toInt();
@@ -77,35 +93,22 @@ namespace Asset
 
     void AssetCache::ClearDiskCache()
     {
-        QFileInfoList file_list = cache_dir_.entryInfoList(QDir::Files);
-        if (file_list.count() > 0)
-        {
-            int removed_files = 0;
-            qint64 removed_bytes = 0;
-            
-            foreach(QFileInfo file_info, file_list)
-            {
-                QString native_absolute_path = file_info.absoluteFilePath().replace("/", QDir::separator());
-                qint64 file_size = file_info.size();
-                if (!cache_dir_.remove(file_info.fileName()))
-                    continue;
-                
-                removed_files++;
-                removed_bytes += file_size;
-
-                std::set<std::string>::iterator find_result = disk_cache_contents_.find(native_absolute_path.toStdString());
-                if (find_result != disk_cache_contents_.end())
-                    disk_cache_contents_.erase(find_result);
-            }
+        uint removed_assets = 0;
+        u64 removed_bytes = 0;
+        if (disk_cache_)
+            disk_cache_->Clear(removed_assets, removed_bytes);
+        RemoveExportedFiles();
 
+        if (removed_assets > 0)
+        {
             // Notify user
             qreal removed_bytes_f = removed_bytes;
             QString mb_string = QString::number(((removed_bytes_f/1024)/1024));
             mb_string = mb_string.left(mb_string.indexOf(".")+3);
-            QMessageBox::information(0, "Asset Cache", QString("Asset cache cleared, removed %1 files total of " + mb_string + " mb").arg(removed_files));
+            QMessageBox::information(0, "Asset Cache", QString("Asset cache cleared, removed %1 assets total of " + mb_string + " mb").arg(removed_assets));
         }
         else
-            QMessageBox::information(0, "Asset Cache", "There are currently no files in asset cache");
+            QMessageBox::information(0, "Asset Cache", "There are currently no assets in asset cache");
     }
 
     void AssetCache::CacheConfigChanged(int new_disk_max_size)
@@ -119,44 +122,24 @@ namespace Asset
 
     void AssetCache::CheckDiskCacheSize(bool make_extra_space)
     {
-        if (disk_cache_max_size_ == 0)
+        if ((disk_cache_max_size_ <= 0) || (!disk_cache_))
             return;
 
-        int current_size = 0;
-        QFileInfoList file_list = cache_dir_.entryInfoList(QDir::Files, QDir::Time | QDir::Reversed);
-        foreach(QFileInfo file, file_list)
-            current_size += file.size();
-
-        if (current_size > disk_cache_max_size_)
-        {
-            int removed_files = 0;
-            qint64 removed_bytes = 0;
-
-            int aimed_size = disk_cache_max_size_;
-            if (make_extra_space)
-                aimed_size -= (2*1024*1024);
-
-            foreach(QFileInfo file_info, file_list)
-            {
-                QString native_absolute_path = file_info.absoluteFilePath().replace("/", QDir::separator());
-                qint64 file_size = file_info.size();
-                if (!cache_dir_.remove(file_info.fileName()))
-                    continue;
-                
-                removed_files++;
-                removed_bytes += file_size;
-                current_size -= file_size;
+        u64 max_size = disk_cache_max_size_;
+        if (disk_cache_->GetSize() <= max_size)
+            return;
 
-                std::set<std::string>::iterator find_result = disk_cache_contents_.find(native_absolute_path.toStdString());
-                if (find_result != disk_cache_contents_.end())
-                    disk_cache_contents_.erase(find_result);
+        u64 aimed_size = max_size;
+        if ((make_extra_space) && (aimed_size > DISK_CACHE_EXTRA_SPACE))
+            aimed_size -= DISK_CACHE_EXTRA_SPACE;
 
-                if (current_size < aimed_size)
-                    break;
-            }
-
-            AssetModule::LogInfo("Asset cache was over limit. Removed " + QString::number(removed_files).toStdString() + 
-                " files, total of " + QString::number(removed_bytes).toStdString() + " bytes");
+        // Evict a part at a time, the next check continues if still over the limit
+        u64 size_before = disk_cache_->GetSize();
+        uint evicted = disk_cache_->Evict(aimed_size, DISK_CACHE_MAX_SWEEP);
+        if (evicted)
+        {
+            AssetModule::LogDebug("Asset cache was over limit. Evicted " + ToString<uint>(evicted) + 
+                " assets, total of " + ToString<u64>(size_before - disk_cache_->GetSize()) + " bytes");
         }
     }
 
@@ -169,7 +152,12 @@ namespace Asset
             while (i != end_iter)
             {
                 if (boost::filesystem::is_regular_file(i->status()))
-                    disk_cache_contents_.insert(i->path().native_directory_string());
+                {
+                    // Files are named by the hash of the asset id, with the asset type as extension
+                    std::string filename = i->path().leaf();
+                    std::string hash = filename.substr(0, filename.find('.'));
+                    local_cache_contents_[hash].push_back(i->path().native_directory_string());
+                }
                 ++i;
             }
         }
@@ -178,6 +166,70 @@ namespace Asset
         }
     }
 
+    Foundation::AssetPtr AssetCache::GetLocalCacheAsset(const std::string& asset_id, const std::string& asset_type)
+    {
+        std::map<std::string, StringVector>::iterator i = local_cache_contents_.find(GetHash(asset_id));
+        if (i == local_cache_contents_.end())
+            return Foundation::AssetPtr();
+
+        StringVector& paths = i->second;
+        for (uint j = 0; j < paths.size(); ++j)
+        {
+            // Identify assettype from end of cached asset name
+            StringVector assetNameType = SplitString(paths[j], '.');
+            if (assetNameType.size() < 2)
+                continue;
+            const std::string& type = assetNameType[assetNameType.size() - 1];
+            if ((!asset_type.empty()) && (type != asset_type))
+                continue;
+
+            std::ifstream filestr(paths[j].c_str(), std::ios::in | std::ios::binary);
+            if (!filestr.good())
+            {
+                // File got deleted by someone else while program was running, or something, do not re-check
+                paths.erase(paths.begin() + j);
+                return Foundation::AssetPtr();
+            }
+
+            filestr.seekg(0, std::ios::end);
+            uint length = filestr.tellg();
+            filestr.seekg(0, std::ios::beg);
+
+            RexAsset* new_asset = new RexAsset(asset_id, type);
+            Foundation::AssetPtr asset(new_asset);
+            RexAsset::AssetDataVector& data = new_asset->GetDataInternal();
+            data.resize(length);
+            if (length)
+                filestr.read((char *)&data[0], length);
+            filestr.close();
+            return asset;
+        }
+
+        return Foundation::AssetPtr();
+    }
+
+    void AssetCache::RemoveLegacyCacheFiles()
+    {
+        QDir cache_dir(cache_path_.c_str());
+        QStringList file_list = cache_dir.entryList(QDir::Files);
+        int removed_files = 0;
+        foreach(QString filename, file_list)
+        {
+            if (cache_dir.remove(filename))
+                removed_files++;
+        }
+        if (removed_files)
+            AssetModule::LogInfo("Removed " + ToString<int>(removed_files) + " files of the earlier asset cache format");
+    }
+
+    void AssetCache::RemoveExportedFiles()
+    {
+        QDir export_dir((cache_path_ + DISK_CACHE_EXPORT_PATH).c_str());
+        QStringList file_list = export_dir.entryList(QDir::Files);
+        foreach(QString filename, file_list)
+            export_dir.remove(filename);
+    }
+
     bool CompareAssetAge(RexAsset* lhs, RexAsset* rhs)
     {
         // Favor oldest assets for deletion
@@ -230,11 +282,10 @@ namespace Asset
             ++deletes;
         }
 
-        if (disk_changes_after_last_check_)
-        {
-            CheckDiskCacheSize();
-            disk_changes_after_last_check_ = false;
-        }
+        // Keep the disk cache within its size limit, and reclaim the space of evicted assets
+        CheckDiskCacheSize();
+        if (disk_cache_)
+            disk_cache_->Compact(DISK_CACHE_MAX_COMPACT_BYTES, DISK_CACHE_MAX_COMPACT_SWEEP);
         
         update_time_ = 0.0;
     }
@@ -243,72 +294,29 @@ namespace Asset
     {
         if (check_memory)
         {
-            AssetMap::iterator i = assets_.begin();
-            while (i != assets_.end())
+            AssetMap::iterator i = assets_.find(asset_id);
+            if ((i != assets_.end()) && (asset_type.empty() || (i->second->GetType() == asset_type)))
             {
-                Foundation::AssetPtr asset = i->second;
-                if ((asset->GetId() == asset_id) && (asset_type.empty() || (asset->GetType() == asset_type)))
-                {
-                    RexAsset* asset = dynamic_cast<RexAsset*>(i->second.get());
-                    if (asset)
-                        asset->ResetAge();
-                    return i->second;
-                }
-                ++i;
+                RexAsset* asset = dynamic_cast<RexAsset*>(i->second.get());
+                if (asset)
+                    asset->ResetAge();
+                return i->second;
             }
         }
         
-        std::string asset_hash = GetHash(asset_id);
-        
         if (check_disk)
         {
-            std::set<std::string>::iterator i = disk_cache_contents_.begin();
-            while (i != disk_cache_contents_.end())
-            {
-                if ((i->find(asset_hash) != std::string::npos) && (asset_type.empty() || i->find(asset_type) != std::string::npos))
-                    break;
-                ++i;
-            }
-            
-            if (i != disk_cache_contents_.end())
+            Foundation::AssetPtr asset;
+            if (disk_cache_)
+                asset = disk_cache_->GetAsset(asset_id, asset_type);
+            if (!asset)
+                asset = GetLocalCacheAsset(asset_id, asset_type);
+            if (asset)
             {
-                boost::filesystem::path file_path(*i);
-                std::ifstream filestr(file_path.native_directory_string().c_str(), std::ios::in | std::ios::binary);
-                if (filestr.good())
-                {
-                    filestr.seekg(0, std::ios::end);
-                    uint length = filestr.tellg();
-                    filestr.seekg(0, std::ios::beg);
-                    
-                    // Identify assettype from end of cached asset name
-                    StringVector assetNameType = SplitString(*i, '.');
-                    if (assetNameType.size() < 2)
-                    {
-                        AssetModule::LogDebug("Malformed assetcache filename " + *i);
-                        filestr.close();
-                        disk_cache_contents_.erase(i);
-                        return Foundation::AssetPtr();
-                    }
-                    
-                    std::string type = assetNameType[assetNameType.size() - 1];
-
-                    RexAsset* new_asset = new RexAsset(asset_id, type);
-                    assets_[asset_id] = Foundation::AssetPtr(new_asset);
-                
-                    RexAsset::AssetDataVector& data = new_asset->GetDataInternal();
-                    data.resize(length);
-                    filestr.read((char *)&data[0], length);
-                    filestr.close();
-                    return assets_[asset_id];
-                }
-                else
-                {
-                    // File got deleted by someone else while program was running, or something, do not re-check
-                    disk_cache_contents_.erase(i);
-                }
+                assets_[asset_id] = asset;
+                return asset;
             }
         }
-        
             
         return Foundation::AssetPtr();
     }
@@ -325,23 +333,8 @@ namespace Asset
             return;
         
         // Store to disk cache
-        const std::string& type = asset->GetType();
-        boost::filesystem::path file_path(cache_path_ + "/" + GetHash(asset_id) + "." + type);
-        std::ofstream filestr(file_path.native_directory_string().c_str(), std::ios::out | std::ios::binary);
-        if (filestr.good())
-        {
-            const u8* data = asset->GetData();
-            uint size = asset->GetSize();
-            
-            filestr.write((const char *)&data[0], size);
-            filestr.close();
-
-            disk_cache_contents_.insert(file_path.native_directory_string());
-        }
-        else
-        {
+        if ((!disk_cache_) || (!disk_cache_->StoreAsset(asset_id, asset->GetType(), asset->GetData(), asset->GetSize())))
             AssetModule::LogError("Error storing asset " + asset_id + " to cache.");
-        }
     }
 
     bool AssetCache::DeleteAsset(Foundation::AssetPtr asset)
@@ -350,38 +343,43 @@ namespace Asset
 
         // Delete from disk cache
         const std::string& type = asset->GetType();
-        boost::filesystem::path file_path(cache_path_ + "/" + GetHash(asset_id)  + "." + type);
-        if (boost::filesystem::exists(file_path))
+        QFile::remove(QString::fromStdString(cache_path_ + DISK_CACHE_EXPORT_PATH + "/" + GetHash(asset_id) + "." + type));
+        if ((disk_cache_) && (disk_cache_->RemoveAsset(asset_id, type)))
         {
-            if (boost::filesystem::remove(file_path))
-            {
-                AssetModule::LogDebug("Removed asset " + asset_id + " from cache");
-
-                std::set<std::string>::iterator find_result = disk_cache_contents_.find(file_path.native_directory_string());
-                if (find_result != disk_cache_contents_.end())
-                    disk_cache_contents_.erase(find_result);
-
-                assets_.erase(asset_id);
-                disk_changes_after_last_check_ = true;
-
-                return true;
-            }
-            else
-            {
-                AssetModule::LogDebug("Could not removed asset " + asset_id + " from cache");
-                return false;
-            }
+            AssetModule::LogDebug("Removed asset " + asset_id + " from cache");
+            assets_.erase(asset_id);
+            return true;
         }
         else
         {
-            AssetModule::LogDebug("File " + file_path.string() + " does not exist, could not delete from cache.");
+            AssetModule::LogDebug("Asset " + asset_id + " is not in disk cache, could not delete from cache.");
             return true;
         }
     }
 
     std::string AssetCache::GetAbsoluteFilePath(const std::string& asset_id, const std::string& asset_type)
     {
-        return cache_path_ + "/" + GetHash(asset_id)  + "." + asset_type;
+        std::string path = cache_path_ + DISK_CACHE_EXPORT_PATH + "/" + GetHash(asset_id)  + "." + asset_type;
+        if (boost::filesystem::exists(path))
+            return path;
+
+        // Write the asset to a file of its own
+        Foundation::AssetPtr asset = GetAsset(asset_id, true, true, asset_type);
+        if (!asset)
+            return std::string();
+
+        std::ofstream filestr(path.c_str(), std::ios::out | std::ios::binary);
+        if (filestr.good())
+        {
+            filestr.write((const char *)asset->GetData(), asset->GetSize());
+            filestr.close();
+        }
+        if (!filestr.good())
+        {
+            AssetModule::LogError("Error writing asset " + asset_id + " to file " + path);
+            return std::string();
+        }
+        return path;
     }
 
     std::string AssetCache::GetHash(const std::string &asset_id)
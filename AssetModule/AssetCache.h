@@ -7,10 +7,11 @@
 #include "AssetInterface.h"
 
 #include <QObject>
-#include <QDir>
 
 namespace Asset
 {
+    class DiskAssetCache;
+
     //! Stores assets to memory and/or disk based cache. Created and used by AssetManager.
     class AssetCache : public QObject
     {
@@ -55,6 +56,10 @@ namespace Asset
         //! Update. Adds age to assets, removes oldest if cache size too big
         void Update(f64 frametime);
 
+        //! Returns path of a file with the asset data, for users that need a file instead of data in memory
+        /*! The file is written on demand from the cache, and is removed when the cache is cleared, or on next startup.
+            \return Path, empty if the asset is not in cache
+         */
         std::string GetAbsoluteFilePath(const std::string& asset_id, const std::string& asset_type);
 
     private slots:
@@ -67,11 +72,20 @@ namespace Asset
         //! Read config and init QDir to working directory
         void ReadConfig();
 
-        //! Check contents of a disk cache path
+        //! Check contents of the local, read-only disk cache path
         /*! \param path Disk cache path
          */
         void CheckDiskCache(const std::string& path);
 
+        //! Tries to get asset from the local disk cache
+        Foundation::AssetPtr GetLocalCacheAsset(const std::string& asset_id, const std::string& asset_type);
+
+        //! Removes files of the earlier cache format, which stored each asset in its own file
+        void RemoveLegacyCacheFiles();
+
+        //! Removes files written by GetAbsoluteFilePath
+        void RemoveExportedFiles();
+
         //! Calculates hash from given asset id
         //! Used for file name generation
         std::string GetHash(const std::string &asset_id);
@@ -88,16 +102,17 @@ namespace Asset
         //! Update time accumulator
         f64 update_time_;
 
-        //! Assets known to be in disk cache
-        //! Values are hash values from asset id's
-        std::set<std::string> disk_cache_contents_;
+        //! Disk asset cache
+        boost::scoped_ptr<DiskAssetCache> disk_cache_;
+
+        //! Files in the local disk cache, by hash value of the asset id
+        std::map<std::string, StringVector> local_cache_contents_;
 
         //! Framework
         Foundation::Framework* framework_;
 
-        QDir cache_dir_;
+        //! Maximum disk cache size in bytes, 0 if unlimited
         int disk_cache_max_size_;
-        bool disk_changes_after_last_check_;
     };
 }
 
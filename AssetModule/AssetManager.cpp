@@ -85,6 +85,27 @@ namespace Asset
         return 0;
     }
 
+    void AssetManager::SetAssetPriority(const std::string& asset_id, f32 priority)
+    {
+        AssetProviderVector::iterator i = providers_.begin();
+        while (i != providers_.end())
+        {
+            (*i)->SetAssetPriority(asset_id, priority);
+            ++i;
+        }
+    }
+
+    void AssetManager::CancelAssetRequest(const std::string& asset_id, request_tag_t tag)
+    {
+        AssetProviderVector::iterator i = providers_.begin();
+        while (i != providers_.end())
+        {
+            if ((*i)->CancelAssetRequest(asset_id, tag))
+                return;
+            ++i;
+        }
+    }
+
     Foundation::AssetPtr AssetManager::GetIncompleteAsset(const std::string& asset_id, const std::string& asset_type, uint received)
     {
         if (!received)
@@ -60,6 +60,18 @@ namespace Asset
         /*! \return true if asset id is valid
          */
         virtual bool IsValidId(const std::string& asset_id, const std::string& asset_type);
+
+        //! Sets how soon a requested asset is needed. Passed on to the asset providers
+        /*! \param asset_id Asset ID
+            \param priority Approximate fraction of the screen the asset covers, from 0 to 1
+         */
+        virtual void SetAssetPriority(const std::string& asset_id, f32 priority);
+
+        //! Withdraws an asset request. Passed on to the asset providers until one of them has the request
+        /*! \param asset_id Asset ID
+            \param tag Request tag returned by RequestAsset()
+         */
+        virtual void CancelAssetRequest(const std::string& asset_id, request_tag_t tag);
         
         //! Requests an asset download
         /*! Events will be sent when download progresses, and when asset is ready.
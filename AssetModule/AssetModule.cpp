@@ -16,6 +16,8 @@
 
 #include "Interfaces/ProtocolModuleInterface.h"
 
+#include <sstream>
+
 namespace Asset
 {
     std::string AssetModule::type_name_static_ = "Asset";
@@ -57,6 +59,7 @@ namespace Asset
         manager_->RegisterAssetProvider(udp_asset_provider_);
 
         framework_category_id_ = framework_->GetEventManager()->QueryEventCategory("Framework");
+        framework_->GetEventManager()->SubscribeToEvent(this, framework_category_id_, Foundation::NETWORKING_REGISTERED);
     }
 
     void AssetModule::PostInitialize()
@@ -64,6 +67,10 @@ namespace Asset
         RegisterConsoleCommand(Console::CreateCommand(
             "RequestAsset", "Request asset from server. Usage: RequestAsset(uuid,assettype)", 
             Console::Bind(this, &AssetModule::ConsoleRequestAsset)));
+
+        RegisterConsoleCommand(Console::CreateCommand(
+            "HttpAssetStats", "Prints HTTP asset transfer statistics: queue wait, time to first byte and throughput.", 
+            Console::Bind(this, &AssetModule::ConsoleHttpAssetStats)));
     }
 
     void AssetModule::SubscribeToNetworkEvents(boost::weak_ptr<ProtocolUtilities::ProtocolModuleInterface> currentProtocolModule)
@@ -72,6 +79,11 @@ namespace Asset
         udp_asset_provider_->SetCurrentProtocolModule(protocolModule_);
         network_state_category_id_ = framework_->GetEventManager()->QueryEventCategory("NetworkState");
         inboundcategory_id_ = framework_->GetEventManager()->QueryEventCategory("NetworkIn");
+
+        EventManagerPtr event_manager = framework_->GetEventManager();
+        event_manager->SubscribeToEventCategory(this, inboundcategory_id_);
+        event_manager->SubscribeToEvent(this, network_state_category_id_, ProtocolUtilities::Events::EVENT_SERVER_DISCONNECTED);
+        event_manager->SubscribeToEvent(this, network_state_category_id_, ProtocolUtilities::Events::EVENT_CAPS_FETCHED);
     }
 
     void AssetModule::UnsubscribeNetworkEvents()
@@ -110,6 +122,26 @@ namespace Asset
         return Console::ResultSuccess();
     }
 
+    Console::CommandResult AssetModule::ConsoleHttpAssetStats(const StringVector &params)
+    {
+        if (!http_asset_provider_)
+            return Console::ResultFailure("No HTTP asset provider");
+
+        QtHttpAssetProvider* provider = checked_static_cast<QtHttpAssetProvider*>(http_asset_provider_.get());
+        const HttpAssetStatistics& stats = provider->GetStatistics();
+
+        std::stringstream ss;
+        ss << "Queued " << provider->GetNumQueuedTransfers() << ", in progress " << provider->GetNumActiveTransfers() << std::endl;
+        ss << "Started " << stats.started_ << ", completed " << stats.completed_ << ", failed " << stats.failed_ << ", canceled " << stats.canceled_ << std::endl;
+        if (stats.started_)
+            ss << "Queue wait: average " << stats.total_queue_wait_ * 1000.0 / stats.started_ << " ms, max " << stats.max_queue_wait_ * 1000.0 << " ms" << std::endl;
+        if (stats.first_byte_count_)
+            ss << "Time to first byte: average " << stats.total_time_to_first_byte_ * 1000.0 / stats.first_byte_count_ << " ms, max " << stats.max_time_to_first_byte_ * 1000.0 << " ms" << std::endl;
+        if (stats.completed_)
+            ss << "Transfer time: average " << stats.total_transfer_time_ * 1000.0 / stats.completed_ << " ms, " << stats.total_bytes_ << " bytes received" << std::endl;
+        return Console::ResultSuccess(ss.str());
+    }
+
     bool AssetModule::HandleEvent(
         event_category_id_t category_id,
         event_id_t event_id, 
@@ -56,6 +56,9 @@ namespace Asset
         //! callback for console command
         Console::CommandResult ConsoleRequestAsset(const StringVector &params);
 
+        //! callback for console command, prints HTTP asset transfer statistics
+        Console::CommandResult ConsoleHttpAssetStats(const StringVector &params);
+
         //! returns name of this module. Needed for logging.
         static const std::string &NameStatic() { return type_name_static_; }
 
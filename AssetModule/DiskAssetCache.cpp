@@ -0,0 +1,760 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#include "StableHeaders.h"
+#include "DiskAssetCache.h"
+#include "RexAsset.h"
+#include "AssetModule.h"
+
+#include <QFile>
+#include <QDir>
+#include <QStringList>
+
+namespace Asset
+{
+    namespace
+    {
+        const u32 INDEX_MAGIC = 0x43415852; // "RXAC"
+        const u32 INDEX_VERSION = 1;
+        const u32 RECORD_MAGIC = 0x52415852; // "RXAR"
+        const u32 INITIAL_CAPACITY = 4096;
+        const u64 SEGMENT_SIZE = 32 * 1024 * 1024;
+        //! Smaller assets are copied from the segment files, as mapping them would cost more than the copy
+        const uint MIN_MAPPED_SIZE = 16 * 1024;
+
+        const u32 SLOT_USED = 1;
+        const u32 SLOT_DELETED = 2;
+
+        //! Header of an asset record in a segment file. Followed by the asset ID, asset type and asset data
+        struct RecordHeader
+        {
+            u32 magic_;
+            u16 id_length_;
+            u16 type_length_;
+            u32 data_size_;
+        };
+
+        //! FNV-1a hash of an asset ID
+        u64 HashId(const std::string& asset_id)
+        {
+            u64 hash = 14695981039346656037ULL;
+            for (uint i = 0; i < asset_id.size(); ++i)
+            {
+                hash ^= (u8)asset_id[i];
+                hash *= 1099511628211ULL;
+            }
+            return hash;
+        }
+
+        //! FNV-1a hash of an asset type
+        u32 HashType(const std::string& asset_type)
+        {
+            u32 hash = 2166136261U;
+            for (uint i = 0; i < asset_type.size(); ++i)
+            {
+                hash ^= (u8)asset_type[i];
+                hash *= 16777619U;
+            }
+            return hash;
+        }
+
+        //! Asset data mapped from a segment file. Unmapped when the last asset referring to it is gone
+        class MappedRecord
+        {
+        public:
+            MappedRecord(const boost::shared_ptr<QFile>& file, uchar* address) :
+                file_(file),
+                address_(address)
+            {
+            }
+
+            ~MappedRecord()
+            {
+                file_->unmap(address_);
+            }
+
+        private:
+            boost::shared_ptr<QFile> file_;
+            uchar* address_;
+        };
+    }
+
+    DiskAssetCache::DiskAssetCache(const std::string& path) :
+        path_(QString::fromStdString(path)),
+        index_header_(0),
+        index_slots_(0),
+        live_bytes_(0),
+        file_bytes_(0),
+        compacting_(false),
+        compact_segment_(0),
+        compact_slot_(0),
+        compact_found_(false),
+        is_new_(false)
+    {
+        QDir().mkpath(path_);
+
+        if (!OpenIndex())
+        {
+            if (QFile::exists(path_ + "/index"))
+                AssetModule::LogWarning("Disk asset cache index in " + path + " is corrupt, clearing the cache");
+
+            // Start over, removing any segment files left over
+            QDir dir(path_);
+            QStringList segment_files = dir.entryList(QStringList("segment_*"), QDir::Files);
+            for (int i = 0; i < segment_files.size(); ++i)
+                dir.remove(segment_files[i]);
+
+            is_new_ = CreateIndex(INITIAL_CAPACITY, 0);
+        }
+
+        if (IsOpen())
+            OpenSegments();
+        else
+            AssetModule::LogError("Could not open disk asset cache in " + path);
+    }
+
+    DiskAssetCache::~DiskAssetCache()
+    {
+        active_file_.reset();
+        segments_.clear();
+        for (uint i = 0; i < retired_files_.size(); ++i)
+        {
+            if (retired_files_[i].second.unique())
+            {
+                retired_files_[i].second->close();
+                QFile::remove(retired_files_[i].first);
+            }
+        }
+        retired_files_.clear();
+        CloseIndex();
+    }
+
+    Foundation::AssetPtr DiskAssetCache::GetAsset(const std::string& asset_id, const std::string& asset_type)
+    {
+        if (!IsOpen())
+            return Foundation::AssetPtr();
+
+        std::string type;
+        IndexSlot* slot = FindSlot(asset_id, asset_type, &type);
+        if (!slot)
+            return Foundation::AssetPtr();
+
+        Segment* segment = GetSegment(slot->segment_);
+        if (!segment)
+            return Foundation::AssetPtr();
+
+        const u32 key_size = sizeof(RecordHeader) + asset_id.size() + type.size();
+        const u64 data_offset = (u64)slot->offset_ + key_size;
+        const uint data_size = slot->record_size_ - key_size;
+
+        RexAsset* new_asset = new RexAsset(asset_id, type);
+        Foundation::AssetPtr asset(new_asset);
+
+        bool mapped = false;
+        if (data_size >= MIN_MAPPED_SIZE)
+        {
+            uchar* address = segment->file_->map(data_offset, data_size);
+            if (address)
+            {
+                new_asset->SetMappedData(boost::shared_ptr<void>(new MappedRecord(segment->file_, address)), address, data_size);
+                mapped = true;
+            }
+        }
+
+        if (!mapped)
+        {
+            RexAsset::AssetDataVector& data = new_asset->GetDataInternal();
+            data.resize(data_size);
+            if ((data_size) && ((!segment->file_->seek(data_offset)) ||
+                (segment->file_->read((char*)&data[0], data_size) != (qint64)data_size)))
+            {
+                AssetModule::LogWarning("Could not read asset " + asset_id + " from disk cache");
+                RemoveSlot(*slot);
+                return Foundation::AssetPtr();
+            }
+        }
+
+        slot->last_access_ = ++index_header_->access_counter_;
+        return asset;
+    }
+
+    bool DiskAssetCache::StoreAsset(const std::string& asset_id, const std::string& asset_type, const u8* data, uint size)
+    {
+        if (!IsOpen())
+            return false;
+
+        // Keep at most 70% of the slots in use, so that probe sequences stay short. If mostly removed assets fill
+        // the slots, rebuild with the same capacity
+        const u64 capacity = index_header_->capacity_;
+        if ((index_header_->num_used_ + index_header_->num_deleted_ + 1) * 10 > capacity * 7)
+        {
+            u32 new_capacity = ((index_header_->num_used_ + 1) * 10 > capacity * 3) ? (u32)capacity * 2 : (u32)capacity;
+            if (!ResizeIndex(new_capacity))
+                return false;
+        }
+
+        IndexSlot new_slot;
+        memset(&new_slot, 0, sizeof(IndexSlot));
+        new_slot.id_hash_ = HashId(asset_id);
+        new_slot.type_hash_ = HashType(asset_type);
+        new_slot.flags_ = SLOT_USED;
+        if (!AppendRecord(new_slot, asset_id, asset_type, data, size))
+            return false;
+
+        // Replace the earlier copy only once the new one is safely written
+        IndexSlot* old_slot = FindSlot(asset_id, asset_type);
+        if (old_slot)
+            RemoveSlot(*old_slot);
+
+        IndexSlot* slot = FindFreeSlot(new_slot.id_hash_);
+        new_slot.last_access_ = ++index_header_->access_counter_;
+        *slot = new_slot;
+        ++index_header_->num_used_;
+        return true;
+    }
+
+    bool DiskAssetCache::RemoveAsset(const std::string& asset_id, const std::string& asset_type)
+    {
+        if (!IsOpen())
+            return false;
+
+        IndexSlot* slot = FindSlot(asset_id, asset_type);
+        if (!slot)
+            return false;
+
+        RemoveSlot(*slot);
+        return true;
+    }
+
+    uint DiskAssetCache::Evict(u64 target_size, uint max_slots)
+    {
+        if (!IsOpen())
+            return 0;
+
+        const u32 mask = index_header_->capacity_ - 1;
+        // Assets accessed within this many latest accesses are recently used. As each access stamps at most one asset,
+        // at least half of the assets are always older than this
+        const u32 recent_accesses = index_header_->num_used_ / 2;
+
+        uint evicted = 0;
+        for (uint i = 0; (i < max_slots) && (live_bytes_ > target_size) && (index_header_->num_used_); ++i)
+        {
+            IndexSlot& slot = index_slots_[index_header_->clock_hand_ & mask];
+            index_header_->clock_hand_ = (index_header_->clock_hand_ + 1) & mask;
+
+            if (!(slot.flags_ & SLOT_USED))
+                continue;
+            if (index_header_->access_counter_ - slot.last_access_ < recent_accesses)
+                continue;
+
+            RemoveSlot(slot);
+            ++evicted;
+        }
+
+        return evicted;
+    }
+
+    bool DiskAssetCache::Compact(u64 max_bytes, uint max_slots)
+    {
+        // Retry removing the files that still had assets mapped from them
+        std::vector<std::pair<QString, boost::shared_ptr<QFile> > >::iterator r = retired_files_.begin();
+        while (r != retired_files_.end())
+        {
+            if (r->second.unique())
+            {
+                r->second->close();
+                QFile::remove(r->first);
+                r = retired_files_.erase(r);
+            }
+            else
+                ++r;
+        }
+
+        if (!IsOpen())
+            return false;
+
+        // Find the sealed segment with the most dead space, if at least half dead, unless one is already being compacted
+        SegmentMap::iterator best = segments_.find(compact_segment_);
+        if ((!compacting_) || (best == segments_.end()))
+        {
+            compacting_ = false;
+            best = segments_.end();
+            u64 best_dead_bytes = 0;
+            for (SegmentMap::iterator i = segments_.begin(); i != segments_.end(); ++i)
+            {
+                if (i->first == index_header_->active_segment_)
+                    continue;
+                const Segment& segment = i->second;
+                u64 dead_bytes = segment.size_ - segment.live_bytes_;
+                if ((segment.live_bytes_ * 2 <= segment.size_) && ((best == segments_.end()) || (dead_bytes > best_dead_bytes)))
+                {
+                    best = i;
+                    best_dead_bytes = dead_bytes;
+                }
+            }
+            if (best == segments_.end())
+                return false;
+
+            compacting_ = true;
+            compact_segment_ = best->first;
+            compact_slot_ = 0;
+            compact_found_ = false;
+        }
+
+        // Move the remaining assets to the end of the store, continuing from where the previous call stopped. The whole
+        // index is swept, so that no slot can be left referring to the segment once its file is removed
+        const u32 number = best->first;
+        Segment& segment = best->second;
+        std::vector<u8> buffer;
+        u64 moved_bytes = 0;
+        uint swept = 0;
+        for (; compact_slot_ < index_header_->capacity_; ++compact_slot_)
+        {
+            if ((moved_bytes >= max_bytes) || (swept >= max_slots))
+                return false;
+            ++swept;
+
+            IndexSlot& slot = index_slots_[compact_slot_];
+            if ((!(slot.flags_ & SLOT_USED)) || (slot.segment_ != number))
+                continue;
+            compact_found_ = true;
+
+            buffer.resize(slot.record_size_);
+            RecordHeader header;
+            bool valid = (slot.record_size_ >= sizeof(RecordHeader)) && (segment.file_->seek(slot.offset_)) &&
+                (segment.file_->read((char*)&buffer[0], slot.record_size_) == (qint64)slot.record_size_);
+            if (valid)
+            {
+                memcpy(&header, &buffer[0], sizeof(RecordHeader));
+                valid = (header.magic_ == RECORD_MAGIC) &&
+                    (sizeof(RecordHeader) + header.id_length_ + header.type_length_ + header.data_size_ == slot.record_size_);
+            }
+            if (!valid)
+            {
+                RemoveSlot(slot);
+                continue;
+            }
+
+            const char* key = (const char*)&buffer[sizeof(RecordHeader)];
+            std::string asset_id(key, header.id_length_);
+            std::string asset_type(key + header.id_length_, header.type_length_);
+            const u8* data = &buffer[sizeof(RecordHeader) + header.id_length_ + header.type_length_];
+
+            IndexSlot moved_slot = slot;
+            if (!AppendRecord(moved_slot, asset_id, asset_type, data, header.data_size_))
+            {
+                compacting_ = false;
+                return false;
+            }
+
+            segment.live_bytes_ -= slot.record_size_;
+            live_bytes_ -= slot.record_size_;
+            moved_bytes += slot.record_size_;
+            slot = moved_slot;
+        }
+
+        if (segment.live_bytes_)
+        {
+            // Sweep again if assets were found on this pass, in case any was missed. If none was, the accounting is off
+            if (compact_found_)
+            {
+                compact_slot_ = 0;
+                compact_found_ = false;
+                return false;
+            }
+            AssetModule::LogWarning("Disk asset cache segment " + ToString<u32>(number) + " has no assets left, but " +
+                ToString<u64>(segment.live_bytes_) + " bytes are counted live in it");
+        }
+
+        compacting_ = false;
+        RemoveSegment(number);
+        return true;
+    }
+
+    void DiskAssetCache::Clear(uint& removed_assets, u64& removed_bytes)
+    {
+        removed_assets = GetNumAssets();
+        removed_bytes = file_bytes_;
+
+        if (!IsOpen())
+            return;
+
+        std::vector<u32> numbers;
+        for (SegmentMap::iterator i = segments_.begin(); i != segments_.end(); ++i)
+            numbers.push_back(i->first);
+        for (uint i = 0; i < numbers.size(); ++i)
+            RemoveSegment(numbers[i]);
+
+        live_bytes_ = 0;
+        file_bytes_ = 0;
+        compacting_ = false;
+        if (CreateIndex(INITIAL_CAPACITY, index_header_->next_segment_))
+            GetSegment(index_header_->active_segment_, true);
+    }
+
+    uint DiskAssetCache::GetNumAssets() const
+    {
+        return index_header_ ? index_header_->num_used_ : 0;
+    }
+
+    bool DiskAssetCache::OpenIndex()
+    {
+        index_file_.reset(new QFile(path_ + "/index"));
+        if ((!index_file_->exists()) || (!index_file_->open(QIODevice::ReadWrite)))
+        {
+            index_file_.reset();
+            return false;
+        }
+
+        qint64 file_size = index_file_->size();
+        uchar* address = 0;
+        if (file_size >= (qint64)sizeof(IndexHeader))
+            address = index_file_->map(0, file_size);
+        if (!address)
+        {
+            index_file_.reset();
+            return false;
+        }
+
+        IndexHeader* header = reinterpret_cast<IndexHeader*>(address);
+        const u32 capacity = header->capacity_;
+        if ((header->magic_ != INDEX_MAGIC) || (header->version_ != INDEX_VERSION) || (!capacity) ||
+            (capacity & (capacity - 1)) || (file_size != (qint64)(sizeof(IndexHeader) + (u64)capacity * sizeof(IndexSlot))) ||
+            (header->num_used_ + header->num_deleted_ > capacity))
+        {
+            index_file_->unmap(address);
+            index_file_.reset();
+            return false;
+        }
+
+        index_header_ = header;
+        index_slots_ = reinterpret_cast<IndexSlot*>(address + sizeof(IndexHeader));
+        return true;
+    }
+
+    bool DiskAssetCache::CreateIndex(u32 capacity, u32 first_segment)
+    {
+        CloseIndex();
+
+        const qint64 file_size = (qint64)(sizeof(IndexHeader) + (u64)capacity * sizeof(IndexSlot));
+        index_file_.reset(new QFile(path_ + "/index"));
+        uchar* address = 0;
+        if ((index_file_->open(QIODevice::ReadWrite | QIODevice::Truncate)) && (index_file_->resize(file_size)))
+            address = index_file_->map(0, file_size);
+        if (!address)
+        {
+            AssetModule::LogError("Could not create disk asset cache index " + index_file_->fileName().toStdString());
+            index_file_.reset();
+            return false;
+        }
+
+        memset(address, 0, file_size);
+        index_header_ = reinterpret_cast<IndexHeader*>(address);
+        index_slots_ = reinterpret_cast<IndexSlot*>(address + sizeof(IndexHeader));
+        index_header_->magic_ = INDEX_MAGIC;
+        index_header_->version_ = INDEX_VERSION;
+        index_header_->capacity_ = capacity;
+        index_header_->active_segment_ = first_segment;
+        index_header_->first_segment_ = first_segment;
+        index_header_->next_segment_ = first_segment + 1;
+        return true;
+    }
+
+    bool DiskAssetCache::ResizeIndex(u32 capacity)
+    {
+        const QString index_path = path_ + "/index";
+        const QString new_index_path = path_ + "/index.new";
+        const qint64 file_size = (qint64)(sizeof(IndexHeader) + (u64)capacity * sizeof(IndexSlot));
+
+        {
+            QFile new_file(new_index_path);
+            uchar* address = 0;
+            if ((new_file.open(QIODevice::ReadWrite | QIODevice::Truncate)) && (new_file.resize(file_size)))
+                address = new_file.map(0, file_size);
+            if (!address)
+            {
+                AssetModule::LogError("Could not resize disk asset cache index " + new_index_path.toStdString());
+                return false;
+            }
+
+            memset(address, 0, file_size);
+            IndexHeader* header = reinterpret_cast<IndexHeader*>(address);
+            IndexSlot* slots = reinterpret_cast<IndexSlot*>(address + sizeof(IndexHeader));
+            *header = *index_header_;
+            header->capacity_ = capacity;
+            header->num_deleted_ = 0;
+            header->clock_hand_ = 0;
+
+            const u32 mask = capacity - 1;
+            for (u32 i = 0; i < index_header_->capacity_; ++i)
+            {
+                const IndexSlot& slot = index_slots_[i];
+                if (!(slot.flags_ & SLOT_USED))
+                    continue;
+                u32 j = (u32)slot.id_hash_ & mask;
+                while (slots[j].flags_ & SLOT_USED)
+                    j = (j + 1) & mask;
+                slots[j] = slot;
+            }
+
+            new_file.unmap(address);
+            new_file.close();
+        }
+
+        CloseIndex();
+        QFile::remove(index_path);
+        if ((!QFile::rename(new_index_path, index_path)) || (!OpenIndex()))
+        {
+            AssetModule::LogError("Could not replace disk asset cache index " + index_path.toStdString());
+            return false;
+        }
+
+        // The slots moved, so a compaction in progress has to sweep the index again from the start
+        compact_slot_ = 0;
+        return true;
+    }
+
+    void DiskAssetCache::CloseIndex()
+    {
+        if ((index_file_) && (index_header_))
+            index_file_->unmap(reinterpret_cast<uchar*>(index_header_));
+        index_file_.reset();
+        index_header_ = 0;
+        index_slots_ = 0;
+    }
+
+    void DiskAssetCache::OpenSegments()
+    {
+        for (u32 i = 0; i < index_header_->capacity_; ++i)
+        {
+            IndexSlot& slot = index_slots_[i];
+            if (!(slot.flags_ & SLOT_USED))
+                continue;
+
+            // Drop assets whose segment file is gone or shorter than it should be
+            Segment* segment = GetSegment(slot.segment_);
+            if ((!segment) || ((u64)slot.offset_ + slot.record_size_ > segment->size_))
+            {
+                slot.flags_ = SLOT_DELETED;
+                --index_header_->num_used_;
+                ++index_header_->num_deleted_;
+                continue;
+            }
+
+            segment->live_bytes_ += slot.record_size_;
+            live_bytes_ += slot.record_size_;
+        }
+
+        GetSegment(index_header_->active_segment_, true);
+
+        // Remove the segment files that were left over, for example because assets were mapped from them at exit
+        for (u32 number = index_header_->first_segment_; number != index_header_->next_segment_; ++number)
+        {
+            if (segments_.find(number) == segments_.end())
+                QFile::remove(GetSegmentPath(number));
+        }
+        if (!segments_.empty())
+            index_header_->first_segment_ = segments_.begin()->first;
+    }
+
+    DiskAssetCache::Segment* DiskAssetCache::GetSegment(u32 number, bool create)
+    {
+        SegmentMap::iterator i = segments_.find(number);
+        if (i != segments_.end())
+            return &i->second;
+
+        QString path = GetSegmentPath(number);
+        if ((create) && (!QFile::exists(path)))
+        {
+            QFile new_file(path);
+            if (!new_file.open(QIODevice::WriteOnly))
+            {
+                AssetModule::LogError("Could not create disk asset cache file " + path.toStdString());
+                return 0;
+            }
+        }
+
+        boost::shared_ptr<QFile> file(new QFile(path));
+        if (!file->open(QIODevice::ReadOnly))
+            return 0;
+
+        Segment& segment = segments_[number];
+        segment.file_ = file;
+        segment.size_ = file->size();
+        file_bytes_ += segment.size_;
+        return &segment;
+    }
+
+    void DiskAssetCache::RemoveSegment(u32 number)
+    {
+        SegmentMap::iterator i = segments_.find(number);
+        if (i == segments_.end())
+            return;
+
+        boost::shared_ptr<QFile> file = i->second.file_;
+        file_bytes_ -= i->second.size_;
+        live_bytes_ -= i->second.live_bytes_;
+        segments_.erase(i);
+        if ((index_header_) && (number == index_header_->active_segment_))
+            active_file_.reset();
+
+        // Closing the file would unmap the data of assets still referring to it, so wait until there are none
+        QString path = GetSegmentPath(number);
+        if (file.unique())
+        {
+            file->close();
+            if (!QFile::remove(path))
+                AssetModule::LogWarning("Could not remove disk asset cache file " + path.toStdString());
+        }
+        else
+            retired_files_.push_back(std::make_pair(path, file));
+    }
+
+    DiskAssetCache::IndexSlot* DiskAssetCache::FindSlot(const std::string& asset_id, const std::string& asset_type, std::string* found_type)
+    {
+        const u64 id_hash = HashId(asset_id);
+        const u32 type_hash = HashType(asset_type);
+        const u32 mask = index_header_->capacity_ - 1;
+
+        std::string record_id;
+        std::string record_type;
+        u32 j = (u32)id_hash & mask;
+        for (u32 i = 0; i < index_header_->capacity_; ++i, j = (j + 1) & mask)
+        {
+            IndexSlot& slot = index_slots_[j];
+            // An empty slot ends the probe sequence, a removed one does not
+            if (!(slot.flags_ & (SLOT_USED | SLOT_DELETED)))
+                return 0;
+            if ((!(slot.flags_ & SLOT_USED)) || (slot.id_hash_ != id_hash))
+                continue;
+            if ((!asset_type.empty()) && (slot.type_hash_ != type_hash))
+                continue;
+
+            // Hashes may collide, so check the record itself
+            if ((!ReadRecordKey(slot, record_id, record_type)) || (record_id != asset_id) ||
+                ((!asset_type.empty()) && (record_type != asset_type)))
+                continue;
+
+            if (found_type)
+                *found_type = record_type;
+            return &slot;
+        }
+
+        return 0;
+    }
+
+    DiskAssetCache::IndexSlot* DiskAssetCache::FindFreeSlot(u64 id_hash)
+    {
+        const u32 mask = index_header_->capacity_ - 1;
+        u32 j = (u32)id_hash & mask;
+        while (index_slots_[j].flags_ & SLOT_USED)
+            j = (j + 1) & mask;
+
+        if (index_slots_[j].flags_ & SLOT_DELETED)
+            --index_header_->num_deleted_;
+        return &index_slots_[j];
+    }
+
+    bool DiskAssetCache::ReadRecordKey(const IndexSlot& slot, std::string& asset_id, std::string& asset_type)
+    {
+        Segment* segment = GetSegment(slot.segment_);
+        if ((!segment) || (slot.record_size_ < sizeof(RecordHeader)) || ((u64)slot.offset_ + slot.record_size_ > segment->size_))
+            return false;
+
+        RecordHeader header;
+        if ((!segment->file_->seek(slot.offset_)) ||
+            (segment->file_->read((char*)&header, sizeof(RecordHeader)) != (qint64)sizeof(RecordHeader)))
+            return false;
+        if ((header.magic_ != RECORD_MAGIC) ||
+            (sizeof(RecordHeader) + header.id_length_ + header.type_length_ + header.data_size_ != slot.record_size_))
+            return false;
+
+        asset_id.resize(header.id_length_);
+        asset_type.resize(header.type_length_);
+        if ((header.id_length_) && (segment->file_->read(&asset_id[0], header.id_length_) != header.id_length_))
+            return false;
+        if ((header.type_length_) && (segment->file_->read(&asset_type[0], header.type_length_) != header.type_length_))
+            return false;
+        return true;
+    }
+
+    bool DiskAssetCache::AppendRecord(IndexSlot& slot, const std::string& asset_id, const std::string& asset_type, const u8* data, uint size)
+    {
+        const u64 record_size = sizeof(RecordHeader) + asset_id.size() + asset_type.size() + size;
+        if ((asset_id.size() > 0xffff) || (asset_type.size() > 0xffff) || (record_size > 0xffffffff))
+        {
+            AssetModule::LogError("Asset " + asset_id + " is too large for the disk cache");
+            return false;
+        }
+
+        // Start a new segment if the record does not fit in the active one
+        Segment* segment = GetSegment(index_header_->active_segment_, true);
+        if ((segment) && (segment->size_) && (segment->size_ + record_size > SEGMENT_SIZE))
+        {
+            active_file_.reset();
+            index_header_->active_segment_ = index_header_->next_segment_++;
+            segment = GetSegment(index_header_->active_segment_, true);
+        }
+        if (!segment)
+            return false;
+
+        if (!active_file_)
+        {
+            active_file_.reset(new QFile(GetSegmentPath(index_header_->active_segment_)));
+            if (!active_file_->open(QIODevice::WriteOnly | QIODevice::Append))
+            {
+                AssetModule::LogError("Could not open disk asset cache file " + active_file_->fileName().toStdString());
+                active_file_.reset();
+                return false;
+            }
+        }
+
+        RecordHeader header;
+        header.magic_ = RECORD_MAGIC;
+        header.id_length_ = (u16)asset_id.size();
+        header.type_length_ = (u16)asset_type.size();
+        header.data_size_ = size;
+
+        bool success = (active_file_->write((const char*)&header, sizeof(RecordHeader)) == (qint64)sizeof(RecordHeader)) &&
+            (active_file_->write(asset_id.data(), asset_id.size()) == (qint64)asset_id.size()) &&
+            (active_file_->write(asset_type.data(), asset_type.size()) == (qint64)asset_type.size()) &&
+            ((!size) || (active_file_->write((const char*)data, size) == (qint64)size)) &&
+            (active_file_->flush());
+        if (!success)
+        {
+            // Whatever got written is dead space now
+            AssetModule::LogError("Could not write asset " + asset_id + " to disk cache");
+            u64 file_size = active_file_->size();
+            file_bytes_ += file_size - segment->size_;
+            segment->size_ = file_size;
+            return false;
+        }
+
+        slot.segment_ = index_header_->active_segment_;
+        slot.offset_ = (u32)segment->size_;
+        slot.record_size_ = (u32)record_size;
+        segment->size_ += record_size;
+        segment->live_bytes_ += record_size;
+        file_bytes_ += record_size;
+        live_bytes_ += record_size;
+        return true;
+    }
+
+    void DiskAssetCache::RemoveSlot(IndexSlot& slot)
+    {
+        SegmentMap::iterator i = segments_.find(slot.segment_);
+        if (i != segments_.end())
+        {
+            i->second.live_bytes_ -= slot.record_size_;
+            live_bytes_ -= slot.record_size_;
+        }
+
+        slot.flags_ = SLOT_DELETED;
+        --index_header_->num_used_;
+        ++index_header_->num_deleted_;
+    }
+
+    QString DiskAssetCache::GetSegmentPath(u32 number) const
+    {
+        return path_ + "/segment_" + QString::number(number);
+    }
+}
@@ -0,0 +1,240 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#ifndef incl_Asset_DiskAssetCache_h
+#define incl_Asset_DiskAssetCache_h
+
+#include "Foundation.h"
+#include "AssetInterface.h"
+
+#include <QString>
+
+class QFile;
+
+namespace Asset
+{
+    //! Packed on-disk asset store. Created and used by AssetCache.
+    /*! Assets are appended as records to segment files of a few tens of megabytes. An open-addressing hash table in a
+        separate index file, keyed by asset ID and type, tells which segment and offset each asset is at. The index file
+        is memory-mapped, so lookups and updates touch no files, and opening the store does not list any directories.
+
+        Large assets are returned without copying, referring directly to a memory-mapped region of the segment file.
+
+        Each lookup stamps the asset with an access counter. Evict() sweeps a part of the index at a time and drops the
+        assets not among the recently used half, which approximates LRU without keeping an ordered list on disk.
+        Evicted and replaced records leave dead space in their segments; Compact() copies the remaining assets of the
+        emptiest segment to the end of the store a few at a time, and removes the segment file once it is empty.
+
+        Not thread-safe; used from the main thread only.
+     */
+    class DiskAssetCache
+    {
+    public:
+        //! Constructor. Opens the store in a directory, or creates it if there is none, or if the index is corrupt.
+        /*! \param path Directory of the store
+         */
+        explicit DiskAssetCache(const std::string& path);
+
+        //! Destructor. Closes the store.
+        ~DiskAssetCache();
+
+        //! Returns whether the store could be opened
+        bool IsOpen() const { return index_header_ != 0; }
+
+        //! Returns whether the store was created anew when opened
+        bool IsNew() const { return is_new_; }
+
+        //! Gets asset from the store
+        /*! \param asset_id Asset ID
+            \param asset_type Asset type, empty to match any
+            \return Pointer to asset if found, or null if not
+         */
+        Foundation::AssetPtr GetAsset(const std::string& asset_id, const std::string& asset_type);
+
+        //! Stores asset, replacing an earlier asset with the same ID and type
+        /*! \return true if successful
+         */
+        bool StoreAsset(const std::string& asset_id, const std::string& asset_type, const u8* data, uint size);
+
+        //! Removes asset
+        /*! \return true if the asset was in the store
+         */
+        bool RemoveAsset(const std::string& asset_id, const std::string& asset_type);
+
+        //! Evicts least recently used assets until the size of the store is at most the target size
+        /*! \param target_size Target size in bytes
+            \param max_slots Maximum number of index slots to sweep, to limit the time taken
+            \return Number of assets evicted
+         */
+        uint Evict(u64 target_size, uint max_slots);
+
+        //! Reclaims the dead space of the segment file with the most of it, if at least half of the file is dead
+        /*! Moves a limited amount of assets per call, continuing on the next call, so that compacting does not stall
+            the caller. Also removes the segment files that could not be removed earlier because assets were still mapped
+            from them.
+            \param max_bytes Number of bytes of assets to move before stopping
+            \param max_slots Maximum number of index slots to sweep, to limit the time taken
+            \return true if a segment file was removed
+         */
+        bool Compact(u64 max_bytes, uint max_slots);
+
+        //! Removes all assets
+        /*! \param removed_assets Number of assets removed
+            \param removed_bytes Number of bytes removed
+         */
+        void Clear(uint& removed_assets, u64& removed_bytes);
+
+        //! Returns total size of the assets in bytes
+        u64 GetSize() const { return live_bytes_; }
+
+        //! Returns total size of the segment files in bytes
+        u64 GetFileSize() const { return file_bytes_; }
+
+        //! Returns number of assets
+        uint GetNumAssets() const;
+
+    private:
+        DiskAssetCache(const DiskAssetCache&);
+        void operator=(const DiskAssetCache&);
+
+        //! Index file header
+        struct IndexHeader
+        {
+            u32 magic_;
+            u32 version_;
+            //! Number of slots, a power of two
+            u32 capacity_;
+            //! Number of slots holding an asset
+            u32 num_used_;
+            //! Number of slots of removed assets
+            u32 num_deleted_;
+            //! Incremented on each access, used to stamp the slots
+            u32 access_counter_;
+            //! Next slot to sweep when evicting
+            u32 clock_hand_;
+            //! Segment that new records are appended to
+            u32 active_segment_;
+            //! Lowest segment number that may still have a file
+            u32 first_segment_;
+            //! Number of the next segment to create
+            u32 next_segment_;
+            u32 reserved_[6];
+        };
+
+        //! Index slot
+        struct IndexSlot
+        {
+            u64 id_hash_;
+            u32 type_hash_;
+            u32 flags_;
+            u32 segment_;
+            u32 offset_;
+            u32 record_size_;
+            u32 last_access_;
+        };
+
+        //! A segment file
+        struct Segment
+        {
+            Segment() : size_(0), live_bytes_(0) {}
+
+            //! Read handle. Asset data mapped from the file holds a reference to it
+            boost::shared_ptr<QFile> file_;
+            u64 size_;
+            u64 live_bytes_;
+        };
+        typedef std::map<u32, Segment> SegmentMap;
+
+        //! Opens the index file, returns false if missing or corrupt
+        bool OpenIndex();
+
+        //! Creates an empty index file
+        /*! \param first_segment Number of the first segment to use. Segment files from earlier are not reused,
+                   as assets may still be mapped from them
+         */
+        bool CreateIndex(u32 capacity, u32 first_segment);
+
+        //! Rebuilds the index with a new capacity, dropping the slots of removed assets
+        bool ResizeIndex(u32 capacity);
+
+        //! Unmaps and closes the index file
+        void CloseIndex();
+
+        //! Opens the segment files referred to by the index and sums up their contents. Removes unused segment files
+        void OpenSegments();
+
+        //! Returns segment, opening its file if necessary. Returns null if the file can not be opened
+        Segment* GetSegment(u32 number, bool create = false);
+
+        //! Removes a segment file, or queues it for removal if assets are still mapped from it
+        void RemoveSegment(u32 number);
+
+        //! Returns the slot of an asset, or null if not found
+        /*! \param asset_type Asset type, empty to match any
+            \param found_type If not null, set to the type of the asset found
+         */
+        IndexSlot* FindSlot(const std::string& asset_id, const std::string& asset_type, std::string* found_type = 0);
+
+        //! Returns a free slot to store an asset with the given ID hash to
+        IndexSlot* FindFreeSlot(u64 id_hash);
+
+        //! Reads the asset ID and type from the record of a slot
+        /*! \return false if the record could not be read or is corrupt
+         */
+        bool ReadRecordKey(const IndexSlot& slot, std::string& asset_id, std::string& asset_type);
+
+        //! Appends a record to the active segment, starting a new segment if it is full
+        /*! \return true if successful. The location of the record is written to the slot
+         */
+        bool AppendRecord(IndexSlot& slot, const std::string& asset_id, const std::string& asset_type, const u8* data, uint size);
+
+        //! Marks the slot of an asset removed
+        void RemoveSlot(IndexSlot& slot);
+
+        //! Returns path of a segment file
+        QString GetSegmentPath(u32 number) const;
+
+        //! Directory of the store
+        QString path_;
+
+        //! Index file
+        boost::shared_ptr<QFile> index_file_;
+
+        //! Mapped index header, null if the store is not open
+        IndexHeader* index_header_;
+
+        //! Mapped index slots
+        IndexSlot* index_slots_;
+
+        //! Open segments
+        SegmentMap segments_;
+
+        //! Write handle of the active segment
+        boost::shared_ptr<QFile> active_file_;
+
+        //! Segment files to remove once no assets are mapped from them
+        std::vector<std::pair<QString, boost::shared_ptr<QFile> > > retired_files_;
+
+        //! Total size of the assets
+        u64 live_bytes_;
+
+        //! Total size of the segment files
+        u64 file_bytes_;
+
+        //! Whether a segment is being compacted
+        bool compacting_;
+
+        //! Segment being compacted
+        u32 compact_segment_;
+
+        //! Next index slot to sweep when compacting
+        u32 compact_slot_;
+
+        //! Whether the current compaction sweep has found assets in the segment
+        bool compact_found_;
+
+        //! Whether the store was created anew
+        bool is_new_;
+    };
+}
+
+#endif
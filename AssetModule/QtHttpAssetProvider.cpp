@@ -18,21 +18,47 @@
 #include <QDebug>
 #include <QStringList>
 
-#define MAX_HTTP_CONNECTIONS 10000 // Basically means no limit to parallel connections
+// QNetworkAccessManager opens 6 connections per host and pipelines up to 3 requests on each, so this keeps them all busy
+// while leaving the rest of the requests in our own priority queue
+static const int DEFAULT_MAX_ACTIVE_TRANSFERS = 18;
 
 namespace Asset
 {
+    HttpAssetStatistics::HttpAssetStatistics() :
+        started_(0),
+        completed_(0),
+        failed_(0),
+        canceled_(0),
+        total_queue_wait_(0.0),
+        max_queue_wait_(0.0),
+        first_byte_count_(0),
+        total_time_to_first_byte_(0.0),
+        max_time_to_first_byte_(0.0),
+        total_transfer_time_(0.0),
+        total_bytes_(0)
+    {
+    }
+
+    //! Returns seconds between two clock times
+    static f64 GetSeconds(tick_t start, tick_t end)
+    {
+        return (f64)(end - start) / GetCurrentClockFreq();
+    }
+
     QtHttpAssetProvider::QtHttpAssetProvider(Foundation::Framework *framework) :
         QObject(),
         framework_(framework),
         event_manager_(framework->GetEventManager().get()),
         name_("QtHttpAssetProvider"),
         network_manager_(new QNetworkAccessManager()),
-        filling_stack_(false),
+        next_sequence_(0),
         get_texture_cap_(QUrl())
     {
         if (event_manager_)
             asset_event_category_ = event_manager_->QueryEventCategory("Asset");
+        max_active_transfers_ = framework_->GetDefaultConfig().DeclareSetting("AssetSystem", "max_http_transfers", DEFAULT_MAX_ACTIVE_TRANSFERS);
+        if (max_active_transfers_ <= 0)
+            max_active_transfers_ = 1;
         connect(network_manager_, SIGNAL(finished(QNetworkReply*)), SLOT(TranferCompleted(QNetworkReply*)));
         AssetModule::LogInfo("HttpAssetProvider initialized");
     }
@@ -85,9 +111,12 @@ namespace Asset
             return false;
 
         QString asset_id_qstring = QString::fromStdString(asset_id);
-        if (assetid_to_transfer_map_.contains(asset_id_qstring))
+        QtHttpAssetTransfer *existing = assetid_to_transfer_map_.value(asset_id_qstring);
+        if (!existing)
+            existing = pending_transfers_.value(asset_id_qstring);
+        if (existing)
         {
-            assetid_to_transfer_map_[asset_id_qstring]->GetTranferInfo().AddTag(tag);
+            existing->GetTranferInfo().AddTag(tag);
         }
         else
         {
@@ -111,18 +140,65 @@ namespace Asset
                 return false;
 
             transfer->setOriginatingObject(transfer);
-            if (assetid_to_transfer_map_.count() <= MAX_HTTP_CONNECTIONS)
-            {
-                assetid_to_transfer_map_[asset_id_qstring] = transfer;
-                network_manager_->get(*transfer);
-                AssetModule::LogDebug("New HTTP asset request: " + asset_id + " type: " + asset_type);
-            }
-            else
-                pending_request_queue_.append(transfer);
+            // Let the requests share the kept-alive connections to the same host without waiting for each other
+            transfer->setAttribute(QNetworkRequest::HttpPipeliningAllowedAttribute, true);
+            transfer->SetSequence(next_sequence_++);
+            transfer->queued_time_ = GetCurrentClockTime();
+
+            pending_transfers_[asset_id_qstring] = transfer;
+            pending_queue_[GetQueueKey(transfer)] = transfer;
+            StartTransferFromQueue();
         }
         return true;
     }
 
+    void QtHttpAssetProvider::SetAssetPriority(const std::string& asset_id, f32 priority)
+    {
+        // Only the queue order can be changed; transfers in progress are already on the wire
+        QtHttpAssetTransfer *transfer = pending_transfers_.value(QString::fromStdString(asset_id));
+        if (!transfer || transfer->GetPriority() == priority)
+            return;
+
+        pending_queue_.erase(GetQueueKey(transfer));
+        transfer->SetPriority(priority);
+        pending_queue_[GetQueueKey(transfer)] = transfer;
+    }
+
+    bool QtHttpAssetProvider::CancelAssetRequest(const std::string& asset_id, request_tag_t tag)
+    {
+        QString asset_id_qstring = QString::fromStdString(asset_id);
+        QtHttpAssetTransfer *transfer = pending_transfers_.value(asset_id_qstring);
+        bool pending = transfer != 0;
+        if (!transfer)
+            transfer = assetid_to_transfer_map_.value(asset_id_qstring);
+        if (!transfer || !transfer->GetTranferInfo().tags.removeOne(tag))
+            return false;
+
+        // Others still waiting for the asset
+        if (!transfer->GetTranferInfo().tags.isEmpty())
+            return true;
+
+        statistics_.canceled_++;
+        if (pending)
+        {
+            pending_queue_.erase(GetQueueKey(transfer));
+            pending_transfers_.remove(asset_id_qstring);
+            SAFE_DELETE(transfer);
+        }
+        else
+        {
+            // The reply finishes with an error once aborted; it is recognized as canceled and cleaned up then
+            assetid_to_transfer_map_.remove(asset_id_qstring);
+            canceled_transfers_.insert(transfer);
+            if (transfer->GetReply())
+                transfer->GetReply()->abort();
+            StartTransferFromQueue();
+        }
+
+        AssetModule::LogDebug("HTTP asset " + asset_id + " canceled by requester");
+        return true;
+    }
+
     bool QtHttpAssetProvider::InProgress(const std::string& asset_id)
     {
         QString qt_asset_id = QString::fromStdString(asset_id);
@@ -185,6 +261,15 @@ namespace Asset
         fake_metadata_fetch_ = false;
         QtHttpAssetTransfer *transfer = dynamic_cast<QtHttpAssetTransfer*>(reply->request().originatingObject());
 
+        /**** THIS TRANSFER WAS CANCELED BY ITS REQUESTERS ****/
+        if (transfer && canceled_transfers_.contains(transfer))
+        {
+            canceled_transfers_.remove(transfer);
+            SAFE_DELETE(transfer);
+            reply->deleteLater();
+            return;
+        }
+
         /**** THIS IS A DATA REQUEST REPLY AND IT FAILED ****/
         if (reply->error() != QNetworkReply::NoError && transfer)
         {
@@ -195,6 +280,7 @@ namespace Asset
             event_manager_->SendDelayedEvent(asset_event_category_, Events::ASSET_CANCELED, data_ptr, 0);
 
             // Clean up
+            statistics_.failed_++;
             RemoveFinishedTransfers(error_transfer_data.id, reply->url());
             StartTransferFromQueue();
 
@@ -215,8 +301,8 @@ namespace Asset
             // Fill asset data with reply data
             RexAsset::AssetDataVector& data_vector = checked_static_cast<RexAsset*>(asset_ptr.get())->GetDataInternal();
             QByteArray data_array = reply->readAll();
-            for (int index = 0; index < data_array.count(); ++index)
-                data_vector.push_back(data_array.at(index));
+            data_vector.assign(data_array.constData(), data_array.constData() + data_array.count());
+            RecordFinishedTransfer(transfer, data_array.count());
 
             // Get metadata if available
             QString url_path = tranfer_info.url.path();
@@ -340,49 +426,79 @@ namespace Asset
 
     void QtHttpAssetProvider::ClearAllTransfers()
     {
-        foreach (QtHttpAssetTransfer *transfer, assetid_to_transfer_map_.values())
+        // Clear the queue first, so that aborting the transfers in progress does not start queued ones
+        foreach (QtHttpAssetTransfer *transfer, pending_transfers_.values())
             SAFE_DELETE(transfer);
-        assetid_to_transfer_map_.clear();
+        pending_transfers_.clear();
+        pending_queue_.clear();
 
-        foreach (QtHttpAssetTransfer *transfer, pending_request_queue_)
-            SAFE_DELETE(transfer);
-        pending_request_queue_.clear();
+        foreach (QtHttpAssetTransfer *transfer, assetid_to_transfer_map_.values())
+        {
+            canceled_transfers_.insert(transfer);
+            if (transfer->GetReply())
+                transfer->GetReply()->abort();
+        }
+        assetid_to_transfer_map_.clear();
     }
 
     void QtHttpAssetProvider::StartTransferFromQueue()
     {
-        if (pending_request_queue_.count() == 0)
-            return;
+        while (assetid_to_transfer_map_.count() < max_active_transfers_ && !pending_queue_.empty())
+        {
+            TransferQueue::iterator i = pending_queue_.begin();
+            QtHttpAssetTransfer *transfer = i->second;
+            pending_queue_.erase(i);
+            pending_transfers_.remove(transfer->GetTranferInfo().id);
+            StartTransfer(transfer);
+        }
+    }
 
-        // If the whole map is empty then go and start new MAX_HTTP_CONNECTIONS amount of http gets
-        if (assetid_to_transfer_map_.count() == 0)
-            filling_stack_ = true;
+    void QtHttpAssetProvider::StartTransfer(QtHttpAssetTransfer *transfer)
+    {
+        HttpAssetTransferInfo &info = transfer->GetTranferInfo();
+        assetid_to_transfer_map_[info.id] = transfer;
+
+        transfer->started_time_ = GetCurrentClockTime();
+        f64 queue_wait = GetSeconds(transfer->queued_time_, transfer->started_time_);
+        statistics_.started_++;
+        statistics_.total_queue_wait_ += queue_wait;
+        statistics_.max_queue_wait_ = std::max(statistics_.max_queue_wait_, queue_wait);
+
+        QNetworkReply *reply = network_manager_->get(*transfer);
+        transfer->SetReply(reply);
+        connect(reply, SIGNAL(metaDataChanged()), SLOT(FirstBytesReceived()));
+
+        AssetModule::LogDebug("New HTTP asset request: " + info.id.toStdString() + " type: " + RexTypes::GetAssetTypeString(info.type) +
+            " priority: " + ToString<f32>(transfer->GetPriority()));
+    }
 
-        if (!filling_stack_)
+    void QtHttpAssetProvider::FirstBytesReceived()
+    {
+        QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
+        if (!reply)
+            return;
+        QtHttpAssetTransfer *transfer = dynamic_cast<QtHttpAssetTransfer*>(reply->request().originatingObject());
+        if (!transfer || transfer->first_byte_time_ || canceled_transfers_.contains(transfer))
             return;
 
-        if (assetid_to_transfer_map_.count() <= MAX_HTTP_CONNECTIONS && pending_request_queue_.count() > 0)
-        {
-            if (assetid_to_transfer_map_.count() == MAX_HTTP_CONNECTIONS || pending_request_queue_.count() == 0)
-                filling_stack_ = false; 
-            else
-            {
-                QtHttpAssetTransfer *new_transfer = pending_request_queue_.takeAt(0);
-                assetid_to_transfer_map_[new_transfer->GetTranferInfo().id] = new_transfer;
-                network_manager_->get(*new_transfer);
+        transfer->first_byte_time_ = GetCurrentClockTime();
+        f64 time_to_first_byte = GetSeconds(transfer->started_time_, transfer->first_byte_time_);
+        statistics_.first_byte_count_++;
+        statistics_.total_time_to_first_byte_ += time_to_first_byte;
+        statistics_.max_time_to_first_byte_ = std::max(statistics_.max_time_to_first_byte_, time_to_first_byte);
+    }
 
-                AssetModule::LogDebug("New HTTP asset request from queue: " + new_transfer->GetTranferInfo().id.toStdString() + " type: " + RexTypes::GetAssetTypeString(new_transfer->GetTranferInfo().type));
-                StartTransferFromQueue(); // Recursivly fill the transfer map
-            }
-        }
+    void QtHttpAssetProvider::RecordFinishedTransfer(QtHttpAssetTransfer *transfer, uint bytes)
+    {
+        statistics_.completed_++;
+        statistics_.total_bytes_ += bytes;
+        if (transfer->started_time_)
+            statistics_.total_transfer_time_ += GetSeconds(transfer->started_time_, GetCurrentClockTime());
     }
 
     bool QtHttpAssetProvider::CheckRequestQueue(QString assed_id)
     {
-        foreach (QtHttpAssetTransfer *transfer, pending_request_queue_)
-            if (transfer->GetTranferInfo().id == assed_id)
-                return true;
-        return false;
+        return pending_transfers_.contains(assed_id);
     }
 
     bool QtHttpAssetProvider::IsAcceptableAssetType(const std::string& asset_type)
@@ -10,11 +10,45 @@
 #include <QNetworkAccessManager>
 #include <QObject>
 #include <QMap>
+#include <QHash>
+#include <QSet>
 #include <QPair>
 #include <QUrl>
 
 namespace Asset
 {
+    //! Statistics of HTTP asset transfers
+    struct HttpAssetStatistics
+    {
+        HttpAssetStatistics();
+
+        //! Number of transfers started, completed, failed and canceled
+        uint started_;
+        uint completed_;
+        uint failed_;
+        uint canceled_;
+
+        //! Total and longest time transfers waited in the queue before being started, in seconds
+        f64 total_queue_wait_;
+        f64 max_queue_wait_;
+
+        //! Total and longest time from starting a transfer to receiving the response headers, in seconds
+        uint first_byte_count_;
+        f64 total_time_to_first_byte_;
+        f64 max_time_to_first_byte_;
+
+        //! Total time of completed transfers from starting to finishing, in seconds, and bytes received
+        f64 total_transfer_time_;
+        u64 total_bytes_;
+    };
+
+    //! Downloads assets over HTTP with QNetworkAccessManager
+    /*! Requests wait in a priority queue, so that when many assets are requested at once, the ones relevant to the view
+        are downloaded first. Only a limited number of transfers are handed to QNetworkAccessManager at a time: it opens a
+        few kept-alive connections per host, pipelines requests on them, and serves the rest of its own queue in order,
+        so handing it everything at once would defeat the priorities. A request can be re-prioritized or canceled
+        while queued, and canceled while in progress.
+     */
     class QtHttpAssetProvider : public QObject, public Foundation::AssetProviderInterface
     {
 
@@ -39,16 +73,55 @@ namespace Asset
 
         Foundation::AssetPtr GetIncompleteAsset(const std::string& asset_id, const std::string& asset_type, uint received);
         Foundation::AssetTransferInfoVector GetTransferInfo();
+
+        void SetAssetPriority(const std::string& asset_id, f32 priority);
+        bool CancelAssetRequest(const std::string& asset_id, request_tag_t tag);
+
+        //! Returns transfer statistics
+        const HttpAssetStatistics& GetStatistics() const { return statistics_; }
+
+        //! Returns number of transfers waiting in the queue
+        uint GetNumQueuedTransfers() const { return pending_transfers_.count(); }
+
+        //! Returns number of transfers in progress
+        uint GetNumActiveTransfers() const { return assetid_to_transfer_map_.count(); }
     
     private slots:
         QUrl CreateUrl(QString assed_id);
         void TranferCompleted(QNetworkReply *reply);
+        void FirstBytesReceived();
         void RemoveFinishedTransfers(QString asset_transfer_key, QUrl metadata_transfer_key);
         void StartTransferFromQueue();
 
         bool CheckRequestQueue(QString assed_id);
         bool IsAcceptableAssetType(const std::string& asset_type);
 
+    private:
+        //! Queue order of pending transfers: higher priority first, then in request order
+        struct QueueKey
+        {
+            QueueKey(f32 priority, uint sequence) : priority_(priority), sequence_(sequence) {}
+            bool operator < (const QueueKey& rhs) const
+            {
+                if (priority_ != rhs.priority_)
+                    return priority_ > rhs.priority_;
+                return sequence_ < rhs.sequence_;
+            }
+
+            f32 priority_;
+            uint sequence_;
+        };
+        typedef std::map<QueueKey, QtHttpAssetTransfer *> TransferQueue;
+
+        //! Returns queue key of a pending transfer
+        static QueueKey GetQueueKey(QtHttpAssetTransfer *transfer) { return QueueKey(transfer->GetPriority(), transfer->GetSequence()); }
+
+        //! Hands a transfer to the network access manager
+        void StartTransfer(QtHttpAssetTransfer *transfer);
+
+        //! Records statistics of a finished transfer
+        void RecordFinishedTransfer(QtHttpAssetTransfer *transfer, uint bytes);
+
     private:
         Foundation::Framework *framework_;
         EventManager *event_manager_;
@@ -58,11 +131,25 @@ namespace Asset
         event_category_id_t asset_event_category_;
         f64 asset_timeout_;
 
-        QMap<QString, QtHttpAssetTransfer *> assetid_to_transfer_map_;
+        //! Transfers in progress
+        QHash<QString, QtHttpAssetTransfer *> assetid_to_transfer_map_;
         QMap<QUrl, QPair<HttpAssetTransferInfo, Foundation::AssetPtr> > metadata_to_assetptr_;
-        QList<QtHttpAssetTransfer *> pending_request_queue_;
 
-        bool filling_stack_;
+        //! Transfers waiting to be started, by asset id and in queue order
+        QHash<QString, QtHttpAssetTransfer *> pending_transfers_;
+        TransferQueue pending_queue_;
+
+        //! Canceled transfers whose replies have not finished yet
+        QSet<QtHttpAssetTransfer *> canceled_transfers_;
+
+        //! Sequence number of the next request
+        uint next_sequence_;
+
+        //! Maximum number of transfers in progress at once
+        int max_active_transfers_;
+
+        HttpAssetStatistics statistics_;
+
         bool fake_metadata_fetch_;
         QUrl fake_metadata_url_;
 
@@ -38,7 +38,13 @@ namespace Asset
     QtHttpAssetTransfer::QtHttpAssetTransfer(QUrl asset_url, QString asset_id, asset_type_t asset_type, request_tag_t tag) :
         QObject(0),
         QNetworkRequest(asset_url),
-        transfer_info_(asset_url, asset_id, asset_type)
+        queued_time_(0),
+        started_time_(0),
+        first_byte_time_(0),
+        transfer_info_(asset_url, asset_id, asset_type),
+        priority_(0.0f),
+        sequence_(0),
+        reply_(0)
     {
         transfer_info_.AddTag(tag);
     }
@@ -4,12 +4,15 @@
 #define incl_Asset_QtHttpAssetTransfer_h
 
 #include "RexTypes.h"
+#include "HighPerfClock.h"
 
 #include <QObject>
 #include <QNetworkRequest>
 #include <QUrl>
 #include <QString>
 
+class QNetworkReply;
+
 namespace Asset
 {
     struct HttpAssetTransferInfo
@@ -32,10 +35,30 @@ namespace Asset
 
     public:
         QtHttpAssetTransfer(QUrl asset_url, QString asset_id, asset_type_t asset_type, request_tag_t tag);
-        HttpAssetTransferInfo GetTranferInfo() { return transfer_info_; }
+        HttpAssetTransferInfo &GetTranferInfo() { return transfer_info_; }
+
+        //! Priority in the request queue, higher goes first
+        f32 GetPriority() const { return priority_; }
+        void SetPriority(f32 priority) { priority_ = priority; }
+
+        //! Order of the request, to start transfers of the same priority first come first served
+        uint GetSequence() const { return sequence_; }
+        void SetSequence(uint sequence) { sequence_ = sequence; }
+
+        //! Reply of the transfer once started, null while queued
+        QNetworkReply *GetReply() const { return reply_; }
+        void SetReply(QNetworkReply *reply) { reply_ = reply; }
+
+        //! Times of queueing, starting and receiving the first response bytes, 0 if not yet
+        tick_t queued_time_;
+        tick_t started_time_;
+        tick_t first_byte_time_;
 
     private:
         HttpAssetTransferInfo transfer_info_;
+        f32 priority_;
+        uint sequence_;
+        QNetworkReply *reply_;
 
     };
 }
@@ -8,7 +8,30 @@ namespace Asset
     RexAsset::RexAsset(const std::string& asset_id, const std::string& asset_type) :
         asset_id_(asset_id),
         asset_type_(asset_type),
+        mapped_data_(0),
+        mapped_size_(0),
         age_(0.0)
     {
     }
+
+    RexAsset::AssetDataVector& RexAsset::GetDataInternal()
+    {
+        ResetAge();
+        if (mapped_data_)
+        {
+            data_.assign(mapped_data_, mapped_data_ + mapped_size_);
+            mapped_owner_.reset();
+            mapped_data_ = 0;
+            mapped_size_ = 0;
+        }
+        return data_;
+    }
+
+    void RexAsset::SetMappedData(const boost::shared_ptr<void>& owner, const u8* data, uint size)
+    {
+        AssetDataVector().swap(data_);
+        mapped_owner_ = owner;
+        mapped_data_ = data;
+        mapped_size_ = size;
+    }
 }
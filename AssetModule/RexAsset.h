@@ -32,13 +32,23 @@ namespace Asset
         virtual const std::string& GetType() const { return asset_type_; }
 
         //! returns asset data size
-        virtual uint GetSize() const { return data_.size(); }
+        virtual uint GetSize() const { return mapped_data_ ? mapped_size_ : data_.size(); }
 
         //! returns asset data
-        virtual const u8* GetData() const { ResetAge(); return &data_[0]; }
+        virtual const u8* GetData() const { ResetAge(); return mapped_data_ ? mapped_data_ : &data_[0]; }
 
         //! returns asset data vector, non-const. For internal use
-        AssetDataVector& GetDataInternal() { ResetAge(); return data_; }
+        /*! If the asset refers to mapped data, the data is copied to the vector first.
+         */
+        AssetDataVector& GetDataInternal();
+
+        //! makes the asset refer to data that is owned by someone else, instead of copying it. For internal use
+        /*! Used by the disk cache to return assets directly from memory-mapped cache files.
+            \param owner Keeps the data valid for as long as the asset refers to it
+            \param data Asset data
+            \param size Asset data size
+         */
+        void SetMappedData(const boost::shared_ptr<void>& owner, const u8* data, uint size);
 
         //! returns asset metadata
         virtual Foundation::AssetMetadataInterface* GetMetadata() const { ResetAge(); return (Foundation::AssetMetadataInterface*)&metadata_;}
@@ -62,6 +72,15 @@ namespace Asset
         //! asset data
         AssetDataVector data_;
 
+        //! owner of mapped asset data, null if the data is in data_
+        boost::shared_ptr<void> mapped_owner_;
+
+        //! mapped asset data, null if the data is in data_
+        const u8* mapped_data_;
+
+        //! mapped asset data size
+        uint mapped_size_;
+
         //! asset metadata
         RexAssetMetadata metadata_;
 
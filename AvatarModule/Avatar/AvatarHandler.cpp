@@ -19,6 +19,7 @@
 #include "SceneEvents.h"
 #include "EventManager.h"
 #include "WorldStream.h"
+#include "RealXtend/RexProtocolMessageViews.h"
 #include "RexNetworkUtils.h"
 #include "GenericMessageUtils.h"
 #include "NetworkEvents.h"
@@ -153,22 +154,23 @@ namespace Avatar
 
     bool AvatarHandler::HandleOSNE_ObjectUpdate(ProtocolUtilities::NetworkEventInboundData* data)
     {
-        ProtocolUtilities::NetInMessage &msg = *data->message;
-        msg.ResetReading();
+        ProtocolUtilities::ObjectUpdateView view;
+        if (!view.Parse(*data->message))
+        {
+            AvatarModule::LogError("Malformed ObjectUpdate packet received, ignoring.");
+            return false;
+        }
 
-        uint64_t regionhandle = msg.ReadU64();
-        msg.SkipToNextVariable(); ///\todo Unhandled inbound variable 'TimeDilation'.U16
+        ///\todo Unhandled inbound variable 'TimeDilation'.
+        uint64_t regionhandle = view.RegionData().RegionHandle();
 
         // Variable block: Object Data
-        size_t instance_count = msg.ReadCurrentBlockInstanceCount();
-        for(size_t i = 0; i < instance_count; ++i)
+        for(size_t i = 0; i < view.ObjectDataCount(); ++i)
         {
-            uint32_t localid = msg.ReadU32();
-            msg.SkipToNextVariable();        ///\todo Unhandled inbound variable 'State' U8
-            RexUUID fullid = msg.ReadUUID();
-            msg.SkipToNextVariable();        ///\todo Unhandled inbound variable 'CRC' U#"
-            uint8_t pcode = msg.ReadU8();
-            UNREFERENCED_PARAM(pcode);
+            ///\todo Unhandled inbound variables 'State' and 'CRC'.
+            ProtocolUtilities::ObjectUpdateView::ObjectDataBlock object = view.ObjectData(i);
+            uint32_t localid = object.ID();
+            RexUUID fullid = object.FullID();
             bool existing_avatar = false;
             Scene::EntityPtr entity = GetOrCreateAvatarEntity(localid, fullid, &existing_avatar);
             if (!entity)
@@ -180,22 +182,18 @@ namespace Avatar
             presence->regionHandle = regionhandle;
 
             // Get position from objectdata
-            msg.SkipToFirstVariableByName("ObjectData");
-            size_t bytes_read = 0;
-            const uint8_t *objectdatabytes = msg.ReadBuffer(&bytes_read);
-            if (bytes_read >= 28)
+            ProtocolUtilities::NetBufferRef objectdata = object.ObjectData();
+            if (objectdata.size >= 28)
             {
                 // The data contents:
                 // ofs 16 - pos xyz - 3 x float (3x4 bytes)
-                netpos->position_ = *reinterpret_cast<const Vector3df*>(&objectdatabytes[16]);
+                netpos->position_ = ProtocolUtilities::MessageView::Read<Vector3df>(objectdata.data + 16);
                 netpos->Updated();
             }
 
-            msg.SkipToFirstVariableByName("ParentID");
-            presence->parentId = msg.ReadU32();
+            presence->parentId = object.ParentID();
 
-            msg.SkipToFirstVariableByName("NameValue");
-            QString namevalue = QString::fromUtf8(msg.ReadString().c_str());
+            QString namevalue = QString::fromUtf8(object.NameValue().ToString().c_str());
             NameValueMap map = ParseNameValueMap(namevalue.toStdString());
             presence->setfirstName(QString(map["FirstName"].c_str()));
             presence->setlastName(QString(map["LastName"].c_str()));
@@ -262,8 +260,6 @@ namespace Avatar
             // Handle setting the avatar as child of another object, or possibly being parent itself
             Events::SceneHandleParentData data(localid);
             eventMgr->SendEvent("Avatar", Events::EVENT_HANDLE_AVATAR_PARENT, &data);
-
-            msg.SkipToNextInstanceStart();
         }
         
         return false;
@@ -663,7 +659,7 @@ namespace Avatar
         
         for (unsigned i = 0; i < anims_to_start.size(); ++i)
         {
-            const AnimationDefinition& def = GetAnimationByName(anim_defs, anims_to_start[i]);
+            const AnimationDefinition& def = appearance->GetAnimationByName(anims_to_start[i]);
             QString animname = QString::fromStdString(def.animation_name_);
             
             animctrl->EnableAnimation(animname, def.looped_, def.fadein_);
@@ -676,7 +672,7 @@ namespace Avatar
 
         for (unsigned i = 0; i < anims_to_stop.size(); ++i)
         {
-            const AnimationDefinition& def = GetAnimationByName(anim_defs, anims_to_stop[i]);
+            const AnimationDefinition& def = appearance->GetAnimationByName(anims_to_stop[i]);
             QString animname = QString::fromStdString(def.animation_name_);
             animctrl->DisableAnimation(animname, def.fadeout_);
         }
@@ -695,13 +691,11 @@ namespace Avatar
         if (!animctrl || !netpos || !appearance)
             return;
         
-        const AnimationDefinitionMap& anim_defs = appearance->GetAnimations();
-        
         const EC_AnimationController::AnimationMap& running_anims = animctrl->GetRunningAnimations();
         EC_AnimationController::AnimationMap::const_iterator anim = running_anims.begin();
         while (anim != running_anims.end())
         {
-            const AnimationDefinition& def = GetAnimationByName(anim_defs, anim->first);
+            const AnimationDefinition& def = appearance->GetAnimationByName(anim->first);
             // If animation is velocity-adjusted, adjust animation speed by network position speed (horizontal plane movement only)
             if (def.use_velocity_)
             {
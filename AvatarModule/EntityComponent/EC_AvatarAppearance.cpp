@@ -64,6 +64,15 @@ void EC_AvatarAppearance::SetMasterModifiers(const MasterModifierVector& modifie
 void EC_AvatarAppearance::SetAnimations(const AnimationDefinitionMap& animations)
 {
     animations_ = animations;
+    
+    // If several defines share a name, use the first like GetAnimationByName does
+    animations_by_name_.clear();
+    for (AnimationDefinitionMap::const_iterator i = animations_.begin(); i != animations_.end(); ++i)
+    {
+        QString name = QString::fromStdString(i->second.animation_name_);
+        if (animations_by_name_.find(name) == animations_by_name_.end())
+            animations_by_name_[name] = &i->second;
+    }
 }
 
 void EC_AvatarAppearance::SetAttachments(const AvatarAttachmentVector& attachments)
@@ -169,6 +178,7 @@ void EC_AvatarAppearance::Clear()
     transform_ = identity;
     materials_.clear();
     animations_.clear();
+    animations_by_name_.clear();
     bone_modifiers_.clear();
     morph_modifiers_.clear();
     master_modifiers_.clear();
@@ -188,6 +198,16 @@ const std::string& EC_AvatarAppearance::GetProperty(const std::string& name) con
     else return empty_property;
 }
 
+const AnimationDefinition& EC_AvatarAppearance::GetAnimationByName(const QString& name) const
+{
+    static AnimationDefinition default_def;
+    
+    std::map<QString, const AnimationDefinition*>::const_iterator i = animations_by_name_.find(name);
+    if (i != animations_by_name_.end())
+        return *i->second;
+    return default_def;
+}
+
 bool EC_AvatarAppearance::HasProperty(const std::string& name) const
 {
     if (properties_.find(name) != properties_.end())
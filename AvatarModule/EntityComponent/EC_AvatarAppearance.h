@@ -311,6 +311,10 @@ public:
     const MorphModifierVector& GetMorphModifiers() const { return morph_modifiers_; }
     const MasterModifierVector& GetMasterModifiers() const { return master_modifiers_; }
     const AnimationDefinitionMap& GetAnimations() const { return animations_; }
+    //! Returns the animation define of an animation name, or a default define if not found
+    /*! Faster than the free GetAnimationByName function, as the defines are indexed by name
+     */
+    const AnimationDefinition& GetAnimationByName(const QString& name) const;
     const AvatarAttachmentVector& GetAttachments() const { return attachments_; }
     const AvatarTransform& GetTransform() const { return transform_; }
     bool HasProperty(const std::string& name) const;
@@ -337,6 +341,8 @@ private:
     AvatarMaterialVector materials_;
     //! Animation defines
     AnimationDefinitionMap animations_;
+    //! Animation defines by animation name, pointing into animations_
+    std::map<QString, const AnimationDefinition*> animations_by_name_;
     //! Attachments
     AvatarAttachmentVector attachments_;
     //! Transform
@@ -20,10 +20,20 @@
 #include "WorldStream.h"
 #include "SceneEvents.h"
 #include "SceneManager.h"
+#include "EC_Name.h"
+#include "ComponentManager.h"
+#include "IComponent.h"
 #include "NetworkEvents.h"
 #include "RealXtend/RexProtocolMsgIDs.h"
 #include "NetworkMessages/NetInMessage.h"
 #include "NetworkMessages/NetMessageManager.h"
+#include "NetworkMessages/SequenceNumberWindow.h"
+#include "Interfaces/INetMessageListener.h"
+#include "PacketCapture.h"
+#include "ZeroCode.h"
+#include "ProtocolModuleOpenSim.h"
+#include "NetworkConnection.h"
+#include "HighPerfClock.h"
 #include "Renderer.h"
 #include "ResourceHandler.h"
 #include "OgreTextureResource.h"
@@ -31,8 +41,11 @@
 #include "UiProxyWidget.h"
 #include "EC_OpenSimPresence.h"
 #include "Console.h"
+#include "LockFreeMultiProducerQueue.h"
 
 #include <utility>
+#include <sstream>
+#include <cstdio>
 #include <QDebug>
 
 #ifdef Q_WS_WIN
@@ -119,6 +132,53 @@ void DebugStatsModule::PostInitialize()
         "Invokes action execution in entity",
         Console::Bind(this, &DebugStatsModule::Exec)));
 
+    RegisterConsoleCommand(Console::CreateCommand("netstats",
+        "Prints the internal counters of the UDP message manager.",
+        Console::Bind(this, &DebugStatsModule::PrintNetworkStats)));
+
+    RegisterConsoleCommand(Console::CreateCommand("netbench",
+        "Compares UDP packets/s and syscalls/frame over loopback with and without batched socket I/O. "
+        "Usage: \"netbench(frames, packetsPerFrame, batchSize)\"",
+        Console::Bind(this, &DebugStatsModule::RunNetworkLoopbackBenchmark)));
+
+    RegisterConsoleCommand(Console::CreateCommand("netseqcheck",
+        "Replays out-of-order, duplicate and wraparound sequence numbers through the inbound duplicate detection, "
+        "both directly and as datagrams through the message manager, and checks the results.",
+        Console::Bind(this, &DebugStatsModule::CheckSequenceNumberWindow)));
+
+    RegisterConsoleCommand(Console::CreateCommand("netcapture",
+        "Starts capturing the inbound UDP traffic to a file, or stops capturing if no file is given. Usage: \"netcapture(filename)\"",
+        Console::Bind(this, &DebugStatsModule::CaptureNetworkTraffic)));
+
+    RegisterConsoleCommand(Console::CreateCommand("netreplay",
+        "Replays a UDP traffic capture in place of a server, as fast as possible or at the original pace. "
+        "Usage: \"netreplay(filename, realtime)\"",
+        Console::Bind(this, &DebugStatsModule::ReplayNetworkTraffic)));
+
+    RegisterConsoleCommand(Console::CreateCommand("zerocodebench",
+        "Measures zero-decoding the zero-coded messages in a UDP traffic capture, two-pass versus single-pass. "
+        "Usage: \"zerocodebench(filename, rounds)\"",
+        Console::Bind(this, &DebugStatsModule::RunZeroCodeBenchmark)));
+
+    RegisterConsoleCommand(Console::CreateCommand("zerocodefuzz",
+        "Checks the single-pass zero-coding against the scalar implementation with random data. Usage: \"zerocodefuzz(iterations)\"",
+        Console::Bind(this, &DebugStatsModule::FuzzZeroCode)));
+
+    RegisterConsoleCommand(Console::CreateCommand("delayedeventbench",
+        "Posts delayed events from several threads at once, comparing the lock-free intake to a mutex and timing the delivery. "
+        "Usage: \"delayedeventbench(producers, eventsPerProducer)\"",
+        Console::Bind(this, &DebugStatsModule::RunDelayedEventBenchmark)));
+
+    RegisterConsoleCommand(Console::CreateCommand("componentindexbench",
+        "Compares component lookups by type name scan, by indexed type name and by type id, and scene queries by full walk "
+        "and by the component type index, in a temporary scene. Usage: \"componentindexbench(entities, rounds)\"",
+        Console::Bind(this, &DebugStatsModule::RunComponentIndexBenchmark)));
+
+    RegisterConsoleCommand(Console::CreateCommand("entitynamebench",
+        "Compares looking entities up by name by walking the scene and through the name index, and times prefix, regexp "
+        "and rename handling, in a temporary scene. Usage: \"entitynamebench(entities, lookups)\"",
+        Console::Bind(this, &DebugStatsModule::RunEntityNameBenchmark)));
+
     frameworkEventCategory_ = framework_->GetEventManager()->QueryEventCategory("Framework");
 
 
@@ -397,6 +457,903 @@ Console::CommandResult DebugStatsModule::RequestGodMode(const StringVector &para
     return Console::ResultSuccess();
 }
 
+Console::CommandResult DebugStatsModule::PrintNetworkStats(const StringVector &params)
+{
+    if (!current_world_stream_)
+        return Console::ResultFailure("Not connected to server.");
+
+    ProtocolUtilities::NetMessageManager *messageManager = current_world_stream_->GetCurrentProtocolModule()->GetNetworkMessageManager();
+    if (!messageManager)
+        return Console::ResultFailure("No network message manager.");
+
+    std::stringstream ss;
+    ss << "Threaded: " << (messageManager->IsThreadedMode() ? "yes" : "no") << std::endl;
+    ss << "Unacked reliable packets: " << messageManager->NumUnackedReliablePackets()
+       << " (" << messageManager->NumBytesInUnackedReliablePackets() << " bytes)" << std::endl;
+    ss << "Oldest unacked packet: " << messageManager->OldestUnackedSequenceNumber() << std::endl;
+    ss << "Resent packets: " << messageManager->NumResentPackets()
+       << ", given up without ack: " << messageManager->NumDroppedReliablePackets() << std::endl;
+    ss << "Duplicate packets dropped: " << messageManager->NumDuplicatesReceived()
+       << ", estimated lost: " << messageManager->NumLostPacketsEstimate() << std::endl;
+    ss << "Round-trip time: " << messageManager->smoothenedRoundTripTime << " ms (deviation "
+       << messageManager->roundTripTimeVariance << " ms), retransmit timeout " << messageManager->RetransmitTimeout() << " ms" << std::endl;
+    ss << "Inbound path heap allocations: " << messageManager->NumInboundHeapAllocations() << std::endl;
+    ss << "Socket system calls: " << messageManager->NumSocketSyscalls() << std::endl;
+    if (messageManager->IsCapturing())
+        ss << "Captured datagrams: " << messageManager->NumCapturedDatagrams() << std::endl;
+    ss << "Replay finished: " << (messageManager->ReplayFinished() ? "yes" : "no");
+    return Console::ResultSuccess(ss.str());
+}
+
+Console::CommandResult DebugStatsModule::RunNetworkLoopbackBenchmark(const StringVector &params)
+{
+    const int numFrames = params.size() > 0 ? std::max(1, atoi(params[0].c_str())) : 200;
+    const int packetsPerFrame = params.size() > 1 ? std::max(1, atoi(params[1].c_str())) : 64;
+    const size_t batchSize = params.size() > 2 ? (size_t)std::max(1, atoi(params[2].c_str())) : 32;
+
+    // A typical small object update sized packet.
+    std::vector<uint8_t> packet(200, 0xAB);
+
+    const size_t cBufferSize = 2048;
+    std::vector<uint8_t> storage(batchSize * cBufferSize);
+    std::vector<uint8_t*> buffers(batchSize);
+    std::vector<size_t> sizes(batchSize);
+    for(size_t i = 0; i < batchSize; ++i)
+        buffers[i] = &storage[i * cBufferSize];
+
+    std::stringstream ss;
+    for(int mode = 0; mode < 2; ++mode)
+    {
+        const bool batched = (mode == 1);
+        try
+        {
+            ProtocolUtilities::NetworkConnection receiver(0);
+            ProtocolUtilities::NetworkConnection sender("127.0.0.1", receiver.LocalPort());
+            receiver.SetBatchSize(batched ? batchSize : 0);
+            sender.SetBatchSize(batched ? batchSize : 0);
+
+            size_t numReceived = 0;
+            const tick_t startTime = GetCurrentClockTime();
+            for(int frame = 0; frame < numFrames; ++frame)
+            {
+                for(int i = 0; i < packetsPerFrame; ++i)
+                    sender.QueueBytes(&packet[0], packet.size());
+                sender.FlushSendQueue();
+
+                // Drain the socket the same way NetMessageManager does once per frame.
+                for(;;)
+                {
+                    size_t count = receiver.ReceiveBatch(&buffers[0], cBufferSize, &sizes[0], batchSize);
+                    numReceived += count;
+                    if (count < batchSize)
+                        break;
+                }
+            }
+            const double seconds = (double)(GetCurrentClockTime() - startTime) / GetCurrentClockFreq();
+
+            ss << (batched ? "Batched:   " : "Unbatched: ") << numReceived << "/" << numFrames * packetsPerFrame << " packets, "
+               << (seconds > 0.0 ? numReceived / seconds : 0.0) << " packets/s, "
+               << (double)(sender.NumSyscalls() + receiver.NumSyscalls()) / numFrames << " syscalls/frame" << std::endl;
+        }
+        catch(Poco::Exception &e)
+        {
+            return Console::ResultFailure("Loopback benchmark failed: " + e.displayText());
+        }
+    }
+
+    return Console::ResultSuccess(ss.str());
+}
+
+namespace
+{
+    using ProtocolUtilities::SequenceNumberWindow;
+
+    /// An inbound sequence number and what the duplicate detection is expected to make of it.
+    struct RecordedSequenceNumber
+    {
+        uint32_t seqNum;
+        SequenceNumberWindow::InsertResult expected;
+    };
+
+    /// Recorded inbound sequences. Each begins with a fresh window.
+    const RecordedSequenceNumber cInOrder[] = { {1, SequenceNumberWindow::SeqNew}, {2, SequenceNumberWindow::SeqNew},
+        {3, SequenceNumberWindow::SeqNew}, {4, SequenceNumberWindow::SeqNew} };
+    const RecordedSequenceNumber cOutOfOrder[] = { {10, SequenceNumberWindow::SeqNew}, {13, SequenceNumberWindow::SeqNew},
+        {11, SequenceNumberWindow::SeqNew}, {12, SequenceNumberWindow::SeqNew}, {9, SequenceNumberWindow::SeqNew},
+        {14, SequenceNumberWindow::SeqNew} };
+    const RecordedSequenceNumber cDuplicates[] = { {100, SequenceNumberWindow::SeqNew}, {101, SequenceNumberWindow::SeqNew},
+        {100, SequenceNumberWindow::SeqDuplicate}, {103, SequenceNumberWindow::SeqNew}, {101, SequenceNumberWindow::SeqDuplicate},
+        {102, SequenceNumberWindow::SeqNew}, {102, SequenceNumberWindow::SeqDuplicate}, {103, SequenceNumberWindow::SeqDuplicate} };
+    const RecordedSequenceNumber cWindowSlide[] = { {1, SequenceNumberWindow::SeqNew}, {3, SequenceNumberWindow::SeqNew},
+        {5000, SequenceNumberWindow::SeqNew}, {2, SequenceNumberWindow::SeqTooOld}, {3, SequenceNumberWindow::SeqTooOld},
+        {4000, SequenceNumberWindow::SeqNew}, {4000, SequenceNumberWindow::SeqDuplicate}, {5000, SequenceNumberWindow::SeqDuplicate} };
+    const RecordedSequenceNumber cWrap32[] = { {0xFFFFFFFD, SequenceNumberWindow::SeqNew}, {0xFFFFFFFF, SequenceNumberWindow::SeqNew},
+        {0, SequenceNumberWindow::SeqNew}, {0xFFFFFFFE, SequenceNumberWindow::SeqNew}, {1, SequenceNumberWindow::SeqNew},
+        {0xFFFFFFFF, SequenceNumberWindow::SeqDuplicate}, {0, SequenceNumberWindow::SeqDuplicate} };
+    const RecordedSequenceNumber cWrap24[] = { {0xFFFFFE, SequenceNumberWindow::SeqNew}, {0xFFFFFF, SequenceNumberWindow::SeqNew},
+        {1, SequenceNumberWindow::SeqNew}, {2, SequenceNumberWindow::SeqNew}, {1, SequenceNumberWindow::SeqDuplicate} };
+
+    /// Replays a recorded sequence through a fresh window.
+    /// @return The number of mismatches. Each mismatch is described in ss.
+    int ReplaySequenceNumbers(const char *name, const RecordedSequenceNumber *sequence, size_t count, std::stringstream &ss)
+    {
+        SequenceNumberWindow window;
+        int numFailures = 0;
+        for(size_t i = 0; i < count; ++i)
+        {
+            SequenceNumberWindow::InsertResult result = window.Insert(sequence[i].seqNum);
+            if (result != sequence[i].expected)
+            {
+                ss << name << ": sequence number " << sequence[i].seqNum << " at " << i << " gave " << result
+                   << ", expected " << sequence[i].expected << std::endl;
+                ++numFailures;
+            }
+        }
+        return numFailures;
+    }
+
+    /// Records the sequence numbers of the messages the message manager passes on to the application.
+    class SequenceNumberRecorder : public ProtocolUtilities::INetMessageListener
+    {
+    public:
+        virtual void OnNetworkMessageReceived(ProtocolUtilities::NetMsgID msgID, ProtocolUtilities::NetInMessage *msg)
+        {
+            received.push_back(msg->GetSequenceNumber());
+        }
+
+        std::vector<uint32_t> received;
+    };
+
+    /// Replays a recorded sequence as datagrams through the whole inbound path of a fresh message manager, from a packet capture.
+    /// The datagrams are unreliable AddCircuitCode messages, which the manager passes on to the listener as they are.
+    /// @return The number of mismatches. Each mismatch is described in ss.
+    int ReplayDatagrams(const char *name, const RecordedSequenceNumber *sequence, size_t count, std::stringstream &ss)
+    {
+        const char *captureFile = "netseqcheck.rxpcap";
+
+        // Header: flags, sequence number, extra header size. Body: the Low frequency message number and the CircuitCode block.
+        std::vector<uint8_t> datagram(6 + 4 + 36, 0);
+        datagram[6] = 0xFF;
+        datagram[7] = 0xFF;
+        datagram[8] = 0x00;
+        datagram[9] = 0x02;
+        {
+            ProtocolUtilities::PacketCaptureWriter writer(captureFile);
+            for(size_t i = 0; i < count; ++i)
+            {
+                const uint32_t seqNum = sequence[i].seqNum;
+                datagram[1] = (uint8_t)(seqNum >> 24);
+                datagram[2] = (uint8_t)(seqNum >> 16);
+                datagram[3] = (uint8_t)(seqNum >> 8);
+                datagram[4] = (uint8_t)seqNum;
+                writer.Write(&datagram[0], datagram.size());
+            }
+        }
+
+        SequenceNumberRecorder recorder;
+        ProtocolUtilities::NetMessageManager manager("./data/message_template.msg");
+        manager.RegisterNetworkListener(&recorder);
+        if (!manager.ConnectToReplay(captureFile, false))
+        {
+            std::remove(captureFile);
+            ss << name << ": could not replay the datagrams" << std::endl;
+            return 1;
+        }
+        for(int i = 0; i < 100 && !manager.ReplayFinished(); ++i)
+            manager.ProcessMessages();
+        manager.Disconnect();
+        manager.UnregisterNetworkListener(&recorder);
+        std::remove(captureFile);
+
+        // Duplicates are dropped, everything else is passed on in the order received.
+        std::vector<uint32_t> expected;
+        for(size_t i = 0; i < count; ++i)
+            if (sequence[i].expected != SequenceNumberWindow::SeqDuplicate)
+                expected.push_back(sequence[i].seqNum);
+
+        if (recorder.received != expected)
+        {
+            ss << name << ": " << recorder.received.size() << " datagrams passed on, expected " << expected.size() << ":";
+            for(size_t i = 0; i < expected.size(); ++i)
+                ss << " " << expected[i];
+            ss << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+}
+
+Console::CommandResult DebugStatsModule::CheckSequenceNumberWindow(const StringVector &params)
+{
+#define REPLAY(sequence) ReplaySequenceNumbers(#sequence, sequence, sizeof(sequence) / sizeof(sequence[0]), ss)
+    std::stringstream ss;
+    int numFailures = REPLAY(cInOrder) + REPLAY(cOutOfOrder) + REPLAY(cDuplicates) + REPLAY(cWindowSlide) + REPLAY(cWrap32) + REPLAY(cWrap24);
+#undef REPLAY
+
+    // The same sequences as real datagrams through NetMessageManager::HandleInboundBytes.
+#define REPLAY(sequence) ReplayDatagrams(#sequence, sequence, sizeof(sequence) / sizeof(sequence[0]), ss)
+    try
+    {
+        numFailures += REPLAY(cInOrder) + REPLAY(cOutOfOrder) + REPLAY(cDuplicates) + REPLAY(cWindowSlide) + REPLAY(cWrap32) + REPLAY(cWrap24);
+    }
+    catch(const Exception &e)
+    {
+        ss << "Replaying datagrams failed: " << e.what() << std::endl;
+        ++numFailures;
+    }
+#undef REPLAY
+
+    // A single forged sequence number far ahead doesn't count the numbers it jumped over as lost, a real gap does
+    // once the traffic carries on after it.
+    SequenceNumberWindow forged;
+    forged.Insert(1);
+    forged.Insert(2);
+    forged.Insert(1000000);
+    forged.Insert(3);
+    forged.Insert(4);
+    SequenceNumberWindow gap;
+    gap.Insert(1);
+    gap.Insert(5001);
+    const size_t gapLostBeforeConfirm = gap.NumLost();
+    gap.Insert(5002);
+    // 2 up to the sequence numbers that have slid out of the window.
+    const size_t expectedGapLost = 5002 - gap.Size() - 1;
+    if (forged.NumLost() != 0 || gapLostBeforeConfirm != 0 || gap.NumLost() != expectedGapLost)
+    {
+        ss << "Forward jumps: " << forged.NumLost() << " lost after a forged jump, " << gapLostBeforeConfirm << " and "
+           << gap.NumLost() << " lost before and after a real gap, expected 0, 0 and " << expectedGapLost << std::endl;
+        ++numFailures;
+    }
+
+    // A long session with every tenth packet duplicated and every hundredth lost. The memory use stays constant.
+    SequenceNumberWindow window;
+    const uint32_t cNumPackets = 1000000;
+    size_t numNew = 0;
+    const tick_t startTime = GetCurrentClockTime();
+    for(uint32_t seqNum = 1; seqNum <= cNumPackets; ++seqNum)
+    {
+        if (seqNum % 100 == 0)
+            continue;
+        if (window.Insert(seqNum) == SequenceNumberWindow::SeqNew)
+            ++numNew;
+        if (seqNum % 10 == 0)
+            window.Insert(seqNum - 5);
+    }
+    const double seconds = (double)(GetCurrentClockTime() - startTime) / GetCurrentClockFreq();
+    // The lost packets still in the window are not counted yet.
+    const size_t expectedNew = cNumPackets - cNumPackets / 100;
+    const size_t expectedDuplicates = cNumPackets / 10 - cNumPackets / 100;
+    const size_t expectedLost = (cNumPackets - window.Size()) / 100;
+    if (numNew != expectedNew || window.NumDuplicates() != expectedDuplicates || window.NumLost() != expectedLost)
+    {
+        ss << "Long session: " << numNew << " new, " << window.NumDuplicates() << " duplicates, " << window.NumLost()
+           << " lost, expected " << expectedNew << ", " << expectedDuplicates << ", " << expectedLost << std::endl;
+        ++numFailures;
+    }
+    ss << "Long session: " << (seconds > 0.0 ? cNumPackets / seconds : 0.0) << " inserts/s, window of " << window.Size() << " bits" << std::endl;
+
+    if (numFailures > 0)
+        return Console::ResultFailure(ss.str());
+    return Console::ResultSuccess(ss.str() + "All sequences passed.");
+}
+
+Console::CommandResult DebugStatsModule::CaptureNetworkTraffic(const StringVector &params)
+{
+    if (!current_world_stream_)
+        return Console::ResultFailure("Not connected to server.");
+
+    ProtocolUtilities::NetMessageManager *messageManager = current_world_stream_->GetCurrentProtocolModule()->GetNetworkMessageManager();
+    if (!messageManager)
+        return Console::ResultFailure("No network message manager.");
+
+    if (params.empty())
+    {
+        std::stringstream ss;
+        ss << "Capture stopped after " << messageManager->NumCapturedDatagrams() << " datagrams.";
+        messageManager->StopCapture();
+        return Console::ResultSuccess(ss.str());
+    }
+
+    if (!messageManager->StartCapture(params[0]))
+        return Console::ResultFailure("Could not open " + params[0] + " for writing.");
+    return Console::ResultSuccess("Capturing inbound UDP traffic to " + params[0] + ".");
+}
+
+Console::CommandResult DebugStatsModule::ReplayNetworkTraffic(const StringVector &params)
+{
+    if (params.empty())
+        return Console::ResultFailure("Usage: \"netreplay(filename, realtime)\"");
+
+    boost::shared_ptr<OpenSimProtocol::ProtocolModuleOpenSim> protocolModule =
+        framework_->GetModuleManager()->GetModule<OpenSimProtocol::ProtocolModuleOpenSim>().lock();
+    if (!protocolModule)
+        return Console::ResultFailure("OpenSim protocol module not loaded.");
+
+    const bool realTimePacing = params.size() > 1 && atoi(params[1].c_str()) != 0;
+    if (!protocolModule->CreateReplayConnection(params[0], realTimePacing))
+        return Console::ResultFailure("Could not replay " + params[0] + ".");
+    return Console::ResultSuccess("Replaying " + params[0] + (realTimePacing ? " at the original pace." : " as fast as possible."));
+}
+
+Console::CommandResult DebugStatsModule::RunZeroCodeBenchmark(const StringVector &params)
+{
+    if (params.empty())
+        return Console::ResultFailure("Usage: \"zerocodebench(filename, rounds)\"");
+    const int numRounds = params.size() > 1 ? std::max(atoi(params[1].c_str()), 1) : 100;
+
+    // Collect the zero-coded message bodies of the captured datagrams.
+    std::vector<std::vector<uint8_t> > bodies;
+    try
+    {
+        ProtocolUtilities::PacketCaptureReader reader(params[0]);
+        uint64_t timestamp;
+        const uint8_t *data;
+        size_t numBytes;
+        while(reader.Next(timestamp, data, numBytes))
+        {
+            if (numBytes < 6 || !(data[0] & ProtocolUtilities::NetFlagZeroCode))
+                continue;
+            size_t begin = 6 + data[5];
+            size_t end = numBytes;
+            if (data[0] & ProtocolUtilities::NetFlagAck)
+                end -= std::min<size_t>(end, 1 + data[numBytes-1] * 4);
+            if (begin < end)
+                bodies.push_back(std::vector<uint8_t>(data + begin, data + end));
+        }
+    }
+    catch(const Exception &e)
+    {
+        return Console::ResultFailure(e.what());
+    }
+    if (bodies.empty())
+        return Console::ResultFailure("No zero-coded datagrams in " + params[0] + ".");
+
+    std::vector<uint8_t> decoded(16384);
+    size_t twoPassBytes = 0;
+    tick_t startTime = GetCurrentClockTime();
+    for(int round = 0; round < numRounds; ++round)
+        for(size_t i = 0; i < bodies.size(); ++i)
+        {
+            size_t length = ProtocolUtilities::CountZeroDecodedLength(&bodies[i][0], bodies[i].size());
+            if (length > 0 && length <= decoded.size() && ProtocolUtilities::ZeroDecode(&decoded[0], length, &bodies[i][0], bodies[i].size()))
+                twoPassBytes += length;
+        }
+    const double twoPassSeconds = (double)(GetCurrentClockTime() - startTime) / GetCurrentClockFreq();
+
+    size_t singlePassBytes = 0;
+    startTime = GetCurrentClockTime();
+    for(int round = 0; round < numRounds; ++round)
+        for(size_t i = 0; i < bodies.size(); ++i)
+        {
+            size_t length = ProtocolUtilities::ZeroDecodeToBuffer(&decoded[0], decoded.size(), &bodies[i][0], bodies[i].size());
+            if (length <= decoded.size())
+                singlePassBytes += length;
+        }
+    const double singlePassSeconds = (double)(GetCurrentClockTime() - startTime) / GetCurrentClockFreq();
+
+    std::stringstream ss;
+    ss << bodies.size() << " zero-coded messages, " << numRounds << " rounds" << std::endl
+       << "Two-pass:    " << (twoPassSeconds > 0.0 ? twoPassBytes / twoPassSeconds / (1024.0 * 1024.0) : 0.0) << " MB/s decoded" << std::endl
+       << "Single-pass: " << (singlePassSeconds > 0.0 ? singlePassBytes / singlePassSeconds / (1024.0 * 1024.0) : 0.0) << " MB/s decoded" << std::endl;
+    if (twoPassBytes != singlePassBytes)
+        return Console::ResultFailure(ss.str() + "The decoded sizes differ!");
+    return Console::ResultSuccess(ss.str());
+}
+
+Console::CommandResult DebugStatsModule::FuzzZeroCode(const StringVector &params)
+{
+    using namespace ProtocolUtilities;
+
+    const int numIterations = params.size() > 0 ? std::max(atoi(params[0].c_str()), 1) : 100000;
+    srand(numIterations);
+
+    std::stringstream ss;
+    int numFailures = 0;
+    for(int i = 0; i < numIterations && numFailures < 10; ++i)
+    {
+        // Random data with a varying density of zeroes, sometimes with runs longer than one length byte can hold.
+        std::vector<uint8_t> data(1 + rand() % 1500);
+        const int zeroPercentage = rand() % 100;
+        for(size_t j = 0; j < data.size(); ++j)
+            data[j] = (rand() % 100 < zeroPercentage) ? 0 : (uint8_t)(1 + rand() % 255);
+        if (data.size() > 600 && rand() % 4 == 0)
+            std::fill(data.begin() + 100, data.begin() + 400, 0);
+
+        // Encoding must give the same bytes as the scalar encoder, and nothing if the buffer is one byte short.
+        const size_t encodedLength = CountZeroEncodedLength(&data[0], data.size());
+        std::vector<uint8_t> scalar(encodedLength + 1);
+        std::vector<uint8_t> encoded(encodedLength + 1);
+        const bool scalarSuccess = ZeroEncode(&scalar[0], encodedLength, &data[0], data.size());
+        if (!scalarSuccess || ZeroEncodeToBuffer(&encoded[0], encodedLength, &data[0], data.size()) != encodedLength ||
+            memcmp(&scalar[0], &encoded[0], encodedLength) != 0 ||
+            (encodedLength > 0 && ZeroEncodeToBuffer(&encoded[0], encodedLength - 1, &data[0], data.size()) != 0))
+        {
+            ss << "Iteration " << i << ": encoding " << data.size() << " bytes differs from the scalar encoder." << std::endl;
+            ++numFailures;
+            continue;
+        }
+
+        // Decoding must give back the original data.
+        std::vector<uint8_t> decoded(data.size());
+        if (ZeroDecodeToBuffer(&decoded[0], decoded.size(), &encoded[0], encodedLength) != data.size() || decoded != data)
+        {
+            ss << "Iteration " << i << ": decoding " << encodedLength << " bytes does not give back the original data." << std::endl;
+            ++numFailures;
+            continue;
+        }
+
+        // Corrupted input must be rejected, or decoded the same way as the scalar decoder does.
+        encoded[rand() % encodedLength] = (rand() % 3 == 0) ? 0 : (uint8_t)rand();
+        const size_t scalarLength = CountZeroDecodedLength(&encoded[0], encodedLength);
+        if (ZeroDecodeToBuffer(0, 0, &encoded[0], encodedLength) != scalarLength)
+        {
+            ss << "Iteration " << i << ": corrupted input decodes to a different length than with the scalar decoder." << std::endl;
+            ++numFailures;
+            continue;
+        }
+        if (scalarLength > 0)
+        {
+            std::vector<uint8_t> scalarDecoded(scalarLength);
+            decoded.resize(scalarLength);
+            ZeroDecode(&scalarDecoded[0], scalarLength, &encoded[0], encodedLength);
+            ZeroDecodeToBuffer(&decoded[0], decoded.size(), &encoded[0], encodedLength);
+            if (decoded != scalarDecoded)
+            {
+                ss << "Iteration " << i << ": corrupted input decodes differently than with the scalar decoder." << std::endl;
+                ++numFailures;
+            }
+        }
+    }
+
+    if (numFailures > 0)
+        return Console::ResultFailure(ss.str());
+    ss << numIterations << " iterations passed.";
+    return Console::ResultSuccess(ss.str());
+}
+
+namespace
+{
+    /// An item posted by a benchmark producer thread: the producer number and the item number.
+    typedef std::pair<int, int> ProducedItem;
+
+    /// Pushes numbered items to a lock-free queue.
+    struct LockFreeProducer
+    {
+        LockFreeMultiProducerQueue<ProducedItem> *queue;
+        int id;
+        int count;
+
+        void operator()() const
+        {
+            for(int i = 0; i < count; ++i)
+                queue->Push(std::make_pair(id, i));
+        }
+    };
+
+    /// Pushes numbered items to a vector guarded with a mutex, the way delayed events used to be taken in.
+    struct LockedProducer
+    {
+        Mutex *mutex;
+        std::vector<ProducedItem> *items;
+        int id;
+        int count;
+
+        void operator()() const
+        {
+            for(int i = 0; i < count; ++i)
+            {
+                MutexLock lock(*mutex);
+                items->push_back(std::make_pair(id, i));
+            }
+        }
+    };
+
+    /// Event data that counts the events that have been delivered and let go of.
+    class DeliveryCountingEventData : public IEventData
+    {
+    public:
+        explicit DeliveryCountingEventData(QAtomicInt *delivered) : delivered_(delivered) {}
+        ~DeliveryCountingEventData() { delivered_->ref(); }
+    private:
+        QAtomicInt *delivered_;
+    };
+
+    /// Sends delayed events with delays of 0 to 99 milliseconds.
+    struct DelayedEventProducer
+    {
+        EventManager *eventManager;
+        event_category_id_t category;
+        QAtomicInt *delivered;
+        QAtomicInt *finished;
+        int count;
+
+        void operator()() const
+        {
+            for(int i = 0; i < count; ++i)
+                eventManager->SendDelayedEvent(category, 1, EventDataPtr(new DeliveryCountingEventData(delivered)), (i % 100) * 0.001);
+            finished->ref();
+        }
+    };
+}
+
+Console::CommandResult DebugStatsModule::RunDelayedEventBenchmark(const StringVector &params)
+{
+    const int numProducers = params.size() > 0 ? std::max(atoi(params[0].c_str()), 1) : 4;
+    const int numPerProducer = params.size() > 1 ? std::max(atoi(params[1].c_str()), 1) : 100000;
+    const int numTotal = numProducers * numPerProducer;
+    std::stringstream ss;
+
+    // Intake, lock-free: the main thread keeps taking items while the producers push.
+    LockFreeMultiProducerQueue<ProducedItem> queue;
+    std::vector<ProducedItem> received;
+    received.reserve(numTotal);
+    tick_t startTime = GetCurrentClockTime();
+    {
+        boost::thread_group producers;
+        for(int i = 0; i < numProducers; ++i)
+        {
+            LockFreeProducer producer = { &queue, i, numPerProducer };
+            producers.create_thread(producer);
+        }
+        while(received.size() < (size_t)numTotal)
+            queue.PopAll(received);
+        producers.join_all();
+    }
+    const double lockFreeSeconds = (double)(GetCurrentClockTime() - startTime) / GetCurrentClockFreq();
+
+    // Each producer's items must arrive once and in order.
+    std::vector<int> nextExpected(numProducers, 0);
+    for(size_t i = 0; i < received.size(); ++i)
+        if (received[i].first < 0 || received[i].first >= numProducers || received[i].second != nextExpected[received[i].first]++)
+            return Console::ResultFailure("Lock-free intake delivered an item out of order or twice.");
+
+    // Intake, mutex.
+    Mutex mutex;
+    std::vector<ProducedItem> lockedItems;
+    std::vector<ProducedItem> taken;
+    size_t numTaken = 0;
+    startTime = GetCurrentClockTime();
+    {
+        boost::thread_group producers;
+        for(int i = 0; i < numProducers; ++i)
+        {
+            LockedProducer producer = { &mutex, &lockedItems, i, numPerProducer };
+            producers.create_thread(producer);
+        }
+        while(numTaken < (size_t)numTotal)
+        {
+            {
+                MutexLock lock(mutex);
+                taken.swap(lockedItems);
+            }
+            numTaken += taken.size();
+            taken.clear();
+        }
+        producers.join_all();
+    }
+    const double mutexSeconds = (double)(GetCurrentClockTime() - startTime) / GetCurrentClockFreq();
+
+    // Delivery through an event manager of our own, so that the modules are not flooded with events.
+    // The main thread runs 60 fps frames while the producers send, until every event has been delivered.
+    EventManager eventManager(framework_);
+    const event_category_id_t category = eventManager.RegisterEventCategory("DelayedEventBenchmark");
+    QAtomicInt delivered(0);
+    QAtomicInt finished(0);
+    const f64 frametime = 1.0 / 60.0;
+    const int maxFramesAfterSending = 100;
+    int numFrames = 0;
+    int numFramesAfterSending = 0;
+    double processSeconds = 0.0;
+    double maxFrameSeconds = 0.0;
+    {
+        boost::thread_group producers;
+        for(int i = 0; i < numProducers; ++i)
+        {
+            DelayedEventProducer producer = { &eventManager, category, &delivered, &finished, numPerProducer };
+            producers.create_thread(producer);
+        }
+        while((int)delivered < numTotal && numFramesAfterSending < maxFramesAfterSending)
+        {
+            if ((int)finished == numProducers)
+                ++numFramesAfterSending;
+            startTime = GetCurrentClockTime();
+            eventManager.ProcessDelayedEvents(frametime);
+            const double frameSeconds = (double)(GetCurrentClockTime() - startTime) / GetCurrentClockFreq();
+            processSeconds += frameSeconds;
+            maxFrameSeconds = std::max(maxFrameSeconds, frameSeconds);
+            ++numFrames;
+        }
+        producers.join_all();
+    }
+    const int numDelivered = (int)delivered;
+    eventManager.ClearDelayedEvents();
+    if (numDelivered != numTotal)
+    {
+        ss << "Only " << numDelivered << " of " << numTotal << " delayed events were delivered.";
+        return Console::ResultFailure(ss.str());
+    }
+
+    ss << numProducers << " producers, " << numPerProducer << " items each" << std::endl
+       << "Lock-free intake: " << (lockFreeSeconds > 0.0 ? numTotal / lockFreeSeconds : 0.0) << " items/s" << std::endl
+       << "Mutex intake:     " << (mutexSeconds > 0.0 ? numTotal / mutexSeconds : 0.0) << " items/s" << std::endl
+       << "Delayed events delivered in " << numFrames << " frames, ProcessDelayedEvents average "
+       << processSeconds * 1000.0 / numFrames << " ms, max " << maxFrameSeconds * 1000.0 << " ms" << std::endl;
+    return Console::ResultSuccess(ss.str());
+}
+
+namespace
+{
+    /// Component without attributes, with a type name given at runtime, for the component index benchmark.
+    class BenchmarkComponent : public IComponent
+    {
+    public:
+        BenchmarkComponent(Foundation::Framework *framework, const QString &typeName) : IComponent(framework), typeName_(typeName) {}
+        virtual const QString &TypeName() const { return typeName_; }
+
+    private:
+        QString typeName_;
+    };
+
+    /// Looks a component up by comparing the type names of all components, as entities did before the type index.
+    ComponentPtr FindComponentByTypeName(const Scene::Entity &entity, const QString &typeName)
+    {
+        const Scene::Entity::ComponentVector &components = entity.GetComponentVector();
+        for(size_t i = 0; i < components.size(); ++i)
+            if (components[i]->TypeName() == typeName)
+                return components[i];
+        return ComponentPtr();
+    }
+}
+
+Console::CommandResult DebugStatsModule::RunComponentIndexBenchmark(const StringVector &params)
+{
+    const int numEntities = params.size() > 0 ? std::max(atoi(params[0].c_str()), 1) : 50000;
+    const int numRounds = params.size() > 1 ? std::max(atoi(params[1].c_str()), 1) : 10;
+    const int numTypes = 16;
+    const int componentsPerEntity = 4;
+    const int rareInterval = 100;
+    const QString sceneName = "ComponentIndexBenchmark";
+    std::stringstream ss;
+
+    Scene::ScenePtr scene = framework_->CreateScene(sceneName);
+    if (!scene)
+        return Console::ResultFailure("Could not create the benchmark scene.");
+
+    ComponentManagerPtr componentManager = framework_->GetComponentManager();
+    QStringList typeNames;
+    std::vector<uint> typeIds;
+    for(int i = 0; i < numTypes; ++i)
+    {
+        typeNames << QString("EC_IndexBenchmark%1").arg(i);
+        typeIds.push_back(componentManager->GetComponentTypeId(typeNames.back()));
+    }
+    const QString rareTypeName = "EC_IndexBenchmarkRare";
+    const uint rareTypeId = componentManager->GetComponentTypeId(rareTypeName);
+
+    // Every entity gets four of the sixteen types, so each type is in a quarter of the entities, and every
+    // hundredth entity also gets the rare type. Ids are taken from the top of the range, away from the world scene's.
+    // Components are added disconnected, so that nothing reacts to them.
+    tick_t startTime = GetCurrentClockTime();
+    for(int i = 0; i < numEntities; ++i)
+    {
+        Scene::EntityPtr entity = scene->CreateEntity(0x7f000000 + i, QStringList(), AttributeChange::Disconnected);
+        if (!entity)
+            continue;
+        for(int j = 0; j < componentsPerEntity; ++j)
+            entity->AddComponent(ComponentPtr(new BenchmarkComponent(framework_, typeNames[(i + j * 5) % numTypes])), AttributeChange::Disconnected);
+        if (i % rareInterval == 0)
+            entity->AddComponent(ComponentPtr(new BenchmarkComponent(framework_, rareTypeName)), AttributeChange::Disconnected);
+    }
+    const double createSeconds = (double)(GetCurrentClockTime() - startTime) / GetCurrentClockFreq();
+
+    // Per-entity lookups of every type.
+    const Scene::SceneManager::EntityMap &entities = scene->GetEntityMap();
+    const int numLookups = numRounds * (int)entities.size() * numTypes;
+    int scanHits = 0;
+    startTime = GetCurrentClockTime();
+    for(int round = 0; round < numRounds; ++round)
+        for(Scene::SceneManager::const_iterator it = entities.begin(); it != entities.end(); ++it)
+            for(int t = 0; t < numTypes; ++t)
+                if (FindComponentByTypeName(*it->second, typeNames[t]))
+                    ++scanHits;
+    const double scanSeconds = (double)(GetCurrentClockTime() - startTime) / GetCurrentClockFreq();
+
+    int nameHits = 0;
+    startTime = GetCurrentClockTime();
+    for(int round = 0; round < numRounds; ++round)
+        for(Scene::SceneManager::const_iterator it = entities.begin(); it != entities.end(); ++it)
+            for(int t = 0; t < numTypes; ++t)
+                if (it->second->GetComponent(typeNames[t]))
+                    ++nameHits;
+    const double nameSeconds = (double)(GetCurrentClockTime() - startTime) / GetCurrentClockFreq();
+
+    int idHits = 0;
+    startTime = GetCurrentClockTime();
+    for(int round = 0; round < numRounds; ++round)
+        for(Scene::SceneManager::const_iterator it = entities.begin(); it != entities.end(); ++it)
+            for(int t = 0; t < numTypes; ++t)
+                if (it->second->GetComponent(typeIds[t]))
+                    ++idHits;
+    const double idSeconds = (double)(GetCurrentClockTime() - startTime) / GetCurrentClockFreq();
+
+    // Scene queries for a common and a rare type.
+    int walkMatches = 0;
+    startTime = GetCurrentClockTime();
+    for(int round = 0; round < numRounds; ++round)
+        for(Scene::SceneManager::const_iterator it = entities.begin(); it != entities.end(); ++it)
+        {
+            if (FindComponentByTypeName(*it->second, typeNames[0]))
+                ++walkMatches;
+            if (FindComponentByTypeName(*it->second, rareTypeName))
+                ++walkMatches;
+        }
+    const double walkSeconds = (double)(GetCurrentClockTime() - startTime) / GetCurrentClockFreq();
+
+    int indexMatches = 0;
+    startTime = GetCurrentClockTime();
+    for(int round = 0; round < numRounds; ++round)
+    {
+        const Scene::SceneManager::EntityMap &common = scene->GetEntitiesWithComponentType(typeIds[0]);
+        for(Scene::SceneManager::const_iterator it = common.begin(); it != common.end(); ++it)
+            ++indexMatches;
+        const Scene::SceneManager::EntityMap &rare = scene->GetEntitiesWithComponentType(rareTypeId);
+        for(Scene::SceneManager::const_iterator it = rare.begin(); it != rare.end(); ++it)
+            ++indexMatches;
+    }
+    const double indexSeconds = (double)(GetCurrentClockTime() - startTime) / GetCurrentClockFreq();
+
+    // The index must follow removals too.
+    const Scene::SceneManager::EntityMap &rare = scene->GetEntitiesWithComponentType(rareTypeId);
+    const size_t numRare = rare.size();
+    if (!rare.empty())
+    {
+        Scene::EntityPtr entity = rare.begin()->second;
+        entity->RemoveComponent(entity->GetComponent(rareTypeId), AttributeChange::Disconnected);
+    }
+    const bool removalIndexed = numRare == 0 || scene->GetEntitiesWithComponentType(rareTypeId).size() == numRare - 1;
+
+    scene.reset();
+    framework_->RemoveScene(sceneName);
+
+    if (nameHits != scanHits || idHits != scanHits)
+        return Console::ResultFailure("Indexed component lookups found different components than the type name scan.");
+    if (indexMatches != walkMatches || !removalIndexed)
+        return Console::ResultFailure("The component type index does not match the entities in the scene.");
+
+    ss << numEntities << " entities, " << componentsPerEntity << " of " << numTypes << " component types each, created and indexed in "
+       << createSeconds * 1000.0 << " ms" << std::endl
+       << "Lookups, " << numLookups << " per method:" << std::endl
+       << "  Type name scan:     " << scanSeconds * 1e9 / numLookups << " ns/lookup" << std::endl
+       << "  Indexed type name:  " << nameSeconds * 1e9 / numLookups << " ns/lookup" << std::endl
+       << "  Type id:            " << idSeconds * 1e9 / numLookups << " ns/lookup" << std::endl
+       << "Scene queries for a common and a rare type, " << numRounds << " rounds, " << walkMatches / numRounds << " matches per round:" << std::endl
+       << "  Full scene walk:    " << walkSeconds * 1000.0 / numRounds << " ms/round" << std::endl
+       << "  Type index:         " << indexSeconds * 1000.0 / numRounds << " ms/round" << std::endl;
+    return Console::ResultSuccess(ss.str());
+}
+
+namespace
+{
+    /// Looks an entity up by name by walking the whole scene, as the scene did before the name index.
+    Scene::EntityPtr FindEntityByNameWalk(const Scene::SceneManager &scene, const QString &name)
+    {
+        const Scene::SceneManager::EntityMap &entities = scene.GetEntityMap();
+        for(Scene::SceneManager::const_iterator it = entities.begin(); it != entities.end(); ++it)
+        {
+            boost::shared_ptr<EC_Name> nameComp = it->second->GetComponent<EC_Name>();
+            if (nameComp && nameComp->name.Get() == name)
+                return it->second;
+        }
+        return Scene::EntityPtr();
+    }
+}
+
+Console::CommandResult DebugStatsModule::RunEntityNameBenchmark(const StringVector &params)
+{
+    std::vector<int> sizes;
+    if (params.size() > 0)
+        sizes.push_back(std::max(atoi(params[0].c_str()), 1));
+    else
+    {
+        sizes.push_back(10000);
+        sizes.push_back(100000);
+    }
+    const int numLookups = params.size() > 1 ? std::max(atoi(params[1].c_str()), 1) : 1000;
+    const QString sceneName = "EntityNameBenchmark";
+    ComponentManagerPtr componentManager = framework_->GetComponentManager();
+    if (!componentManager->CanCreate(EC_Name::TypeNameStatic()))
+        return Console::ResultFailure("EC_Name is not available.");
+
+    std::stringstream ss;
+    for(size_t s = 0; s < sizes.size(); ++s)
+    {
+        const int numEntities = sizes[s];
+        Scene::ScenePtr scene = framework_->CreateScene(sceneName);
+        if (!scene)
+            return Console::ResultFailure("Could not create the benchmark scene.");
+
+        // Every hundredth name is shared by two entities. The names are set before the components are added,
+        // and the components are added disconnected, so that nothing but the name index reacts to them.
+        const int numNames = numEntities - numEntities / 100;
+        tick_t startTime = GetCurrentClockTime();
+        for(int i = 0; i < numEntities; ++i)
+        {
+            Scene::EntityPtr entity = scene->CreateEntity(0x7f000000 + i, QStringList(), AttributeChange::Disconnected);
+            ComponentPtr comp = componentManager->CreateComponent(EC_Name::TypeNameStatic());
+            if (!entity || !comp)
+                continue;
+            checked_static_cast<EC_Name*>(comp.get())->name.Set(QString("Entity%1").arg(i % numNames), AttributeChange::Disconnected);
+            entity->AddComponent(comp, AttributeChange::Disconnected);
+        }
+        const double createSeconds = (double)(GetCurrentClockTime() - startTime) / GetCurrentClockFreq();
+
+        // Lookups: one in ten for a name that no entity has.
+        QStringList names;
+        for(int i = 0; i < numLookups; ++i)
+            names << (i % 10 == 9 ? QString("Missing%1").arg(i) : QString("Entity%1").arg((i * 7919) % numNames));
+
+        int walkHits = 0;
+        startTime = GetCurrentClockTime();
+        foreach(const QString &name, names)
+            if (FindEntityByNameWalk(*scene, name))
+                ++walkHits;
+        const double walkSeconds = (double)(GetCurrentClockTime() - startTime) / GetCurrentClockFreq();
+
+        int indexHits = 0;
+        bool sameEntities = true;
+        startTime = GetCurrentClockTime();
+        foreach(const QString &name, names)
+            if (scene->GetEntityByName(name))
+                ++indexHits;
+        const double indexSeconds = (double)(GetCurrentClockTime() - startTime) / GetCurrentClockFreq();
+        for(int i = 0; i < names.size() && i < 100; ++i)
+            if (FindEntityByNameWalk(*scene, names[i]) != scene->GetEntityByName(names[i]))
+                sameEntities = false;
+
+        // Tooling queries.
+        startTime = GetCurrentClockTime();
+        const size_t numPrefixed = scene->GetEntitiesByNamePrefix("Entity1").size();
+        const double prefixSeconds = (double)(GetCurrentClockTime() - startTime) / GetCurrentClockFreq();
+
+        startTime = GetCurrentClockTime();
+        const size_t numMatched = scene->GetEntitiesByNameRegExp(QRegExp("Entity\\d*7")).size();
+        const double regExpSeconds = (double)(GetCurrentClockTime() - startTime) / GetCurrentClockFreq();
+
+        // Renames go through the attribute change notification. Rename a tenth of the entities and look them up.
+        const int numRenames = numEntities / 10;
+        const Scene::SceneManager::EntityMap &entities = scene->GetEntityMap();
+        Scene::SceneManager::const_iterator entityIter = entities.begin();
+        startTime = GetCurrentClockTime();
+        for(int i = 0; i < numRenames && entityIter != entities.end(); ++i, ++entityIter)
+            entityIter->second->GetComponent<EC_Name>()->name.Set(QString("Renamed%1").arg(i), AttributeChange::LocalOnly);
+        const double renameSeconds = (double)(GetCurrentClockTime() - startTime) / GetCurrentClockFreq();
+        bool renamesIndexed = true;
+        for(int i = 0; i < numRenames; i += std::max(numRenames / 100, 1))
+            if (!scene->GetEntityByName(QString("Renamed%1").arg(i)))
+                renamesIndexed = false;
+        if (numRenames > 0 && scene->GetEntitiesWithName("Entity0").count(0x7f000000) != 0)
+            renamesIndexed = false;
+
+        scene.reset();
+        framework_->RemoveScene(sceneName);
+
+        if (indexHits != walkHits || !sameEntities)
+            return Console::ResultFailure("The name index found different entities than walking the scene.");
+        if (!renamesIndexed)
+            return Console::ResultFailure("The name index did not follow renamed entities.");
+
+        ss << numEntities << " named entities, " << numNames << " distinct names, created and indexed in "
+           << createSeconds * 1000.0 << " ms" << std::endl
+           << "  " << numLookups << " lookups, " << indexHits << " hits" << std::endl
+           << "  Scene walk:   " << walkSeconds * 1e6 / numLookups << " us/lookup" << std::endl
+           << "  Name index:   " << indexSeconds * 1e6 / numLookups << " us/lookup" << std::endl
+           << "  Prefix query: " << numPrefixed << " entities in " << prefixSeconds * 1000.0 << " ms" << std::endl
+           << "  Regexp query: " << numMatched << " entities in " << regExpSeconds * 1000.0 << " ms" << std::endl
+           << "  Renames:      " << (numRenames > 0 ? renameSeconds * 1e6 / numRenames : 0.0) << " us/rename" << std::endl;
+    }
+    return Console::ResultSuccess(ss.str());
+}
+
 Console::CommandResult DebugStatsModule::KickUser(const StringVector &params)
 {
     if (!current_world_stream_)
@@ -91,6 +91,39 @@ namespace DebugStats
         /// Invokes action in entity.
         Console::CommandResult Exec(const StringVector &params);
 
+        /// Prints the internal counters of the UDP message manager.
+        Console::CommandResult PrintNetworkStats(const StringVector &params);
+
+        /// Measures UDP throughput and system calls per frame over the loopback interface, with and without batched socket I/O.
+        Console::CommandResult RunNetworkLoopbackBenchmark(const StringVector &params);
+
+        /// Replays recorded inbound sequence number patterns through the duplicate detection window and checks the results.
+        Console::CommandResult CheckSequenceNumberWindow(const StringVector &params);
+
+        /// Starts or stops capturing the inbound UDP traffic to a file.
+        Console::CommandResult CaptureNetworkTraffic(const StringVector &params);
+
+        /// Connects to a replay of a captured UDP traffic file instead of a server.
+        Console::CommandResult ReplayNetworkTraffic(const StringVector &params);
+
+        /// Measures zero-decoding the zero-coded message bodies in a UDP traffic capture, with the two-pass and the single-pass decoder.
+        Console::CommandResult RunZeroCodeBenchmark(const StringVector &params);
+
+        /// Checks the single-pass zero-encoder and -decoder against the scalar reference implementation with random input.
+        Console::CommandResult FuzzZeroCode(const StringVector &params);
+
+        /// Sends delayed events from several threads at once. Compares the lock-free intake queue to a mutex-guarded vector,
+        /// checks that every event is delivered, and times ProcessDelayedEvents.
+        Console::CommandResult RunDelayedEventBenchmark(const StringVector &params);
+
+        /// Fills a temporary scene with entities and compares component lookups by type name scan, by indexed type name
+        /// and by type id, and scene queries by full walk and by the component type index.
+        Console::CommandResult RunComponentIndexBenchmark(const StringVector &params);
+
+        /// Fills a temporary scene with named entities, 10000 and 100000 by default, and compares name lookups by walking
+        /// the scene and through the name index. Also times prefix and regexp queries and renames.
+        Console::CommandResult RunEntityNameBenchmark(const StringVector &params);
+
         /// A history of estimated frame times.
         std::vector<std::pair<uint64_t, double> > frameTimes;
 
@@ -8,7 +8,8 @@ EC_NetworkPosition::EC_NetworkPosition(IModule* module) :
     IComponent(module->GetFramework()),
     time_since_update_(0.0),
     time_since_prev_update_(0.001),
-    first_update(true)
+    first_update(true),
+    revision_(0)
 {
 }
 
@@ -18,6 +19,8 @@ EC_NetworkPosition::~EC_NetworkPosition()
 
 void EC_NetworkPosition::Updated()
 {
+    ++revision_;
+
     // See if updated many times on the same frame, don't "update" in that case
     if (time_since_update_ != 0.0)
     {     
@@ -35,6 +38,7 @@ void EC_NetworkPosition::Updated()
 
 void EC_NetworkPosition::SetPosition(const Vector3df& position)
 {
+    ++revision_;
     position_ = position;
     NoPositionDamping();
     NoVelocity();
@@ -42,6 +46,7 @@ void EC_NetworkPosition::SetPosition(const Vector3df& position)
 
 void EC_NetworkPosition::SetOrientation(const Quaternion& orientation)
 {
+    ++revision_;
     orientation_ = orientation;
     NoOrientationDamping();
     NoRotationVelocity();
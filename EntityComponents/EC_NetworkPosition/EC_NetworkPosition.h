@@ -67,6 +67,11 @@ public:
     //! Set orientation forcibly, for example in editing tools
     void SetOrientation(const Quaternion& orientation);
 
+    //! Returns revision of the network state. Changes whenever Updated(), SetPosition() or SetOrientation() is called
+    /*! Used by batched interpolation to notice when the state has to be read again from the component.
+     */
+    uint GetRevision() const { return revision_; }
+
     //! experimental accessors that use the new 3d vector etc types in Qt 4.6, for qproperties
     QVector3D GetQPosition() const;
     void SetQPosition(const QVector3D newpos);
@@ -88,6 +93,9 @@ private:
 
     //! Disable rotational , called after setting orientation forcibly
     void NoRotationVelocity();
+
+    //! Revision of the network state
+    uint revision_;
 };
 
 #endif
\ No newline at end of file
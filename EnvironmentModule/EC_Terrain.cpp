@@ -2,10 +2,12 @@
 
 #include "StableHeaders.h"
 #include "EC_Terrain.h"
+#include "TerrainGeometry.h"
 
 #include "Renderer.h"
 #include "IModule.h"
 #include "ServiceManager.h"
+#include "Frame.h"
 
 #include <Ogre.h>
 #include "OgreMaterialUtils.h"
@@ -24,6 +26,9 @@ typedef boost::shared_ptr<Renderer> RendererPtr;
 namespace Environment
 {
 
+/// Default camera distance beyond which the patches start to be drawn at lower resolution.
+static const float cDefaultLodDistance = 64.f;
+
 EC_Terrain::EC_Terrain(IModule* module) :
     IComponent(module->GetFramework()),
     nodeTransformation(this, "Transform"),
@@ -40,9 +45,13 @@ EC_Terrain::EC_Terrain(IModule* module) :
     vScale(this, "Tex. V scale"),
     patchWidth(1),
     patchHeight(1),
-    rootNode(0)
+    rootNode(0),
+    grid(new TerrainGrid()),
+    indexBuffers(new TerrainIndexBufferCache()),
+    lodDistance(cDefaultLodDistance)
 {
     QObject::connect(this, SIGNAL(ParentEntitySet()), this, SLOT(UpdateSignals()));
+    QObject::connect(GetFramework()->GetFrame(), SIGNAL(Updated(float)), this, SLOT(UpdateLod()));
 
     xPatches.Set(1, AttributeChange::LocalOnly);
     yPatches.Set(1, AttributeChange::LocalOnly);
@@ -55,6 +64,8 @@ EC_Terrain::EC_Terrain(IModule* module) :
 EC_Terrain::~EC_Terrain()
 {
     Destroy();
+    delete grid;
+    delete indexBuffers;
 }
 
 void EC_Terrain::UpdateSignals()
@@ -103,8 +114,9 @@ void EC_Terrain::ResizeTerrain(int newPatchWidth, int newPatchHeight)
 {
     PROFILE(EC_Terrain_ResizeTerrain);
 
-    const int maxPatchSize = 32;
-    // Do an artificial limit to a preset N patches per side. (This limit is way too large already for the current terrain vertex LOD management.)
+    const int maxPatchSize = 64;
+    // Do an artificial limit to a preset N patches per side. With the distance-based LOD this allows 1024x1024 terrains, but each
+    // patch is still drawn with a batch of its own.
     newPatchWidth = max(1, min(maxPatchSize, newPatchWidth));
     newPatchHeight = max(1, min(maxPatchSize, newPatchHeight));
 
@@ -253,6 +265,7 @@ void EC_Terrain::DestroyPatch(int x, int y)
         catch (...) {}
         patch.meshGeometryName = "";
     }
+    patch.indexKey = -1;
 }
 
 void EC_Terrain::Destroy()
@@ -278,6 +291,8 @@ void EC_Terrain::Destroy()
         rootNode = 0;
     }
 
+    indexBuffers->Clear();
+
     ///\todo Clear up materials and textures.
 }
 
@@ -495,7 +510,8 @@ void EC_Terrain::UpdateRootNodeTransform()
 }
 
 /// Creates Ogre geometry data for the single given patch, or updates the geometry for an existing
-/// patch if the associated Ogre resources already exist.
+/// patch if the associated Ogre resources already exist. The vertices are written straight into the vertex buffer of the patch mesh
+/// from the terrain grid, which RegenerateDirtyTerrainPatches has updated.
 void EC_Terrain::GenerateTerrainGeometryForOnePatch(int patchX, int patchY)
 {
     PROFILE(EC_Terrain_GenerateTerrainGeometryForOnePatch);
@@ -507,8 +523,6 @@ void EC_Terrain::GenerateTerrainGeometryForOnePatch(int patchX, int patchY)
         return;
 
     Ogre::SceneNode *node = patch.node;
-    bool firstTimeFill = (node == 0);
-    UNREFERENCED_PARAM(firstTimeFill);
     if (!node)
     {
         CreateOgreTerrainPatchNode(node, patch.x, patch.y);
@@ -516,140 +530,176 @@ void EC_Terrain::GenerateTerrainGeometryForOnePatch(int patchX, int patchY)
     }
     assert(node);
 
-    Ogre::MaterialPtr terrainMaterial = Ogre::MaterialManager::getSingleton().getByName(material.Get().toStdString().c_str());
-    if (!terrainMaterial.get()) // If we could not find the material we were supposed to use, just use the default system terrain material.
-        terrainMaterial = OgreRenderer::GetOrCreateLitTexturedMaterial("Rex/TerrainPCF");
-
     Ogre::SceneManager *sceneMgr = renderer->GetSceneManager();
-    Ogre::ManualObject *manual = sceneMgr->createManualObject(renderer->GetUniqueObjectName());
-    manual->setCastShadows(false);
+    Ogre::MeshPtr terrainMesh;
+    if (patch.entity)
+        terrainMesh = patch.entity->getMesh();
+    else
+    {
+        Ogre::MaterialPtr terrainMaterial = Ogre::MaterialManager::getSingleton().getByName(material.Get().toStdString().c_str());
+        if (!terrainMaterial.get()) // If we could not find the material we were supposed to use, just use the default system terrain material.
+            terrainMaterial = OgreRenderer::GetOrCreateLitTexturedMaterial("Rex/TerrainPCF");
 
-    manual->clear();
-    manual->estimateVertexCount((cPatchSize+1)*(cPatchSize+1));
-    manual->estimateIndexCount((cPatchSize+1)*(cPatchSize+1)*3*2);
-    manual->begin(terrainMaterial->getName(), Ogre::RenderOperation::OT_TRIANGLE_LIST);
+        // If there exists a previously generated GPU Mesh resource, delete it before creating a new one.
+        if (patch.meshGeometryName.length() > 0)
+        {
+            try
+            {
+                Ogre::MeshManager::getSingleton().remove(patch.meshGeometryName);
+            }
+            catch (...) {}
+        }
 
-    const float vertexSpacingX = 1.f;
-    const float vertexSpacingY = 1.f;
-    const float patchSpacingX = cPatchSize * vertexSpacingX;
-    const float patchSpacingY = cPatchSize * vertexSpacingY;
-//        const Ogre::Vector3 patchOrigin(patch.y * patchSpacingY, 0.f, patch.x * patchSpacingX);
-    const Ogre::Vector3 patchOrigin(patch.x * patchSpacingX, patch.y * patchSpacingY, 0.f);
+        // The mesh has one submesh, with a vertex buffer of its own that is rewritten whenever the heights change, and an index buffer
+        // shared with the other patches at the same LOD level.
+        patch.meshGeometryName = renderer->GetUniqueObjectName();
+        terrainMesh = Ogre::MeshManager::getSingleton().createManual(patch.meshGeometryName, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
+        Ogre::SubMesh *submesh = terrainMesh->createSubMesh();
+        submesh->useSharedVertices = false;
+        submesh->vertexData = new Ogre::VertexData();
+        submesh->vertexData->vertexStart = 0;
+        submesh->vertexData->vertexCount = cTerrainPatchVertexCount;
+
+        Ogre::VertexDeclaration *decl = submesh->vertexData->vertexDeclaration;
+        size_t offset = 0;
+        decl->addElement(0, offset, Ogre::VET_FLOAT3, Ogre::VES_POSITION);
+        offset += Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT3);
+        decl->addElement(0, offset, Ogre::VET_FLOAT3, Ogre::VES_NORMAL);
+        offset += Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT3);
+        decl->addElement(0, offset, Ogre::VET_FLOAT2, Ogre::VES_TEXTURE_COORDINATES, 0);
+        offset += Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT2);
+        assert(offset == cTerrainVertexFloats * sizeof(float));
+
+        Ogre::HardwareVertexBufferSharedPtr vertexBuffer = Ogre::HardwareBufferManager::getSingleton().createVertexBuffer(
+            offset, cTerrainPatchVertexCount, Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY);
+        submesh->vertexData->vertexBufferBinding->setBinding(0, vertexBuffer);
+        submesh->setMaterialName(terrainMaterial->getName());
+
+        patch.indexKey = -1;
+        const int noStitch[4] = { 0, 0, 0, 0 };
+        SetPatchIndexBuffer(patch, terrainMesh.get(), TerrainPatchIndexKey(patch.lod, noStitch));
+
+        terrainMesh->_setBounds(Ogre::AxisAlignedBox(0.f, 0.f, 0.f, (float)cPatchSize, (float)cPatchSize, 0.f));
+        terrainMesh->load();
+
+        patch.entity = sceneMgr->createEntity(renderer->GetUniqueObjectName(), patch.meshGeometryName);
+        patch.entity->setUserAny(Ogre::Any(parent_entity_));
+        patch.entity->setCastShadows(false);
+        // Set UserAny also on subentities
+        for (uint i = 0; i < patch.entity->getNumSubEntities(); ++i)
+            patch.entity->getSubEntity(i)->setUserAny(patch.entity->getUserAny());
+
+        // Explicitly destroy all attached MovableObjects previously bound to this terrain node.
+        Ogre::SceneNode::ObjectIterator iter = node->getAttachedObjectIterator();
+        while(iter.hasMoreElements())
+        {
+            Ogre::MovableObject *obj = iter.getNext();
+            sceneMgr->destroyMovableObject(obj);
+        }
+        node->detachAllObjects();
+        // Now attach the new built terrain mesh.
+        node->attachObject(patch.entity);
+    }
 
-    int curIndex = 0;
+    Ogre::HardwareVertexBufferSharedPtr vertexBuffer = terrainMesh->getSubMesh(0)->vertexData->vertexBufferBinding->getBuffer(0);
+    float minHeight = 0.f;
+    float maxHeight = 0.f;
+    float *vertices = static_cast<float *>(vertexBuffer->lock(Ogre::HardwareBuffer::HBL_DISCARD));
+    grid->FillPatchVertices(patch.x, patch.y, uScale.Get(), vScale.Get(), vertices, minHeight, maxHeight);
+    vertexBuffer->unlock();
 
-    const int cPatchVertexWidth = cPatchSize; // The number of vertices in the patch in horizontal direction. We use the fixed value of cPatchSize==16.
-    const int cPatchVertexHeight = cPatchSize; // The number of vertices in the patch in vertical  direction. We use the fixed value of cPatchSize==16.
-    // If we assume each patch is 16x16 vertices, then all the internal patches will get a 17x17 grid, since we need to connect seams.
-    // But, the outermost patch row and column at the terrain edge will not have this, since they do not need to connect to a next patch.
-    // This is the vertex stride for the terrain.
-    const int stride = (patch.x + 1 >= patchWidth) ? cPatchVertexWidth : (cPatchVertexWidth+1);
+    const float size = (float)cPatchSize;
+    terrainMesh->_setBounds(Ogre::AxisAlignedBox(0.f, 0.f, minHeight, size, size, maxHeight), false);
+    terrainMesh->_setBoundingSphereRadius(sqrt(2.f * size * size + max(minHeight * minHeight, maxHeight * maxHeight)));
+    // The geometry changed in place. Bump the state count of the mesh so that cached raycast hierarchies get rebuilt.
+    terrainMesh->_dirtyState();
+    node->needUpdate();
 
-    const float uScale = this->uScale.Get();
-    const float vScale = this->vScale.Get();
+    patch.patch_geometry_dirty = false;
 
-    for(int y = 0; y <= cPatchVertexHeight; ++y)
-        for(int x = 0; x <= cPatchVertexWidth; ++x)
-        {
-            if ((patch.x + 1 >= patchWidth && x == cPatchVertexWidth) ||
-                (patch.y + 1 >= patchHeight && y == cPatchVertexHeight))
-                continue; // We are at the single corner-most vertex of the whole terrain. That is to be skipped.
-
-            // These coordinates are directly generated to our Ogre coordinate system, i.e. are cycled from OpenSim XYZ -> our YZX.
-            // see OpenSimToOgreCoordinateAxes.
-            Ogre::Vector3 pos;
-// Ogre:                pos.x = vertexSpacingY * y;
-// Ogre:                pos.z = vertexSpacingX * x;
-            pos.x = vertexSpacingX * x;
-            pos.y = vertexSpacingY * y;
-
-            EC_Terrain::Patch *thisPatch;
-            int X = x;
-            int Y = y;
-            if (x < cPatchVertexWidth && y < cPatchVertexHeight)
-            {
-                thisPatch = &patch;
+    ///\todo Regression. Re-enable this to have the EnvironmentEditor module function again.
+//    emit HeightmapGeometryUpdated();
+}
 
-                if ((patch.x + 1 < patchWidth || x+1 < cPatchVertexWidth) &&
-                    (patch.y + 1 < patchHeight || y+1 < cPatchVertexHeight))
-                {
-                    manual->index(curIndex);
-                    manual->index(curIndex+1);
-                    manual->index(curIndex+stride);
+void EC_Terrain::SetPatchIndexBuffer(Patch &patch, Ogre::Mesh *mesh, int key)
+{
+    if (key == patch.indexKey)
+        return;
 
-                    manual->index(curIndex+1);
-                    manual->index(curIndex+stride+1);
-                    manual->index(curIndex+stride);
-                }
-            }
-            else if (x == cPatchVertexWidth && y == cPatchVertexHeight)
-            {
-                thisPatch = &GetPatch(patch.x + 1, patch.y + 1);
-                X = 0;
-                Y = 0;
-            }
-            else if (x == cPatchVertexWidth)
-            {
-                thisPatch = &GetPatch(patch.x + 1, patch.y);
-                X = 0;
-            }
-            else // (y == patchHeight)
-            {
-                thisPatch = &GetPatch(patch.x, patch.y + 1);
-                Y = 0;
-            }
+    size_t indexCount = 0;
+    Ogre::IndexData *indexData = mesh->getSubMesh(0)->indexData;
+    indexData->indexBuffer = indexBuffers->GetIndexBuffer(key, indexCount);
+    indexData->indexStart = 0;
+    indexData->indexCount = indexCount;
+    patch.indexKey = key;
+}
 
-// Ogre:        pos.y = thisPatch->heightData[Y*patchSize+X];
-            pos.z = thisPatch->heightData[Y*cPatchVertexWidth+X];
+void EC_Terrain::SetLodDistance(float distance)
+{
+    lodDistance = distance;
+}
 
-            manual->position(pos);
-            manual->normal(OgreRenderer::ToOgreVector3(CalculateNormal(thisPatch->x, thisPatch->y, X, Y)));
-// Ogre:                manual->textureCoord((patchOrigin.x + pos.x) * uScale, (patchOrigin.z + pos.z) * vScale);
-            manual->textureCoord((patchOrigin.x + pos.x) * uScale, (patchOrigin.y + pos.y) * vScale);
-            ++curIndex;
-        }
+void EC_Terrain::UpdateLod()
+{
+    PROFILE(EC_Terrain_UpdateLod);
 
-    manual->end();
+    if (!rootNode)
+        return;
 
-    // If there exists a previously generated GPU Mesh resource, delete it before creating a new one.
-    if (patch.meshGeometryName.length() > 0)
-    {
-        try
-        {
-            Ogre::MeshManager::getSingleton().remove(patch.meshGeometryName);
-        }
-        catch (...) {}
-    }
+    Renderer *renderer = framework_->GetService<Renderer>();
+    if (!renderer || !renderer->GetCurrentCamera())
+        return;
 
-    patch.meshGeometryName = renderer->GetUniqueObjectName();
-    Ogre::MeshPtr terrainMesh = manual->convertToMesh(patch.meshGeometryName);
+    // Camera position in the coordinate system of the patch grid.
+    const Ogre::Vector3 &scale = rootNode->_getDerivedScale();
+    if (scale.x == 0.f || scale.y == 0.f || scale.z == 0.f)
+        return;
+    const Ogre::Vector3 cameraPos = rootNode->_getDerivedOrientation().Inverse() *
+        (renderer->GetCurrentCamera()->getDerivedPosition() - rootNode->_getDerivedPosition()) / scale;
 
-    // Odd: destroyManualObject seems to leave behind a memory leak if we don't call manualObject->clear first.
-    manual->clear();
-    sceneMgr->destroyManualObject(manual);
+    // Choose the LOD level of each patch from the distance of the camera to its bounding box.
+    for(int y = 0; y < patchHeight; ++y)
+        for(int x = 0; x < patchWidth; ++x)
+        {
+            Patch &patch = GetPatch(x, y);
+            if (!patch.entity)
+                continue;
 
-    patch.entity = sceneMgr->createEntity(renderer->GetUniqueObjectName(), patch.meshGeometryName);
-    patch.entity->setUserAny(Ogre::Any(parent_entity_));
-    patch.entity->setCastShadows(false);
-    // Set UserAny also on subentities
-    for (uint i = 0; i < patch.entity->getNumSubEntities(); ++i)
-        patch.entity->getSubEntity(i)->setUserAny(patch.entity->getUserAny());
+            const Ogre::AxisAlignedBox &bounds = patch.entity->getMesh()->getBounds();
+            const Ogre::Vector3 origin((float)(x * cPatchSize), (float)(y * cPatchSize), 0.f);
+            const Ogre::Vector3 nearest = cameraPos - origin;
+            Ogre::Vector3 offset(0.f, 0.f, 0.f);
+            for(int i = 0; i < 3; ++i)
+                offset[i] = max(max(bounds.getMinimum()[i] - nearest[i], nearest[i] - bounds.getMaximum()[i]), 0.f);
+            const float distance = offset.length();
+
+            int lod = 0;
+            if (lodDistance > 0.f)
+                for(float lodStart = lodDistance; lod < cNumTerrainLods - 1 && distance > lodStart; lodStart *= 2.f)
+                    ++lod;
+            patch.lod = lod;
+        }
 
-    // Explicitly destroy all attached MovableObjects previously bound to this terrain node.
-    Ogre::SceneNode::ObjectIterator iter = node->getAttachedObjectIterator();
-    while(iter.hasMoreElements())
-    {
-        Ogre::MovableObject *obj = iter.getNext();
-        sceneMgr->destroyMovableObject(obj);
-    }
-    node->detachAllObjects();
-    // Now attach the new built terrain mesh.
-    node->attachObject(patch.entity);
+    // Stitch the edges that border a coarser patch, and switch the patches whose level or neighbours have changed.
+    for(int y = 0; y < patchHeight; ++y)
+        for(int x = 0; x < patchWidth; ++x)
+        {
+            Patch &patch = GetPatch(x, y);
+            if (!patch.entity)
+                continue;
 
-    patch.patch_geometry_dirty = false;
+            const int neighbors[4][2] = { { x - 1, y }, { x + 1, y }, { x, y - 1 }, { x, y + 1 } };
+            int stitch[4] = { 0, 0, 0, 0 };
+            for(int i = 0; i < 4; ++i)
+                if (PatchExists(neighbors[i][0], neighbors[i][1]))
+                {
+                    const Patch &neighbor = GetPatch(neighbors[i][0], neighbors[i][1]);
+                    if (neighbor.entity)
+                        stitch[i] = max(neighbor.lod - patch.lod, 0);
+                }
 
-    ///\todo Regression. Re-enable this to have the EnvironmentEditor module function again.
-//    emit HeightmapGeometryUpdated();
+            SetPatchIndexBuffer(patch, patch.entity->getMesh().get(), TerrainPatchIndexKey(patch.lod, stitch));
+        }
 }
 
 void EC_Terrain::CreateRootNode()
@@ -726,6 +776,26 @@ void EC_Terrain::RegenerateDirtyTerrainPatches()
 {
     PROFILE(EC_Terrain_RegenerateDirtyTerrainPatches);
 
+    // Copy the heights of the changed patches to the grid, and recalculate the normals of the rows they affect in one pass.
+    // After a resize all the patches are copied.
+    const bool resized = (grid->Width() != patchWidth * cPatchSize || grid->Height() != patchHeight * cPatchSize);
+    if (resized)
+        grid->Resize(patchWidth * cPatchSize, patchHeight * cPatchSize);
+    int firstRow = patchHeight * cPatchSize;
+    int lastRow = -1;
+    for(int y = 0; y < patchHeight; ++y)
+        for(int x = 0; x < patchWidth; ++x)
+        {
+            const EC_Terrain::Patch &scenePatch = GetPatch(x, y);
+            if (!resized && !scenePatch.patch_geometry_dirty)
+                continue;
+            grid->SetPatchHeights(x, y, scenePatch.heightData);
+            firstRow = min(firstRow, y * cPatchSize - 1);
+            lastRow = max(lastRow, (y + 1) * cPatchSize);
+        }
+    if (lastRow >= 0)
+        grid->CalculateNormals(firstRow, lastRow);
+
     for(int y = 0; y < patchHeight; ++y)
         for(int x = 0; x < patchWidth; ++x)
         {
@@ -13,10 +13,14 @@ namespace Ogre
 {
     class SceneNode;
     class Entity;
+    class Mesh;
 }
 
 namespace Environment
 {
+class TerrainGrid;
+class TerrainIndexBufferCache;
+
 	/**
 
 <table class="header">
@@ -79,9 +83,10 @@ public:
     /// - heightmap data loaded. The heightData vector contains the heightmap data, but the visible GPU vertex data itself has not been generated yet, due to the neighbors
     ///   of this patch not being present yet. node == entity == 0, meshGeometryName == "". patch_geometry_dirty == true.
     /// - fully loaded. The GPU data is also loaded and the node, entity and meshGeometryName fields specify the used GPU resources.
+    ///   The mesh is kept for as long as the patch exists. When the heights change, its vertex buffer is rewritten in place.
     struct Patch
     {
-        Patch():x(0),y(0), node(0), entity(0), patch_geometry_dirty(true) {}
+        Patch():x(0),y(0), node(0), entity(0), patch_geometry_dirty(true), lod(0), indexKey(-1) {}
 
         /// X-coordinate on the grid of patches. In the range [0, EC_Terrain::PatchWidth()].
         int x;
@@ -107,6 +112,12 @@ public:
         /// in yet.
         bool patch_geometry_dirty;
 
+        /// The geometry LOD level the patch is drawn at, from 0 (full resolution) to cNumTerrainLods-1. Chosen by the distance to the camera.
+        int lod;
+
+        /// Key of the shared index buffer the mesh of this patch currently uses, or -1 if none yet.
+        int indexKey;
+
         /// Call only when you've checked that this patch has been loaded in.
         float GetHeightValue(int x, int y) const { return heightData[y*cPatchSize+x]; }
     };
@@ -174,6 +185,13 @@ public slots:
     /// Releases all GPU resources used for the given patch.
     void DestroyPatch(int patchX, int patchY);
 
+    /// Sets the camera distance beyond which the patches start to be drawn at lower resolution. Each doubling of the distance
+    /// halves the resolution, down to every eighth vertex. Zero or less draws all the patches at full resolution.
+    void SetLodDistance(float distance);
+
+    /// Returns the camera distance beyond which the patches start to be drawn at lower resolution.
+    float LodDistance() const { return lodDistance; }
+
     /// Makes all the vertices of the given patch flat with the given height value.
     void MakePatchFlat(int patchX, int patchY, float heightValue);
 
@@ -260,6 +278,10 @@ private slots:
     //! Emitted when some of the attributes has been changed.
     void AttributeUpdated(IAttribute *attribute);
 
+    //! Called every frame. Chooses the LOD level of each patch from its distance to the camera, and switches the patches whose
+    //! level or neighbours have changed to the matching shared index buffers.
+    void UpdateLod();
+
 public slots:
 
     void OnTerrainSizeChanged();
@@ -288,6 +310,15 @@ private:
     /// Stores the actual height patches.
     std::vector<Patch> patches;
 
+    /// Heights and normals of all the patches, as copied when their geometry was last regenerated.
+    TerrainGrid *grid;
+
+    /// Index buffers of the patches, shared by all the patches at the same LOD level and with the same stitched edges.
+    TerrainIndexBufferCache *indexBuffers;
+
+    /// Camera distance beyond which the patches start to be drawn at lower resolution.
+    float lodDistance;
+
     void CreateOgreTerrainPatchNode(Ogre::SceneNode *&node, int patchX, int patchY);
 
     /// Sets the given patch to use the currently set material and textures.
@@ -304,6 +335,9 @@ private:
     void SetTerrainMaterialTexture(int index, const char *textureName);
 
     void GenerateTerrainGeometryForOnePatch(int patchX, int patchY);
+
+    /// Switches the mesh of the given patch to use the shared index buffer of the given key.
+    void SetPatchIndexBuffer(Patch &patch, Ogre::Mesh *mesh, int key);
 };
 }
 
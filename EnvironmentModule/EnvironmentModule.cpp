@@ -9,6 +9,10 @@
 
 #include "EnvironmentModule.h"
 #include "Terrain.h"
+#include "LayerDataDecoder.h"
+#include "TerrainDecoder.h"
+#include "TerrainGeometry.h"
+#include "EC_Terrain.h"
 #include "Water.h"
 #include "Environment.h"
 #include "Sky.h"
@@ -34,7 +38,14 @@
 #include "GenericMessageUtils.h"
 #include "ModuleManager.h"
 #include "EventManager.h"
+#include "ThreadTaskManager.h"
 #include "RexNetworkUtils.h"
+#include "CoreException.h"
+#include "PacketCapture.h"
+#include "ZeroCode.h"
+#include "NetworkMessages/NetMessage.h"
+#include "BitStream.h"
+#include "HighPerfClock.h"
 #include "CompositionHandler.h"
 #include <EC_Name.h>
 
@@ -62,6 +73,7 @@ namespace Environment
         scene_event_category_(0),
         framework_event_category_(0),
         input_event_category_(0),
+        task_event_category_(0),
         firstTime_(true)
     {
     }
@@ -96,6 +108,10 @@ namespace Environment
         scene_event_category_ = event_manager_->QueryEventCategory("Scene");
         framework_event_category_ = event_manager_->QueryEventCategory("Framework");
         input_event_category_ = event_manager_->QueryEventCategory("Input");
+        task_event_category_ = event_manager_->QueryEventCategory("Task");
+
+        // Terrain height data is decoded in the background
+        framework_->GetThreadTaskManager()->AddThreadTask(Foundation::ThreadTaskPtr(new LayerDataDecoder()));
 
         OgreRenderer::Renderer *renderer = framework_->GetService<OgreRenderer::Renderer>();
         if (renderer)
@@ -126,10 +142,19 @@ namespace Environment
         RegisterConsoleCommand(Console::CreateCommand("TerrainTextureEditor",
             "Shows the terrain texture weight editor.",
             Console::Bind(w_editor_, &TerrainWeightEditor::ShowWindow)));
+
+        RegisterConsoleCommand(Console::CreateCommand("terrainbench",
+            "Decodes the terrain LayerData packets of a packet capture with the reference and optimized decoders. Usage: terrainbench(filename, rounds)",
+            Console::Bind(this, &EnvironmentModule::RunTerrainDecodeBenchmark)));
+
+        RegisterConsoleCommand(Console::CreateCommand("terraingeombench",
+            "Generates the normals and patch vertices of a synthetic terrain. Usage: terraingeombench(patches per side, rounds)",
+            Console::Bind(this, &EnvironmentModule::RunTerrainGeometryBenchmark)));
     }
 
     void EnvironmentModule::Uninitialize()
     {
+        framework_->GetThreadTaskManager()->RemoveThreadTask(LayerDataDecoder::GetTaskDescriptionStatic());
         SAFE_DELETE(environment_editor_);
         SAFE_DELETE(postprocess_dialog_);
         SAFE_DELETE(w_editor_);
@@ -231,6 +256,10 @@ namespace Environment
         {
             HandleInputEvent(event_id, data);
         }
+        else if(category_id == task_event_category_)
+        {
+            HandleTaskEvent(event_id, data);
+        }
         return false;
     }
 
@@ -560,6 +589,254 @@ namespace Environment
         return false;
     }
 
+    bool EnvironmentModule::HandleTaskEvent(event_id_t event_id, IEventData* data)
+    {
+        if (event_id != Task::Events::REQUEST_COMPLETED)
+            return false;
+
+        LayerDataDecodeResult *result = dynamic_cast<LayerDataDecodeResult*>(data);
+        if (result && terrain_.get())
+            terrain_->HandleDecodedLayerData(result);
+        return false;
+    }
+
+    Console::CommandResult EnvironmentModule::RunTerrainDecodeBenchmark(const StringVector &params)
+    {
+        if (params.empty())
+            return Console::ResultFailure("Usage: \"terrainbench(filename, rounds)\"");
+        const int numRounds = params.size() > 1 ? std::max(atoi(params[1].c_str()), 1) : 100;
+
+        // Collect the layer data of the captured land LayerData messages
+        std::vector<std::vector<u8> > layers;
+        try
+        {
+            ProtocolUtilities::PacketCaptureReader reader(params[0]);
+            std::vector<u8> decoded(16384);
+            uint64_t timestamp;
+            const uint8_t *data;
+            size_t numBytes;
+            while(reader.Next(timestamp, data, numBytes))
+            {
+                if (numBytes < 6)
+                    continue;
+                size_t begin = 6 + data[5];
+                size_t end = numBytes;
+                if (data[0] & ProtocolUtilities::NetFlagAck)
+                    end -= std::min<size_t>(end, 1 + data[numBytes-1] * 4);
+                if (begin >= end)
+                    continue;
+
+                const u8 *body = data + begin;
+                size_t bodySize = end - begin;
+                if (data[0] & ProtocolUtilities::NetFlagZeroCode)
+                {
+                    bodySize = ProtocolUtilities::ZeroDecodeToBuffer(&decoded[0], decoded.size(), body, bodySize);
+                    if (bodySize == 0 || bodySize > decoded.size())
+                        continue;
+                    body = &decoded[0];
+                }
+
+                // High frequency message id, LayerID block with the type, then the variable length data
+                if (bodySize < 4 || body[0] != RexNetMsgLayerData)
+                    continue;
+                const size_t dataSize = body[2] | (body[3] << 8);
+                if (dataSize < 4 || 4 + dataSize > bodySize)
+                    continue;
+                ProtocolUtilities::BitStream bits(body + 4, dataSize);
+                if (DecodePatchGroupHeader(bits).layerType == TPLayerLand)
+                    layers.push_back(std::vector<u8>(body + 4, body + 4 + dataSize));
+            }
+        }
+        catch(const Exception &e)
+        {
+            return Console::ResultFailure(e.what());
+        }
+        if (layers.empty())
+            return Console::ResultFailure("No land LayerData packets in " + params[0] + ".");
+
+        std::vector<std::vector<DecodedTerrainPatch> > reference(layers.size());
+        std::vector<std::vector<DecodedTerrainPatch> > optimized(layers.size());
+        f64 times[2] = { 0.0, 0.0 };
+        for(int round = 0; round < numRounds; ++round)
+            for(int pass = 0; pass < 2; ++pass)
+            {
+                tick_t startTime = GetCurrentClockTime();
+                for(size_t i = 0; i < layers.size(); ++i)
+                {
+                    std::vector<DecodedTerrainPatch> &patches = pass ? optimized[i] : reference[i];
+                    patches.clear();
+                    ProtocolUtilities::BitStream bits(&layers[i][0], layers[i].size());
+                    TerrainPatchGroupHeader header = DecodePatchGroupHeader(bits);
+                    if (pass)
+                        DecompressLand(patches, bits, header);
+                    else
+                        DecompressLandReference(patches, bits, header);
+                }
+                times[pass] += (f64)(GetCurrentClockTime() - startTime) / GetCurrentClockFreq();
+            }
+
+        // Check that the decoders agree, and which patches of the region the capture covers
+        std::set<int> covered;
+        uint numPatches = 0;
+        uint numMismatches = 0;
+        float maxError = 0.0f;
+        for(size_t i = 0; i < layers.size(); ++i)
+        {
+            if (reference[i].size() != optimized[i].size())
+            {
+                ++numMismatches;
+                continue;
+            }
+            for(size_t j = 0; j < reference[i].size(); ++j)
+            {
+                const DecodedTerrainPatch &a = reference[i][j];
+                const DecodedTerrainPatch &b = optimized[i][j];
+                ++numPatches;
+                covered.insert(a.header.y * 16 + a.header.x);
+                if (a.header.x != b.header.x || a.header.y != b.header.y || a.heightData.size() != b.heightData.size())
+                {
+                    ++numMismatches;
+                    continue;
+                }
+                for(size_t k = 0; k < a.heightData.size(); ++k)
+                    maxError = std::max(maxError, (float)fabs(a.heightData[k] - b.heightData[k]));
+            }
+        }
+
+        std::stringstream ss;
+        ss << layers.size() << " land LayerData packets, " << numPatches << " patches, covering " << covered.size() << " of the 256 patches of a region, "
+           << numRounds << " rounds" << std::endl;
+        for(int pass = 0; pass < 2; ++pass)
+        {
+            const f64 perRound = times[pass] / numRounds;
+            ss << (pass ? "Optimized: " : "Reference: ") << perRound * 1000.0 << " ms per round, "
+               << (numPatches ? perRound * 1000000.0 / numPatches : 0.0) << " us per patch, "
+               << perRound * 1000.0 * 256.0 / std::max(numPatches, 1u) << " ms per 256x256 region" << std::endl;
+        }
+        ss << "Largest height difference " << maxError << " m";
+        if (numMismatches > 0 || maxError > 1e-3f)
+            return Console::ResultFailure(ss.str() + ", " + ToString(numMismatches) + " mismatched patches!");
+        return Console::ResultSuccess(ss.str());
+    }
+
+    /// Returns the height at the given point of a terrain stored as patches, as EC_Terrain::GetPoint does.
+    static float GetPatchHeight(const std::vector<std::vector<float> > &patches, int numPatches, int x, int y)
+    {
+        const int patchSize = EC_Terrain::cPatchSize;
+        return patches[(y / patchSize) * numPatches + x / patchSize][(y % patchSize) * patchSize + x % patchSize];
+    }
+
+    Console::CommandResult EnvironmentModule::RunTerrainGeometryBenchmark(const StringVector &params)
+    {
+        const int numPatches = params.size() > 0 ? clamp(atoi(params[0].c_str()), 1, 64) : 64;
+        const int numRounds = params.size() > 1 ? std::max(atoi(params[1].c_str()), 1) : 10;
+        const int patchSize = EC_Terrain::cPatchSize;
+        const int size = numPatches * patchSize;
+
+        // Rolling hills, stored per patch as EC_Terrain stores them
+        std::vector<std::vector<float> > patches(numPatches * numPatches);
+        TerrainGrid grid;
+        grid.Resize(size, size);
+        for(int py = 0; py < numPatches; ++py)
+            for(int px = 0; px < numPatches; ++px)
+            {
+                std::vector<float> &heights = patches[py * numPatches + px];
+                heights.resize(patchSize * patchSize);
+                for(int y = 0; y < patchSize; ++y)
+                    for(int x = 0; x < patchSize; ++x)
+                    {
+                        const float gx = (float)(px * patchSize + x);
+                        const float gy = (float)(py * patchSize + y);
+                        heights[y * patchSize + x] = 20.f + 10.f * sin(gx * 0.05f) * cos(gy * 0.03f) + 2.f * sin(gx * 0.37f + gy * 0.21f);
+                    }
+                grid.SetPatchHeights(px, py, heights);
+            }
+
+        // Reference: the normal of each vertex from its neighbours, looked up through the patches as EC_Terrain::CalculateNormal does
+        std::vector<Vector3df> reference(size * size);
+        tick_t startTime = GetCurrentClockTime();
+        for(int round = 0; round < numRounds; ++round)
+            for(int y = 0; y < size; ++y)
+                for(int x = 0; x < size; ++x)
+                {
+                    const int xNext = std::min(x + 1, size - 1);
+                    const int yNext = std::min(y + 1, size - 1);
+                    const int xPrev = std::max(x - 1, 0);
+                    const int yPrev = std::max(y - 1, 0);
+                    float xSlope = GetPatchHeight(patches, numPatches, xPrev, y) - GetPatchHeight(patches, numPatches, xNext, y);
+                    if (x <= 0)
+                        xSlope *= 2;
+                    float ySlope = GetPatchHeight(patches, numPatches, x, yPrev) - GetPatchHeight(patches, numPatches, x, yNext);
+                    if (y <= 0)
+                        ySlope *= 2;
+                    Vector3df normal(xSlope, ySlope, 2.0);
+                    normal.normalize();
+                    reference[y * size + x] = normal;
+                }
+        const f64 referenceTime = (f64)(GetCurrentClockTime() - startTime) / GetCurrentClockFreq() / numRounds;
+
+        startTime = GetCurrentClockTime();
+        for(int round = 0; round < numRounds; ++round)
+            grid.CalculateNormals(0, size - 1);
+        const f64 normalTime = (f64)(GetCurrentClockTime() - startTime) / GetCurrentClockFreq() / numRounds;
+
+        // Write the vertices of every patch, as done when the whole terrain changes
+        std::vector<float> vertices(cTerrainPatchVertexCount * cTerrainVertexFloats);
+        float maxError = 0.f;
+        startTime = GetCurrentClockTime();
+        for(int round = 0; round < numRounds; ++round)
+            for(int py = 0; py < numPatches; ++py)
+                for(int px = 0; px < numPatches; ++px)
+                {
+                    float minHeight, maxHeight;
+                    grid.FillPatchVertices(px, py, 0.13f, 0.13f, &vertices[0], minHeight, maxHeight);
+                    if (round == 0 && px == py)
+                        for(int i = 0; i < cTerrainPatchVertexCount; ++i)
+                        {
+                            const float *v = &vertices[i * cTerrainVertexFloats];
+                            const Vector3df &normal = reference[(py * patchSize + (int)v[1]) * size + px * patchSize + (int)v[0]];
+                            maxError = std::max(maxError, (Vector3df(v[3], v[4], v[5]) - normal).getLength());
+                        }
+                }
+        const f64 fillTime = (f64)(GetCurrentClockTime() - startTime) / GetCurrentClockFreq() / numRounds;
+
+        // Triangles drawn with the camera above the middle of the terrain, at the default LOD distance
+        std::vector<u16> indices;
+        uint numTriangles[cNumTerrainLods];
+        const int noStitch[4] = { 0, 0, 0, 0 };
+        for(int lod = 0; lod < cNumTerrainLods; ++lod)
+        {
+            GenerateTerrainPatchIndices(TerrainPatchIndexKey(lod, noStitch), indices);
+            numTriangles[lod] = indices.size() / 3;
+        }
+        uint lodTriangles = 0;
+        for(int py = 0; py < numPatches; ++py)
+            for(int px = 0; px < numPatches; ++px)
+            {
+                const float dx = std::max(fabs((px + 0.5f) * patchSize - size * 0.5f) - patchSize * 0.5f, 0.f);
+                const float dy = std::max(fabs((py + 0.5f) * patchSize - size * 0.5f) - patchSize * 0.5f, 0.f);
+                const float distance = sqrt(dx * dx + dy * dy);
+                int lod = 0;
+                for(float lodStart = 64.f; lod < cNumTerrainLods - 1 && distance > lodStart; lodStart *= 2.f)
+                    ++lod;
+                lodTriangles += numTriangles[lod];
+            }
+
+        std::stringstream ss;
+        ss << size << "x" << size << " terrain, " << numPatches * numPatches << " patches, " << numRounds << " rounds" << std::endl
+           << "Normals one vertex at a time: " << referenceTime * 1000.0 << " ms" << std::endl
+           << "Normals in one pass: " << normalTime * 1000.0 << " ms" << std::endl
+           << "Patch vertices: " << fillTime * 1000.0 << " ms, " << fillTime * 1000000.0 / (numPatches * numPatches) << " us per patch" << std::endl
+           << "Triangles per patch by LOD level:";
+        for(int lod = 0; lod < cNumTerrainLods; ++lod)
+            ss << " " << numTriangles[lod];
+        ss << std::endl << "Triangles with the camera in the middle: " << lodTriangles << " of " << numTriangles[0] * numPatches * numPatches << std::endl
+           << "Largest normal difference " << maxError;
+        if (maxError > 1e-4f)
+            return Console::ResultFailure(ss.str() + ", the normals differ!");
+        return Console::ResultSuccess(ss.str());
+    }
+
     bool EnvironmentModule::HandleOSNE_RegionHandshake(ProtocolUtilities::NetworkEventInboundData* data)
     {
         ProtocolUtilities::NetInMessage &msg = *data->message;
@@ -78,6 +78,12 @@ namespace Environment
         //! @return Should return true if the event was handled and is not to be propagated further
         bool HandleNetworkEvent(event_id_t event_id, IEventData* data);
 
+        //! Handles task event category.
+        //! @param event_id event id
+        //! @param data event data pointer
+        //! @return Should return true if the event was handled and is not to be propagated further
+        bool HandleTaskEvent(event_id_t event_id, IEventData* data);
+
         //! Handles input event category.
         //! @param event_id event id
         //! @param data event data pointer
@@ -138,6 +144,16 @@ namespace Environment
          */ 
         void RemoveLocalEnvironment();
 
+        //! Decodes the land LayerData packets of a packet capture with the reference and the optimized terrain decoders,
+        //! and compares their results and speed.
+        //! @param params capture file name, and optionally the number of rounds to decode the packets
+        Console::CommandResult RunTerrainDecodeBenchmark(const StringVector &params);
+
+        //! Generates the terrain normals and patch vertices of a synthetic terrain, and compares the batched normal pass to
+        //! calculating the normals one vertex at a time.
+        //! @param params optionally the number of patches per side and the number of rounds
+        Console::CommandResult RunTerrainGeometryBenchmark(const StringVector &params);
+
         MODULE_LOGGING_FUNCTIONS
 
         //! @return Returns name of this module. Needed for logging.
@@ -195,6 +211,9 @@ namespace Environment
         //! Id for Input event category
         event_category_id_t input_event_category_;
 
+        //! Id for Task event category
+        event_category_id_t task_event_category_;
+
         //! Terrain geometry ptr.
         TerrainPtr terrain_;
 
@@ -0,0 +1,52 @@
+/**
+ *  For conditions of distribution and use, see copyright notice in license.txt
+ *
+ *  @file   LayerDataDecoder.cpp
+ *  @brief  Decodes terrain height data of LayerData packets in a worker thread.
+ */
+
+#include "StableHeaders.h"
+
+#include "LayerDataDecoder.h"
+#include "EnvironmentModule.h"
+#include "BitStream.h"
+#include "HighPerfClock.h"
+#include "Profiler.h"
+
+namespace Environment
+{
+    static const std::string task_description("LayerDataDecoder");
+
+    LayerDataDecoder::LayerDataDecoder() :
+        Foundation::ThreadTask(task_description, 1)
+    {
+    }
+
+    const std::string& LayerDataDecoder::GetTaskDescriptionStatic()
+    {
+        return task_description;
+    }
+
+    void LayerDataDecoder::ProcessRequest(Foundation::ThreadTaskRequestPtr request)
+    {
+        LayerDataDecodeRequestPtr decode_request = boost::dynamic_pointer_cast<LayerDataDecodeRequest>(request);
+        if (!decode_request || decode_request->data_.empty())
+            return;
+
+        PROFILE(LayerDataDecoder_Decode);
+        tick_t start_time = GetCurrentClockTime();
+
+        LayerDataDecodeResultPtr result(new LayerDataDecodeResult());
+        result->tag_ = decode_request->tag_;
+
+        ProtocolUtilities::BitStream bits(&decode_request->data_[0], decode_request->data_.size());
+        result->header_ = DecodePatchGroupHeader(bits);
+
+        if (result->header_.layerType == TPLayerLand)
+            DecompressLand(result->patches_, bits, result->header_);
+        result->num_decoded_ = result->patches_.size();
+
+        result->decode_time_ = (f64)(GetCurrentClockTime() - start_time) / GetCurrentClockFreq();
+        QueueResult<LayerDataDecodeResult>(result);
+    }
+}
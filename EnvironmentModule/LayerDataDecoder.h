@@ -0,0 +1,66 @@
+/**
+ *  For conditions of distribution and use, see copyright notice in license.txt
+ *
+ *  @file   LayerDataDecoder.h
+ *  @brief  Decodes terrain height data of LayerData packets in a worker thread.
+ */
+
+#ifndef incl_EnvironmentModule_LayerDataDecoder_h
+#define incl_EnvironmentModule_LayerDataDecoder_h
+
+#include "ThreadTask.h"
+#include "TerrainDecoder.h"
+
+namespace Environment
+{
+    /// Request to decode the land patches of a LayerData packet in a worker thread.
+    class LayerDataDecodeRequest : public Foundation::ThreadTaskRequest
+    {
+    public:
+        /// Copy of the layer data of the packet, starting with the Patch Group Header.
+        std::vector<u8> data_;
+    };
+
+    /// Decoded land patches of a LayerData packet.
+    class LayerDataDecodeResult : public Foundation::ThreadTaskResult
+    {
+    public:
+        LayerDataDecodeResult() : num_decoded_(0), decode_time_(0.0) {}
+
+        /// Patch Group Header of the packet.
+        TerrainPatchGroupHeader header_;
+
+        /// The decoded patches.
+        std::vector<DecodedTerrainPatch> patches_;
+
+        /// Number of patches in the packet.
+        uint num_decoded_;
+
+        /// Time spent in the worker thread, in seconds.
+        f64 decode_time_;
+    };
+
+    typedef boost::shared_ptr<LayerDataDecodeRequest> LayerDataDecodeRequestPtr;
+    typedef boost::shared_ptr<LayerDataDecodeResult> LayerDataDecodeResultPtr;
+
+    /// Decodes LayerData land patches in the thread pool, used by Terrain.
+    /** Processes one request at a time, in the order they were added, so that the patches of a later packet are never applied
+        before those of an earlier one. Terrain compares the decoded heights against the EC_Terrain patches, and regenerates only
+        the patches that have changed.
+    */
+    class LayerDataDecoder : public Foundation::ThreadTask
+    {
+    public:
+        /// Constructor.
+        LayerDataDecoder();
+
+        /// @return Task description of the decoder.
+        static const std::string& GetTaskDescriptionStatic();
+
+    protected:
+        /// Decodes the patches of a packet. Called from the thread pool.
+        virtual void ProcessRequest(Foundation::ThreadTaskRequestPtr request);
+    };
+}
+
+#endif
@@ -9,6 +9,7 @@
 
 #include "Terrain.h"
 #include "TerrainDecoder.h"
+#include "LayerDataDecoder.h"
 #include "EnvironmentModule.h"
 
 #include "EC_Placeable.h"
@@ -22,7 +23,9 @@
 #include "ServiceManager.h"
 #include "RexTypes.h"
 #include "NetworkMessages/NetInMessage.h"
+#include "RealXtend/RexProtocolMessageViews.h"
 #include "Entity.h"
+#include "ThreadTaskManager.h"
 
 #include <OgreManualObject.h>
 #include <OgreSceneManager.h>
@@ -487,19 +490,18 @@ namespace Environment
 
         PROFILE(HandleOSNE_LayerData);
 
-        ProtocolUtilities::NetInMessage &msg = *data->message;
-        u8 layerID = msg.ReadU8();
-        UNREFERENCED_PARAM(layerID);
-        size_t sizeBytes = 0;
-        const uint8_t *packedData = msg.ReadBuffer(&sizeBytes);
-        if (!packedData)
+        ProtocolUtilities::LayerDataView view;
+        if (!view.Parse(*data->message))
+        {
+            EnvironmentModule::LogWarning("Malformed LayerData packet received, ignoring.");
             return false;
-        ProtocolUtilities::BitStream bits(packedData, sizeBytes);
-        TerrainPatchGroupHeader header;
+        }
 
-        header.stride = bits.ReadBits(16);
-        header.patchSize = bits.ReadBits(8);
-        header.layerType = bits.ReadBits(8);
+        ProtocolUtilities::NetBufferRef packedData = view.LayerData().Data();
+        if (packedData.size == 0)
+            return false;
+        ProtocolUtilities::BitStream bits(packedData.data, packedData.size);
+        TerrainPatchGroupHeader header = DecodePatchGroupHeader(bits);
 
         switch(header.layerType)
         {
@@ -508,15 +510,13 @@ namespace Environment
             // First ensure that the Terrain really is in "OpenSim state".
             SetupOpenSimTerrainParameters();
 
-            std::vector<DecodedTerrainPatch> patches;
-            DecompressLand(patches, bits, header);
-            for(size_t i = 0; i < patches.size(); ++i)
-                CreateOrUpdateTerrainPatchHeightData(patches[i], header.patchSize);
-
-            // Now that we have updated all the height map data for each patch, see if
-            // we have enough of the patches loaded in to regenerate the GPU-side resources as well.
-            terrainComponent->RegenerateDirtyTerrainPatches();
-            emit HeightmapGeometryUpdated();
+            // The patches are decoded in a worker thread, and arrive to HandleDecodedLayerData().
+            LayerDataDecodeRequestPtr request(new LayerDataDecodeRequest());
+            request->data_.assign(packedData.data, packedData.data + packedData.size);
+            request_tag_t tag = owner_->GetFramework()->GetThreadTaskManager()->AddRequest<LayerDataDecodeRequest>(
+                LayerDataDecoder::GetTaskDescriptionStatic(), request);
+            if (tag)
+                layer_data_requests_.insert(tag);
             break;
         }
         case TPLayerWater:
@@ -536,6 +536,36 @@ namespace Environment
         return false;
     }
 
+    bool Terrain::HandleDecodedLayerData(LayerDataDecodeResult *result)
+    {
+        if (!result || result->task_description_ != LayerDataDecoder::GetTaskDescriptionStatic())
+            return false;
+        // Results of requests made by an earlier terrain are dropped.
+        if (!layer_data_requests_.erase(result->tag_))
+            return false;
+
+        PROFILE(Terrain_HandleDecodedLayerData);
+
+        EC_Terrain *terrainComponent = GetTerrainComponent();
+        if (!terrainComponent)
+        {
+            EnvironmentModule::LogWarning("EC_Terrain entity component is missing.");
+            return false;
+        }
+
+        if (result->patches_.empty())
+            return true;
+
+        for(size_t i = 0; i < result->patches_.size(); ++i)
+            CreateOrUpdateTerrainPatchHeightData(result->patches_[i], result->header_.patchSize);
+
+        // Now that we have updated all the height map data for each patch, see if
+        // we have enough of the patches loaded in to regenerate the GPU-side resources as well.
+        terrainComponent->RegenerateDirtyTerrainPatches();
+        emit HeightmapGeometryUpdated();
+        return true;
+    }
+
     void Terrain::SetTerrainTextures(const RexAssetID textures[num_terrain_textures])
     {
         bool texturesChanged = false;
@@ -32,6 +32,7 @@ namespace Environment
     class EC_Terrain;
     class EnvironmentModule;
     struct DecodedTerrainPatch;
+    class LayerDataDecodeResult;
 
     //! Handles the logic related to the OpenSim Terrain. Note - partially lacks support for multiple scenes - the Terrain object is not instantiated
     //! per-scene, but it contains data that should be stored per-scene. This doesn't affect anything unless we will some day actually have several scenes.
@@ -49,9 +50,13 @@ namespace Environment
         ~Terrain();
 
         //! Called to handle an OpenSim LayerData packet.
-        //! Decodes terrain data from a LayerData packet and generates terrain patches accordingly.
+        //! Passes the terrain data of a LayerData packet to LayerDataDecoder, to be decoded in a worker thread.
         bool HandleOSNE_LayerData(ProtocolUtilities::NetworkEventInboundData* data);
 
+        //! Called when LayerDataDecoder has decoded a LayerData packet. Updates the changed terrain patches.
+        //! @return True if the result was of a request made by this terrain.
+        bool HandleDecodedLayerData(LayerDataDecodeResult *result);
+
         //! The OpenSim terrain has a hardcoded size of four textures. When/if we lift that, change the amount here or remove altogether if dynamic.
         static const int num_terrain_textures = 4;
 
@@ -130,6 +135,9 @@ namespace Environment
         float height_ranges_[num_terrain_textures];
 
         Scene::EntityWeakPtr cachedTerrainEntity_;
+
+        /// Tags of the LayerData decode requests not yet completed.
+        std::set<request_tag_t> layer_data_requests_;
     };
 }
 
@@ -14,6 +14,11 @@
 #include "TerrainDecoder.h"
 #include "EnvironmentModule.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TERRAINDECODER_SSE2
+#include <emmintrin.h>
+#endif
+
 namespace Environment
 {
 
@@ -33,10 +38,15 @@ public:
         BuildQuantizeTable16();
         SetupCosines16();
         BuildCopyMatrix16();
+        BuildIDCTMatrices16();
     }
 
     float dequantizeTable16[16*16];
     float cosineTable16[16*16];
+    /// The IDCT of a column as a matrix, [u*16 + n], the DC term weighted by 1/sqrt(2).
+    float columnIDCT16[16*16];
+    /// The IDCT of a row as a matrix, [u*16 + n], also scaled by 2/16.
+    float lineIDCT16[16*16];
     int copyMatrix16[16*16];
     float quantizeTable16[16*16];
 
@@ -63,6 +73,17 @@ public:
                 cosineTable16[u*16 + n] = (float)cosf((2.0f * (float)n + 1.0f) * (float)u * hposz);
     }
 
+    void BuildIDCTMatrices16()
+    {
+        const float oosob = 2.0f / 16.0f;
+        for (int u = 0; u < 16; u++)
+            for (int n = 0; n < 16; n++)
+            {
+                columnIDCT16[u*16 + n] = (u == 0) ? OO_SQRT2 : cosineTable16[u*16 + n];
+                lineIDCT16[u*16 + n] = columnIDCT16[u*16 + n] * oosob;
+            }
+    }
+
     void BuildCopyMatrix16()
     {
         bool diag = false;
@@ -136,10 +157,32 @@ TerrainPatchHeader DecodePatchHeader(ProtocolUtilities::BitStream &bits)
    return header;
 }
 
+/// Reads bits one at a time, the way BitStream::ReadBits used to. Used by the reference decoder.
+u32 ReadBitsOneByOne(ProtocolUtilities::BitStream &bits, int count)
+{
+    u8 data[4] = { 0 };
+    int cur_byte = 0;
+    int cur_bit = 0;
+    int total_bits = std::min(8, count);
+    while(count-- > 0)
+    {
+        if (bits.ReadBit())
+            data[cur_byte] |= 1 << (total_bits - 1 - cur_bit);
+        if (++cur_bit >= 8)
+        {
+            ++cur_byte;
+            cur_bit = 0;
+            total_bits = std::min(8, count);
+        }
+    }
+    return data[0] | (data[1] << 8) | (data[2] << 16) | (data[3] << 24);
+}
+
 /// Code adapted from libopenmetaverse.org project, TerrainCompressor.cs / TerrainManager.cs
 /// @param patches [out] The resulting patch data will be output here. The size of this buffer must be >= size*size.
 /// @param size The number of points in the patch in one direction (patches are square). 
-void DecodeTerrainPatch(int *patches, ProtocolUtilities::BitStream &bits, const TerrainPatchHeader &header, int size)
+/// @param reference If true, the coefficients are read one bit at a time.
+void DecodeTerrainPatch(int *patches, ProtocolUtilities::BitStream &bits, const TerrainPatchHeader &header, int size, bool reference)
 {
     for(int i = 0; i < size * size; ++i)
     {
@@ -168,7 +211,7 @@ void DecodeTerrainPatch(int *patches, ProtocolUtilities::BitStream &bits, const
         }
 
         bool signNegative = bits.ReadBit();
-        u32 data = (u32)bits.ReadBits(header.wordBits);
+        u32 data = reference ? ReadBitsOneByOne(bits, header.wordBits) : bits.ReadBits(header.wordBits);
         patches[i] = signNegative ? -(s32)data : (s32)data;
     }
 }
@@ -212,10 +255,105 @@ void IDCTLine16(const float *linein, float *lineout, int line)
     }
 }
 
+/// Performs the IDCT of a 16x16 block as two matrix products, first of the columns and then of the rows.
+/// The innermost loops run over 16 consecutive floats, so the compiler can vectorize them. Rows and columns of
+/// coefficients that are all zero, typically most of the high frequencies, are skipped.
+void IDCT16(const float *block, float *output)
+{
+    int rows[16];
+    int numRows = 0;
+    int columns[16];
+    int numColumns = 0;
+    for(int u = 0; u < 16; ++u)
+    {
+        bool rowZero = true;
+        bool columnZero = true;
+        for(int i = 0; i < 16; ++i)
+        {
+            rowZero &= (block[u*16 + i] == 0.0f);
+            columnZero &= (block[i*16 + u] == 0.0f);
+        }
+        if (!rowZero)
+            rows[numRows++] = u;
+        if (!columnZero)
+            columns[numColumns++] = u;
+    }
+
+    float temp[16*16];
+#ifdef TERRAINDECODER_SSE2
+    for(int n = 0; n < 16; ++n)
+    {
+        __m128 total0 = _mm_setzero_ps(), total1 = _mm_setzero_ps(), total2 = _mm_setzero_ps(), total3 = _mm_setzero_ps();
+        for(int i = 0; i < numRows; ++i)
+        {
+            const float *in = &block[rows[i]*16];
+            const __m128 k = _mm_set1_ps(precompTables.columnIDCT16[rows[i]*16 + n]);
+            total0 = _mm_add_ps(total0, _mm_mul_ps(_mm_loadu_ps(in), k));
+            total1 = _mm_add_ps(total1, _mm_mul_ps(_mm_loadu_ps(in + 4), k));
+            total2 = _mm_add_ps(total2, _mm_mul_ps(_mm_loadu_ps(in + 8), k));
+            total3 = _mm_add_ps(total3, _mm_mul_ps(_mm_loadu_ps(in + 12), k));
+        }
+        _mm_storeu_ps(&temp[n*16], total0);
+        _mm_storeu_ps(&temp[n*16 + 4], total1);
+        _mm_storeu_ps(&temp[n*16 + 8], total2);
+        _mm_storeu_ps(&temp[n*16 + 12], total3);
+    }
+
+    // The columns that were zero in the coefficients are zero in every row of temp as well.
+    for(int line = 0; line < 16; ++line)
+    {
+        __m128 total0 = _mm_setzero_ps(), total1 = _mm_setzero_ps(), total2 = _mm_setzero_ps(), total3 = _mm_setzero_ps();
+        for(int i = 0; i < numColumns; ++i)
+        {
+            const __m128 k = _mm_set1_ps(temp[line*16 + columns[i]]);
+            const float *coeffs = &precompTables.lineIDCT16[columns[i]*16];
+            total0 = _mm_add_ps(total0, _mm_mul_ps(_mm_loadu_ps(coeffs), k));
+            total1 = _mm_add_ps(total1, _mm_mul_ps(_mm_loadu_ps(coeffs + 4), k));
+            total2 = _mm_add_ps(total2, _mm_mul_ps(_mm_loadu_ps(coeffs + 8), k));
+            total3 = _mm_add_ps(total3, _mm_mul_ps(_mm_loadu_ps(coeffs + 12), k));
+        }
+        _mm_storeu_ps(&output[line*16], total0);
+        _mm_storeu_ps(&output[line*16 + 4], total1);
+        _mm_storeu_ps(&output[line*16 + 8], total2);
+        _mm_storeu_ps(&output[line*16 + 12], total3);
+    }
+#else
+    for(int n = 0; n < 16; ++n)
+    {
+        float *total = &temp[n*16];
+        for(int c = 0; c < 16; ++c)
+            total[c] = 0.0f;
+        for(int i = 0; i < numRows; ++i)
+        {
+            const float *in = &block[rows[i]*16];
+            const float k = precompTables.columnIDCT16[rows[i]*16 + n];
+            for(int c = 0; c < 16; ++c)
+                total[c] += in[c] * k;
+        }
+    }
+
+    // The columns that were zero in the coefficients are zero in every row of temp as well.
+    for(int line = 0; line < 16; ++line)
+    {
+        float *total = &output[line*16];
+        for(int n = 0; n < 16; ++n)
+            total[n] = 0.0f;
+        for(int i = 0; i < numColumns; ++i)
+        {
+            const float k = temp[line*16 + columns[i]];
+            const float *coeffs = &precompTables.lineIDCT16[columns[i]*16];
+            for(int n = 0; n < 16; ++n)
+                total[n] += k * coeffs[n];
+        }
+    }
+#endif
+}
+
 /// Code adapted from libopenmetaverse.org project, TerrainCompressor.cs / TerrainManager.cs
-void DecompressTerrainPatch(std::vector<float> &output, int *patchData, const TerrainPatchHeader &patchHeader, const TerrainPatchGroupHeader &groupHeader)
+/// @param reference If true, uses the direct IDCT of IDCTColumn16 and IDCTLine16.
+void DecompressTerrainPatch(std::vector<float> &output, int *patchData, const TerrainPatchHeader &patchHeader, const TerrainPatchGroupHeader &groupHeader,
+    bool reference)
 {
-    std::vector<float> block(groupHeader.patchSize * groupHeader.patchSize);
     output.clear();
     output.resize(groupHeader.patchSize * groupHeader.patchSize);
 
@@ -231,49 +369,79 @@ void DecompressTerrainPatch(std::vector<float> &output, int *patchData, const Te
         return;
     }
 
+    float block[16*16];
     for(int n = 0; n < 16 * 16; n++)
         block[n] = patchData[precompTables.copyMatrix16[n]] * precompTables.dequantizeTable16[n];
 
-    std::vector<float> ftemp(16*16);
-
-    for (int o = 0; o < 16; o++)
-        IDCTColumn16(&block[0], &ftemp[0], o);
-    for (int o = 0; o < 16; o++)
-        IDCTLine16(&ftemp[0], &block[0], o);
+    if (reference)
+    {
+        float ftemp[16*16];
+        for (int o = 0; o < 16; o++)
+            IDCTColumn16(block, ftemp, o);
+        for (int o = 0; o < 16; o++)
+            IDCTLine16(ftemp, block, o);
+    }
+    else
+    {
+        float transformed[16*16];
+        IDCT16(block, transformed);
+        for(int n = 0; n < 16 * 16; n++)
+            block[n] = transformed[n];
+    }
 
-    for (int j = 0; j < block.size(); j++)
+    for (int j = 0; j < 16 * 16; j++)
         output[j] = block[j] * mult + addval;
 }
 
-} // ~unnamed namespace
-
 /// Code adapted from libopenmetaverse.org project, TerrainCompressor.cs / TerrainManager.cs
-void DecompressLand(std::vector<DecodedTerrainPatch> &patches, ProtocolUtilities::BitStream &bits, const TerrainPatchGroupHeader &groupHeader)
+void DecompressLandPatches(std::vector<DecodedTerrainPatch> &patches, ProtocolUtilities::BitStream &bits, const TerrainPatchGroupHeader &groupHeader,
+    bool reference)
 {
     while(bits.BitsLeft() > 0)
     {
-        DecodedTerrainPatch patch;
-        patch.header = DecodePatchHeader(bits);
+        TerrainPatchHeader header = DecodePatchHeader(bits);
 
-        if (patch.header.quantWBits == cEndOfPatches)
+        if (header.quantWBits == cEndOfPatches)
             break;
 
         const int cPatchesPerEdge = 16;
 
         // The MSB of header.x and header.y are unused, or used for some other purpose?
-        if (patch.header.x >= cPatchesPerEdge || patch.header.y >= cPatchesPerEdge)
+        if (header.x >= cPatchesPerEdge || header.y >= cPatchesPerEdge)
         {
             EnvironmentModule::LogWarning("TerrainDecoder:DecompressLand: Invalid patch data!");
             return;
         }
 
         int patchData[16*16];
-        DecodeTerrainPatch(patchData, bits, patch.header, groupHeader.patchSize);
+        DecodeTerrainPatch(patchData, bits, header, groupHeader.patchSize, reference);
 
-        DecompressTerrainPatch(patch.heightData, patchData, patch.header, groupHeader);
-
-        patches.push_back(patch); ///\todo Can optimize out a copy of heavy struct by push_backing early in the loop.
+        patches.push_back(DecodedTerrainPatch());
+        DecodedTerrainPatch &patch = patches.back();
+        patch.header = header;
+        DecompressTerrainPatch(patch.heightData, patchData, header, groupHeader, reference);
     }
 }
 
+} // ~unnamed namespace
+
+void DecompressLand(std::vector<DecodedTerrainPatch> &patches, ProtocolUtilities::BitStream &bits, const TerrainPatchGroupHeader &groupHeader)
+{
+    DecompressLandPatches(patches, bits, groupHeader, false);
+}
+
+void DecompressLandReference(std::vector<DecodedTerrainPatch> &patches, ProtocolUtilities::BitStream &bits, const TerrainPatchGroupHeader &groupHeader)
+{
+    DecompressLandPatches(patches, bits, groupHeader, true);
+}
+
+TerrainPatchGroupHeader DecodePatchGroupHeader(ProtocolUtilities::BitStream &bits)
+{
+    TerrainPatchGroupHeader header;
+    header.stride = bits.ReadBits(16);
+    header.patchSize = bits.ReadBits(8);
+    header.layerType = bits.ReadBits(8);
+    return header;
+}
+
 }
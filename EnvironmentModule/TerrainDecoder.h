@@ -48,11 +48,19 @@ namespace Environment
         TerrainPatchHeader header;
     };
 
+    /// Reads the Patch Group Header from the beginning of the data of a LayerData packet.
+    TerrainPatchGroupHeader DecodePatchGroupHeader(ProtocolUtilities::BitStream &bits);
+
     /// Decompresses a single patch of terrain height data from a LayerData packet.
+    /// Thread-safe, so it can be called from worker threads.
     /// @param patches [out] The resulting patch data will be output here.
     /// @param bits [in] The LayerData packet, of which the Patch Group Header has already been read.
     /// @param groupHeader 
     void DecompressLand(std::vector<DecodedTerrainPatch> &patches, ProtocolUtilities::BitStream &bits, const TerrainPatchGroupHeader &groupHeader);
+
+    /// Decompresses the patches like DecompressLand, but reads the stream one bit at a time and performs the IDCT
+    /// directly, like the original libopenmetaverse code. Slow, used to check and benchmark DecompressLand.
+    void DecompressLandReference(std::vector<DecodedTerrainPatch> &patches, ProtocolUtilities::BitStream &bits, const TerrainPatchGroupHeader &groupHeader);
 }
 
 #endif
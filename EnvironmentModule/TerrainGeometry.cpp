@@ -0,0 +1,229 @@
+/**
+ *  For conditions of distribution and use, see copyright notice in license.txt
+ *
+ *  @file   TerrainGeometry.cpp
+ *  @brief  Vertex and index data of the terrain patches, with distance-based LOD.
+ */
+
+#include "StableHeaders.h"
+
+#include "TerrainGeometry.h"
+#include "EC_Terrain.h"
+
+#include <OgreHardwareBufferManager.h>
+
+namespace Environment
+{
+    static const int cPatchSize = EC_Terrain::cPatchSize;
+
+    void TerrainGrid::Resize(int width, int height)
+    {
+        width_ = width;
+        height_ = height;
+        const size_t size = width * height;
+        heights_.resize(size);
+        normalX_.resize(size);
+        normalY_.resize(size);
+        normalZ_.resize(size);
+    }
+
+    void TerrainGrid::SetPatchHeights(int patchX, int patchY, const std::vector<float> &heightData)
+    {
+        for(int y = 0; y < cPatchSize; ++y)
+        {
+            float *row = &heights_[(patchY * cPatchSize + y) * width_ + patchX * cPatchSize];
+            if (heightData.size() < cPatchSize * cPatchSize)
+                std::fill(row, row + cPatchSize, 0.f);
+            else
+                std::copy(&heightData[y * cPatchSize], &heightData[y * cPatchSize] + cPatchSize, row);
+        }
+    }
+
+    void TerrainGrid::CalculateNormals(int firstRow, int lastRow)
+    {
+        if (width_ <= 0 || height_ <= 0)
+            return;
+        firstRow = std::max(firstRow, 0);
+        lastRow = std::min(lastRow, height_ - 1);
+
+        for(int y = firstRow; y <= lastRow; ++y)
+        {
+            const float *row = &heights_[y * width_];
+            const float *prev = &heights_[std::max(y - 1, 0) * width_];
+            const float *next = &heights_[std::min(y + 1, height_ - 1) * width_];
+            // As in EC_Terrain::CalculateNormal, the slope is doubled on the first row and column only.
+            const float yScale = (y == 0) ? 2.f : 1.f;
+            float *nx = &normalX_[y * width_];
+            float *ny = &normalY_[y * width_];
+            float *nz = &normalZ_[y * width_];
+
+            // Inner vertices. No branches or lookups through the patches, so that the compiler can vectorize this.
+            for(int x = 1; x < width_ - 1; ++x)
+            {
+                const float xSlope = row[x-1] - row[x+1];
+                const float ySlope = (prev[x] - next[x]) * yScale;
+                const float invLength = 1.f / sqrtf(xSlope * xSlope + ySlope * ySlope + 4.f);
+                nx[x] = xSlope * invLength;
+                ny[x] = ySlope * invLength;
+                nz[x] = 2.f * invLength;
+            }
+
+            // The first and last vertices of the row, with the lookups clamped to the row.
+            for(int x = 0; x < width_; x += std::max(width_ - 1, 1))
+            {
+                float xSlope = row[std::max(x - 1, 0)] - row[std::min(x + 1, width_ - 1)];
+                if (x == 0)
+                    xSlope *= 2.f;
+                const float ySlope = (prev[x] - next[x]) * yScale;
+                const float invLength = 1.f / sqrtf(xSlope * xSlope + ySlope * ySlope + 4.f);
+                nx[x] = xSlope * invLength;
+                ny[x] = ySlope * invLength;
+                nz[x] = 2.f * invLength;
+            }
+        }
+    }
+
+    void TerrainGrid::FillPatchVertices(int patchX, int patchY, float uScale, float vScale, float *vertices, float &minHeight, float &maxHeight) const
+    {
+        const int originX = patchX * cPatchSize;
+        const int originY = patchY * cPatchSize;
+        minHeight = std::numeric_limits<float>::max();
+        maxHeight = -std::numeric_limits<float>::max();
+
+        for(int y = 0; y < cTerrainPatchVertexSize; ++y)
+        {
+            const int gridY = std::min(originY + y, height_ - 1);
+            for(int x = 0; x < cTerrainPatchVertexSize; ++x)
+            {
+                const int gridX = std::min(originX + x, width_ - 1);
+                const int i = gridY * width_ + gridX;
+                const float height = heights_[i];
+                minHeight = std::min(minHeight, height);
+                maxHeight = std::max(maxHeight, height);
+
+                // These coordinates are directly generated to our Ogre coordinate system, i.e. are cycled from OpenSim XYZ -> our YZX.
+                // see OpenSimToOgreCoordinateAxes.
+                vertices[0] = (float)(gridX - originX);
+                vertices[1] = (float)(gridY - originY);
+                vertices[2] = height;
+                vertices[3] = normalX_[i];
+                vertices[4] = normalY_[i];
+                vertices[5] = normalZ_[i];
+                vertices[6] = gridX * uScale;
+                vertices[7] = gridY * vScale;
+                vertices += cTerrainVertexFloats;
+            }
+        }
+    }
+
+    int TerrainPatchIndexKey(int lod, const int stitch[4])
+    {
+        int key = lod;
+        for(int i = 0; i < 4; ++i)
+            key = (key << 2) | std::min(stitch[i], cNumTerrainLods - 1);
+        return key;
+    }
+
+    /// Appends a triangle of the given grid points to the index list, wound counterclockwise as seen from above.
+    static void AddTerrainTriangle(std::vector<u16> &indices, int x0, int y0, int x1, int y1, int x2, int y2)
+    {
+        const int cross = (x1 - x0) * (y2 - y0) - (x2 - x0) * (y1 - y0);
+        if (cross == 0)
+            return;
+        if (cross < 0)
+        {
+            std::swap(x1, x2);
+            std::swap(y1, y2);
+        }
+        indices.push_back(y0 * cTerrainPatchVertexSize + x0);
+        indices.push_back(y1 * cTerrainPatchVertexSize + x1);
+        indices.push_back(y2 * cTerrainPatchVertexSize + x2);
+    }
+
+    /// Returns the grid point at distance t along the given patch edge (-x, +x, -y, +y) and distance d inwards from it.
+    static void GetTerrainEdgePoint(int edge, int t, int d, int &x, int &y)
+    {
+        const int last = cTerrainPatchVertexSize - 1;
+        switch(edge)
+        {
+        case 0: x = d; y = t; break;
+        case 1: x = last - d; y = t; break;
+        case 2: x = t; y = d; break;
+        default: x = t; y = last - d; break;
+        }
+    }
+
+    void GenerateTerrainPatchIndices(int key, std::vector<u16> &indices)
+    {
+        // Spacing of the vertices on each edge, as used by the neighbour on that side: -x, +x, -y, +y.
+        int edgeStep[4];
+        for(int i = 3; i >= 0; --i, key >>= 2)
+            edgeStep[i] = key & 3;
+        const int lod = key & 3;
+        const int step = 1 << lod;
+        for(int i = 0; i < 4; ++i)
+            edgeStep[i] = step << edgeStep[i];
+
+        const int last = cTerrainPatchVertexSize - 1;
+        indices.clear();
+        indices.reserve((last / step) * (last / step) * 6);
+
+        // Inner quads, two triangles each.
+        for(int y = step; y < last - step; y += step)
+            for(int x = step; x < last - step; x += step)
+            {
+                AddTerrainTriangle(indices, x, y, x + step, y, x, y + step);
+                AddTerrainTriangle(indices, x + step, y, x + step, y + step, x, y + step);
+            }
+
+        // The outermost ring of quads is triangulated one edge at a time, between the vertices of the edge at the spacing of
+        // the neighbour and the inner vertices one step in, so that the edge matches the neighbour and leaves no cracks.
+        for(int edge = 0; edge < 4; ++edge)
+        {
+            const int outerStep = edgeStep[edge];
+            int outer = 0;
+            int inner = step;
+            while(outer < last || inner < last - step)
+            {
+                int x0, y0, x1, y1, x2, y2;
+                GetTerrainEdgePoint(edge, outer, 0, x0, y0);
+                GetTerrainEdgePoint(edge, inner, step, x2, y2);
+                if (inner >= last - step || (outer < last && outer + outerStep <= inner + step))
+                {
+                    GetTerrainEdgePoint(edge, outer + outerStep, 0, x1, y1);
+                    outer += outerStep;
+                }
+                else
+                {
+                    GetTerrainEdgePoint(edge, inner + step, step, x1, y1);
+                    inner += step;
+                }
+                AddTerrainTriangle(indices, x0, y0, x1, y1, x2, y2);
+            }
+        }
+    }
+
+    Ogre::HardwareIndexBufferSharedPtr TerrainIndexBufferCache::GetIndexBuffer(int key, size_t &indexCount)
+    {
+        assert(key >= 0 && key < cNumTerrainPatchIndexKeys);
+        if (buffers_.empty())
+        {
+            buffers_.resize(cNumTerrainPatchIndexKeys);
+            indexCounts_.resize(cNumTerrainPatchIndexKeys, 0);
+        }
+
+        Ogre::HardwareIndexBufferSharedPtr &buffer = buffers_[key];
+        if (buffer.isNull())
+        {
+            std::vector<u16> indices;
+            GenerateTerrainPatchIndices(key, indices);
+            buffer = Ogre::HardwareBufferManager::getSingleton().createIndexBuffer(Ogre::HardwareIndexBuffer::IT_16BIT,
+                indices.size(), Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY);
+            buffer->writeData(0, buffer->getSizeInBytes(), &indices[0], true);
+            indexCounts_[key] = indices.size();
+        }
+
+        indexCount = indexCounts_[key];
+        return buffer;
+    }
+}
@@ -0,0 +1,93 @@
+/**
+ *  For conditions of distribution and use, see copyright notice in license.txt
+ *
+ *  @file   TerrainGeometry.h
+ *  @brief  Vertex and index data of the terrain patches, with distance-based LOD.
+ */
+
+#ifndef incl_EnvironmentModule_TerrainGeometry_h
+#define incl_EnvironmentModule_TerrainGeometry_h
+
+#include <OgreHardwareIndexBuffer.h>
+
+namespace Environment
+{
+    /// Number of vertices on each side of a patch. The last row and column are shared with the next patches.
+    static const int cTerrainPatchVertexSize = 17;
+
+    /// Number of vertices in a patch.
+    static const int cTerrainPatchVertexCount = cTerrainPatchVertexSize * cTerrainPatchVertexSize;
+
+    /// Number of floats in a patch vertex: position xyz, normal xyz and texture coordinate uv.
+    static const int cTerrainVertexFloats = 8;
+
+    /// Number of geometry LOD levels. LOD level n uses every 2^n'th vertex of a patch.
+    static const int cNumTerrainLods = 4;
+
+    /// Heights and normals of the whole terrain, one vertex per height map point, stored in contiguous rows.
+    class TerrainGrid
+    {
+    public:
+        TerrainGrid() : width_(0), height_(0) {}
+
+        /// Resizes the grid. The contents are undefined until set again.
+        void Resize(int width, int height);
+
+        /// Copies the 16x16 heights of a patch into the grid. Empty height data sets the patch flat at zero.
+        void SetPatchHeights(int patchX, int patchY, const std::vector<float> &heightData);
+
+        /// Calculates the normals of the rows firstRow to lastRow, inclusive, in one pass.
+        /** Gives the same normals as EC_Terrain::CalculateNormal, but reads the neighbouring heights from the rows directly
+            instead of looking up the patch of each, so that the loop over the inner vertices of a row vectorizes. */
+        void CalculateNormals(int firstRow, int lastRow);
+
+        /// Writes the vertices of a patch, including the shared last row and column, in the format of cTerrainVertexFloats.
+        /** At the far edges of the terrain the last row and column repeat the edge vertices, so that all the patches can use
+            the same index buffers. Returns the range of the heights in the patch in minHeight and maxHeight. */
+        void FillPatchVertices(int patchX, int patchY, float uScale, float vScale, float *vertices, float &minHeight, float &maxHeight) const;
+
+        int Width() const { return width_; }
+        int Height() const { return height_; }
+
+        /// Returns the height at the given grid point, which must be inside the grid.
+        float GetHeight(int x, int y) const { return heights_[y * width_ + x]; }
+
+    private:
+        int width_;
+        int height_;
+        std::vector<float> heights_;
+        std::vector<float> normalX_;
+        std::vector<float> normalY_;
+        std::vector<float> normalZ_;
+    };
+
+    /// Returns the key of the index buffer of a patch drawn at the given LOD level.
+    /// @param stitch How many LOD levels coarser the neighbours at -x, +x, -y and +y are than this patch, zero if not coarser.
+    int TerrainPatchIndexKey(int lod, const int stitch[4]);
+
+    /// Number of different index buffer keys.
+    static const int cNumTerrainPatchIndexKeys = 1 << 10;
+
+    /// Generates the triangle list of a patch for the given index buffer key.
+    /** The edges bordering a coarser neighbour use only the vertices the neighbour has, so that the edges of the two
+        patches match and leave no cracks. */
+    void GenerateTerrainPatchIndices(int key, std::vector<u16> &indices);
+
+    /// Shares the index buffers of the patches between all the patches of a terrain.
+    class TerrainIndexBufferCache
+    {
+    public:
+        /// Returns the index buffer of the given key, creating it on first use.
+        /// @param indexCount [out] Number of indices in the buffer.
+        Ogre::HardwareIndexBufferSharedPtr GetIndexBuffer(int key, size_t &indexCount);
+
+        /// Releases the buffers. The patch meshes still using them keep them alive.
+        void Clear() { buffers_.clear(); indexCounts_.clear(); }
+
+    private:
+        std::vector<Ogre::HardwareIndexBufferSharedPtr> buffers_;
+        std::vector<size_t> indexCounts_;
+    };
+}
+
+#endif
@@ -29,6 +29,8 @@ ComponentManager::ComponentManager(Foundation::Framework *framework) : framework
     attributeTypes_.push_back("qvariant");
     attributeTypes_.push_back("qvariantlist");
     attributeTypes_.push_back("transform");
+
+    typeNames_.push_back(QString());
 }
 
 void ComponentManager::RegisterFactory(const QString &component, const ComponentFactoryPtr &factory)
@@ -130,3 +132,26 @@ QStringList ComponentManager::GetAvailableComponentTypeNames() const
     return ret;
 }
 
+uint ComponentManager::GetComponentTypeId(const QString &type_name)
+{
+    QHash<QString, uint>::const_iterator iter = typeIds_.find(type_name);
+    if (iter != typeIds_.end())
+        return iter.value();
+
+    uint type_id = typeNames_.size();
+    typeIds_.insert(type_name, type_id);
+    typeNames_.push_back(type_name);
+    return type_id;
+}
+
+uint ComponentManager::FindComponentTypeId(const QString &type_name) const
+{
+    return typeIds_.value(type_name, 0);
+}
+
+QString ComponentManager::GetComponentTypeName(uint type_id) const
+{
+    if (type_id >= (uint)typeNames_.size())
+        return QString();
+    return typeNames_[type_id];
+}
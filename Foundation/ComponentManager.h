@@ -7,6 +7,8 @@
 
 #include <map>
 
+#include <QHash>
+
 //! Scenegraph, entity and component model that together form a generic, extendable, lightweight scene model.
 /*! See \ref SceneModelPage "Scenes, entities and components" for details about the viewer's scene model.
 
@@ -74,6 +76,21 @@ public:
     //! Returns string list of available component type names.
     QStringList GetAvailableComponentTypeNames() const;
 
+    //! Returns the type id of a component type name, assigning a new id if the type name has none yet
+    /*! Type ids are small integers that stay the same for the lifetime of the framework, so entities and scenes can
+        look components up by type without comparing type names. Ids start from 1.
+        \param type_name type of the component
+    */
+    uint GetComponentTypeId(const QString &type_name);
+
+    //! Returns the type id of a component type name, or 0 if the type name has not been assigned an id
+    /*! \param type_name type of the component
+    */
+    uint FindComponentTypeId(const QString &type_name) const;
+
+    //! Returns the component type name of a type id, or empty string if the id is not assigned
+    QString GetComponentTypeName(uint type_id) const;
+
 private:
     //! Map of component factories
     ComponentFactoryMap factories_;
@@ -81,6 +98,12 @@ private:
     //! List of supported attribute types.
     QStringList attributeTypes_;
 
+    //! Component type ids by type name
+    QHash<QString, uint> typeIds_;
+
+    //! Component type names by type id. Index 0 is unused
+    QStringList typeNames_;
+
     //! Framework
     Foundation::Framework *framework_;
 };
@@ -18,7 +18,8 @@ bool EventManager::AddSubscriber(T* subscriber, QList<U>& subscribers, int prior
         if (subscribers[i].subscriber_ == subscriber)
         {
             subscribers[i].priority_ = priority;
-            qSort(subscribers.begin(), subscribers.end());
+            qStableSort(subscribers.begin(), subscribers.end());
+            InvalidateDispatchTable();
             return true;
         }
 
@@ -26,7 +27,8 @@ bool EventManager::AddSubscriber(T* subscriber, QList<U>& subscribers, int prior
     new_subscriber.subscriber_ = subscriber;
     new_subscriber.priority_ = priority;
     subscribers.append(new_subscriber);
-    qSort(subscribers.begin(), subscribers.end());
+    qStableSort(subscribers.begin(), subscribers.end());
+    InvalidateDispatchTable();
 
     return true;
 }
@@ -58,6 +60,7 @@ bool EventManager::RemoveSubscriber(T* subscriber, QList<U>& subscribers )
         if (subscribers[i].subscriber_ == subscriber)
         {
             subscribers.erase(subscribers.begin() + i);
+            InvalidateDispatchTable();
             return true;
         }
 
@@ -104,6 +107,8 @@ bool EventManager::UnregisterEventSubscriber(T* subscriber)
                 ++iter;
         }
 
+        if (ret2)
+            InvalidateDispatchTable();
         return (ret || ret2);
     }
 
@@ -120,6 +125,59 @@ bool EventManager::EventSubscriberExist(T* subscriber, QList<U>& subscribers)
     return false;
 }
 
+template <typename T, typename U>
+bool EventManager::AddSubscription(T* subscriber, QList<U>& subscribers, event_category_id_t category_id, event_id_t event_id, bool whole_category)
+{
+    for(int i = 0; i < subscribers.size(); ++i)
+        if (subscribers[i].subscriber_ == subscriber)
+        {
+            if (whole_category)
+            {
+                if (std::find(subscribers[i].categories_.begin(), subscribers[i].categories_.end(), category_id) == subscribers[i].categories_.end())
+                    subscribers[i].categories_.push_back(category_id);
+            }
+            else
+            {
+                std::pair<event_category_id_t, event_id_t> event = std::make_pair(category_id, event_id);
+                if (std::find(subscribers[i].events_.begin(), subscribers[i].events_.end(), event) == subscribers[i].events_.end())
+                    subscribers[i].events_.push_back(event);
+            }
+            InvalidateDispatchTable();
+            return true;
+        }
+
+    RootLogError("Tried to declare events for an unregistered event subscriber");
+    return false;
+}
+
+template <typename T>
+bool EventManager::SubscribeToEventCategory(T* subscriber, event_category_id_t category_id)
+{
+    IModule* module = dynamic_cast<IModule* >(subscriber);
+    if (module != 0)
+        return AddSubscription(module, module_subscribers_, category_id, 0, true);
+
+    IComponent* component = dynamic_cast<IComponent* >(subscriber);
+    if (component != 0)
+        return AddSubscription(component, component_subscribers_, category_id, 0, true);
+
+    return false;
+}
+
+template <typename T>
+bool EventManager::SubscribeToEvent(T* subscriber, event_category_id_t category_id, event_id_t event_id)
+{
+    IModule* module = dynamic_cast<IModule* >(subscriber);
+    if (module != 0)
+        return AddSubscription(module, module_subscribers_, category_id, event_id, false);
+
+    IComponent* component = dynamic_cast<IComponent* >(subscriber);
+    if (component != 0)
+        return AddSubscription(component, component_subscribers_, category_id, event_id, false);
+
+    return false;
+}
+
 template <typename T>
 bool EventManager::HasEventSubscriber(T* subscriber)
 {
@@ -139,30 +197,3 @@ bool EventManager::HasEventSubscriber(T* subscriber)
 
     return false;
  }
-
-template <typename T>
-bool EventManager::SendEvent(const EventSubscriber<T>& subs, event_category_id_t category_id, event_id_t event_id, IEventData* data) const
- {
-    T* subscriber = subs.subscriber_;
-    if (subscriber)
-    {
-        try
-        {
-            return subscriber->HandleEvent(category_id, event_id, data);
-        }
-        catch(const std::exception &/*e*/)
-        {
-            //std::cout << "HandleEvent caught an exception inside module " << module->Name() << ": " << (e.what() ? e.what() : "(null)") << std::endl;
-            //RootLogCritical(std::string("HandleEvent caught an exception inside module " + module->Name() + ": " + (e.what() ? e.what() : "(null)")));
-            throw;
-        }
-        catch(...)
-        {
-            //std::cout << "HandleEvent caught an unknown exception inside module " << module->Name() << std::endl;
-            //RootLogCritical(std::string("HandleEvent caught an unknown exception inside module " + module->Name()));
-            throw;
-        }
-    }
-
-    return false;
-}
@@ -17,6 +17,7 @@
 #include <QThread>
 
 #include <algorithm>
+#include <sstream>
 
 #include "MemoryLeakCheck.h"
 
@@ -24,7 +25,10 @@ EventManager::EventManager(Foundation::Framework *framework) :
     framework_(framework),
     next_category_id_(1),
     next_request_tag_(1),
-    main_thread_id_(QThread::currentThreadId())
+    main_thread_id_(QThread::currentThreadId()),
+    dispatch_generation_(0),
+    delayed_event_time_(0.0),
+    next_delayed_serial_(0)
 {
 }
 
@@ -95,6 +99,9 @@ void EventManager::RegisterEvent(event_category_id_t category_id, event_id_t eve
         RootLogDebug("Registering event " + name);
 
     event_map_[category_id][event_id] = name;
+
+    // The profiling block names use the event names.
+    InvalidateDispatchTable();
 }
 
 bool EventManager::SendEvent(event_category_id_t category_id, event_id_t event_id, IEventData* data)
@@ -120,35 +127,95 @@ bool EventManager::SendEvent(event_category_id_t category_id, event_id_t event_i
     if (framework_->Asset())
         framework_->Asset()->HandleEvent(category_id, event_id, data);
 
-    // Send event in priority order, until someone returns true
-    for (int i = 0; i < module_subscribers_.size(); ++i)
-        if (SendEvent(module_subscribers_[i], category_id, event_id, data))
-            return true;
-
-    // After that send events to components
-    for (int i = 0; i < component_subscribers_.size(); ++i)
-        if (SendEvent(component_subscribers_[i], category_id, event_id, data))
+    // Send event in priority order, until someone returns true. Modules come first, then components,
+    // then the components registered to this event only.
+    DispatchListPtr list = GetDispatchList(category_id, event_id);
+#ifdef PROFILING
+    Foundation::ProfilerSection profile(list->profile_name_);
+#endif
+    uint generation = dispatch_generation_;
+    for(int i = 0; i < (int)list->targets_.size(); ++i)
+    {
+        const DispatchTarget target = list->targets_[i];
+        if (SendEvent(target, category_id, event_id, data))
             return true;
 
-    // Then go through 
-    QPair<event_category_id_t, event_id_t> group = qMakePair<event_category_id_t, event_id_t>(category_id, event_id);
-   
-    if ( specialEvents_.contains(group) )
-    {
-        QList<IComponent* >& lst = specialEvents_[group];
-        for ( int i = 0; i < lst.size(); ++i)
+        // If the handler changed the subscribers, continue from the same position in the new dispatch order.
+        if (dispatch_generation_ != generation)
         {
-            EventSubscriber<IComponent> subs;
-            subs.subscriber_ = lst[i];
-
-            if (SendEvent(subs, category_id, event_id, data))
-                return true;
+            list = GetDispatchList(category_id, event_id);
+            generation = dispatch_generation_;
+            std::vector<DispatchTarget>::const_iterator iter = std::find(list->targets_.begin(), list->targets_.end(), target);
+            if (iter != list->targets_.end())
+                i = iter - list->targets_.begin();
+            else
+                --i; // The handler unsubscribed itself, so the next receiver has taken its place.
         }
     }
 
     return false;
 }
 
+bool EventManager::SendEvent(const DispatchTarget& target, event_category_id_t category_id, event_id_t event_id, IEventData* data) const
+{
+    if (target.module_)
+        return target.module_->HandleEvent(category_id, event_id, data);
+    if (target.component_)
+        return target.component_->HandleEvent(category_id, event_id, data);
+    return false;
+}
+
+EventManager::DispatchListPtr EventManager::GetDispatchList(event_category_id_t category_id, event_id_t event_id)
+{
+    const std::pair<event_category_id_t, event_id_t> key = std::make_pair(category_id, event_id);
+    DispatchTable::const_iterator iter = dispatch_table_.find(key);
+    if (iter != dispatch_table_.end())
+        return iter->second;
+
+    DispatchListPtr list(new DispatchList());
+    for(int i = 0; i < module_subscribers_.size(); ++i)
+        if (module_subscribers_[i].subscriber_ && module_subscribers_[i].Handles(category_id, event_id))
+        {
+            DispatchTarget target = { module_subscribers_[i].subscriber_, 0 };
+            list->targets_.push_back(target);
+        }
+
+    for(int i = 0; i < component_subscribers_.size(); ++i)
+        if (component_subscribers_[i].subscriber_ && component_subscribers_[i].Handles(category_id, event_id))
+        {
+            DispatchTarget target = { 0, component_subscribers_[i].subscriber_ };
+            list->targets_.push_back(target);
+        }
+
+    QMap<QPair<event_category_id_t, event_id_t>, QList<IComponent* > >::const_iterator special = specialEvents_.constFind(qMakePair(category_id, event_id));
+    if (special != specialEvents_.constEnd())
+        for(int i = 0; i < special.value().size(); ++i)
+        {
+            DispatchTarget target = { 0, special.value()[i] };
+            list->targets_.push_back(target);
+        }
+
+    // Name the profiling block after the event, so that the profiler shows the number and duration of the dispatches of each event.
+    std::stringstream name;
+    name << "Event_" << QueryEventCategoryName(category_id) << "_";
+    EventMap::const_iterator category = event_map_.find(category_id);
+    std::map<event_id_t, std::string>::const_iterator event;
+    if (category != event_map_.end() && (event = category->second.find(event_id)) != category->second.end())
+        name << event->second;
+    else
+        name << event_id;
+    list->profile_name_ = name.str();
+
+    dispatch_table_[key] = list;
+    return list;
+}
+
+void EventManager::InvalidateDispatchTable()
+{
+    dispatch_table_.clear();
+    ++dispatch_generation_;
+}
+
 bool EventManager::SendEvent(const std::string& category, event_id_t event_id, IEventData* data)
 {
     return SendEvent(QueryEventCategory(category), event_id, data);
@@ -156,8 +223,6 @@ bool EventManager::SendEvent(const std::string& category, event_id_t event_id, I
 
 void EventManager::SendDelayedEvent(event_category_id_t category_id, event_id_t event_id, EventDataPtr data, f64 delay)
 {
-    MutexLock lock(delayed_events_mutex_);
-    
     // Do not send messages after exit
     if (framework_->IsExiting())
         return;
@@ -173,7 +238,9 @@ void EventManager::SendDelayedEvent(event_category_id_t category_id, event_id_t
     new_delayed_event.event_id_ = event_id;
     new_delayed_event.data_ = data;
     new_delayed_event.delay_ = delay;
-    new_delayed_events_.push_back(new_delayed_event);
+    new_delayed_event.due_time_ = 0.0;
+    new_delayed_event.serial_ = 0;
+    new_delayed_events_.Push(new_delayed_event);
 }
 
 bool EventManager::RegisterEventSubscriber(IComponent* component, event_category_id_t category_id, event_id_t event_id)
@@ -193,6 +260,7 @@ bool EventManager::RegisterEventSubscriber(IComponent* component, event_category
         specialEvents_.insert(group,lst);
     }
 
+    InvalidateDispatchTable();
     return true;
 }
 
@@ -211,6 +279,7 @@ bool EventManager::UnregisterEventSubscriber(IComponent* component, event_catego
         if (lst.empty())
             specialEvents_.remove(group);
         
+        InvalidateDispatchTable();
         return true;
    }
 
@@ -226,30 +295,37 @@ request_tag_t EventManager::GetNextRequestTag()
 
 void EventManager::ClearDelayedEvents()
 {
-    MutexLock lock(delayed_events_mutex_);
     delayed_events_.clear();
-    new_delayed_events_.clear();
+    incoming_delayed_events_.clear();
+    new_delayed_events_.Clear();
 }
 
 void EventManager::ProcessDelayedEvents(f64 frametime)
 {
+    // Move the new events to the heap. An event is due once the frametimes of the frames it has been
+    // pending for, counting this one, add up to its delay, so it is due relative to the clock before
+    // this frame is added.
+    incoming_delayed_events_.clear();
+    new_delayed_events_.PopAll(incoming_delayed_events_);
+    for(size_t i = 0; i < incoming_delayed_events_.size(); ++i)
     {
-        MutexLock lock(delayed_events_mutex_);
-        delayed_events_.insert(delayed_events_.end(), new_delayed_events_.begin(), new_delayed_events_.end());
-        new_delayed_events_.clear();
+        DelayedEvent& new_event = incoming_delayed_events_[i];
+        new_event.due_time_ = delayed_event_time_ + new_event.delay_;
+        new_event.serial_ = next_delayed_serial_++;
+        delayed_events_.push_back(new_event);
+        std::push_heap(delayed_events_.begin(), delayed_events_.end(), LaterDelayedEvent());
     }
+    incoming_delayed_events_.clear();
 
-    DelayedEventVector::iterator i = delayed_events_.begin();
-    while (i != delayed_events_.end())
-        if (i->delay_ <= 0.0)
-        {
-            SendEvent(i->category_id_, i->event_id_, i->data_.get());
-            i = delayed_events_.erase(i);
-        }
-        else
-        {
-            i->delay_ -= frametime;
-            ++i;
-        }
+    // Events sent from the handlers go to the intake queue, so the heap is not modified while sending.
+    while (!delayed_events_.empty() && delayed_events_.front().due_time_ <= delayed_event_time_)
+    {
+        std::pop_heap(delayed_events_.begin(), delayed_events_.end(), LaterDelayedEvent());
+        DelayedEvent due_event = delayed_events_.back();
+        delayed_events_.pop_back();
+        SendEvent(due_event.category_id_, due_event.event_id_, due_event.data_.get());
+    }
+
+    delayed_event_time_ += frametime;
 }
 
@@ -8,12 +8,17 @@
 #include "CoreThread.h"
 #include "IComponent.h"
 #include "Framework.h"
+#include "LockFreeMultiProducerQueue.h"
 
 #include <QList>
 #include <QtAlgorithms>
 #include <QMap>
 #include <QPair>
 
+#include <boost/unordered_map.hpp>
+
+#include <algorithm>
+
 class EventManager
 {
 public:
@@ -74,6 +79,7 @@ public:
     /*! Use with judgement. Note that you will not get to know whether event was handled. The event data object
         will be retained until event sent, so it should be allocated with new and wrapped inside a shared pointer.
         Delayed events are also the only safe way to send events from threads other than main thread!
+        Sending a delayed event is lock-free, so worker threads never wait for each other or the main thread.
         \param category_id Event category ID
         \param event_id Event ID
         \param data Shared pointer to event data structure (event-specific), can be 0 if not needed
@@ -108,6 +114,25 @@ public:
     template <typename T>
     bool UnregisterEventSubscriber(T* subscriber);
 
+    //! Declares that a registered module or component handles all the events of the given category
+    /*! A subscriber that has declared no categories or events gets sent every event. Once it declares some, it only
+        gets sent the events it has declared. Declarations are kept when the subscriber is resubscribed to change priority.
+        \param subscriber Module or component, registered first with RegisterEventSubscriber
+        \param category_id Event category ID
+        \return true if successful, false if the subscriber is not registered
+    */
+    template <typename T>
+    bool SubscribeToEventCategory(T* subscriber, event_category_id_t category_id);
+
+    //! Declares that a registered module or component handles the given event. See SubscribeToEventCategory.
+    /*! \param subscriber Module or component, registered first with RegisterEventSubscriber
+        \param category_id Event category ID
+        \param event_id Event ID
+        \return true if successful, false if the subscriber is not registered
+    */
+    template <typename T>
+    bool SubscribeToEvent(T* subscriber, event_category_id_t category_id, event_id_t event_id);
+
     //! Checks if module or component is registered as an event subscriber
     /*! \param module Module to check
         \return true if is registered
@@ -122,7 +147,8 @@ public:
     void ClearDelayedEvents();
 
     //! Processes delayed events. Called by the framework.
-    /*! \param frametime Time since last frame
+    /*! Only the events that are due are looked at, so pending events with long delays cost nothing per frame.
+        \param frametime Time since last frame
      */
     void ProcessDelayedEvents(f64 frametime);
 
@@ -167,6 +193,21 @@ private:
        
        T* subscriber_;
        int priority_;
+
+       //! Categories the subscriber handles all events of
+       std::vector<event_category_id_t> categories_;
+
+       //! Individual events the subscriber handles
+       std::vector<std::pair<event_category_id_t, event_id_t> > events_;
+
+       //! Returns true if the subscriber should be sent the given event
+       bool Handles(event_category_id_t category_id, event_id_t event_id) const
+       {
+            if (categories_.empty() && events_.empty())
+                return true;
+            return std::find(categories_.begin(), categories_.end(), category_id) != categories_.end() ||
+                std::find(events_.begin(), events_.end(), std::make_pair(category_id, event_id)) != events_.end();
+       }
       
        bool operator<(const EventSubscriber& rhs) const
        {
@@ -175,13 +216,51 @@ private:
       
    };
 
+   //! One receiver of an event in a dispatch list. Either the module or the component is set.
+   struct DispatchTarget
+   {
+        IModule *module_;
+        IComponent *component_;
+
+        bool operator==(const DispatchTarget& rhs) const { return module_ == rhs.module_ && component_ == rhs.component_; }
+   };
+
+   //! The receivers of one event in the order they are sent the event.
+   struct DispatchList
+   {
+        std::vector<DispatchTarget> targets_;
+
+        //! Name of the profiling block of the event
+        std::string profile_name_;
+   };
+   typedef boost::shared_ptr<DispatchList> DispatchListPtr;
+
    //! Delayed event. Used internally by EventManager.
    struct DelayedEvent
    {
         event_category_id_t category_id_;
         event_id_t event_id_;
         EventDataPtr data_;
+
+        //! Delay in seconds, as given to SendDelayedEvent
         f64 delay_;
+
+        //! Time the event is due, on the delayed event clock
+        f64 due_time_;
+
+        //! Order of arrival, to send events due at the same time in the order they were sent
+        uint serial_;
+   };
+
+   //! Orders the delayed event heap so that the event due first is on top
+   struct LaterDelayedEvent
+   {
+        bool operator()(const DelayedEvent& lhs, const DelayedEvent& rhs) const
+        {
+            if (lhs.due_time_ != rhs.due_time_)
+                return lhs.due_time_ > rhs.due_time_;
+            return lhs.serial_ > rhs.serial_;
+        }
    };
 
     /// Sends event to a module in the subscriber vector
@@ -191,8 +270,13 @@ private:
         @param data Pointer to event data structure (event-specific)
         @return true if event handled and further subscribers should not be processed
     */
-   template <typename T>
-   bool SendEvent(const EventSubscriber<T>& subs, event_category_id_t category_id, event_id_t event_id, IEventData* data) const;
+   bool SendEvent(const DispatchTarget& target, event_category_id_t category_id, event_id_t event_id, IEventData* data) const;
+
+    /// Returns the dispatch list of the given event, building it if the event has not been sent since the subscribers last changed
+    DispatchListPtr GetDispatchList(event_category_id_t category_id, event_id_t event_id);
+
+    /// Forgets all dispatch lists. Called whenever the subscribers or their declared events change.
+    void InvalidateDispatchTable();
 
    template <typename T, typename U>
    bool AddSubscriber(T* subscriber, QList<U>& subscribers, int priority);
@@ -203,6 +287,9 @@ private:
    template <typename T, typename U>
    bool EventSubscriberExist(T* subscriber, QList<U>& subscribers);
 
+   template <typename T, typename U>
+   bool AddSubscription(T* subscriber, QList<U>& subscribers, event_category_id_t category_id, event_id_t event_id, bool whole_category);
+
     //! Next event category ID that will be assigned
     event_category_id_t next_category_id_;
 
@@ -221,13 +308,22 @@ private:
     /// Component event subscribers
     QList<EventSubscriber<IComponent > > component_subscribers_;
 
-    //! Delayed events
     typedef std::vector<DelayedEvent> DelayedEventVector;
-    DelayedEventVector new_delayed_events_;
+
+    //! Delayed events sent since the last ProcessDelayedEvents, from any thread
+    LockFreeMultiProducerQueue<DelayedEvent> new_delayed_events_;
+
+    //! Pending delayed events, a min-heap by due time. Accessed from the main thread only.
     DelayedEventVector delayed_events_;
 
-    //! Mutex for new delayed events
-    Mutex delayed_events_mutex_;
+    //! Scratch space for taking the new delayed events, kept to avoid reallocating every frame
+    DelayedEventVector incoming_delayed_events_;
+
+    //! Sum of the frametimes given to ProcessDelayedEvents. The due times of delayed events are on this clock.
+    f64 delayed_event_time_;
+
+    //! Serial number of the next delayed event taken from the intake queue
+    uint next_delayed_serial_;
 
     //! Framework
     Foundation::Framework *framework_;
@@ -236,6 +332,14 @@ private:
     Qt::HANDLE main_thread_id_;
 
     QMap<QPair<event_category_id_t, event_id_t>, QList<IComponent* > > specialEvents_;
+
+    typedef boost::unordered_map<std::pair<event_category_id_t, event_id_t>, DispatchListPtr> DispatchTable;
+
+    //! Dispatch lists of the events sent since the subscribers last changed
+    DispatchTable dispatch_table_;
+
+    //! Incremented whenever the dispatch table is invalidated, so that a dispatch in progress notices the change
+    uint dispatch_generation_;
 };
 
 #include "EventManager-templates.h"
@@ -0,0 +1,107 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#ifndef incl_Foundation_LockFreeMultiProducerQueue_h
+#define incl_Foundation_LockFreeMultiProducerQueue_h
+
+#include <vector>
+#include <cassert>
+
+#include <QAtomicPointer>
+
+/** Implements an unbounded FIFO queue that any number of threads can push to without locking:
+    - Any thread may call Push(). A push is a single compare-and-swap, retried only if another
+      producer pushed at the same moment, so producers never block each other or the consumer.
+    - Only one thread (the consumer) may call PopAll() and Clear().
+    - The consumer takes all the pushed elements at once. Because single elements are never popped,
+      the queue is not subject to the ABA problem.
+    - The elements pushed by one thread are popped in the order that thread pushed them.
+      The order of the elements pushed by different threads is the order their pushes completed.
+
+    Each push allocates one node. Deliberately not following the naming of std::queue so that there
+    is no confusion that this behaves like a standard container. */
+template<typename T>
+class LockFreeMultiProducerQueue
+{
+    LockFreeMultiProducerQueue(const LockFreeMultiProducerQueue &); // N/I
+    void operator =(const LockFreeMultiProducerQueue &); // N/I
+public:
+    LockFreeMultiProducerQueue()
+    :head(0)
+    {
+    }
+
+    /// Deletes the elements that were not popped.
+    ~LockFreeMultiProducerQueue()
+    {
+        Clear();
+    }
+
+    /// Inserts a new element at the back of the queue. Thread-safe.
+    void Push(const T &value)
+    {
+        Node *node = new Node(value);
+        for(;;)
+        {
+            Node *top = head;
+            node->next = top;
+            if (head.testAndSetRelease(top, node))
+                return;
+        }
+    }
+
+    /// Removes all the elements from the queue. Call only from the consumer thread.
+    /// @param values [out] The removed elements are appended to this vector, oldest first.
+    /// @return The number of elements removed.
+    size_t PopAll(std::vector<T> &values)
+    {
+        Node *node = head.fetchAndStoreAcquire(0);
+
+        // The nodes are linked newest first, so write them to the vector backwards.
+        size_t count = 0;
+        for(Node *n = node; n; n = n->next)
+            ++count;
+
+        const size_t first = values.size();
+        values.resize(first + count);
+        for(size_t i = first + count; i > first; --i)
+        {
+            assert(node);
+            values[i - 1] = node->value;
+            Node *next = node->next;
+            delete node;
+            node = next;
+        }
+        return count;
+    }
+
+    /// Deletes all the elements in the queue. Call only from the consumer thread.
+    void Clear()
+    {
+        Node *node = head.fetchAndStoreAcquire(0);
+        while(node)
+        {
+            Node *next = node->next;
+            delete node;
+            node = next;
+        }
+    }
+
+    /// @return True if the queue is empty. The result is only a snapshot and may be stale by the time it is used.
+    bool IsEmpty() const { return const_cast<QAtomicPointer<Node> &>(head).fetchAndAddAcquire(0) == 0; }
+
+private:
+    struct Node
+    {
+        explicit Node(const T &v) : value(v), next(0) {}
+
+        T value;
+
+        /// The element pushed before this one.
+        Node *next;
+    };
+
+    /// The most recently pushed element, or 0 if the queue is empty.
+    QAtomicPointer<Node> head;
+};
+
+#endif
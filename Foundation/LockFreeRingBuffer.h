@@ -0,0 +1,106 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#ifndef incl_Foundation_LockFreeRingBuffer_h
+#define incl_Foundation_LockFreeRingBuffer_h
+
+#include <vector>
+#include <cassert>
+
+#include <QAtomicInt>
+
+/** Implements a bounded FIFO queue that is safe to use from exactly two threads without locking:
+    - Only one thread (the producer) may call Push().
+    - Only one thread (the consumer) may call Pop() and Front().
+    - The capacity is fixed at construction time and is rounded up to the next power of two.
+      One slot is always kept empty to tell a full queue from an empty one.
+    - Size(), IsEmpty() and IsFull() may be called from either thread, but the result is
+      only a snapshot and may be stale by the time it is used.
+
+    The element type should be cheap to copy, e.g. a pointer. Deliberately not following the naming
+    of std::queue so that there is no confusion that this behaves like a standard container. */
+template<typename T>
+class LockFreeRingBuffer
+{
+    LockFreeRingBuffer(const LockFreeRingBuffer &); // N/I
+    void operator =(const LockFreeRingBuffer &); // N/I
+public:
+    /// @param capacity The number of slots to allocate, rounded up to the next power of two.
+    explicit LockFreeRingBuffer(size_t capacity)
+    :head(0), tail(0)
+    {
+        size_t size = 2;
+        while(size < capacity)
+            size <<= 1;
+        data.resize(size);
+        mask = size - 1;
+    }
+
+    /// @return The maximum number of elements the queue can hold at the same time.
+    size_t Capacity() const { return mask; }
+
+    /// Inserts a new element at the back of the queue. Call only from the producer thread.
+    /// @return True if the element was added, false if the queue was full.
+    bool Push(const T &value)
+    {
+        const int t = (int)tail;
+        const int next = (int)((t + 1) & mask);
+        if (next == const_cast<QAtomicInt &>(head).fetchAndAddAcquire(0))
+            return false;
+
+        data[t] = value;
+        tail.fetchAndStoreRelease(next);
+        return true;
+    }
+
+    /// Removes the element at the front of the queue. Call only from the consumer thread.
+    /// @param value [out] Receives the removed element.
+    /// @return True if an element was removed, false if the queue was empty.
+    bool Pop(T &value)
+    {
+        const int h = (int)head;
+        if (h == tail.fetchAndAddAcquire(0))
+            return false;
+
+        value = data[h];
+        data[h] = T();
+        head.fetchAndStoreRelease((int)((h + 1) & mask));
+        return true;
+    }
+
+    /// @return A pointer to the element at the front of the queue, or 0 if the queue is empty.
+    ///         Call only from the consumer thread.
+    T *Front()
+    {
+        const int h = (int)head;
+        if (h == tail.fetchAndAddAcquire(0))
+            return 0;
+        return &data[h];
+    }
+
+    /// @return The number of elements currently in the queue.
+    size_t Size() const
+    {
+        const int h = const_cast<QAtomicInt &>(head).fetchAndAddAcquire(0);
+        const int t = const_cast<QAtomicInt &>(tail).fetchAndAddAcquire(0);
+        return (size_t)((t - h) & (int)mask);
+    }
+
+    bool IsEmpty() const { return Size() == 0; }
+
+    bool IsFull() const { return Size() == Capacity(); }
+
+private:
+    /// The element storage. Its size is always a power of two.
+    std::vector<T> data;
+
+    /// data.size() - 1, used to wrap the indices.
+    size_t mask;
+
+    /// Index of the next element to read. Written by the consumer thread only.
+    QAtomicInt head;
+
+    /// Index of the next free slot to write. Written by the producer thread only.
+    QAtomicInt tail;
+};
+
+#endif
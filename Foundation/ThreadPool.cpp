@@ -0,0 +1,155 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#include "StableHeaders.h"
+#include "Foundation.h"
+#include "ThreadPool.h"
+
+#include <boost/bind.hpp>
+
+namespace Foundation
+{
+    ThreadPool::ThreadPool(uint num_threads) :
+        queued_jobs_(0),
+        running_jobs_(0),
+        stolen_jobs_(0),
+        next_queue_(0),
+        stopping_(false)
+    {
+        if (!num_threads)
+        {
+            uint hardware_threads = boost::thread::hardware_concurrency();
+            num_threads = hardware_threads > 1 ? hardware_threads - 1 : 1;
+        }
+
+        for(uint i = 0; i < num_threads; ++i)
+            queues_.push_back(WorkerQueuePtr(new WorkerQueue()));
+
+        // Hold the state lock so that no worker looks up its index before all the ids are known
+        MutexLock lock(state_mutex_);
+        for(uint i = 0; i < num_threads; ++i)
+            thread_ids_.push_back(threads_.create_thread(boost::bind(&ThreadPool::Run, this, i))->get_id());
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            MutexLock lock(state_mutex_);
+            stopping_ = true;
+        }
+        idle_condition_.notify_all();
+        threads_.join_all();
+    }
+
+    void ThreadPool::Submit(const Job& job)
+    {
+        if (!job)
+        {
+            RootLogError("Null job passed to ThreadPool::Submit");
+            return;
+        }
+
+        uint index = GetWorkerIndex();
+        {
+            MutexLock lock(state_mutex_);
+            if (index >= queues_.size())
+                index = next_queue_++ % queues_.size();
+            ++queued_jobs_;
+        }
+
+        {
+            MutexLock lock(queues_[index]->mutex_);
+            queues_[index]->jobs_.push_back(job);
+        }
+        idle_condition_.notify_one();
+    }
+
+    uint ThreadPool::GetNumPendingJobs()
+    {
+        MutexLock lock(state_mutex_);
+        return queued_jobs_ + running_jobs_;
+    }
+
+    uint ThreadPool::GetNumStolenJobs()
+    {
+        MutexLock lock(state_mutex_);
+        return stolen_jobs_;
+    }
+
+    void ThreadPool::Run(uint index)
+    {
+        for(;;)
+        {
+            {
+                ScopedLock lock(state_mutex_);
+                while(!queued_jobs_ && !stopping_)
+                    idle_condition_.wait(lock);
+                // Run the remaining jobs before stopping, as their owners may be waiting for them
+                if (!queued_jobs_ && stopping_)
+                    return;
+            }
+
+            // The job is counted as queued before it is pushed, so it may not be visible yet
+            Job job;
+            if (!TakeJob(index, job))
+            {
+                boost::this_thread::yield();
+                continue;
+            }
+
+            job();
+            job.clear();
+
+            {
+                MutexLock lock(state_mutex_);
+                --running_jobs_;
+            }
+
+            RESETPROFILER
+        }
+    }
+
+    bool ThreadPool::TakeJob(uint index, Job& job)
+    {
+        {
+            MutexLock lock(queues_[index]->mutex_);
+            std::deque<Job>& jobs = queues_[index]->jobs_;
+            if (!jobs.empty())
+            {
+                job = jobs.front();
+                jobs.pop_front();
+            }
+        }
+
+        bool stolen = false;
+        for(uint i = 1; !job && i < queues_.size(); ++i)
+        {
+            WorkerQueue& victim = *queues_[(index + i) % queues_.size()];
+            MutexLock lock(victim.mutex_);
+            if (!victim.jobs_.empty())
+            {
+                job = victim.jobs_.back();
+                victim.jobs_.pop_back();
+                stolen = true;
+            }
+        }
+
+        if (!job)
+            return false;
+
+        MutexLock lock(state_mutex_);
+        --queued_jobs_;
+        ++running_jobs_;
+        if (stolen)
+            ++stolen_jobs_;
+        return true;
+    }
+
+    uint ThreadPool::GetWorkerIndex() const
+    {
+        boost::thread::id id = boost::this_thread::get_id();
+        for(uint i = 0; i < thread_ids_.size(); ++i)
+            if (thread_ids_[i] == id)
+                return i;
+        return thread_ids_.size();
+    }
+}
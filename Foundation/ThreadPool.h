@@ -0,0 +1,104 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#ifndef incl_Foundation_ThreadPool_h
+#define incl_Foundation_ThreadPool_h
+
+#include "CoreTypes.h"
+#include "CoreThread.h"
+
+#include <deque>
+#include <vector>
+
+#include <boost/function.hpp>
+
+namespace Foundation
+{
+    //! A pool of worker threads that run jobs, used by ThreadTaskManager to run pooled ThreadTasks.
+    /*! Each worker has its own job queue. Jobs submitted from a worker thread go to the queue of that worker,
+        other jobs are dealt to the queues in turn. A worker takes jobs from the front of its own queue, and when that
+        is empty, steals from the back of the queues of the other workers, so no core sits idle while there is work.
+        Idle workers sleep until a job is submitted.
+     */
+    class ThreadPool
+    {
+    public:
+        //! A unit of work
+        typedef boost::function<void ()> Job;
+
+        //! Constructor. Starts the worker threads.
+        /*! \param num_threads Number of worker threads. If 0, one less than the number of hardware threads, but at least one,
+                   so that the main thread keeps a core to itself
+         */
+        explicit ThreadPool(uint num_threads = 0);
+
+        //! Destructor. Runs the jobs that are still queued, then stops the worker threads.
+        ~ThreadPool();
+
+        //! Queues a job to be run by one of the worker threads. Thread-safe.
+        void Submit(const Job& job);
+
+        //! Returns the number of worker threads
+        uint GetNumThreads() const { return queues_.size(); }
+
+        //! Returns the number of jobs that are queued or running
+        uint GetNumPendingJobs();
+
+        //! Returns the number of jobs that were run by another worker than the one they were queued to
+        uint GetNumStolenJobs();
+
+    private:
+        ThreadPool(const ThreadPool&);
+        void operator=(const ThreadPool&);
+
+        //! The job queue of one worker
+        struct WorkerQueue
+        {
+            Mutex mutex_;
+            std::deque<Job> jobs_;
+        };
+        typedef boost::shared_ptr<WorkerQueue> WorkerQueuePtr;
+
+        //! Worker thread entry point
+        void Run(uint index);
+
+        //! Takes a job from the own queue of a worker, or failing that, steals one from another worker
+        /*! \return true if a job was taken
+         */
+        bool TakeJob(uint index, Job& job);
+
+        //! Returns the index of the worker the calling thread is, or GetNumThreads() if it is not a worker
+        uint GetWorkerIndex() const;
+
+        //! Job queues, one per worker
+        std::vector<WorkerQueuePtr> queues_;
+
+        //! Worker threads
+        boost::thread_group threads_;
+
+        //! Thread ids of the workers, in the same order as the queues
+        std::vector<boost::thread::id> thread_ids_;
+
+        //! Guards the counters below and the idle condition
+        Mutex state_mutex_;
+
+        //! Signaled when jobs are submitted or the pool is stopping
+        Condition idle_condition_;
+
+        //! Number of jobs submitted and not yet taken
+        uint queued_jobs_;
+
+        //! Number of jobs being run
+        uint running_jobs_;
+
+        //! Number of stolen jobs so far
+        uint stolen_jobs_;
+
+        //! Queue that the next job submitted from outside the pool goes to
+        uint next_queue_;
+
+        //! Set when the pool is being destroyed
+        bool stopping_;
+    };
+}
+
+#endif
@@ -5,15 +5,21 @@
 #include "ThreadTask.h"
 #include "ThreadTaskManager.h"
 #include "ForwardDefines.h"
+#include "ThreadPool.h"
+
+#include <boost/bind.hpp>
 
 namespace Foundation
 {
-    ThreadTask::ThreadTask(const std::string& task_description) :
+    ThreadTask::ThreadTask(const std::string& task_description, uint max_concurrency) :
         keep_running_(true),
         task_description_(task_description),
         task_manager_(0),
         running_(false),
-        finished_(false)
+        finished_(false),
+        max_concurrency_(max_concurrency),
+        active_runners_(0),
+        max_queued_results_(0)
     {
     }
 
@@ -28,16 +34,29 @@ namespace Foundation
         request_condition_.notify_one();
         
         thread_.join();
+
+        // Pooled runners notice the flag before taking their next request
+        ScopedLock lock(request_mutex_);
+        while (active_runners_)
+            runners_condition_.wait(lock);
     }
 
     void ThreadTask::AddRequest(ThreadTaskRequestPtr request)
     {
         if (request)
         {
-            if (!running_)
+            if (IsPooled() && task_manager_)
+            {
+                {
+                    MutexLock lock(request_mutex_);
+                    InsertRequest(request);
+                }
+                SchedulePooledRequests();
+            }
+            else if (!running_)
             {
                 thread_.join(); // Make sure it's really stopped, not just set the flag to false
-                requests_.push_back(request);
+                InsertRequest(request);
                 running_ = true;
                 finished_ = false;
                 thread_ = boost::thread(boost::ref(*this));
@@ -45,7 +64,7 @@ namespace Foundation
             else
             {
                 MutexLock lock(request_mutex_);
-                requests_.push_back(request);
+                InsertRequest(request);
             }
             request_condition_.notify_one();
         }
@@ -55,6 +74,120 @@ namespace Foundation
         }
     }
 
+    uint ThreadTask::GetNumPendingRequests()
+    {
+        MutexLock lock(request_mutex_);
+        return requests_.size();
+    }
+
+    bool ThreadTask::SetRequestPriority(request_tag_t tag, f32 priority)
+    {
+        MutexLock lock(request_mutex_);
+        std::list<ThreadTaskRequestPtr>::iterator i = requests_.begin();
+        while (i != requests_.end())
+        {
+            if ((*i)->tag_ == tag)
+            {
+                ThreadTaskRequestPtr request = *i;
+                requests_.erase(i);
+                request->priority_ = priority;
+                InsertRequest(request);
+                return true;
+            }
+            ++i;
+        }
+        
+        return false;
+    }
+
+    void ThreadTask::InsertRequest(ThreadTaskRequestPtr request)
+    {
+        // Most requests have the same priority, so look for the place from the back
+        std::list<ThreadTaskRequestPtr>::iterator i = requests_.end();
+        while (i != requests_.begin())
+        {
+            std::list<ThreadTaskRequestPtr>::iterator prev = i;
+            --prev;
+            if ((*prev)->priority_ >= request->priority_)
+                break;
+            i = prev;
+        }
+        requests_.insert(i, request);
+    }
+
+    void ThreadTask::Work()
+    {
+        while (ShouldRun())
+        {
+            WaitForRequests();
+
+            ThreadTaskRequestPtr request = GetNextRequest();
+            if (request)
+                ProcessRequest(request);
+
+            RESETPROFILER
+        }
+    }
+
+    void ThreadTask::SchedulePooledRequests()
+    {
+        ThreadPool* pool = task_manager_ ? task_manager_->GetThreadPool() : 0;
+        if (!pool)
+            return;
+
+        uint new_runners = 0;
+        {
+            MutexLock lock(request_mutex_);
+            if (!keep_running_ || HasTooManyQueuedResults())
+                return;
+            while (active_runners_ < max_concurrency_ && active_runners_ < requests_.size())
+            {
+                ++active_runners_;
+                ++new_runners;
+            }
+        }
+
+        for(uint i = 0; i < new_runners; ++i)
+            pool->Submit(boost::bind(&ThreadTask::RunPooledRequests, this));
+    }
+
+    void ThreadTask::RunPooledRequests()
+    {
+        for(;;)
+        {
+            ThreadTaskRequestPtr request;
+            {
+                // Requests added while this runner is returning see it as active and do not submit another,
+                // so decide to return under the same lock that they are added with
+                MutexLock lock(request_mutex_);
+                if (!keep_running_ || requests_.empty() || HasTooManyQueuedResults())
+                {
+                    --active_runners_;
+                    runners_condition_.notify_all();
+                    return;
+                }
+                request = requests_.front();
+                requests_.pop_front();
+            }
+
+            try
+            {
+                ProcessRequest(request);
+            }
+            catch(const std::exception& e)
+            {
+                RootLogError("Thread task " + task_description_ + " failed to process a request: " + e.what());
+            }
+        }
+    }
+
+    bool ThreadTask::HasTooManyQueuedResults()
+    {
+        if (!max_queued_results_ || !task_manager_)
+            return false;
+        return task_manager_->GetNumResults(task_description_) >= max_queued_results_;
+    }
+
     ThreadTaskResultPtr ThreadTask::GetResult() const
     {
         if (!finished_)
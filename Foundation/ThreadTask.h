@@ -15,13 +15,16 @@ namespace Foundation
     class ThreadTaskRequest
     {
     public:
-        ThreadTaskRequest() {}
+        ThreadTaskRequest() : priority_(0.0f) {}
         virtual ~ThreadTaskRequest() {}
         
         //! Request tag. Assigned when queuing the request & returned to caller.
         /*! Note: assigned by a ThreadTaskManager, not by ThreadTask itself
          */
         request_tag_t tag_;
+
+        //! Priority. Requests with higher priority are served first, requests with equal priority in the order they were added.
+        f32 priority_;
     };
 
     typedef boost::shared_ptr<ThreadTaskRequest> ThreadTaskRequestPtr;
@@ -44,6 +47,9 @@ namespace Foundation
         - one-shot, use SetResult() and terminate work thread
         - continuous, use QueueResult() to queue results to the thread task manager, while work thread keeps running
           In this mode a thread task manager is needed to post results to, otherwise results will be lost
+        - pooled, implement ProcessRequest() instead of Work(). The requests are run on the thread pool of the thread task
+          manager, several at a time up to the concurrency given in the constructor, and the task has no thread of its own.
+          Without a thread task manager, a pooled task serves its requests one at a time in its own thread.
      */
     class ThreadTask
     {
@@ -54,7 +60,9 @@ namespace Foundation
         /*! \param task_description Description of the work this thread will be doing. Should be unique,
             if work requests are to be communicated via the foundation's default ThreadTaskManager
          */
-        ThreadTask(const std::string& task_description);
+        /*! \param max_concurrency If non-zero, the task is pooled, and at most this many of its requests are processed at the same time
+         */
+        ThreadTask(const std::string& task_description, uint max_concurrency = 0);
         
         //! Destructor
         /*! Calls Stop(). Note that in subclass destructors, it would be safest to call Stop() first, at least before
@@ -90,6 +98,25 @@ namespace Foundation
 
         //! Checks if work thread has been run & finished
         bool HasFinished() const { return finished_; }
+
+        //! Checks if the requests of the task are run on the thread pool of the thread task manager
+        bool IsPooled() const { return max_concurrency_ > 0; }
+
+        //! Returns the number of requests waiting to be processed
+        uint GetNumPendingRequests();
+
+        //! Changes the priority of a request that is waiting to be processed
+        /*! \param tag Request tag
+            \param priority New priority
+            \return true if the request was found waiting
+         */
+        bool SetRequestPriority(request_tag_t tag, f32 priority);
+
+        //! Sets how many results of a pooled task may wait in the thread task manager before no more requests are processed
+        /*! Processing resumes when the results are taken from the thread task manager.
+            \param max_results Maximum amount of queued results, 0 for no limit
+         */
+        void SetMaxQueuedResults(uint max_results) { max_queued_results_ = max_results; }
         
         //! Commands the work thread to stop after current iteration is complete (continuous tasks only)
         void Stop();
@@ -100,8 +127,15 @@ namespace Foundation
     protected:
         //! Performs work thread activity.
         /*! Note: if doing a loop, check ShouldRun() function and terminate when it returns false
+            The default implementation serves the requests with ProcessRequest() until stopped.
+         */
+        virtual void Work();
+
+        //! Processes one request. Implement for pooled tasks.
+        /*! May be called from several threads at the same time, as many as the concurrency of the task.
+            \param request Request to process
          */
-        virtual void Work() = 0;
+        virtual void ProcessRequest(ThreadTaskRequestPtr request) {}
         
         //! Waits for request queue to contain at least one item, or ShouldRun() becomes false
         /*! \return true if a request did arrive, false if ShouldRun() becomes false
@@ -160,6 +194,18 @@ namespace Foundation
         /*! \param manager Task manager
          */
         void SetThreadTaskManager(ThreadTaskManager* manager) { task_manager_ = manager; }
+
+        //! Submits pooled request runners to the thread pool, up to the concurrency of the task
+        void SchedulePooledRequests();
+
+        //! Processes requests in a pool thread, until there are none left or the task is stopped or throttled
+        void RunPooledRequests();
+
+        //! Checks if the thread task manager holds as many results of this task as allowed
+        bool HasTooManyQueuedResults();
+
+        //! Inserts a request to the request queue by its priority. Call with the request mutex locked, or before the work thread runs.
+        void InsertRequest(ThreadTaskRequestPtr request);
         
         //! Task description
         std::string task_description_;
@@ -169,7 +215,7 @@ namespace Foundation
         Mutex result_mutex_;
         //! Condition for request queue
         Condition request_condition_;
-        //! Request queue
+        //! Request queue, highest priority first
         std::list<ThreadTaskRequestPtr> requests_;
         //! Work thread
         Thread thread_;
@@ -183,6 +229,14 @@ namespace Foundation
         bool running_;
         //! Finished flag
         bool finished_;
+        //! Maximum number of requests processed at the same time in the thread pool, 0 if not pooled
+        uint max_concurrency_;
+        //! Number of request runners submitted to the thread pool and not yet returned
+        uint active_runners_;
+        //! Signaled when a request runner returns
+        Condition runners_condition_;
+        //! Maximum number of results in the thread task manager before processing stops, 0 for no limit
+        uint max_queued_results_;
     };
     
     typedef boost::shared_ptr<ThreadTask> ThreadTaskPtr;
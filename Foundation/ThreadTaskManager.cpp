@@ -5,12 +5,14 @@
 #include "ForwardDefines.h"
 #include "Framework.h"
 #include "EventManager.h"
+#include "ThreadPool.h"
 
 namespace Foundation
 {
 
-    ThreadTaskManager::ThreadTaskManager(Framework* framework) :
-        framework_(framework)
+    ThreadTaskManager::ThreadTaskManager(Framework* framework, uint num_pool_threads) :
+        framework_(framework),
+        num_pool_threads_(num_pool_threads)
     {
     }
 
@@ -108,19 +110,31 @@ namespace Foundation
     {
         if (request)
         {
+            ThreadTaskPtr least_loaded;
+            uint least_pending = 0;
             std::vector<ThreadTaskPtr>::iterator i = tasks_.begin();
             while (i != tasks_.end())
             {
                 if ((*i)->GetTaskDescription() == task_description)
                 {
-                    request_tag_t tag = framework_->GetEventManager()->GetNextRequestTag();
-                    request->tag_ = tag;
-                    (*i)->AddRequest(request);
-                    return tag;
+                    uint pending = (*i)->GetNumPendingRequests();
+                    if (!least_loaded || pending < least_pending)
+                    {
+                        least_loaded = *i;
+                        least_pending = pending;
+                    }
                 }
                 ++i;
             }
             
+            if (least_loaded)
+            {
+                request_tag_t tag = framework_->GetEventManager()->GetNextRequestTag();
+                request->tag_ = tag;
+                least_loaded->AddRequest(request);
+                return tag;
+            }
+            
             RootLogError("No thread task matching task description " + task_description + ", could not queue request");
         }
         else
@@ -131,6 +145,19 @@ namespace Foundation
         return 0;
     }
     
+    bool ThreadTaskManager::SetRequestPriority(const std::string& task_description, request_tag_t tag, f32 priority)
+    {
+        std::vector<ThreadTaskPtr>::iterator i = tasks_.begin();
+        while (i != tasks_.end())
+        {
+            if (((*i)->GetTaskDescription() == task_description) && ((*i)->SetRequestPriority(tag, priority)))
+                return true;
+            ++i;
+        }
+        
+        return false;
+    }
+    
     void ThreadTaskManager::QueueResult(ThreadTaskResultPtr result)
     {
         MutexLock lock(result_mutex_);
@@ -183,6 +210,7 @@ namespace Foundation
             results_.clear();
         }
         
+        ResumePooledTasks();
         return results;
     }
 
@@ -220,6 +248,7 @@ namespace Foundation
             }
         }
         
+        ResumePooledTasks();
         return results;
     }
 
@@ -246,4 +275,23 @@ namespace Foundation
         
         return num;
     }
+
+    ThreadPool* ThreadTaskManager::GetThreadPool()
+    {
+        MutexLock lock(thread_pool_mutex_);
+        if (!thread_pool_)
+            thread_pool_.reset(new ThreadPool(num_pool_threads_));
+        return thread_pool_.get();
+    }
+
+    void ThreadTaskManager::ResumePooledTasks()
+    {
+        std::vector<ThreadTaskPtr>::iterator i = tasks_.begin();
+        while (i != tasks_.end())
+        {
+            if ((*i)->IsPooled())
+                (*i)->SchedulePooledRequests();
+            ++i;
+        }
+    }
 }
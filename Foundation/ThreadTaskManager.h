@@ -5,14 +5,18 @@
 
 #include "ThreadTask.h"
 
+#include <boost/scoped_ptr.hpp>
+
 namespace Foundation
 {
     class Framework;
+    class ThreadPool;
     
     //! Manager of ThreadTasks.
     /*! Takes ownership of ThreadTasks to handle results from them. Necessary to use ThreadTasks in queued result mode.
         There exists a system-wide ThreadTaskManager in the framework, but nothing prevents you creating your own additional
         ThreadTaskManager and registering tasks to it instead.
+        The requests of pooled ThreadTasks are run on a work-stealing ThreadPool owned by the manager, which is created when first needed.
      */
     class ThreadTaskManager
     {
@@ -21,8 +25,9 @@ namespace Foundation
     public:
         //! Constructor
         /*! \param framework Framework, needed for sending events
+            \param num_pool_threads Number of threads in the thread pool, 0 to size it by the hardware
          */
-        explicit ThreadTaskManager(Framework* framework);
+        explicit ThreadTaskManager(Framework* framework, uint num_pool_threads = 0);
         
         //! Destructor
         ~ThreadTaskManager();
@@ -57,7 +62,7 @@ namespace Foundation
         /*! \param task_description Task description
             \param request Task request
             \return a non-zero request tag if request could be fulfilled, zero if not
-            Note: currently simply the first matching ThreadTask will be used; there is no load balancing
+            If several ThreadTasks match, the request goes to the one with the fewest pending requests
          */
         request_tag_t AddRequest(const std::string& task_description, ThreadTaskRequestPtr request);
         
@@ -71,6 +76,14 @@ namespace Foundation
             return AddRequest(task_description, boost::dynamic_pointer_cast<ThreadTaskRequest>(request));
         }
         
+        //! Changes the priority of a request that is waiting to be processed
+        /*! \param task_description Task description
+            \param tag Request tag, as returned by AddRequest
+            \param priority New priority, higher is served first
+            \return true if the request was found waiting
+         */
+        bool SetRequestPriority(const std::string& task_description, request_tag_t tag, f32 priority);
+        
         //! Checks for results and sends them as events. Deletes finished ThreadTasks.
         /*! Framework calls this for the system-wide ThreadTaskManager on each run of the main loop.
          */
@@ -87,6 +100,9 @@ namespace Foundation
         
         //! Gets amount of results in queue for certain task type
         uint GetNumResults(const std::string& task_description);
+
+        //! Gets the thread pool that runs pooled tasks, creating it if necessary. Thread-safe.
+        ThreadPool* GetThreadPool();
         
     private:
         //! Queues a result. Called from ThreadTask work thread.
@@ -103,8 +119,20 @@ namespace Foundation
         //! Result queue mutex
         Mutex result_mutex_;
         
+        //! Resumes the pooled tasks that stopped because too many of their results were queued
+        void ResumePooledTasks();
+
         //! Framework
         Framework* framework_;
+
+        //! Number of threads to create the thread pool with
+        uint num_pool_threads_;
+
+        //! Thread pool for pooled tasks, 0 until first needed. Destroyed only after the destructor has stopped the tasks.
+        boost::scoped_ptr<ThreadPool> thread_pool_;
+
+        //! Mutex for creating the thread pool
+        Mutex thread_pool_mutex_;
     };
 }
 
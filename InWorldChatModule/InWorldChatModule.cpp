@@ -58,6 +58,8 @@ void InWorldChatModule::Load()
 void InWorldChatModule::PostInitialize()
 {
     frameworkEventCategory_ = framework_->GetEventManager()->QueryEventCategory("Framework");
+    framework_->GetEventManager()->SubscribeToEvent(this, frameworkEventCategory_, Foundation::NETWORKING_REGISTERED);
+    framework_->GetEventManager()->SubscribeToEvent(this, frameworkEventCategory_, Foundation::WORLD_STREAM_READY);
 
     RegisterConsoleCommand(Console::CreateCommand("bbtest",
         "Adds a billboard to each entity in the scene.",
@@ -87,6 +89,11 @@ bool InWorldChatModule::HandleEvent(event_category_id_t category_id, event_id_t
                 networkStateEventCategory_ = framework_->GetEventManager()->QueryEventCategory("NetworkState");
                 networkInEventCategory_ = framework_->GetEventManager()->QueryEventCategory("NetworkIn");
 
+                EventManagerPtr event_manager = framework_->GetEventManager();
+                event_manager->SubscribeToEventCategory(this, networkStateEventCategory_);
+                event_manager->SubscribeToEvent(this, networkInEventCategory_, RexNetMsgGenericMessage);
+                event_manager->SubscribeToEvent(this, networkInEventCategory_, RexNetMsgChatFromSimulator);
+
                 return false;
             }
         }
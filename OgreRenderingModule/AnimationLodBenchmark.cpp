@@ -0,0 +1,150 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#include "StableHeaders.h"
+#include "AnimationLodBenchmark.h"
+#include "Renderer.h"
+#include "EC_Placeable.h"
+#include "EC_Mesh.h"
+#include "EC_AnimationController.h"
+#include "Framework.h"
+#include "ComponentManager.h"
+#include "HighPerfClock.h"
+
+#include <Ogre.h>
+
+#include <sstream>
+#include <iomanip>
+
+namespace OgreRenderer
+{
+    namespace
+    {
+        //! Frames left out at the start of each phase, while the animations settle
+        const uint warmup_frames = 10;
+
+        //! Distance between the avatars in the grid
+        const float spacing = 3.0f;
+
+        //! Avatar mesh and skeleton from the default media
+        const char* avatar_mesh = "avatar.mesh";
+        const char* avatar_skeleton = "avatar.skeleton";
+    }
+
+    AnimationLodBenchmark::AnimationLodBenchmark(Foundation::Framework* framework, Renderer* renderer, uint count, uint frames) :
+        framework_(framework),
+        renderer_(renderer),
+        count_(std::max(count, 1u)),
+        frames_(std::max(frames, 1u)),
+        old_enabled_(renderer->IsAnimationLodEnabled()),
+        frame_(0),
+        lod_(false)
+    {
+    }
+
+    AnimationLodBenchmark::~AnimationLodBenchmark()
+    {
+        controllers_.clear();
+        components_.clear();
+        renderer_->SetAnimationLodEnabled(old_enabled_);
+    }
+
+    bool AnimationLodBenchmark::Start()
+    {
+        // Measure without LOD first
+        renderer_->SetAnimationLodEnabled(false);
+
+        ComponentManagerPtr component_mgr = framework_->GetComponentManager();
+
+        // A square grid around the camera, feet a bit below eye level
+        Ogre::Camera* camera = renderer_->GetCurrentCamera();
+        Ogre::Vector3 center = camera->getDerivedPosition();
+        uint columns = (uint)ceil(sqrt((f64)count_));
+        float half_width = (columns - 1) * spacing * 0.5f;
+
+        QString animation;
+        for(uint i = 0; i < count_; ++i)
+        {
+            ComponentPtr placeable_ptr = component_mgr->CreateComponent(EC_Placeable::TypeNameStatic());
+            ComponentPtr mesh_ptr = component_mgr->CreateComponent(EC_Mesh::TypeNameStatic());
+            ComponentPtr controller_ptr = component_mgr->CreateComponent(EC_AnimationController::TypeNameStatic());
+            if (!placeable_ptr || !mesh_ptr || !controller_ptr)
+                return false;
+            components_.push_back(controller_ptr);
+            components_.push_back(mesh_ptr);
+            components_.push_back(placeable_ptr);
+
+            EC_Placeable* placeable = checked_static_cast<EC_Placeable*>(placeable_ptr.get());
+            EC_Mesh* mesh = checked_static_cast<EC_Mesh*>(mesh_ptr.get());
+            EC_AnimationController* controller = checked_static_cast<EC_AnimationController*>(controller_ptr.get());
+
+            placeable->SetPosition(Vector3df(center.x - half_width + (i % columns) * spacing,
+                center.y - half_width + (i / columns) * spacing, center.z - 2.0f));
+            mesh->SetPlaceable(placeable_ptr);
+            if (!mesh->SetMeshWithSkeleton(avatar_mesh, avatar_skeleton))
+                return false;
+            controller->SetMeshEntity(mesh);
+
+            if (animation.isEmpty())
+            {
+                QStringList available = controller->GetAvailableAnimations();
+                if (available.isEmpty())
+                    return false;
+                animation = available.front();
+            }
+
+            // Start from different time positions, so that the avatars do not move in step
+            controller->EnableAnimation(animation, true, 0.0f);
+            controller->SetAnimationTimePosition(animation, i * 0.37f);
+            controllers_.push_back(controller);
+        }
+
+        return true;
+    }
+
+    bool AnimationLodBenchmark::Update(f64 frametime)
+    {
+        tick_t start_time = GetCurrentClockTime();
+        for(uint i = 0; i < controllers_.size(); ++i)
+            controllers_[i]->Update(frametime);
+        f64 animation_time = (f64)(GetCurrentClockTime() - start_time) / GetCurrentClockFreq();
+
+        ++frame_;
+        if (frame_ > warmup_frames)
+        {
+            Phase& phase = lod_ ? reduced_ : full_;
+            ++phase.frames_;
+            phase.time_ += frametime;
+            phase.animation_time_ += animation_time;
+        }
+
+        if (frame_ < warmup_frames + frames_)
+            return false;
+        if (lod_)
+            return true;
+
+        renderer_->SetAnimationLodEnabled(true);
+        lod_ = true;
+        frame_ = 0;
+        return false;
+    }
+
+    std::string AnimationLodBenchmark::GetReport() const
+    {
+        std::stringstream ss;
+        ss << std::fixed << std::setprecision(2);
+        ss << "Animation LOD with " << controllers_.size() << " avatars, " << frames_ << " frames each, LOD distance "
+            << renderer_->GetAnimationLodDistance() << std::endl;
+
+        const Phase* phases[] = { &full_, &reduced_ };
+        const char* names[] = { "Full", "LOD" };
+        for(uint i = 0; i < 2; ++i)
+        {
+            const Phase& phase = *phases[i];
+            if (!phase.frames_)
+                continue;
+            ss << std::setw(5) << names[i] << ": frame time mean " << phase.time_ * 1000.0 / phase.frames_ << " ms, "
+                << "animation update mean " << phase.animation_time_ * 1000.0 / phase.frames_ << " ms" << std::endl;
+        }
+        return ss.str();
+    }
+}
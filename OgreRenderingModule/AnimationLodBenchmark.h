@@ -0,0 +1,96 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#ifndef incl_OgreRenderer_AnimationLodBenchmark_h
+#define incl_OgreRenderer_AnimationLodBenchmark_h
+
+namespace Foundation
+{
+    class Framework;
+}
+
+class EC_AnimationController;
+
+namespace OgreRenderer
+{
+    class Renderer;
+
+    //! Surrounds the camera with a crowd of animated avatars and compares the frame time with and without animation LOD
+    /*! Used by the animbench console command. The avatars are standalone placeable, mesh and animation controller
+        components outside any scene, so the benchmark updates their animation controllers itself. They are laid out
+        in a grid centred on the camera, so that some are behind it and some far away.
+     */
+    class AnimationLodBenchmark
+    {
+    public:
+        //! Constructor
+        /*! \param framework Framework, for creating the components
+            \param renderer Renderer
+            \param count How many avatars to create
+            \param frames How many frames to measure with and without animation LOD
+         */
+        AnimationLodBenchmark(Foundation::Framework* framework, Renderer* renderer, uint count, uint frames);
+
+        //! Destructor. Destroys the avatars and restores the animation LOD setting
+        ~AnimationLodBenchmark();
+
+        //! Creates the avatars around the camera and starts their animations
+        /*! \return false if the avatar mesh could not be loaded or has no animations
+         */
+        bool Start();
+
+        //! Updates the animations and records a frame
+        /*! \param frametime Time of the previous frame, in seconds
+            \return true when both phases have been measured
+         */
+        bool Update(f64 frametime);
+
+        //! Returns the frame times and animation update times
+        std::string GetReport() const;
+
+    private:
+        //! Measured values of a phase
+        struct Phase
+        {
+            Phase() : frames_(0), time_(0.0), animation_time_(0.0) {}
+
+            uint frames_;
+            f64 time_;
+            f64 animation_time_;
+        };
+
+        //! Framework
+        Foundation::Framework* framework_;
+
+        //! Renderer
+        Renderer* renderer_;
+
+        //! How many avatars to create
+        uint count_;
+
+        //! How many frames to measure per phase
+        uint frames_;
+
+        //! Animation LOD setting before the benchmark
+        bool old_enabled_;
+
+        //! Created components, kept alive until the end
+        std::vector<ComponentPtr> components_;
+
+        //! Animation controllers of the avatars
+        std::vector<EC_AnimationController*> controllers_;
+
+        //! Frames recorded in the current phase, including warmup frames
+        uint frame_;
+
+        //! Whether measuring with animation LOD
+        bool lod_;
+
+        //! Measurements without animation LOD
+        Phase full_;
+
+        //! Measurements with animation LOD
+        Phase reduced_;
+    };
+}
+
+#endif
@@ -6,6 +6,7 @@
 #include "EC_AnimationController.h"
 #include "Entity.h"
 #include "OgreRenderingModule.h"
+#include "Renderer.h"
 #include "RexNetworkUtils.h"
 
 #include <Ogre.h>
@@ -18,10 +19,22 @@ DEFINE_POCO_LOGGING_FUNCTIONS("EC_AnimationController")
 using namespace OgreRenderer;
 using namespace RexTypes;
 
+namespace
+{
+    //! Most frames between animation updates of a distant entity
+    const uint max_lod_interval = 8;
+
+    //! Spreads the updates of distant entities evenly over the frames
+    uint next_lod_frame = 0;
+}
+
 EC_AnimationController::EC_AnimationController(IModule* module) :
     IComponent(module->GetFramework()),
     animationState(this, "Animation state", ""),
-    mesh(0)
+    mesh(0),
+    renderer_(checked_static_cast<OgreRenderingModule*>(module)->GetRenderer()),
+    lod_time_(0.0),
+    lod_frame_(next_lod_frame++ % max_lod_interval)
 {
     ResetState();
     
@@ -34,7 +47,25 @@ EC_AnimationController::~EC_AnimationController()
 
 void EC_AnimationController::SetMeshEntity(EC_Mesh *new_mesh)
 {
+    if (mesh == new_mesh)
+        return;
+    
+    // The cached animation states belong to the Ogre entity of the mesh, which is recreated whenever the mesh is set
+    if (mesh)
+        QObject::disconnect(mesh, SIGNAL(OnMeshChanged()), this, SLOT(ForgetAnimationStates()));
     mesh = new_mesh;
+    if (mesh)
+        QObject::connect(mesh, SIGNAL(OnMeshChanged()), this, SLOT(ForgetAnimationStates()));
+    ForgetAnimationStates();
+}
+
+void EC_AnimationController::ForgetAnimationStates()
+{
+    for (AnimationMap::iterator i = animations_.begin(); i != animations_.end(); ++i)
+    {
+        i->second.state_ = 0;
+        i->second.tracks_.clear();
+    }
 }
 
 QStringList EC_AnimationController::GetAvailableAnimations()
@@ -72,13 +103,25 @@ void EC_AnimationController::Update(f64 frametime)
     Ogre::Entity* entity = GetEntity();
     if (!entity) 
         return;
+    if (animations_.empty())
+    {
+        lod_time_ = 0.0;
+        return;
+    }
+    
+    // Skipped frames are made up for on the next update
+    lod_time_ += frametime;
+    if (!IsUpdateDue(entity))
+        return;
+    frametime = lod_time_;
+    lod_time_ = 0.0;
     
     std::vector<QString> erase_list;
     
     // Loop through all animations & update them as necessary
     for (AnimationMap::iterator i = animations_.begin(); i != animations_.end(); ++i)
     {
-        Ogre::AnimationState* animstate = GetAnimationState(entity, i->first);
+        Ogre::AnimationState* animstate = GetAnimationState(entity, i->first, i->second);
         if (!animstate)
             continue;
             
@@ -190,7 +233,7 @@ void EC_AnimationController::Update(f64 frametime)
         // Loop through all high priority animations & update the lowpriority-blendmask based on their active tracks
         for (AnimationMap::iterator i = animations_.begin(); i != animations_.end(); ++i)
         {
-            Ogre::AnimationState* animstate = GetAnimationState(entity, i->first);
+            Ogre::AnimationState* animstate = i->second.state_;
             if (!animstate)
                 continue;            
             // Create blend mask if animstate doesn't have it yet
@@ -201,16 +244,11 @@ void EC_AnimationController::Update(f64 frametime)
             {
                 // High-priority animations get the full weight blend mask
                 animstate->_setBlendMaskData(&highpriority_mask_[0]);
-                if (!skel->hasAnimation(animstate->getAnimationName()))
-                    continue;
-                    
-                Ogre::Animation* anim = skel->getAnimation(animstate->getAnimationName());
                 
-                Ogre::Animation::NodeTrackIterator it = anim->getNodeTrackIterator();
-                while (it.hasMoreElements())
+                const std::vector<unsigned short>& tracks = i->second.tracks_;
+                for (uint j = 0; j < tracks.size(); ++j)
                 {
-                    Ogre::NodeAnimationTrack* track = it.getNext();
-                    unsigned id = track->getHandle();
+                    unsigned id = tracks[j];
                     // For each active track, reduce corresponding bone weight in lowpriority-blendmask 
                     // by this animation's weight
                     if (id < lowpriority_mask_.size())
@@ -225,7 +263,7 @@ void EC_AnimationController::Update(f64 frametime)
         // Now set the calculated blendmask on low-priority animations
         for (AnimationMap::iterator i = animations_.begin(); i != animations_.end(); ++i)
         {
-            Ogre::AnimationState* animstate = GetAnimationState(entity, i->first);
+            Ogre::AnimationState* animstate = i->second.state_;
             if (!animstate)
                 continue;    
             if (i->second.high_priority_ == false)
@@ -244,7 +282,11 @@ Ogre::Entity* EC_AnimationController::GetEntity()
     
     Ogre::Entity* entity = mesh->GetEntity();
     if (!entity)
+    {
+        // The mesh has been removed, the next one will be a new entity
+        ForgetAnimationStates();
         return 0;
+    }
     
     if (entity->getMesh()->getName() != mesh_name_)
     {
@@ -258,6 +300,7 @@ Ogre::Entity* EC_AnimationController::GetEntity()
 void EC_AnimationController::ResetState()
 {
     animations_.clear();
+    lod_time_ = 0.0;
 }
 
 Ogre::AnimationState* EC_AnimationController::GetAnimationState(Ogre::Entity* entity, const QString& name)
@@ -277,6 +320,60 @@ Ogre::AnimationState* EC_AnimationController::GetAnimationState(Ogre::Entity* en
         return 0;
 }
 
+Ogre::AnimationState* EC_AnimationController::GetAnimationState(Ogre::Entity* entity, const QString& name, Animation& animation)
+{
+    if (animation.state_)
+        return animation.state_;
+    
+    animation.state_ = GetAnimationState(entity, name);
+    animation.tracks_.clear();
+    if (!animation.state_ || !entity->hasSkeleton())
+        return animation.state_;
+    
+    // Remember the bones the animation moves, for the low-priority blend mask
+    Ogre::SkeletonInstance* skel = entity->getSkeleton();
+    const Ogre::String& animname = animation.state_->getAnimationName();
+    if (skel && skel->hasAnimation(animname))
+    {
+        Ogre::Animation::NodeTrackIterator it = skel->getAnimation(animname)->getNodeTrackIterator();
+        while (it.hasMoreElements())
+            animation.tracks_.push_back(it.getNext()->getHandle());
+    }
+    
+    return animation.state_;
+}
+
+bool EC_AnimationController::IsUpdateDue(Ogre::Entity* entity)
+{
+    uint frame = lod_frame_++;
+    
+    RendererPtr renderer = renderer_.lock();
+    if (!renderer || !renderer->IsAnimationLodEnabled())
+        return true;
+    Ogre::Camera* camera = renderer->GetCurrentCamera();
+    if (!camera)
+        return true;
+    
+    // Entities out of view are not animated at all, they catch up when they come back to view
+    if (!entity->isInScene() || !entity->isVisible())
+        return false;
+    const Ogre::AxisAlignedBox& box = entity->getWorldBoundingBox(true);
+    if (!camera->isVisible(box))
+        return false;
+    
+    // Beyond the LOD distance, halve the update rate each time the distance doubles
+    uint interval = 1;
+    float lod_distance = renderer->GetAnimationLodDistance();
+    if (lod_distance > 0.0f)
+    {
+        float distance = camera->getDerivedPosition().distance(box.getCenter());
+        for (float limit = lod_distance; distance > limit && interval < max_lod_interval; limit *= 2.0f)
+            interval *= 2;
+    }
+    
+    return (frame % interval) == 0;
+}
+
 bool EC_AnimationController::EnableExclusiveAnimation(const QString& name, bool looped, float fadein, float fadeout, bool high_priority)
 {
     // Disable all other active animations
@@ -309,6 +406,7 @@ bool EC_AnimationController::EnableAnimation(const QString& name, bool looped, f
     AnimationMap::iterator i = animations_.find(name);
     if (i != animations_.end())
     {
+        GetAnimationState(entity, name, i->second);
         i->second.phase_ = PHASE_FADEIN;
         i->second.num_repeats_ = (looped ? 0: 1);
         i->second.fade_period_ = fadein;
@@ -326,6 +424,7 @@ bool EC_AnimationController::EnableAnimation(const QString& name, bool looped, f
     newanim.high_priority_ = high_priority;
 
     animations_[name] = newanim;
+    GetAnimationState(entity, name, animations_[name]);
 
     return true;
 }
@@ -333,11 +432,12 @@ bool EC_AnimationController::EnableAnimation(const QString& name, bool looped, f
 bool EC_AnimationController::HasAnimationFinished(const QString& name)
 {
     Ogre::Entity* entity = GetEntity();
-    Ogre::AnimationState* animstate = GetAnimationState(entity, name);
+    AnimationMap::iterator i = animations_.find(name);
+    Ogre::AnimationState* animstate = (i != animations_.end()) ? GetAnimationState(entity, name, i->second) :
+        GetAnimationState(entity, name);
     if (!animstate) 
         return false;
 
-    AnimationMap::iterator i = animations_.find(name);
     if (i != animations_.end())
     {
         if ((!animstate->getLoop()) && ((i->second.speed_factor_ >= 0.f && animstate->getTimePosition() >= animstate->getLength()) ||
@@ -471,14 +571,14 @@ bool EC_AnimationController::SetAnimationPriority(const QString& name, bool high
 bool EC_AnimationController::SetAnimationTimePosition(const QString& name, float newPosition)
 {
     Ogre::Entity* entity = GetEntity();
-    Ogre::AnimationState* animstate = GetAnimationState(entity, name);
-    if (!animstate) 
-        return false;
         
     // See if we find this animation in the list of active animations
     AnimationMap::iterator i = animations_.find(name);
     if (i != animations_.end())
     {
+        Ogre::AnimationState* animstate = GetAnimationState(entity, name, i->second);
+        if (!animstate) 
+            return false;
         animstate->setTimePosition(newPosition);
         return true;
     }
@@ -167,6 +167,12 @@ public:
         //! current phase
         AnimationPhase phase_;
 
+        //! Ogre animation state, looked up on first use and kept until the Ogre entity changes
+        Ogre::AnimationState* state_;
+
+        //! Handles of the skeleton tracks the animation moves, for high-priority blending
+        std::vector<unsigned short> tracks_;
+
         Animation() :
             auto_stop_(false),
             fade_period_(0.0),
@@ -175,7 +181,8 @@ public:
             speed_factor_(1.0),
             num_repeats_(0),
             high_priority_(false),
-            phase_(PHASE_STOP)
+            phase_(PHASE_STOP),
+            state_(0)
         {
         }
     };
@@ -185,6 +192,9 @@ public:
     virtual ~EC_AnimationController();
     
     //! Updates animation(s) by elapsed time
+    /*! With animation LOD enabled in the renderer, entities far from the camera are updated only every few frames,
+        and entities outside the view not at all. The skipped time is added on the next update.
+     */
     void Update(f64 frametime);
     
 public slots:
@@ -310,6 +320,9 @@ private slots:
     //! Called when the parent entity has been set.
     void UpdateSignals();
 
+    //! Drops the cached animation states of the running animations. Called when the mesh entity has been recreated
+    void ForgetAnimationStates();
+
 private:
     //! Constructor
     /*! \param module renderer module
@@ -325,6 +338,17 @@ private:
         \return animationstate, or null if not found
      */
     Ogre::AnimationState* GetAnimationState(Ogre::Entity* entity, const QString& name);
+
+    //! Gets animationstate of a running animation, from the cache or from the Ogre entity
+    /*! \param entity Ogre entity
+        \param name Animation name
+        \param animation Running animation, whose cached state and tracks are set
+        \return animationstate, or null if not found
+     */
+    Ogre::AnimationState* GetAnimationState(Ogre::Entity* entity, const QString& name, Animation& animation);
+
+    //! Returns whether animations should be updated this frame, according to the distance and visibility of the entity
+    bool IsUpdateDue(Ogre::Entity* entity);
     
     //! Auto-associate mesh component if not yet set
     void AutoAssociateMesh();
@@ -334,6 +358,15 @@ private:
     
     //! Mesh entity component 
     EC_Mesh *mesh;
+
+    //! renderer
+    OgreRenderer::RendererWeakPtr renderer_;
+
+    //! Time not yet applied to the animations, while updates are skipped
+    f64 lod_time_;
+
+    //! Frame counter for the LOD update interval, started at a different value for each controller
+    uint lod_frame_;
     
     //! Current mesh name
     std::string mesh_name_;
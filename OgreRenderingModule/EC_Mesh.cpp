@@ -12,6 +12,7 @@
 #include "OgreMeshResource.h"
 #include "OgreMaterialResource.h"
 #include "OgreSkeletonResource.h"
+#include "StaticBatcher.h"
 #include <Ogre.h>
 #include <OgreTagPoint.h>
 
@@ -34,7 +35,8 @@ EC_Mesh::EC_Mesh(IModule* module) :
     renderer_(checked_static_cast<OgreRenderingModule*>(module)->GetRenderer()),
     entity_(0),
     adjustment_node_(0),
-    attached_(false)
+    attached_(false),
+    pendingMeshTag_(0)
 {
     static AttributeMetadata drawDistanceData("", "0", "10000");
     drawDistance.SetMetadata(&drawDistanceData);
@@ -65,6 +67,7 @@ EC_Mesh::~EC_Mesh()
         return;
     RendererPtr renderer = renderer_.lock();
         
+    CancelPendingMeshRequest();
     RemoveMesh();
     
     if (adjustment_node_)
@@ -561,6 +564,10 @@ bool EC_Mesh::SetMaterial(uint index, const std::string& material_name)
         return false;
     }
     
+    RendererPtr renderer = renderer_.lock();
+    if (renderer && renderer->GetStaticBatcher())
+        renderer->GetStaticBatcher()->Invalidate(entity_);
+    
     return true;
 }
 
@@ -720,6 +727,10 @@ void EC_Mesh::DetachEntity()
     if ((!attached_) || (!entity_) || (!placeable_))
         return;
         
+    RendererPtr renderer = renderer_.lock();
+    if (renderer && renderer->GetStaticBatcher())
+        renderer->GetStaticBatcher()->Remove(entity_);
+
     EC_Placeable* placeable = checked_static_cast<EC_Placeable*>(placeable_.get());
     Ogre::SceneNode* node = placeable->GetSceneNode();
     adjustment_node_->detachObject(entity_);
@@ -739,6 +750,10 @@ void EC_Mesh::AttachEntity()
     adjustment_node_->attachObject(entity_);
             
     attached_ = true;
+
+    RendererPtr renderer = renderer_.lock();
+    if (renderer && renderer->GetStaticBatcher())
+        renderer->GetStaticBatcher()->Add(entity_);
 }
 
 Ogre::Mesh* EC_Mesh::PrepareMesh(const std::string& mesh_name, bool clone)
@@ -809,7 +824,12 @@ void EC_Mesh::AttributeUpdated(IAttribute *attribute)
     if (attribute == &drawDistance)
     {
         if(entity_)
+        {
             entity_->setRenderingDistance(drawDistance.Get());
+            RendererPtr renderer = renderer_.lock();
+            if (renderer && renderer->GetStaticBatcher())
+                renderer->GetStaticBatcher()->Invalidate(entity_);
+        }
     }
     else if (attribute == &castShadows)
     {
@@ -823,6 +843,9 @@ void EC_Mesh::AttributeUpdated(IAttribute *attribute)
                 if (attachment_entities_[i])
                     attachment_entities_[i]->setCastShadows(castShadows.Get());
             }
+            RendererPtr renderer = renderer_.lock();
+            if (renderer && renderer->GetStaticBatcher())
+                renderer->GetStaticBatcher()->Invalidate(entity_);
         }
     }
     else if (attribute == &nodeTransformation)
@@ -859,10 +882,19 @@ void EC_Mesh::AttributeUpdated(IAttribute *attribute)
             if(QString::fromStdString(entity_->getMesh()->getName()) == meshResourceId.Get())
                 return;
 
-        tag = RequestResource(meshResourceId.Get().toStdString(), OgreRenderer::OgreMeshResource::GetTypeStatic());
+        // A mesh requested earlier and not yet received is no longer needed
+        CancelPendingMeshRequest();
+
+        std::string meshId = meshResourceId.Get().toStdString();
+        tag = RequestResource(meshId, OgreRenderer::OgreMeshResource::GetTypeStatic());
         if(tag)
+        {
             resRequestTags_[ResourceKeyPair(tag, OgreRenderer::OgreMeshResource::GetTypeStatic())] = 
                 boost::bind(&EC_Mesh::HandleMeshResourceEvent, this, _1, _2);
+            pendingMeshId_ = meshId;
+            pendingMeshTag_ = tag;
+            SetRequestLocation(meshId, tag);
+        }
         else
             RemoveMesh();
     }
@@ -913,6 +945,31 @@ bool EC_Mesh::HandleEvent(event_category_id_t category_id, event_id_t event_id,
     return false;
 }
 
+void EC_Mesh::SetRequestLocation(const std::string& id, request_tag_t tag)
+{
+    EC_Placeable* placeable = dynamic_cast<EC_Placeable*>(placeable_.get());
+    if (renderer_.expired() || !placeable || !placeable->GetSceneNode())
+        return;
+
+    // Meshes are mostly modeled about unit size and scaled to fit, so the scale tells the size well enough
+    Ogre::SceneNode* node = placeable->GetSceneNode();
+    const Ogre::Vector3& pos = node->_getDerivedPosition();
+    f32 radius = std::max(node->_getDerivedScale().length() * 0.5f, 0.5f);
+    renderer_.lock()->SetResourceRequestLocation(id, tag, Vector3df(pos.x, pos.y, pos.z), radius);
+}
+
+void EC_Mesh::CancelPendingMeshRequest()
+{
+    if (!pendingMeshTag_)
+        return;
+
+    resRequestTags_.erase(ResourceKeyPair(pendingMeshTag_, OgreRenderer::OgreMeshResource::GetTypeStatic()));
+    if (!renderer_.expired())
+        renderer_.lock()->CancelResourceRequest(pendingMeshId_, pendingMeshTag_);
+    pendingMeshId_.clear();
+    pendingMeshTag_ = 0;
+}
+
 request_tag_t EC_Mesh::RequestResource(const std::string& id, const std::string& type)
 {
     request_tag_t tag = 0;
@@ -956,6 +1013,11 @@ bool EC_Mesh::HandleMeshResourceEvent(event_id_t event_id, IEventData* data)
         return false;
     if (res->GetType() != OgreRenderer::OgreMeshResource::GetTypeStatic())
         return false;
+    if (event_data->tag_ == pendingMeshTag_)
+    {
+        pendingMeshId_.clear();
+        pendingMeshTag_ = 0;
+    }
     OgreRenderer::OgreMeshResource* meshResource = checked_static_cast<OgreRenderer::OgreMeshResource*>(res.get());
     UNREFERENCED_PARAM(meshResource);
     //! @todo for some reason compiler will have linking error if we try to call ResourceInterface's GetId inline method
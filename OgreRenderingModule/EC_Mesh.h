@@ -388,6 +388,12 @@ private:
     bool HandleMaterialResourceEvent(event_id_t event_id, IEventData* data);
     request_tag_t RequestResource(const std::string& id, const std::string& type);
     bool HasMaterialsChanged() const;
+
+    //! Tells the renderer where a requested resource will be used, to prioritize its download
+    void SetRequestLocation(const std::string& id, request_tag_t tag);
+
+    //! Withdraws the request of a mesh that has not been received yet
+    void CancelPendingMeshRequest();
     
     //! placeable component 
     ComponentPtr placeable_;
@@ -421,6 +427,10 @@ private:
     typedef boost::function<bool(event_id_t,IEventData*)> MeshEventHandlerFunction;
     typedef std::map<ResourceKeyPair, MeshEventHandlerFunction> MeshResourceHandlerMap;
     MeshResourceHandlerMap resRequestTags_;
+
+    //! Id and request tag of the mesh requested and not yet received, tag 0 if none
+    std::string pendingMeshId_;
+    request_tag_t pendingMeshTag_;
 };
 
 #endif
@@ -6,6 +6,7 @@
 #include "Entity.h"
 #include "EC_Placeable.h"
 #include "EC_OgreCustomObject.h"
+#include "StaticBatcher.h"
 
 #include <Ogre.h>
 
@@ -16,6 +17,7 @@ EC_OgreCustomObject::EC_OgreCustomObject(IModule* module) :
     renderer_(checked_static_cast<OgreRenderingModule*>(module)->GetRenderer()),
     entity_(0),
     attached_(false),
+    owns_mesh_(false),
     cast_shadows_(false),
     draw_distance_(0.0f)
 {
@@ -53,6 +55,53 @@ bool EC_OgreCustomObject::CommitChanges(Ogre::ManualObject* object)
             
     DestroyEntity();
     
+    if (!object->getNumSections())
+        return true;
+        
+    std::string mesh_name = renderer->GetUniqueObjectName();
+    try
+    {
+        object->convertToMesh(mesh_name);
+        object->clear();
+    }
+    catch (Ogre::Exception& e)
+    {
+        OgreRenderingModule::LogError("Could not convert manualobject to mesh: " + std::string(e.what()));
+        return false;
+    }
+    
+    owns_mesh_ = true;
+    if (!CreateEntity(mesh_name))
+    {
+        try
+        {
+            Ogre::MeshManager::getSingleton().remove(mesh_name);
+        }
+        catch (...) {}
+        owns_mesh_ = false;
+        return false;
+    }
+    
+    return true;
+}
+
+bool EC_OgreCustomObject::SetSharedMesh(const std::string& mesh_name)
+{
+    if (renderer_.expired())
+        return false;
+    
+    DestroyEntity();
+    
+    if (mesh_name.empty())
+        return true;
+    
+    return CreateEntity(mesh_name);
+}
+
+bool EC_OgreCustomObject::CreateEntity(const std::string& mesh_name)
+{
+    RendererPtr renderer = renderer_.lock();
+    
     // If placeable is not set yet, set it manually by searching it from the parent entity
     if (!placeable_)
     {
@@ -65,15 +114,8 @@ bool EC_OgreCustomObject::CommitChanges(Ogre::ManualObject* object)
         }
     }
     
-    if (!object->getNumSections())
-        return true;
-        
     try
     {
-        std::string mesh_name = renderer->GetUniqueObjectName();
-        object->convertToMesh(mesh_name);
-        object->clear();
-    
         Ogre::SceneManager* scene_mgr = renderer->GetSceneManager();
 
         entity_ = scene_mgr->createEntity(renderer->GetUniqueObjectName(), mesh_name);
@@ -89,13 +131,14 @@ bool EC_OgreCustomObject::CommitChanges(Ogre::ManualObject* object)
         }
         else
         {
-            OgreRenderingModule::LogError("Could not create entity from manualobject mesh");
+            OgreRenderingModule::LogError("Could not create entity from mesh " + mesh_name);
             return false;
         }
     }   
     catch (Ogre::Exception& e)
     {
-        OgreRenderingModule::LogError("Could not convert manualobject to mesh: " + std::string(e.what()));
+        OgreRenderingModule::LogError("Could not create entity from mesh " + mesh_name + ": " + std::string(e.what()));
+        entity_ = 0;
         return false;
     }
     
@@ -106,14 +149,24 @@ void EC_OgreCustomObject::SetDrawDistance(float draw_distance)
 {
     draw_distance_ = draw_distance;
     if (entity_)
+    {
         entity_->setRenderingDistance(draw_distance);
+        RendererPtr renderer = renderer_.lock();
+        if (renderer && renderer->GetStaticBatcher())
+            renderer->GetStaticBatcher()->Invalidate(entity_);
+    }
 }
 
 void EC_OgreCustomObject::SetCastShadows(bool enabled)
 {
     cast_shadows_ = enabled;
     if (entity_)
+    {
         entity_->setCastShadows(enabled);
+        RendererPtr renderer = renderer_.lock();
+        if (renderer && renderer->GetStaticBatcher())
+            renderer->GetStaticBatcher()->Invalidate(entity_);
+    }
 }
 
 bool EC_OgreCustomObject::SetMaterial(uint index, const std::string& material_name)
@@ -137,6 +190,10 @@ bool EC_OgreCustomObject::SetMaterial(uint index, const std::string& material_na
         return false;
     }
     
+    RendererPtr renderer = renderer_.lock();
+    if (renderer && renderer->GetStaticBatcher())
+        renderer->GetStaticBatcher()->Invalidate(entity_);
+    
     return true;
 }
 
@@ -169,6 +226,10 @@ void EC_OgreCustomObject::AttachEntity()
         Ogre::SceneNode* node = placeable->GetSceneNode();
         node->attachObject(entity_);
         attached_ = true;
+
+        RendererPtr renderer = renderer_.lock();
+        if (renderer && renderer->GetStaticBatcher())
+            renderer->GetStaticBatcher()->Add(entity_);
     }
 }
 
@@ -176,6 +237,10 @@ void EC_OgreCustomObject::DetachEntity()
 {
     if ((placeable_) && (attached_) && (entity_))
     {
+        RendererPtr renderer = renderer_.lock();
+        if (renderer && renderer->GetStaticBatcher())
+            renderer->GetStaticBatcher()->Remove(entity_);
+
         EC_Placeable* placeable = checked_static_cast<EC_Placeable*>(placeable_.get());
         Ogre::SceneNode* node = placeable->GetSceneNode();
         node->detachObject(entity_);
@@ -197,11 +262,15 @@ void EC_OgreCustomObject::DestroyEntity()
         std::string mesh_name = entity_->getMesh()->getName();
         scene_mgr->destroyEntity(entity_);
         entity_ = 0;
-        try
+        if (owns_mesh_)
         {
-            Ogre::MeshManager::getSingleton().remove(mesh_name);
+            try
+            {
+                Ogre::MeshManager::getSingleton().remove(mesh_name);
+            }
+            catch (...) {}
         }
-        catch (...) {}
+        owns_mesh_ = false;
     }
 }
 
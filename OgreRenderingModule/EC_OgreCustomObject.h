@@ -75,6 +75,13 @@ public:
      */
     bool CommitChanges(Ogre::ManualObject* object);
 
+    //! Creates the entity from an existing mesh, which may be shared by other objects
+    /*! The mesh is not removed when the entity is destroyed; whoever created it is responsible for that.
+        \param mesh_name name of the mesh
+        \return true if successful
+     */
+    bool SetSharedMesh(const std::string& mesh_name);
+
     //! Sets material on already committed geometry, similar to EC_Mesh
     /*! \param index submesh index
         \param material_name material name
@@ -113,6 +120,9 @@ private:
     
     //! removes old entity and mesh
     void DestroyEntity();
+
+    //! creates entity of the given mesh & attaches it to placeable
+    bool CreateEntity(const std::string& mesh_name);
     
     //! placeable component 
     ComponentPtr placeable_;
@@ -125,6 +135,9 @@ private:
     
     //! object attached to placeable -flag
     bool attached_;
+
+    //! whether the mesh was converted from a manual object by this component, and should be removed with the entity
+    bool owns_mesh_;
     
     //! whether should cast shadows
     bool cast_shadows_;
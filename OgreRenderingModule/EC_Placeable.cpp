@@ -4,6 +4,7 @@
 #include "OgreRenderingModule.h"
 #include "Renderer.h"
 #include "EC_Placeable.h"
+#include "StaticBatcher.h"
 #include <Ogre.h>
 #include <QDebug>
 
@@ -16,6 +17,7 @@ EC_Placeable::EC_Placeable(IModule* module) :
     link_scene_node_(0),
     attached_(false),
     select_priority_(0),
+    dynamic_(false),
     transform(this, "Transform"),
     position(this, "Position", QVector3D()),
     scale(this, "Scale", QVector3D())
@@ -40,6 +42,8 @@ EC_Placeable::~EC_Placeable()
         return;
     RendererPtr renderer = renderer_.lock();
     Ogre::SceneManager* scene_mgr = renderer->GetSceneManager();
+
+    SetDynamic(false);
                     
     if (scene_node_ && link_scene_node_)
     {
@@ -185,6 +189,30 @@ void EC_Placeable::SetScale(const Vector3df& newscale)
     AttachNode(); // Nodes become visible only after having their position set at least once
 }
 
+void EC_Placeable::SetDynamic(bool dynamic)
+{
+    if (dynamic == dynamic_)
+        return;
+    dynamic_ = dynamic;
+
+    if (renderer_.expired())
+        return;
+    RendererPtr renderer = renderer_.lock();
+    if (renderer->GetStaticBatcher())
+        renderer->GetStaticBatcher()->SetDynamic(link_scene_node_, dynamic);
+}
+
+void EC_Placeable::SetVisible(bool visible)
+{
+    scene_node_->setVisible(visible);
+
+    if (renderer_.expired())
+        return;
+    RendererPtr renderer = renderer_.lock();
+    if (renderer->GetStaticBatcher())
+        renderer->GetStaticBatcher()->VisibilityChanged(scene_node_);
+}
+
 void EC_Placeable::AttachNode()
 {
     if (renderer_.expired())
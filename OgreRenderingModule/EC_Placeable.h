@@ -143,6 +143,21 @@ public:
     /*! \param priority new select priority
      */
     void SetSelectPriority(int priority) { select_priority_ = priority; }
+
+    //! sets whether the node is moving continuously, for example by network velocity
+    /*! Entities under a dynamic placeable are drawn individually instead of being merged into static geometry.
+        \param dynamic whether the node is moving
+     */
+    void SetDynamic(bool dynamic);
+
+    //! returns whether the node is marked as moving continuously
+    bool IsDynamic() const { return dynamic_; }
+
+    //! shows or hides the node and the nodes attached to it
+    /*! Use instead of setting the visibility of the scene node directly, so that merged static geometry is updated at once.
+        \param visible whether the node is shown
+     */
+    void SetVisible(bool visible);
     
     //! gets parent placeable
     ComponentPtr GetParent() { return parent_; }
@@ -204,6 +219,12 @@ public slots:
     //! LookAt wrapper that accepts a QVector3D for py & js e.g. camera use
     void LookAt(const QVector3D look_at) { LookAt(Vector3df(look_at.x(), look_at.y(), look_at.z())); }
 
+    //! shows the node
+    void Show() { SetVisible(true); }
+
+    //! hides the node
+    void Hide() { SetVisible(false); }
+
 signals:
     //! emmitted when position has changed.
     void PositionChanged(const QVector3D &pos);
@@ -250,6 +271,9 @@ private:
     
     //! selection priority for picking
     int select_priority_;
+
+    //! moving continuously -flag
+    bool dynamic_;
 };
 
 #endif
@@ -0,0 +1,421 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#include "StableHeaders.h"
+#include "MeshBvh.h"
+#include "Profiler.h"
+
+#include <Ogre.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace OgreRenderer
+{
+    //! Most triangles in a leaf
+    static const uint max_leaf_triangles = 4;
+
+    //! Deepest possible hierarchy, as nodes are split in half
+    static const uint max_depth = 64;
+
+    //! Orders triangles by their centroid along an axis
+    struct CentroidLess
+    {
+        CentroidLess(const std::vector<Ogre::Vector3>& centroids, int axis) : centroids_(centroids), axis_(axis) {}
+
+        bool operator () (uint a, uint b) const { return centroids_[a][axis_] < centroids_[b][axis_]; }
+
+        const std::vector<Ogre::Vector3>& centroids_;
+        int axis_;
+    };
+
+    MeshBvh::MeshBvh(Ogre::Mesh* mesh) :
+        mesh_(mesh)
+    {
+        PROFILE(MeshBvh_Build);
+        GetSignature(mesh, signature_);
+        ReadMesh(mesh);
+
+        uint num_triangles = submeshes_.size();
+        if (!num_triangles)
+            return;
+
+        std::vector<Ogre::Vector3> centroids(num_triangles);
+        std::vector<uint> order(num_triangles);
+        for(uint i = 0; i < num_triangles; ++i)
+        {
+            centroids[i] = (vertices_[indices_[i * 3]] + vertices_[indices_[i * 3 + 1]] + vertices_[indices_[i * 3 + 2]]) / 3.0f;
+            order[i] = i;
+        }
+
+        nodes_.reserve(num_triangles * 2 / max_leaf_triangles + 1);
+        Build(0, num_triangles, centroids, order);
+
+        // Put the triangles in the order of the leaves
+        std::vector<uint> indices(indices_.size());
+        std::vector<u16> submeshes(num_triangles);
+        for(uint i = 0; i < num_triangles; ++i)
+        {
+            indices[i * 3] = indices_[order[i] * 3];
+            indices[i * 3 + 1] = indices_[order[i] * 3 + 1];
+            indices[i * 3 + 2] = indices_[order[i] * 3 + 2];
+            submeshes[i] = submeshes_[order[i]];
+        }
+        indices_.swap(indices);
+        submeshes_.swap(submeshes);
+    }
+
+    void MeshBvh::ReadMesh(Ogre::Mesh* mesh)
+    {
+        // Vertex offsets of the vertex data already read, so that shared vertices are read once
+        std::map<Ogre::VertexData*, uint> vertex_offsets;
+
+        for(unsigned short i = 0; i < mesh->getNumSubMeshes(); ++i)
+        {
+            Ogre::SubMesh* submesh = mesh->getSubMesh(i);
+            Ogre::VertexData* vertex_data = submesh->useSharedVertices ? mesh->sharedVertexData : submesh->vertexData;
+            Ogre::IndexData* index_data = submesh->indexData;
+            // Only triangle lists can be picked, as in Renderer::Raycast before
+            if (!vertex_data || !index_data || !index_data->indexCount || submesh->operationType != Ogre::RenderOperation::OT_TRIANGLE_LIST)
+                continue;
+
+            std::map<Ogre::VertexData*, uint>::iterator offset_iter = vertex_offsets.find(vertex_data);
+            uint offset;
+            if (offset_iter != vertex_offsets.end())
+                offset = offset_iter->second;
+            else
+            {
+                const Ogre::VertexElement* pos_elem = vertex_data->vertexDeclaration->findElementBySemantic(Ogre::VES_POSITION);
+                if (!pos_elem)
+                    continue;
+                const Ogre::VertexElement* tex_elem = vertex_data->vertexDeclaration->findElementBySemantic(Ogre::VES_TEXTURE_COORDINATES);
+
+                offset = vertices_.size();
+                vertex_offsets[vertex_data] = offset;
+                vertices_.resize(offset + vertex_data->vertexCount);
+                texcoords_.resize(offset + vertex_data->vertexCount, Ogre::Vector2(0.0f, 0.0f));
+
+                Ogre::HardwareVertexBufferSharedPtr vbuf = vertex_data->vertexBufferBinding->getBuffer(pos_elem->getSource());
+                unsigned char* vertex = static_cast<unsigned char*>(vbuf->lock(Ogre::HardwareBuffer::HBL_READ_ONLY));
+                vertex += vertex_data->vertexStart * vbuf->getVertexSize();
+                float* real = 0;
+                for(size_t j = 0; j < vertex_data->vertexCount; ++j, vertex += vbuf->getVertexSize())
+                {
+                    pos_elem->baseVertexPointerToElement(vertex, &real);
+                    vertices_[offset + j] = Ogre::Vector3(real[0], real[1], real[2]);
+                }
+                vbuf->unlock();
+
+                // Texture coordinates may live in a buffer of their own
+                if (tex_elem)
+                {
+                    Ogre::HardwareVertexBufferSharedPtr tbuf = vertex_data->vertexBufferBinding->getBuffer(tex_elem->getSource());
+                    vertex = static_cast<unsigned char*>(tbuf->lock(Ogre::HardwareBuffer::HBL_READ_ONLY));
+                    vertex += vertex_data->vertexStart * tbuf->getVertexSize();
+                    for(size_t j = 0; j < vertex_data->vertexCount; ++j, vertex += tbuf->getVertexSize())
+                    {
+                        tex_elem->baseVertexPointerToElement(vertex, &real);
+                        texcoords_[offset + j] = Ogre::Vector2(real[0], real[1]);
+                    }
+                    tbuf->unlock();
+                }
+            }
+
+            Ogre::HardwareIndexBufferSharedPtr ibuf = index_data->indexBuffer;
+            uint num_triangles = index_data->indexCount / 3;
+            uint first_index = indices_.size();
+            indices_.resize(first_index + num_triangles * 3);
+            submeshes_.resize(submeshes_.size() + num_triangles, i);
+            if (ibuf->getType() == Ogre::HardwareIndexBuffer::IT_32BIT)
+            {
+                const u32* src = static_cast<const u32*>(ibuf->lock(Ogre::HardwareBuffer::HBL_READ_ONLY)) + index_data->indexStart;
+                for(uint k = 0; k < num_triangles * 3; ++k)
+                    indices_[first_index + k] = src[k] + offset;
+            }
+            else
+            {
+                const u16* src = static_cast<const u16*>(ibuf->lock(Ogre::HardwareBuffer::HBL_READ_ONLY)) + index_data->indexStart;
+                for(uint k = 0; k < num_triangles * 3; ++k)
+                    indices_[first_index + k] = src[k] + offset;
+            }
+            ibuf->unlock();
+
+            // Clamp indices past the vertex data, rather than read out of bounds later
+            for(uint k = first_index; k < indices_.size(); ++k)
+            {
+                if (indices_[k] >= vertices_.size())
+                    indices_[k] = offset;
+            }
+        }
+    }
+
+    void MeshBvh::Build(uint first, uint count, std::vector<Ogre::Vector3>& centroids, std::vector<uint>& order)
+    {
+        uint node_index = nodes_.size();
+        nodes_.push_back(Node());
+
+        Ogre::Vector3 min(std::numeric_limits<f32>::max(), std::numeric_limits<f32>::max(), std::numeric_limits<f32>::max());
+        Ogre::Vector3 max(-min);
+        Ogre::Vector3 centroid_min(min);
+        Ogre::Vector3 centroid_max(max);
+        for(uint i = first; i < first + count; ++i)
+        {
+            const uint* tri = &indices_[order[i] * 3];
+            for(uint j = 0; j < 3; ++j)
+            {
+                min.makeFloor(vertices_[tri[j]]);
+                max.makeCeil(vertices_[tri[j]]);
+            }
+            centroid_min.makeFloor(centroids[order[i]]);
+            centroid_max.makeCeil(centroids[order[i]]);
+        }
+        nodes_[node_index].min_ = min;
+        nodes_[node_index].max_ = max;
+
+        Ogre::Vector3 extent = centroid_max - centroid_min;
+        if (count <= max_leaf_triangles || (extent.x <= 0.0f && extent.y <= 0.0f && extent.z <= 0.0f))
+        {
+            nodes_[node_index].first_ = first;
+            nodes_[node_index].count_ = count;
+            return;
+        }
+
+        // Split at the median centroid along the longest axis
+        int axis = 0;
+        if (extent.y > extent[axis])
+            axis = 1;
+        if (extent.z > extent[axis])
+            axis = 2;
+        uint half = count / 2;
+        std::nth_element(order.begin() + first, order.begin() + first + half, order.begin() + first + count, CentroidLess(centroids, axis));
+
+        Build(first, half, centroids, order);
+        nodes_[node_index].first_ = nodes_.size();
+        nodes_[node_index].count_ = 0;
+        Build(first + half, count - half, centroids, order);
+    }
+
+    //! Returns the distance where a ray enters a box, or a negative value if it misses the box before max_distance
+    static inline f32 RayBoxEntry(const Ogre::Vector3& origin, const Ogre::Vector3& inv_dir, const Ogre::Vector3& min, const Ogre::Vector3& max,
+        f32 max_distance)
+    {
+        f32 t_min = 0.0f;
+        f32 t_max = max_distance;
+        for(int i = 0; i < 3; ++i)
+        {
+            f32 t0 = (min[i] - origin[i]) * inv_dir[i];
+            f32 t1 = (max[i] - origin[i]) * inv_dir[i];
+            if (t0 > t1)
+                std::swap(t0, t1);
+            if (t0 > t_min)
+                t_min = t0;
+            if (t1 < t_max)
+                t_max = t1;
+            if (t_min > t_max)
+                return -1.0f;
+        }
+        return t_min;
+    }
+
+    bool MeshBvh::Raycast(const Ogre::Ray& ray, bool mirrored, RayHit& hit) const
+    {
+        if (nodes_.empty())
+            return false;
+
+        const Ogre::Vector3& origin = ray.getOrigin();
+        const Ogre::Vector3& dir = ray.getDirection();
+        Ogre::Vector3 inv_dir;
+        for(int i = 0; i < 3; ++i)
+            inv_dir[i] = dir[i] != 0.0f ? 1.0f / dir[i] : std::numeric_limits<f32>::max();
+
+        const f32 epsilon = std::numeric_limits<f32>::epsilon();
+        f32 closest = std::numeric_limits<f32>::max();
+        uint closest_triangle = 0;
+        f32 closest_u = 0.0f, closest_v = 0.0f;
+        bool found = false;
+
+        uint stack[max_depth];
+        uint stack_size = 0;
+        if (RayBoxEntry(origin, inv_dir, nodes_[0].min_, nodes_[0].max_, closest) >= 0.0f)
+            stack[stack_size++] = 0;
+
+        while(stack_size)
+        {
+            const Node& node = nodes_[stack[--stack_size]];
+            if (node.count_)
+            {
+                for(uint i = node.first_; i < node.first_ + node.count_; ++i)
+                {
+                    // Moller-Trumbore. The determinant is positive when the ray meets the front side
+                    const Ogre::Vector3& v0 = vertices_[indices_[i * 3]];
+                    Ogre::Vector3 e1 = vertices_[indices_[i * 3 + 1]] - v0;
+                    Ogre::Vector3 e2 = vertices_[indices_[i * 3 + 2]] - v0;
+                    Ogre::Vector3 p = dir.crossProduct(e2);
+                    f32 det = e1.dotProduct(p);
+                    if (mirrored)
+                    {
+                        if (det > -epsilon)
+                            continue;
+                    }
+                    else if (det < epsilon)
+                        continue;
+
+                    f32 inv_det = 1.0f / det;
+                    Ogre::Vector3 s = origin - v0;
+                    f32 u = s.dotProduct(p) * inv_det;
+                    if (u < 0.0f || u > 1.0f)
+                        continue;
+                    Ogre::Vector3 q = s.crossProduct(e1);
+                    f32 v = dir.dotProduct(q) * inv_det;
+                    if (v < 0.0f || u + v > 1.0f)
+                        continue;
+                    f32 t = e2.dotProduct(q) * inv_det;
+                    if (t < 0.0f || t >= closest)
+                        continue;
+
+                    closest = t;
+                    closest_triangle = i;
+                    closest_u = u;
+                    closest_v = v;
+                    found = true;
+                }
+            }
+            else
+            {
+                // Visit the nearer child first, so that it can cut off the farther one
+                uint left = &node - &nodes_[0] + 1;
+                uint right = node.first_;
+                f32 left_entry = RayBoxEntry(origin, inv_dir, nodes_[left].min_, nodes_[left].max_, closest);
+                f32 right_entry = RayBoxEntry(origin, inv_dir, nodes_[right].min_, nodes_[right].max_, closest);
+                if (left_entry >= 0.0f && right_entry >= 0.0f)
+                {
+                    if (left_entry < right_entry)
+                        std::swap(left, right);
+                    stack[stack_size++] = left;
+                    stack[stack_size++] = right;
+                }
+                else if (left_entry >= 0.0f)
+                    stack[stack_size++] = left;
+                else if (right_entry >= 0.0f)
+                    stack[stack_size++] = right;
+            }
+        }
+
+        if (!found)
+            return false;
+
+        const uint* tri = &indices_[closest_triangle * 3];
+        Ogre::Vector2 uv = texcoords_[tri[0]] * (1.0f - closest_u - closest_v) + texcoords_[tri[1]] * closest_u + texcoords_[tri[2]] * closest_v;
+        hit.distance_ = closest;
+        hit.submesh_ = submeshes_[closest_triangle];
+        hit.u_ = uv.x;
+        hit.v_ = uv.y;
+        return true;
+    }
+
+    bool MeshBvh::Intersects(const std::vector<Ogre::Plane>& planes) const
+    {
+        if (nodes_.empty())
+            return false;
+
+        uint stack[max_depth];
+        uint stack_size = 0;
+        stack[stack_size++] = 0;
+
+        while(stack_size)
+        {
+            uint node_index = stack[--stack_size];
+            const Node& node = nodes_[node_index];
+
+            // Skip the node if its box is entirely outside a plane
+            bool outside = false;
+            for(uint i = 0; i < planes.size() && !outside; ++i)
+            {
+                const Ogre::Vector3& n = planes[i].normal;
+                Ogre::Vector3 farthest(n.x >= 0.0f ? node.max_.x : node.min_.x, n.y >= 0.0f ? node.max_.y : node.min_.y,
+                    n.z >= 0.0f ? node.max_.z : node.min_.z);
+                outside = planes[i].getDistance(farthest) < 0.0f;
+            }
+            if (outside)
+                continue;
+
+            if (!node.count_)
+            {
+                stack[stack_size++] = node.first_;
+                stack[stack_size++] = node_index + 1;
+                continue;
+            }
+
+            for(uint i = node.first_; i < node.first_ + node.count_; ++i)
+            {
+                const Ogre::Vector3& v0 = vertices_[indices_[i * 3]];
+                const Ogre::Vector3& v1 = vertices_[indices_[i * 3 + 1]];
+                const Ogre::Vector3& v2 = vertices_[indices_[i * 3 + 2]];
+                bool triangle_outside = false;
+                for(uint j = 0; j < planes.size() && !triangle_outside; ++j)
+                {
+                    triangle_outside = planes[j].getDistance(v0) < 0.0f && planes[j].getDistance(v1) < 0.0f &&
+                        planes[j].getDistance(v2) < 0.0f;
+                }
+                if (!triangle_outside)
+                    return true;
+            }
+        }
+
+        return false;
+    }
+
+    void MeshBvh::GetSignature(const Ogre::Mesh* mesh, std::vector<const void*>& signature)
+    {
+        signature.clear();
+        // Meshes whose vertex buffers are rewritten in place, such as the terrain patches, dirty their state when they do so
+        signature.push_back((const void*)mesh->getStateCount());
+        signature.push_back(mesh->sharedVertexData);
+        if (mesh->sharedVertexData)
+            signature.push_back((const void*)mesh->sharedVertexData->vertexCount);
+        for(unsigned short i = 0; i < mesh->getNumSubMeshes(); ++i)
+        {
+            const Ogre::SubMesh* submesh = mesh->getSubMesh(i);
+            signature.push_back(submesh->vertexData);
+            signature.push_back(submesh->indexData);
+            if (submesh->indexData)
+            {
+                signature.push_back(submesh->indexData->indexBuffer.getPointer());
+                signature.push_back((const void*)submesh->indexData->indexCount);
+            }
+        }
+    }
+
+    bool MeshBvh::IsBuiltFrom(const Ogre::Mesh* mesh) const
+    {
+        if (mesh != mesh_)
+            return false;
+        std::vector<const void*> signature;
+        GetSignature(mesh, signature);
+        return signature == signature_;
+    }
+
+    MeshBvhPtr MeshBvhCache::GetBvh(Ogre::Mesh* mesh)
+    {
+        if (!mesh)
+            return MeshBvhPtr();
+
+        MeshBvhPtr& bvh = bvhs_[mesh->getName()];
+        if (!bvh || !bvh->IsBuiltFrom(mesh))
+            bvh = MeshBvhPtr(new MeshBvh(mesh));
+        return bvh;
+    }
+
+    void MeshBvhCache::Prune()
+    {
+        Ogre::MeshManager& mesh_manager = Ogre::MeshManager::getSingleton();
+        std::map<std::string, MeshBvhPtr>::iterator i = bvhs_.begin();
+        while (i != bvhs_.end())
+        {
+            Ogre::MeshPtr mesh = mesh_manager.getByName(i->first);
+            if (mesh.isNull() || !i->second->IsBuiltFrom(mesh.getPointer()))
+                bvhs_.erase(i++);
+            else
+                ++i;
+        }
+    }
+}
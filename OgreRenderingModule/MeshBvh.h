@@ -0,0 +1,129 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#ifndef incl_OgreRenderer_MeshBvh_h
+#define incl_OgreRenderer_MeshBvh_h
+
+#include <OgreVector2.h>
+#include <OgreVector3.h>
+#include <OgrePlane.h>
+#include <OgreRay.h>
+
+namespace Ogre
+{
+    class Mesh;
+}
+
+namespace OgreRenderer
+{
+    //! Bounding volume hierarchy over the triangles of a mesh, in object space
+    /*! Used for polygon-level raycasts and frustum queries. Holds a copy of the vertex positions, texture coordinates
+        and triangle list indices of the mesh, so the hardware buffers are read back only once. Vertices animated by
+        skeletons or vertex animation are not taken into account.
+     */
+    class MeshBvh
+    {
+    public:
+        //! Raycast hit
+        struct RayHit
+        {
+            RayHit() : distance_(0.0f), submesh_(0), u_(0.0f), v_(0.0f) {}
+
+            //! Distance along the ray, in units of the ray direction
+            f32 distance_;
+            //! Submesh index
+            uint submesh_;
+            //! Texture coordinates at the hit point
+            f32 u_;
+            f32 v_;
+        };
+
+        //! Builds the hierarchy from the triangle lists of a mesh
+        explicit MeshBvh(Ogre::Mesh* mesh);
+
+        //! Returns whether the hierarchy was built from the current geometry of a mesh
+        bool IsBuiltFrom(const Ogre::Mesh* mesh) const;
+
+        //! Finds the closest triangle hit by a ray
+        /*! Triangles are hit only from their front side, as with Ogre::Math::intersects(ray, a, b, c, true, false).
+            \param ray Ray in object space. Need not be normalized; the hit distance is in units of its direction
+            \param mirrored Whether the object is mirrored by its transform, which turns the front sides around
+            \param hit Closest hit
+            \return true if a triangle was hit
+         */
+        bool Raycast(const Ogre::Ray& ray, bool mirrored, RayHit& hit) const;
+
+        //! Returns whether any triangle may be inside a convex volume
+        /*! Conservative: a triangle counts unless all its vertices are outside the same plane.
+            \param planes Planes of the volume in object space, with the inside on their positive side
+         */
+        bool Intersects(const std::vector<Ogre::Plane>& planes) const;
+
+        //! Returns number of triangles
+        uint GetNumTriangles() const { return submeshes_.size(); }
+
+    private:
+        //! Node of the hierarchy. The left child of an inner node follows it directly
+        struct Node
+        {
+            //! Bounds of the triangles under the node
+            Ogre::Vector3 min_;
+            Ogre::Vector3 max_;
+            //! First triangle of a leaf, or the right child of an inner node
+            uint first_;
+            //! Amount of triangles of a leaf, 0 for an inner node
+            uint count_;
+        };
+
+        //! Reads the geometry of a mesh
+        void ReadMesh(Ogre::Mesh* mesh);
+
+        //! Builds the subtree of the triangles from first to first + count, ordered by centroids
+        void Build(uint first, uint count, std::vector<Ogre::Vector3>& centroids, std::vector<uint>& order);
+
+        //! Identifies the geometry of a mesh, to notice when it has changed
+        static void GetSignature(const Ogre::Mesh* mesh, std::vector<const void*>& signature);
+
+        //! Mesh the hierarchy was built from. Not dereferenced
+        const Ogre::Mesh* mesh_;
+
+        //! Geometry of the mesh the hierarchy was built from
+        std::vector<const void*> signature_;
+
+        //! Vertex positions
+        std::vector<Ogre::Vector3> vertices_;
+
+        //! Vertex texture coordinates
+        std::vector<Ogre::Vector2> texcoords_;
+
+        //! Triangle vertex indices, three per triangle, in the order of the leaves
+        std::vector<uint> indices_;
+
+        //! Submesh of each triangle
+        std::vector<u16> submeshes_;
+
+        //! Nodes, the root first
+        std::vector<Node> nodes_;
+    };
+
+    typedef boost::shared_ptr<MeshBvh> MeshBvhPtr;
+
+    //! Builds mesh bounding volume hierarchies on demand and keeps them until their meshes change or are destroyed
+    class MeshBvhCache
+    {
+    public:
+        //! Returns the hierarchy of a mesh, building it if not built yet or if the mesh has changed since
+        MeshBvhPtr GetBvh(Ogre::Mesh* mesh);
+
+        //! Drops the hierarchies of meshes that no longer exist
+        void Prune();
+
+        //! Drops all hierarchies
+        void Clear() { bvhs_.clear(); }
+
+    private:
+        //! Hierarchies by mesh name
+        std::map<std::string, MeshBvhPtr> bvhs_;
+    };
+}
+
+#endif
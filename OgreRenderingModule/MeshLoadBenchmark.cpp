@@ -0,0 +1,166 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#include "StableHeaders.h"
+#include "MeshLoadBenchmark.h"
+#include "ResourceHandler.h"
+#include "OgreMeshResource.h"
+#include "RexTypes.h"
+#include "HighPerfClock.h"
+
+#include <QDir>
+#include <QFile>
+
+#include <sstream>
+#include <iomanip>
+
+namespace OgreRenderer
+{
+    namespace
+    {
+        //! A mesh read from a file, for the mesh load benchmark
+        class BenchmarkAsset : public Foundation::AssetInterface
+        {
+        public:
+            BenchmarkAsset(const std::string& id, const QByteArray& data) : id_(id), type_(RexTypes::ASSETTYPENAME_MESH), data_(data) {}
+
+            virtual const std::string& GetId() const { return id_; }
+            virtual const std::string& GetType() const { return type_; }
+            virtual uint GetSize() const { return data_.size(); }
+            virtual const u8* GetData() const { return (const u8*)data_.constData(); }
+            virtual Foundation::AssetMetadataInterface* GetMetadata() const { return 0; }
+
+            //! Returns the file contents, shared with the copy
+            const QByteArray& GetByteArray() const { return data_; }
+
+        private:
+            std::string id_;
+            std::string type_;
+            QByteArray data_;
+        };
+
+        //! Upper limits of the histogram bins, in milliseconds. The last bin has no limit
+        const f64 bin_limits[] = { 8.0, 16.7, 33.3, 50.0, 100.0, 250.0 };
+        const uint num_bins = sizeof(bin_limits) / sizeof(bin_limits[0]) + 1;
+
+        //! Stop waiting for the meshes after this many seconds
+        const f64 max_duration = 120.0;
+    }
+
+    MeshLoadBenchmark::MeshLoadBenchmark(ResourceHandler* handler, const std::vector<Foundation::AssetPtr>& assets, uint copies, bool background) :
+        handler_(handler),
+        assets_(assets),
+        copies_(std::max(copies, 1u)),
+        background_(background),
+        old_background_(handler->IsBackgroundLoading()),
+        start_time_(0.0),
+        loaded_(0)
+    {
+    }
+
+    MeshLoadBenchmark::~MeshLoadBenchmark()
+    {
+        for(uint i = 0; i < ids_.size(); ++i)
+            handler_->RemoveResource(ids_[i], OgreMeshResource::GetTypeStatic());
+    }
+
+    void MeshLoadBenchmark::Start()
+    {
+        handler_->SetBackgroundLoading(background_);
+
+        tick_t start_time = GetCurrentClockTime();
+        for(uint copy = 0; copy < copies_; ++copy)
+        {
+            for(uint i = 0; i < assets_.size(); ++i)
+            {
+                const BenchmarkAsset* source = checked_static_cast<const BenchmarkAsset*>(assets_[i].get());
+                std::string id = "meshloadbench" + ToString(copy) + "/" + source->GetId();
+                ids_.push_back(id);
+                handler_->UpdateResource(Foundation::AssetPtr(new BenchmarkAsset(id, source->GetByteArray())));
+            }
+        }
+        start_time_ = (f64)(GetCurrentClockTime() - start_time) / GetCurrentClockFreq();
+
+        // Loads already started in the background are finished regardless
+        handler_->SetBackgroundLoading(old_background_);
+    }
+
+    bool MeshLoadBenchmark::Update(f64 frametime)
+    {
+        frame_times_.push_back(frametime);
+
+        f64 elapsed = 0.0;
+        for(uint i = 0; i < frame_times_.size(); ++i)
+            elapsed += frame_times_[i];
+
+        loaded_ = 0;
+        bool done = true;
+        for(uint i = 0; i < ids_.size(); ++i)
+        {
+            ResourceHandler::ResourceLoadState state = handler_->GetResourceLoadState(ids_[i]);
+            if (state == ResourceHandler::RLS_Loading || state == ResourceHandler::RLS_Finishing)
+                done = false;
+            else if (state == ResourceHandler::RLS_Ready || state == ResourceHandler::RLS_WaitingReferences)
+                ++loaded_;
+        }
+
+        return done || elapsed >= max_duration;
+    }
+
+    std::string MeshLoadBenchmark::GetReport() const
+    {
+        std::vector<f64> sorted(frame_times_);
+        std::sort(sorted.begin(), sorted.end());
+
+        uint bins[num_bins] = { 0 };
+        f64 total = 0.0;
+        for(uint i = 0; i < sorted.size(); ++i)
+        {
+            f64 ms = sorted[i] * 1000.0;
+            uint bin = 0;
+            while(bin < num_bins - 1 && ms >= bin_limits[bin])
+                ++bin;
+            ++bins[bin];
+            total += sorted[i];
+        }
+
+        std::stringstream ss;
+        ss << std::fixed << std::setprecision(1);
+        ss << "Loaded " << loaded_ << "/" << ids_.size() << " meshes " << (background_ ? "in the background" : "in the main thread")
+            << " in " << sorted.size() << " frames, " << total * 1000.0 << " ms" << std::endl;
+        ss << "Starting the loads took " << start_time_ * 1000.0 << " ms" << std::endl;
+        if (sorted.empty())
+            return ss.str();
+
+        ss << "Frame time mean " << total * 1000.0 / sorted.size() << " ms, median " << sorted[sorted.size() / 2] * 1000.0
+            << " ms, 99th percentile " << sorted[(sorted.size() * 99) / 100] * 1000.0 << " ms, max " << sorted.back() * 1000.0 << " ms" << std::endl;
+
+        uint max_count = *std::max_element(bins, bins + num_bins);
+        for(uint i = 0; i < num_bins; ++i)
+        {
+            std::stringstream range;
+            range << std::fixed << std::setprecision(1);
+            if (i < num_bins - 1)
+                range << "< " << bin_limits[i] << " ms";
+            else
+                range << ">= " << bin_limits[i - 1] << " ms";
+            ss << std::setw(12) << range.str() << " " << std::setw(6) << bins[i] << " " << std::string(max_count ? bins[i] * 40 / max_count : 0, '#') << std::endl;
+        }
+
+        return ss.str();
+    }
+
+    void MeshLoadBenchmark::LoadAssets(const std::string& path, std::vector<Foundation::AssetPtr>& assets)
+    {
+        QDir dir(QString::fromStdString(path));
+        QStringList files = dir.entryList(QStringList("*.mesh"), QDir::Files);
+        for(int i = 0; i < files.size(); ++i)
+        {
+            QFile file(dir.filePath(files[i]));
+            if (!file.open(QIODevice::ReadOnly))
+                continue;
+            QByteArray data = file.readAll();
+            if (!data.isEmpty())
+                assets.push_back(Foundation::AssetPtr(new BenchmarkAsset(files[i].toStdString(), data)));
+        }
+    }
+}
@@ -0,0 +1,74 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#ifndef incl_OgreRenderer_MeshLoadBenchmark_h
+#define incl_OgreRenderer_MeshLoadBenchmark_h
+
+#include "AssetInterface.h"
+
+namespace OgreRenderer
+{
+    class ResourceHandler;
+
+    //! Loads a burst of meshes through the resource handler and records a histogram of the frame times meanwhile
+    /*! Used by the meshloadbench console command, to compare loading meshes in the background and in the main thread.
+     */
+    class MeshLoadBenchmark
+    {
+    public:
+        //! Constructor
+        /*! \param handler Resource handler to load the meshes with
+            \param assets Mesh assets to load
+            \param copies How many times to load each mesh, under different ids
+            \param background Whether to load in the background
+         */
+        MeshLoadBenchmark(ResourceHandler* handler, const std::vector<Foundation::AssetPtr>& assets, uint copies, bool background);
+
+        //! Destructor. Removes the loaded meshes
+        ~MeshLoadBenchmark();
+
+        //! Starts loading the meshes
+        void Start();
+
+        //! Records a frame
+        /*! \param frametime Time of the previous frame, in seconds
+            \return true when all meshes have been loaded
+         */
+        bool Update(f64 frametime);
+
+        //! Returns the frame time histogram and statistics
+        std::string GetReport() const;
+
+        //! Reads the .mesh files in a directory
+        static void LoadAssets(const std::string& path, std::vector<Foundation::AssetPtr>& assets);
+
+    private:
+        //! Resource handler
+        ResourceHandler* handler_;
+
+        //! Source assets, one per mesh file
+        std::vector<Foundation::AssetPtr> assets_;
+
+        //! Ids of the meshes being loaded
+        StringVector ids_;
+
+        //! How many times to load each mesh
+        uint copies_;
+
+        //! Whether to load in the background
+        bool background_;
+
+        //! Background loading setting before the benchmark
+        bool old_background_;
+
+        //! Recorded frame times, in seconds
+        std::vector<f64> frame_times_;
+
+        //! Time spent starting the loads, in seconds
+        f64 start_time_;
+
+        //! Amount of meshes loaded successfully
+        uint loaded_;
+    };
+}
+
+#endif
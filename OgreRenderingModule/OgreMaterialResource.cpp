@@ -37,15 +37,6 @@ namespace OgreRenderer
     
     bool OgreMaterialResource::SetData(Foundation::AssetPtr source)
     {
-        // Remove old material if any
-        RemoveMaterial();
-        references_.clear();
-        original_textures_.clear();
-
-        Ogre::MaterialManager& matmgr = Ogre::MaterialManager::getSingleton(); 
-
-        OgreRenderingModule::LogDebug("Parsing material " + source->GetId());
-        
         if (!source)
         {
             OgreRenderingModule::LogError("Null source asset data pointer");
@@ -57,78 +48,111 @@ namespace OgreRenderer
             return false;
         }
 
-        Ogre::DataStreamPtr data = Ogre::DataStreamPtr(new Ogre::MemoryDataStream(const_cast<u8 *>(source->GetData()), source->GetSize()));
+        PreprocessedScript script;
+        PreprocessScript(source->GetId(), source->GetData(), source->GetSize(), GetNextTempName(), script);
+        return SetPreprocessedData(source->GetId(), script);
+    }
 
+    std::string OgreMaterialResource::GetNextTempName()
+    {
         static int tempname_count = 0;
         tempname_count++;
-        std::string tempname = "TempMat" + ToString<int>(tempname_count);
-        
-        try
+        return "TempMat" + ToString<int>(tempname_count);
+    }
+
+    void OgreMaterialResource::PreprocessScript(const std::string& asset_id, const u8* data, uint size, const std::string& temp_name,
+        PreprocessedScript& result)
+    {
+        OgreRenderingModule::LogDebug("Parsing material " + asset_id);
+
+        Ogre::DataStreamPtr stream = Ogre::DataStreamPtr(new Ogre::MemoryDataStream(const_cast<u8 *>(data), size));
+        result.temp_name_ = temp_name;
+        result.references_.clear();
+        result.original_textures_.clear();
+
+        int num_materials = 0;
+        int brace_level = 0;
+        bool skip_until_next = false;
+        int skip_brace_level = 0;
+        // Parsed/modified material script
+        std::ostringstream output;
+
+        while (!stream->eof())
         {
-            int num_materials = 0;
-            int brace_level = 0;
-            bool skip_until_next = false;
-            int skip_brace_level = 0;
-            // Parsed/modified material script
-            std::ostringstream output;
+            Ogre::String line = stream->getLine();
             
-
-            while (!data->eof())
+            // Skip empty lines & comments
+            if ((line.length()) && (line.substr(0, 2) != "//"))
             {
-                Ogre::String line = data->getLine();
-                
-                // Skip empty lines & comments
-                if ((line.length()) && (line.substr(0, 2) != "//"))
+                // Process opening/closing braces
+                if (!ResourceHandler::ProcessBraces(line, brace_level))
                 {
-                    // Process opening/closing braces
-                    if (!ResourceHandler::ProcessBraces(line, brace_level))
+                    // If not a brace and on level 0, it should be a new material; replace name
+                    if ((brace_level == 0) && (line.substr(0, 8) == "material"))
                     {
-                        // If not a brace and on level 0, it should be a new material; replace name
-                        if ((brace_level == 0) && (line.substr(0, 8) == "material"))
+                        if (num_materials == 0)
                         {
-                            if (num_materials == 0)
-                            {
-                                line = "material " + tempname;
-                                ++num_materials;
-                            }
-                            else
-                            {
-                                OgreRenderingModule::LogWarning("More than one material defined in material asset " + source->GetId() + " - only first one supported");
-                                break;
-                            }
+                            line = "material " + temp_name;
+                            ++num_materials;
                         }
                         else
                         {
-                            // Check for textures
-                            if ((line.substr(0, 8) == "texture ") && (line.length() > 8))
-                            {
-                                std::string tex_name = line.substr(8);
-                                // Note: we assume all texture references are asset based. ResourceHandler checks later whether this is true,
-                                // before requesting the reference
-                                references_.push_back(Foundation::ResourceReference(tex_name, OgreTextureResource::GetTypeStatic()));
-                                original_textures_.push_back(tex_name);
-                                // Replace any / with \ in the material, then change the texture names back later, so that Ogre does not go nuts
-                                ReplaceCharInplace(line, '/', '\\');
-                                ReplaceCharInplace(line, ':', '@');
-                            }
+                            OgreRenderingModule::LogWarning("More than one material defined in material asset " + asset_id + " - only first one supported");
+                            break;
                         }
-
-                        // Write line to the modified copy
-                        if (!skip_until_next)
-                            output << line << std::endl;
                     }
                     else
                     {
-                        // Write line to the modified copy
-                        if (!skip_until_next)
-                            output << line << std::endl;
-                        if (brace_level <= skip_brace_level)
-                            skip_until_next = false;
+                        // Check for textures
+                        if ((line.substr(0, 8) == "texture ") && (line.length() > 8))
+                        {
+                            std::string tex_name = line.substr(8);
+                            // Note: we assume all texture references are asset based. ResourceHandler checks later whether this is true,
+                            // before requesting the reference
+                            result.references_.push_back(Foundation::ResourceReference(tex_name, OgreTextureResource::GetTypeStatic()));
+                            result.original_textures_.push_back(tex_name);
+                            // Replace any / with \ in the material, then change the texture names back later, so that Ogre does not go nuts
+                            ReplaceCharInplace(line, '/', '\\');
+                            ReplaceCharInplace(line, ':', '@');
+                        }
                     }
+
+                    // Write line to the modified copy
+                    if (!skip_until_next)
+                        output << line << std::endl;
+                }
+                else
+                {
+                    // Write line to the modified copy
+                    if (!skip_until_next)
+                        output << line << std::endl;
+                    if (brace_level <= skip_brace_level)
+                        skip_until_next = false;
                 }
             }
+        }
 
-            std::string output_str = output.str();
+        result.script_ = output.str();
+    }
+
+    bool OgreMaterialResource::SetPreprocessedData(const std::string& asset_id, const PreprocessedScript& script)
+    {
+        // Remove old material if any
+        RemoveMaterial();
+        references_ = script.references_;
+        original_textures_ = script.original_textures_;
+
+        Ogre::MaterialManager& matmgr = Ogre::MaterialManager::getSingleton(); 
+        const std::string& tempname = script.temp_name_;
+
+        try
+        {
+            std::string output_str = script.script_;
+            if (output_str.empty())
+            {
+                OgreRenderingModule::LogWarning("Failed to create an Ogre material from material asset " + asset_id);
+                return false;
+            }
             Ogre::DataStreamPtr modified_data = Ogre::DataStreamPtr(new Ogre::MemoryDataStream((u8 *)(&output_str[0]), output_str.size()));
 
             matmgr.parseScript(modified_data, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
@@ -137,14 +161,14 @@ namespace OgreRenderer
             if (tempmat.isNull())
             {
                 OgreRenderingModule::LogWarning(std::string("Failed to create an Ogre material from material asset ") +
-                    source->GetId());
+                    asset_id);
 
                 return false;
             }
             if(!tempmat->getNumTechniques())
             {
                 OgreRenderingModule::LogWarning("Failed to create an Ogre material from material asset "  +
-                    source->GetId());
+                    asset_id);
                 return false;
             }
             
@@ -154,7 +178,7 @@ namespace OgreRenderer
             if (ogre_material_.isNull())
             {
                 OgreRenderingModule::LogWarning("Failed to create an Ogre material from material asset "  +
-                    source->GetId());
+                    asset_id);
                 return false;
             }
             
@@ -218,7 +242,7 @@ namespace OgreRenderer
         } catch (Ogre::Exception &e)
         {
             OgreRenderingModule::LogWarning(e.what());
-            OgreRenderingModule::LogWarning("Failed to parse Ogre material " + source->GetId() + ".");
+            OgreRenderingModule::LogWarning("Failed to parse Ogre material " + asset_id + ".");
             try
             {
                 if (!matmgr.getByName(tempname).isNull())
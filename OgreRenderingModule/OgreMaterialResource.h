@@ -62,6 +62,39 @@ namespace OgreRenderer
 
         //! returns original texture names
         const StringVector& GetOriginalTextureNames() const { return original_textures_; }
+
+        //! Material script prepared for Ogre to parse
+        struct PreprocessedScript
+        {
+            //! Script with the material renamed and texture names escaped
+            std::string script_;
+            //! Temporary name given to the material
+            std::string temp_name_;
+            //! Texture references of the material
+            Foundation::ResourceReferenceVector references_;
+            //! Original texture names
+            StringVector original_textures_;
+        };
+
+        //! Returns a unique temporary name to give the material of a script. Call from the main thread
+        static std::string GetNextTempName();
+
+        //! Renames the material of a script and collects its texture references. Does not touch Ogre, so can be called from a worker thread
+        /*! \param asset_id Id of the material asset, for log messages
+            \param data Material script
+            \param size Size of material script
+            \param temp_name Temporary name to give the material, from GetNextTempName()
+            \param result Preprocessed script
+         */
+        static void PreprocessScript(const std::string& asset_id, const u8* data, uint size, const std::string& temp_name,
+            PreprocessedScript& result);
+
+        //! sets contents from a preprocessed material script. Call from the main thread
+        /*! \param asset_id Id of the material asset, for log messages
+            \param script Preprocessed script
+            \return true if successful
+         */
+        bool SetPreprocessedData(const std::string& asset_id, const PreprocessedScript& script);
         
     private:
         Ogre::MaterialPtr ogre_material_;
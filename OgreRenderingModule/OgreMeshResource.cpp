@@ -6,16 +6,110 @@
 #include "Profiler.h"
 
 #include <Ogre.h>
+#ifdef OGRE_MESH_BACKGROUND_IMPORT
+#include <OgreDefaultHardwareBufferManager.h>
+#endif
 
 namespace OgreRenderer
 {
+#ifdef OGRE_MESH_BACKGROUND_IMPORT
+    //! Records the material and skeleton names of a mesh being imported
+    class MeshImportListener : public Ogre::MeshSerializerListener
+    {
+    public:
+        MeshImportListener(OgreMeshResource::MeshImport& import, bool system_memory) :
+            import_(import),
+            system_memory_(system_memory)
+        {
+        }
+
+        virtual void processMaterialName(Ogre::Mesh* mesh, Ogre::String* name)
+        {
+            import_.material_names_.push_back(*name);
+            // Assign default materials that won't complain
+            *name = "LitTextured";
+        }
+
+        virtual void processSkeletonName(Ogre::Mesh* mesh, Ogre::String* name)
+        {
+            import_.skeleton_name_ = *name;
+            // Setting the skeleton loads it through the skeleton manager, so leave that to the main thread
+            if (system_memory_)
+                name->clear();
+        }
+
+    private:
+        OgreMeshResource::MeshImport& import_;
+        bool system_memory_;
+    };
+
+    //! Replaces vertex data in system memory buffers with a copy in hardware buffers
+    static void CopyToHardwareBuffers(Ogre::VertexData*& data)
+    {
+        if (!data)
+            return;
+        Ogre::VertexData* copy = data->clone(true, Ogre::HardwareBufferManager::getSingletonPtr());
+        OGRE_DELETE data;
+        data = copy;
+    }
+
+    //! Replaces index data in system memory buffers with a copy in hardware buffers
+    static void CopyToHardwareBuffers(Ogre::IndexData*& data)
+    {
+        if (!data)
+            return;
+        Ogre::IndexData* copy = data->clone(true, Ogre::HardwareBufferManager::getSingletonPtr());
+        OGRE_DELETE data;
+        data = copy;
+    }
+
+    //! Copies all the geometry of a mesh imported to system memory to hardware buffers
+    static void CopyToHardwareBuffers(Ogre::Mesh* mesh)
+    {
+        CopyToHardwareBuffers(mesh->sharedVertexData);
+        for(uint i = 0; i < mesh->getNumSubMeshes(); ++i)
+        {
+            Ogre::SubMesh* submesh = mesh->getSubMesh(i);
+            CopyToHardwareBuffers(submesh->vertexData);
+            CopyToHardwareBuffers(submesh->indexData);
+            for(uint j = 0; j < submesh->mLodFaceList.size(); ++j)
+                CopyToHardwareBuffers(submesh->mLodFaceList[j]);
+        }
+
+        // Morph animation keyframes refer to vertex buffers of their own
+        for(unsigned short i = 0; i < mesh->getNumAnimations(); ++i)
+        {
+            Ogre::Animation::VertexTrackIterator tracks = mesh->getAnimation(i)->getVertexTrackIterator();
+            while(tracks.hasMoreElements())
+            {
+                Ogre::VertexAnimationTrack* track = tracks.getNext();
+                if (track->getAnimationType() != Ogre::VAT_MORPH)
+                    continue;
+                for(unsigned short j = 0; j < track->getNumKeyFrames(); ++j)
+                {
+                    Ogre::VertexMorphKeyFrame* keyframe = track->getVertexMorphKeyFrame(j);
+                    Ogre::HardwareVertexBufferSharedPtr source = keyframe->getVertexBuffer();
+                    if (source.isNull() || !dynamic_cast<Ogre::DefaultHardwareVertexBuffer*>(source.getPointer()))
+                        continue;
+                    Ogre::HardwareVertexBufferSharedPtr copy = Ogre::HardwareBufferManager::getSingleton().createVertexBuffer(
+                        source->getVertexSize(), source->getNumVertices(), source->getUsage(), source->hasShadowBuffer());
+                    copy->copyData(*source.getPointer(), 0, 0, source->getSizeInBytes(), true);
+                    keyframe->setVertexBuffer(copy);
+                }
+            }
+        }
+    }
+#endif
+
     OgreMeshResource::OgreMeshResource(const std::string& id) : 
-        ResourceInterface(id)
+        ResourceInterface(id),
+        importing_(false)
     {
     }
 
     OgreMeshResource::OgreMeshResource(const std::string& id, Foundation::AssetPtr source) : 
-        ResourceInterface(id)
+        ResourceInterface(id),
+        importing_(false)
     {
         SetData(source);
     }
@@ -38,7 +132,18 @@ namespace OgreRenderer
             OgreRenderingModule::LogError("Zero sized mesh asset");     
             return false;
         }
-                
+
+        Ogre::Mesh* mesh = BeginImport();
+        if (!mesh)
+            return false;
+
+        MeshImport import;
+        ImportMesh(mesh, source->GetData(), source->GetSize(), false, import);
+        return FinishImport(import);
+    }
+
+    Ogre::Mesh* OgreMeshResource::BeginImport()
+    {
         try
         {
             if (ogre_mesh_.isNull())
@@ -48,56 +153,118 @@ namespace OgreRenderer
                 if (ogre_mesh_.isNull())
                 {
                     OgreRenderingModule::LogError("Failed to create mesh " + id_);
-                    return false; 
+                    return 0; 
                 }   
                 ogre_mesh_->setAutoBuildEdgeLists(false);
             }
+        }
+        catch (Ogre::Exception &e)
+        {
+            OgreRenderingModule::LogError("Failed to create mesh " + id_ + ": " + std::string(e.what()));
+            return 0;
+        }
+
+        importing_ = true;
+        return ogre_mesh_.getPointer();
+    }
 
-            Ogre::DataStreamPtr stream(new Ogre::MemoryDataStream((void*)source->GetData(), source->GetSize(), false));
+    void OgreMeshResource::ImportMesh(Ogre::Mesh* mesh, const u8* data, uint size, bool system_memory, MeshImport& import)
+    {
+        PROFILE(OgreMeshResource_ImportMesh);
+        try
+        {
             Ogre::MeshSerializer serializer;
-            serializer.importMesh(stream, ogre_mesh_.getPointer());
+#ifdef OGRE_MESH_BACKGROUND_IMPORT
+            if (system_memory)
+            {
+                import.buffer_manager_ = boost::shared_ptr<Ogre::HardwareBufferManagerBase>(new Ogre::DefaultHardwareBufferManagerBase());
+                mesh->setHardwareBufferManager(import.buffer_manager_.get());
+            }
+            MeshImportListener listener(import, system_memory);
+            serializer.setListener(&listener);
+#endif
+
+            Ogre::DataStreamPtr stream(new Ogre::MemoryDataStream((void*)data, size, false));
+            serializer.importMesh(stream, mesh);
             
             // Generate tangents to mesh
             try
             {
                 unsigned short src, dest;
-                if (!ogre_mesh_->suggestTangentVectorBuildParams(Ogre::VES_TANGENT, src, dest))
-                    ogre_mesh_->buildTangentVectors(Ogre::VES_TANGENT, src, dest);
+                if (!mesh->suggestTangentVectorBuildParams(Ogre::VES_TANGENT, src, dest))
+                    mesh->buildTangentVectors(Ogre::VES_TANGENT, src, dest);
             }
             catch (...) {}
             
             // Generate extremity points to submeshes, 1 should be enough
             try
             {
-                for(uint i = 0; i < ogre_mesh_->getNumSubMeshes(); ++i)
+                for(uint i = 0; i < mesh->getNumSubMeshes(); ++i)
                 {
-                    Ogre::SubMesh *smesh = ogre_mesh_->getSubMesh(i);
+                    Ogre::SubMesh *smesh = mesh->getSubMesh(i);
                     if (smesh)
                         smesh->generateExtremes(1);
                 }
             }
             catch (...) {}
-            
+
+#ifndef OGRE_MESH_BACKGROUND_IMPORT
             // Assign default materials that won't complain
-            original_materials_.clear();
-            for (uint i = 0; i < ogre_mesh_->getNumSubMeshes(); ++i)
+            for (uint i = 0; i < mesh->getNumSubMeshes(); ++i)
             {
-                Ogre::SubMesh* submesh = ogre_mesh_->getSubMesh(i);
+                Ogre::SubMesh* submesh = mesh->getSubMesh(i);
                 if (submesh)
                 {
-                    original_materials_.push_back(submesh->getMaterialName());
+                    import.material_names_.push_back(submesh->getMaterialName());
                     submesh->setMaterialName("LitTextured");
                 }
             }
-            
+            import.skeleton_name_ = mesh->getSkeletonName();
+#endif
+            import.success_ = true;
         }
         catch (Ogre::Exception &e)
         {
-            OgreRenderingModule::LogError("Failed to create mesh " + id_ + ": " + std::string(e.what()));
+            import.error_ = e.what();
+        }
+    }
+
+    bool OgreMeshResource::FinishImport(MeshImport& import)
+    {
+        PROFILE(OgreMeshResource_FinishImport);
+        importing_ = false;
+        if (ogre_mesh_.isNull())
+            return false;
+
+        if (import.success_)
+        {
+            try
+            {
+#ifdef OGRE_MESH_BACKGROUND_IMPORT
+                if (import.buffer_manager_)
+                {
+                    CopyToHardwareBuffers(ogre_mesh_.getPointer());
+                    ogre_mesh_->setHardwareBufferManager(0);
+                }
+#endif
+                if (ogre_mesh_->getSkeletonName() != import.skeleton_name_)
+                    ogre_mesh_->setSkeletonName(import.skeleton_name_);
+            }
+            catch (Ogre::Exception &e)
+            {
+                import.success_ = false;
+                import.error_ = e.what();
+            }
+        }
+
+        if (!import.success_)
+        {
+            OgreRenderingModule::LogError("Failed to create mesh " + id_ + ": " + import.error_);
             RemoveMesh();
             return false;
         }
 
+        original_materials_ = import.material_names_;
         OgreRenderingModule::LogDebug("Ogre mesh " + id_ + " created");
         return true;
     }
@@ -131,6 +298,6 @@ namespace OgreRenderer
     
     bool OgreMeshResource::IsValid() const
     {
-        return (!ogre_mesh_.isNull());
+        return (!ogre_mesh_.isNull()) && (!importing_);
     }
 }
\ No newline at end of file
@@ -9,6 +9,11 @@
 
 #include <OgreMesh.h>
 
+#if OGRE_VERSION_MAJOR > 1 || OGRE_VERSION_MINOR >= 7
+//! Since Ogre 1.7, meshes can be imported to system memory buffers, which lets the import run in a worker thread
+#define OGRE_MESH_BACKGROUND_IMPORT
+#endif
+
 namespace OgreRenderer
 {
     class OgreMeshResource;
@@ -56,6 +61,47 @@ namespace OgreRenderer
         
         //! returns original material names
         const StringVector& GetOriginalMaterialNames() const { return original_materials_; }
+
+        //! Outcome of importing mesh data, used to finish the mesh in the main thread
+        struct MeshImport
+        {
+            MeshImport() : success_(false) {}
+
+            //! Whether the mesh data could be imported
+            bool success_;
+            //! Error message if not
+            std::string error_;
+            //! Submesh material names in the mesh data
+            StringVector material_names_;
+            //! Skeleton name in the mesh data, not yet set to the mesh if imported to system memory
+            std::string skeleton_name_;
+#ifdef OGRE_MESH_BACKGROUND_IMPORT
+            //! Owner of the system memory buffers the mesh was imported to, null if imported to hardware buffers
+            boost::shared_ptr<Ogre::HardwareBufferManagerBase> buffer_manager_;
+#endif
+        };
+
+        //! Creates an empty Ogre mesh to import data to. The resource is not valid until FinishImport() is called
+        /*! \return The mesh, or null if it could not be created
+         */
+        Ogre::Mesh* BeginImport();
+
+        //! Imports mesh data, and generates tangents and submesh extremes
+        /*! With system memory buffers, touches neither the render system nor the Ogre resource managers,
+            and can be called from a worker thread while the main thread leaves the mesh alone.
+            \param mesh Mesh from BeginImport()
+            \param data Mesh data
+            \param size Size of mesh data
+            \param system_memory Whether to import to system memory buffers, which requires OGRE_MESH_BACKGROUND_IMPORT
+            \param import Outcome of the import
+         */
+        static void ImportMesh(Ogre::Mesh* mesh, const u8* data, uint size, bool system_memory, MeshImport& import);
+
+        //! Finishes the mesh after ImportMesh(), copying it to hardware buffers if it was imported to system memory.
+        //! Call from the main thread, before releasing the outcome of the import.
+        /*! \return true if successful
+         */
+        bool FinishImport(MeshImport& import);
         
     private:
         //! Ogre mesh
@@ -63,6 +109,9 @@ namespace OgreRenderer
         
         //! Original materials
         StringVector original_materials_;
+
+        //! Whether mesh data is being imported
+        bool importing_;
         
         //! destroys mesh if exists
         void RemoveMesh();
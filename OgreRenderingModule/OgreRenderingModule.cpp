@@ -22,6 +22,9 @@
 #include "ConsoleServiceInterface.h"
 #include "ConsoleCommandServiceInterface.h"
 #include "RendererSettings.h"
+#include "MeshLoadBenchmark.h"
+#include "StaticBatchBenchmark.h"
+#include "AnimationLodBenchmark.h"
 #include "ConfigurationManager.h"
 #include "EventManager.h"
 
@@ -34,7 +37,9 @@ namespace OgreRenderer
         asset_event_category_(0),
         resource_event_category_(0),
         input_event_category_(0),
-        scene_event_category_(0)
+        scene_event_category_(0),
+        network_state_event_category_(0),
+        task_event_category_(0)
     {
     }
 
@@ -104,12 +109,28 @@ namespace OgreRenderer
         input_event_category_ = event_manager->QueryEventCategory("Input");
         scene_event_category_ = event_manager->QueryEventCategory("Scene");
         network_state_event_category_ = event_manager->QueryEventCategory("NetworkState");
+        task_event_category_ = event_manager->QueryEventCategory("Task");
         
         renderer_->PostInitialize();
 
         RegisterConsoleCommand(Console::CreateCommand(
                 "RenderStats", "Prints out render statistics.", 
                 Console::Bind(this, &OgreRenderingModule::ConsoleStats)));
+        RegisterConsoleCommand(Console::CreateCommand(
+                "meshloadbench", "Loads the .mesh files in a directory, each the given number of times, in the background or in the "
+                "main thread, and prints a histogram of the frame times until they are loaded. "
+                "Usage: \"meshloadbench(directory, copies, background)\"",
+                Console::Bind(this, &OgreRenderingModule::ConsoleMeshLoadBenchmark)));
+        RegisterConsoleCommand(Console::CreateCommand(
+                "staticbatchbench", "Creates the given number of still entities in front of the camera, and prints the frame time "
+                "and batch count without and with static batching, measured over the given number of frames. "
+                "Usage: \"staticbatchbench(count, frames)\"",
+                Console::Bind(this, &OgreRenderingModule::ConsoleStaticBatchBenchmark)));
+        RegisterConsoleCommand(Console::CreateCommand(
+                "animbench", "Creates the given number of animated avatars around the camera, and prints the frame time "
+                "and animation update time without and with animation LOD, measured over the given number of frames. "
+                "Usage: \"animbench(count, frames)\"",
+                Console::Bind(this, &OgreRenderingModule::ConsoleAnimationLodBenchmark)));
         renderer_settings_ = RendererSettingsPtr(new RendererSettings(framework_));
     }
 
@@ -130,6 +151,11 @@ namespace OgreRenderer
             return renderer_->GetResourceHandler()->HandleResourceEvent(event_id, data);
         }
 
+        if (category_id == task_event_category_)
+        {
+            return renderer_->GetResourceHandler()->HandleTaskEvent(event_id, data);
+        }
+
         if (category_id == input_event_category_ && event_id == InputEvents::INWORLD_CLICK)
         {
             // do raycast into the world when user clicks mouse button
@@ -172,6 +198,9 @@ namespace OgreRenderer
         if (renderer_)
             renderer_->RemoveLogListener();
 
+        mesh_load_benchmark_.reset();
+        static_batch_benchmark_.reset();
+        animation_lod_benchmark_.reset();
         renderer_settings_.reset();
         renderer_.reset();
     }
@@ -182,6 +211,33 @@ namespace OgreRenderer
         {
             PROFILE(OgreRenderingModule_Update);
             renderer_->Update(frametime);
+
+            if (mesh_load_benchmark_ && mesh_load_benchmark_->Update(frametime))
+            {
+                Console::ConsoleServiceInterface *console = GetFramework()->GetService<Console::ConsoleServiceInterface>();
+                if (console)
+                    console->Print(mesh_load_benchmark_->GetReport());
+                LogInfo(mesh_load_benchmark_->GetReport());
+                mesh_load_benchmark_.reset();
+            }
+
+            if (static_batch_benchmark_ && static_batch_benchmark_->Update(frametime))
+            {
+                Console::ConsoleServiceInterface *console = GetFramework()->GetService<Console::ConsoleServiceInterface>();
+                if (console)
+                    console->Print(static_batch_benchmark_->GetReport());
+                LogInfo(static_batch_benchmark_->GetReport());
+                static_batch_benchmark_.reset();
+            }
+
+            if (animation_lod_benchmark_ && animation_lod_benchmark_->Update(frametime))
+            {
+                Console::ConsoleServiceInterface *console = GetFramework()->GetService<Console::ConsoleServiceInterface>();
+                if (console)
+                    console->Print(animation_lod_benchmark_->GetReport());
+                LogInfo(animation_lod_benchmark_->GetReport());
+                animation_lod_benchmark_.reset();
+            }
         }
         RESETPROFILER;
     }
@@ -206,6 +262,62 @@ namespace OgreRenderer
 
         return Console::ResultFailure("No renderer found.");
     }
+
+    Console::CommandResult OgreRenderingModule::ConsoleMeshLoadBenchmark(const StringVector &params)
+    {
+        if (params.empty())
+            return Console::ResultFailure("Usage: \"meshloadbench(directory, copies, background)\"");
+        if (!renderer_ || !renderer_->IsInitialized())
+            return Console::ResultFailure("No renderer found.");
+        if (mesh_load_benchmark_)
+            return Console::ResultFailure("Mesh load benchmark already running.");
+
+        uint copies = params.size() > 1 ? ParseString<uint>(params[1], 1) : 1;
+        bool background = params.size() < 3 || (params[2] != "0" && params[2] != "false");
+
+        std::vector<Foundation::AssetPtr> assets;
+        MeshLoadBenchmark::LoadAssets(params[0], assets);
+        if (assets.empty())
+            return Console::ResultFailure("No .mesh files found in " + params[0]);
+
+        mesh_load_benchmark_ = MeshLoadBenchmarkPtr(new MeshLoadBenchmark(renderer_->GetResourceHandler().get(), assets, copies, background));
+        mesh_load_benchmark_->Start();
+        return Console::ResultSuccess("Loading " + ToString(assets.size() * std::max(copies, 1u)) + " meshes, the frame time histogram is printed when done");
+    }
+
+    Console::CommandResult OgreRenderingModule::ConsoleStaticBatchBenchmark(const StringVector &params)
+    {
+        if (!renderer_ || !renderer_->IsInitialized())
+            return Console::ResultFailure("No renderer found.");
+        if (static_batch_benchmark_)
+            return Console::ResultFailure("Static batching benchmark already running.");
+
+        uint count = params.size() > 0 ? ParseString<uint>(params[0], 20000) : 20000;
+        uint frames = params.size() > 1 ? ParseString<uint>(params[1], 200) : 200;
+
+        static_batch_benchmark_ = StaticBatchBenchmarkPtr(new StaticBatchBenchmark(renderer_.get(), count, frames));
+        static_batch_benchmark_->Start();
+        return Console::ResultSuccess("Measuring " + ToString(std::max(count, 1u)) + " entities, the results are printed when done");
+    }
+
+    Console::CommandResult OgreRenderingModule::ConsoleAnimationLodBenchmark(const StringVector &params)
+    {
+        if (!renderer_ || !renderer_->IsInitialized())
+            return Console::ResultFailure("No renderer found.");
+        if (animation_lod_benchmark_)
+            return Console::ResultFailure("Animation LOD benchmark already running.");
+
+        uint count = params.size() > 0 ? ParseString<uint>(params[0], 200) : 200;
+        uint frames = params.size() > 1 ? ParseString<uint>(params[1], 200) : 200;
+
+        animation_lod_benchmark_ = AnimationLodBenchmarkPtr(new AnimationLodBenchmark(framework_, renderer_.get(), count, frames));
+        if (!animation_lod_benchmark_->Start())
+        {
+            animation_lod_benchmark_.reset();
+            return Console::ResultFailure("Could not create animated avatars from avatar.mesh.");
+        }
+        return Console::ResultSuccess("Measuring " + ToString(std::max(count, 1u)) + " avatars, the results are printed when done");
+    }
 }
 
 extern "C" void POCO_LIBRARY_API SetProfiler(Foundation::Profiler *profiler);
@@ -19,6 +19,12 @@ namespace OgreRenderer
     typedef boost::shared_ptr<Renderer> RendererPtr;
     class RendererSettings;
     typedef boost::shared_ptr<RendererSettings> RendererSettingsPtr;
+    class MeshLoadBenchmark;
+    typedef boost::shared_ptr<MeshLoadBenchmark> MeshLoadBenchmarkPtr;
+    class StaticBatchBenchmark;
+    typedef boost::shared_ptr<StaticBatchBenchmark> StaticBatchBenchmarkPtr;
+    class AnimationLodBenchmark;
+    typedef boost::shared_ptr<AnimationLodBenchmark> AnimationLodBenchmarkPtr;
 
     //! \bug Ogre assert fail when viewing a mesh that contains a reference to non-existing skeleton.
     
@@ -54,6 +60,15 @@ namespace OgreRenderer
         //! callback for console command
         Console::CommandResult ConsoleStats(const StringVector &params);
 
+        //! callback for console command
+        Console::CommandResult ConsoleMeshLoadBenchmark(const StringVector &params);
+
+        //! callback for console command
+        Console::CommandResult ConsoleStaticBatchBenchmark(const StringVector &params);
+
+        //! callback for console command
+        Console::CommandResult ConsoleAnimationLodBenchmark(const StringVector &params);
+
      
 
     private:
@@ -66,6 +81,15 @@ namespace OgreRenderer
         //! renderer settings
         RendererSettingsPtr renderer_settings_;
 
+        //! running mesh load benchmark
+        MeshLoadBenchmarkPtr mesh_load_benchmark_;
+
+        //! running static batching benchmark
+        StaticBatchBenchmarkPtr static_batch_benchmark_;
+
+        //! running animation LOD benchmark
+        AnimationLodBenchmarkPtr animation_lod_benchmark_;
+
         //! asset event category
         event_category_id_t asset_event_category_;
 
@@ -80,6 +104,9 @@ namespace OgreRenderer
 
         //! network state category
         event_category_id_t network_state_event_category_;
+
+        //! thread task category
+        event_category_id_t task_event_category_;
     };
 }
 
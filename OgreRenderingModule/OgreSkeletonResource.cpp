@@ -9,12 +9,14 @@
 namespace OgreRenderer
 {
     OgreSkeletonResource::OgreSkeletonResource(const std::string& id) :
-        ResourceInterface(id)
+        ResourceInterface(id),
+        importing_(false)
     {
     }
 
     OgreSkeletonResource::OgreSkeletonResource(const std::string& id, Foundation::AssetPtr source) :
-        ResourceInterface(id)
+        ResourceInterface(id),
+        importing_(false)
     {
         SetData(source);
     }
@@ -37,6 +39,17 @@ namespace OgreRenderer
             return false;
         }
 
+        Ogre::Skeleton* skeleton = BeginImport();
+        if (!skeleton)
+            return false;
+
+        std::string error;
+        bool success = ImportSkeleton(skeleton, source->GetData(), source->GetSize(), error);
+        return FinishImport(success, error);
+    }
+
+    Ogre::Skeleton* OgreSkeletonResource::BeginImport()
+    {
         try
         {
             if (ogre_skeleton_.isNull())
@@ -47,17 +60,45 @@ namespace OgreRenderer
                 if (ogre_skeleton_.isNull())
                 {
                     OgreRenderingModule::LogError("Failed to create skeleton " + id_);
-                    return false; 
+                    return 0; 
                 }
             }
+        }
+        catch (Ogre::Exception &e)
+        {
+            OgreRenderingModule::LogError("Failed to create skeleton " + id_ + ": " + std::string(e.what()));
+            return 0;
+        }
 
-            Ogre::DataStreamPtr stream(new Ogre::MemoryDataStream((void*)source->GetData(), source->GetSize(), false));
+        importing_ = true;
+        return ogre_skeleton_.getPointer();
+    }
+
+    bool OgreSkeletonResource::ImportSkeleton(Ogre::Skeleton* skeleton, const u8* data, uint size, std::string& error)
+    {
+        try
+        {
+            Ogre::DataStreamPtr stream(new Ogre::MemoryDataStream((void*)data, size, false));
             Ogre::SkeletonSerializer serializer;
-            serializer.importSkeleton(stream, ogre_skeleton_.getPointer());
+            serializer.importSkeleton(stream, skeleton);
         }
         catch (Ogre::Exception &e)
         {
-            OgreRenderingModule::LogError("Failed to create skeleton " + id_ + ": " + std::string(e.what()));
+            error = e.what();
+            return false;
+        }
+        return true;
+    }
+
+    bool OgreSkeletonResource::FinishImport(bool success, const std::string& error)
+    {
+        importing_ = false;
+        if (ogre_skeleton_.isNull())
+            return false;
+
+        if (!success)
+        {
+            OgreRenderingModule::LogError("Failed to create skeleton " + id_ + ": " + error);
             RemoveSkeleton();
             return false;
         }
@@ -95,6 +136,6 @@ namespace OgreRenderer
 
     bool OgreSkeletonResource::IsValid() const
     {
-        return (!ogre_skeleton_.isNull());
+        return (!ogre_skeleton_.isNull()) && (!importing_);
     }
 }
@@ -54,8 +54,33 @@ namespace OgreRenderer
         //! returns resource type in text form (static)
         static const std::string& GetTypeStatic();
 
+        //! Creates an empty Ogre skeleton to import data to. The resource is not valid until FinishImport() is called
+        /*! \return The skeleton, or null if it could not be created
+         */
+        Ogre::Skeleton* BeginImport();
+
+        //! Imports skeleton data. Skeletons hold no hardware buffers, so this can be called from a worker thread
+        //! while the main thread leaves the skeleton alone.
+        /*! \param skeleton Skeleton from BeginImport()
+            \param data Skeleton data
+            \param size Size of skeleton data
+            \param error Error message if not successful
+            \return true if successful
+         */
+        static bool ImportSkeleton(Ogre::Skeleton* skeleton, const u8* data, uint size, std::string& error);
+
+        //! Finishes the skeleton after ImportSkeleton(). Call from the main thread
+        /*! \param success Whether ImportSkeleton() succeeded
+            \param error Error message of ImportSkeleton()
+            \return true if successful
+         */
+        bool FinishImport(bool success, const std::string& error);
+
     private:
         Ogre::SkeletonPtr ogre_skeleton_;
+
+        //! Whether skeleton data is being imported
+        bool importing_;
         
         //! Deinitializes the skeleton and frees all Ogre-side structures as well.
         void RemoveSkeleton();
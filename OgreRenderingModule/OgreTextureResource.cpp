@@ -118,6 +118,9 @@ namespace OgreRenderer
             }
         }
 
+        if ((source->GetNumMipmaps()) || (Ogre::PixelUtil::isCompressed(pixel_format)))
+            return SetDataWithMipmaps(source, pixel_format);
+
         try
         {
             if (ogre_texture_.isNull())
@@ -134,15 +137,19 @@ namespace OgreRenderer
             }
             else
             {
-                // See if size/format changed, have to delete/recreate internal resources
+                // See if size/format changed, have to delete/recreate internal resources. Also if the earlier contents
+                // had their own mipmaps, as then the mipmaps were not generated automatically
                 if ((source->GetWidth() != ogre_texture_->getWidth()) ||
                     (source->GetHeight() != ogre_texture_->getHeight()) ||
-                    (pixel_format != ogre_texture_->getFormat()))
+                    (pixel_format != ogre_texture_->getFormat()) ||
+                    (!(ogre_texture_->getUsage() & Ogre::TU_AUTOMIPMAP)))
                 {
                     ogre_texture_->freeInternalResources();
                     ogre_texture_->setWidth(source->GetWidth());
                     ogre_texture_->setHeight(source->GetHeight());
                     ogre_texture_->setFormat(pixel_format);
+                    ogre_texture_->setNumMipmaps(Ogre::TextureManager::getSingleton().getDefaultNumMipmaps());
+                    ogre_texture_->setUsage(Ogre::TU_DEFAULT);
                     ogre_texture_->createInternalResources();
                 }
             }
@@ -176,6 +183,95 @@ namespace OgreRenderer
         return true;
     }
 
+    bool OgreTextureResource::SetDataWithMipmaps(Foundation::TexturePtr source, Ogre::PixelFormat pixel_format)
+    {
+        if (Ogre::PixelUtil::isCompressed(pixel_format))
+        {
+            Ogre::RenderSystem* render_system = Ogre::Root::getSingleton().getRenderSystem();
+            if ((!render_system) || (!render_system->getCapabilities()) ||
+                (!render_system->getCapabilities()->hasCapability(Ogre::RSC_TEXTURE_COMPRESSION_DXT)))
+            {
+                OgreRenderingModule::LogError("Texture " + id_ + " is DXT compressed, which the render system does not support");
+                return false;
+            }
+        }
+
+        uint width = source->GetWidth();
+        uint height = source->GetHeight();
+        uint num_mipmaps = source->GetNumMipmaps();
+        const u8* data = source->GetData();
+        const u8* data_end = data + source->GetDataSize();
+
+        // For the highest level texture, leave out the full size image in low quality mode
+        if ((!source->GetLevel()) && (texturequality_ == Texture_Low) && (num_mipmaps))
+        {
+            data += Ogre::PixelUtil::getMemorySize(width, height, 1, pixel_format);
+            width = std::max(width / 2, 1u);
+            height = std::max(height / 2, 1u);
+            --num_mipmaps;
+        }
+
+        try
+        {
+            if (ogre_texture_.isNull())
+            {
+                ogre_texture_ = Ogre::TextureManager::getSingleton().createManual(
+                    id_, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME, Ogre::TEX_TYPE_2D,
+                    width, height, num_mipmaps, pixel_format, Ogre::TU_STATIC_WRITE_ONLY);
+
+                if (ogre_texture_.isNull())
+                {
+                    OgreRenderingModule::LogError("Failed to create texture " + id_);
+                    return false;
+                }
+            }
+            else if ((width != ogre_texture_->getWidth()) ||
+                (height != ogre_texture_->getHeight()) ||
+                (pixel_format != ogre_texture_->getFormat()) ||
+                (num_mipmaps != ogre_texture_->getNumMipmaps()) ||
+                (ogre_texture_->getUsage() & Ogre::TU_AUTOMIPMAP))
+            {
+                ogre_texture_->freeInternalResources();
+                ogre_texture_->setWidth(width);
+                ogre_texture_->setHeight(height);
+                ogre_texture_->setFormat(pixel_format);
+                ogre_texture_->setNumMipmaps(num_mipmaps);
+                ogre_texture_->setUsage(Ogre::TU_STATIC_WRITE_ONLY);
+                ogre_texture_->createInternalResources();
+            }
+
+            // The data holds the levels one after another, from the largest
+            for (uint mip = 0; mip <= num_mipmaps; ++mip)
+            {
+                size_t size = Ogre::PixelUtil::getMemorySize(width, height, 1, pixel_format);
+                if (data + size > data_end)
+                {
+                    OgreRenderingModule::LogError("Texture " + id_ + " has less data than its mipmaps need");
+                    return false;
+                }
+
+                Ogre::Box dimensions(0, 0, width, height);
+                Ogre::PixelBox pixel_box(dimensions, pixel_format, (void*)data);
+                Ogre::HardwarePixelBufferSharedPtr buffer = ogre_texture_->getBuffer(0, mip);
+                if (!buffer.isNull())
+                    buffer->blitFromMemory(pixel_box);
+
+                data += size;
+                width = std::max(width / 2, 1u);
+                height = std::max(height / 2, 1u);
+            }
+        }
+        catch (Ogre::Exception &e)
+        {
+            OgreRenderingModule::LogError("Failed to create texture " + id_ + ": " + std::string(e.what()));
+            return false;
+        }
+
+        OgreRenderingModule::LogDebug("Ogre texture " + id_ + " updated with " + ToString<uint>(num_mipmaps) + " mipmaps");
+        level_ = source->GetLevel();
+        return true;
+    }
+
     bool OgreTextureResource::HasAlpha() const
     {
         if (ogre_texture_.get())
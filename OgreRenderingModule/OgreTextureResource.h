@@ -70,6 +70,9 @@ namespace OgreRenderer
         static const std::string& GetTypeStatic();
 
     private:
+        //! Sets contents from a raw source texture that holds its own mipmap levels, such as a DXT compressed one
+        bool SetDataWithMipmaps(Foundation::TexturePtr source, Ogre::PixelFormat pixel_format);
+
         //! Remove texture
         void RemoveTexture();
         
@@ -6,6 +6,8 @@
 #include "Renderer.h"
 #include "RendererEvents.h"
 #include "ResourceHandler.h"
+#include "MeshBvh.h"
+#include "StaticBatcher.h"
 #include "OgreRenderingModule.h"
 #include "OgreConversionUtils.h"
 #include "EC_Placeable.h"
@@ -141,6 +143,10 @@ namespace OgreRenderer
         config_filename_(config),
         plugins_filename_(plugins),
         ray_query_(0),
+        mesh_bvhs_(new MeshBvhCache()),
+        mesh_bvh_prune_timer_(0.0),
+        animation_lod_(true),
+        animation_lod_distance_(20.0f),
         window_title_(window_title),
         renderWindow(0),
         last_width_(0),
@@ -177,6 +183,8 @@ namespace OgreRenderer
         foreach(GaussianListener* listener, gaussianListeners_)
             SAFE_DELETE(listener);
 
+        mesh_bvhs_.reset();
+        static_batcher_.reset();
         resource_handler_.reset();
         root_.reset();
         SAFE_DELETE(c_handler_);
@@ -224,6 +232,8 @@ namespace OgreRenderer
         Ogre::LogManager::getSingleton().getDefaultLog()->addListener(log_listener_.get());
 
         view_distance_ = framework_->GetDefaultConfig().DeclareSetting("OgreRenderer", "view_distance", 500.0);
+        animation_lod_ = framework_->GetDefaultConfig().DeclareSetting("OgreRenderer", "animation_lod", true);
+        animation_lod_distance_ = (float)framework_->GetDefaultConfig().DeclareSetting("OgreRenderer", "animation_lod_distance", 20.0);
 
         // Load plugins
         LoadPlugins(plugins_filename_);
@@ -431,6 +441,10 @@ namespace OgreRenderer
         renderable_listener_ = RenderableListenerPtr(new RenderableListener(this));
         scenemanager_->getRenderQueue()->setRenderableListener(renderable_listener_.get());
 
+        float cell_size = (float)framework_->GetDefaultConfig().DeclareSetting("OgreRenderer", "static_batch_cell_size", 64.0);
+        static_batcher_ = StaticBatcherPtr(new StaticBatcher(scenemanager_, cell_size));
+        static_batcher_->SetEnabled(framework_->GetDefaultConfig().DeclareSetting("OgreRenderer", "static_batching", false));
+
         InitShadows();
 
         c_handler_->Initialize(framework_ ,viewport_);
@@ -462,6 +476,22 @@ namespace OgreRenderer
     void Renderer::Update(f64 frametime)
     {
         Ogre::WindowEventUtilities::messagePump();
+
+        if (initialized_)
+        {
+            resource_handler_->FinishLoadedResources();
+            resource_handler_->UpdateResourcePriorities(frametime);
+
+            // Drop the hierarchies of destroyed meshes once in a while
+            mesh_bvh_prune_timer_ += frametime;
+            if (mesh_bvh_prune_timer_ >= 5.0)
+            {
+                mesh_bvh_prune_timer_ = 0.0;
+                mesh_bvhs_->Prune();
+            }
+
+            static_batcher_->Update(frametime);
+        }
     }
     
     void Renderer::SetCurrentCamera(Ogre::Camera* camera)
@@ -870,6 +900,14 @@ namespace OgreRenderer
         return t;
     }
 
+    MeshBvhPtr Renderer::GetStaticMeshBvh(Ogre::Entity* entity)
+    {
+        // Vertices deformed by skeletons or vertex animation are not where the hierarchy has them
+        if (entity->hasSkeleton() || entity->hasVertexAnimation())
+            return MeshBvhPtr();
+        return mesh_bvhs_->GetBvh(entity->getMesh().getPointer());
+    }
+
     RaycastResult* Renderer::Raycast(int x, int y)
     {
         static RaycastResult result;
@@ -977,7 +1015,43 @@ namespace OgreRenderer
                 Ogre::Entity* ogre_entity = static_cast<Ogre::Entity*>(entry.movable);
                 assert(ogre_entity != 0);
 
-                // get the mesh information
+                // Static meshes: cast the ray in object space against the cached hierarchy
+                MeshBvhPtr bvh = GetStaticMeshBvh(ogre_entity);
+                if (bvh)
+                {
+                    Ogre::Node* node = ogre_entity->getParentNode();
+                    const Ogre::Vector3& scale = node->_getDerivedScale();
+                    if (scale.x == 0.0f || scale.y == 0.0f || scale.z == 0.0f)
+                        continue;
+                    Ogre::Quaternion inv_orient = node->_getDerivedOrientation().Inverse();
+                    // Not normalized, so that distances along the ray stay the same as in world space
+                    Ogre::Ray local_ray(inv_orient * (ray.getOrigin() - node->_getDerivedPosition()) / scale, inv_orient * ray.getDirection() / scale);
+
+                    MeshBvh::RayHit hit;
+                    if (bvh->Raycast(local_ray, scale.x * scale.y * scale.z < 0.0f, hit))
+                    {
+                        if ((closest_distance < 0.0f) || (hit.distance_ < closest_distance) || (current_priority > closest_priority))
+                        {
+                            if (current_priority >= closest_priority)
+                            {
+                                // this is the closest/best so far, save it
+                                closest_distance = hit.distance_;
+                                closest_priority = current_priority;
+
+                                Ogre::Vector3 point = ray.getPoint(closest_distance);
+
+                                result.entity_ = entity;
+                                result.pos_ = Vector3df(point.x, point.y, point.z);
+                                result.submesh_ = hit.submesh_;
+                                result.u_ = hit.u_;
+                                result.v_ = hit.v_;
+                            }
+                        }
+                    }
+                    continue;
+                }
+
+                // Animated meshes: get the mesh information
                 GetMeshInformation(ogre_entity, vertices, texcoords, indices, submeshstartindex,
                     ogre_entity->getParentNode()->_getDerivedPosition(),
                     ogre_entity->getParentNode()->_getDerivedOrientation(),
@@ -1047,31 +1121,95 @@ namespace OgreRenderer
             return result;
      } */
 
-    //qt wrapper / upcoming replacement for the one above
+    //! Returns a world space plane in the object space of a transform
+    static Ogre::Plane ToObjectSpace(const Ogre::Plane& plane, const Ogre::Matrix4& transform)
+    {
+        Ogre::Vector4 local = transform.transpose() * Ogre::Vector4(plane.normal.x, plane.normal.y, plane.normal.z, plane.d);
+        Ogre::Plane result;
+        result.normal = Ogre::Vector3(local.x, local.y, local.z);
+        result.d = local.w;
+        return result;
+    }
+
     QVariantList Renderer::FrustumQuery(QRect &viewrect)
     {
-/*
+        QVariantList l;
+        if (!initialized_)
+            return l;
+
+        int width = renderWindow->OgreRenderWindow()->getWidth();
+        int height = renderWindow->OgreRenderWindow()->getHeight();
+        QRect rect = viewrect.normalized();
+        if (!width || !height || rect.width() < 2 || rect.height() < 2)
+            return l;
+
+        float left = rect.left() / (float)width;
+        float right = rect.right() / (float)width;
+        float top = rect.top() / (float)height;
+        float bottom = rect.bottom() / (float)height;
+        Ogre::Ray top_left = camera_->getCameraToViewportRay(left, top);
+        Ogre::Ray top_right = camera_->getCameraToViewportRay(right, top);
+        Ogre::Ray bottom_left = camera_->getCameraToViewportRay(left, bottom);
+        Ogre::Ray bottom_right = camera_->getCameraToViewportRay(right, bottom);
+
+        // The inside of the volume is on the positive side of its planes
+        Ogre::PlaneBoundedVolume volume;
+        const Ogre::Real near_distance = camera_->getNearClipDistance();
+        const Ogre::Real far_distance = view_distance_;
+        volume.planes.push_back(Ogre::Plane(top_left.getPoint(near_distance), top_right.getPoint(near_distance), bottom_right.getPoint(near_distance)));
+        volume.planes.push_back(Ogre::Plane(top_left.getOrigin(), top_left.getPoint(far_distance), top_right.getPoint(far_distance)));
+        volume.planes.push_back(Ogre::Plane(top_left.getOrigin(), bottom_left.getPoint(far_distance), top_left.getPoint(far_distance)));
+        volume.planes.push_back(Ogre::Plane(bottom_left.getOrigin(), bottom_right.getPoint(far_distance), bottom_left.getPoint(far_distance)));
+        volume.planes.push_back(Ogre::Plane(top_right.getOrigin(), top_right.getPoint(far_distance), bottom_right.getPoint(far_distance)));
+
         Ogre::PlaneBoundedVolumeList volumes;
-        Ogre::PlaneBoundedVolume p;
-        Ogre::Plane plane;
-        p.planes.push_back(plane);
-        volumes.push_back(p);
+        volumes.push_back(volume);
         Ogre::PlaneBoundedVolumeListSceneQuery *query = scenemanager_->createPlaneBoundedVolumeQuery(volumes);
-        assert(query);
+        Ogre::SceneQueryResult& results = query->execute();
 
-        Ogre::SceneQueryResult results = query->execute();
-        for(Ogre::SceneQueryResultMovableList::iterator iter = results.movables.begin(); iter != results.movables.end(); ++iter)
+        std::set<Scene::Entity*> found;
+        std::vector<Ogre::Plane> local_planes(volume.planes.size());
+        for(Ogre::SceneQueryResultMovableList::iterator i = results.movables.begin(); i != results.movables.end(); ++i)
         {
-            MovableObject *m = *iter;
-            std::cout << "Hit MovableObject:" << m << std::endl;
+            Ogre::MovableObject* movable = *i;
+            Ogre::Any any = movable->getUserAny();
+            if (any.isEmpty())
+                continue;
+
+            Scene::Entity *entity = 0;
+            try
+            {
+                entity = Ogre::any_cast<Scene::Entity*>(any);
+            }
+            catch (Ogre::InvalidParametersException &/*e*/)
+            {
+                continue;
+            }
+            if (found.find(entity) != found.end())
+                continue;
+
+            // Static meshes are tested to the polygon level, other objects by their bounding box
+            if (movable->getMovableType().compare("Entity") == 0)
+            {
+                Ogre::Entity* ogre_entity = static_cast<Ogre::Entity*>(movable);
+                MeshBvhPtr bvh = GetStaticMeshBvh(ogre_entity);
+                if (bvh)
+                {
+                    Ogre::Node* node = ogre_entity->getParentNode();
+                    Ogre::Matrix4 transform;
+                    transform.makeTransform(node->_getDerivedPosition(), node->_getDerivedScale(), node->_getDerivedOrientation());
+                    for(uint j = 0; j < volume.planes.size(); ++j)
+                        local_planes[j] = ToObjectSpace(volume.planes[j], transform);
+                    if (!bvh->Intersects(local_planes))
+                        continue;
+                }
+            }
+
+            found.insert(entity);
+            l << QVariant::fromValue<QObject*>(entity);
         }
 
         scenemanager_->destroyQuery(query);
-*/
-        QVariantList l;
-        l << 1;
-        l << 2;
-        l << 3;
         return l;
     }
 
@@ -1100,6 +1238,16 @@ namespace OgreRenderer
         return resource_handler_->RemoveResource(id, type);
     }
 
+    void Renderer::SetResourceRequestLocation(const std::string& id, request_tag_t tag, const Vector3df& position, f32 radius)
+    {
+        resource_handler_->SetResourceRequestLocation(id, tag, Ogre::Vector3(position.x, position.y, position.z), radius);
+    }
+
+    void Renderer::CancelResourceRequest(const std::string& id, request_tag_t tag)
+    {
+        resource_handler_->CancelResourceRequest(id, tag);
+    }
+
     void Renderer::TakeScreenshot(const std::string& filePath, const std::string& fileName)
     {
         if (renderWindow)
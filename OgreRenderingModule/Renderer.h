@@ -44,11 +44,17 @@ namespace OgreRenderer
     class StereoController;
     class CompositionHandler;
     class GaussianListener;
+    class MeshBvh;
+    class MeshBvhCache;
+    class StaticBatcher;
 
     typedef boost::shared_ptr<Ogre::Root> OgreRootPtr;
     typedef boost::shared_ptr<LogListener> OgreLogListenerPtr;
     typedef boost::shared_ptr<ResourceHandler> ResourceHandlerPtr;
     typedef boost::shared_ptr<RenderableListener> RenderableListenerPtr;
+    typedef boost::shared_ptr<MeshBvh> MeshBvhPtr;
+    typedef boost::shared_ptr<MeshBvhCache> MeshBvhCachePtr;
+    typedef boost::shared_ptr<StaticBatcher> StaticBatcherPtr;
 
     //! Ogre renderer
     /*! Created by OgreRenderingModule. Implements the RenderServiceInterface.
@@ -154,6 +160,22 @@ namespace OgreRenderer
          */
         virtual void RemoveResource(const std::string& id, const std::string& type);
 
+        //! Tells where in the world a requested resource will be used, so that its download goes before those of
+        //! resources that will appear smaller on screen. The priority follows the camera until the resource is ready
+        /*! \param id Resource id
+            \param tag Request tag from RequestResource()
+            \param position World position
+            \param radius Approximate radius of the object that will use the resource
+         */
+        void SetResourceRequestLocation(const std::string& id, request_tag_t tag, const Vector3df& position, f32 radius);
+
+        //! Withdraws a resource request. No RESOURCE_READY event will be sent for the tag, and the download is canceled
+        //! if no other request is waiting for it
+        /*! \param id Resource id
+            \param tag Request tag from RequestResource()
+         */
+        void CancelResourceRequest(const std::string& id, request_tag_t tag);
+
         //! Returns framework
         Foundation::Framework* GetFramework() const { return framework_; }
 
@@ -186,6 +208,9 @@ namespace OgreRenderer
         //! Returns resource handler
         ResourceHandlerPtr GetResourceHandler() const { return resource_handler_; }
 
+        //! Returns the static batcher, which components register their entities with. Null before the scene is set up
+        StaticBatcherPtr GetStaticBatcher() const { return static_batcher_; }
+
         //! Removes log listener
         void RemoveLogListener();
 
@@ -219,6 +244,16 @@ namespace OgreRenderer
         //! Sets shadow quality. Note: changes need viewer restart to take effect due to Ogre resource system
         void SetShadowQuality(ShadowQuality newquality);
 
+        //! Returns whether animation controllers update less often by distance, and not at all off-screen
+        bool IsAnimationLodEnabled() const { return animation_lod_; }
+
+        //! Enables or disables animation LOD
+        void SetAnimationLodEnabled(bool enabled) { animation_lod_ = enabled; }
+
+        //! Returns the camera distance beyond which animations update every second frame. The interval doubles with each
+        //! doubling of the distance
+        float GetAnimationLodDistance() const { return animation_lod_distance_; }
+
         //! Returns texture quality
         TextureQuality GetTextureQuality() const { return texturequality_; }
 
@@ -268,6 +303,9 @@ namespace OgreRenderer
         //! Initializes shadows. Called by SetupScene().
         void InitShadows();
 
+        //! Returns the bounding volume hierarchy of the mesh of an entity, or null if the entity deforms its mesh
+        MeshBvhPtr GetStaticMeshBvh(Ogre::Entity* entity);
+
         //! Successfully initialized flag
         bool initialized_;
 
@@ -321,6 +359,21 @@ namespace OgreRenderer
         //! ray for raycasting, reusable
         Ogre::RaySceneQuery *ray_query_;
 
+        //! bounding volume hierarchies of meshes, for polygon-level raycasts and frustum queries
+        MeshBvhCachePtr mesh_bvhs_;
+
+        //! time since meshes were last checked for hierarchies to drop
+        f64 mesh_bvh_prune_timer_;
+
+        //! batches still entities into static geometry
+        StaticBatcherPtr static_batcher_;
+
+        //! animation LOD -flag
+        bool animation_lod_;
+
+        //! distance beyond which animations are updated less often
+        float animation_lod_distance_;
+
         //! window title to be used when creating renderwindow
         std::string window_title_;
 
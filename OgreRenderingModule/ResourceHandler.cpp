@@ -18,13 +18,21 @@
 #include "Framework.h"
 #include "EventManager.h"
 #include "ServiceManager.h"
+#include "ThreadTaskManager.h"
+#include "ConfigurationManager.h"
+#include "HighPerfClock.h"
+
+#include <Ogre.h>
 
 
 namespace OgreRenderer
 {
     ResourceHandler::ResourceHandler(Renderer* renderer, Foundation::Framework* framework) :
         renderer_(renderer),
-        framework_(framework)
+        framework_(framework),
+        texture_priority_timer_(0.0),
+        background_loading_(false),
+        finish_time_budget_(0.004)
     {
         source_types_[OgreTextureResource::GetTypeStatic()] = RexTypes::ASSETTYPENAME_TEXTURE;
         source_types_[OgreMeshResource::GetTypeStatic()] = RexTypes::ASSETTYPENAME_MESH;
@@ -47,6 +55,11 @@ namespace OgreRenderer
             }
             ++i;
         }
+
+        // Make sure no worker thread is still loading to the resources
+        framework_->GetThreadTaskManager()->RemoveThreadTask(ResourceLoader::GetTaskDescriptionStatic());
+        loaded_resources_.clear();
+        pending_loads_.clear();
                 
         resources_.clear();
     }
@@ -56,6 +69,12 @@ namespace OgreRenderer
         EventManagerPtr event_manager = framework_->GetEventManager();
         
         resource_event_category_ = event_manager->QueryEventCategory("Resource");
+
+        // Deserialize on a couple of threads, leaving most of the thread pool to the texture decoder
+        background_loading_ = framework_->GetDefaultConfig().DeclareSetting("OgreRenderer", "background_resource_loading", true);
+        uint max_load_threads = framework_->GetDefaultConfig().DeclareSetting("OgreRenderer", "max_resource_load_threads", 2);
+        finish_time_budget_ = framework_->GetDefaultConfig().DeclareSetting("OgreRenderer", "resource_finish_time_ms", 4.0) / 1000.0;
+        framework_->GetThreadTaskManager()->AddThreadTask(Foundation::ThreadTaskPtr(new ResourceLoader(std::max(max_load_threads, 1u))));
     }
     
     Foundation::ResourcePtr ResourceHandler::GetResource(const std::string& id, const std::string& type)
@@ -152,6 +171,9 @@ namespace OgreRenderer
                 if (expected_request_tags_.find(event_data->tag_) == expected_request_tags_.end())
                     return false;
 
+                source_tags_.erase(event_data->asset_id_);
+                download_priorities_.erase(event_data->asset_id_);
+
                 if (event_data->asset_type_ == RexTypes::ASSETTYPENAME_MESH)
                     UpdateMesh(event_data->asset_, event_data->tag_);
 
@@ -180,6 +202,8 @@ namespace OgreRenderer
                     framework_->GetEventManager()->SendEvent(resource_event_category_, Resource::Events::RESOURCE_CANCELED, &canceled_event_data);
                 }
                 request_tags_.erase(event_data->asset_id_);
+                source_tags_.erase(event_data->asset_id_);
+                download_priorities_.erase(event_data->asset_id_);
                 
                 // Check if the asset matches outstanding resource references
                 std::map<std::string, Foundation::ResourceReferenceVector>::iterator i = outstanding_references_.begin();
@@ -226,6 +250,350 @@ namespace OgreRenderer
         return false;
     }
 
+    bool ResourceHandler::HandleTaskEvent(event_id_t event_id, IEventData* data)
+    {
+        if (event_id != Task::Events::REQUEST_COMPLETED)
+            return false;
+        ResourceLoadResult* result = dynamic_cast<ResourceLoadResult*>(data);
+        if (!result || result->task_description_ != ResourceLoader::GetTaskDescriptionStatic())
+            return false;
+
+        std::map<std::string, PendingLoad>::iterator i = pending_loads_.find(result->id_);
+        if (i == pending_loads_.end() || i->second.tag_ != result->tag_)
+            return false;
+
+        // The event data is only valid during the event, so keep a copy to finish later
+        i->second.loaded_ = true;
+        loaded_resources_.push_back(ResourceLoadResultPtr(new ResourceLoadResult(*result)));
+        return false;
+    }
+
+    bool ResourceHandler::UpdateResource(Foundation::AssetPtr source)
+    {
+        if (!source)
+            return false;
+
+        const std::string& type = source->GetType();
+        if (type == RexTypes::ASSETTYPENAME_MESH)
+            return UpdateMesh(source, 0);
+        if (type == RexTypes::ASSETTYPENAME_SKELETON)
+            return UpdateSkeleton(source, 0);
+        if (type == RexTypes::ASSETTYPENAME_MATERIAL_SCRIPT)
+            return UpdateMaterial(source, 0);
+        if (type == RexTypes::ASSETTYPENAME_PARTICLE_SCRIPT)
+            return UpdateParticles(source, 0);
+        if (type == RexTypes::ASSETTYPENAME_IMAGE)
+            return UpdateImageTexture(source, 0);
+
+        OgreRenderingModule::LogWarning("Can not create a resource from asset " + source->GetId() + " of type " + type);
+        return false;
+    }
+
+    ResourceHandler::ResourceLoadState ResourceHandler::GetResourceLoadState(const std::string& id) const
+    {
+        std::map<std::string, PendingLoad>::const_iterator l = pending_loads_.find(id);
+        if (l != pending_loads_.end())
+            return l->second.loaded_ ? RLS_Finishing : RLS_Loading;
+
+        Foundation::ResourceMap::const_iterator r = resources_.find(id);
+        if (r != resources_.end() && r->second->IsValid())
+        {
+            std::map<std::string, Foundation::ResourceReferenceVector>::const_iterator o = outstanding_references_.find(id);
+            if (o != outstanding_references_.end() && !o->second.empty())
+                return RLS_WaitingReferences;
+            return RLS_Ready;
+        }
+
+        if (request_tags_.find(id) != request_tags_.end())
+            return RLS_Requested;
+        return RLS_Unknown;
+    }
+
+    void ResourceHandler::FinishLoadedResources()
+    {
+        if (loaded_resources_.empty())
+            return;
+
+        PROFILE(ResourceHandler_FinishLoadedResources);
+        const tick_t start_time = GetCurrentClockTime();
+        const tick_t budget = (tick_t)(finish_time_budget_ * GetCurrentClockFreq());
+
+        // At least one resource is finished each frame, even if it alone takes longer than the budget
+        while (!loaded_resources_.empty())
+        {
+            ResourceLoadResultPtr result = loaded_resources_.front();
+            loaded_resources_.pop_front();
+            FinishLoad(*result);
+            if (GetCurrentClockTime() - start_time >= budget)
+                break;
+        }
+    }
+
+    bool ResourceHandler::LoadInBackground(Foundation::ResourcePtr resource, Foundation::AssetPtr source, LoadedResourceType type)
+    {
+        const std::string& id = resource->GetId();
+        if (pending_loads_.find(id) != pending_loads_.end())
+            return true;
+        if (!source || !source->GetSize())
+            return false;
+
+        ResourceLoadRequestPtr request(new ResourceLoadRequest());
+        request->id_ = id;
+        request->type_ = type;
+        request->data_ = source->GetData();
+        request->size_ = source->GetSize();
+        switch (type)
+        {
+        case LR_Mesh:
+            request->mesh_ = checked_static_cast<OgreMeshResource*>(resource.get())->BeginImport();
+            if (!request->mesh_)
+                return false;
+            break;
+
+        case LR_Skeleton:
+            request->skeleton_ = checked_static_cast<OgreSkeletonResource*>(resource.get())->BeginImport();
+            if (!request->skeleton_)
+                return false;
+            break;
+
+        case LR_Material:
+            request->material_name_ = OgreMaterialResource::GetNextTempName();
+            break;
+        }
+
+        PendingLoad& load = pending_loads_[id];
+        load.resource_ = resource;
+        load.source_ = source;
+        load.tag_ = framework_->GetThreadTaskManager()->AddRequest<ResourceLoadRequest>(ResourceLoader::GetTaskDescriptionStatic(), request);
+        if (!load.tag_)
+        {
+            // No loader to serve the request; let the resource know it is not going to get its data
+            ResourceLoadResult result;
+            result.id_ = id;
+            result.type_ = type;
+            result.error_ = "Resource loader not running";
+            result.mesh_import_.error_ = result.error_;
+            FinishLoad(result);
+            return false;
+        }
+
+        return true;
+    }
+
+    void ResourceHandler::FinishLoad(ResourceLoadResult& result)
+    {
+        std::map<std::string, PendingLoad>::iterator i = pending_loads_.find(result.id_);
+        if (i == pending_loads_.end())
+            return;
+        // Releases also the source asset, which the worker thread is done with
+        Foundation::ResourcePtr resource = i->second.resource_;
+        pending_loads_.erase(i);
+
+        bool success = false;
+        switch (result.type_)
+        {
+        case LR_Mesh:
+            success = checked_static_cast<OgreMeshResource*>(resource.get())->FinishImport(result.mesh_import_);
+            break;
+
+        case LR_Skeleton:
+            success = checked_static_cast<OgreSkeletonResource*>(resource.get())->FinishImport(result.success_, result.error_);
+            break;
+
+        case LR_Material:
+            success = checked_static_cast<OgreMaterialResource*>(resource.get())->SetPreprocessedData(result.id_, result.material_script_);
+            break;
+        }
+
+        if (success)
+        {
+            resources_[result.id_] = resource;
+            ProcessResourceReferences(resource);
+        }
+    }
+
+    //! Returns roughly what fraction of the screen height a sphere covers. Spheres outside the view get a fraction of that,
+    //! so that the ones just out of view come next
+    static f32 GetScreenRelevance(Ogre::Camera* camera, const Ogre::Vector3& camera_pos, f32 tan_half_fov, const Ogre::Sphere& sphere)
+    {
+        static const f32 outside_view_factor = 0.1f;
+
+        f32 distance = (sphere.getCenter() - camera_pos).length();
+        f32 relevance = 1.0f;
+        if (distance > sphere.getRadius() && tan_half_fov > 0.0f)
+            relevance = std::min(1.0f, sphere.getRadius() / (distance * tan_half_fov));
+        if (!camera->isVisible(sphere))
+            relevance *= outside_view_factor;
+        return relevance;
+    }
+
+    void ResourceHandler::SetResourceRequestLocation(const std::string& id, request_tag_t tag, const Ogre::Vector3& position, f32 radius)
+    {
+        std::map<std::string, RequestTagVector>::const_iterator i = request_tags_.find(id);
+        if (i == request_tags_.end() || std::find(i->second.begin(), i->second.end(), tag) == i->second.end())
+            return;
+
+        RequestLocation& location = request_locations_[tag];
+        location.id_ = id;
+        location.position_ = position;
+        location.radius_ = radius;
+    }
+
+    void ResourceHandler::CancelResourceRequest(const std::string& id, request_tag_t tag)
+    {
+        request_locations_.erase(tag);
+
+        std::map<std::string, RequestTagVector>::iterator i = request_tags_.find(id);
+        if (i == request_tags_.end())
+            return;
+        RequestTagVector& tags = i->second;
+        tags.erase(std::remove(tags.begin(), tags.end(), tag), tags.end());
+        if (!tags.empty())
+            return;
+
+        // Textures are left to finish decoding, but downloads of other resources nobody waits for are dropped
+        std::map<std::string, request_tag_t>::iterator s = source_tags_.find(id);
+        if (s == source_tags_.end())
+            return;
+
+        boost::shared_ptr<Foundation::AssetServiceInterface> asset_service = framework_->GetServiceManager()->
+            GetService<Foundation::AssetServiceInterface>(Service::ST_Asset).lock();
+        if (asset_service)
+            asset_service->CancelAssetRequest(id, s->second);
+        expected_request_tags_.erase(s->second);
+        source_tags_.erase(s);
+        download_priorities_.erase(id);
+        request_tags_.erase(i);
+    }
+
+    void ResourceHandler::UpdateResourcePriorities(f64 frametime)
+    {
+        // Interval of priority updates in seconds, and the smallest priority change worth telling about
+        static const f64 update_interval = 0.25;
+        static const f32 min_priority_change = 0.01f;
+
+        if (decoding_textures_.empty() && request_locations_.empty())
+            return;
+        texture_priority_timer_ += frametime;
+        if (texture_priority_timer_ < update_interval)
+            return;
+        texture_priority_timer_ = 0.0;
+
+        PROFILE(ResourceHandler_UpdateResourcePriorities);
+
+        // Forget textures that have finished or been canceled
+        std::map<std::string, f32>::iterator i = decoding_textures_.begin();
+        while (i != decoding_textures_.end())
+        {
+            if (request_tags_.find(i->first) == request_tags_.end())
+                decoding_textures_.erase(i++);
+            else
+                ++i;
+        }
+
+        // Forget locations of requests that have finished
+        std::map<request_tag_t, RequestLocation>::iterator l = request_locations_.begin();
+        while (l != request_locations_.end())
+        {
+            std::map<std::string, RequestTagVector>::const_iterator t = request_tags_.find(l->second.id_);
+            if (t == request_tags_.end() || std::find(t->second.begin(), t->second.end(), l->first) == t->second.end())
+            {
+                download_priorities_.erase(l->second.id_);
+                request_locations_.erase(l++);
+            }
+            else
+                ++l;
+        }
+
+        Ogre::SceneManager* scene_manager = renderer_->GetSceneManager();
+        Ogre::Camera* camera = renderer_->GetCurrentCamera();
+        if ((decoding_textures_.empty() && request_locations_.empty()) || !scene_manager || !camera)
+            return;
+
+        const Ogre::Vector3 camera_pos = camera->getDerivedPosition();
+        const f32 tan_half_fov = tan(camera->getFOVy().valueRadians() * 0.5f);
+
+        // Screen relevance of each resource is the largest screen fraction of the places it is used at
+        std::map<std::string, f32> relevances;
+        for (l = request_locations_.begin(); l != request_locations_.end(); ++l)
+        {
+            f32 relevance = GetScreenRelevance(camera, camera_pos, tan_half_fov, Ogre::Sphere(l->second.position_, l->second.radius_));
+            f32& best = relevances[l->second.id_];
+            best = std::max(best, relevance);
+        }
+
+        // Textures also by the entities whose materials use them
+        if (!decoding_textures_.empty())
+        {
+            Ogre::SceneManager::MovableObjectIterator iter = scene_manager->getMovableObjectIterator(Ogre::EntityFactory::FACTORY_TYPE_NAME);
+            while (iter.hasMoreElements())
+            {
+                Ogre::Entity* entity = static_cast<Ogre::Entity*>(iter.getNext());
+                if (!entity->isInScene() || !entity->isVisible())
+                    continue;
+
+                f32 relevance = GetScreenRelevance(camera, camera_pos, tan_half_fov, entity->getWorldBoundingSphere());
+                for (uint j = 0; j < entity->getNumSubEntities(); ++j)
+                {
+                    const Ogre::MaterialPtr& material = entity->getSubEntity(j)->getMaterial();
+                    if (material.isNull())
+                        continue;
+                    Ogre::Material::TechniqueIterator tech_iter = material->getTechniqueIterator();
+                    while (tech_iter.hasMoreElements())
+                    {
+                        Ogre::Technique::PassIterator pass_iter = tech_iter.getNext()->getPassIterator();
+                        while (pass_iter.hasMoreElements())
+                        {
+                            Ogre::Pass::TextureUnitStateIterator tu_iter = pass_iter.getNext()->getTextureUnitStateIterator();
+                            while (tu_iter.hasMoreElements())
+                            {
+                                const std::string& texture_name = tu_iter.getNext()->getTextureName();
+                                if (decoding_textures_.find(texture_name) == decoding_textures_.end())
+                                    continue;
+                                f32& best = relevances[texture_name];
+                                best = std::max(best, relevance);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        boost::shared_ptr<Foundation::TextureServiceInterface> texture_service = framework_->GetServiceManager()->
+            GetService<Foundation::TextureServiceInterface>(Service::ST_Texture).lock();
+        if (texture_service)
+        {
+            for (i = decoding_textures_.begin(); i != decoding_textures_.end(); ++i)
+            {
+                std::map<std::string, f32>::const_iterator r = relevances.find(i->first);
+                f32 priority = (r != relevances.end()) ? r->second : 0.0f;
+                if (fabs(priority - i->second) > min_priority_change)
+                {
+                    texture_service->SetTexturePriority(i->first, priority);
+                    i->second = priority;
+                }
+            }
+        }
+
+        // Other resources still downloading
+        boost::shared_ptr<Foundation::AssetServiceInterface> asset_service = framework_->GetServiceManager()->
+            GetService<Foundation::AssetServiceInterface>(Service::ST_Asset).lock();
+        if (asset_service)
+        {
+            for (std::map<std::string, f32>::const_iterator r = relevances.begin(); r != relevances.end(); ++r)
+            {
+                if (source_tags_.find(r->first) == source_tags_.end())
+                    continue;
+                std::map<std::string, f32>::iterator last = download_priorities_.find(r->first);
+                if (last == download_priorities_.end() || fabs(r->second - last->second) > min_priority_change)
+                {
+                    asset_service->SetAssetPriority(r->first, r->second);
+                    download_priorities_[r->first] = r->second;
+                }
+            }
+        }
+    }
+
     request_tag_t ResourceHandler::RequestTexture(const std::string& id)
     {
         request_tag_t tag = framework_->GetEventManager()->GetNextRequestTag();
@@ -287,11 +655,16 @@ namespace OgreRenderer
             // Perform the actual decode request only once, for the first request
             if (request_tags_.find(id) == request_tags_.end())
             {
-                request_tag_t source_tag = texture_service->RequestTexture(id);
+                // Textures that the texture cache has DXT compressed can be uploaded as is, if the graphics card supports them
+                Ogre::RenderSystem* render_system = Ogre::Root::getSingleton().getRenderSystem();
+                bool allow_compressed = (render_system) && (render_system->getCapabilities()) &&
+                    (render_system->getCapabilities()->hasCapability(Ogre::RSC_TEXTURE_COMPRESSION_DXT));
+                request_tag_t source_tag = texture_service->RequestTexture(id, allow_compressed);
                 if (source_tag)
                 {
                     expected_request_tags_.insert(source_tag);
                     request_tags_[id].push_back(tag); 
+                    decoding_textures_[id] = 0.0f;
                     return tag;
                 }
             }
@@ -377,6 +750,7 @@ namespace OgreRenderer
                 {
                     request_tags_[id].push_back(tag);
                     expected_request_tags_.insert(source_tag);
+                    source_tags_[id] = source_tag;
                     return tag;
                 }
             }
@@ -404,6 +778,12 @@ namespace OgreRenderer
         bool success = false;
         OgreMeshResource* mesh_res = checked_static_cast<OgreMeshResource*>(mesh.get());
 
+#ifdef OGRE_MESH_BACKGROUND_IMPORT
+        // Import in the background, unless already have valid data
+        if ((!mesh_res->IsValid()) && (background_loading_))
+            return LoadInBackground(mesh, source, LR_Mesh);
+#endif
+
         // If data successfully set, or already have valid data, success (send RESOURCE_READY_EVENT)
         if ((mesh_res->IsValid()) || (mesh_res->SetData(source)))
         {
@@ -456,6 +836,10 @@ namespace OgreRenderer
         bool success = false;
         OgreMaterialResource* material_res = checked_static_cast<OgreMaterialResource*>(material.get());
 
+        // Preprocess the script in the background, unless already have valid data
+        if ((!material_res->IsValid()) && (background_loading_))
+            return LoadInBackground(material, source, LR_Material);
+
         // If data successfully set, or already have valid data, success; check resource references if any
         StringVector tex_names;
         if ((material_res->IsValid()) || (material_res->SetData(source)))
@@ -510,6 +894,10 @@ namespace OgreRenderer
         bool success = false;
         OgreSkeletonResource* skeleton_res = checked_static_cast<OgreSkeletonResource*>(skeleton.get());
 
+        // Import in the background, unless already have valid data
+        if ((!skeleton_res->IsValid()) && (background_loading_))
+            return LoadInBackground(skeleton, source, LR_Skeleton);
+
         // If data successfully set, or already have valid data, success (send RESOURCE_READY_EVENT)
         if ((skeleton_res->IsValid()) || (skeleton_res->SetData(source)))
         {
@@ -6,13 +6,36 @@
 #include "ResourceInterface.h"
 #include "AssetInterface.h"
 #include "OgreModuleApi.h"
+#include "ResourceLoader.h"
+
+#include <OgreVector3.h>
 
 namespace OgreRenderer
 {
     //! Manages Ogre resources & requests for their data from the asset system. Used internally by Renderer.
+    /*! Meshes, skeletons and material scripts arriving from the asset system are deserialized in the background by
+        ResourceLoader, and finished in the main thread a few at a time per frame.
+     */
     class OGRE_MODULE_API ResourceHandler
     {
     public:
+        //! Load state of a resource
+        enum ResourceLoadState
+        {
+            //! Not requested, or the request failed or was canceled
+            RLS_Unknown = 0,
+            //! Waiting for the asset system or the texture decoder
+            RLS_Requested,
+            //! Being deserialized in a worker thread
+            RLS_Loading,
+            //! Deserialized, waiting to be finished in the main thread
+            RLS_Finishing,
+            //! Loaded, waiting for the resources it refers to
+            RLS_WaitingReferences,
+            //! Ready to use
+            RLS_Ready
+        };
+
         //! Constructor
         explicit ResourceHandler(Renderer* renderer, Foundation::Framework* framework);
         
@@ -39,6 +62,43 @@ namespace OgreRenderer
 
         //! Handles a resource event. Called by OgreRenderingModule
         bool HandleResourceEvent(event_id_t event_id, IEventData* data);
+
+        //! Handles a thread task event, to pick up resources deserialized in the background. Called by OgreRenderingModule
+        bool HandleTaskEvent(event_id_t event_id, IEventData* data);
+
+        //! Creates or updates a resource from asset data, as if the asset had arrived from the asset system
+        /*! \param source Asset
+            \return true if the resource was created, or is being loaded in the background
+         */
+        bool UpdateResource(Foundation::AssetPtr source);
+
+        //! Returns load state of a resource
+        ResourceLoadState GetResourceLoadState(const std::string& id) const;
+
+        //! Sets whether to deserialize meshes, skeletons and material scripts in the background. Loads already started are finished
+        void SetBackgroundLoading(bool enable) { background_loading_ = enable; }
+
+        //! Returns whether meshes, skeletons and material scripts are deserialized in the background
+        bool IsBackgroundLoading() const { return background_loading_; }
+
+        //! Finishes resources deserialized in the background, creating their hardware buffers. Called by Renderer each frame
+        /*! Stops after the time given by the OgreRenderer/resource_finish_time_ms setting, so that a burst of
+            arriving resources is spread over several frames.
+         */
+        void FinishLoadedResources();
+
+        //! Tells where a requested resource will be used, to prioritize its download. Called by Renderer
+        void SetResourceRequestLocation(const std::string& id, request_tag_t tag, const Ogre::Vector3& position, f32 radius);
+
+        //! Withdraws a resource request, canceling the download if nobody else waits for it. Called by Renderer
+        void CancelResourceRequest(const std::string& id, request_tag_t tag);
+
+        //! Tells the texture decoder and the asset system how large on screen the textures being decoded and
+        //! the resources being downloaded are. Called by Renderer
+        /*! Done only a few times per second, as it goes through all the entities in the scene.
+            \param frametime Time since last update
+         */
+        void UpdateResourcePriorities(f64 frametime);
         
         //! Internal method to parse braces from an Ogre script. Returns true if line contained open/close brace
         static bool ProcessBraces(const std::string& line, int& brace_level);
@@ -103,6 +163,17 @@ namespace OgreRenderer
          */
         bool UpdateImageTexture(Foundation::AssetPtr source, request_tag_t tag);
 
+        //! Starts deserializing a resource in the background
+        /*! \param resource Resource to load to
+            \param source Source asset
+            \param type Resource type
+            \return true if loading was started or is already in progress
+         */
+        bool LoadInBackground(Foundation::ResourcePtr resource, Foundation::AssetPtr source, LoadedResourceType type);
+
+        //! Finishes a resource deserialized in the background, and processes its references
+        void FinishLoad(ResourceLoadResult& result);
+
         //! Processes resource references of a resource once it has been loaded.
         /*! Adds references to outstanding list and makes requests as necessary.
             If no outstanding references, sends RESOURCE_READY event
@@ -127,6 +198,29 @@ namespace OgreRenderer
         
         //! Map of resource request tags by resource
         std::map<std::string, RequestTagVector> request_tags_;
+
+        //! Textures being decoded, with the priority last given to the texture decoder
+        std::map<std::string, f32> decoding_textures_;
+
+        //! Where a requested resource will be used
+        struct RequestLocation
+        {
+            std::string id_;
+            Ogre::Vector3 position_;
+            f32 radius_;
+        };
+
+        //! Locations of pending resource requests by request tag
+        std::map<request_tag_t, RequestLocation> request_locations_;
+
+        //! Asset request tags of the resources requested from the asset system, by resource
+        std::map<std::string, request_tag_t> source_tags_;
+
+        //! Priorities last given to the asset system, by resource
+        std::map<std::string, f32> download_priorities_;
+
+        //! Time since texture priorities were last updated
+        f64 texture_priority_timer_;
         
         //! Map of source asset types by renderer resource type
         std::map<std::string, std::string> source_types_;
@@ -136,6 +230,33 @@ namespace OgreRenderer
         
         //! Map of outstanding reference requests per resource
         std::map<std::string, Foundation::ResourceReferenceVector> outstanding_references_;
+
+        //! Resource being deserialized in the background
+        struct PendingLoad
+        {
+            PendingLoad() : tag_(0), loaded_(false) {}
+
+            //! The resource, not valid until finished
+            Foundation::ResourcePtr resource_;
+            //! Source asset, kept alive while the worker thread reads it
+            Foundation::AssetPtr source_;
+            //! Load request tag
+            request_tag_t tag_;
+            //! Whether deserialized and waiting in loaded_resources_
+            bool loaded_;
+        };
+
+        //! Resources being deserialized in the background, by resource
+        std::map<std::string, PendingLoad> pending_loads_;
+
+        //! Resources deserialized in the background and waiting to be finished, in the order they were loaded
+        std::list<ResourceLoadResultPtr> loaded_resources_;
+
+        //! Whether to deserialize resources in the background
+        bool background_loading_;
+
+        //! Time to spend finishing loaded resources per frame, in seconds
+        f64 finish_time_budget_;
         
         //! Framework we belong to
         Foundation::Framework* framework_;
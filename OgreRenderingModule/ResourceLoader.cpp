@@ -0,0 +1,68 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#include "StableHeaders.h"
+#include "ResourceLoader.h"
+#include "OgreSkeletonResource.h"
+#include "OgreRenderingModule.h"
+#include "HighPerfClock.h"
+#include "Profiler.h"
+
+namespace OgreRenderer
+{
+    static const std::string task_description("OgreResourceLoader");
+
+    ResourceLoader::ResourceLoader(uint max_concurrency) :
+        Foundation::ThreadTask(task_description, max_concurrency)
+    {
+    }
+
+    const std::string& ResourceLoader::GetTaskDescriptionStatic()
+    {
+        return task_description;
+    }
+
+    void ResourceLoader::ProcessRequest(Foundation::ThreadTaskRequestPtr request)
+    {
+        ResourceLoadRequestPtr load_request = boost::dynamic_pointer_cast<ResourceLoadRequest>(request);
+        if (!load_request)
+            return;
+
+        PROFILE(ResourceLoader_Load);
+        tick_t start_time = GetCurrentClockTime();
+
+        ResourceLoadResultPtr result(new ResourceLoadResult());
+        result->tag_ = load_request->tag_;
+        result->id_ = load_request->id_;
+        result->type_ = load_request->type_;
+
+        switch (load_request->type_)
+        {
+        case LR_Mesh:
+#ifdef OGRE_MESH_BACKGROUND_IMPORT
+            if (load_request->mesh_)
+            {
+                OgreMeshResource::ImportMesh(load_request->mesh_, load_request->data_, load_request->size_, true, result->mesh_import_);
+                result->success_ = result->mesh_import_.success_;
+                result->error_ = result->mesh_import_.error_;
+            }
+#else
+            result->error_ = "Meshes can not be imported in the background with this Ogre version";
+#endif
+            break;
+
+        case LR_Skeleton:
+            if (load_request->skeleton_)
+                result->success_ = OgreSkeletonResource::ImportSkeleton(load_request->skeleton_, load_request->data_, load_request->size_, result->error_);
+            break;
+
+        case LR_Material:
+            OgreMaterialResource::PreprocessScript(load_request->id_, load_request->data_, load_request->size_, load_request->material_name_,
+                result->material_script_);
+            result->success_ = true;
+            break;
+        }
+
+        result->load_time_ = (f64)(GetCurrentClockTime() - start_time) / GetCurrentClockFreq();
+        QueueResult<ResourceLoadResult>(result);
+    }
+}
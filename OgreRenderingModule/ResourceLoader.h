@@ -0,0 +1,89 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#ifndef incl_OgreRenderer_ResourceLoader_h
+#define incl_OgreRenderer_ResourceLoader_h
+
+#include "ThreadTask.h"
+#include "OgreMeshResource.h"
+#include "OgreMaterialResource.h"
+
+namespace OgreRenderer
+{
+    //! Kinds of renderer resources deserialized by ResourceLoader
+    enum LoadedResourceType
+    {
+        LR_Mesh = 0,
+        LR_Skeleton,
+        LR_Material
+    };
+
+    //! Request to deserialize a renderer resource in a worker thread
+    class ResourceLoadRequest : public Foundation::ThreadTaskRequest
+    {
+    public:
+        ResourceLoadRequest() : type_(LR_Mesh), data_(0), size_(0), mesh_(0), skeleton_(0) {}
+
+        //! Resource id
+        std::string id_;
+        //! Resource type
+        LoadedResourceType type_;
+        //! Source asset data. The requester keeps the asset alive until the result has arrived
+        const u8* data_;
+        //! Size of source asset data
+        uint size_;
+        //! Mesh to import to, from OgreMeshResource::BeginImport()
+        Ogre::Mesh* mesh_;
+        //! Skeleton to import to, from OgreSkeletonResource::BeginImport()
+        Ogre::Skeleton* skeleton_;
+        //! Temporary name to give a material, from OgreMaterialResource::GetNextTempName()
+        std::string material_name_;
+    };
+
+    //! Deserialized renderer resource, to be finished in the main thread
+    class ResourceLoadResult : public Foundation::ThreadTaskResult
+    {
+    public:
+        ResourceLoadResult() : type_(LR_Mesh), success_(false), load_time_(0.0) {}
+
+        //! Resource id
+        std::string id_;
+        //! Resource type
+        LoadedResourceType type_;
+        //! Whether deserializing succeeded. For meshes, see also mesh_import_
+        bool success_;
+        //! Error message if not
+        std::string error_;
+        //! Time spent in the worker thread, in seconds
+        f64 load_time_;
+        //! Imported mesh data
+        OgreMeshResource::MeshImport mesh_import_;
+        //! Preprocessed material script
+        OgreMaterialResource::PreprocessedScript material_script_;
+    };
+
+    typedef boost::shared_ptr<ResourceLoadRequest> ResourceLoadRequestPtr;
+    typedef boost::shared_ptr<ResourceLoadResult> ResourceLoadResultPtr;
+
+    //! Deserializes meshes, skeletons and material scripts in the thread pool, used by ResourceHandler
+    /*! Meshes are imported to system memory buffers, with their tangents and extremes generated, skeletons are imported as is,
+        and material scripts are prepared for Ogre to parse. Creating hardware buffers and parsing the scripts is left to the
+        main thread. Without OGRE_MESH_BACKGROUND_IMPORT, meshes are not loaded here.
+     */
+    class ResourceLoader : public Foundation::ThreadTask
+    {
+    public:
+        //! Constructor
+        /*! \param max_concurrency Maximum amount of resources to load at the same time
+         */
+        explicit ResourceLoader(uint max_concurrency);
+
+        //! Returns task description of the loader
+        static const std::string& GetTaskDescriptionStatic();
+
+    protected:
+        //! Loads a resource. Called from the thread pool.
+        virtual void ProcessRequest(Foundation::ThreadTaskRequestPtr request);
+    };
+}
+
+#endif
@@ -0,0 +1,169 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#include "StableHeaders.h"
+#include "StaticBatchBenchmark.h"
+#include "StaticBatcher.h"
+#include "Renderer.h"
+#include "HighPerfClock.h"
+
+#include <Ogre.h>
+
+#include <sstream>
+#include <iomanip>
+
+namespace OgreRenderer
+{
+    namespace
+    {
+        //! Frames left out at the start of each phase, while the scene settles
+        const uint warmup_frames = 10;
+
+        //! Distance between the entities in the grid
+        const float spacing = 1.5f;
+
+        //! The prefab meshes are 100 units across
+        const float prefab_scale = 0.01f;
+
+        //! Colours of the cloned materials
+        const Ogre::ColourValue colours[] = { Ogre::ColourValue(0.8f, 0.3f, 0.3f), Ogre::ColourValue(0.3f, 0.8f, 0.3f),
+            Ogre::ColourValue(0.3f, 0.3f, 0.8f), Ogre::ColourValue(0.8f, 0.8f, 0.3f) };
+        const uint num_colours = sizeof(colours) / sizeof(colours[0]);
+    }
+
+    StaticBatchBenchmark::StaticBatchBenchmark(Renderer* renderer, uint count, uint frames) :
+        renderer_(renderer),
+        count_(std::max(count, 1u)),
+        frames_(std::max(frames, 1u)),
+        old_enabled_(renderer->GetStaticBatcher()->IsEnabled()),
+        frame_(0),
+        batching_(false),
+        build_time_(0.0),
+        batched_cells_(0),
+        batched_entities_(0)
+    {
+    }
+
+    StaticBatchBenchmark::~StaticBatchBenchmark()
+    {
+        StaticBatcherPtr batcher = renderer_->GetStaticBatcher();
+        Ogre::SceneManager* scene_mgr = renderer_->GetSceneManager();
+        for(uint i = 0; i < entities_.size(); ++i)
+        {
+            batcher->Remove(entities_[i]);
+            nodes_[i]->detachObject(entities_[i]);
+            scene_mgr->destroyEntity(entities_[i]);
+            scene_mgr->destroySceneNode(nodes_[i]);
+        }
+        batcher->SetEnabled(old_enabled_);
+
+        for(uint i = 0; i < materials_.size(); ++i)
+            Ogre::MaterialManager::getSingleton().remove(materials_[i]);
+    }
+
+    void StaticBatchBenchmark::Start()
+    {
+        Ogre::SceneManager* scene_mgr = renderer_->GetSceneManager();
+
+        // Measure without batching first, also for the rest of the scene
+        renderer_->GetStaticBatcher()->SetEnabled(false);
+
+        Ogre::MaterialPtr base = Ogre::MaterialManager::getSingleton().getByName("BaseWhite");
+        for(uint i = 0; i < num_colours; ++i)
+        {
+            Ogre::MaterialPtr material = base->clone(renderer_->GetUniqueObjectName());
+            material->setAmbient(colours[i]);
+            material->setDiffuse(colours[i]);
+            materials_.push_back(material->getName());
+        }
+
+        // A square grid below eye level, starting a bit in front of the camera
+        Ogre::Camera* camera = renderer_->GetCurrentCamera();
+        Ogre::Vector3 forward = camera->getDerivedDirection();
+        forward.z = 0.0f;
+        if (forward.normalise() < 1e-3f)
+            forward = Ogre::Vector3::UNIT_X;
+        Ogre::Vector3 side = Ogre::Vector3::UNIT_Z.crossProduct(forward);
+        uint columns = (uint)ceil(sqrt((f64)count_));
+        Ogre::Vector3 origin = camera->getDerivedPosition() + forward * 5.0f - side * (columns * spacing * 0.5f) -
+            Ogre::Vector3(0.0f, 0.0f, 2.0f);
+
+        for(uint i = 0; i < count_; ++i)
+        {
+            Ogre::Entity* entity = scene_mgr->createEntity(renderer_->GetUniqueObjectName(),
+                (i % 2) ? Ogre::SceneManager::PT_SPHERE : Ogre::SceneManager::PT_CUBE);
+            entity->setMaterialName(materials_[(i / 2) % materials_.size()]);
+
+            Ogre::SceneNode* node = scene_mgr->getRootSceneNode()->createChildSceneNode();
+            node->setPosition(origin + forward * ((i / columns) * spacing) + side * ((i % columns) * spacing));
+            node->setScale(Ogre::Vector3(prefab_scale));
+            node->attachObject(entity);
+
+            entities_.push_back(entity);
+            nodes_.push_back(node);
+        }
+    }
+
+    bool StaticBatchBenchmark::Update(f64 frametime)
+    {
+        if (!batching_)
+        {
+            Record(unbatched_, frametime);
+            if (frame_ >= warmup_frames + frames_)
+                StartBatching();
+            return false;
+        }
+
+        Record(batched_, frametime);
+        return frame_ >= warmup_frames + frames_;
+    }
+
+    void StaticBatchBenchmark::Record(Phase& phase, f64 frametime)
+    {
+        ++frame_;
+        if (frame_ <= warmup_frames)
+            return;
+
+        ++phase.frames_;
+        phase.time_ += frametime;
+        phase.batches_ += renderer_->GetCurrentRenderWindow()->getStatistics().batchCount;
+    }
+
+    void StaticBatchBenchmark::StartBatching()
+    {
+        StaticBatcherPtr batcher = renderer_->GetStaticBatcher();
+        batcher->SetEnabled(true);
+        for(uint i = 0; i < entities_.size(); ++i)
+            batcher->Add(entities_[i]);
+
+        tick_t start_time = GetCurrentClockTime();
+        batcher->Flush();
+        build_time_ = (f64)(GetCurrentClockTime() - start_time) / GetCurrentClockFreq();
+
+        batched_cells_ = batcher->GetNumBatchedCells();
+        batched_entities_ = batcher->GetNumBatchedEntities();
+        batching_ = true;
+        frame_ = 0;
+    }
+
+    std::string StaticBatchBenchmark::GetReport() const
+    {
+        std::stringstream ss;
+        ss << std::fixed << std::setprecision(2);
+        ss << "Static batching of " << entities_.size() << " entities, " << frames_ << " frames each" << std::endl;
+
+        const Phase* phases[] = { &unbatched_, &batched_ };
+        const char* names[] = { "Unbatched", "Batched" };
+        for(uint i = 0; i < 2; ++i)
+        {
+            const Phase& phase = *phases[i];
+            if (!phase.frames_)
+                continue;
+            ss << std::setw(10) << names[i] << ": frame time mean " << phase.time_ * 1000.0 / phase.frames_ << " ms, "
+                << phase.batches_ / phase.frames_ << " batches per frame" << std::endl;
+        }
+
+        ss << "Building " << batched_cells_ << " cells of " << batched_entities_ << " entities took " << build_time_ * 1000.0
+            << " ms" << std::endl;
+        return ss.str();
+    }
+}
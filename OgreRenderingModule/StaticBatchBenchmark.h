@@ -0,0 +1,104 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#ifndef incl_OgreRenderer_StaticBatchBenchmark_h
+#define incl_OgreRenderer_StaticBatchBenchmark_h
+
+namespace Ogre
+{
+    class Entity;
+    class SceneNode;
+}
+
+namespace OgreRenderer
+{
+    class Renderer;
+
+    //! Fills the view with a grid of still entities and compares the frame time and batch count with and without static batching
+    /*! Used by the staticbatchbench console command. The entities are cubes and spheres with a few materials, roughly
+        like a region full of simple prims.
+     */
+    class StaticBatchBenchmark
+    {
+    public:
+        //! Constructor
+        /*! \param renderer Renderer
+            \param count How many entities to create
+            \param frames How many frames to measure with and without batching
+         */
+        StaticBatchBenchmark(Renderer* renderer, uint count, uint frames);
+
+        //! Destructor. Destroys the entities and restores the batching setting
+        ~StaticBatchBenchmark();
+
+        //! Creates the entities in front of the camera
+        void Start();
+
+        //! Records a frame
+        /*! \param frametime Time of the previous frame, in seconds
+            \return true when both phases have been measured
+         */
+        bool Update(f64 frametime);
+
+        //! Returns the frame times and batch counts
+        std::string GetReport() const;
+
+    private:
+        //! Measured values of a phase
+        struct Phase
+        {
+            Phase() : frames_(0), time_(0.0), batches_(0) {}
+
+            uint frames_;
+            f64 time_;
+            u64 batches_;
+        };
+
+        //! Records a frame of a phase, after the warmup frames
+        void Record(Phase& phase, f64 frametime);
+
+        //! Switches batching on and builds all cells
+        void StartBatching();
+
+        //! Renderer
+        Renderer* renderer_;
+
+        //! How many entities to create
+        uint count_;
+
+        //! How many frames to measure per phase
+        uint frames_;
+
+        //! Batching setting before the benchmark
+        bool old_enabled_;
+
+        //! Created entities
+        std::vector<Ogre::Entity*> entities_;
+
+        //! Scene nodes of the entities
+        std::vector<Ogre::SceneNode*> nodes_;
+
+        //! Names of the cloned materials
+        StringVector materials_;
+
+        //! Frames recorded in the current phase, including warmup frames
+        uint frame_;
+
+        //! Whether measuring with batching
+        bool batching_;
+
+        //! Measurements without batching
+        Phase unbatched_;
+
+        //! Measurements with batching
+        Phase batched_;
+
+        //! Time spent building the static geometry of all cells, in seconds
+        f64 build_time_;
+
+        //! Cells and entities drawn as static geometry after building
+        uint batched_cells_;
+        uint batched_entities_;
+    };
+}
+
+#endif
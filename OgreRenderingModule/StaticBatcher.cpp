@@ -0,0 +1,546 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#include "StableHeaders.h"
+#include "StaticBatcher.h"
+#include "OgreRenderingModule.h"
+#include "Profiler.h"
+
+#include <Ogre.h>
+
+#include <algorithm>
+
+namespace OgreRenderer
+{
+    //! How long an entity has to stay still before it is batched, in seconds
+    static const f64 settle_time = 2.0;
+
+    //! How long a changed cell has to stay quiet before it is rebuilt, in seconds
+    static const f64 quiet_time = 1.0;
+
+    //! Fewest visible members worth building static geometry for
+    static const uint min_batch_members = 2;
+
+    //! How many members PollMembers checks per frame
+    static const uint poll_count = 512;
+
+    bool StaticBatcher::CellKey::operator < (const CellKey& rhs) const
+    {
+        if (x_ != rhs.x_)
+            return x_ < rhs.x_;
+        if (y_ != rhs.y_)
+            return y_ < rhs.y_;
+        if (z_ != rhs.z_)
+            return z_ < rhs.z_;
+        if (cast_shadows_ != rhs.cast_shadows_)
+            return rhs.cast_shadows_;
+        return rendering_distance_ < rhs.rendering_distance_;
+    }
+
+    StaticBatcher::StaticBatcher(Ogre::SceneManager* scene_manager, float cell_size) :
+        scene_manager_(scene_manager),
+        cell_size_(std::max(cell_size, 1.0f)),
+        enabled_(false),
+        poll_cursor_(0),
+        geometry_id_(0)
+    {
+    }
+
+    StaticBatcher::~StaticBatcher()
+    {
+        SetEnabled(false);
+    }
+
+    void StaticBatcher::SetEnabled(bool enabled)
+    {
+        if (enabled == enabled_)
+            return;
+        enabled_ = enabled;
+
+        if (!enabled_)
+        {
+            for(CellMap::iterator i = cells_.begin(); i != cells_.end(); ++i)
+                DestroyGeometry(i->second);
+            cells_.clear();
+
+            for(MemberMap::iterator i = members_.begin(); i != members_.end(); ++i)
+            {
+                Member& member = i->second;
+                member.in_cell_ = false;
+                member.still_time_ = 0.0;
+                if (member.node_)
+                    settling_.insert(i->first);
+            }
+        }
+
+        SetListening(enabled_);
+    }
+
+    void StaticBatcher::Add(Ogre::Entity* entity)
+    {
+        if (!entity || members_.find(entity) != members_.end())
+            return;
+        // Static geometry would freeze the animation
+        if (entity->hasSkeleton() || entity->hasVertexAnimation())
+            return;
+        Ogre::SceneNode* node = entity->getParentSceneNode();
+        if (!node)
+            return;
+
+        Member& member = members_[entity];
+        member.node_ = node;
+        member.visibility_flags_ = entity->getVisibilityFlags();
+
+        NodeEntities& node_entities = nodes_[node];
+        node_entities.entities_.push_back(entity);
+        if (enabled_ && node_entities.entities_.size() == 1)
+            SetListening(node, node_entities, true);
+
+        settling_.insert(entity);
+    }
+
+    void StaticBatcher::Remove(Ogre::Entity* entity)
+    {
+        MemberMap::iterator i = members_.find(entity);
+        if (i == members_.end())
+            return;
+
+        Member& member = i->second;
+        Release(entity, member, true);
+        settling_.erase(entity);
+
+        NodeMap::iterator n = nodes_.find(member.node_);
+        if (n != nodes_.end())
+        {
+            std::vector<Ogre::Entity*>& entities = n->second.entities_;
+            entities.erase(std::remove(entities.begin(), entities.end(), entity), entities.end());
+            if (entities.empty())
+            {
+                SetListening(n->first, n->second, false);
+                nodes_.erase(n);
+            }
+        }
+
+        members_.erase(i);
+    }
+
+    void StaticBatcher::Invalidate(Ogre::Entity* entity)
+    {
+        MemberMap::iterator i = members_.find(entity);
+        if (i != members_.end() && i->second.in_cell_)
+            Release(entity, i->second, false);
+    }
+
+    void StaticBatcher::VisibilityChanged(const Ogre::Node* node)
+    {
+        NodeMap::iterator i = nodes_.find(node);
+        if (i != nodes_.end())
+        {
+            std::vector<Ogre::Entity*>& entities = i->second.entities_;
+            for(uint j = 0; j < entities.size(); ++j)
+            {
+                MemberMap::iterator m = members_.find(entities[j]);
+                if (m != members_.end())
+                    CheckVisibility(m->first, m->second);
+            }
+        }
+
+        // Scene node visibility cascades to the child nodes
+        Ogre::Node::ConstChildNodeIterator children = node->getChildIterator();
+        while(children.hasMoreElements())
+            VisibilityChanged(children.getNext());
+    }
+
+    void StaticBatcher::SetDynamic(Ogre::Node* node, bool dynamic)
+    {
+        if (dynamic)
+            dynamic_nodes_.insert(node);
+        else
+            dynamic_nodes_.erase(node);
+    }
+
+    void StaticBatcher::Update(f64 frametime)
+    {
+        if (!enabled_)
+            return;
+
+        PROFILE(StaticBatcher_Update);
+
+        for(std::set<Ogre::Entity*>::iterator i = settling_.begin(); i != settling_.end();)
+        {
+            Member& member = members_[*i];
+            member.still_time_ += frametime;
+            if (member.still_time_ >= settle_time && CanBatch(*i, member))
+            {
+                Settle(*i, member);
+                settling_.erase(i++);
+            }
+            else
+                ++i;
+        }
+
+        PollMembers();
+
+        // Rebuild at most one cell per frame, as building is slow
+        CellMap::iterator build = cells_.end();
+        for(CellMap::iterator i = cells_.begin(); i != cells_.end();)
+        {
+            Cell& cell = i->second;
+            if (cell.members_.empty())
+            {
+                DestroyGeometry(cell);
+                cells_.erase(i++);
+                continue;
+            }
+            if (cell.dirty_)
+            {
+                cell.quiet_time_ += frametime;
+                if (build == cells_.end() && cell.quiet_time_ >= quiet_time)
+                    build = i;
+            }
+            ++i;
+        }
+
+        if (build != cells_.end())
+            Build(build->first, build->second);
+    }
+
+    void StaticBatcher::Flush()
+    {
+        if (!enabled_)
+            return;
+
+        for(std::set<Ogre::Entity*>::iterator i = settling_.begin(); i != settling_.end();)
+        {
+            Member& member = members_[*i];
+            if (CanBatch(*i, member))
+            {
+                Settle(*i, member);
+                settling_.erase(i++);
+            }
+            else
+                ++i;
+        }
+
+        for(CellMap::iterator i = cells_.begin(); i != cells_.end();)
+        {
+            if (i->second.members_.empty())
+            {
+                DestroyGeometry(i->second);
+                cells_.erase(i++);
+                continue;
+            }
+            if (i->second.dirty_)
+                Build(i->first, i->second);
+            ++i;
+        }
+    }
+
+    uint StaticBatcher::GetNumBatchedCells() const
+    {
+        uint count = 0;
+        for(CellMap::const_iterator i = cells_.begin(); i != cells_.end(); ++i)
+            if (i->second.batched_)
+                ++count;
+        return count;
+    }
+
+    uint StaticBatcher::GetNumBatchedEntities() const
+    {
+        uint count = 0;
+        for(MemberMap::const_iterator i = members_.begin(); i != members_.end(); ++i)
+            if (i->second.built_)
+                ++count;
+        return count;
+    }
+
+    void StaticBatcher::nodeUpdated(const Ogre::Node* node)
+    {
+        NodeMap::iterator i = nodes_.find(node);
+        if (i == nodes_.end())
+            return;
+
+        // Nodes get updated also when set to the transform they already have, which is not worth unbatching for
+        NodeEntities& entities = i->second;
+        const Ogre::Vector3& position = node->_getDerivedPosition();
+        const Ogre::Quaternion& orientation = node->_getDerivedOrientation();
+        const Ogre::Vector3& scale = node->_getDerivedScale();
+        if (position == entities.position_ && orientation == entities.orientation_ && scale == entities.scale_)
+            return;
+        entities.position_ = position;
+        entities.orientation_ = orientation;
+        entities.scale_ = scale;
+
+        ReleaseNode(node);
+    }
+
+    void StaticBatcher::nodeDestroyed(const Ogre::Node* node)
+    {
+        NodeMap::iterator i = nodes_.find(node);
+        if (i == nodes_.end())
+            return;
+
+        // The entities stay tracked until removed, but without a node they are never batched
+        std::vector<Ogre::Entity*>& entities = i->second.entities_;
+        for(uint j = 0; j < entities.size(); ++j)
+        {
+            Member& member = members_[entities[j]];
+            Release(entities[j], member, true);
+            member.node_ = 0;
+            settling_.erase(entities[j]);
+        }
+        nodes_.erase(i);
+        dynamic_nodes_.erase(node);
+    }
+
+    void StaticBatcher::nodeDetached(const Ogre::Node* node)
+    {
+        ReleaseNode(node);
+    }
+
+    void StaticBatcher::SetListening(bool listening)
+    {
+        for(NodeMap::iterator i = nodes_.begin(); i != nodes_.end(); ++i)
+            SetListening(i->first, i->second, listening);
+    }
+
+    void StaticBatcher::SetListening(const Ogre::Node* node, NodeEntities& entities, bool listening)
+    {
+        Ogre::Node* listened = const_cast<Ogre::Node*>(node);
+        if (listening)
+        {
+            if (entities.listening_ || node->getListener())
+                return;
+            entities.position_ = listened->_getDerivedPosition();
+            entities.orientation_ = listened->_getDerivedOrientation();
+            entities.scale_ = listened->_getDerivedScale();
+            listened->setListener(this);
+            entities.listening_ = true;
+        }
+        else if (entities.listening_)
+        {
+            if (node->getListener() == this)
+                listened->setListener(0);
+            entities.listening_ = false;
+        }
+    }
+
+    void StaticBatcher::SetDirty(Cell& cell)
+    {
+        cell.dirty_ = true;
+        cell.failed_ = false;
+        cell.quiet_time_ = 0.0;
+    }
+
+    void StaticBatcher::Release(Ogre::Entity* entity, Member& member, bool reset_still_time)
+    {
+        if (member.in_cell_)
+        {
+            CellMap::iterator i = cells_.find(member.cell_);
+            if (i != cells_.end())
+            {
+                Cell& cell = i->second;
+                if (member.built_)
+                    Unbatch(cell);
+                cell.members_.erase(entity);
+                SetDirty(cell);
+            }
+            member.in_cell_ = false;
+        }
+        if (member.built_)
+        {
+            entity->setVisibilityFlags(member.visibility_flags_);
+            member.built_ = false;
+        }
+
+        if (reset_still_time)
+            member.still_time_ = 0.0;
+        if (member.node_)
+            settling_.insert(entity);
+    }
+
+    void StaticBatcher::ReleaseNode(const Ogre::Node* node)
+    {
+        NodeMap::iterator i = nodes_.find(node);
+        if (i == nodes_.end())
+            return;
+
+        std::vector<Ogre::Entity*>& entities = i->second.entities_;
+        for(uint j = 0; j < entities.size(); ++j)
+            Release(entities[j], members_[entities[j]], true);
+    }
+
+    bool StaticBatcher::CanBatch(Ogre::Entity* entity, const Member& member) const
+    {
+        if (!member.node_ || !entity->isInScene() || IsDynamic(member))
+            return false;
+
+        NodeMap::const_iterator i = nodes_.find(member.node_);
+        return i != nodes_.end() && i->second.listening_;
+    }
+
+    bool StaticBatcher::IsDynamic(const Member& member) const
+    {
+        if (dynamic_nodes_.empty())
+            return false;
+
+        for(const Ogre::Node* node = member.node_; node; node = node->getParent())
+            if (dynamic_nodes_.find(node) != dynamic_nodes_.end())
+                return true;
+        return false;
+    }
+
+    void StaticBatcher::Settle(Ogre::Entity* entity, Member& member)
+    {
+        const Ogre::AxisAlignedBox& box = entity->getWorldBoundingBox(true);
+        Ogre::Vector3 centre = box.isFinite() ? box.getCenter() : member.node_->_getDerivedPosition();
+
+        CellKey key;
+        key.x_ = (int)floor(centre.x / cell_size_);
+        key.y_ = (int)floor(centre.y / cell_size_);
+        key.z_ = (int)floor(centre.z / cell_size_);
+        key.cast_shadows_ = entity->getCastShadows();
+        key.rendering_distance_ = entity->getRenderingDistance();
+
+        // The new member is drawn on its own until the cell is rebuilt, so the current geometry can stay
+        Cell& cell = cells_[key];
+        cell.members_.insert(entity);
+        SetDirty(cell);
+
+        member.in_cell_ = true;
+        member.visible_ = entity->getVisible();
+        member.cell_ = key;
+    }
+
+    void StaticBatcher::Unbatch(Cell& cell)
+    {
+        if (!cell.batched_)
+            return;
+
+        if (cell.geometry_)
+            cell.geometry_->setVisible(false);
+
+        for(std::set<Ogre::Entity*>::iterator i = cell.members_.begin(); i != cell.members_.end(); ++i)
+        {
+            Member& member = members_[*i];
+            if (member.built_)
+            {
+                (*i)->setVisibilityFlags(member.visibility_flags_);
+                member.built_ = false;
+            }
+        }
+
+        cell.batched_ = false;
+    }
+
+    void StaticBatcher::Build(const CellKey& key, Cell& cell)
+    {
+        PROFILE(StaticBatcher_Build);
+
+        Unbatch(cell);
+
+        // Bring the derived transforms up to date first, as members that turn out to have moved get released
+        std::vector<Ogre::Entity*> members(cell.members_.begin(), cell.members_.end());
+        for(uint i = 0; i < members.size(); ++i)
+            if (members[i]->getParentSceneNode())
+                members[i]->getParentSceneNode()->_getDerivedPosition();
+        cell.dirty_ = false;
+
+        std::vector<Ogre::Entity*> included;
+        for(std::set<Ogre::Entity*>::iterator i = cell.members_.begin(); i != cell.members_.end(); ++i)
+        {
+            Member& member = members_[*i];
+            member.visible_ = (*i)->isInScene() && (*i)->getVisible() && (*i)->getParentSceneNode();
+            if (member.visible_)
+                included.push_back(*i);
+        }
+
+        if (included.size() < min_batch_members)
+        {
+            DestroyGeometry(cell);
+            return;
+        }
+
+        try
+        {
+            if (!cell.geometry_)
+            {
+                cell.geometry_ = scene_manager_->createStaticGeometry("StaticBatch" + ToString(geometry_id_++));
+                // One region per cell
+                cell.geometry_->setOrigin(Ogre::Vector3((float)key.x_, (float)key.y_, (float)key.z_) * cell_size_);
+                cell.geometry_->setRegionDimensions(Ogre::Vector3(cell_size_));
+            }
+            else
+                cell.geometry_->reset();
+
+            cell.geometry_->setCastShadows(key.cast_shadows_);
+            cell.geometry_->setRenderingDistance(key.rendering_distance_);
+            for(uint i = 0; i < included.size(); ++i)
+            {
+                Ogre::SceneNode* node = included[i]->getParentSceneNode();
+                cell.geometry_->addEntity(included[i], node->_getDerivedPosition(), node->_getDerivedOrientation(),
+                    node->_getDerivedScale());
+            }
+            cell.geometry_->build();
+        }
+        catch (Ogre::Exception& e)
+        {
+            OgreRenderingModule::LogWarning("Could not build static geometry of " + ToString(included.size()) + " entities: " +
+                std::string(e.what()));
+            DestroyGeometry(cell);
+            cell.failed_ = true;
+            return;
+        }
+
+        cell.geometry_->setVisible(true);
+        for(uint i = 0; i < included.size(); ++i)
+        {
+            Member& member = members_[included[i]];
+            member.visibility_flags_ = included[i]->getVisibilityFlags();
+            member.built_ = true;
+            included[i]->setVisibilityFlags(0);
+        }
+        cell.batched_ = true;
+    }
+
+    void StaticBatcher::DestroyGeometry(Cell& cell)
+    {
+        Unbatch(cell);
+        if (cell.geometry_)
+        {
+            scene_manager_->destroyStaticGeometry(cell.geometry_);
+            cell.geometry_ = 0;
+        }
+    }
+
+    void StaticBatcher::PollMembers()
+    {
+        if (members_.empty())
+            return;
+
+        MemberMap::iterator i = members_.upper_bound(poll_cursor_);
+        uint count = std::min<uint>(poll_count, members_.size());
+        for(uint n = 0; n < count; ++n, ++i)
+        {
+            if (i == members_.end())
+                i = members_.begin();
+            poll_cursor_ = i->first;
+            CheckVisibility(i->first, i->second);
+        }
+    }
+
+    void StaticBatcher::CheckVisibility(Ogre::Entity* entity, Member& member)
+    {
+        if (!member.in_cell_)
+            return;
+        bool visible = entity->isInScene() && entity->getVisible();
+        if (visible == member.visible_)
+            return;
+        member.visible_ = visible;
+
+        // A hidden member has to be taken out of the geometry at once, a shown one can wait for the rebuild
+        Cell& cell = cells_[member.cell_];
+        if (member.built_)
+            Unbatch(cell);
+        SetDirty(cell);
+    }
+}
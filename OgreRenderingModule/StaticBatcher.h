@@ -0,0 +1,239 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#ifndef incl_OgreRenderer_StaticBatcher_h
+#define incl_OgreRenderer_StaticBatcher_h
+
+#include <OgreNode.h>
+
+#include <map>
+#include <set>
+
+namespace Ogre
+{
+    class Entity;
+    class SceneManager;
+    class StaticGeometry;
+}
+
+namespace OgreRenderer
+{
+    //! Merges entities that have stayed still into static geometry, one batch per spatial cell
+    /*! Mesh components register their entities here. An entity that has not moved for a while, and whose scene node
+        is not marked dynamic, is put to the cell its bounding box centre falls in. Cells are built into Ogre static
+        geometry, which draws each material of a cell in one batch, and the member entities are hidden meanwhile with
+        their visibility flags. Animated entities are never batched.
+
+        When a member moves, is detached, hidden or otherwise changed, its cell is unbatched at once by showing the
+        members again, and rebuilt without the changed member after the cell has been quiet for a while. Building
+        static geometry has to happen in the main thread, so at most one cell is built per frame.
+
+        Disabled by default; see the static_batching setting.
+     */
+    class StaticBatcher : public Ogre::Node::Listener
+    {
+    public:
+        //! Constructor
+        /*! \param scene_manager Scene manager of the entities
+            \param cell_size Edge length of the cells, in world units
+         */
+        StaticBatcher(Ogre::SceneManager* scene_manager, float cell_size);
+
+        //! Destructor. Shows all members and destroys the static geometry
+        virtual ~StaticBatcher();
+
+        //! Enables or disables batching. Disabling shows all members and destroys the static geometry
+        void SetEnabled(bool enabled);
+
+        //! Returns whether batching is enabled
+        bool IsEnabled() const { return enabled_; }
+
+        //! Starts tracking an entity. Call after attaching the entity to its scene node
+        void Add(Ogre::Entity* entity);
+
+        //! Stops tracking an entity. Call before detaching or destroying the entity
+        void Remove(Ogre::Entity* entity);
+
+        //! Tells that the materials, shadow casting or rendering distance of an entity have changed
+        void Invalidate(Ogre::Entity* entity);
+
+        //! Tells that a scene node has been shown or hidden. Unbatches the cells of its hidden entities and those of its child nodes
+        void VisibilityChanged(const Ogre::Node* node);
+
+        //! Marks a scene node as moving. Entities under a dynamic node are not batched
+        void SetDynamic(Ogre::Node* node, bool dynamic);
+
+        //! Settles still entities to their cells and rebuilds a changed cell. Called by Renderer
+        /*! \param frametime Time since the previous update, in seconds
+         */
+        void Update(f64 frametime);
+
+        //! Settles all entities that are not dynamic and rebuilds all changed cells at once
+        void Flush();
+
+        //! Returns the number of cells that are drawn as static geometry
+        uint GetNumBatchedCells() const;
+
+        //! Returns the number of entities drawn as part of static geometry
+        uint GetNumBatchedEntities() const;
+
+        //! Returns the number of tracked entities
+        uint GetNumEntities() const { return members_.size(); }
+
+        //! Node listener callback. Unbatches the entities of a node that has moved
+        virtual void nodeUpdated(const Ogre::Node* node);
+
+        //! Node listener callback. Unbatches the entities of a node that is being destroyed
+        virtual void nodeDestroyed(const Ogre::Node* node);
+
+        //! Node listener callback. Unbatches the entities of a node that has been detached from its parent
+        virtual void nodeDetached(const Ogre::Node* node);
+
+    private:
+        //! Identifies a cell. Entities that differ in shadow casting or rendering distance go to different cells
+        struct CellKey
+        {
+            CellKey() : x_(0), y_(0), z_(0), cast_shadows_(false), rendering_distance_(0.0f) {}
+
+            bool operator < (const CellKey& rhs) const;
+
+            int x_;
+            int y_;
+            int z_;
+            bool cast_shadows_;
+            float rendering_distance_;
+        };
+
+        //! A tracked entity
+        struct Member
+        {
+            Member() : node_(0), visibility_flags_(0), still_time_(0.0), in_cell_(false), built_(false), visible_(false) {}
+
+            //! Scene node the entity is attached to, listened for movement
+            Ogre::SceneNode* node_;
+            //! Visibility flags of the entity before it was hidden
+            Ogre::uint32 visibility_flags_;
+            //! Time the entity has stayed still, while it is not in a cell
+            f64 still_time_;
+            //! Whether the entity belongs to a cell
+            bool in_cell_;
+            //! Whether the entity is included in the static geometry of its cell, and hidden
+            bool built_;
+            //! Whether the entity was visible when its cell was last built or polled
+            bool visible_;
+            //! The cell the entity belongs to
+            CellKey cell_;
+        };
+
+        //! A spatial cell of still entities
+        struct Cell
+        {
+            Cell() : geometry_(0), dirty_(true), batched_(false), failed_(false), quiet_time_(0.0) {}
+
+            //! Static geometry of the members, null if not built yet
+            Ogre::StaticGeometry* geometry_;
+            //! Member entities
+            std::set<Ogre::Entity*> members_;
+            //! Whether the members have changed since the geometry was built
+            bool dirty_;
+            //! Whether the static geometry is shown and the built members hidden
+            bool batched_;
+            //! Whether building failed. Not retried until the members change
+            bool failed_;
+            //! Time since the members last changed
+            f64 quiet_time_;
+        };
+
+        //! Entities attached to a node
+        struct NodeEntities
+        {
+            NodeEntities() : listening_(false) {}
+
+            std::vector<Ogre::Entity*> entities_;
+            //! Derived transform of the node when last updated, to tell actual movement from mere updates
+            Ogre::Vector3 position_;
+            Ogre::Quaternion orientation_;
+            Ogre::Vector3 scale_;
+            //! Whether this is the listener of the node. If the node already had another listener, its entities are not batched
+            bool listening_;
+        };
+
+        typedef std::map<Ogre::Entity*, Member> MemberMap;
+        typedef std::map<CellKey, Cell> CellMap;
+        typedef std::map<const Ogre::Node*, NodeEntities> NodeMap;
+
+        //! Starts or stops listening to all nodes
+        void SetListening(bool listening);
+
+        //! Starts or stops listening to a node
+        void SetListening(const Ogre::Node* node, NodeEntities& entities, bool listening);
+
+        //! Marks a cell changed, so that it is rebuilt after it has stayed quiet
+        void SetDirty(Cell& cell);
+
+        //! Takes an entity out of its cell and puts it back to wait for being still
+        /*! \param reset_still_time If true, the entity has to stay still again for the full time before it is batched
+         */
+        void Release(Ogre::Entity* entity, Member& member, bool reset_still_time);
+
+        //! Releases all entities of a node
+        void ReleaseNode(const Ogre::Node* node);
+
+        //! Returns whether an entity can be batched now
+        bool CanBatch(Ogre::Entity* entity, const Member& member) const;
+
+        //! Returns whether an entity or one of its ancestor nodes is marked dynamic
+        bool IsDynamic(const Member& member) const;
+
+        //! Puts a still entity to its cell
+        void Settle(Ogre::Entity* entity, Member& member);
+
+        //! Shows the members of a cell and hides its static geometry, until the cell is rebuilt
+        void Unbatch(Cell& cell);
+
+        //! Builds the static geometry of a cell and hides the members included in it
+        void Build(const CellKey& key, Cell& cell);
+
+        //! Destroys the static geometry of a cell
+        void DestroyGeometry(Cell& cell);
+
+        //! Checks a few built members per frame for having been hidden or removed from the scene in other ways
+        /*! A fallback for the changes not told through VisibilityChanged(), for example by setting Ogre visibility directly.
+         */
+        void PollMembers();
+
+        //! Unbatches the cell of a built member that has been hidden, and marks the cell of a shown member changed
+        void CheckVisibility(Ogre::Entity* entity, Member& member);
+
+        //! Scene manager
+        Ogre::SceneManager* scene_manager_;
+
+        //! Edge length of the cells
+        float cell_size_;
+
+        //! Whether batching is enabled
+        bool enabled_;
+
+        //! Tracked entities
+        MemberMap members_;
+
+        //! Tracked entities by their scene node
+        NodeMap nodes_;
+
+        //! Nodes marked dynamic
+        std::set<const Ogre::Node*> dynamic_nodes_;
+
+        //! Entities waiting to stay still long enough
+        std::set<Ogre::Entity*> settling_;
+
+        //! Cells
+        CellMap cells_;
+
+        //! Last entity checked by PollMembers
+        Ogre::Entity* poll_cursor_;
+
+        //! Counter for unique static geometry names
+        uint geometry_id_;
+    };
+}
+
+#endif
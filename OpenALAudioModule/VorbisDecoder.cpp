@@ -10,6 +10,8 @@
 namespace OpenALAudio
 {
     static const int MAX_DECODE_SIZE = 16384;
+    //! Maximum amount of sounds to decode at the same time. Sounds are short, so leave most of the thread pool to other work
+    static const uint MAX_CONCURRENT_DECODES = 2;
     
     class OggMemDataSource
     {
@@ -87,26 +89,17 @@ namespace OpenALAudio
     }
 
     VorbisDecoder::VorbisDecoder() :
-        Foundation::ThreadTask("VorbisDecoder")
+        Foundation::ThreadTask("VorbisDecoder", MAX_CONCURRENT_DECODES)
     {
     }
     
-    void VorbisDecoder::Work()
+    void VorbisDecoder::ProcessRequest(Foundation::ThreadTaskRequestPtr request)
     {
-        while (ShouldRun())
+        VorbisDecodeRequestPtr decode_request = boost::dynamic_pointer_cast<VorbisDecodeRequest>(request);
+        if (decode_request)
         {
-            WaitForRequests();
-            
-            VorbisDecodeRequestPtr request = GetNextRequest<VorbisDecodeRequest>();
-            if (request)
-            {
-                {
-                    PROFILE(VorbisDecoder_Decode);
-                    PerformDecode(request);
-                }
-            }
-
-            RESETPROFILER
+            PROFILE(VorbisDecoder_Decode);
+            PerformDecode(decode_request);
         }
     }
     
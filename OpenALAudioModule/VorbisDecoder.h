@@ -31,23 +31,22 @@ namespace OpenALAudio
     typedef boost::shared_ptr<VorbisDecodeRequest> VorbisDecodeRequestPtr;
     typedef boost::shared_ptr<VorbisDecodeResult> VorbisDecodeResultPtr;
 
-    //! Ogg Vorbis decoder that runs in a thread and serves decode requests, used by SoundSystem
+    //! Ogg Vorbis decoder that serves decode requests in the thread pool, used by SoundSystem
     class VorbisDecoder : public Foundation::ThreadTask
     {
     public:
         //! Constructor
         VorbisDecoder();
         
-        //! Work function
-        virtual void Work();
-        
+    protected:
+        //! Decodes a sound. Called from the thread pool.
+        virtual void ProcessRequest(Foundation::ThreadTaskRequestPtr request);
+
     private:
         //! perform a decode & queue result
         /*! \param request decode request to serve
          */
         void PerformDecode(VorbisDecodeRequestPtr request);
-        
-        uint decodes_per_frame_;
     };
 }
 #endif
\ No newline at end of file
@@ -10,6 +10,7 @@
 #include "EventManager.h"
 #include "Profiler.h"
 #include "ModuleManager.h"
+#include "ConfigurationManager.h"
 #include "RealXtend/RexProtocolMsgIDs.h"
 #include "HttpRequest.h"
 #include "CoreException.h"
@@ -73,6 +74,12 @@ namespace OpenSimProtocol
         networkManager_ = boost::shared_ptr<ProtocolUtilities::NetMessageManager>(new ProtocolUtilities::NetMessageManager(filename));
         assert(networkManager_);
         networkManager_->RegisterNetworkListener(this);
+        networkManager_->SetThreadedMode(framework_->GetDefaultConfig().DeclareSetting("NetMessageManager", "threaded", false));
+        networkManager_->SetBatchedIO(framework_->GetDefaultConfig().DeclareSetting("NetMessageManager", "io_batch_size", 0));
+
+        const std::string captureFile = framework_->GetDefaultConfig().DeclareSetting("NetMessageManager", "capture_file", std::string());
+        if (!captureFile.empty())
+            networkManager_->StartCapture(captureFile);
 
         // Send event that other modules can query above categories
         boost::shared_ptr<ProtocolUtilities::ProtocolModuleInterface> thisModule = framework_->GetModuleManager()->GetModule<ProtocolModuleOpenSim>().lock();
@@ -215,6 +222,27 @@ namespace OpenSimProtocol
         }
     }
 
+    bool ProtocolModuleOpenSim::CreateReplayConnection(const std::string &filename, bool realTimePacing)
+    {
+        if (connected_)
+            DisconnectFromServer();
+        if (!networkManager_)
+            RegisterNetworkEvents();
+
+        if (!networkManager_->ConnectToReplay(filename, realTimePacing))
+        {
+            LogError("Network Manager could not start replaying " + filename);
+            return false;
+        }
+
+        loginWorker_.SetConnectionState(ProtocolUtilities::Connection::STATE_CONNECTED);
+        connected_ = true;
+
+        ProtocolUtilities::AuthenticationEventData auth_data(ProtocolUtilities::AT_OpenSim);
+        eventManager_->SendEvent(networkStateEventCategory_, ProtocolUtilities::Events::EVENT_SERVER_CONNECTED, &auth_data);
+        return true;
+    }
+
     void ProtocolModuleOpenSim::DisconnectFromServer()
     {
         if (!connected_)
@@ -74,6 +74,10 @@ namespace OpenSimProtocol
         /// ProtocolModuleInterface override
         virtual bool CreateUdpConnection(const char *address, int port);
 
+        /// Connects to a replay of a packet capture instead of a server, and signals a server connection as usual.
+        /// See NetMessageManager::ConnectToReplay().
+        bool CreateReplayConnection(const std::string &filename, bool realTimePacing);
+
         /// ProtocolModuleInterface override
         virtual ProtocolUtilities::Connection::State GetConnectionState() const { return loginWorker_.GetState(); }
 
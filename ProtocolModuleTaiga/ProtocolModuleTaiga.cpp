@@ -9,6 +9,7 @@
 #include "Framework.h"
 #include "EventManager.h"
 #include "ModuleManager.h"
+#include "ConfigurationManager.h"
 #include "CoreException.h"
 #include "NetworkMessages/NetOutMessage.h"
 
@@ -69,6 +70,8 @@ namespace TaigaProtocol
         networkManager_ = boost::shared_ptr<ProtocolUtilities::NetMessageManager>(new ProtocolUtilities::NetMessageManager(filename));
         assert(networkManager_);
         networkManager_->RegisterNetworkListener(this);
+        networkManager_->SetThreadedMode(framework_->GetDefaultConfig().DeclareSetting("NetMessageManager", "threaded", false));
+        networkManager_->SetBatchedIO(framework_->GetDefaultConfig().DeclareSetting("NetMessageManager", "io_batch_size", 0));
 
         // Send event that other modules can query above categories
         boost::shared_ptr<ProtocolUtilities::ProtocolModuleInterface> thisModule = framework_->GetModuleManager()->GetModule<ProtocolModuleTaiga>().lock();
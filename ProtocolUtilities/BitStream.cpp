@@ -22,23 +22,44 @@ namespace ProtocolUtilities
 
     u32 BitStream::ReadBits(int count)
     {
-        u8 data[4] = { 0 };
-        int cur_byte = 0;
-        int cur_bit = 0;
         assert(num_bits_in_elem_ == 8);
-        int total_bits = std::min(num_bits_in_elem_, count);
-        while(count-- > 0)
+        assert(count >= 0 && count <= 32);
+        if (count <= 0)
+            return 0;
+
+        // Take the next 64 bits of the stream to a word, the first bit the most significant. Past the end, the bits are 0.
+        const size_t first = elem_ofs_;
+        u64 window = 0;
+        if (first + 8 <= num_elems_)
+        {
+            for(size_t i = 0; i < 8; ++i)
+                window = (window << 8) | data_[first + i];
+        }
+        else
+        {
+            for(size_t i = 0; i < 8; ++i)
+                window = (window << 8) | (first + i < num_elems_ ? data_[first + i] : 0);
+        }
+
+        // count + bit_ofs_ <= 39, so the bits are all in the window.
+        const u32 bits = (u32)((window << bit_ofs_) >> (64 - count));
+
+        const size_t pos = std::min(BitPos() + count, Size());
+        elem_ofs_ = pos / num_bits_in_elem_;
+        bit_ofs_ = pos % num_bits_in_elem_;
+
+        if (count <= num_bits_in_elem_)
+            return bits;
+
+        // Each full byte of bits, and the remaining bits last, go to the next byte of the result, starting from the least significant.
+        u32 result = 0;
+        int shift = 0;
+        for(int remaining = count; remaining > 0; remaining -= num_bits_in_elem_, shift += num_bits_in_elem_)
         {
-            if (ReadBit()) ///\note Can optimize here - read several bits at a time instead of looping bit-per-bit.
-                data[cur_byte] |= 1 << (total_bits - 1 - cur_bit);
-            if (++cur_bit >= num_bits_in_elem_)
-            {
-                ++cur_byte;
-                cur_bit = 0;
-                total_bits = std::min(num_bits_in_elem_, count);
-            }
+            const int n = std::min(remaining, num_bits_in_elem_);
+            result |= ((bits >> (remaining - n)) & ((1u << n) - 1)) << shift;
         }
-        return *reinterpret_cast<u32*>(data);
+        return result;
     }
 
     bool BitStream::ReadBit()
@@ -11,7 +11,7 @@ namespace ProtocolUtilities
     class BitStream
     {
     private:
-        /// The memory is now accessed per-byte, but for optimization, one could use u32 reads.
+        /// The stream is addressed per-byte. ReadBits() reads the bytes to a 64-bit word to extract the bits at once.
         static const int num_bits_in_elem_;
 
     public:
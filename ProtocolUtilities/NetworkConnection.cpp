@@ -2,25 +2,77 @@
 #include "StableHeaders.h"
 
 #include <utility>
+#include <cstring>
+#include <cerrno>
 
 #include "NetworkConnection.h"
 
+#include <Poco/Net/NetException.h>
+
 using namespace std;
 
 namespace ProtocolUtilities
 {
 
-NetworkConnection::NetworkConnection(const char *address, int port): bOpen(true)
+/// The maximum size of a datagram that can be queued for batched sending.
+static const size_t cMaxDatagramSize = 2048;
+
+NetworkConnection::NetworkConnection(const char *address, int port):
+    bOpen(true),
+    numSyscalls(0),
+    batchSize(0),
+    numQueued(0)
 {
     socket.connect(Poco::Net::SocketAddress(address, port));
-    
+    SetupSocket();
+}
+
+NetworkConnection::NetworkConnection(int localPort):
+    bOpen(true),
+    numSyscalls(0),
+    batchSize(0),
+    numQueued(0)
+{
+    socket.bind(Poco::Net::SocketAddress("127.0.0.1", localPort));
+    SetupSocket();
+}
+
+NetworkConnection::NetworkConnection():
+    bOpen(true),
+    numSyscalls(0),
+    batchSize(0),
+    numQueued(0)
+{
+}
+
+NetworkConnection::~NetworkConnection()
+{
+}
+
+void NetworkConnection::SetupSocket()
+{
     const size_t cBufferSize = 100000;
     socket.setReceiveBufferSize(cBufferSize);
     socket.setSendBufferSize(cBufferSize);
 }
 
-NetworkConnection::~NetworkConnection()
+void NetworkConnection::SetBatchSize(size_t maxBatchSize)
+{
+    FlushSendQueue();
+
+    batchSize = maxBatchSize;
+    sendQueueData.resize(batchSize * cMaxDatagramSize);
+    sendQueueSizes.resize(batchSize);
+
+#ifdef NETWORKCONNECTION_NATIVE_BATCHING
+    msgHeaders.resize(batchSize);
+    ioVectors.resize(batchSize);
+#endif
+}
+
+int NetworkConnection::LocalPort() const
 {
+    return socket.address().port();
 }
 
 bool NetworkConnection::PacketsAvailable() const
@@ -28,27 +80,149 @@ bool NetworkConnection::PacketsAvailable() const
     if (!bOpen)
         return false;
     
+    ++numSyscalls;
     return socket.available() != 0;
 }
 
+bool NetworkConnection::WaitForPackets(int timeoutMsecs) const
+{
+    if (!bOpen)
+        return false;
+
+    ++numSyscalls;
+    return socket.poll(Poco::Timespan(timeoutMsecs * 1000), Poco::Net::Socket::SELECT_READ);
+}
+
 int NetworkConnection::ReceiveBytes(uint8_t *bytes, size_t maxCount)
 {
+    ++numSyscalls;
     int numBytes = min((int)maxCount, socket.available());
     if (numBytes == 0)
         return numBytes;
 
+    ++numSyscalls;
     return socket.receiveBytes(bytes, numBytes);
 }
 
+size_t NetworkConnection::ReceiveBatch(uint8_t **buffers, size_t bufferSize, size_t *sizes, size_t maxCount)
+{
+    if (!bOpen || maxCount == 0)
+        return 0;
+
+#ifdef NETWORKCONNECTION_NATIVE_BATCHING
+    if (batchSize > 0)
+    {
+        size_t numReceived = 0;
+        while(numReceived < maxCount)
+        {
+            const size_t count = min(maxCount - numReceived, batchSize);
+            for(size_t i = 0; i < count; ++i)
+            {
+                ioVectors[i].iov_base = buffers[numReceived + i];
+                ioVectors[i].iov_len = bufferSize;
+                memset(&msgHeaders[i], 0, sizeof(mmsghdr));
+                msgHeaders[i].msg_hdr.msg_iov = &ioVectors[i];
+                msgHeaders[i].msg_hdr.msg_iovlen = 1;
+            }
+
+            ++numSyscalls;
+            int ret = recvmmsg(socket.NativeHandle(), &msgHeaders[0], count, MSG_DONTWAIT, 0);
+            if (ret < 0)
+            {
+                if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                    break;
+                throw Poco::Net::NetException(strerror(errno));
+            }
+
+            for(int i = 0; i < ret; ++i)
+                sizes[numReceived + i] = msgHeaders[i].msg_len;
+            numReceived += ret;
+
+            // The socket was drained.
+            if ((size_t)ret < count)
+                break;
+        }
+        return numReceived;
+    }
+#endif
+
+    size_t numReceived = 0;
+    while(numReceived < maxCount && PacketsAvailable())
+    {
+        int numBytes = ReceiveBytes(buffers[numReceived], bufferSize);
+        if (numBytes <= 0)
+            break;
+        sizes[numReceived++] = numBytes;
+    }
+    return numReceived;
+}
+
 void NetworkConnection::SendBytes(const uint8_t *bytes, size_t count)
 {
+    ++numSyscalls;
     socket.sendBytes(bytes, (int)count);
 }
 
+void NetworkConnection::QueueBytes(const uint8_t *bytes, size_t count)
+{
+    if (batchSize == 0 || count > cMaxDatagramSize)
+    {
+        // Keep the ordering of the datagrams even if this one can't be queued.
+        FlushSendQueue();
+        SendBytes(bytes, count);
+        return;
+    }
+
+    if (numQueued >= batchSize)
+        FlushSendQueue();
+
+    memcpy(&sendQueueData[numQueued * cMaxDatagramSize], bytes, count);
+    sendQueueSizes[numQueued] = count;
+    ++numQueued;
+}
+
+void NetworkConnection::FlushSendQueue()
+{
+    if (numQueued == 0)
+        return;
+
+    // Clear the queue up front, so that an exception from the socket doesn't leave stale datagrams behind.
+    const size_t count = numQueued;
+    numQueued = 0;
+
+#ifdef NETWORKCONNECTION_NATIVE_BATCHING
+    for(size_t i = 0; i < count; ++i)
+    {
+        ioVectors[i].iov_base = &sendQueueData[i * cMaxDatagramSize];
+        ioVectors[i].iov_len = sendQueueSizes[i];
+        memset(&msgHeaders[i], 0, sizeof(mmsghdr));
+        msgHeaders[i].msg_hdr.msg_iov = &ioVectors[i];
+        msgHeaders[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    size_t numSent = 0;
+    while(numSent < count)
+    {
+        ++numSyscalls;
+        int ret = sendmmsg(socket.NativeHandle(), &msgHeaders[numSent], count - numSent, 0);
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            throw Poco::Net::NetException(strerror(errno));
+        }
+        numSent += ret;
+    }
+#else
+    for(size_t i = 0; i < count; ++i)
+        SendBytes(&sendQueueData[i * cMaxDatagramSize], sendQueueSizes[i]);
+#endif
+}
+
 void NetworkConnection::Close()
 {
     socket.close();
     bOpen = false;
 }
 
-}
\ No newline at end of file
+}
@@ -5,39 +5,128 @@
 #include "Poco/Net/DatagramSocket.h"
 #include "RexTypes.h"
 
+#include <vector>
+
+#if defined(__linux__)
+/// recvmmsg() and sendmmsg() are available, so batched socket I/O can use one system call per batch.
+#define NETWORKCONNECTION_NATIVE_BATCHING
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+
 namespace ProtocolUtilities
 {
+    /// Exposes the native handle of a PoCo UDP socket, needed for the batched system calls.
+    class NativeDatagramSocket : public Poco::Net::DatagramSocket
+    {
+    public:
+        poco_socket_t NativeHandle() const { return impl()->sockfd(); }
+    };
+
     /// NetworkConnection represents the socket of a bidirectional UDP connection.
+    /// The I/O functions are virtual so that a connection can be stood in for, see ReplayNetworkConnection.
     class NetworkConnection
     {
     public:
         /// Connects to the given address.
         NetworkConnection(const char *address, int port);
-        ~NetworkConnection();
 
-        /// @return True if there are available UDP packets in the stream and the socket is open. 
-        bool PacketsAvailable() const;
+        /// Binds to the given local port on the loopback interface without connecting. Used for loopback testing.
+        /// @param localPort The port to bind to, or 0 to let the system pick one. See LocalPort().
+        explicit NetworkConnection(int localPort);
+
+        virtual ~NetworkConnection();
+
+        /// @return True if there are available UDP packets in the stream and the socket is open.
+        virtual bool PacketsAvailable() const;
+
+        /// Blocks until there are UDP packets available in the stream or the timeout expires.
+        /// @param timeoutMsecs The maximum time to wait, in milliseconds.
+        /// @return True if there are packets available to read.
+        virtual bool WaitForPackets(int timeoutMsecs) const;
 
         /// Reads bytes from the socket. Doesn't block, but returns 0 if no bytes available.
         /// @param maxCount The maximum number of bytes to fill into the buffer.
         /// @return The number of bytes that was actually filled into the buffer.
-        int ReceiveBytes(uint8_t *bytes, size_t maxCount);
+        virtual int ReceiveBytes(uint8_t *bytes, size_t maxCount);
+
+        /// Reads several datagrams from the socket. Doesn't block. With batching enabled on Linux, uses a single
+        /// recvmmsg() call, otherwise reads one datagram at a time.
+        /// @param buffers The buffers to receive the datagrams to, one datagram per buffer.
+        /// @param bufferSize The size of each buffer, in bytes.
+        /// @param sizes [out] The number of bytes received to each buffer.
+        /// @param maxCount The number of buffers.
+        /// @return The number of datagrams received.
+        virtual size_t ReceiveBatch(uint8_t **buffers, size_t bufferSize, size_t *sizes, size_t maxCount);
 
         /// Pushes out a packet with the given contents.
-        void SendBytes(const uint8_t *bytes, size_t count);
+        virtual void SendBytes(const uint8_t *bytes, size_t count);
+
+        /// Queues a packet to be sent on the next FlushSendQueue(). The data is copied, so the caller may reuse the buffer.
+        /// Flushes automatically if the queue is full. Sends immediately if batching is disabled.
+        virtual void QueueBytes(const uint8_t *bytes, size_t count);
+
+        /// Sends all the packets queued with QueueBytes(). With batching enabled on Linux, uses a single sendmmsg() call.
+        virtual void FlushSendQueue();
+
+        /// Enables batched sending and receiving.
+        /// @param maxBatchSize The maximum number of datagrams to send in one batch, or 0 to disable batching.
+        void SetBatchSize(size_t maxBatchSize);
+
+        /// @return The maximum number of datagrams sent in one batch, or 0 if batching is disabled.
+        size_t BatchSize() const { return batchSize; }
+
+        /// @return The number of socket system calls made so far.
+        size_t NumSyscalls() const { return numSyscalls; }
+
+        /// @return The local port the socket is bound to.
+        virtual int LocalPort() const;
 
         /// Closes the socket.
-        void Close();
+        virtual void Close();
 
         /// @return True if the socket is open.
         bool Open() const { return bOpen; }
 
-    private:
-        /// PoCo UDP socket.
-        Poco::Net::DatagramSocket socket;
+    protected:
+        /// Creates a connection whose socket is not bound or connected, for stand-ins that don't use the socket.
+        NetworkConnection();
 
         /// Signals that socket is open for use. ///\todo Remove this boolean altogether. -jj.
         bool bOpen;
+
+        /// The number of socket system calls made. Mutable since PacketsAvailable() is const.
+        mutable size_t numSyscalls;
+
+    private:
+        NetworkConnection(const NetworkConnection &);
+        void operator=(const NetworkConnection &);
+
+        /// Sets the socket buffer sizes.
+        void SetupSocket();
+
+        /// PoCo UDP socket.
+        NativeDatagramSocket socket;
+
+        /// The maximum number of datagrams in one batch, or 0 if batching is disabled.
+        size_t batchSize;
+
+        /// Storage for the queued outbound datagrams, batchSize slots of cMaxDatagramSize bytes each.
+        std::vector<uint8_t> sendQueueData;
+
+        /// The sizes of the queued outbound datagrams.
+        std::vector<size_t> sendQueueSizes;
+
+        /// The number of datagrams currently queued.
+        size_t numQueued;
+
+#ifdef NETWORKCONNECTION_NATIVE_BATCHING
+        /// Preallocated message headers for recvmmsg() and sendmmsg().
+        std::vector<mmsghdr> msgHeaders;
+
+        /// Preallocated I/O vectors for recvmmsg() and sendmmsg().
+        std::vector<iovec> ioVectors;
+#endif
     };
 }
 
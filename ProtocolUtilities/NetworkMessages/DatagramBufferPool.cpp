@@ -0,0 +1,54 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+#include "StableHeaders.h"
+
+#include "DatagramBufferPool.h"
+
+namespace ProtocolUtilities
+{
+
+DatagramBufferPool::DatagramBufferPool(size_t bufferSize_, size_t numBuffers) :
+    slab(bufferSize_ * numBuffers, 0),
+    bufferSize(bufferSize_),
+    numHeapAllocations(0)
+{
+    assert(bufferSize > 0);
+    freeList.reserve(numBuffers);
+    for(size_t i = 0; i < numBuffers; ++i)
+        freeList.push_back(&slab[i * bufferSize]);
+}
+
+DatagramBufferPool::~DatagramBufferPool()
+{
+    assert(freeList.size() * bufferSize == slab.size() && "Warning! DatagramBufferPool destroyed while buffers are still in use!");
+}
+
+uint8_t *DatagramBufferPool::Acquire()
+{
+    if (freeList.empty())
+    {
+        ++numHeapAllocations;
+        return new uint8_t[bufferSize];
+    }
+
+    uint8_t *buffer = freeList.back();
+    freeList.pop_back();
+    return buffer;
+}
+
+void DatagramBufferPool::Release(uint8_t *buffer)
+{
+    if (!buffer)
+        return;
+
+    if (IsFromSlab(buffer))
+        freeList.push_back(buffer); // Never reallocates, the capacity was reserved for all the slab buffers.
+    else
+        delete[] buffer;
+}
+
+bool DatagramBufferPool::IsFromSlab(const uint8_t *buffer) const
+{
+    return !slab.empty() && buffer >= &slab[0] && buffer < &slab[0] + slab.size();
+}
+
+}
@@ -0,0 +1,81 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+#ifndef incl_ProtocolUtilities_DatagramBufferPool_h
+#define incl_ProtocolUtilities_DatagramBufferPool_h
+
+#include <vector>
+
+#include "RexTypes.h"
+
+namespace ProtocolUtilities
+{
+    /** A slab of fixed-size byte buffers for inbound datagrams. The slab is allocated once at construction,
+        so acquiring and releasing buffers never touches the heap unless all the buffers are in use at once.
+        Not thread-safe; owned by the thread that reads the socket.
+        \ingroup OpenSimProtocolClient */
+    class DatagramBufferPool
+    {
+    public:
+        /// Constructor.
+        /** @param bufferSize Size of each buffer, in bytes.
+            @param numBuffers Number of buffers in the slab.
+        */
+        DatagramBufferPool(size_t bufferSize, size_t numBuffers);
+
+        /// Destructor. All buffers must have been released before this.
+        ~DatagramBufferPool();
+
+        /// @return A free buffer of BufferSize() bytes. If the slab is exhausted, allocates a new buffer from the heap.
+        uint8_t *Acquire();
+
+        /// Returns a buffer obtained from Acquire() back to the pool.
+        void Release(uint8_t *buffer);
+
+        /// @return The size of each buffer, in bytes.
+        size_t BufferSize() const { return bufferSize; }
+
+        /// @return The number of buffers that can currently be acquired without allocating.
+        size_t NumFree() const { return freeList.size(); }
+
+        /// @return The number of times Acquire() has had to allocate from the heap.
+        size_t NumHeapAllocations() const { return numHeapAllocations; }
+
+    private:
+        DatagramBufferPool(const DatagramBufferPool &);
+        void operator=(const DatagramBufferPool &);
+
+        /// @return True if the given buffer is a part of the slab.
+        bool IsFromSlab(const uint8_t *buffer) const;
+
+        /// The memory of all the buffers in the pool.
+        std::vector<uint8_t> slab;
+
+        /// The slab buffers that are not currently in use.
+        std::vector<uint8_t*> freeList;
+
+        /// Size of each buffer, in bytes.
+        size_t bufferSize;
+
+        /// How many times a buffer has been allocated from the heap.
+        size_t numHeapAllocations;
+    };
+
+    /// Releases a buffer back to its DatagramBufferPool when going out of scope.
+    class ScopedDatagramBuffer
+    {
+    public:
+        explicit ScopedDatagramBuffer(DatagramBufferPool &pool_) : pool(pool_), buffer(pool_.Acquire()) {}
+        ~ScopedDatagramBuffer() { pool.Release(buffer); }
+
+        uint8_t *Get() const { return buffer; }
+        size_t Size() const { return pool.BufferSize(); }
+
+    private:
+        ScopedDatagramBuffer(const ScopedDatagramBuffer &);
+        void operator=(const ScopedDatagramBuffer &);
+
+        DatagramBufferPool &pool;
+        uint8_t *buffer;
+    };
+}
+
+#endif // incl_ProtocolUtilities_DatagramBufferPool_h
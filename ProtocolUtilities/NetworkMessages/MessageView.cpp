@@ -0,0 +1,57 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+#include "StableHeaders.h"
+
+#include "MessageView.h"
+
+#include <sstream>
+
+namespace ProtocolUtilities
+{
+
+namespace MessageView
+{
+
+std::string LayoutSignature(const NetMessageInfo &info)
+{
+    std::stringstream signature;
+    for(size_t i = 0; i < info.blocks.size(); ++i)
+    {
+        const NetMessageBlock &block = info.blocks[i];
+        switch(block.type)
+        {
+        case NetBlockSingle: signature << "S"; break;
+        case NetBlockMultiple: signature << "M" << block.repeatCount; break;
+        case NetBlockVariable: signature << "V"; break;
+        default: signature << "?"; break;
+        }
+
+        signature << "(";
+        for(size_t j = 0; j < block.variables.size(); ++j)
+        {
+            const NetMessageVariable &var = block.variables[j];
+            signature << (j > 0 ? "," : "") << (int)var.type;
+            if (var.type == NetVarFixed)
+                signature << ":" << var.count;
+        }
+        signature << ")";
+    }
+    return signature.str();
+}
+
+bool MatchesLayout(const NetMessageInfo *info, const char *signature, const NetMessageInfo *&matchedInfo)
+{
+    if (!info)
+        return false;
+    if (info == matchedInfo)
+        return true;
+
+    if (LayoutSignature(*info) != signature)
+        return false;
+
+    matchedInfo = info;
+    return true;
+}
+
+}
+
+}
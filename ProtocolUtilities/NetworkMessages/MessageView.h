@@ -0,0 +1,93 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+#ifndef incl_ProtocolUtilities_MessageView_h
+#define incl_ProtocolUtilities_MessageView_h
+
+#include <cstring>
+#include <string>
+
+#include "RexTypes.h"
+#include "NetMessage.h"
+
+namespace ProtocolUtilities
+{
+    class NetInMessage;
+
+    /// A variable-length or fixed-size buffer variable inside an inbound message. Refers to the message data directly.
+    struct NetBufferRef
+    {
+        NetBufferRef(const uint8_t *data_, size_t size_) : data(data_), size(size_) {}
+
+        /// @return The buffer as a string, up to the first null character.
+        std::string ToString() const
+        {
+            const void *nul = size > 0 ? memchr(data, 0, size) : 0;
+            return std::string((const char *)data, nul ? (const char *)nul - (const char *)data : size);
+        }
+
+        const uint8_t *data;
+        size_t size;
+    };
+
+    /** Helpers for the generated message views in RealXtend/RexProtocolMessageViews.h.
+
+        A message view reads the fields of a known, high-frequency message at fixed offsets instead of walking
+        the message layout one variable at a time as NetInMessage does. The view is generated from
+        message_template.msg by NetMessageList::GenerateViewHeaderFile(). Parsing a message with a view checks
+        once per message type that the layout loaded at runtime matches the one the view was generated from,
+        and once per packet that all the block instances fit in the data. After that, the fields are read directly. */
+    namespace MessageView
+    {
+        /// Reads a value of the given type from a possibly unaligned address.
+        template<typename T>
+        inline T Read(const uint8_t *data)
+        {
+            T value;
+            memcpy((void*)&value, data, sizeof(T));
+            return value;
+        }
+
+        /// @return The length of a variable-length buffer, stored in the given number of bytes.
+        inline size_t ReadLength(const uint8_t *data, size_t prefixSize)
+        {
+            switch(prefixSize)
+            {
+            case 1: return data[0];
+            case 2: return Read<uint16_t>(data);
+            default: return Read<uint32_t>(data);
+            }
+        }
+
+        /// Advances the read pointer over the given number of bytes.
+        /// @return False if there are not enough bytes left.
+        inline bool Skip(const uint8_t *&pos, const uint8_t *end, size_t numBytes)
+        {
+            if ((size_t)(end - pos) < numBytes)
+                return false;
+            pos += numBytes;
+            return true;
+        }
+
+        /// Advances the read pointer over a variable-length buffer.
+        /// @return False if there are not enough bytes left.
+        inline bool SkipVariable(const uint8_t *&pos, const uint8_t *end, size_t prefixSize)
+        {
+            if ((size_t)(end - pos) < prefixSize)
+                return false;
+            const size_t length = ReadLength(pos, prefixSize);
+            pos += prefixSize;
+            return Skip(pos, end, length);
+        }
+
+        /// @return A string that identifies the binary layout of the message: the block multiplicities and the variable types and sizes.
+        std::string LayoutSignature(const NetMessageInfo &info);
+
+        /// Checks that the layout of the given message matches the signature a view was generated with.
+        /** @param info The layout of the message loaded at runtime.
+            @param signature The signature the view was generated with.
+            @param matchedInfo [in, out] The layout that has already been checked to match. The check is skipped if this is info.
+        */
+        bool MatchesLayout(const NetMessageInfo *info, const char *signature, const NetMessageInfo *&matchedInfo);
+    }
+}
+
+#endif // incl_ProtocolUtilities_MessageView_h
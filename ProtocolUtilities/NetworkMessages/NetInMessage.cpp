@@ -100,38 +100,73 @@ static uint8_t *ComputeMessageContentStartAddrAndLength(uint8_t *data, size_t nu
 */
 
 NetInMessage::NetInMessage(size_t seqNum, const uint8_t *data, size_t numBytes, bool zeroCoded) :
-    messageInfo(0), sequenceNumber(seqNum)
+    messageInfo(0), sequenceNumber(seqNum), messageData(0), messageDataSize(0)
 {
     if (zeroCoded)
     {
-        size_t decodedLength = CountZeroDecodedLength(data, numBytes);
+        size_t decodedLength = ZeroDecodeToBuffer(0, 0, data, numBytes);
         if (decodedLength == 0)
             throw Exception("Corrupted zero-encoded stream received!");
-        messageData.resize(decodedLength, 0); ///\todo Can optimize here for extra-extra bit of performance if profiling shows the need for so..
-        bool success = ZeroDecode(&messageData[0], decodedLength, data, numBytes);
-        if (!success)
-            throw Exception("Zero-decoding input data failed!");
+        ownedData.resize(decodedLength, 0);
+        ZeroDecodeToBuffer(&ownedData[0], decodedLength, data, numBytes);
     }
     else
     {
-        messageData.reserve(numBytes);
-        messageData.insert(messageData.end(), data, data + numBytes);
+        ownedData.reserve(numBytes);
+        ownedData.insert(ownedData.end(), data, data + numBytes);
     }
 
-    size_t messageIDLength = 0;
-    messageID = ExtractNetworkMessageID(&messageData[0], numBytes, &messageIDLength);
-    if (messageIDLength == 0)
-        throw Exception("Malformed SLUDP packet read! MessageID not present!");
-    
-    // We remove the messageID from the beginning of the message data buffer, since we just want to store the message content.
-    messageData.erase(messageData.begin(), messageData.begin() + messageIDLength);
+    if (ownedData.size() > 0)
+        SetMessageBody(&ownedData[0], ownedData.size());
+    else
+        SetMessageBody(0, 0);
 }
 
-NetInMessage::NetInMessage(const NetInMessage &rhs)
+NetInMessage::NetInMessage(size_t seqNum, uint8_t *data, size_t numBytes, bool zeroCoded, uint8_t *decodeBuffer, size_t decodeBufferSize) :
+    messageInfo(0), sequenceNumber(seqNum), messageData(0), messageDataSize(0)
 {
+    if (!zeroCoded)
+    {
+        SetMessageBody(data, numBytes);
+        return;
+    }
+
+    // Decode in a single pass. The decoded length is found out along the way.
+    uint8_t *dst = decodeBuffer;
+    size_t decodedLength = ZeroDecodeToBuffer(dst, dst ? decodeBufferSize : 0, data, numBytes);
+    if (decodedLength == 0)
+        throw Exception("Corrupted zero-encoded stream received!");
+
+    // Fall back to an owned buffer if the caller's buffer is too small for this message.
+    if (!dst || decodeBufferSize < decodedLength)
+    {
+        ownedData.resize(decodedLength, 0);
+        dst = &ownedData[0];
+        ZeroDecodeToBuffer(dst, decodedLength, data, numBytes);
+    }
+
+    SetMessageBody(dst, decodedLength);
+}
+
+NetInMessage::NetInMessage(const NetInMessage &rhs) :
+    messageData(0), messageDataSize(0)
+{
+    *this = rhs;
+}
+
+NetInMessage &NetInMessage::operator=(const NetInMessage &rhs)
+{
+    if (this == &rhs)
+        return *this;
+
+    // Always take a private copy of the data, so that the copy stays valid after a borrowed buffer is reused.
+    // assign() reuses the existing capacity of ownedData, so recycled messages don't allocate in the steady state.
+    ownedData.assign(rhs.messageData, rhs.messageData + rhs.messageDataSize);
+    messageData = ownedData.size() > 0 ? &ownedData[0] : 0;
+    messageDataSize = ownedData.size();
+
     sequenceNumber = rhs.sequenceNumber;
     messageInfo = rhs.messageInfo;
-    messageData = rhs.messageData;
     currentBlock = rhs.currentBlock;
     currentBlockInstanceNumber = rhs.currentBlockInstanceNumber;
     currentBlockInstanceCount = rhs.currentBlockInstanceCount;
@@ -139,6 +174,21 @@ NetInMessage::NetInMessage(const NetInMessage &rhs)
     currentVariableSize = rhs.currentVariableSize;
     bytesRead = rhs.bytesRead;
     messageID = rhs.messageID;
+    variableCountBlockNext = rhs.variableCountBlockNext;
+
+    return *this;
+}
+
+void NetInMessage::SetMessageBody(uint8_t *data, size_t numBytes)
+{
+    size_t messageIDLength = 0;
+    messageID = ExtractNetworkMessageID(data, numBytes, &messageIDLength);
+    if (messageIDLength == 0)
+        throw Exception("Malformed SLUDP packet read! MessageID not present!");
+
+    // We skip the messageID at the beginning of the message data buffer, since we just want to store the message content.
+    messageData = data + messageIDLength;
+    messageDataSize = numBytes - messageIDLength;
 }
 
 NetInMessage::~NetInMessage()
@@ -619,7 +669,7 @@ void NetInMessage::StartReadingNextBlock()
         return;
     case NetBlockVariable:
         // Malformity check.
-        if (bytesRead >= messageData.size())
+        if (bytesRead >= messageDataSize)
         {
             SkipToPacketEnd();
             return;
@@ -633,7 +683,7 @@ void NetInMessage::StartReadingNextBlock()
             ++currentBlock;
 
             // Malformity check.
-            if (bytesRead >= messageData.size() || currentBlock >= messageInfo->blocks.size())
+            if (bytesRead >= messageDataSize || currentBlock >= messageInfo->blocks.size())
             {
                 SkipToPacketEnd();
                 return;
@@ -667,7 +717,7 @@ void NetInMessage::ReadNextVariableSize()
     {
     case NetVarBufferByte:
         // Variable-sized variable, size denoted with 1 byte.
-        if (bytesRead >= messageData.size())
+        if (bytesRead >= messageDataSize)
         {
             SkipToPacketEnd();
             return;
@@ -679,7 +729,7 @@ void NetInMessage::ReadNextVariableSize()
         return;
     case NetVarBuffer2Bytes:
         // Variable-sized variable, size denoted with 2 bytes.
-        if (bytesRead + 1 >= messageData.size())
+        if (bytesRead + 1 >= messageDataSize)
         {
             SkipToPacketEnd();
             return;
@@ -707,12 +757,12 @@ void NetInMessage::ReadNextVariableSize()
 
 void *NetInMessage::ReadBytesUnchecked(size_t count)
 {
-    if (bytesRead >= messageData.size() || count == 0)
+    if (bytesRead >= messageDataSize || count == 0)
         return 0;
 
-    if (bytesRead + count > messageData.size())
+    if (bytesRead + count > messageDataSize)
     {
-        bytesRead = messageData.size(); // Jump to the end of the whole message so that we don't after this read anything.
+        bytesRead = messageDataSize; // Jump to the end of the whole message so that we don't after this read anything.
         std::cout << "Error: Size of the message exceeded. Can't read bytes anymore." << std::endl;
         return 0;
     }
@@ -731,7 +781,7 @@ void NetInMessage::SkipToPacketEnd()
     currentBlockInstanceCount = 0;
     currentVariable = 0;
     currentVariableSize = 0;
-    bytesRead = messageData.size();
+    bytesRead = messageDataSize;
 }
 
 void NetInMessage::RequireNextVariableType(NetVariableType type)
@@ -27,12 +27,27 @@ namespace ProtocolUtilities
         */
         NetInMessage(size_t seqNum, const uint8_t *data, size_t numBytes, bool zeroEncoded);
 
+        /// Constructor that parses the message in place without copying it.
+        /** The message refers directly to the given buffers, so they must outlive it. Copy the message
+            to get an instance that owns its data.
+            @param seqNum Sequence number of this message.
+            @param data Data buffer. Referred to directly if the data is not zero-encoded.
+            @param numBytes Number of bytes.
+            @param zeroEncoded Is this data zero-encoded.
+            @param decodeBuffer Buffer where zero-encoded data is decoded to.
+            @param decodeBufferSize Size of decodeBuffer. If the decoded data doesn't fit, the message allocates a buffer of its own.
+        */
+        NetInMessage(size_t seqNum, uint8_t *data, size_t numBytes, bool zeroEncoded, uint8_t *decodeBuffer, size_t decodeBufferSize);
+
         /// Destructor.
         ~NetInMessage();
 
-        /// Copy-constuctor.
+        /// Copy-constuctor. The copy always owns its data.
         NetInMessage(const NetInMessage &rhs);
 
+        /// Assignment. Copies the data to the buffer owned by this message, reusing its capacity.
+        NetInMessage &operator=(const NetInMessage &rhs);
+
         /// The following functions all read data from the message and advance to the next variable in the message block.
         uint8_t  ReadU8();
         uint16_t ReadU16();
@@ -124,10 +139,13 @@ namespace ProtocolUtilities
         const NetMessageInfo *GetMessageInfo() const { return messageInfo; }
 
         /// @return The original message data.
-        const std::vector<uint8_t> &GetData() const { return messageData; }
+        const uint8_t *GetData() const { return messageData; }
 
         /// @return The size of the data (message body, the header is excluded). 
-        size_t GetDataSize() const { return messageData.size(); }
+        size_t GetDataSize() const { return messageDataSize; }
+
+        /// @return The number of bytes this message has allocated for its own copy of the data.
+        size_t OwnedDataCapacity() const { return ownedData.capacity(); }
 
         /// @return The amount of read bytes.
         uint32_t BytesRead() const { return (uint32_t)bytesRead; }
@@ -140,8 +158,9 @@ namespace ProtocolUtilities
         void SetMessageID(NetMsgID id);
 #endif
     private:
-        void operator=(const NetInMessage &);
-        
+        /// Reads the message ID from the start of the given message body and points the message data to the content after it.
+        void SetMessageBody(uint8_t *data, size_t numBytes);
+
         /// Called to start reading the next variable.
         void AdvanceToNextVariable();
 
@@ -166,8 +185,14 @@ namespace ProtocolUtilities
         /// Identifies what kind of packet we're handling.
         const NetMessageInfo *messageInfo;
         
-        /// A pointer to the inbound message body
-        std::vector<uint8_t> messageData;
+        /// A pointer to the inbound message content. Points either to ownedData or to a buffer borrowed from the caller.
+        uint8_t *messageData;
+
+        /// The size of the message content, in bytes.
+        size_t messageDataSize;
+
+        /// The message data, if this message owns a copy of it.
+        std::vector<uint8_t> ownedData;
         
         /// Index of the current block.
         size_t currentBlock;
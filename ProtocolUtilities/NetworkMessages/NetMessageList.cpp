@@ -9,6 +9,7 @@
 #include <boost/cstdint.hpp>
 
 #include "NetMessageList.h"
+#include "MessageView.h"
 #include "CoreDefines.h"
 
 using namespace std;
@@ -280,6 +281,15 @@ const NetMessageInfo *NetMessageList::GetMessageInfoByID(NetMsgID id) const
         return 0;
 }
 
+const NetMessageInfo *NetMessageList::GetMessageInfoByName(const std::string &name) const
+{
+    for(NetworkMessageMap::const_iterator iter = messages.begin(); iter != messages.end(); ++iter)
+        if (iter->second.name == name)
+            return &iter->second;
+
+    return 0;
+}
+
 void NetMessageList::ParseMessageListFromFile(const char *filename)
 {
     char *file = LoadFileToString(filename);
@@ -433,4 +443,277 @@ void NetMessageList::GenerateHeaderFile(const char *filename) const
     out << endl << "#endif" << endl;
 }
 
-}
\ No newline at end of file
+/// @return The C++ type a message view returns for a fixed-size variable, or 0 if the variable is a buffer.
+static const char *ViewTypeName(NetVariableType type)
+{
+    switch(type)
+    {
+    case NetVarU8: return "uint8_t";
+    case NetVarU16: return "uint16_t";
+    case NetVarU32: return "uint32_t";
+    case NetVarU64: return "uint64_t";
+    case NetVarS8: return "int8_t";
+    case NetVarS16: return "int16_t";
+    case NetVarS32: return "int32_t";
+    case NetVarS64: return "int64_t";
+    case NetVarF32: return "float";
+    case NetVarF64: return "double";
+    case NetVarVector3: return "RexTypes::Vector3";
+    case NetVarVector3d: return "RexTypes::Vector3d";
+    case NetVarVector4: return "RexTypes::Vector4";
+    case NetVarQuaternion: return "Quaternion";
+    case NetVarUUID: return "RexUUID";
+    case NetVarBOOL: return "bool";
+    case NetVarIPADDR: return "uint32_t";
+    case NetVarIPPORT: return "uint16_t";
+    default: return 0;
+    }
+}
+
+/// @return The number of bytes in the length prefix of a variable-length buffer, or 0 if the variable is of fixed size.
+static size_t LengthPrefixSize(NetVariableType type)
+{
+    switch(type)
+    {
+    case NetVarBufferByte: return 1;
+    case NetVarBuffer2Bytes: return 2;
+    case NetVarBuffer4Bytes: return 4;
+    default: return 0;
+    }
+}
+
+/// @return The name of the variable with the first letter in lower case, for naming data members.
+static std::string MemberName(const std::string &name)
+{
+    std::string member = name;
+    if (!member.empty())
+        member[0] = (char)tolower(member[0]);
+    return member;
+}
+
+/// @return The expression for the given offset from the start of the given block segment.
+static std::string SegmentOffset(size_t segment, size_t offset)
+{
+    std::stringstream str;
+    str << "segments[" << segment << "]";
+    if (offset > 0)
+        str << " + " << offset;
+    return str.str();
+}
+
+/// Writes the view class of one block of a message.
+static void GenerateBlockView(ostream &out, const NetMessageBlock &block)
+{
+    const std::string className = block.name + "Block";
+
+    // A block is read in segments: the first segment starts at the block, and a new one after each variable-length buffer.
+    // No segment is needed after a buffer that ends the block.
+    size_t numSegments = 1;
+    for(size_t i = 0; i + 1 < block.variables.size(); ++i)
+        if (LengthPrefixSize(block.variables[i].type) > 0)
+            ++numSegments;
+
+    out << "        /// A view to one instance of the " << block.name << " block." << endl
+        << "        class " << className << endl
+        << "        {" << endl
+        << "        public:" << endl
+        << "            explicit " << className << "(const uint8_t *data)" << endl
+        << "            {" << endl
+        << "                segments[0] = data;" << endl;
+
+    size_t segment = 0;
+    size_t offset = 0;
+    for(size_t i = 0; i < block.variables.size(); ++i)
+    {
+        const NetMessageVariable &var = block.variables[i];
+        const size_t prefixSize = LengthPrefixSize(var.type);
+        if (prefixSize > 0 && segment + 1 < numSegments)
+        {
+            out << "                segments[" << segment + 1 << "] = " << SegmentOffset(segment, offset + prefixSize)
+                << " + MessageView::ReadLength(" << SegmentOffset(segment, offset) << ", " << prefixSize << ");" << endl;
+            ++segment;
+            offset = 0;
+        }
+        else
+            offset += (var.type == NetVarFixed) ? var.count : NetVariableSizes[var.type];
+    }
+    out << "            }" << endl << endl;
+
+    segment = 0;
+    offset = 0;
+    for(size_t i = 0; i < block.variables.size(); ++i)
+    {
+        const NetMessageVariable &var = block.variables[i];
+        const size_t prefixSize = LengthPrefixSize(var.type);
+        const char *typeName = ViewTypeName(var.type);
+        const std::string pos = SegmentOffset(segment, offset);
+
+        if (prefixSize > 0)
+        {
+            out << "            NetBufferRef " << var.name << "() const { return NetBufferRef(" << SegmentOffset(segment, offset + prefixSize)
+                << ", MessageView::ReadLength(" << pos << ", " << prefixSize << ")); }" << endl;
+            ++segment;
+            offset = 0;
+            continue;
+        }
+
+        if (var.type == NetVarFixed)
+            out << "            NetBufferRef " << var.name << "() const { return NetBufferRef(" << pos << ", " << var.count << "); }" << endl;
+        else if (var.type == NetVarBOOL)
+            out << "            bool " << var.name << "() const { return *(" << pos << ") != 0; }" << endl;
+        else if (var.type == NetVarQuaternion)
+            out << "            Quaternion " << var.name << "() const { return UnpackQuaternionFromFloat3(MessageView::Read<RexTypes::Vector3>("
+                << pos << ")); }" << endl;
+        else if (typeName)
+            out << "            " << typeName << " " << var.name << "() const { return MessageView::Read<" << typeName << ">(" << pos << "); }" << endl;
+        offset += (var.type == NetVarFixed) ? var.count : NetVariableSizes[var.type];
+    }
+
+    out << endl
+        << "            /// Advances the read pointer over one instance of the block." << endl
+        << "            /// @return False if the block doesn't fit in the remaining bytes." << endl
+        << "            static bool Skip(const uint8_t *&pos, const uint8_t *end)" << endl
+        << "            {" << endl
+        << "                return ";
+    offset = 0;
+    bool first = true;
+    for(size_t i = 0; i <= block.variables.size(); ++i)
+    {
+        const size_t prefixSize = i < block.variables.size() ? LengthPrefixSize(block.variables[i].type) : 0;
+        if (i < block.variables.size() && prefixSize == 0)
+        {
+            const NetMessageVariable &var = block.variables[i];
+            offset += (var.type == NetVarFixed) ? var.count : NetVariableSizes[var.type];
+            continue;
+        }
+        if (offset > 0)
+        {
+            out << (first ? "" : " &&\n                    ") << "MessageView::Skip(pos, end, " << offset << ")";
+            first = false;
+            offset = 0;
+        }
+        if (prefixSize > 0)
+        {
+            out << (first ? "" : " &&\n                    ") << "MessageView::SkipVariable(pos, end, " << prefixSize << ")";
+            first = false;
+        }
+    }
+    out << (first ? "true" : "") << ";" << endl
+        << "            }" << endl << endl
+        << "        private:" << endl
+        << "            const uint8_t *segments[" << numSegments << "];" << endl
+        << "        };" << endl << endl;
+}
+
+/// Writes the view class of a message.
+static void GenerateMessageView(ostream &out, const NetMessageInfo &msg)
+{
+    const std::string className = msg.name + "View";
+
+    out << "    /// A view to the " << msg.name << " message." << endl
+        << "    class " << className << endl
+        << "    {" << endl
+        << "    public:" << endl
+        << "        static const NetMsgID cMessageID = 0x" << hex << msg.id << dec << ";" << endl << endl
+        << "        /// @return The layout of the message the view was generated from. See MessageView::LayoutSignature." << endl
+        << "        static const char *Signature() { return \"" << MessageView::LayoutSignature(msg) << "\"; }" << endl << endl;
+
+    for(size_t i = 0; i < msg.blocks.size(); ++i)
+        GenerateBlockView(out, msg.blocks[i]);
+
+    out << "        " << className << "() :";
+    for(size_t i = 0; i < msg.blocks.size(); ++i)
+        out << (i > 0 ? "," : "") << " num" << msg.blocks[i].name << "(0)";
+    out << " {}" << endl << endl
+        << "        /// Locates the block instances in the message. Checks that they all fit in the message." << endl
+        << "        /// @return False if the message is not of type " << msg.name << " with the expected layout, or is truncated." << endl
+        << "        bool Parse(const NetInMessage &msg)" << endl
+        << "        {" << endl
+        << "            static const NetMessageInfo *matchedInfo = 0;" << endl
+        << "            if (msg.GetMessageID() != cMessageID || !MessageView::MatchesLayout(msg.GetMessageInfo(), Signature(), matchedInfo))" << endl
+        << "                return false;" << endl << endl
+        << "            const uint8_t *pos = msg.GetData();" << endl
+        << "            const uint8_t *end = pos + msg.GetDataSize();" << endl;
+
+    for(size_t i = 0; i < msg.blocks.size(); ++i)
+    {
+        const NetMessageBlock &block = msg.blocks[i];
+        const std::string member = MemberName(block.name);
+        out << endl;
+        if (block.type == NetBlockVariable)
+            out << "            // A missing instance count means there are no instances." << endl
+                << "            num" << block.name << " = (pos < end) ? *pos++ : 0;" << endl;
+        else
+            out << "            num" << block.name << " = " << (block.type == NetBlockSingle ? 1 : block.repeatCount) << ";" << endl;
+        out << "            for(size_t i = 0; i < num" << block.name << "; ++i)" << endl
+            << "            {" << endl
+            << "                " << member << "[i] = pos;" << endl
+            << "                if (!" << block.name << "Block::Skip(pos, end))" << endl
+            << "                    return false;" << endl
+            << "            }" << endl;
+    }
+    out << endl
+        << "            return true;" << endl
+        << "        }" << endl << endl;
+
+    for(size_t i = 0; i < msg.blocks.size(); ++i)
+    {
+        const NetMessageBlock &block = msg.blocks[i];
+        const std::string member = MemberName(block.name);
+        if (block.type == NetBlockSingle)
+            out << "        " << block.name << "Block " << block.name << "() const { return " << block.name << "Block(" << member << "[0]); }" << endl;
+        else
+        {
+            out << "        size_t " << block.name << "Count() const { return num" << block.name << "; }" << endl
+                << "        " << block.name << "Block " << block.name << "(size_t index) const { assert(index < num" << block.name << "); return "
+                << block.name << "Block(" << member << "[index]); }" << endl;
+        }
+    }
+
+    out << endl << "    private:" << endl;
+    for(size_t i = 0; i < msg.blocks.size(); ++i)
+    {
+        const NetMessageBlock &block = msg.blocks[i];
+        const size_t maxInstances = (block.type == NetBlockSingle) ? 1 : (block.type == NetBlockMultiple) ? block.repeatCount : 255;
+        out << "        const uint8_t *" << MemberName(block.name) << "[" << maxInstances << "];" << endl
+            << "        size_t num" << block.name << ";" << endl;
+    }
+    out << "    };" << endl << endl;
+}
+
+bool NetMessageList::GenerateViewHeaderFile(const char *filename, const std::vector<std::string> &messageNames) const
+{
+    std::vector<const NetMessageInfo*> msgs;
+    for(size_t i = 0; i < messageNames.size(); ++i)
+    {
+        const NetMessageInfo *msg = GetMessageInfoByName(messageNames[i]);
+        if (!msg)
+            return false;
+        msgs.push_back(msg);
+    }
+
+    ofstream out(filename);
+
+    out << "/* This file defines views for reading the fields of frequently received messages at fixed offsets." << endl
+        << "See NetworkMessages/MessageView.h. This file is automatically generated from the message template" << endl
+        << "file by NetMessageList::GenerateViewHeaderFile, so no point modifying it here. */" << endl
+        << endl
+        << "#ifndef RexProtocolMessageViews" << endl
+        << "#define RexProtocolMessageViews" << endl
+        << endl
+        << "#include \"NetworkMessages/NetInMessage.h\"" << endl
+        << "#include \"NetworkMessages/MessageView.h\"" << endl
+        << "#include \"QuatUtils.h\"" << endl
+        << "#include \"RexUUID.h\"" << endl
+        << endl
+        << "namespace ProtocolUtilities" << endl
+        << "{" << endl;
+
+    for(size_t i = 0; i < msgs.size(); ++i)
+        GenerateMessageView(out, *msgs[i]);
+
+    out << "}" << endl << endl << "#endif" << endl;
+    return true;
+}
+
+}
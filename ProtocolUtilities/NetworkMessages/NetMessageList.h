@@ -23,9 +23,17 @@ namespace ProtocolUtilities
         ///         message is known.
         const NetMessageInfo *GetMessageInfoByID(NetMsgID id) const;
 
+        /// @return The message info structure corresponding to the message with the given name, or 0 if no such
+        ///         message is known.
+        const NetMessageInfo *GetMessageInfoByName(const std::string &name) const;
+
         /// Generates a C++ header file out of all the IDs of the known message definitions.
         void GenerateHeaderFile(const char *filename) const;
 
+        /// Generates a C++ header file with a message view class for each of the given messages. See MessageView.h.
+        /// @return False if some of the messages are not known. The file is not written in that case.
+        bool GenerateViewHeaderFile(const char *filename, const std::vector<std::string> &messageNames) const;
+
     private:
         NetMessageList(const NetMessageList &);
         void operator=(const NetMessageList &);
@@ -7,6 +7,9 @@
 #include "NetInMessage.h"
 #include "NetOutMessage.h"
 #include "NetworkConnection.h"
+#include "ReplayNetworkConnection.h"
+#include "PacketCapture.h"
+#include "DatagramBufferPool.h"
 #include "ZeroCode.h"
 #include "RealXtend/RexProtocolMsgIDs.h"
 #include "Interfaces/INetMessageListener.h"
@@ -18,8 +21,11 @@
 #include <sstream>
 #include <vector>
 #include <cstring>
+#include <cmath>
+#include <algorithm>
 
 #include <boost/timer.hpp>
+#include <boost/bind.hpp>
 
 #include <Poco/Net/NetException.h>
 
@@ -86,31 +92,6 @@ namespace ProtocolUtilities
         return data + 6 + extraHeaderSize;
     }
 
-    /// Returns a list of appended acks from packet
-    /// @param data A pointer to the message data.
-    /// @param numBytes The size of data, in bytes.
-    static std::vector<uint32_t> GetAppendedAckList(uint8_t *data, size_t numBytes)
-    {
-        std::vector<uint32_t> acks;
-        if ((data[0] & NetFlagAck) && (numBytes > 6))
-        {
-            if (numBytes > 6)
-            {
-                size_t num_acks = data[numBytes-1];
-                acks.resize(num_acks);
-                
-                int idx = numBytes - 1 - num_acks * 4;
-                if (idx < 6) return acks;
-                
-                for (size_t i = 0; i < num_acks; ++i)
-                {
-                    acks.push_back((uint32_t)ntohl(*(u_long*)&data[idx]));
-                }
-            }
-        }
-        return acks;
-    }
-
     /// const version of above.
     /*
     static const uint8_t *ComputeMessageBodyStartAddrAndLength(const uint8_t *data, size_t numBytes, size_t *messageLength)
@@ -143,8 +124,30 @@ namespace ProtocolUtilities
         return data[type];
     }
 
+    /// The maximum size of an inbound datagram.
+    static const size_t cMaxPayload = 2048;
+
+    /// The size of the buffers zero-encoded messages are decoded into. Larger messages fall back to allocating.
+    static const size_t cMaxDecodedPayload = 16384;
+
+    /// The retransmit timeout used before the round-trip time has been measured, in milliseconds.
+    static const uint32_t cInitialRetransmitTimeout = 1000;
+
+    /// Bounds of the retransmit timeout, in milliseconds. The lower bound leaves room for the server delaying its acks.
+    static const uint32_t cMinRetransmitTimeout = 250;
+    static const uint32_t cMaxRetransmitTimeout = 5000;
+
+    /// @return The current time in milliseconds, for the resend queue.
+    static uint64_t CurrentTimeMsecs()
+    {
+        return (uint64_t)((double)GetCurrentClockTime() * 1000.0 / GetCurrentClockFreq());
+    }
+
     NetMessageManager::NetMessageManager(const char *messageListFilename)
     :messageList(boost::shared_ptr<NetMessageList>(new NetMessageList(messageListFilename)))
+    ,datagramBuffers(new DatagramBufferPool(cMaxPayload, 64))
+    ,decodeBuffers(new DatagramBufferPool(cMaxDecodedPayload, 4))
+    ,inboundHeapAllocations(0)
     ,messageListener(0)
     ,sequenceNumber(1) // Note here: We always start outbound communication with PacketID==1.
     ,lastReceivedSequenceNumber(0)
@@ -159,17 +162,27 @@ namespace ProtocolUtilities
 #endif
     ,lastRoundTripTime(0.0)
     ,smoothenedRoundTripTime(5.0) // arbitrary default value
+    ,roundTripTimeVariance(0.0)
     ,lastHeardSince(0.0)
     ,lastHeardSinceTick(0)
     ,pingId(0)
+    ,numResentPackets(0)
+    ,retransmitTimeout(cInitialRetransmitTimeout)
+    ,roundTripTimeMeasured(false)
+    ,threaded(false)
+    ,threadedQueueSize(4096)
+    ,ioBatchSize(0)
+    ,networkThreadActive(false)
+    ,keepNetworkThreadRunning(false)
     {
-        receivedSequenceNumbers.clear();
+        pendingACKs.reserve(256);
+        expiredMessages.reserve(64);
     }
 
     NetMessageManager::~NetMessageManager()
     {
+        StopNetworkThread();
         ClearMessagePoolMemory();
-        receivedSequenceNumbers.clear();
     }
 
     void NetMessageManager::DumpNetworkMessage(NetMsgID id, NetInMessage *msg)
@@ -251,9 +264,23 @@ namespace ProtocolUtilities
 
 #endif
 
-    void NetMessageManager::HandleInboundBytes(std::vector<uint8_t> &data)
+    void NetMessageManager::ProcessAppendedAcks(const uint8_t *data, size_t numBytes)
+    {
+        if (!(data[0] & NetFlagAck) || numBytes <= 6)
+            return;
+
+        const size_t numAcks = data[numBytes-1];
+        if (numBytes - 1 < 6 + numAcks * 4)
+            return; // Malformed.
+
+        // The appended acks are stored in big endian right before the ack count byte.
+        const uint8_t *ack = data + numBytes - 1 - numAcks * 4;
+        for(size_t i = 0; i < numAcks; ++i, ack += 4)
+            ProcessPacketACK((uint32_t)ntohl(*(u_long*)ack));
+    }
+
+    void NetMessageManager::HandleInboundBytes(uint8_t *data, size_t numBytes)
     {
-        const size_t numBytes = data.size();
 #ifdef PROFILING
         receivedDatagrams.InsertRecord(1.0);
         receivedDatabytes.InsertRecord(numBytes);
@@ -266,24 +293,24 @@ namespace ProtocolUtilities
             return;
         }
 
-        uint32_t seqNum = ExtractNetworkMessageSequenceNumber(&data[0], numBytes);
-
-#ifdef PROFILING
-        if (receivedSequenceNumbers.size() > 0 && seqNum - lastReceivedSequenceNumber < 16)
-            for(int i = lastReceivedSequenceNumber+1; i < seqNum; ++i)
-                if (receivedSequenceNumbers.find(i) == receivedSequenceNumbers.end())
-                    lostPackets.InsertRecord(1.0);
-#endif
+        uint32_t seqNum = ExtractNetworkMessageSequenceNumber(data, numBytes);
         lastReceivedSequenceNumber = seqNum;
 
         // Send ACK for reliable messages.
         if ((data[0] & NetFlagReliable) != 0)
             QueuePacketACK(seqNum);
 
-        // We need to do pruning of inbound duplicates, so add the sequence number to the set of received sequence numbers, 
-        // and check if we've seen this packet before.
-        pair<set<uint32_t>::iterator, bool> ret = receivedSequenceNumbers.insert(seqNum);
-        if (ret.second == false) 
+        // We need to do pruning of inbound duplicates, so mark the sequence number received, and check if we've seen this packet before.
+        // Packets too old to be in the window are let through, there's no telling whether they are duplicates.
+#ifdef PROFILING
+        const size_t numLostBefore = receivedSequenceNumbers.NumLost();
+#endif
+        const SequenceNumberWindow::InsertResult result = receivedSequenceNumbers.Insert(seqNum);
+#ifdef PROFILING
+        if (receivedSequenceNumbers.NumLost() != numLostBefore)
+            lostPackets.InsertRecord((double)(receivedSequenceNumbers.NumLost() - numLostBefore));
+#endif
+        if (result == SequenceNumberWindow::SeqDuplicate)
         {
 #ifdef PROFILING
             duplicatesReceived.InsertRecord(1.0);
@@ -294,18 +321,22 @@ namespace ProtocolUtilities
 //        NetMsgID id = ExtractNetworkMessageNumber(&data[0], numBytes);
 
         size_t messageLength = 0;
-        const uint8_t *message = ComputeMessageBodyStartAddrAndLength(&data[0], numBytes, &messageLength);
+        uint8_t *message = ComputeMessageBodyStartAddrAndLength(data, numBytes, &messageLength);
         if (!message)
         {
             cout << "Malformed packet received, could not determine message size" << endl;
             return;
         }
-        
-        std::vector<uint32_t> appended_acks = GetAppendedAckList(&data[0], numBytes);
-        
+
+        const bool zeroCoded = (data[0] & NetFlagZeroCode) != 0;
+
         try
         {
-            NetInMessage msg(seqNum, &message[0], messageLength, (data[0] & NetFlagZeroCode) != 0);
+            // Parse the message in place. Zero-encoded messages are decoded into a pooled buffer, others are read straight from the datagram.
+            ScopedDatagramBuffer decodeBuffer(*decodeBuffers);
+            NetInMessage msg(seqNum, message, messageLength, zeroCoded, decodeBuffer.Get(), decodeBuffer.Size());
+            if (msg.OwnedDataCapacity() > 0)
+                ++inboundHeapAllocations; // Didn't fit in the decode buffer.
 
             const NetMessageInfo *messageInfo = messageList->GetMessageInfoByID(msg.GetMessageID());
             if (!messageInfo)
@@ -315,10 +346,7 @@ namespace ProtocolUtilities
             }
             msg.SetMessageInfo(messageInfo);
 
-            // Process appended acks
-            if (appended_acks.size() > 0)
-                for(unsigned i = 0; i < appended_acks.size(); ++i)
-                    ProcessPacketACK(appended_acks[i]);
+            ProcessAppendedAcks(data, numBytes);
 
             // NetMessageManager handles all Acks and Pings. Those are not passed to the application.
             switch(msg.GetMessageID())
@@ -334,7 +362,7 @@ namespace ProtocolUtilities
                 break;
             default:
                 // Pass the message to the listener(s).
-                messageListener->OnNetworkMessageReceived(msg.GetMessageID(), &msg);
+                DeliverInboundMessage(msg);
                 break;
             }
         }
@@ -345,16 +373,47 @@ namespace ProtocolUtilities
         }
     }
 
-    static void FlipBits(std::vector<uint8_t> &data, int numBitsToFlip)
+    static void FlipBits(uint8_t *data, size_t numBytes, int numBitsToFlip)
     {
         while(numBitsToFlip-- > 0)
         {
-            int idx = rand() % data.size();
+            int idx = rand() % numBytes;
             uint8_t bit = 1 << (rand() % 8);
             data[idx] ^= bit;
         }
     }
 
+    void NetMessageManager::DeliverInboundMessage(NetInMessage &msg)
+    {
+        if (inboundQueue)
+        {
+            // The message refers to pooled buffers that are reused right after this, so the queue gets a copy that owns its data.
+            // Reuse a message the main thread has already handled if there is one, so that we don't allocate in the steady state.
+            NetInMessage *queued = 0;
+            if (recycledInboundMessages->Pop(queued))
+            {
+                const size_t oldCapacity = queued->OwnedDataCapacity();
+                *queued = msg;
+                if (queued->OwnedDataCapacity() != oldCapacity)
+                    ++inboundHeapAllocations;
+            }
+            else
+            {
+                queued = new NetInMessage(msg);
+                ++inboundHeapAllocations;
+            }
+
+            // ReceivePackets checks for free space before reading a datagram, so the push should never fail.
+            if (!inboundQueue->Push(queued))
+            {
+                cout << "Inbound message queue full! Dropping message " << msg.GetMessageID() << "." << endl;
+                delete queued;
+            }
+        }
+        else
+            messageListener->OnNetworkMessageReceived(msg.GetMessageID(), &msg);
+    }
+
     /// Polls the inbound socket until the message queue is empty. Also resends any timed out reliable messages.
     void NetMessageManager::ProcessMessages()
     {
@@ -362,60 +421,286 @@ namespace ProtocolUtilities
         if (!connection)
             return;
 
-        if (!ResendQueueIsEmpty())
-            ProcessResendQueue();
-
         // Process network messages for max. 0.1 seconds, to prevent lack of rendering/mainloop execution during heavy processing
         static const double MAX_PROCESS_TIME = 0.1;
-        boost::timer timer;
 
-        PROFILE(NetMessageManager_WhilePacketsAvailable);
-        while(connection->PacketsAvailable() && timer.elapsed() < MAX_PROCESS_TIME)
+        if (inboundQueue)
         {
-            const int cMaxPayload = 2048;
-            std::vector<uint8_t> data(cMaxPayload, 0);
-            int numBytes = connection->ReceiveBytes(&data[0], cMaxPayload);
-            if (numBytes == 0)
-                break;
+            // In threaded mode the network thread does all the socket work, we only pass the already parsed messages to the listener.
+            std::string error;
+            {
+                MutexLock lock(networkErrorMutex);
+                error.swap(networkError);
+            }
+            if (!error.empty())
+            {
+                StopNetworkThread();
+                throw Poco::Net::NetException(error);
+            }
 
-            data.resize(numBytes);
+            boost::timer timer;
+            NetInMessage *msg = 0;
+            while(timer.elapsed() < MAX_PROCESS_TIME && inboundQueue->Pop(msg))
+            {
+                if (messageListener)
+                    messageListener->OnNetworkMessageReceived(msg->GetMessageID(), msg);
 
-            tick_t now = GetCurrentClockTime();
-            lastHeardSince = (double)(now - lastHeardSinceTick) / GetCurrentClockFreq() * 1000;
-            lastHeardSinceTick = now;
+                // Hand the message struct back to the network thread for reuse.
+                if (!recycledInboundMessages->Push(msg))
+                    delete msg;
+            }
 
-#ifdef PROTOCOL_STRESS_TEST
-            const int numDuplications = 10;
-            const double bitErrorRate = 0.05;
-            for(int i = 0; i < numDuplications; ++i)
+            NetOutMessage *sentMsg = 0;
+            while(sentMessageCopies->Pop(sentMsg))
             {
-#endif
-                HandleInboundBytes(data);
-#ifdef PROTOCOL_STRESS_TEST
-                FlipBits(data, (int)ceil(data.size() * bitErrorRate));
+                if (messageListener)
+                    messageListener->OnNetworkMessageSent(sentMsg);
+                MutexLock lock(messagePoolMutex);
+                unusedMessagePool.push_back(sentMsg);
             }
-#endif
+
+            // The network thread quits when the socket is closed. Once the remaining messages are handled, release the connection.
+            if (!NetworkThreadActive() && inboundQueue->IsEmpty())
+            {
+                StopNetworkThread();
+                connection.reset();
+            }
+            return;
         }
+
+        // Send out what the application has queued since the last frame.
+        connection->FlushSendQueue();
+
+        if (!ResendQueueIsEmpty())
+            ProcessResendQueue();
+
+        ReceivePackets(MAX_PROCESS_TIME);
+
         if (!connection->Open())
+        {
             connection.reset();
-
-        // To keep memory footprint down and to defend against memory attacks, keep the list of seen sequence numbers to a fixed size.
-        const size_t cMaxSeqNumMemorySize = 300;
-        while(receivedSequenceNumbers.size() > cMaxSeqNumMemorySize)
-            receivedSequenceNumbers.erase(receivedSequenceNumbers.begin()); // We remove from the front to guarantee the smallest(oldest) are removed first.
+            pendingACKs.clear();
+            return;
+        }
 
         // Acknowledge all the new accumulated packets that the server sent as reliable.
         SendPendingACKs();
 
         ManagePingSends();
+
+        // With batched I/O the resends, ACKs and pings of this frame go out in one system call.
+        connection->FlushSendQueue();
+    }
+
+    void NetMessageManager::HandleReceivedDatagram(uint8_t *data, size_t numBytes)
+    {
+        tick_t now = GetCurrentClockTime();
+        lastHeardSince = (double)(now - lastHeardSinceTick) / GetCurrentClockFreq() * 1000;
+        lastHeardSinceTick = now;
+
+        {
+            MutexLock lock(captureMutex);
+            if (capture && !capture->Write(data, numBytes))
+            {
+                std::cout << "Failed to write to packet capture file " << capture->Filename() << ", stopping the capture after "
+                    << capture->NumDatagrams() << " datagrams." << std::endl;
+                capture.reset();
+            }
+        }
+
+#ifdef PROTOCOL_STRESS_TEST
+        const int numDuplications = 10;
+        const double bitErrorRate = 0.05;
+        for(int i = 0; i < numDuplications; ++i)
+        {
+#endif
+            HandleInboundBytes(data, numBytes);
+#ifdef PROTOCOL_STRESS_TEST
+            FlipBits(data, numBytes, (int)ceil(numBytes * bitErrorRate));
+        }
+#endif
+    }
+
+    void NetMessageManager::ReceivePackets(double maxProcessTime)
+    {
+        boost::timer timer;
+
+        PROFILE(NetMessageManager_WhilePacketsAvailable);
+        if (connection->BatchSize() > 0)
+        {
+            // Drain the socket a batch at a time. The batch is bounded by the buffer pool size and, in threaded mode,
+            // by the free space in the inbound queue.
+            const size_t cMaxBatch = 32;
+            uint8_t *buffers[cMaxBatch];
+            size_t sizes[cMaxBatch];
+
+            while(timer.elapsed() < maxProcessTime)
+            {
+                size_t maxCount = std::min(connection->BatchSize(), cMaxBatch);
+                if (inboundQueue)
+                    maxCount = std::min(maxCount, inboundQueue->Capacity() - inboundQueue->Size());
+                if (maxCount == 0)
+                    break;
+
+                for(size_t i = 0; i < maxCount; ++i)
+                    buffers[i] = datagramBuffers->Acquire();
+
+                size_t numReceived = 0;
+                try
+                {
+                    numReceived = connection->ReceiveBatch(buffers, datagramBuffers->BufferSize(), sizes, maxCount);
+                    for(size_t i = 0; i < numReceived; ++i)
+                        HandleReceivedDatagram(buffers[i], sizes[i]);
+                }
+                catch(...)
+                {
+                    for(size_t i = 0; i < maxCount; ++i)
+                        datagramBuffers->Release(buffers[i]);
+                    throw;
+                }
+
+                for(size_t i = 0; i < maxCount; ++i)
+                    datagramBuffers->Release(buffers[i]);
+
+                // The socket was drained.
+                if (numReceived < maxCount)
+                    break;
+            }
+        }
+        else
+        {
+            while(connection->PacketsAvailable() && timer.elapsed() < maxProcessTime)
+            {
+                // Leave the datagrams in the socket buffer until the main thread has caught up.
+                if (inboundQueue && inboundQueue->IsFull())
+                    break;
+
+                ScopedDatagramBuffer data(*datagramBuffers);
+                int numBytes = connection->ReceiveBytes(data.Get(), data.Size());
+                if (numBytes == 0)
+                    break;
+
+                HandleReceivedDatagram(data.Get(), numBytes);
+            }
+        }
+    }
+
+    void NetMessageManager::SetThreadedMode(bool enable, size_t queueSize)
+    {
+        threaded = enable;
+        threadedQueueSize = queueSize;
+    }
+
+    void NetMessageManager::SetBatchedIO(size_t batchSize)
+    {
+        ioBatchSize = batchSize;
+    }
+
+    size_t NetMessageManager::NumSocketSyscalls() const
+    {
+        boost::shared_ptr<NetworkConnection> conn = connection;
+        return conn ? conn->NumSyscalls() : 0;
+    }
+
+    void NetMessageManager::NetworkThreadMain()
+    {
+        // How long the network thread may spend reading the socket before it services the outbound queue again.
+        static const double MAX_RECEIVE_TIME = 0.01;
+
+        try
+        {
+            while(keepNetworkThreadRunning && connection->Open())
+            {
+                {
+                    PROFILE(NetMessageManager_NetworkThread);
+
+                    NetOutMessage *message = 0;
+                    while(outboundQueue->Pop(message))
+                        ProcessOutboundMessage(message);
+
+                    if (!ResendQueueIsEmpty())
+                        ProcessResendQueue();
+
+                    ReceivePackets(MAX_RECEIVE_TIME);
+
+                    SendPendingACKs();
+
+                    ManagePingSends();
+
+                    connection->FlushSendQueue();
+                }
+                RESETPROFILER;
+
+                // Sleep until more data arrives, but wake up often enough to send out what the main thread has queued.
+                if (inboundQueue->IsFull())
+                    boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+                else
+                    connection->WaitForPackets(1);
+            }
+        }
+        catch(Poco::Net::NetException &e)
+        {
+            MutexLock lock(networkErrorMutex);
+            networkError = e.displayText();
+        }
+
+        // Send out what was left in the queues when we were asked to stop, e.g. a logout request.
+        try
+        {
+            if (connection->Open())
+            {
+                NetOutMessage *message = 0;
+                while(outboundQueue->Pop(message))
+                    ProcessOutboundMessage(message);
+                connection->FlushSendQueue();
+            }
+        }
+        catch(Poco::Net::NetException &)
+        {
+        }
+
+        networkThreadActive = false;
+    }
+
+    void NetMessageManager::StopNetworkThread()
+    {
+        if (!outboundQueue)
+            return;
+
+        keepNetworkThreadRunning = false;
+        networkThread.join();
+        networkThreadActive = false;
+
+        // The network thread is gone, so we can now act as the consumer of the outbound queue as well.
+        NetInMessage *inMsg = 0;
+        while(inboundQueue->Pop(inMsg))
+            delete inMsg;
+        while(recycledInboundMessages->Pop(inMsg))
+            delete inMsg;
+
+        NetOutMessage *outMsg = 0;
+        {
+            MutexLock lock(messagePoolMutex);
+            while(outboundQueue->Pop(outMsg))
+                unusedMessagePool.push_back(outMsg);
+            while(sentMessageCopies->Pop(outMsg))
+                unusedMessagePool.push_back(outMsg);
+        }
+
+        inboundQueue.reset();
+        recycledInboundMessages.reset();
+        outboundQueue.reset();
+        sentMessageCopies.reset();
     }
 
     bool NetMessageManager::ConnectTo(const char *serverAddress, int port)
     {
+        StopNetworkThread();
+
         try
         {
-            connection = boost::shared_ptr<NetworkConnection>(new NetworkConnection(serverAddress, port));
-            pingSendTimer.restart();
+            replayConnection.reset();
+            StartConnection(boost::shared_ptr<NetworkConnection>(new NetworkConnection(serverAddress, port)));
             return true;
         }
         catch(Poco::Net::NetException &e)
@@ -425,11 +710,93 @@ namespace ProtocolUtilities
         }
     }
 
+    bool NetMessageManager::ConnectToReplay(const std::string &filename, bool realTimePacing)
+    {
+        StopNetworkThread();
+
+        try
+        {
+            replayConnection = boost::shared_ptr<ReplayNetworkConnection>(new ReplayNetworkConnection(filename, realTimePacing));
+        }
+        catch(Exception &e)
+        {
+            std::cout << "Failed to start replay: " << e.what() << std::endl;
+            return false;
+        }
+
+        StartConnection(replayConnection);
+        return true;
+    }
+
+    bool NetMessageManager::ReplayFinished() const
+    {
+        boost::shared_ptr<ReplayNetworkConnection> replay = replayConnection;
+        return replay && replay->Finished();
+    }
+
+    void NetMessageManager::StartConnection(boost::shared_ptr<NetworkConnection> newConnection)
+    {
+        connection = newConnection;
+        connection->SetBatchSize(ioBatchSize);
+        pingSendTimer.restart();
+
+        if (threaded)
+        {
+            inboundQueue = boost::shared_ptr<LockFreeRingBuffer<NetInMessage*> >(new LockFreeRingBuffer<NetInMessage*>(threadedQueueSize));
+            recycledInboundMessages = boost::shared_ptr<LockFreeRingBuffer<NetInMessage*> >(new LockFreeRingBuffer<NetInMessage*>(threadedQueueSize));
+            outboundQueue = boost::shared_ptr<LockFreeRingBuffer<NetOutMessage*> >(new LockFreeRingBuffer<NetOutMessage*>(threadedQueueSize));
+            sentMessageCopies = boost::shared_ptr<LockFreeRingBuffer<NetOutMessage*> >(new LockFreeRingBuffer<NetOutMessage*>(threadedQueueSize));
+            keepNetworkThreadRunning = true;
+            networkThreadActive = true;
+            networkThread = Thread(boost::bind(&NetMessageManager::NetworkThreadMain, this));
+        }
+    }
+
+    bool NetMessageManager::StartCapture(const std::string &filename)
+    {
+        try
+        {
+            boost::shared_ptr<PacketCaptureWriter> newCapture(new PacketCaptureWriter(filename));
+            MutexLock lock(captureMutex);
+            capture = newCapture;
+            return true;
+        }
+        catch(Exception &e)
+        {
+            std::cout << "Failed to start packet capture: " << e.what() << std::endl;
+            return false;
+        }
+    }
+
+    void NetMessageManager::StopCapture()
+    {
+        MutexLock lock(captureMutex);
+        capture.reset();
+    }
+
+    bool NetMessageManager::IsCapturing() const
+    {
+        MutexLock lock(captureMutex);
+        return capture.get() != 0;
+    }
+
+    size_t NetMessageManager::NumCapturedDatagrams() const
+    {
+        MutexLock lock(captureMutex);
+        return capture ? capture->NumDatagrams() : 0;
+    }
+
     void NetMessageManager::Disconnect()
     {
-        connection->Close();
+        StopNetworkThread();
+        if (connection)
+        {
+            if (connection->Open())
+                connection->FlushSendQueue();
+            connection->Close();
+        }
         ClearMessagePoolMemory();
-        receivedSequenceNumbers.clear();
+        receivedSequenceNumbers.Clear();
     }
 
     NetOutMessage *NetMessageManager::StartNewMessage(NetMsgID id)
@@ -444,35 +811,32 @@ namespace ProtocolUtilities
         NetOutMessage *newMsg = 0;
 
         // Find if we have an old message struct in the unused pool that we can use.
-        if (unusedMessagePool.size() > 0)
         {
-            newMsg = unusedMessagePool.front();
-            unusedMessagePool.pop_front();
-            newMsg->ResetWriting();
+            MutexLock lock(messagePoolMutex);
+            if (unusedMessagePool.size() > 0)
+            {
+                newMsg = unusedMessagePool.front();
+                unusedMessagePool.pop_front();
+            }
         }
+
+        if (newMsg)
+            newMsg->ResetWriting();
         else
             newMsg = new NetOutMessage();
 
         newMsg->SetMessageInfo(info);
         newMsg->AddMessageHeader();
+
+        MutexLock lock(messagePoolMutex);
         usedMessagePool.push_back(newMsg);
         
         return newMsg;
     }
 
-    void NetMessageManager::FinishMessage(NetOutMessage *message)
+    void NetMessageManager::ReleaseFromUsedPool(NetOutMessage *message)
     {
-        assert(message);
-        message->SetSequenceNumber(GetNewSequenceNumber());
-
-        std::vector<uint8_t> &data = message->GetData();
-        if (data.size() == 0)
-        {
-            unusedMessagePool.push_back(message);
-            return;
-        }
-        assert(data.size() >= message->BytesFilled());
-        data.resize(message->BytesFilled());
+        MutexLock lock(messagePoolMutex);
 
         // Find and remove the given message from the usedMessagePool list, it has to be there.
 #ifdef _DEBUG
@@ -483,7 +847,61 @@ namespace ProtocolUtilities
 #ifdef _DEBUG
         assert(usedMessagePoolSize == usedMessagePool.size() + 1);
 #endif
-        
+    }
+
+    void NetMessageManager::FinishMessage(NetOutMessage *message)
+    {
+        assert(message);
+        ReleaseFromUsedPool(message);
+
+        if (message->GetData().size() == 0)
+        {
+            MutexLock lock(messagePoolMutex);
+            unusedMessagePool.push_back(message);
+            return;
+        }
+
+        if (outboundQueue)
+        {
+            // In threaded mode the network thread numbers, encodes and sends the message, so that the sequence numbers
+            // go out in increasing order along with the ACKs, pings and resends of the network thread.
+            while(!outboundQueue->Push(message))
+            {
+                if (!NetworkThreadActive())
+                {
+                    MutexLock lock(messagePoolMutex);
+                    unusedMessagePool.push_back(message);
+                    return;
+                }
+                boost::this_thread::yield();
+            }
+            return;
+        }
+
+        ProcessOutboundMessage(message);
+    }
+
+    void NetMessageManager::FinishInternalMessage(NetOutMessage *message)
+    {
+        assert(message);
+        ReleaseFromUsedPool(message);
+        ProcessOutboundMessage(message);
+    }
+
+    void NetMessageManager::ProcessOutboundMessage(NetOutMessage *message)
+    {
+        PrepareOutboundMessage(message);
+        SendOutboundMessage(message);
+    }
+
+    void NetMessageManager::PrepareOutboundMessage(NetOutMessage *message)
+    {
+        message->SetSequenceNumber(GetNewSequenceNumber());
+
+        std::vector<uint8_t> &data = message->GetData();
+        assert(data.size() >= message->BytesFilled());
+        data.resize(message->BytesFilled());
+
         // Try to Zero-encode the message if that is desired. If encoding worsens the size, we'll send unencoded.
         if (message->GetMessageInfo()->encoding == NetZeroEncoded)
         {
@@ -492,32 +910,39 @@ namespace ProtocolUtilities
             assert(bodyLength < message->BytesFilled());
             size_t headerLength = message->BytesFilled() - bodyLength;
 
-            size_t encodedBodyLength = CountZeroEncodedLength(bodyData, bodyLength);
+            // Encode in a single pass to a scratch buffer. The encoding stops as soon as it would take as much space
+            // as the non-coded body, in which case the message is sent non-coded. Messages are only prepared by the
+            // thread that owns the connection, which also owns the buffer pool.
+            ScopedDatagramBuffer encodeBuffer(*datagramBuffers);
+            size_t encodedBodyLength = 0;
+            if (bodyLength > 1)
+                encodedBodyLength = ZeroEncodeToBuffer(encodeBuffer.Get(), std::min(bodyLength - 1, encodeBuffer.Size()), bodyData, bodyLength);
 
-            // If the encoded message would take more space than the non-coded, just send non-coded.
-            if (headerLength + encodedBodyLength >= message->BytesFilled()) 
+            if (encodedBodyLength == 0)
             {
                 data[0] &= ~NetFlagZeroCode;
             }
             else // Send out zerocoded, it's actually compressed something.
             {
                 data[0] |= NetFlagZeroCode;
-
-                std::vector<uint8_t> zeroCodedData;
-                zeroCodedData.resize(headerLength + encodedBodyLength, 0);
-                memcpy(&zeroCodedData[0], &data[0], headerLength);
-                ZeroEncode(&zeroCodedData[headerLength], encodedBodyLength, bodyData, bodyLength);
-                data = zeroCodedData;
+                memcpy(&data[headerLength], encodeBuffer.Get(), encodedBodyLength);
+                data.resize(headerLength + encodedBodyLength);
             }
         }
+    }
 
+    void NetMessageManager::SendOutboundMessage(NetOutMessage *message)
+    {
         SendProcessedMessage(message);
 
         // Push reliable messages to queue to wait ACK from the server.
         if (message->IsReliable())
             AddMessageToResendQueue(message);
         else
+        {
+            MutexLock lock(messagePoolMutex);
             unusedMessagePool.push_back(message);
+        }
     }
 
     void NetMessageManager::SendProcessedMessage(NetOutMessage *msg)
@@ -526,7 +951,7 @@ namespace ProtocolUtilities
 
         std::vector<uint8_t> &data = msg->GetData();
         assert(data.size() > 0);
-        connection->SendBytes(&data[0], data.size());
+        connection->QueueBytes(&data[0], data.size());
 
 #ifdef PROFILING
         sentDatagrams.InsertRecord(1.0);
@@ -534,16 +959,54 @@ namespace ProtocolUtilities
 #endif
 
         if (messageListener)
-            messageListener->OnNetworkMessageSent(msg);
+        {
+            // In threaded mode the listener is called on the main thread, with a copy, as the message may be acked and
+            // reused before the main thread gets to it.
+            if (sentMessageCopies)
+                QueueSentMessageCopy(msg);
+            else
+                messageListener->OnNetworkMessageSent(msg);
+        }
+    }
+
+    void NetMessageManager::QueueSentMessageCopy(const NetOutMessage *msg)
+    {
+        NetOutMessage *copy = 0;
+        {
+            MutexLock lock(messagePoolMutex);
+            if (unusedMessagePool.size() > 0)
+            {
+                copy = unusedMessagePool.front();
+                unusedMessagePool.pop_front();
+            }
+        }
+        if (!copy)
+            copy = new NetOutMessage();
+        *copy = *msg;
+
+        // The notifications are for debugging and stats only, so rather skip one than stall the network thread.
+        if (!sentMessageCopies->Push(copy))
+        {
+            MutexLock lock(messagePoolMutex);
+            unusedMessagePool.push_back(copy);
+        }
+    }
+
+    size_t NetMessageManager::GetNewSequenceNumber()
+    {
+        MutexLock lock(messagePoolMutex);
+        return sequenceNumber++;
     }
 
     void NetMessageManager::QueuePacketACK(uint32_t packetID)
     {
-        pendingACKs.insert(packetID);
+        pendingACKs.push_back(packetID);
     }
 
     void NetMessageManager::ClearMessagePoolMemory()
     {
+        MutexLock lock(messagePoolMutex);
+
         for(std::list<NetOutMessage*>::iterator iter = unusedMessagePool.begin(); iter != unusedMessagePool.end(); ++iter)
             delete *iter;
 
@@ -552,12 +1015,13 @@ namespace ProtocolUtilities
         for(std::list<NetOutMessage*>::iterator iter = usedMessagePool.begin(); iter != usedMessagePool.end(); ++iter)
             delete *iter;
 
-        for(MessageResendList::iterator iter = messageResendQueue.begin(); iter != messageResendQueue.end(); ++iter)
-            delete iter->second;
+        std::vector<NetOutMessage*> unacked;
+        resendQueue.Clear(unacked);
+        for(std::vector<NetOutMessage*>::iterator iter = unacked.begin(); iter != unacked.end(); ++iter)
+            delete *iter;
 
         unusedMessagePool.clear();
         usedMessagePool.clear();
-        messageResendQueue.clear();
     }
 
     ///\todo Have better delay method for pending ACKs, currently sends everything accumulated just over one frame
@@ -573,9 +1037,14 @@ namespace ProtocolUtilities
 
         static const size_t max_acks_in_msg = 100;
 
-        while (pendingACKs.size() > 0)
+        // The same packet may have been queued several times if the server resent it.
+        std::sort(pendingACKs.begin(), pendingACKs.end());
+        std::vector<uint32_t>::iterator i = pendingACKs.begin();
+        std::vector<uint32_t>::iterator end = std::unique(pendingACKs.begin(), pendingACKs.end());
+
+        while (i != end)
         {
-            size_t acks_to_send = pendingACKs.size();
+            size_t acks_to_send = end - i;
             if (acks_to_send > max_acks_in_msg)
                 acks_to_send = max_acks_in_msg;
 
@@ -583,7 +1052,6 @@ namespace ProtocolUtilities
             assert(m);
             m->SetVariableBlockCount(acks_to_send);
             
-            std::set<uint32_t>::iterator i = pendingACKs.begin();
             size_t added_acks = 0;
             
             while (added_acks < acks_to_send)
@@ -597,10 +1065,11 @@ namespace ProtocolUtilities
                 ++i;
             }
             
-            FinishMessage(m);
-            
-            pendingACKs.erase(pendingACKs.begin(), i);
+            FinishInternalMessage(m);
         }
+
+        // clear() keeps the capacity, so queuing acks doesn't allocate in the steady state.
+        pendingACKs.clear();
     }
 
     void NetMessageManager::ProcessPacketACK(NetInMessage *msg)
@@ -621,7 +1090,7 @@ namespace ProtocolUtilities
         NetOutMessage *m = StartNewMessage(RexNetMsgCompletePingCheck);
         assert(m);
         m->AddU8(pingId);
-        FinishMessage(m);
+        FinishInternalMessage(m);
     }
 
     void NetMessageManager::HandleCompletePingCheck(NetInMessage *msg)
@@ -640,105 +1109,142 @@ namespace ProtocolUtilities
         lastRoundTripTime = (double)(timeNow - it->second) / GetCurrentClockFreq() * 1000;
 
         const float alpha = 3.f/4.f;
-        smoothenedRoundTripTime = smoothenedRoundTripTime * alpha + (1.f - alpha) * lastRoundTripTime;
+        if (!roundTripTimeMeasured)
+        {
+            // Start from the first sample instead of the arbitrary default.
+            smoothenedRoundTripTime = lastRoundTripTime;
+            roundTripTimeVariance = lastRoundTripTime / 2.0;
+            roundTripTimeMeasured = true;
+        }
+        else
+        {
+            roundTripTimeVariance = roundTripTimeVariance * alpha + (1.f - alpha) * fabs(smoothenedRoundTripTime - lastRoundTripTime);
+            smoothenedRoundTripTime = smoothenedRoundTripTime * alpha + (1.f - alpha) * lastRoundTripTime;
+        }
+        UpdateRetransmitTimeout();
 
         pendingPings.erase(it);
     }
 
+    void NetMessageManager::UpdateRetransmitTimeout()
+    {
+        // As in TCP (RFC 6298): the smoothened round-trip time plus four times its deviation.
+        double timeout = smoothenedRoundTripTime + 4.0 * roundTripTimeVariance;
+        timeout = std::max(timeout, (double)cMinRetransmitTimeout);
+        timeout = std::min(timeout, (double)cMaxRetransmitTimeout);
+        retransmitTimeout = (uint32_t)timeout;
+    }
+
     void NetMessageManager::SendStartPingCheck(uint8_t id, uint32_t oldestUnacked)
     {
         NetOutMessage *m = StartNewMessage(RexNetMsgStartPingCheck);
         assert(m);
         m->AddU8(id);
         m->AddU32(oldestUnacked);
-        FinishMessage(m);
+        FinishInternalMessage(m);
     }
 
-    /// A unary find predicate that looks for a NetOutMessage that has the given desired sequence number in a resendqueue container.
-    class MsgSeqNumMatchPred
+    void NetMessageManager::AddMessageToResendQueue(NetOutMessage *msg)
     {
-    public:
-        MsgSeqNumMatchPred(uint32_t seqNum_):seqNum(seqNum_) {}
+        MutexLock lock(messagePoolMutex);
 
-        bool operator()(const std::pair<time_t, NetOutMessage*> &elem) const { return elem.second && elem.second->GetSequenceNumber() == seqNum; }
-    private:
-        uint32_t seqNum;
-    };
+        // The message might already be in the queue, if it has already been resent once due to a timeout.
+        // If the sequence numbers matched but these are different message structs, the new one is extraneous.
+        if (!resendQueue.Add(msg, CurrentTimeMsecs(), retransmitTimeout))
+            unusedMessagePool.push_back(msg);
+        RecycleDroppedMessages();
+    }
 
-    void NetMessageManager::AddMessageToResendQueue(NetOutMessage *msg)
+    void NetMessageManager::RecycleDroppedMessages()
     {
-        // Don't add this message to the queue, if it already exists in the queue, i.e. it has already been resent once due to a timeout.
-        MessageResendList::iterator it = std::find_if(messageResendQueue.begin(), messageResendQueue.end(), MsgSeqNumMatchPred(msg->GetSequenceNumber()));
-        if (it != messageResendQueue.end())
-        {
-            // If the sequence numbers matched but these are different message structs, add the message to unusedMessagePool, it's extraneous.
-            if (it->second != msg)
-                unusedMessagePool.push_back(msg);
-            return;
-        }
-
-        messageResendQueue.push_back(std::make_pair(time(0), msg));
+        droppedMessages.clear();
+        resendQueue.TakeDropped(droppedMessages);
+        unusedMessagePool.insert(unusedMessagePool.end(), droppedMessages.begin(), droppedMessages.end());
     }
 
     void NetMessageManager::RemoveMessageFromResendQueue(uint32_t packetID)
     {
-        MessageResendList::iterator it = std::find_if(messageResendQueue.begin(), messageResendQueue.end(), MsgSeqNumMatchPred(packetID));
+        MutexLock lock(messagePoolMutex);
 
-        if (it != messageResendQueue.end())
-        {
-            unusedMessagePool.push_back(it->second);
-            messageResendQueue.erase(it);
-        }
+        NetOutMessage *msg = resendQueue.Remove(packetID);
+        if (msg)
+            unusedMessagePool.push_back(msg);
     }
 
     void NetMessageManager::ProcessResendQueue()
     {
         PROFILE(NetMessageManager_ProcessResendQueue);
-        const int cTimeoutSeconds = 5;
 
-        const time_t timeNow = time(0);
-        for(MessageResendList::iterator it = messageResendQueue.begin(); it != messageResendQueue.end(); ++it)
+        const uint64_t timeNow = CurrentTimeMsecs();
         {
-            if (timeNow - it->first >= cTimeoutSeconds)
-            {
-                it->first = timeNow;
-                it->second->MarkResend();
-                SendProcessedMessage(it->second);
-                //std::cout << "Resending packet " << it->second->GetSequenceNumber() << std::endl;
+            MutexLock lock(messagePoolMutex);
+            // Each resend doubles the timeout of the message, so a congested link isn't flooded further.
+            while(NetOutMessage *msg = resendQueue.PopExpired(timeNow, cMaxRetransmitTimeout))
+                expiredMessages.push_back(msg);
+            numResentPackets += expiredMessages.size();
+            RecycleDroppedMessages();
+        }
+
+        // Send without holding the lock, as the listener may start new messages. The messages stay in the resend queue,
+        // and only this thread, which owns the connection, removes messages from it when processing acks.
+        for(size_t i = 0; i < expiredMessages.size(); ++i)
+        {
+            NetOutMessage *msg = expiredMessages[i];
+            msg->MarkResend();
+            SendProcessedMessage(msg);
+            //std::cout << "Resending packet " << msg->GetSequenceNumber() << std::endl;
 #ifdef PROFILING
-                resentPackets.InsertRecord(1.0);
+            resentPackets.InsertRecord(1.0);
 #endif
-            }
         }
+        expiredMessages.clear();
     }
+
     void NetMessageManager::ManagePingSends()
     {
         const double interval = 2.0;
         if (pingSendTimer.elapsed() >= interval)
         {
             ++pingId;
-            uint32_t oldestUnacked = pendingACKs.empty() ? 0 : *pendingACKs.begin();
+            uint32_t oldestUnacked = OldestUnackedSequenceNumber();
             pendingPings[pingId] = GetCurrentClockTime();
             SendStartPingCheck(pingId, oldestUnacked);
             pingSendTimer.restart();
         }
     }
 
+    size_t NetMessageManager::NumInboundHeapAllocations() const
+    {
+        return datagramBuffers->NumHeapAllocations() + decodeBuffers->NumHeapAllocations() + inboundHeapAllocations;
+    }
+
     int NetMessageManager::NumUnackedReliablePackets() const
     {
-        return messageResendQueue.size();
+        MutexLock lock(messagePoolMutex);
+        return resendQueue.Size();
     }
 
     int NetMessageManager::NumBytesInUnackedReliablePackets() const
     {
-        size_t bytes = 0;
-        MessageResendList::const_iterator it = messageResendQueue.begin();
-        while(it != messageResendQueue.end())
-        {
-            bytes += it->second->BytesFilled();
-            ++it;
-        }
-        return bytes;
+        MutexLock lock(messagePoolMutex);
+        return resendQueue.NumBytes();
+    }
+
+    uint32_t NetMessageManager::OldestUnackedSequenceNumber() const
+    {
+        MutexLock lock(messagePoolMutex);
+        return resendQueue.OldestSequenceNumber();
+    }
+
+    size_t NetMessageManager::NumResentPackets() const
+    {
+        MutexLock lock(messagePoolMutex);
+        return numResentPackets;
     }
-}
 
+    size_t NetMessageManager::NumDroppedReliablePackets() const
+    {
+        MutexLock lock(messagePoolMutex);
+        return resendQueue.NumDropped();
+    }
+}
@@ -4,14 +4,18 @@
 #define incl_ProtocolUtilities_NetMessageManager_h
 
 #include <list>
-#include <set>
+#include <vector>
 
 #include <boost/shared_ptr.hpp>
 
 #include "NetMessage.h"
 #include "EventHistory.h"
+#include "LockFreeRingBuffer.h"
+#include "ResendQueue.h"
+#include "SequenceNumberWindow.h"
 
 #include "RexTypes.h"
+#include "CoreThread.h"
 
 namespace ProtocolUtilities
 {
@@ -19,7 +23,10 @@ namespace ProtocolUtilities
     class NetInMessage;
     class NetMessageList;
     class NetworkConnection;
+    class ReplayNetworkConnection;
     class INetMessageListener;
+    class DatagramBufferPool;
+    class PacketCaptureWriter;
 
     /// Manages both in- and outbound UDP communication. Implements a packet queue, packet sequence numbering, ACKing,
     /// pinging, and reliable communications. reX-protocol specific. Used internally by OpenSimProtocolModule, external
@@ -34,12 +41,36 @@ namespace ProtocolUtilities
         /// Destructor. Clears message pool memory.
         ~NetMessageManager();
 
-        /// Connects to the given server.
+        /// Connects to the given server. If threaded mode is enabled, also starts the network thread.
         bool ConnectTo(const char *serverAddress, int port);
 
+        /** Stands in for a server by replaying a packet capture made with StartCapture(). Everything sent is discarded.
+            Otherwise behaves as ConnectTo(), so the replayed traffic goes through the whole inbound path and to the listener.
+            @param filename The packet capture file.
+            @param realTimePacing If true, the datagrams are delivered at the pace they were captured at, otherwise as fast as possible.
+            @return False if the capture could not be read. */
+        bool ConnectToReplay(const std::string &filename, bool realTimePacing);
+
+        /// @return True if connected to a replay and all the datagrams of the capture have been received.
+        bool ReplayFinished() const;
+
         /// Disconnets from the current server.
         void Disconnect();
 
+        /** Starts writing all the raw inbound datagrams with their receive times to a packet capture file. Can be
+            called whether connected or not. Replaces a capture in progress. The capture is stopped if writing fails.
+            @return False if the file could not be opened. */
+        bool StartCapture(const std::string &filename);
+
+        /// Stops the capture in progress and closes the capture file.
+        void StopCapture();
+
+        /// @return True if a capture is in progress.
+        bool IsCapturing() const;
+
+        /// @return The number of datagrams written to the capture in progress.
+        size_t NumCapturedDatagrams() const;
+
         /// To start building a new outbound message, call this.
         /// @return An empty message holder where the message can be built.
         NetOutMessage *StartNewMessage(NetMsgID msgId);
@@ -48,9 +79,32 @@ namespace ProtocolUtilities
         void FinishMessage(NetOutMessage *message);
 
         /// Reads in all inbound UDP messages and processes them forward to the application through the listener.
-        /// Checks and resends any timed out reliable outbound messages. This could be moved into a separate thread, but not that timing specific so not necessary atm.
+        /// Checks and resends any timed out reliable outbound messages.
+        /// In threaded mode only passes the messages already parsed by the network thread to the listener.
         void ProcessMessages();
 
+        /** Enables or disables threaded mode. In threaded mode a separate network thread owns the socket and does
+            sequence tracking, ACKing, zero-decoding, pinging and resending. Inbound messages are handed over to the main
+            thread through a lock-free queue and passed to the listener from ProcessMessages(), outbound messages finished
+            with FinishMessage() are handed to the network thread the same way, and numbered and encoded there. Sent
+            messages are passed to the listener as copies from ProcessMessages().
+            Takes effect on the next ConnectTo().
+            @param enable Whether to use a separate network thread.
+            @param queueSize Capacity of the inbound and outbound message queues. */
+        void SetThreadedMode(bool enable, size_t queueSize = 4096);
+
+        /// @return True if threaded mode is enabled.
+        bool IsThreadedMode() const { return threaded; }
+
+        /** Enables batched socket I/O. Inbound datagrams are read up to batchSize at a time, and outbound datagrams
+            are queued and flushed once per frame, both with a single system call per batch where the platform supports it.
+            Takes effect on the next ConnectTo().
+            @param batchSize The maximum number of datagrams per batch, or 0 to disable batching. */
+        void SetBatchedIO(size_t batchSize);
+
+        /// @return The number of socket system calls made on the current connection.
+        size_t NumSocketSyscalls() const;
+
         /// Interprets the given byte stream as a message and dumps it contents out to the log. Useful only for diagnostics and such.
         void DumpNetworkMessage(NetMsgID id, NetInMessage *msg);
 
@@ -103,24 +157,88 @@ namespace ProtocolUtilities
         /// Smoothened round-trip time in milliseconds.
         double smoothenedRoundTripTime;
 
+        /// Smoothened mean deviation of the round-trip time in milliseconds.
+        double roundTripTimeVariance;
+
         /// How much time has elapsed in milliseconds since we've heard from the server last time.
         double lastHeardSince;
 
         /// Returns number of unacked reliable packets.
         int NumUnackedReliablePackets() const;
 
+        /// Returns the number of heap allocations the inbound datagram path has made: receive and decode buffers that
+        /// didn't fit in the pools, and message copies handed to the main thread in threaded mode.
+        /// Stays constant in the steady state.
+        size_t NumInboundHeapAllocations() const;
+
         /// Returns number of bytes in unacked reliable packets.
         int NumBytesInUnackedReliablePackets() const;
 
+        /// Returns the sequence number of the oldest unacked reliable packet, or 0 if everything has been acked.
+        uint32_t OldestUnackedSequenceNumber() const;
+
+        /// Returns the number of reliable packets that have been resent after a timeout.
+        size_t NumResentPackets() const;
+
+        /// Returns the number of reliable packets given up on without an ack, after too many resends or to keep the
+        /// unacked window bounded.
+        size_t NumDroppedReliablePackets() const;
+
+        /// Returns the number of duplicate inbound packets that have been dropped.
+        size_t NumDuplicatesReceived() const { return receivedSequenceNumbers.NumDuplicates(); }
+
+        /// Returns the number of inbound packets estimated lost, i.e. not received by the time 1024 newer packets were.
+        size_t NumLostPacketsEstimate() const { return receivedSequenceNumbers.NumLost(); }
+
+        /// Returns the current retransmit timeout of reliable packets in milliseconds. Adapts to the measured round-trip time.
+        uint32_t RetransmitTimeout() const { return retransmitTimeout; }
+
     private:
         NetMessageManager(const NetMessageManager &);
         void operator=(const NetMessageManager &);
 
+        /// Entry point of the network thread.
+        void NetworkThreadMain();
+
+        /// Stops and joins the network thread, if running.
+        void StopNetworkThread();
+
+        /// @return True if the network thread is running and owns the connection.
+        bool NetworkThreadActive() const { return networkThreadActive; }
+
+        /// Configures a new connection and starts the network thread in threaded mode.
+        void StartConnection(boost::shared_ptr<NetworkConnection> newConnection);
+
+        /// Polls the socket until it is empty, the time budget is used or the inbound queue is full.
+        void ReceivePackets(double maxProcessTime);
+
+        /// Updates the last heard time and processes a single datagram read from the socket.
+        void HandleReceivedDatagram(uint8_t *data, size_t numBytes);
+
+        /// Passes a parsed inbound message to the listener, or in threaded mode queues it for the main thread.
+        void DeliverInboundMessage(NetInMessage &msg);
+
+        /// Removes the given message from the used message pool.
+        void ReleaseFromUsedPool(NetOutMessage *message);
+
+        /// Assigns a sequence number, zero-encodes and sends a message finished by the application, and puts it to the resend queue if reliable.
+        /// Called by the thread that owns the connection only, so that the sequence numbers are sent in order.
+        void ProcessOutboundMessage(NetOutMessage *message);
+
+        /// Assigns a sequence number to a finished message and zero-encodes it, putting it to its final binary format.
+        void PrepareOutboundMessage(NetOutMessage *message);
+
+        /// Sends a prepared message, and puts it to the resend queue if reliable.
+        void SendOutboundMessage(NetOutMessage *message);
+
+        /// Finishes a message that the manager itself has built (ACKs and pings). Always sent from the thread that owns the connection.
+        void FinishInternalMessage(NetOutMessage *message);
+
         /// Deallocates all memory used for outbound message structs.
         void ClearMessagePoolMemory();
 
-        /// @return A new sequence number for outbound UDP messages.
-        size_t GetNewSequenceNumber() { return sequenceNumber++; }
+        /// @return A new sequence number for outbound UDP messages. Only the thread that owns the connection takes sequence numbers.
+        size_t GetNewSequenceNumber();
 
         /// Queues acking the packet with the given packetID.
         void QueuePacketACK(uint32_t packetID);
@@ -129,7 +247,12 @@ namespace ProtocolUtilities
         void SendPendingACKs();
 
         /// Processes a single raw datagram received from the network.
-        void HandleInboundBytes(std::vector<uint8_t> &data);
+        /// @param data The datagram. The message is parsed in place, so the contents may be modified.
+        /// @param numBytes The size of the datagram.
+        void HandleInboundBytes(uint8_t *data, size_t numBytes);
+
+        /// Processes the acks appended to the end of a datagram.
+        void ProcessAppendedAcks(const uint8_t *data, size_t numBytes);
 
         /// Processes a received PacketAck message.
         void ProcessPacketACK(NetInMessage *msg);
@@ -156,6 +279,9 @@ namespace ProtocolUtilities
         /// Called to send out a message that is already binary-mangled to the proper final format. (packet number, zerocoding, flags, ...)
         void SendProcessedMessage(NetOutMessage *msg);
 
+        /// In threaded mode, passes a copy of a sent message to the main thread for the listener.
+        void QueueSentMessageCopy(const NetOutMessage *msg);
+
         /// Adds message to the queue of reliable outbound messages.
         void AddMessageToResendQueue(NetOutMessage *msg);
 
@@ -163,11 +289,17 @@ namespace ProtocolUtilities
         void RemoveMessageFromResendQueue(uint32_t packetID);
 
         /// @return True, if the resend queue is empty, false otherwise.
-        bool ResendQueueIsEmpty() const { return messageResendQueue.empty(); }
+        bool ResendQueueIsEmpty() const { return resendQueue.IsEmpty(); }
 
-        /// Checks each reliable message in outbound queue and resends any of the if an Ack was not received within a time-out period.
+        /// Resends the reliable messages whose retransmit timeout has expired without an Ack.
         void ProcessResendQueue();
 
+        /// Returns the messages the resend queue has given up on to the unused pool. Call with the pool mutex held.
+        void RecycleDroppedMessages();
+
+        /// Recalculates the retransmit timeout from the smoothened round-trip time and its variance.
+        void UpdateRetransmitTimeout();
+
         /// Manages ping sending.
         void ManagePingSends();
 
@@ -180,19 +312,41 @@ namespace ProtocolUtilities
         /// List of messages this manager can handle.
         boost::shared_ptr<NetMessageList> messageList;
 
+        /// Buffers for receiving datagrams.
+        boost::shared_ptr<DatagramBufferPool> datagramBuffers;
+
+        /// Buffers for zero-decoding received messages.
+        boost::shared_ptr<DatagramBufferPool> decodeBuffers;
+
+        /// Heap allocations made by the inbound path outside the buffer pools.
+        size_t inboundHeapAllocations;
+
         /// A pool of allocated unused NetOutMessage structures. Used to avoid unnecessary allocations at runtime.
         std::list<NetOutMessage*> unusedMessagePool;
 
         /// A pool of NetOutMessage structures, which have been handed out to the application and are currently being built.
         std::list<NetOutMessage*> usedMessagePool;
 
-        /// Packet acks pending to be sent
-        std::set<uint32_t> pendingACKs;
+        /// Packet acks pending to be sent. May contain duplicates, which are dropped when the acks are sent.
+        std::vector<uint32_t> pendingACKs;
 
-        typedef std::list<std::pair<time_t, NetOutMessage*> > MessageResendList;
-        /// A pool of NetOutMessages that are in the outbound queue. Need to keep the unacked reliable messages in
-        /// memory for possible resending.
-        MessageResendList messageResendQueue;
+        /// The unacked reliable messages, kept in memory for possible resending.
+        ResendQueue resendQueue;
+
+        /// The number of reliable messages resent after a timeout.
+        size_t numResentPackets;
+
+        /// The expired messages of the resend queue, collected under the lock and resent after releasing it.
+        std::vector<NetOutMessage*> expiredMessages;
+
+        /// Scratch space for the messages dropped by the resend queue.
+        std::vector<NetOutMessage*> droppedMessages;
+
+        /// The current retransmit timeout in milliseconds.
+        volatile uint32_t retransmitTimeout;
+
+        /// True after the first round-trip time measurement.
+        bool roundTripTimeMeasured;
 
         /// A running sequence number for outbound messages.
         size_t sequenceNumber;
@@ -201,8 +355,8 @@ namespace ProtocolUtilities
         /// Note that this can go up and down if we receive data out of order (or if we receive spoofed data)
         size_t lastReceivedSequenceNumber;
 
-        /// A set of received messages' sequence numbers.
-        std::set<uint32_t> receivedSequenceNumbers;
+        /// The recently received sequence numbers, for pruning duplicates.
+        SequenceNumberWindow receivedSequenceNumbers;
 
         /// Timer for sending pings.
         boost::timer pingSendTimer;
@@ -215,6 +369,55 @@ namespace ProtocolUtilities
 
         /// How much time has elapsed in CPU ticks since we've heard from the server last time.
         tick_t lastHeardSinceTick;
+
+        /// Guards the message pools, the resend queue and the outbound sequence number, which are shared between the main
+        /// and the network thread in threaded mode. Never held while calling the listener.
+        mutable Mutex messagePoolMutex;
+
+        /// If true, a network thread is started on the next ConnectTo().
+        bool threaded;
+
+        /// Capacity of the inbound and outbound queues in threaded mode.
+        size_t threadedQueueSize;
+
+        /// The maximum number of datagrams per batched socket call, or 0 if batching is disabled.
+        size_t ioBatchSize;
+
+        /// Set while the network thread is running.
+        volatile bool networkThreadActive;
+
+        /// Keep running-flag of the network thread.
+        volatile bool keepNetworkThreadRunning;
+
+        /// The network thread.
+        Thread networkThread;
+
+        /// Messages parsed by the network thread, waiting to be passed to the listener on the main thread.
+        boost::shared_ptr<LockFreeRingBuffer<NetInMessage*> > inboundQueue;
+
+        /// Messages the main thread has handled, returned to the network thread for reuse.
+        boost::shared_ptr<LockFreeRingBuffer<NetInMessage*> > recycledInboundMessages;
+
+        /// Messages finished by the application, waiting to be sent by the network thread.
+        boost::shared_ptr<LockFreeRingBuffer<NetOutMessage*> > outboundQueue;
+
+        /// Copies of the messages sent by the network thread, waiting to be passed to the listener on the main thread.
+        boost::shared_ptr<LockFreeRingBuffer<NetOutMessage*> > sentMessageCopies;
+
+        /// Guards networkError.
+        Mutex networkErrorMutex;
+
+        /// The packet capture in progress, or null.
+        boost::shared_ptr<PacketCaptureWriter> capture;
+
+        /// Guards capture, which is written to by the network thread in threaded mode.
+        mutable Mutex captureMutex;
+
+        /// The current connection if it is a replay, or null.
+        boost::shared_ptr<ReplayNetworkConnection> replayConnection;
+
+        /// The error message of a network exception caught in the network thread, rethrown on the main thread.
+        std::string networkError;
     };
 }
 
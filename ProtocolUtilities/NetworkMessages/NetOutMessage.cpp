@@ -43,6 +43,17 @@ namespace ProtocolUtilities
         blockQuantityCounter = rhs.blockQuantityCounter;
     }
 
+    void NetOutMessage::operator=(const NetOutMessage &rhs)
+    {
+        messageInfo = rhs.messageInfo;
+        messageData = rhs.messageData;
+        bytesFilled = rhs.bytesFilled;
+        sequenceNumber = rhs.sequenceNumber;
+        currentBlock = rhs.currentBlock;
+        currentVariable = rhs.currentVariable;
+        blockQuantityCounter = rhs.blockQuantityCounter;
+    }
+
     void NetOutMessage::AddU8(uint8_t value)
     {
         if (CheckNextVariable() != NetVarU8)
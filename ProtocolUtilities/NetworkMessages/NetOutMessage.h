@@ -108,6 +108,7 @@ namespace ProtocolUtilities
         void SetMessageInfo(const NetMessageInfo *info);
 
     private: // friend-public:
+        /// Copies the contents of a message, reusing the data buffer. Used to pass sent messages across threads.
         void operator=(const NetOutMessage &);
 
         // NetMessageManager manages the internal header fields of the message, but this can't all be done ctor-time.
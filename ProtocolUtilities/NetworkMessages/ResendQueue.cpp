@@ -0,0 +1,241 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+#include "StableHeaders.h"
+
+#include "ResendQueue.h"
+#include "NetOutMessage.h"
+
+namespace ProtocolUtilities
+{
+
+/// The number of one millisecond buckets in the timer wheel. Must be a power of two.
+static const size_t cWheelSize = 1024;
+
+ResendQueue::ResendQueue(size_t initialCapacity, size_t maxCapacity_, uint32_t maxResends_) :
+    maxCapacity(std::max<size_t>(maxCapacity_, 2)),
+    maxResends(maxResends_),
+    numDropped(0),
+    wheel(cWheelSize, -1),
+    windowStart(0),
+    windowEnd(0),
+    numMessages(0),
+    numBytes(0),
+    wheelTime(0)
+{
+    size_t size = 2;
+    while(size < std::min(initialCapacity, maxCapacity))
+        size <<= 1;
+    slots.resize(size);
+}
+
+bool ResendQueue::Add(NetOutMessage *msg, uint64_t nowMsecs, uint32_t timeoutMsecs)
+{
+    assert(msg);
+    const uint32_t seqNum = msg->GetSequenceNumber();
+
+    if (numMessages == 0)
+    {
+        // Nothing is scheduled, so the wheel can skip directly to the present.
+        windowStart = seqNum;
+        windowEnd = seqNum + 1;
+        wheelTime = nowMsecs;
+    }
+    else
+    {
+        const Slot &existing = slots[seqNum & (slots.size() - 1)];
+        if (existing.msg && existing.seqNum == seqNum)
+            return false;
+
+        // A message too old to fit in the window is given up on at once.
+        if ((int32_t)(seqNum - windowStart) < 0 && (uint32_t)(windowEnd - seqNum) > maxCapacity)
+            return false;
+
+        if ((int32_t)(seqNum - windowStart) < 0)
+            windowStart = seqNum;
+        if ((int32_t)(seqNum + 1 - windowEnd) > 0)
+            windowEnd = seqNum + 1;
+        DropOldest();
+        if (numMessages == 0)
+            windowStart = seqNum;
+        Grow();
+    }
+
+    const int index = (int)(seqNum & (slots.size() - 1));
+    Slot &slot = slots[index];
+    assert(slot.msg == 0);
+    slot.msg = msg;
+    slot.seqNum = seqNum;
+    slot.timeoutMsecs = std::max<uint32_t>(timeoutMsecs, 1);
+    slot.dueMsecs = std::max(nowMsecs, wheelTime) + slot.timeoutMsecs;
+    Schedule(index);
+
+    ++numMessages;
+    numBytes += msg->BytesFilled();
+    return true;
+}
+
+NetOutMessage *ResendQueue::Remove(uint32_t seqNum)
+{
+    const int index = (int)(seqNum & (slots.size() - 1));
+    Slot &slot = slots[index];
+    if (!slot.msg || slot.seqNum != seqNum)
+        return 0;
+
+    return Release(index);
+}
+
+NetOutMessage *ResendQueue::Release(int index)
+{
+    const size_t mask = slots.size() - 1;
+    Slot &slot = slots[index];
+    NetOutMessage *msg = slot.msg;
+    Unschedule(index);
+    slot.msg = 0;
+    slot.numResends = 0;
+    --numMessages;
+    numBytes -= msg->BytesFilled();
+
+    // Advance the window past the acked messages. Each sequence number is passed over only once.
+    if (slot.seqNum == windowStart && numMessages > 0)
+        while(!slots[windowStart & mask].msg || slots[windowStart & mask].seqNum != windowStart)
+            ++windowStart;
+
+    return msg;
+}
+
+void ResendQueue::Drop(int index)
+{
+    dropped.push_back(Release(index));
+    ++numDropped;
+}
+
+void ResendQueue::DropOldest()
+{
+    // All the messages already in the queue fit in the ring, so the oldest ones are found by the current mask.
+    const size_t mask = slots.size() - 1;
+    while((uint32_t)(windowEnd - windowStart) > maxCapacity && numMessages > 0)
+    {
+        const int index = (int)(windowStart & mask);
+        if (slots[index].msg && slots[index].seqNum == windowStart)
+            Drop(index); // Advances the window to the next message.
+        else
+            ++windowStart;
+    }
+}
+
+NetOutMessage *ResendQueue::PopExpired(uint64_t nowMsecs, uint32_t maxTimeoutMsecs)
+{
+    if (numMessages == 0)
+    {
+        wheelTime = std::max(wheelTime, nowMsecs);
+        return 0;
+    }
+    if (nowMsecs < wheelTime)
+        return 0;
+
+    // If more time than one revolution of the wheel has passed, each bucket needs to be checked only once.
+    if (nowMsecs - wheelTime >= cWheelSize)
+        wheelTime = nowMsecs - cWheelSize + 1;
+
+    for(;;)
+    {
+        // The bucket may also contain messages due on the later revolutions of the wheel. Leave those be.
+        for(int i = wheel[wheelTime & (cWheelSize - 1)]; i != -1;)
+        {
+            const int next = slots[i].next;
+            if (slots[i].dueMsecs <= nowMsecs)
+            {
+                Slot &slot = slots[i];
+                // Give up on a message that has been resent too many times, so that the window can advance past it.
+                if (slot.numResends >= maxResends)
+                {
+                    Drop(i);
+                    if (numMessages == 0)
+                        return 0;
+                    i = next;
+                    continue;
+                }
+                Unschedule(i);
+                ++slot.numResends;
+                slot.timeoutMsecs = std::min(slot.timeoutMsecs * 2, std::max<uint32_t>(maxTimeoutMsecs, 1));
+                slot.dueMsecs = nowMsecs + slot.timeoutMsecs;
+                Schedule(i);
+                return slot.msg;
+            }
+            i = next;
+        }
+
+        if (wheelTime == nowMsecs)
+            return 0;
+        ++wheelTime;
+    }
+}
+
+void ResendQueue::Clear(std::vector<NetOutMessage*> &messages)
+{
+    for(size_t i = 0; i < slots.size(); ++i)
+        if (slots[i].msg)
+            messages.push_back(slots[i].msg);
+
+    messages.insert(messages.end(), dropped.begin(), dropped.end());
+    dropped.clear();
+
+    std::fill(slots.begin(), slots.end(), Slot());
+    std::fill(wheel.begin(), wheel.end(), -1);
+    numMessages = 0;
+    numBytes = 0;
+}
+
+void ResendQueue::TakeDropped(std::vector<NetOutMessage*> &messages)
+{
+    messages.insert(messages.end(), dropped.begin(), dropped.end());
+    dropped.clear();
+}
+
+void ResendQueue::Grow()
+{
+    size_t newSize = slots.size();
+    while((uint32_t)(windowEnd - windowStart) > newSize)
+        newSize <<= 1;
+    if (newSize == slots.size())
+        return;
+
+    // The slot indices change, so rebuild the wheel as well.
+    std::vector<Slot> oldSlots(newSize);
+    oldSlots.swap(slots);
+    std::fill(wheel.begin(), wheel.end(), -1);
+
+    const size_t mask = newSize - 1;
+    for(size_t i = 0; i < oldSlots.size(); ++i)
+        if (oldSlots[i].msg)
+        {
+            const int index = (int)(oldSlots[i].seqNum & mask);
+            slots[index] = oldSlots[i];
+            Schedule(index);
+        }
+}
+
+void ResendQueue::Schedule(int index)
+{
+    Slot &slot = slots[index];
+    int &head = wheel[slot.dueMsecs & (cWheelSize - 1)];
+    slot.prev = -1;
+    slot.next = head;
+    if (head != -1)
+        slots[head].prev = index;
+    head = index;
+}
+
+void ResendQueue::Unschedule(int index)
+{
+    Slot &slot = slots[index];
+    if (slot.prev != -1)
+        slots[slot.prev].next = slot.next;
+    else
+        wheel[slot.dueMsecs & (cWheelSize - 1)] = slot.next;
+    if (slot.next != -1)
+        slots[slot.next].prev = slot.prev;
+    slot.prev = -1;
+    slot.next = -1;
+}
+
+}
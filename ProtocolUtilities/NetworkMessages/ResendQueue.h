@@ -0,0 +1,166 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+#ifndef incl_ProtocolUtilities_ResendQueue_h
+#define incl_ProtocolUtilities_ResendQueue_h
+
+#include <vector>
+
+#include "RexTypes.h"
+
+namespace ProtocolUtilities
+{
+    class NetOutMessage;
+
+    /** Tracks the reliable outbound messages that have not been acked yet.
+        The messages are stored in a ring indexed by their sequence number, so adding and removing a message is O(1).
+        The resend timeouts are kept in a hashed timer wheel of one millisecond buckets, so finding the expired
+        messages only looks at the buckets that have passed since the previous check.
+        The ring grows if the unacked window becomes wider than its capacity, otherwise nothing is allocated.
+        The ring never grows past its maximum capacity: the oldest messages are dropped instead, as are messages that have
+        been resent too many times, so that a single message that is never acked doesn't hold the window open.
+        The dropped messages are handed back to the owner with TakeDropped().
+        Not thread-safe; NetMessageManager guards it with its message pool mutex.
+        \ingroup OpenSimProtocolClient */
+    class ResendQueue
+    {
+    public:
+        /// Constructor.
+        /** @param initialCapacity The initial width of the unacked window, rounded up to the next power of two.
+            @param maxCapacity The maximum width of the unacked window.
+            @param maxResends How many times a message is resent before it is given up on.
+        */
+        explicit ResendQueue(size_t initialCapacity = 1024, size_t maxCapacity = 65536, uint32_t maxResends = 10);
+
+        /// Adds a message to the queue. The message must have its sequence number set.
+        /** @param msg The message.
+            @param nowMsecs The current time, in milliseconds.
+            @param timeoutMsecs How long to wait for an ack before the message is resent.
+            @return False if a message with the same sequence number is already in the queue, or if the message is older
+                than the maximum window allows. In that case the message is not added. Adding may drop the oldest messages.
+        */
+        bool Add(NetOutMessage *msg, uint64_t nowMsecs, uint32_t timeoutMsecs);
+
+        /// Removes the message with the given sequence number from the queue.
+        /** @return The removed message, or 0 if there was no message with that sequence number.
+        */
+        NetOutMessage *Remove(uint32_t seqNum);
+
+        /// Finds a message whose resend timeout has expired. The message stays in the queue, and is rescheduled
+        /// to expire again after twice its previous timeout, but no longer than maxTimeoutMsecs.
+        /// Expired messages that have already been resent the maximum number of times are dropped instead.
+        /** @param nowMsecs The current time, in milliseconds. Must not decrease between calls.
+            @return The expired message, or 0 if there are no more expired messages.
+        */
+        NetOutMessage *PopExpired(uint64_t nowMsecs, uint32_t maxTimeoutMsecs);
+
+        /// Removes all the messages from the queue.
+        /** @param messages [out] Receives the removed messages, so that the caller can free them.
+        */
+        void Clear(std::vector<NetOutMessage*> &messages);
+
+        /// Hands over the messages dropped since the previous call.
+        /** @param messages [out] Receives the dropped messages, so that the caller can free them.
+        */
+        void TakeDropped(std::vector<NetOutMessage*> &messages);
+
+        /// @return The total number of messages dropped without an ack.
+        size_t NumDropped() const { return numDropped; }
+
+        /// @return The number of messages in the queue.
+        size_t Size() const { return numMessages; }
+
+        /// @return True if the queue is empty.
+        bool IsEmpty() const { return numMessages == 0; }
+
+        /// @return The total number of bytes in the messages in the queue.
+        size_t NumBytes() const { return numBytes; }
+
+        /// @return The sequence number of the oldest message in the queue, or 0 if the queue is empty.
+        uint32_t OldestSequenceNumber() const { return numMessages > 0 ? windowStart : 0; }
+
+        /// @return The number of sequence numbers the ring can hold before it has to grow.
+        size_t Capacity() const { return slots.size(); }
+
+    private:
+        ResendQueue(const ResendQueue &);
+        void operator=(const ResendQueue &);
+
+        /// A ring slot for one unacked message.
+        struct Slot
+        {
+            Slot() : msg(0), seqNum(0), dueMsecs(0), timeoutMsecs(0), numResends(0), prev(-1), next(-1) {}
+
+            /// The message, or 0 if the slot is free.
+            NetOutMessage *msg;
+
+            /// The sequence number of the message.
+            uint32_t seqNum;
+
+            /// When the message is to be resent, in milliseconds.
+            uint64_t dueMsecs;
+
+            /// The current resend timeout of the message.
+            uint32_t timeoutMsecs;
+
+            /// How many times the message has been resent.
+            uint32_t numResends;
+
+            /// The neighbouring slots in the same timer wheel bucket, or -1.
+            int prev;
+            int next;
+        };
+
+        /// Doubles the capacity of the ring until the whole window fits in it.
+        void Grow();
+
+        /// Drops the oldest messages until the window is no wider than the maximum capacity.
+        void DropOldest();
+
+        /// Frees a slot and advances the window past it if it was the oldest.
+        /// @return The message of the slot.
+        NetOutMessage *Release(int index);
+
+        /// Frees a slot and moves its message to the dropped messages.
+        void Drop(int index);
+
+        /// Links the slot to the timer wheel bucket of its due time.
+        void Schedule(int slot);
+
+        /// Unlinks the slot from its timer wheel bucket.
+        void Unschedule(int slot);
+
+        /// The slots, indexed by sequence number modulo the size. The size is always a power of two.
+        std::vector<Slot> slots;
+
+        /// The messages dropped and not yet taken by the owner.
+        std::vector<NetOutMessage*> dropped;
+
+        /// The maximum width of the window.
+        size_t maxCapacity;
+
+        /// How many times a message is resent before it is dropped.
+        uint32_t maxResends;
+
+        /// The total number of dropped messages.
+        size_t numDropped;
+
+        /// The heads of the timer wheel bucket lists, indexed by due time in milliseconds modulo the size.
+        std::vector<int> wheel;
+
+        /// The sequence number of the oldest message in the queue.
+        uint32_t windowStart;
+
+        /// One past the sequence number of the newest message in the queue.
+        uint32_t windowEnd;
+
+        /// The number of messages in the queue.
+        size_t numMessages;
+
+        /// The number of bytes in the messages in the queue.
+        size_t numBytes;
+
+        /// The time up to which the timer wheel has been checked, in milliseconds.
+        uint64_t wheelTime;
+    };
+}
+
+#endif // incl_ProtocolUtilities_ResendQueue_h
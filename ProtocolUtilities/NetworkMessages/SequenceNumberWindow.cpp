@@ -0,0 +1,142 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+#include "StableHeaders.h"
+
+#include "SequenceNumberWindow.h"
+
+namespace ProtocolUtilities
+{
+
+/// How many window sizes a sequence number may be behind the window before the window is anchored anew.
+static const size_t cResyncWindows = 64;
+
+SequenceNumberWindow::SequenceNumberWindow(size_t size) :
+    newest(0),
+    pendingLost(0),
+    anchor(0),
+    started(false),
+    numDuplicates(0),
+    numLost(0),
+    numTooOld(0),
+    numResyncs(0)
+{
+    size_t numWords = 1;
+    while(numWords * 32 < size)
+        numWords <<= 1;
+    bits.resize(numWords, 0);
+}
+
+SequenceNumberWindow::InsertResult SequenceNumberWindow::Insert(uint32_t seqNum)
+{
+    if (!started)
+    {
+        Reset(seqNum);
+        started = true;
+        return SeqNew;
+    }
+
+    const int32_t distance = (int32_t)(seqNum - newest);
+    if (distance > 0)
+    {
+        // Landing in the window confirms a preceding jump. Counts before Advance(), which may start a new jump.
+        if ((uint32_t)distance < Size())
+            numLost += pendingLost;
+        pendingLost = 0;
+        Advance(seqNum);
+        bits[BitWord(seqNum)] |= BitMask(seqNum);
+        return SeqNew;
+    }
+
+    const uint32_t behind = (uint32_t)(-distance);
+    if (behind >= Size())
+    {
+        // Traffic from before the jump carries on, so the jump was bogus.
+        pendingLost = 0;
+        if (behind >= Size() * cResyncWindows)
+        {
+            ++numResyncs;
+            Reset(seqNum);
+            return SeqNew;
+        }
+        ++numTooOld;
+        return SeqTooOld;
+    }
+
+    numLost += pendingLost;
+    pendingLost = 0;
+
+    if (TestBit(seqNum))
+    {
+        ++numDuplicates;
+        return SeqDuplicate;
+    }
+
+    bits[BitWord(seqNum)] |= BitMask(seqNum);
+    return SeqNew;
+}
+
+bool SequenceNumberWindow::Contains(uint32_t seqNum) const
+{
+    if (!started)
+        return false;
+
+    const int32_t distance = (int32_t)(seqNum - newest);
+    if (distance > 0 || (uint32_t)(-distance) >= Size())
+        return false;
+
+    return TestBit(seqNum);
+}
+
+void SequenceNumberWindow::Clear()
+{
+    std::fill(bits.begin(), bits.end(), 0);
+    newest = 0;
+    pendingLost = 0;
+    anchor = 0;
+    started = false;
+}
+
+void SequenceNumberWindow::Advance(uint32_t seqNum)
+{
+    const uint32_t size = (uint32_t)Size();
+    const uint32_t distance = seqNum - newest;
+
+    if (distance >= size)
+    {
+        // The whole window slides out, and the sequence numbers jumped over never even enter it.
+        // Counted as lost only when the jump is confirmed.
+        for(uint32_t i = 0; i < size; ++i)
+        {
+            const uint32_t old = newest - i;
+            if (!TestBit(old) && (int32_t)(old - anchor) >= 0)
+                ++pendingLost;
+        }
+        pendingLost += distance - size;
+        std::fill(bits.begin(), bits.end(), 0);
+    }
+    else
+    {
+        // The new sequence numbers reuse the bits of the ones sliding out of the window.
+        for(uint32_t s = newest + 1; s != seqNum + 1; ++s)
+        {
+            const uint32_t old = s - size;
+            uint32_t &word = bits[BitWord(old)];
+            if (word & BitMask(old))
+                word &= ~BitMask(old);
+            else if ((int32_t)(old - anchor) >= 0)
+                ++numLost;
+        }
+    }
+
+    newest = seqNum;
+}
+
+void SequenceNumberWindow::Reset(uint32_t seqNum)
+{
+    std::fill(bits.begin(), bits.end(), 0);
+    bits[BitWord(seqNum)] |= BitMask(seqNum);
+    newest = seqNum;
+    pendingLost = 0;
+    anchor = seqNum;
+}
+
+}
@@ -0,0 +1,102 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+#ifndef incl_ProtocolUtilities_SequenceNumberWindow_h
+#define incl_ProtocolUtilities_SequenceNumberWindow_h
+
+#include <vector>
+
+#include "RexTypes.h"
+
+namespace ProtocolUtilities
+{
+    /** Remembers which of the most recent inbound sequence numbers have been received, for pruning duplicates
+        and estimating packet loss. Keeps one bit per sequence number in a fixed-size window that slides forward
+        with the newest received sequence number, so inserting and looking up are O(1) and the memory use is bounded.
+        Sequence numbers are compared with wraparound, so the window keeps working across the 32-bit boundary.
+        A sequence number far behind the window is taken as the server having restarted or wrapped its numbering,
+        and the window is anchored at it anew.
+        The sequence numbers skipped by a jump past the whole window are counted as lost only once the jump is confirmed
+        by the next sequence number landing in the new window, so that a single forged sequence number can't inflate the loss.
+        \ingroup OpenSimProtocolClient */
+    class SequenceNumberWindow
+    {
+    public:
+        /// The result of inserting a sequence number.
+        enum InsertResult
+        {
+            /// The sequence number has not been seen before.
+            SeqNew,
+            /// The sequence number is in the window and has been seen before.
+            SeqDuplicate,
+            /// The sequence number is too old to be in the window, so it can't be told whether it is a duplicate.
+            SeqTooOld
+        };
+
+        /// Constructor.
+        /** @param size The number of sequence numbers to remember, rounded up to a power of two of at least 32.
+        */
+        explicit SequenceNumberWindow(size_t size = 1024);
+
+        /// Marks the given sequence number received.
+        InsertResult Insert(uint32_t seqNum);
+
+        /// @return True if the given sequence number is in the window and has been received.
+        bool Contains(uint32_t seqNum) const;
+
+        /// Forgets all the received sequence numbers. The statistics are kept.
+        void Clear();
+
+        /// @return The newest received sequence number, or 0 if nothing has been received.
+        uint32_t Newest() const { return newest; }
+
+        /// @return The number of sequence numbers the window can hold.
+        size_t Size() const { return bits.size() * 32; }
+
+        /// @return The number of duplicates detected.
+        size_t NumDuplicates() const { return numDuplicates; }
+
+        /// @return The number of sequence numbers that slid out of the window without ever being received.
+        /// Doesn't include the sequence numbers skipped by an unconfirmed jump.
+        size_t NumLost() const { return numLost; }
+
+        /// @return The number of sequence numbers that arrived after falling out of the window.
+        size_t NumTooOld() const { return numTooOld; }
+
+        /// @return The number of times the window was anchored anew because of a large backwards jump.
+        size_t NumResyncs() const { return numResyncs; }
+
+    private:
+        /// @return True if the bit of the given sequence number is set.
+        bool TestBit(uint32_t seqNum) const { return (bits[BitWord(seqNum)] & BitMask(seqNum)) != 0; }
+
+        size_t BitWord(uint32_t seqNum) const { return (seqNum >> 5) & (bits.size() - 1); }
+        static uint32_t BitMask(uint32_t seqNum) { return 1u << (seqNum & 31); }
+
+        /// Slides the window forward so that seqNum becomes the newest sequence number.
+        void Advance(uint32_t seqNum);
+
+        /// Anchors the window at the given sequence number, with only it received.
+        void Reset(uint32_t seqNum);
+
+        /// One bit per sequence number, indexed by sequence number modulo Size(). The number of words is a power of two.
+        std::vector<uint32_t> bits;
+
+        /// The newest received sequence number.
+        uint32_t newest;
+
+        /// The sequence numbers lost if the latest jump past the whole window is confirmed.
+        size_t pendingLost;
+
+        /// The sequence number the window was last anchored at. Older sequence numbers don't count as lost when they slide out.
+        uint32_t anchor;
+
+        /// False until the first sequence number is received.
+        bool started;
+
+        size_t numDuplicates;
+        size_t numLost;
+        size_t numTooOld;
+        size_t numResyncs;
+    };
+}
+
+#endif // incl_ProtocolUtilities_SequenceNumberWindow_h
@@ -0,0 +1,151 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+#include "StableHeaders.h"
+
+#include "PacketCapture.h"
+#include "CoreException.h"
+
+#include <cstring>
+
+namespace ProtocolUtilities
+{
+
+namespace
+{
+    void WriteU16(uint8_t *dst, uint16_t value)
+    {
+        dst[0] = (uint8_t)(value & 0xFF);
+        dst[1] = (uint8_t)(value >> 8);
+    }
+
+    void WriteU64(uint8_t *dst, uint64_t value)
+    {
+        for(int i = 0; i < 8; ++i)
+            dst[i] = (uint8_t)(value >> (i * 8));
+    }
+
+    uint16_t ReadU16(const uint8_t *src)
+    {
+        return (uint16_t)(src[0] | (src[1] << 8));
+    }
+
+    uint64_t ReadU64(const uint8_t *src)
+    {
+        uint64_t value = 0;
+        for(int i = 7; i >= 0; --i)
+            value = (value << 8) | src[i];
+        return value;
+    }
+
+    /// The size of the per-datagram header: timestamp and size.
+    const size_t cRecordHeaderSize = 10;
+}
+
+PacketCaptureWriter::PacketCaptureWriter(const std::string &filename_) :
+    filename(filename_),
+    handle(0),
+    startTime(GetCurrentClockTime()),
+    numDatagrams(0)
+{
+    handle = fopen(filename.c_str(), "wb");
+    if (!handle)
+        throw Exception(("Could not open packet capture file " + filename + " for writing.").c_str());
+
+    uint8_t header[PacketCapture::cMagicSize + 2];
+    memcpy(header, PacketCapture::cMagic, PacketCapture::cMagicSize);
+    WriteU16(header + PacketCapture::cMagicSize, PacketCapture::cVersion);
+    if (fwrite(header, sizeof(header), 1, handle) != 1)
+    {
+        fclose(handle);
+        handle = 0;
+        throw Exception(("Could not write the header of packet capture file " + filename + ".").c_str());
+    }
+}
+
+PacketCaptureWriter::~PacketCaptureWriter()
+{
+    if (handle)
+        fclose(handle);
+}
+
+bool PacketCaptureWriter::Write(const uint8_t *data, size_t numBytes)
+{
+    if (!handle)
+        return false;
+    if (numBytes > 0xFFFF)
+        return true; // Can't be a valid datagram.
+
+    const tick_t elapsed = GetCurrentClockTime() - startTime;
+    const uint64_t timestamp = (uint64_t)((double)elapsed * 1000000.0 / GetCurrentClockFreq());
+
+    uint8_t header[cRecordHeaderSize];
+    WriteU64(header, timestamp);
+    WriteU16(header + 8, (uint16_t)numBytes);
+    if (fwrite(header, sizeof(header), 1, handle) != 1 || (numBytes > 0 && fwrite(data, numBytes, 1, handle) != 1))
+    {
+        // Stop at the first error, e.g. a full disk. The reader drops the partial record at the end,
+        // but anything written after it would be misparsed.
+        fclose(handle);
+        handle = 0;
+        return false;
+    }
+    ++numDatagrams;
+    return true;
+}
+
+PacketCaptureReader::PacketCaptureReader(const std::string &filename) :
+    position(0),
+    numDatagrams(0)
+{
+    FILE *handle = fopen(filename.c_str(), "rb");
+    if (!handle)
+        throw Exception(("Could not open packet capture file " + filename + ".").c_str());
+
+    uint8_t buffer[4096];
+    size_t numRead;
+    while((numRead = fread(buffer, 1, sizeof(buffer), handle)) > 0)
+        contents.insert(contents.end(), buffer, buffer + numRead);
+    fclose(handle);
+
+    const size_t headerSize = PacketCapture::cMagicSize + 2;
+    if (contents.size() < headerSize || memcmp(&contents[0], PacketCapture::cMagic, PacketCapture::cMagicSize) != 0)
+        throw Exception(("File " + filename + " is not a packet capture.").c_str());
+    if (ReadU16(&contents[PacketCapture::cMagicSize]) != PacketCapture::cVersion)
+        throw Exception(("Packet capture " + filename + " has an unsupported version.").c_str());
+
+    // Drop the header and a possible partial record at the end, e.g. if the client crashed while capturing.
+    contents.erase(contents.begin(), contents.begin() + headerSize);
+    size_t end = 0;
+    while(end + cRecordHeaderSize <= contents.size())
+    {
+        const size_t recordSize = cRecordHeaderSize + ReadU16(&contents[end + 8]);
+        if (end + recordSize > contents.size())
+            break;
+        end += recordSize;
+        ++numDatagrams;
+    }
+    contents.resize(end);
+}
+
+bool PacketCaptureReader::Next(uint64_t &timestamp, const uint8_t *&data, size_t &numBytes)
+{
+    if (AtEnd())
+        return false;
+
+    timestamp = ReadU64(&contents[position]);
+    numBytes = ReadU16(&contents[position + 8]);
+    data = &contents[0] + position + cRecordHeaderSize;
+    position += cRecordHeaderSize + numBytes;
+    return true;
+}
+
+uint64_t PacketCaptureReader::PeekTimestamp() const
+{
+    return AtEnd() ? 0 : ReadU64(&contents[position]);
+}
+
+void PacketCaptureReader::Rewind()
+{
+    position = 0;
+}
+
+}
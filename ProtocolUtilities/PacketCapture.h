@@ -0,0 +1,102 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+#ifndef incl_ProtocolUtilities_PacketCapture_h
+#define incl_ProtocolUtilities_PacketCapture_h
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "RexTypes.h"
+#include "HighPerfClock.h"
+
+namespace ProtocolUtilities
+{
+    /** The packet capture file format. All the fields are little-endian.
+        - Header: the magic bytes "RXPCAP", a u16 version number.
+        - Then, for each datagram: a u64 receive time in microseconds since the start of the capture,
+          a u16 datagram size in bytes, and the datagram bytes. */
+    namespace PacketCapture
+    {
+        const char cMagic[] = "RXPCAP";
+        const size_t cMagicSize = 6;
+        const uint16_t cVersion = 1;
+    }
+
+    /// Writes raw datagrams with their receive times to a packet capture file. Not thread-safe.
+    class PacketCaptureWriter
+    {
+    public:
+        /// Opens the capture file for writing, truncating it.
+        /// @throw Exception if the file could not be opened or the header could not be written.
+        explicit PacketCaptureWriter(const std::string &filename);
+
+        /// Closes the capture file.
+        ~PacketCaptureWriter();
+
+        /// Writes a datagram to the file, timestamped with the current time.
+        /** If writing fails, the file is closed and the datagrams written so far are kept.
+            @return False if the datagram could not be written, or the file has already been closed. */
+        bool Write(const uint8_t *data, size_t numBytes);
+
+        /// @return True if the capture file is open for writing, i.e. no write has failed.
+        bool IsOpen() const { return handle != 0; }
+
+        /// @return The number of datagrams written.
+        size_t NumDatagrams() const { return numDatagrams; }
+
+        /// @return The name of the capture file.
+        const std::string &Filename() const { return filename; }
+
+    private:
+        PacketCaptureWriter(const PacketCaptureWriter &);
+        void operator=(const PacketCaptureWriter &);
+
+        std::string filename;
+        FILE *handle;
+
+        /// The time the capture was started.
+        tick_t startTime;
+
+        size_t numDatagrams;
+    };
+
+    /// Reads a whole packet capture file to memory and iterates through the datagrams in it.
+    class PacketCaptureReader
+    {
+    public:
+        /// Reads the capture file.
+        /// @throw Exception if the file could not be read or is not a packet capture.
+        explicit PacketCaptureReader(const std::string &filename);
+
+        /// Reads the next datagram.
+        /** @param timestamp [out] The receive time of the datagram, in microseconds since the start of the capture.
+            @param data [out] Points to the datagram bytes, valid as long as the reader is.
+            @param numBytes [out] The size of the datagram.
+            @return False if there are no more datagrams.
+        */
+        bool Next(uint64_t &timestamp, const uint8_t *&data, size_t &numBytes);
+
+        /// @return The receive time of the next datagram in microseconds, or 0 if there are no more datagrams.
+        uint64_t PeekTimestamp() const;
+
+        /// @return True if all the datagrams have been read.
+        bool AtEnd() const { return position >= contents.size(); }
+
+        /// Starts reading from the first datagram again.
+        void Rewind();
+
+        /// @return The number of datagrams in the capture.
+        size_t NumDatagrams() const { return numDatagrams; }
+
+    private:
+        /// The whole capture file.
+        std::vector<uint8_t> contents;
+
+        /// The read position in contents.
+        size_t position;
+
+        size_t numDatagrams;
+    };
+}
+
+#endif
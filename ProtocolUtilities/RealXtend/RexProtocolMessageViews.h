@@ -0,0 +1,377 @@
+/* This file defines views for reading the fields of frequently received messages at fixed offsets.
+See NetworkMessages/MessageView.h. This file is automatically generated from the message template
+file by NetMessageList::GenerateViewHeaderFile, so no point modifying it here. */
+
+#ifndef RexProtocolMessageViews
+#define RexProtocolMessageViews
+
+#include "NetworkMessages/NetInMessage.h"
+#include "NetworkMessages/MessageView.h"
+#include "QuatUtils.h"
+#include "RexUUID.h"
+
+namespace ProtocolUtilities
+{
+    /// A view to the LayerData message.
+    class LayerDataView
+    {
+    public:
+        static const NetMsgID cMessageID = 0xb;
+
+        /// @return The layout of the message the view was generated from. See MessageView::LayoutSignature.
+        static const char *Signature() { return "S(1)S(21)"; }
+
+        /// A view to one instance of the LayerID block.
+        class LayerIDBlock
+        {
+        public:
+            explicit LayerIDBlock(const uint8_t *data)
+            {
+                segments[0] = data;
+            }
+
+            uint8_t Type() const { return MessageView::Read<uint8_t>(segments[0]); }
+
+            /// Advances the read pointer over one instance of the block.
+            /// @return False if the block doesn't fit in the remaining bytes.
+            static bool Skip(const uint8_t *&pos, const uint8_t *end)
+            {
+                return MessageView::Skip(pos, end, 1);
+            }
+
+        private:
+            const uint8_t *segments[1];
+        };
+
+        /// A view to one instance of the LayerData block.
+        class LayerDataBlock
+        {
+        public:
+            explicit LayerDataBlock(const uint8_t *data)
+            {
+                segments[0] = data;
+            }
+
+            NetBufferRef Data() const { return NetBufferRef(segments[0] + 2, MessageView::ReadLength(segments[0], 2)); }
+
+            /// Advances the read pointer over one instance of the block.
+            /// @return False if the block doesn't fit in the remaining bytes.
+            static bool Skip(const uint8_t *&pos, const uint8_t *end)
+            {
+                return MessageView::SkipVariable(pos, end, 2);
+            }
+
+        private:
+            const uint8_t *segments[1];
+        };
+
+        LayerDataView() : numLayerID(0), numLayerData(0) {}
+
+        /// Locates the block instances in the message. Checks that they all fit in the message.
+        /// @return False if the message is not of type LayerData with the expected layout, or is truncated.
+        bool Parse(const NetInMessage &msg)
+        {
+            static const NetMessageInfo *matchedInfo = 0;
+            if (msg.GetMessageID() != cMessageID || !MessageView::MatchesLayout(msg.GetMessageInfo(), Signature(), matchedInfo))
+                return false;
+
+            const uint8_t *pos = msg.GetData();
+            const uint8_t *end = pos + msg.GetDataSize();
+
+            numLayerID = 1;
+            for(size_t i = 0; i < numLayerID; ++i)
+            {
+                layerID[i] = pos;
+                if (!LayerIDBlock::Skip(pos, end))
+                    return false;
+            }
+
+            numLayerData = 1;
+            for(size_t i = 0; i < numLayerData; ++i)
+            {
+                layerData[i] = pos;
+                if (!LayerDataBlock::Skip(pos, end))
+                    return false;
+            }
+
+            return true;
+        }
+
+        LayerIDBlock LayerID() const { return LayerIDBlock(layerID[0]); }
+        LayerDataBlock LayerData() const { return LayerDataBlock(layerData[0]); }
+
+    private:
+        const uint8_t *layerID[1];
+        size_t numLayerID;
+        const uint8_t *layerData[1];
+        size_t numLayerData;
+    };
+
+    /// A view to the ObjectUpdate message.
+    class ObjectUpdateView
+    {
+    public:
+        static const NetMsgID cMessageID = 0xc;
+
+        /// @return The layout of the message the view was generated from. See MessageView::LayoutSignature.
+        static const char *Signature() { return "S(4,2)V(3,1,15,3,1,1,1,11,20,3,3,1,1,2,2,1,1,1,1,5,5,5,5,5,1,5,2,2,2,21,20,21,21,20,19:4,20,20,20,15,15,9,1,9,1,11,11)"; }
+
+        /// A view to one instance of the RegionData block.
+        class RegionDataBlock
+        {
+        public:
+            explicit RegionDataBlock(const uint8_t *data)
+            {
+                segments[0] = data;
+            }
+
+            uint64_t RegionHandle() const { return MessageView::Read<uint64_t>(segments[0]); }
+            uint16_t TimeDilation() const { return MessageView::Read<uint16_t>(segments[0] + 8); }
+
+            /// Advances the read pointer over one instance of the block.
+            /// @return False if the block doesn't fit in the remaining bytes.
+            static bool Skip(const uint8_t *&pos, const uint8_t *end)
+            {
+                return MessageView::Skip(pos, end, 10);
+            }
+
+        private:
+            const uint8_t *segments[1];
+        };
+
+        /// A view to one instance of the ObjectData block.
+        class ObjectDataBlock
+        {
+        public:
+            explicit ObjectDataBlock(const uint8_t *data)
+            {
+                segments[0] = data;
+                segments[1] = segments[0] + 41 + MessageView::ReadLength(segments[0] + 40, 1);
+                segments[2] = segments[1] + 33 + MessageView::ReadLength(segments[1] + 31, 2);
+                segments[3] = segments[2] + 1 + MessageView::ReadLength(segments[2], 1);
+                segments[4] = segments[3] + 2 + MessageView::ReadLength(segments[3], 2);
+                segments[5] = segments[4] + 2 + MessageView::ReadLength(segments[4], 2);
+                segments[6] = segments[5] + 1 + MessageView::ReadLength(segments[5], 1);
+                segments[7] = segments[6] + 5 + MessageView::ReadLength(segments[6] + 4, 1);
+                segments[8] = segments[7] + 1 + MessageView::ReadLength(segments[7], 1);
+                segments[9] = segments[8] + 1 + MessageView::ReadLength(segments[8], 1);
+            }
+
+            uint32_t ID() const { return MessageView::Read<uint32_t>(segments[0]); }
+            uint8_t State() const { return MessageView::Read<uint8_t>(segments[0] + 4); }
+            RexUUID FullID() const { return MessageView::Read<RexUUID>(segments[0] + 5); }
+            uint32_t CRC() const { return MessageView::Read<uint32_t>(segments[0] + 21); }
+            uint8_t PCode() const { return MessageView::Read<uint8_t>(segments[0] + 25); }
+            uint8_t Material() const { return MessageView::Read<uint8_t>(segments[0] + 26); }
+            uint8_t ClickAction() const { return MessageView::Read<uint8_t>(segments[0] + 27); }
+            RexTypes::Vector3 Scale() const { return MessageView::Read<RexTypes::Vector3>(segments[0] + 28); }
+            NetBufferRef ObjectData() const { return NetBufferRef(segments[0] + 41, MessageView::ReadLength(segments[0] + 40, 1)); }
+            uint32_t ParentID() const { return MessageView::Read<uint32_t>(segments[1]); }
+            uint32_t UpdateFlags() const { return MessageView::Read<uint32_t>(segments[1] + 4); }
+            uint8_t PathCurve() const { return MessageView::Read<uint8_t>(segments[1] + 8); }
+            uint8_t ProfileCurve() const { return MessageView::Read<uint8_t>(segments[1] + 9); }
+            uint16_t PathBegin() const { return MessageView::Read<uint16_t>(segments[1] + 10); }
+            uint16_t PathEnd() const { return MessageView::Read<uint16_t>(segments[1] + 12); }
+            uint8_t PathScaleX() const { return MessageView::Read<uint8_t>(segments[1] + 14); }
+            uint8_t PathScaleY() const { return MessageView::Read<uint8_t>(segments[1] + 15); }
+            uint8_t PathShearX() const { return MessageView::Read<uint8_t>(segments[1] + 16); }
+            uint8_t PathShearY() const { return MessageView::Read<uint8_t>(segments[1] + 17); }
+            int8_t PathTwist() const { return MessageView::Read<int8_t>(segments[1] + 18); }
+            int8_t PathTwistBegin() const { return MessageView::Read<int8_t>(segments[1] + 19); }
+            int8_t PathRadiusOffset() const { return MessageView::Read<int8_t>(segments[1] + 20); }
+            int8_t PathTaperX() const { return MessageView::Read<int8_t>(segments[1] + 21); }
+            int8_t PathTaperY() const { return MessageView::Read<int8_t>(segments[1] + 22); }
+            uint8_t PathRevolutions() const { return MessageView::Read<uint8_t>(segments[1] + 23); }
+            int8_t PathSkew() const { return MessageView::Read<int8_t>(segments[1] + 24); }
+            uint16_t ProfileBegin() const { return MessageView::Read<uint16_t>(segments[1] + 25); }
+            uint16_t ProfileEnd() const { return MessageView::Read<uint16_t>(segments[1] + 27); }
+            uint16_t ProfileHollow() const { return MessageView::Read<uint16_t>(segments[1] + 29); }
+            NetBufferRef TextureEntry() const { return NetBufferRef(segments[1] + 33, MessageView::ReadLength(segments[1] + 31, 2)); }
+            NetBufferRef TextureAnim() const { return NetBufferRef(segments[2] + 1, MessageView::ReadLength(segments[2], 1)); }
+            NetBufferRef NameValue() const { return NetBufferRef(segments[3] + 2, MessageView::ReadLength(segments[3], 2)); }
+            NetBufferRef Data() const { return NetBufferRef(segments[4] + 2, MessageView::ReadLength(segments[4], 2)); }
+            NetBufferRef Text() const { return NetBufferRef(segments[5] + 1, MessageView::ReadLength(segments[5], 1)); }
+            NetBufferRef TextColor() const { return NetBufferRef(segments[6], 4); }
+            NetBufferRef MediaURL() const { return NetBufferRef(segments[6] + 5, MessageView::ReadLength(segments[6] + 4, 1)); }
+            NetBufferRef PSBlock() const { return NetBufferRef(segments[7] + 1, MessageView::ReadLength(segments[7], 1)); }
+            NetBufferRef ExtraParams() const { return NetBufferRef(segments[8] + 1, MessageView::ReadLength(segments[8], 1)); }
+            RexUUID Sound() const { return MessageView::Read<RexUUID>(segments[9]); }
+            RexUUID OwnerID() const { return MessageView::Read<RexUUID>(segments[9] + 16); }
+            float Gain() const { return MessageView::Read<float>(segments[9] + 32); }
+            uint8_t Flags() const { return MessageView::Read<uint8_t>(segments[9] + 36); }
+            float Radius() const { return MessageView::Read<float>(segments[9] + 37); }
+            uint8_t JointType() const { return MessageView::Read<uint8_t>(segments[9] + 41); }
+            RexTypes::Vector3 JointPivot() const { return MessageView::Read<RexTypes::Vector3>(segments[9] + 42); }
+            RexTypes::Vector3 JointAxisOrAnchor() const { return MessageView::Read<RexTypes::Vector3>(segments[9] + 54); }
+
+            /// Advances the read pointer over one instance of the block.
+            /// @return False if the block doesn't fit in the remaining bytes.
+            static bool Skip(const uint8_t *&pos, const uint8_t *end)
+            {
+                return MessageView::Skip(pos, end, 40) &&
+                    MessageView::SkipVariable(pos, end, 1) &&
+                    MessageView::Skip(pos, end, 31) &&
+                    MessageView::SkipVariable(pos, end, 2) &&
+                    MessageView::SkipVariable(pos, end, 1) &&
+                    MessageView::SkipVariable(pos, end, 2) &&
+                    MessageView::SkipVariable(pos, end, 2) &&
+                    MessageView::SkipVariable(pos, end, 1) &&
+                    MessageView::Skip(pos, end, 4) &&
+                    MessageView::SkipVariable(pos, end, 1) &&
+                    MessageView::SkipVariable(pos, end, 1) &&
+                    MessageView::SkipVariable(pos, end, 1) &&
+                    MessageView::Skip(pos, end, 66);
+            }
+
+        private:
+            const uint8_t *segments[10];
+        };
+
+        ObjectUpdateView() : numRegionData(0), numObjectData(0) {}
+
+        /// Locates the block instances in the message. Checks that they all fit in the message.
+        /// @return False if the message is not of type ObjectUpdate with the expected layout, or is truncated.
+        bool Parse(const NetInMessage &msg)
+        {
+            static const NetMessageInfo *matchedInfo = 0;
+            if (msg.GetMessageID() != cMessageID || !MessageView::MatchesLayout(msg.GetMessageInfo(), Signature(), matchedInfo))
+                return false;
+
+            const uint8_t *pos = msg.GetData();
+            const uint8_t *end = pos + msg.GetDataSize();
+
+            numRegionData = 1;
+            for(size_t i = 0; i < numRegionData; ++i)
+            {
+                regionData[i] = pos;
+                if (!RegionDataBlock::Skip(pos, end))
+                    return false;
+            }
+
+            // A missing instance count means there are no instances.
+            numObjectData = (pos < end) ? *pos++ : 0;
+            for(size_t i = 0; i < numObjectData; ++i)
+            {
+                objectData[i] = pos;
+                if (!ObjectDataBlock::Skip(pos, end))
+                    return false;
+            }
+
+            return true;
+        }
+
+        RegionDataBlock RegionData() const { return RegionDataBlock(regionData[0]); }
+        size_t ObjectDataCount() const { return numObjectData; }
+        ObjectDataBlock ObjectData(size_t index) const { assert(index < numObjectData); return ObjectDataBlock(objectData[index]); }
+
+    private:
+        const uint8_t *regionData[1];
+        size_t numRegionData;
+        const uint8_t *objectData[255];
+        size_t numObjectData;
+    };
+
+    /// A view to the ImprovedTerseObjectUpdate message.
+    class ImprovedTerseObjectUpdateView
+    {
+    public:
+        static const NetMsgID cMessageID = 0xf;
+
+        /// @return The layout of the message the view was generated from. See MessageView::LayoutSignature.
+        static const char *Signature() { return "S(4,2)V(20,21)"; }
+
+        /// A view to one instance of the RegionData block.
+        class RegionDataBlock
+        {
+        public:
+            explicit RegionDataBlock(const uint8_t *data)
+            {
+                segments[0] = data;
+            }
+
+            uint64_t RegionHandle() const { return MessageView::Read<uint64_t>(segments[0]); }
+            uint16_t TimeDilation() const { return MessageView::Read<uint16_t>(segments[0] + 8); }
+
+            /// Advances the read pointer over one instance of the block.
+            /// @return False if the block doesn't fit in the remaining bytes.
+            static bool Skip(const uint8_t *&pos, const uint8_t *end)
+            {
+                return MessageView::Skip(pos, end, 10);
+            }
+
+        private:
+            const uint8_t *segments[1];
+        };
+
+        /// A view to one instance of the ObjectData block.
+        class ObjectDataBlock
+        {
+        public:
+            explicit ObjectDataBlock(const uint8_t *data)
+            {
+                segments[0] = data;
+                segments[1] = segments[0] + 1 + MessageView::ReadLength(segments[0], 1);
+            }
+
+            NetBufferRef Data() const { return NetBufferRef(segments[0] + 1, MessageView::ReadLength(segments[0], 1)); }
+            NetBufferRef TextureEntry() const { return NetBufferRef(segments[1] + 2, MessageView::ReadLength(segments[1], 2)); }
+
+            /// Advances the read pointer over one instance of the block.
+            /// @return False if the block doesn't fit in the remaining bytes.
+            static bool Skip(const uint8_t *&pos, const uint8_t *end)
+            {
+                return MessageView::SkipVariable(pos, end, 1) &&
+                    MessageView::SkipVariable(pos, end, 2);
+            }
+
+        private:
+            const uint8_t *segments[2];
+        };
+
+        ImprovedTerseObjectUpdateView() : numRegionData(0), numObjectData(0) {}
+
+        /// Locates the block instances in the message. Checks that they all fit in the message.
+        /// @return False if the message is not of type ImprovedTerseObjectUpdate with the expected layout, or is truncated.
+        bool Parse(const NetInMessage &msg)
+        {
+            static const NetMessageInfo *matchedInfo = 0;
+            if (msg.GetMessageID() != cMessageID || !MessageView::MatchesLayout(msg.GetMessageInfo(), Signature(), matchedInfo))
+                return false;
+
+            const uint8_t *pos = msg.GetData();
+            const uint8_t *end = pos + msg.GetDataSize();
+
+            numRegionData = 1;
+            for(size_t i = 0; i < numRegionData; ++i)
+            {
+                regionData[i] = pos;
+                if (!RegionDataBlock::Skip(pos, end))
+                    return false;
+            }
+
+            // A missing instance count means there are no instances.
+            numObjectData = (pos < end) ? *pos++ : 0;
+            for(size_t i = 0; i < numObjectData; ++i)
+            {
+                objectData[i] = pos;
+                if (!ObjectDataBlock::Skip(pos, end))
+                    return false;
+            }
+
+            return true;
+        }
+
+        RegionDataBlock RegionData() const { return RegionDataBlock(regionData[0]); }
+        size_t ObjectDataCount() const { return numObjectData; }
+        ObjectDataBlock ObjectData(size_t index) const { assert(index < numObjectData); return ObjectDataBlock(objectData[index]); }
+
+    private:
+        const uint8_t *regionData[1];
+        size_t numRegionData;
+        const uint8_t *objectData[255];
+        size_t numObjectData;
+    };
+
+}
+
+#endif
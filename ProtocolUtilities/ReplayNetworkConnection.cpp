@@ -0,0 +1,107 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+#include "StableHeaders.h"
+
+#include "ReplayNetworkConnection.h"
+
+#include <cstring>
+
+#include <boost/thread.hpp>
+
+namespace ProtocolUtilities
+{
+
+ReplayNetworkConnection::ReplayNetworkConnection(const std::string &filename, bool realTimePacing_) :
+    capture(filename),
+    realTimePacing(realTimePacing_),
+    startTime(0),
+    started(false),
+    numReceived(0),
+    numSent(0)
+{
+}
+
+uint64_t ReplayNetworkConnection::ElapsedMicroseconds() const
+{
+    if (!started)
+    {
+        startTime = GetCurrentClockTime();
+        started = true;
+    }
+    return (uint64_t)((double)(GetCurrentClockTime() - startTime) * 1000000.0 / GetCurrentClockFreq());
+}
+
+bool ReplayNetworkConnection::PacketsAvailable() const
+{
+    if (!bOpen || capture.AtEnd())
+        return false;
+
+    return !realTimePacing || capture.PeekTimestamp() <= ElapsedMicroseconds();
+}
+
+bool ReplayNetworkConnection::WaitForPackets(int timeoutMsecs) const
+{
+    if (!bOpen || capture.AtEnd())
+    {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(timeoutMsecs));
+        return false;
+    }
+
+    if (realTimePacing)
+    {
+        const uint64_t now = ElapsedMicroseconds();
+        const uint64_t due = capture.PeekTimestamp();
+        if (due > now)
+        {
+            const uint64_t waitMsecs = std::min<uint64_t>((due - now + 999) / 1000, timeoutMsecs);
+            boost::this_thread::sleep(boost::posix_time::milliseconds((long)waitMsecs));
+        }
+    }
+    return PacketsAvailable();
+}
+
+int ReplayNetworkConnection::ReceiveBytes(uint8_t *bytes, size_t maxCount)
+{
+    if (!PacketsAvailable())
+        return 0;
+
+    uint64_t timestamp;
+    const uint8_t *data;
+    size_t numBytes;
+    capture.Next(timestamp, data, numBytes);
+    ++numReceived;
+
+    // Truncate like a socket would.
+    numBytes = std::min(numBytes, maxCount);
+    memcpy(bytes, data, numBytes);
+    return (int)numBytes;
+}
+
+size_t ReplayNetworkConnection::ReceiveBatch(uint8_t **buffers, size_t bufferSize, size_t *sizes, size_t maxCount)
+{
+    size_t count = 0;
+    while(count < maxCount && PacketsAvailable())
+    {
+        sizes[count] = ReceiveBytes(buffers[count], bufferSize);
+        ++count;
+    }
+    return count;
+}
+
+void ReplayNetworkConnection::SendBytes(const uint8_t *bytes, size_t count)
+{
+    ++numSent;
+}
+
+void ReplayNetworkConnection::QueueBytes(const uint8_t *bytes, size_t count)
+{
+    ++numSent;
+}
+
+void ReplayNetworkConnection::Rewind()
+{
+    capture.Rewind();
+    started = false;
+    numReceived = 0;
+}
+
+}
@@ -0,0 +1,66 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+#ifndef incl_ProtocolUtilities_ReplayNetworkConnection_h
+#define incl_ProtocolUtilities_ReplayNetworkConnection_h
+
+#include "NetworkConnection.h"
+#include "PacketCapture.h"
+
+namespace ProtocolUtilities
+{
+    /** Stands in for the server connection by feeding back the datagrams of a packet capture, see
+        NetMessageManager::StartCapture(). Outbound datagrams are counted and discarded.
+        The datagrams are delivered either at their original pacing, or as fast as they are read. */
+    class ReplayNetworkConnection : public NetworkConnection
+    {
+    public:
+        /// Reads the packet capture.
+        /** @param filename The packet capture file.
+            @param realTimePacing If true, each datagram becomes available only when as much time has passed since
+                   the first read as had passed since the start of the capture. If false, all the datagrams are available at once.
+            @throw Exception if the capture could not be read.
+        */
+        ReplayNetworkConnection(const std::string &filename, bool realTimePacing);
+
+        virtual bool PacketsAvailable() const;
+        virtual bool WaitForPackets(int timeoutMsecs) const;
+        virtual int ReceiveBytes(uint8_t *bytes, size_t maxCount);
+        virtual size_t ReceiveBatch(uint8_t **buffers, size_t bufferSize, size_t *sizes, size_t maxCount);
+        virtual void SendBytes(const uint8_t *bytes, size_t count);
+        virtual void QueueBytes(const uint8_t *bytes, size_t count);
+        virtual void FlushSendQueue() {}
+        virtual int LocalPort() const { return 0; }
+        virtual void Close() { bOpen = false; }
+
+        /// @return True if all the datagrams of the capture have been received.
+        bool Finished() const { return capture.AtEnd(); }
+
+        /// @return The number of datagrams in the capture.
+        size_t NumDatagrams() const { return capture.NumDatagrams(); }
+
+        /// @return The number of datagrams received so far.
+        size_t NumReceived() const { return numReceived; }
+
+        /// @return The number of datagrams sent and discarded.
+        size_t NumSent() const { return numSent; }
+
+        /// Starts the replay again from the first datagram.
+        void Rewind();
+
+    private:
+        /// @return The current time in microseconds since the start of the replay.
+        uint64_t ElapsedMicroseconds() const;
+
+        PacketCaptureReader capture;
+
+        bool realTimePacing;
+
+        /// The time of the first read. Mutable since the clock starts on the first PacketsAvailable().
+        mutable tick_t startTime;
+        mutable bool started;
+
+        size_t numReceived;
+        size_t numSent;
+    };
+}
+
+#endif
@@ -6,6 +6,21 @@
 
 #include "LoggingFunctions.h"
 
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ZEROCODE_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define ZEROCODE_NEON
+#include <arm_neon.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 DEFINE_POCO_LOGGING_FUNCTIONS("ZeroCode")
 
 namespace ProtocolUtilities
@@ -31,8 +46,9 @@ namespace ProtocolUtilities
         {
             if (data[i] == 0) // Hit a zero?
             {
+                // Each run of at most 255 zeroes is encoded as a zero followed by the length of the run.
                 size_t numZeroes = CountConsecutiveZeroes(data, i, numBytes);
-                length += 1 + numZeroes;
+                length += 2 * ((numZeroes + 254) / 255);
                 i += numZeroes;
             }
             else
@@ -127,10 +143,10 @@ namespace ProtocolUtilities
         {
             if (srcData[src] == 0)
             {
-                size_t numZeroes = CountConsecutiveZeroes(srcData, src, srcBytes);
+                size_t numZeroes = std::min<size_t>(CountConsecutiveZeroes(srcData, src, srcBytes), 255);
                 src += numZeroes;
 
-                ///\bug Fails on a run of 256 or more zeroes.
+                // A longer run is encoded as several runs of at most 255 zeroes.
                 if (dst >= dstBytes)
                 {
                     LogWarning("Whoops! Caller didn't provide a buffer big enough!");
@@ -142,7 +158,7 @@ namespace ProtocolUtilities
                     LogWarning("Whoops! Caller didn't provide a buffer big enough!");
                     return false;
                 }
-                dstData[dst++] = numZeroes;
+                dstData[dst++] = (uint8_t)numZeroes;
             }
             else
             {
@@ -157,4 +173,150 @@ namespace ProtocolUtilities
 
         return true;
     }
+
+    /// @return The index of the lowest set bit. The value must be nonzero.
+    static inline unsigned LowestSetBit(uint32_t value)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward(&index, value);
+        return (unsigned)index;
+#else
+        return (unsigned)__builtin_ctz(value);
+#endif
+    }
+
+#ifdef ZEROCODE_NEON
+    /// @return A mask with four bits set for each byte of the comparison result that is set.
+    static inline uint64_t NeonByteMask(uint8x16_t cmp)
+    {
+        return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(cmp), 4)), 0);
+    }
+
+    static inline unsigned LowestSetBit64(uint64_t value)
+    {
+        return (unsigned)__builtin_ctzll(value);
+    }
+#endif
+
+    /// @return A pointer to the first zero byte in [data, end), or end if there is none.
+    static inline const uint8_t *FindZero(const uint8_t *data, const uint8_t *end)
+    {
+#if defined(ZEROCODE_SSE2)
+        const __m128i zero = _mm_setzero_si128();
+        while(end - data >= 16)
+        {
+            const int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)data), zero));
+            if (mask)
+                return data + LowestSetBit((uint32_t)mask);
+            data += 16;
+        }
+#elif defined(ZEROCODE_NEON)
+        while(end - data >= 16)
+        {
+            const uint64_t mask = NeonByteMask(vceqq_u8(vld1q_u8(data), vdupq_n_u8(0)));
+            if (mask)
+                return data + LowestSetBit64(mask) / 4;
+            data += 16;
+        }
+#endif
+        while(data < end && *data != 0)
+            ++data;
+        return data;
+    }
+
+    /// @return A pointer to the first nonzero byte in [data, end), or end if there is none.
+    static inline const uint8_t *FindNonZero(const uint8_t *data, const uint8_t *end)
+    {
+#if defined(ZEROCODE_SSE2)
+        const __m128i zero = _mm_setzero_si128();
+        while(end - data >= 16)
+        {
+            const int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)data), zero)) ^ 0xFFFF;
+            if (mask)
+                return data + LowestSetBit((uint32_t)mask);
+            data += 16;
+        }
+#elif defined(ZEROCODE_NEON)
+        while(end - data >= 16)
+        {
+            const uint64_t mask = NeonByteMask(vtstq_u8(vld1q_u8(data), vld1q_u8(data)));
+            if (mask)
+                return data + LowestSetBit64(mask) / 4;
+            data += 16;
+        }
+#endif
+        while(data < end && *data == 0)
+            ++data;
+        return data;
+    }
+
+    size_t ZeroEncodeToBuffer(uint8_t *dstData, size_t dstBytes, const uint8_t *srcData, size_t srcBytes)
+    {
+        const uint8_t *src = srcData;
+        const uint8_t *srcEnd = srcData + srcBytes;
+        size_t dst = 0;
+
+        while(src < srcEnd)
+        {
+            // Copy the nonzero bytes up to the next zero as such.
+            const uint8_t *zero = FindZero(src, srcEnd);
+            const size_t numLiterals = zero - src;
+            if (numLiterals > dstBytes - dst)
+                return 0;
+            memcpy(dstData + dst, src, numLiterals);
+            dst += numLiterals;
+            if (zero == srcEnd)
+                break;
+
+            // Encode the run of zeroes, in pieces of at most 255 zeroes.
+            src = FindNonZero(zero, srcEnd);
+            for(size_t numZeroes = src - zero; numZeroes > 0; )
+            {
+                const size_t pieceLength = std::min<size_t>(numZeroes, 255);
+                if (dstBytes - dst < 2)
+                    return 0;
+                dstData[dst++] = 0;
+                dstData[dst++] = (uint8_t)pieceLength;
+                numZeroes -= pieceLength;
+            }
+        }
+
+        return dst;
+    }
+
+    size_t ZeroDecodeToBuffer(uint8_t *dstData, size_t dstBytes, const uint8_t *srcData, size_t srcBytes)
+    {
+        const uint8_t *src = srcData;
+        const uint8_t *srcEnd = srcData + srcBytes;
+        size_t length = 0;
+
+        while(src < srcEnd)
+        {
+            // Copy the nonzero bytes up to the next zero as such.
+            const uint8_t *zero = FindZero(src, srcEnd);
+            const size_t numLiterals = zero - src;
+            if (numLiterals > 0 && length + numLiterals <= dstBytes)
+                memcpy(dstData + length, src, numLiterals);
+            length += numLiterals;
+            if (zero == srcEnd)
+                break;
+
+            // The byte after a zero tells how many times the zero is repeated.
+            if (zero + 1 >= srcEnd)
+            {
+                LogWarning("Malformed zero-encoded packet found! (Ends in a zero without run-length!");
+                return 0;
+            }
+            const size_t numZeroes = zero[1];
+            if (numZeroes == 0) // A run of zero zeroes? The packet is then malformed.
+                return 0;
+            if (length + numZeroes <= dstBytes)
+                memset(dstData + length, 0, numZeroes);
+            length += numZeroes;
+            src = zero + 2;
+        }
+
+        return length;
+    }
 }
@@ -32,6 +32,26 @@ bool ZeroEncode(uint8_t *dstData, size_t dstBytes, const uint8_t *srcData, size_
 ///  destination buffer or if some other error occurred.
 bool ZeroDecode(uint8_t *dstData, size_t dstBytes, const uint8_t *srcData, size_t srcBytes);
 
+/// Zero-encodes the given data block in a single pass, without counting the encoded length first.
+/// Scans for zero runs using SSE2 or NEON where available.
+/// @param dstData [out] The resulting zero-encoded block will be written here.
+/// @param dstBytes The maximum number of bytes that can be written to dstData.
+/// @param srcData The source buffer to encode.
+/// @param srcBytes The number of bytes to encode.
+/// @return The number of bytes written to dstData, or 0 if the encoded block doesn't fit in dstBytes.
+size_t ZeroEncodeToBuffer(uint8_t *dstData, size_t dstBytes, const uint8_t *srcData, size_t srcBytes);
+
+/// Zero-decodes the given data block in a single pass, without counting the decoded length first.
+/// Scans for zero runs using SSE2 or NEON where available.
+/// @param dstData [out] The resulting zero-decoded block will be written here. May be null if dstBytes is 0.
+/// @param dstBytes The maximum number of bytes that can be written to dstData.
+/// @param srcData The zero-encoded source buffer to decode.
+/// @param srcBytes The number of bytes to decode.
+/// @return The zero-decoded length, or 0 if the data block is malformed. If the return value is greater than
+///  dstBytes, the decoded block didn't fit, and the contents of dstData are undefined. The caller can then
+///  provide a buffer of the returned size and decode again.
+size_t ZeroDecodeToBuffer(uint8_t *dstData, size_t dstBytes, const uint8_t *srcData, size_t srcBytes);
+
 }
 
 #endif
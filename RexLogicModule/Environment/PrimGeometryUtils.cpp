@@ -50,6 +50,7 @@
 #endif
 
 #include <Ogre.h>
+#include <boost/functional/hash.hpp>
 
 namespace RexLogic
 {
@@ -57,7 +58,7 @@ namespace RexLogic
     
     void TransformUV(Ogre::Vector2& uv, float repeat_u, float repeat_v, float offset_u, float offset_v, float rot_sin, float rot_cos)
     {
-        const static Ogre::Vector2 half(0.5f, 0.5f);
+        const Ogre::Vector2 half(0.5f, 0.5f);
         
         Ogre::Vector2 centered = uv - half;
 
@@ -83,27 +84,174 @@ namespace RexLogic
         return true;
     }
 
-    Ogre::ManualObject* CreatePrimGeometry(Foundation::Framework* framework, EC_OpenSimPrim& primitive, bool optimisations_enabled)
+
+    //! Returns the face number used to index the per-face parameters
+    inline int GetFaceIndex(int facenum)
     {
-        PROFILE(Primitive_CreateGeometry)
-        
-        if (!primitive.HasPrimShapeData)
-            return 0;
-        
-        // Create only a single manual object for prim geometry and reuse it over and over, to avoid Ogre generating
-        // a huge load of unnecessary D3D resources, that are never used for anything visible (the manual object will
-        // be converted to a mesh anyway)
-        if (!prim_manual_object)
+        return std::max(std::min(facenum, cMaxPrimFaces - 1), 0);
+    }
+
+    PrimShapeParams::PrimShapeParams() :
+        path_curve(0),
+        profile_curve(0),
+        path_begin(0.0f),
+        path_end(0.0f),
+        path_scale_x(0.0f),
+        path_scale_y(0.0f),
+        path_shear_x(0.0f),
+        path_shear_y(0.0f),
+        path_twist(0.0f),
+        path_twist_begin(0.0f),
+        path_radius_offset(0.0f),
+        path_taper_x(0.0f),
+        path_taper_y(0.0f),
+        path_revolutions(0.0f),
+        path_skew(0.0f),
+        profile_begin(0.0f),
+        profile_end(0.0f),
+        profile_hollow(0.0f),
+        optimisations_enabled(true)
+    {
+        for (int i = 0; i < cMaxPrimFaces; ++i)
         {
-            OgreRenderer::RendererPtr renderer = framework->GetServiceManager()->GetService<OgreRenderer::Renderer>(Service::ST_Renderer).lock();
-            if (!renderer)
-                return 0;
-            Ogre::SceneManager *sceneMgr = renderer->GetSceneManager();
-            prim_manual_object = sceneMgr->createManualObject(renderer->GetUniqueObjectName());
-            if (!prim_manual_object)
-                return 0;
+            repeat_u[i] = 1.0f;
+            repeat_v[i] = 1.0f;
+            offset_u[i] = 0.0f;
+            offset_v[i] = 0.0f;
+            uv_rotation[i] = 0.0f;
+            material_groups[i] = i;
         }
-        
+    }
+
+    void PrimShapeParams::Set(const EC_OpenSimPrim& primitive, const std::vector<std::string>& material_names, bool optimisations)
+    {
+        path_curve = primitive.PathCurve.Get();
+        profile_curve = primitive.ProfileCurve.Get();
+        path_begin = primitive.PathBegin.Get();
+        path_end = primitive.PathEnd.Get();
+        path_scale_x = primitive.PathScaleX.Get();
+        path_scale_y = primitive.PathScaleY.Get();
+        path_shear_x = primitive.PathShearX.Get();
+        path_shear_y = primitive.PathShearY.Get();
+        path_twist = primitive.PathTwist.Get();
+        path_twist_begin = primitive.PathTwistBegin.Get();
+        path_radius_offset = primitive.PathRadiusOffset.Get();
+        path_taper_x = primitive.PathTaperX.Get();
+        path_taper_y = primitive.PathTaperY.Get();
+        path_revolutions = primitive.PathRevolutions.Get();
+        path_skew = primitive.PathSkew.Get();
+        profile_begin = primitive.ProfileBegin.Get();
+        profile_end = primitive.ProfileEnd.Get();
+        profile_hollow = primitive.ProfileHollow.Get();
+        optimisations_enabled = optimisations || primitive.DrawType == RexTypes::DRAWTYPE_MESH;
+
+        for (int facenum = 0; facenum < cMaxPrimFaces; ++facenum)
+        {
+            colors[facenum] = primitive.PrimDefaultColor;
+            ColorMap::const_iterator c = primitive.PrimColors.find(facenum);
+            if (c != primitive.PrimColors.end())
+                colors[facenum] = c->second;
+
+            repeat_u[facenum] = primitive.PrimDefaultRepeatU;
+            repeat_v[facenum] = primitive.PrimDefaultRepeatV;
+            offset_u[facenum] = primitive.PrimDefaultOffsetU;
+            offset_v[facenum] = primitive.PrimDefaultOffsetV;
+            uv_rotation[facenum] = primitive.PrimDefaultUVRotation;
+            UVParamMap::const_iterator p = primitive.PrimRepeatU.find(facenum);
+            if (p != primitive.PrimRepeatU.end())
+                repeat_u[facenum] = p->second;
+            p = primitive.PrimRepeatV.find(facenum);
+            if (p != primitive.PrimRepeatV.end())
+                repeat_v[facenum] = p->second;
+            p = primitive.PrimOffsetU.find(facenum);
+            if (p != primitive.PrimOffsetU.end())
+                offset_u[facenum] = p->second;
+            p = primitive.PrimOffsetV.find(facenum);
+            if (p != primitive.PrimOffsetV.end())
+                offset_v[facenum] = p->second;
+            p = primitive.PrimUVRotation.find(facenum);
+            if (p != primitive.PrimUVRotation.end())
+                uv_rotation[facenum] = p->second;
+
+            material_groups[facenum] = facenum;
+            for (int i = 0; i < facenum && facenum < (int)material_names.size(); ++i)
+                if (material_names[i] == material_names[facenum])
+                {
+                    material_groups[facenum] = i;
+                    break;
+                }
+        }
+    }
+
+    size_t PrimShapeParams::Hash() const
+    {
+        size_t seed = 0;
+        boost::hash_combine(seed, path_curve);
+        boost::hash_combine(seed, profile_curve);
+        boost::hash_combine(seed, path_begin);
+        boost::hash_combine(seed, path_end);
+        boost::hash_combine(seed, path_scale_x);
+        boost::hash_combine(seed, path_scale_y);
+        boost::hash_combine(seed, path_shear_x);
+        boost::hash_combine(seed, path_shear_y);
+        boost::hash_combine(seed, path_twist);
+        boost::hash_combine(seed, path_twist_begin);
+        boost::hash_combine(seed, path_radius_offset);
+        boost::hash_combine(seed, path_taper_x);
+        boost::hash_combine(seed, path_taper_y);
+        boost::hash_combine(seed, path_revolutions);
+        boost::hash_combine(seed, path_skew);
+        boost::hash_combine(seed, profile_begin);
+        boost::hash_combine(seed, profile_end);
+        boost::hash_combine(seed, profile_hollow);
+        boost::hash_combine(seed, optimisations_enabled);
+        for (int i = 0; i < cMaxPrimFaces; ++i)
+        {
+            boost::hash_combine(seed, colors[i].r);
+            boost::hash_combine(seed, colors[i].g);
+            boost::hash_combine(seed, colors[i].b);
+            boost::hash_combine(seed, colors[i].a);
+            boost::hash_combine(seed, repeat_u[i]);
+            boost::hash_combine(seed, repeat_v[i]);
+            boost::hash_combine(seed, offset_u[i]);
+            boost::hash_combine(seed, offset_v[i]);
+            boost::hash_combine(seed, uv_rotation[i]);
+            boost::hash_combine(seed, material_groups[i]);
+        }
+        return seed;
+    }
+
+    bool PrimShapeParams::operator ==(const PrimShapeParams& rhs) const
+    {
+        if (path_curve != rhs.path_curve || profile_curve != rhs.profile_curve ||
+            path_begin != rhs.path_begin || path_end != rhs.path_end ||
+            path_scale_x != rhs.path_scale_x || path_scale_y != rhs.path_scale_y ||
+            path_shear_x != rhs.path_shear_x || path_shear_y != rhs.path_shear_y ||
+            path_twist != rhs.path_twist || path_twist_begin != rhs.path_twist_begin ||
+            path_radius_offset != rhs.path_radius_offset ||
+            path_taper_x != rhs.path_taper_x || path_taper_y != rhs.path_taper_y ||
+            path_revolutions != rhs.path_revolutions || path_skew != rhs.path_skew ||
+            profile_begin != rhs.profile_begin || profile_end != rhs.profile_end || profile_hollow != rhs.profile_hollow ||
+            optimisations_enabled != rhs.optimisations_enabled)
+            return false;
+
+        for (int i = 0; i < cMaxPrimFaces; ++i)
+        {
+            if (colors[i].r != rhs.colors[i].r || colors[i].g != rhs.colors[i].g ||
+                colors[i].b != rhs.colors[i].b || colors[i].a != rhs.colors[i].a ||
+                repeat_u[i] != rhs.repeat_u[i] || repeat_v[i] != rhs.repeat_v[i] ||
+                offset_u[i] != rhs.offset_u[i] || offset_v[i] != rhs.offset_v[i] ||
+                uv_rotation[i] != rhs.uv_rotation[i] || material_groups[i] != rhs.material_groups[i])
+                return false;
+        }
+        return true;
+    }
+
+    void GetPrimFaceMaterials(Foundation::Framework* framework, EC_OpenSimPrim& primitive, std::vector<std::string>& material_names)
+    {
+        material_names.clear();
+        material_names.resize(cMaxPrimFaces);
+
         std::string mat_override;
         if ((primitive.Materials[0].Type == RexTypes::RexAT_MaterialScript) && (!RexTypes::IsNull(primitive.Materials[0].asset_id)))
         {
@@ -113,26 +261,79 @@ namespace RexLogic
             // We will probably get resource ready event later for the material & redo this prim
             boost::shared_ptr<OgreRenderer::Renderer> renderer = framework->GetServiceManager()->
                 GetService<OgreRenderer::Renderer>(Service::ST_Renderer).lock();
-            if (!renderer->GetResource(mat_override, OgreRenderer::OgreMaterialResource::GetTypeStatic()))
+            if (!renderer || !renderer->GetResource(mat_override, OgreRenderer::OgreMaterialResource::GetTypeStatic()))
             {
                 mat_override = "LitTextured";
             }
         }
-            
+
+        for (int facenum = 0; facenum < cMaxPrimFaces; ++facenum)
+        {
+            Color color = primitive.PrimDefaultColor;
+            ColorMap::const_iterator c = primitive.PrimColors.find(facenum);
+            if (c != primitive.PrimColors.end())
+                color = c->second;
+
+            // Very transparent faces are not drawn, so need no material
+            if (color.a <= 0.11f)
+                continue;
+
+            if (!mat_override.empty())
+            {
+                material_names[facenum] = mat_override;
+                continue;
+            }
+
+            unsigned variation = OgreRenderer::LEGACYMAT_VERTEXCOL;
+
+            // Check for transparency
+            if (color.a < 1.0f)
+                variation = OgreRenderer::LEGACYMAT_VERTEXCOLALPHA;
+
+            // Check for fullbright
+            bool fullbright = (primitive.PrimDefaultMaterialType & RexTypes::MATERIALTYPE_FULLBRIGHT) != 0;
+            MaterialTypeMap::const_iterator mt = primitive.PrimMaterialTypes.find(facenum);
+            if (mt != primitive.PrimMaterialTypes.end())
+                fullbright = (mt->second & RexTypes::MATERIALTYPE_FULLBRIGHT) != 0;
+            if (fullbright)
+                variation |= OgreRenderer::LEGACYMAT_FULLBRIGHT;
+
+            std::string suffix = OgreRenderer::GetMaterialSuffix(variation);
+
+            // Try to find face's texture in texturemap, use default if not found
+            std::string texture_name = primitive.PrimDefaultTextureID;
+            TextureMap::const_iterator t = primitive.PrimTextures.find(facenum);
+            if (t != primitive.PrimTextures.end())
+                texture_name = t->second;
+
+            material_names[facenum] = texture_name + suffix;
+
+            // Create the material here if texture yet missing, the material will be updated later
+            OgreRenderer::GetOrCreateLegacyMaterial(texture_name, variation);
+        }
+    }
+
+    bool BuildPrimGeometry(const PrimShapeParams& params, PrimGeometry& geometry)
+    {
+        PROFILE(Primitive_BuildGeometry)
+
+        geometry.sections.clear();
+        geometry.error.clear();
+
         try
         {
-            float profileBegin = primitive.ProfileBegin.Get();
-            float profileEnd = 1.0f - primitive.ProfileEnd.Get();
-            float profileHollow = primitive.ProfileHollow.Get();
+            float profileBegin = params.profile_begin;
+            float profileEnd = 1.0f - params.profile_end;
+            float profileHollow = params.profile_hollow;
 
             int sides = 4;
-            if ((primitive.ProfileCurve.Get() & 0x07) == RexTypes::SHAPE_EQUILATERAL_TRIANGLE)
+            if ((params.profile_curve & 0x07) == RexTypes::SHAPE_EQUILATERAL_TRIANGLE)
                 sides = 3;
-            else if ((primitive.ProfileCurve.Get() & 0x07) == RexTypes::SHAPE_CIRCLE)
+            else if ((params.profile_curve & 0x07) == RexTypes::SHAPE_CIRCLE)
                 // Reduced prim lod!!!
                 sides = 12;
                 //sides = 24;
-            else if ((primitive.ProfileCurve.Get() & 0x07) == RexTypes::SHAPE_HALF_CIRCLE)
+            else if ((params.profile_curve & 0x07) == RexTypes::SHAPE_HALF_CIRCLE)
             {
                 // half circle, prim is a sphere
                 // Reduced prim lod!!!
@@ -144,194 +345,263 @@ namespace RexLogic
             }
 
             int hollowSides = sides;
-            if ((primitive.ProfileCurve.Get() & 0xf0) == RexTypes::HOLLOW_CIRCLE)
+            if ((params.profile_curve & 0xf0) == RexTypes::HOLLOW_CIRCLE)
                 // Reduced prim lod!!!
                 hollowSides = 12;
                 //hollowSides = 24;
-            else if ((primitive.ProfileCurve.Get() & 0xf0) == RexTypes::HOLLOW_SQUARE)
+            else if ((params.profile_curve & 0xf0) == RexTypes::HOLLOW_SQUARE)
                 hollowSides = 4;
-            else if ((primitive.ProfileCurve.Get() & 0xf0) == RexTypes::HOLLOW_TRIANGLE)
+            else if ((params.profile_curve & 0xf0) == RexTypes::HOLLOW_TRIANGLE)
                 hollowSides = 3;
-            
+
             PrimMesher::PrimMesh primMesh(sides, profileBegin, profileEnd, profileHollow, hollowSides);
-            primMesh.topShearX = primitive.PathShearX.Get();
-            primMesh.topShearY = primitive.PathShearY.Get();
-            primMesh.pathCutBegin = primitive.PathBegin.Get();
-            primMesh.pathCutEnd = 1.0f - primitive.PathEnd.Get();
+            primMesh.topShearX = params.path_shear_x;
+            primMesh.topShearY = params.path_shear_y;
+            primMesh.pathCutBegin = params.path_begin;
+            primMesh.pathCutEnd = 1.0f - params.path_end;
 
-            if (primitive.PathCurve.Get() == RexTypes::EXTRUSION_STRAIGHT)
+            if (params.path_curve == RexTypes::EXTRUSION_STRAIGHT)
             {
-                primMesh.twistBegin = primitive.PathTwistBegin.Get() * 180;
-                primMesh.twistEnd = primitive.PathTwist.Get() * 180;
-                primMesh.taperX = primitive.PathScaleX.Get() - 1.0f;
-                primMesh.taperY = primitive.PathScaleY.Get() - 1.0f;
+                primMesh.twistBegin = params.path_twist_begin * 180;
+                primMesh.twistEnd = params.path_twist * 180;
+                primMesh.taperX = params.path_scale_x - 1.0f;
+                primMesh.taperY = params.path_scale_y - 1.0f;
                 primMesh.ExtrudeLinear();
             }
             else
             {
-                primMesh.holeSizeX = (2.0f - primitive.PathScaleX.Get());
-                primMesh.holeSizeY = (2.0f - primitive.PathScaleY.Get());
-                primMesh.radius = primitive.PathRadiusOffset.Get();
-                primMesh.revolutions = primitive.PathRevolutions.Get();
-                primMesh.skew = primitive.PathSkew.Get();
-                primMesh.twistBegin = primitive.PathTwistBegin.Get() * 360;
-                primMesh.twistEnd = primitive.PathTwist.Get() * 360;
-                primMesh.taperX = primitive.PathTaperX.Get();
-                primMesh.taperY = primitive.PathTaperY.Get();
+                primMesh.holeSizeX = (2.0f - params.path_scale_x);
+                primMesh.holeSizeY = (2.0f - params.path_scale_y);
+                primMesh.radius = params.path_radius_offset;
+                primMesh.revolutions = params.path_revolutions;
+                primMesh.skew = params.path_skew;
+                primMesh.twistBegin = params.path_twist_begin * 360;
+                primMesh.twistEnd = params.path_twist * 360;
+                primMesh.taperX = params.path_taper_x;
+                primMesh.taperY = params.path_taper_y;
                 primMesh.ExtrudeCircular();
             }
-            
-            PROFILE(Primitive_CreateManualObject)
-            prim_manual_object->clear();
-            prim_manual_object->setBoundingBox(Ogre::AxisAlignedBox());
-            
+
             // Check for highly illegal coordinates in any of the faces
             for (int i = 0; i < primMesh.viewerFaces.size(); ++i)
             {
                 if (!(CheckCoord(primMesh.viewerFaces[i].v1) && CheckCoord(primMesh.viewerFaces[i].v2) && CheckCoord(primMesh.viewerFaces[i].v3)))
                 {
-                    RexLogicModule::LogError("NaN or infinite number encountered in prim face coordinates. Skipping geometry creation.");
-                    return 0;
+                    geometry.error = "NaN or infinite number encountered in prim face coordinates. Skipping geometry creation.";
+                    return false;
                 }
             }
-            
-            std::string mat_name;
-            std::string prev_mat_name;
-            
-            uint indices = 0;
-            bool first_face = true;
-            
+
+            PrimGeometrySection* section = 0;
+            int prev_group = -1;
+
             for (int i = 0; i < primMesh.viewerFaces.size(); ++i)
             {
-                int facenum = primMesh.viewerFaces[i].primFaceNumber;
-                
-                Color color = primitive.PrimDefaultColor;
-                ColorMap::const_iterator c = primitive.PrimColors.find(facenum);
-                if (c != primitive.PrimColors.end())
-                    color = c->second;
-                
+                const PrimMesher::ViewerFace& face = primMesh.viewerFaces[i];
+                const int facenum = GetFaceIndex(face.primFaceNumber);
+                const Color& color = params.colors[facenum];
+
                 // Skip face if very transparent
                 if (color.a <= 0.11f)
                     continue;
-                
-                if (!mat_override.empty())
-                    mat_name = mat_override;
-                else
+
+                if (params.optimisations_enabled)
                 {
-                    unsigned variation = OgreRenderer::LEGACYMAT_VERTEXCOL;
-                    
-                    // Check for transparency
-                    if (color.a < 1.0f)
-                        variation = OgreRenderer::LEGACYMAT_VERTEXCOLALPHA;
-                    
-                    // Check for fullbright
-                    bool fullbright = (primitive.PrimDefaultMaterialType & RexTypes::MATERIALTYPE_FULLBRIGHT) != 0;
-                    MaterialTypeMap::const_iterator mt = primitive.PrimMaterialTypes.find(facenum);
-                    if (mt != primitive.PrimMaterialTypes.end())
-                        fullbright = (mt->second & RexTypes::MATERIALTYPE_FULLBRIGHT) != 0;
-                    if (fullbright)
-                        variation |= OgreRenderer::LEGACYMAT_FULLBRIGHT;
-                    
-                    std::string suffix = OgreRenderer::GetMaterialSuffix(variation);
-                    
-                    // Try to find face's texture in texturemap, use default if not found
-                    std::string texture_name = primitive.PrimDefaultTextureID;
-                    TextureMap::const_iterator t = primitive.PrimTextures.find(facenum);
-                    if (t != primitive.PrimTextures.end())
-                        texture_name = t->second;
-                    
-                    mat_name = texture_name + suffix;
-                    
-                    // Create the material here if texture yet missing, the material will be updated later
-                    OgreRenderer::GetOrCreateLegacyMaterial(texture_name, variation);
+                    if (!section || params.material_groups[facenum] != prev_group)
+                        section = 0;
+                    prev_group = params.material_groups[facenum];
                 }
-                
-                // Get texture mapping parameters
-                float repeat_u = primitive.PrimDefaultRepeatU;
-                float repeat_v = primitive.PrimDefaultRepeatV;
-                float offset_u = primitive.PrimDefaultOffsetU;
-                float offset_v = primitive.PrimDefaultOffsetV;
-                float rot = primitive.PrimDefaultUVRotation;
-                if (primitive.PrimRepeatU.find(facenum) != primitive.PrimRepeatU.end())
-                    repeat_u = primitive.PrimRepeatU[facenum];
-                if (primitive.PrimRepeatV.find(facenum) != primitive.PrimRepeatV.end())
-                    repeat_v = primitive.PrimRepeatV[facenum];
-                if (primitive.PrimOffsetU.find(facenum) != primitive.PrimOffsetU.end())
-                    offset_u = primitive.PrimOffsetU[facenum];
-                if (primitive.PrimOffsetV.find(facenum) != primitive.PrimOffsetV.end())
-                    offset_v = primitive.PrimOffsetV[facenum];
-                if (primitive.PrimUVRotation.find(facenum) != primitive.PrimUVRotation.end())
-                    rot = primitive.PrimUVRotation[facenum];
-                float rot_sin = sin(-rot);
-                float rot_cos = cos(-rot);
-
-                if (optimisations_enabled || primitive.DrawType == RexTypes::DRAWTYPE_MESH)
+                else if (i % 2 == 0)
+                    section = 0;
+
+                if (!section)
                 {
-                    if ((first_face) || (mat_name != prev_mat_name))
-                    {
-                        if (indices)
-                            prim_manual_object->end();
-                        indices = 0;
-                        prim_manual_object->begin(mat_name, Ogre::RenderOperation::OT_TRIANGLE_LIST);
-                        prev_mat_name = mat_name;
-                        first_face = false;
-                    }
+                    geometry.sections.push_back(PrimGeometrySection());
+                    section = &geometry.sections.back();
+                    section->face = facenum;
                 }
-                else
+
+                float rot_sin = sin(-params.uv_rotation[facenum]);
+                float rot_cos = cos(-params.uv_rotation[facenum]);
+
+                const PrimMesher::Coord* positions[3] = { &face.v1, &face.v2, &face.v3 };
+                const PrimMesher::Coord* normals[3] = { &face.n1, &face.n2, &face.n3 };
+                const PrimMesher::UVCoord* uvs[3] = { &face.uv1, &face.uv2, &face.uv3 };
+
+                for (int j = 0; j < 3; ++j)
                 {
-                    if (i % 2 == 0)
-                    {
-                        if (indices)
-                            prim_manual_object->end();
-                        indices = 0;
-                        prim_manual_object->begin(mat_name, Ogre::RenderOperation::OT_TRIANGLE_LIST);
-                    }
+                    Ogre::Vector2 uv(uvs[j]->U, uvs[j]->V);
+                    TransformUV(uv, params.repeat_u[facenum], params.repeat_v[facenum], params.offset_u[facenum], params.offset_v[facenum],
+                        rot_sin, rot_cos);
+
+                    const float vertex[cPrimVertexFloats] = {
+                        positions[j]->X, positions[j]->Y, positions[j]->Z,
+                        normals[j]->X, normals[j]->Y, normals[j]->Z,
+                        uv.x, uv.y,
+                        color.r, color.g, color.b, color.a };
+                    section->vertices.insert(section->vertices.end(), vertex, vertex + cPrimVertexFloats);
                 }
-                
-                Ogre::Vector3 pos1(primMesh.viewerFaces[i].v1.X, primMesh.viewerFaces[i].v1.Y, primMesh.viewerFaces[i].v1.Z);
-                Ogre::Vector3 pos2(primMesh.viewerFaces[i].v2.X, primMesh.viewerFaces[i].v2.Y, primMesh.viewerFaces[i].v2.Z);
-                Ogre::Vector3 pos3(primMesh.viewerFaces[i].v3.X, primMesh.viewerFaces[i].v3.Y, primMesh.viewerFaces[i].v3.Z);
-
-                Ogre::Vector3 n1(primMesh.viewerFaces[i].n1.X, primMesh.viewerFaces[i].n1.Y, primMesh.viewerFaces[i].n1.Z);
-                Ogre::Vector3 n2(primMesh.viewerFaces[i].n2.X, primMesh.viewerFaces[i].n2.Y, primMesh.viewerFaces[i].n2.Z);
-                Ogre::Vector3 n3(primMesh.viewerFaces[i].n3.X, primMesh.viewerFaces[i].n3.Y, primMesh.viewerFaces[i].n3.Z);
-                
-                Ogre::Vector2 uv1(primMesh.viewerFaces[i].uv1.U, primMesh.viewerFaces[i].uv1.V);
-                Ogre::Vector2 uv2(primMesh.viewerFaces[i].uv2.U, primMesh.viewerFaces[i].uv2.V);
-                Ogre::Vector2 uv3(primMesh.viewerFaces[i].uv3.U, primMesh.viewerFaces[i].uv3.V);
-
-                TransformUV(uv1, repeat_u, repeat_v, offset_u, offset_v, rot_sin, rot_cos);
-                TransformUV(uv2, repeat_u, repeat_v, offset_u, offset_v, rot_sin, rot_cos);
-                TransformUV(uv3, repeat_u, repeat_v, offset_u, offset_v, rot_sin, rot_cos);
-
-                prim_manual_object->position(pos1);
-                prim_manual_object->normal(n1);
-                prim_manual_object->textureCoord(uv1);
-                prim_manual_object->colour(color.r, color.g, color.b, color.a);
-                
-                prim_manual_object->position(pos2);
-                prim_manual_object->normal(n2);
-                prim_manual_object->textureCoord(uv2);
-                prim_manual_object->colour(color.r, color.g, color.b, color.a);
-                
-                prim_manual_object->position(pos3);
-                prim_manual_object->normal(n3);
-                prim_manual_object->textureCoord(uv3);
-                prim_manual_object->colour(color.r, color.g, color.b, color.a);
-                
-                prim_manual_object->index(indices++);
-                prim_manual_object->index(indices++);
-                prim_manual_object->index(indices++);
             }
-            
-            // End last subsection
-            if (indices)
-                prim_manual_object->end();
         }
         catch (Exception& e)
         {
-            RexLogicModule::LogError(std::string("Exception while creating primitive geometry: ") + e.what());
+            geometry.error = std::string("Exception while creating primitive geometry: ") + e.what();
+            geometry.sections.clear();
+            return false;
+        }
+
+        return true;
+    }
+
+    Ogre::MeshPtr CreatePrimMesh(const std::string& mesh_name, const PrimGeometry& geometry)
+    {
+        PROFILE(Primitive_CreateMesh)
+
+        if (geometry.sections.empty())
+            return Ogre::MeshPtr();
+
+        Ogre::MeshPtr mesh;
+        try
+        {
+            mesh = Ogre::MeshManager::getSingleton().createManual(mesh_name, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
+
+            const Ogre::VertexElementType colour_type = Ogre::VertexElement::getBestColourVertexElementType();
+            Ogre::AxisAlignedBox bounds;
+            float radius_sq = 0.0f;
+
+            for (uint i = 0; i < geometry.sections.size(); ++i)
+            {
+                const PrimGeometrySection& section = geometry.sections[i];
+                const size_t vertex_count = section.vertices.size() / cPrimVertexFloats;
+
+                Ogre::SubMesh* submesh = mesh->createSubMesh();
+                submesh->useSharedVertices = false;
+                submesh->operationType = Ogre::RenderOperation::OT_TRIANGLE_LIST;
+                submesh->setMaterialName("LitTextured");
+
+                submesh->vertexData = new Ogre::VertexData();
+                submesh->vertexData->vertexStart = 0;
+                submesh->vertexData->vertexCount = vertex_count;
+                Ogre::VertexDeclaration* decl = submesh->vertexData->vertexDeclaration;
+                size_t offset = 0;
+                decl->addElement(0, offset, Ogre::VET_FLOAT3, Ogre::VES_POSITION);
+                offset += Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT3);
+                decl->addElement(0, offset, Ogre::VET_FLOAT3, Ogre::VES_NORMAL);
+                offset += Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT3);
+                decl->addElement(0, offset, Ogre::VET_FLOAT2, Ogre::VES_TEXTURE_COORDINATES, 0);
+                offset += Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT2);
+                decl->addElement(0, offset, colour_type, Ogre::VES_DIFFUSE);
+                offset += Ogre::VertexElement::getTypeSize(colour_type);
+
+                // Keep a copy in system memory, as raycasts read the vertices back
+                Ogre::HardwareVertexBufferSharedPtr vbuf = Ogre::HardwareBufferManager::getSingleton().createVertexBuffer(
+                    offset, vertex_count, Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY, true);
+                submesh->vertexData->vertexBufferBinding->setBinding(0, vbuf);
+
+                unsigned char* dest = static_cast<unsigned char*>(vbuf->lock(Ogre::HardwareBuffer::HBL_DISCARD));
+                for (size_t v = 0; v < vertex_count; ++v)
+                {
+                    const float* src = &section.vertices[v * cPrimVertexFloats];
+                    memcpy(dest, src, 8 * sizeof(float));
+                    Ogre::RGBA colour = Ogre::VertexElement::convertColourValue(Ogre::ColourValue(src[8], src[9], src[10], src[11]), colour_type);
+                    memcpy(dest + 8 * sizeof(float), &colour, sizeof(colour));
+                    dest += offset;
+
+                    Ogre::Vector3 pos(src[0], src[1], src[2]);
+                    bounds.merge(pos);
+                    radius_sq = std::max(radius_sq, pos.squaredLength());
+                }
+                vbuf->unlock();
+
+                // The vertices are not shared between triangles, so the indices just run through them
+                const bool use_32bit = vertex_count > 0xffff;
+                Ogre::HardwareIndexBufferSharedPtr ibuf = Ogre::HardwareBufferManager::getSingleton().createIndexBuffer(
+                    use_32bit ? Ogre::HardwareIndexBuffer::IT_32BIT : Ogre::HardwareIndexBuffer::IT_16BIT, vertex_count,
+                    Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY, true);
+                void* indices = ibuf->lock(Ogre::HardwareBuffer::HBL_DISCARD);
+                for (size_t v = 0; v < vertex_count; ++v)
+                {
+                    if (use_32bit)
+                        static_cast<u32*>(indices)[v] = (u32)v;
+                    else
+                        static_cast<u16*>(indices)[v] = (u16)v;
+                }
+                ibuf->unlock();
+                submesh->indexData->indexBuffer = ibuf;
+                submesh->indexData->indexStart = 0;
+                submesh->indexData->indexCount = vertex_count;
+            }
+
+            mesh->_setBounds(bounds);
+            mesh->_setBoundingSphereRadius(sqrt(radius_sq));
+            mesh->load();
+        }
+        catch (Ogre::Exception& e)
+        {
+            RexLogicModule::LogError("Could not create prim mesh: " + std::string(e.what()));
+            if (!mesh.isNull())
+                Ogre::MeshManager::getSingleton().remove(mesh_name);
+            return Ogre::MeshPtr();
+        }
+
+        return mesh;
+    }
+
+    Ogre::ManualObject* CreatePrimGeometry(Foundation::Framework* framework, EC_OpenSimPrim& primitive, bool optimisations_enabled)
+    {
+        PROFILE(Primitive_CreateGeometry)
+        
+        if (!primitive.HasPrimShapeData)
             return 0;
+        
+        // Create only a single manual object for prim geometry and reuse it over and over, to avoid Ogre generating
+        // a huge load of unnecessary D3D resources, that are never used for anything visible (the manual object will
+        // be converted to a mesh anyway)
+        if (!prim_manual_object)
+        {
+            OgreRenderer::RendererPtr renderer = framework->GetServiceManager()->GetService<OgreRenderer::Renderer>(Service::ST_Renderer).lock();
+            if (!renderer)
+                return 0;
+            Ogre::SceneManager *sceneMgr = renderer->GetSceneManager();
+            prim_manual_object = sceneMgr->createManualObject(renderer->GetUniqueObjectName());
+            if (!prim_manual_object)
+                return 0;
+        }
+        
+        std::vector<std::string> material_names;
+        GetPrimFaceMaterials(framework, primitive, material_names);
+
+        PrimShapeParams params;
+        params.Set(primitive, material_names, optimisations_enabled);
+
+        PrimGeometry geometry;
+        if (!BuildPrimGeometry(params, geometry))
+        {
+            RexLogicModule::LogError(geometry.error);
+            return 0;
+        }
+        
+        PROFILE(Primitive_CreateManualObject)
+        prim_manual_object->clear();
+        prim_manual_object->setBoundingBox(Ogre::AxisAlignedBox());
+
+        for (uint i = 0; i < geometry.sections.size(); ++i)
+        {
+            const PrimGeometrySection& section = geometry.sections[i];
+            prim_manual_object->begin(material_names[section.face], Ogre::RenderOperation::OT_TRIANGLE_LIST);
+
+            const uint vertex_count = section.vertices.size() / cPrimVertexFloats;
+            for (uint v = 0; v < vertex_count; ++v)
+            {
+                const float* src = &section.vertices[v * cPrimVertexFloats];
+                prim_manual_object->position(src[0], src[1], src[2]);
+                prim_manual_object->normal(src[3], src[4], src[5]);
+                prim_manual_object->textureCoord(src[6], src[7]);
+                prim_manual_object->colour(src[8], src[9], src[10], src[11]);
+                prim_manual_object->index(v);
+            }
+
+            prim_manual_object->end();
         }
         
         return prim_manual_object;
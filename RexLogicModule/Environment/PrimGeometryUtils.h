@@ -4,6 +4,9 @@
 #define incl_RexLogicModule_PrimGeometryUtils_h
 
 #include "RexLogicModuleApi.h"
+#include "Color.h"
+
+#include <OgreMesh.h>
 
 class EC_OpenSimPrim;
 
@@ -14,6 +17,100 @@ namespace Ogre
 
 namespace RexLogic
 {
+    //! Maximum number of faces of a prim
+    static const int cMaxPrimFaces = 9;
+
+    //! Number of floats in a vertex of PrimGeometrySection: position xyz, normal xyz, texture coordinate uv and colour rgba
+    static const int cPrimVertexFloats = 12;
+
+    //! Everything that affects the geometry of a prim, copied from EC_OpenSimPrim so that the prim can be meshed in a worker thread
+    /*! Prims that have equal parameters get identical geometry, and can share one mesh with their own materials.
+     */
+    struct REXLOGIC_MODULE_API PrimShapeParams
+    {
+        PrimShapeParams();
+
+        //! Fills the parameters from a prim.
+        /*! \param material_names Material name of each face, as returned by GetPrimFaceMaterials
+            \param optimisations_enabled If true, or if the prim is drawn as a mesh, consecutive faces of the same material
+                   are put to the same submesh
+         */
+        void Set(const EC_OpenSimPrim& primitive, const std::vector<std::string>& material_names, bool optimisations_enabled);
+
+        //! Returns a hash of all the parameters
+        size_t Hash() const;
+
+        bool operator ==(const PrimShapeParams& rhs) const;
+        bool operator !=(const PrimShapeParams& rhs) const { return !(*this == rhs); }
+
+        int path_curve;
+        int profile_curve;
+        float path_begin;
+        float path_end;
+        float path_scale_x;
+        float path_scale_y;
+        float path_shear_x;
+        float path_shear_y;
+        float path_twist;
+        float path_twist_begin;
+        float path_radius_offset;
+        float path_taper_x;
+        float path_taper_y;
+        float path_revolutions;
+        float path_skew;
+        float profile_begin;
+        float profile_end;
+        float profile_hollow;
+
+        //! If false, a new submesh is started every second face regardless of the materials
+        bool optimisations_enabled;
+
+        //! Vertex colour of each face. Faces that are almost fully transparent are left out.
+        Color colors[cMaxPrimFaces];
+
+        //! Texture mapping parameters of each face
+        float repeat_u[cMaxPrimFaces];
+        float repeat_v[cMaxPrimFaces];
+        float offset_u[cMaxPrimFaces];
+        float offset_v[cMaxPrimFaces];
+        float uv_rotation[cMaxPrimFaces];
+
+        //! For each face, the lowest face number that has the same material. Decides how the faces are split into submeshes.
+        u8 material_groups[cMaxPrimFaces];
+    };
+
+    //! A submesh of prim geometry: triangle list of non-indexed vertices in the format of cPrimVertexFloats
+    struct PrimGeometrySection
+    {
+        //! Face number of the first triangle, whose material the submesh uses
+        u8 face;
+
+        std::vector<float> vertices;
+    };
+
+    //! Prim geometry created by BuildPrimGeometry
+    struct PrimGeometry
+    {
+        std::vector<PrimGeometrySection> sections;
+
+        //! Description of what went wrong if the geometry could not be built
+        std::string error;
+    };
+
+    //! Returns the material name of each face of a prim, creating the legacy materials the faces need if they do not exist yet.
+    REXLOGIC_MODULE_API void GetPrimFaceMaterials(Foundation::Framework* framework, EC_OpenSimPrim& primitive, std::vector<std::string>& material_names);
+
+    //! Generates prim geometry from shape parameters. Uses no Ogre resources, so can be called from any thread.
+    /*! \return true if successful, false with geometry.error set if the parameters give illegal geometry
+     */
+    REXLOGIC_MODULE_API bool BuildPrimGeometry(const PrimShapeParams& params, PrimGeometry& geometry);
+
+    //! Creates an Ogre mesh of prim geometry, with one submesh for each section. Call from the main thread only.
+    /*! The submeshes use a default material; set the materials of each face on the entities created from the mesh.
+        \return the mesh, or null if the geometry is empty or the mesh could not be created
+     */
+    REXLOGIC_MODULE_API Ogre::MeshPtr CreatePrimMesh(const std::string& mesh_name, const PrimGeometry& geometry);
+
     //! Generates prim geometry into an Ogre manual object from prim parameters and returns it or 0 if something went wrong
     /*! Note that the same manual object is returned for each call, so you should immediately CommitChanges() into an
         EC_OgreCustomObject before calling CreatePrimGeometry again.
@@ -21,4 +118,4 @@ namespace RexLogic
     REXLOGIC_MODULE_API Ogre::ManualObject* CreatePrimGeometry(Foundation::Framework* framework, EC_OpenSimPrim& primitive, bool optimisations_enabled = true);
 }
 
-#endif
\ No newline at end of file
+#endif
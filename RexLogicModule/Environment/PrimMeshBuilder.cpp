@@ -0,0 +1,41 @@
+/**
+ *  For conditions of distribution and use, see copyright notice in license.txt
+ *
+ *  @file   PrimMeshBuilder.cpp
+ *  @brief  Generates prim geometry in worker threads.
+ */
+
+#include "StableHeaders.h"
+
+#include "Environment/PrimMeshBuilder.h"
+
+namespace RexLogic
+{
+    static const std::string task_description("PrimMeshBuilder");
+
+    //! Number of shapes meshed at the same time
+    static const uint cMaxConcurrentPrimMeshes = 4;
+
+    PrimMeshBuilder::PrimMeshBuilder() :
+        Foundation::ThreadTask(task_description, cMaxConcurrentPrimMeshes)
+    {
+    }
+
+    const std::string& PrimMeshBuilder::GetTaskDescriptionStatic()
+    {
+        return task_description;
+    }
+
+    void PrimMeshBuilder::ProcessRequest(Foundation::ThreadTaskRequestPtr request)
+    {
+        PrimMeshRequestPtr mesh_request = boost::dynamic_pointer_cast<PrimMeshRequest>(request);
+        if (!mesh_request)
+            return;
+
+        PrimMeshResultPtr result(new PrimMeshResult());
+        result->tag_ = mesh_request->tag_;
+        result->hash_ = mesh_request->hash_;
+        result->success_ = BuildPrimGeometry(mesh_request->params_, result->geometry_);
+        QueueResult<PrimMeshResult>(result);
+    }
+}
@@ -0,0 +1,66 @@
+/**
+ *  For conditions of distribution and use, see copyright notice in license.txt
+ *
+ *  @file   PrimMeshBuilder.h
+ *  @brief  Generates prim geometry in worker threads.
+ */
+
+#ifndef incl_RexLogicModule_PrimMeshBuilder_h
+#define incl_RexLogicModule_PrimMeshBuilder_h
+
+#include "ThreadTask.h"
+#include "Environment/PrimGeometryUtils.h"
+
+namespace RexLogic
+{
+    //! Request to generate the geometry of a prim shape in a worker thread
+    class PrimMeshRequest : public Foundation::ThreadTaskRequest
+    {
+    public:
+        PrimMeshRequest() : hash_(0) {}
+
+        //! Shape parameters, copied from the prim
+        PrimShapeParams params_;
+
+        //! Hash of the parameters, with which the result is matched to the prims waiting for it
+        size_t hash_;
+    };
+
+    //! Generated prim geometry
+    class PrimMeshResult : public Foundation::ThreadTaskResult
+    {
+    public:
+        PrimMeshResult() : hash_(0), success_(false) {}
+
+        //! Hash of the shape parameters the geometry was generated from
+        size_t hash_;
+
+        //! True if the geometry was generated, false if the parameters give illegal geometry
+        bool success_;
+
+        //! The geometry, to be converted to a mesh in the main thread
+        PrimGeometry geometry_;
+    };
+
+    typedef boost::shared_ptr<PrimMeshRequest> PrimMeshRequestPtr;
+    typedef boost::shared_ptr<PrimMeshResult> PrimMeshResultPtr;
+
+    //! Runs PrimMesher extrusion for prim shapes in the thread pool, used by Primitive.
+    /*! Each unique shape is meshed only once; Primitive shares the resulting mesh between all the prims of that shape.
+     */
+    class PrimMeshBuilder : public Foundation::ThreadTask
+    {
+    public:
+        //! Constructor.
+        PrimMeshBuilder();
+
+        //! @return Task description of the builder.
+        static const std::string& GetTaskDescriptionStatic();
+
+    protected:
+        //! Generates the geometry of a shape. Called from the thread pool.
+        virtual void ProcessRequest(Foundation::ThreadTaskRequestPtr request);
+    };
+}
+
+#endif
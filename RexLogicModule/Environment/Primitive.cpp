@@ -32,13 +32,16 @@
 #include "SceneEvents.h"
 #include "ResourceInterface.h"
 #include "Environment/PrimGeometryUtils.h"
+#include "Environment/PrimMeshBuilder.h"
 #include "SceneManager.h"
 #include "AssetServiceInterface.h"
 #include "ISoundService.h"
 #include "GenericMessageUtils.h"
+#include "RealXtend/RexProtocolMessageViews.h"
 #include "EventManager.h"
 #include "ServiceManager.h"
 #include "WorldStream.h"
+#include "ThreadTaskManager.h"
 
 #include "EC_NetworkPosition.h"
 #ifdef EC_HoveringText_ENABLED
@@ -49,6 +52,9 @@
 #include "IAttribute.h"
 
 #include <OgreSceneNode.h>
+#include <OgreEntity.h>
+#include <OgreMeshManager.h>
+#include <OgreResourceGroupManager.h>
 
 #include <QUrl>
 #include <QColor>
@@ -57,7 +63,12 @@
 namespace RexLogic
 {
 
-Primitive::Primitive(RexLogicModule *rexlogicmodule) : rexlogicmodule_(rexlogicmodule)
+//! Interval at which the shared prim meshes that are not used any more are removed, in seconds
+static const f64 cPrimMeshCleanupInterval = 10.0;
+
+Primitive::Primitive(RexLogicModule *rexlogicmodule) :
+    rexlogicmodule_(rexlogicmodule),
+    prim_mesh_cleanup_time_(0.0)
 {
 }
 
@@ -68,6 +79,13 @@ Primitive::~Primitive()
 void Primitive::Update(f64 frametime)
 {
     SerializeECsToNetwork();
+
+    prim_mesh_cleanup_time_ += frametime;
+    if (prim_mesh_cleanup_time_ >= cPrimMeshCleanupInterval)
+    {
+        prim_mesh_cleanup_time_ = 0.0;
+        RemoveUnusedPrimMeshes();
+    }
 }
 
 Scene::EntityPtr Primitive::GetOrCreatePrimEntity(entity_id_t entityid, const RexUUID &fullid, bool *created)
@@ -131,22 +149,21 @@ Scene::EntityPtr Primitive::CreateNewPrimEntity(entity_id_t entityid)
 
 bool Primitive::HandleOSNE_ObjectUpdate(ProtocolUtilities::NetworkEventInboundData* data)
 {
-    ProtocolUtilities::NetInMessage *msg = data->message;
+    ProtocolUtilities::ObjectUpdateView view;
+    if (!view.Parse(*data->message))
+    {
+        RexLogicModule::LogError("Malformed ObjectUpdate packet received, ignoring.");
+        return false;
+    }
 
-    msg->ResetReading();
-    uint64_t regionhandle = msg->ReadU64();
-    msg->SkipToNextVariable(); // TimeDilation U16
+    uint64_t regionhandle = view.RegionData().RegionHandle();
 
     // Variable block: Object Data
-    size_t instance_count = data->message->ReadCurrentBlockInstanceCount();
-    for(size_t i = 0; i < instance_count; ++i)
-    {
-        uint32_t localid = msg->ReadU32();
-        msg->SkipToNextVariable();        // State U8
-        RexUUID fullid = msg->ReadUUID();
-        msg->SkipToNextVariable();        // CRC U32
-        uint8_t pcode = msg->ReadU8();
-        UNREFERENCED_PARAM(pcode);
+    for(size_t i = 0; i < view.ObjectDataCount(); ++i)
+    {
+        ProtocolUtilities::ObjectUpdateView::ObjectDataBlock object = view.ObjectData(i);
+        uint32_t localid = object.ID();
+        RexUUID fullid = object.FullID();
         bool was_created;
 
         Scene::EntityPtr entity = GetOrCreatePrimEntity(localid, fullid, &was_created);
@@ -157,16 +174,16 @@ bool Primitive::HandleOSNE_ObjectUpdate(ProtocolUtilities::NetworkEventInboundDa
         ///      Will cause problems with multigrid support.
         prim->RegionHandle = regionhandle;
 
-        prim->Material = msg->ReadU8();
-        prim->ClickAction = msg->ReadU8();
+        prim->Material = object.Material();
+        prim->ClickAction = object.ClickAction();
 
-        prim->Scale = msg->ReadVector3();
+        prim->Scale = object.Scale();
         // Scale is not handled by interpolation system, so set directly
         HandlePrimScaleAndVisibility(localid);
 
-        size_t bytes_read = 0;
-        const uint8_t *objectdatabytes = msg->ReadBuffer(&bytes_read);
-        if (bytes_read == 60)
+        ProtocolUtilities::NetBufferRef objectdata = object.ObjectData();
+        const uint8_t *objectdatabytes = objectdata.data;
+        if (objectdata.size == 60)
         {
             // The data contents:
             // ofs  0 - pos xyz - 3 x float (3x4 bytes)
@@ -195,45 +212,41 @@ bool Primitive::HandleOSNE_ObjectUpdate(ProtocolUtilities::NetworkEventInboundDa
             netpos->Updated();
         }
         else
-            RexLogicModule::LogError("Error reading ObjectData for prim:" + ToString(prim->LocalId) + ". Bytes read:" + ToString(bytes_read));
+            RexLogicModule::LogError("Error reading ObjectData for prim:" + ToString(prim->LocalId) + ". Bytes read:" + ToString(objectdata.size));
 
-        prim->ParentId = msg->ReadU32();
-        prim->UpdateFlags = msg->ReadU32();
+        prim->ParentId = object.ParentID();
+        prim->UpdateFlags = object.UpdateFlags();
 
         // Read prim shape
-        prim->PathCurve.Set(msg->ReadU8(), AttributeChange::LocalOnly);
-        prim->ProfileCurve.Set(msg->ReadU8(), AttributeChange::LocalOnly);
-        prim->PathBegin.Set(msg->ReadU16() * 0.00002f, AttributeChange::LocalOnly);
-        prim->PathEnd.Set(msg->ReadU16() * 0.00002f, AttributeChange::LocalOnly);
-        prim->PathScaleX.Set(msg->ReadU8() * 0.01f, AttributeChange::LocalOnly);
-        prim->PathScaleY.Set(msg->ReadU8() * 0.01f, AttributeChange::LocalOnly);
-        prim->PathShearX.Set(((int8_t)msg->ReadU8()) * 0.01f, AttributeChange::LocalOnly);
-        prim->PathShearY.Set(((int8_t)msg->ReadU8()) * 0.01f, AttributeChange::LocalOnly);
-        prim->PathTwist.Set(msg->ReadS8() * 0.01f, AttributeChange::LocalOnly);
-        prim->PathTwistBegin.Set(msg->ReadS8() * 0.01f, AttributeChange::LocalOnly);
-        prim->PathRadiusOffset.Set(msg->ReadS8() * 0.01f, AttributeChange::LocalOnly);
-        prim->PathTaperX.Set(msg->ReadS8() * 0.01f, AttributeChange::LocalOnly);
-        prim->PathTaperY.Set(msg->ReadS8() * 0.01f, AttributeChange::LocalOnly);
-        prim->PathRevolutions.Set(1.0f + msg->ReadU8() * 0.015f, AttributeChange::LocalOnly);
-        prim->PathSkew.Set( msg->ReadS8() * 0.01f, AttributeChange::LocalOnly);
-        prim->ProfileBegin.Set(msg->ReadU16() * 0.00002f, AttributeChange::LocalOnly);
-        prim->ProfileEnd.Set(msg->ReadU16() * 0.00002f, AttributeChange::LocalOnly);
-        prim->ProfileHollow.Set(msg->ReadU16() * 0.00002f, AttributeChange::LocalOnly);
+        prim->PathCurve.Set(object.PathCurve(), AttributeChange::LocalOnly);
+        prim->ProfileCurve.Set(object.ProfileCurve(), AttributeChange::LocalOnly);
+        prim->PathBegin.Set(object.PathBegin() * 0.00002f, AttributeChange::LocalOnly);
+        prim->PathEnd.Set(object.PathEnd() * 0.00002f, AttributeChange::LocalOnly);
+        prim->PathScaleX.Set(object.PathScaleX() * 0.01f, AttributeChange::LocalOnly);
+        prim->PathScaleY.Set(object.PathScaleY() * 0.01f, AttributeChange::LocalOnly);
+        prim->PathShearX.Set(((int8_t)object.PathShearX()) * 0.01f, AttributeChange::LocalOnly);
+        prim->PathShearY.Set(((int8_t)object.PathShearY()) * 0.01f, AttributeChange::LocalOnly);
+        prim->PathTwist.Set(object.PathTwist() * 0.01f, AttributeChange::LocalOnly);
+        prim->PathTwistBegin.Set(object.PathTwistBegin() * 0.01f, AttributeChange::LocalOnly);
+        prim->PathRadiusOffset.Set(object.PathRadiusOffset() * 0.01f, AttributeChange::LocalOnly);
+        prim->PathTaperX.Set(object.PathTaperX() * 0.01f, AttributeChange::LocalOnly);
+        prim->PathTaperY.Set(object.PathTaperY() * 0.01f, AttributeChange::LocalOnly);
+        prim->PathRevolutions.Set(1.0f + object.PathRevolutions() * 0.015f, AttributeChange::LocalOnly);
+        prim->PathSkew.Set(object.PathSkew() * 0.01f, AttributeChange::LocalOnly);
+        prim->ProfileBegin.Set(object.ProfileBegin() * 0.00002f, AttributeChange::LocalOnly);
+        prim->ProfileEnd.Set(object.ProfileEnd() * 0.00002f, AttributeChange::LocalOnly);
+        prim->ProfileHollow.Set(object.ProfileHollow() * 0.00002f, AttributeChange::LocalOnly);
         prim->HasPrimShapeData = true;
 
         // Texture entry
-        const uint8_t *textureentrybytes = msg->ReadBuffer(&bytes_read);
-        ParseTextureEntryData(*prim, textureentrybytes, bytes_read);
+        ProtocolUtilities::NetBufferRef textureentry = object.TextureEntry();
+        ParseTextureEntryData(*prim, textureentry.data, textureentry.size);
 
         // Hovering text
-        msg->SkipToFirstVariableByName("Text");
-        prim->HoveringText = msg->ReadString();
+        prim->HoveringText = object.Text().ToString();
 
-        // Text color
-        const uint8_t *colorBytes = msg->ReadBuffer(&bytes_read);
-        assert(bytes_read == 4 && "Invalid length for fixed-sized variable TextColor in ObjectUpdate packet! Should be 4 bytes always.");
-        if (bytes_read != 4)
-            throw Exception("Invalid length for fixed-sized variable TextColor in ObjectUpdate packet! Should be 4 bytes always.");
+        // Text color, fixed-sized to 4 bytes.
+        const uint8_t *colorBytes = object.TextColor().data;
 
         // Convert from bytes to QColor
         int idx = 0;
@@ -247,7 +260,7 @@ bool Primitive::HandleOSNE_ObjectUpdate(ProtocolUtilities::NetworkEventInboundDa
 
         // read mediaurl, and send an event if it was changed
         std::string prevMediaUrl = prim->MediaUrl;
-        prim->MediaUrl = msg->ReadString();
+        prim->MediaUrl = object.MediaURL().ToString();
         //RexLogicModule::LogInfo("MediaURL: " + prim->MediaUrl);
         if (prim->MediaUrl.compare(prevMediaUrl) != 0)
         {
@@ -258,16 +271,10 @@ bool Primitive::HandleOSNE_ObjectUpdate(ProtocolUtilities::NetworkEventInboundDa
             event_manager->SendEvent("Scene", Scene::Events::EVENT_ENTITY_MEDIAURL_SET, &event_data);
         }
 
-        msg->SkipToNextVariable(); // PSBlock
-
         // If there are extra params, handle them.
-        if (msg->ReadVariableSize() > 1)
-        {
-            const uint8_t *extra_params_data = msg->ReadBuffer(&bytes_read);
-            HandleExtraParams(localid, extra_params_data);
-        }
-
-        msg->SkipToNextInstanceStart();
+        ProtocolUtilities::NetBufferRef extraparams = object.ExtraParams();
+        if (extraparams.size > 1)
+            HandleExtraParams(localid, extraparams.data);
 
         HandleDrawType(localid);
 
@@ -933,7 +940,15 @@ void Primitive::HandleDrawType(entity_id_t entityid)
 
                 // Remember that we are going to get a resource event for this entity
                 if (tag)
+                {
                     prim_resource_request_tags_[std::make_pair(tag, RexTypes::RexAT_Mesh)] = entityid;
+
+                    // Download the meshes that will be largest on screen first. Prim meshes are scaled to the prim size
+                    EC_Placeable* placeable = entity->GetComponent<EC_Placeable>().get();
+                    if (placeable)
+                        renderer->SetResourceRequestLocation(mesh_name, tag, placeable->GetPosition(),
+                            std::max(placeable->GetScale().getLength() * 0.5f, 0.5f));
+                }
             }
         }
         
@@ -996,15 +1011,7 @@ void Primitive::HandleDrawType(entity_id_t entityid)
 
         // Create/update geometry
         if (prim.HasPrimShapeData)
-        {
-            Ogre::ManualObject* manual = CreatePrimGeometry(rexlogicmodule_->GetFramework(), prim);
-            custom.CommitChanges(manual);
-            
-            Scene::Events::EntityEventData event_data;
-            event_data.entity = entity;
-            EventManagerPtr event_manager = rexlogicmodule_->GetFramework()->GetEventManager();
-            event_manager->SendEvent("Scene", Scene::Events::EVENT_ENTITY_VISUALS_MODIFIED, &event_data);
-        }
+            UpdatePrimGeometry(entity, prim, custom);
     }
 
     if (!RexTypes::IsNull(prim.ParticleScriptID))
@@ -1546,15 +1553,7 @@ void Primitive::HandleMaterialResourceReady(entity_id_t entityid, Foundation::Re
         {
             // Update geometry now that the material exists
             if (prim->HasPrimShapeData)
-            {
-                Ogre::ManualObject* manual = CreatePrimGeometry(rexlogicmodule_->GetFramework(), *prim);
-                custom->CommitChanges(manual);
-
-                Scene::Events::EntityEventData event_data;
-                event_data.entity = entity;
-                EventManagerPtr event_manager = rexlogicmodule_->GetFramework()->GetEventManager();
-                event_manager->SendEvent("Scene", Scene::Events::EVENT_ENTITY_VISUALS_MODIFIED, &event_data);
-            }
+                UpdatePrimGeometry(entity, *prim, *custom);
         }
     }
     
@@ -1666,7 +1665,7 @@ void Primitive::HandlePrimScaleAndVisibility(entity_id_t entityid)
     ogrepos->SetScale(prim->Scale);
 
     // Handle visibility
-    ogrepos->GetSceneNode()->setVisible(prim->IsVisible.Get());
+    ogrepos->SetVisible(prim->IsVisible.Get());
 }
 
 void SkipTextureEntrySection(const uint8_t* bytes, int& idx, int length, int elementsize)
@@ -1971,6 +1970,162 @@ void Primitive::HandleLogout()
     pending_rexprimdata_.clear();
     pending_rexfreedata_.clear();
     local_dirty_entities_.clear();
+    ClearPrimMeshes();
+}
+
+void Primitive::UpdatePrimGeometry(Scene::EntityPtr entity, EC_OpenSimPrim& prim, EC_OgreCustomObject& custom)
+{
+    PROFILE(Primitive_UpdatePrimGeometry);
+
+    Foundation::Framework* framework = rexlogicmodule_->GetFramework();
+    const entity_id_t entityid = entity->GetId();
+
+    std::vector<std::string> material_names;
+    GetPrimFaceMaterials(framework, prim, material_names);
+
+    PrimShapeParams params;
+    params.Set(prim, material_names, true);
+    const size_t hash = params.Hash();
+
+    Scene::Events::EntityEventData event_data;
+    event_data.entity = entity;
+
+    SharedPrimMeshMap::iterator i = prim_meshes_.find(hash);
+    if (i != prim_meshes_.end() && i->second.params != params)
+    {
+        // Another shape with the same hash has the slot, so mesh this prim on its own
+        pending_prim_meshes_.erase(entityid);
+        custom.CommitChanges(CreatePrimGeometry(framework, prim));
+        framework->GetEventManager()->SendEvent("Scene", Scene::Events::EVENT_ENTITY_VISUALS_MODIFIED, &event_data);
+        return;
+    }
+
+    if (i == prim_meshes_.end())
+    {
+        // New shape: mesh it in the thread pool, and give the mesh to all the prims of this shape when ready
+        i = prim_meshes_.insert(std::make_pair(hash, SharedPrimMesh())).first;
+        i->second.params = params;
+
+        PrimMeshRequestPtr request(new PrimMeshRequest());
+        request->params_ = params;
+        request->hash_ = hash;
+        framework->GetThreadTaskManager()->AddRequest<PrimMeshRequest>(PrimMeshBuilder::GetTaskDescriptionStatic(), request);
+    }
+
+    SharedPrimMesh& shared = i->second;
+    if (shared.pending)
+    {
+        pending_prim_meshes_[entityid] = hash;
+        return;
+    }
+
+    pending_prim_meshes_.erase(entityid);
+
+    // Keep the old geometry, as when the prim was meshed directly
+    if (shared.failed)
+        return;
+
+    const std::string mesh_name = shared.mesh.isNull() ? std::string() : shared.mesh->getName();
+    if (!custom.GetEntity() || custom.GetEntity()->getMesh() != shared.mesh)
+        if (!custom.SetSharedMesh(mesh_name))
+            return;
+
+    for (uint j = 0; j < shared.section_faces.size(); ++j)
+        custom.SetMaterial(j, material_names[shared.section_faces[j]]);
+
+    framework->GetEventManager()->SendEvent("Scene", Scene::Events::EVENT_ENTITY_VISUALS_MODIFIED, &event_data);
+}
+
+bool Primitive::HandleTaskEvent(event_id_t event_id, IEventData* data)
+{
+    if (event_id != Task::Events::REQUEST_COMPLETED)
+        return false;
+
+    PrimMeshResult* result = dynamic_cast<PrimMeshResult*>(data);
+    if (!result)
+        return false;
+
+    // The shape may have been forgotten on logout while it was being meshed
+    SharedPrimMeshMap::iterator i = prim_meshes_.find(result->hash_);
+    if (i == prim_meshes_.end() || !i->second.pending)
+        return false;
+
+    SharedPrimMesh& shared = i->second;
+    shared.pending = false;
+    if (!result->success_)
+    {
+        RexLogicModule::LogError(result->geometry_.error);
+        shared.failed = true;
+    }
+    else if (!result->geometry_.sections.empty())
+    {
+        boost::shared_ptr<OgreRenderer::Renderer> renderer = rexlogicmodule_->GetFramework()->GetServiceManager()->
+            GetService<OgreRenderer::Renderer>(Service::ST_Renderer).lock();
+        if (renderer)
+            shared.mesh = CreatePrimMesh(renderer->GetUniqueObjectName(), result->geometry_);
+        if (shared.mesh.isNull())
+            shared.failed = true;
+        for (uint j = 0; j < result->geometry_.sections.size(); ++j)
+            shared.section_faces.push_back(result->geometry_.sections[j].face);
+    }
+
+    // Give the mesh to the prims waiting for it. Their shape is checked again, in case it has changed meanwhile
+    std::vector<entity_id_t> waiting;
+    std::map<entity_id_t, size_t>::iterator j = pending_prim_meshes_.begin();
+    while (j != pending_prim_meshes_.end())
+    {
+        if (j->second == result->hash_)
+        {
+            waiting.push_back(j->first);
+            pending_prim_meshes_.erase(j++);
+        }
+        else
+            ++j;
+    }
+
+    for (uint k = 0; k < waiting.size(); ++k)
+    {
+        Scene::EntityPtr entity = rexlogicmodule_->GetPrimEntity(waiting[k]);
+        if (!entity)
+            continue;
+        EC_OpenSimPrim* prim = entity->GetComponent<EC_OpenSimPrim>().get();
+        EC_OgreCustomObject* custom = entity->GetComponent<EC_OgreCustomObject>().get();
+        if (!prim || !custom || prim->DrawType != RexTypes::DRAWTYPE_PRIM || !prim->HasPrimShapeData)
+            continue;
+        UpdatePrimGeometry(entity, *prim, *custom);
+    }
+
+    return false;
+}
+
+void Primitive::RemoveUnusedPrimMeshes()
+{
+    // The mesh manager holds the mesh too, and this map one more reference
+    const unsigned int unused_count = Ogre::ResourceGroupManager::RESOURCE_SYSTEM_NUM_REFERENCE_COUNTS + 1;
+
+    SharedPrimMeshMap::iterator i = prim_meshes_.begin();
+    while (i != prim_meshes_.end())
+    {
+        const SharedPrimMesh& shared = i->second;
+        if (shared.pending || (!shared.mesh.isNull() && shared.mesh.useCount() > unused_count))
+        {
+            ++i;
+            continue;
+        }
+
+        if (!shared.mesh.isNull())
+            Ogre::MeshManager::getSingleton().remove(shared.mesh->getName());
+        prim_meshes_.erase(i++);
+    }
+}
+
+void Primitive::ClearPrimMeshes()
+{
+    for (SharedPrimMeshMap::iterator i = prim_meshes_.begin(); i != prim_meshes_.end(); ++i)
+        if (!i->second.mesh.isNull())
+            Ogre::MeshManager::getSingleton().remove(i->second.mesh->getName());
+    prim_meshes_.clear();
+    pending_prim_meshes_.clear();
 }
 
 
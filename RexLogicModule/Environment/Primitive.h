@@ -14,6 +14,7 @@
 #include "IComponent.h"
 #include "SceneManager.h"
 #include "Color.h"
+#include "Environment/PrimGeometryUtils.h"
 
 #include <QObject>
 
@@ -21,6 +22,7 @@ class QColor;
 class QDomDocument;
 
 class EC_OpenSimPrim;
+class EC_OgreCustomObject;
 
 namespace ProtocolUtilities
 {
@@ -60,6 +62,9 @@ namespace RexLogic
 
         bool HandleResourceEvent(event_id_t event_id, IEventData* data);
 
+        //! Creates the meshes of prim shapes generated by PrimMeshBuilder, and gives them to the prims waiting for them
+        bool HandleTaskEvent(event_id_t event_id, IEventData* data);
+
         void HandleLogout();
 
         typedef std::map<std::pair<request_tag_t, asset_type_t>, entity_id_t> EntityResourceRequestMap;
@@ -182,6 +187,15 @@ namespace RexLogic
         //! handles prim size and visibility
         void HandlePrimScaleAndVisibility(entity_id_t entityid);
 
+        //! Gives a prim the shared mesh of its shape, or requests the shape to be meshed by PrimMeshBuilder if it has not been yet
+        void UpdatePrimGeometry(Scene::EntityPtr entity, EC_OpenSimPrim& prim, EC_OgreCustomObject& custom);
+
+        //! Removes the shared prim meshes that no prim uses any more
+        void RemoveUnusedPrimMeshes();
+
+        //! Removes all the shared prim meshes
+        void ClearPrimMeshes();
+
         //! discards request tags for certain entity
         void DiscardRequestTags(entity_id_t, EntityResourceRequestMap& map);
 
@@ -214,6 +228,37 @@ namespace RexLogic
         typedef std::set<entity_id_t> EntityIdSet;
         //! entities with local EC changes
         EntityIdSet local_dirty_entities_;
+
+        //! A prim mesh shared by all the prims of the same shape
+        struct SharedPrimMesh
+        {
+            SharedPrimMesh() : pending(true), failed(false) {}
+
+            //! The shape parameters, to tell apart shapes whose hashes collide
+            PrimShapeParams params;
+
+            //! The mesh, null until PrimMeshBuilder has meshed the shape or if the shape has no visible faces
+            Ogre::MeshPtr mesh;
+
+            //! For each submesh, the face whose material the prims set on it
+            std::vector<u8> section_faces;
+
+            //! True while the shape is being meshed
+            bool pending;
+
+            //! True if the shape gives illegal geometry
+            bool failed;
+        };
+
+        //! shared prim meshes by the hash of their shape parameters
+        typedef std::map<size_t, SharedPrimMesh> SharedPrimMeshMap;
+        SharedPrimMeshMap prim_meshes_;
+
+        //! prims waiting for the mesh of their shape, and the hash of the shape
+        std::map<entity_id_t, size_t> pending_prim_meshes_;
+
+        //! time since unused prim meshes were last removed
+        f64 prim_mesh_cleanup_time_;
     };
 }
 #endif
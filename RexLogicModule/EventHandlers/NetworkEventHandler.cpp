@@ -18,6 +18,7 @@
 #include "NetworkMessages/NetInMessage.h"
 #include "WorldStream.h"
 #include "RealXtend/RexProtocolMsgIDs.h"
+#include "RealXtend/RexProtocolMessageViews.h"
 #include "ProtocolModuleOpenSim.h"
 #include "BitStream.h"
 #include "GenericMessageUtils.h"
@@ -156,33 +157,29 @@ bool NetworkEventHandler::HandleOpenSimNetworkEvent(event_id_t event_id, IEventD
 
 bool NetworkEventHandler::HandleOSNE_ObjectUpdate(NetworkEventInboundData* data)
 {
-    NetInMessage &msg = *data->message;
-    msg.ResetReading();
-    msg.SkipToNextVariable();
-    msg.SkipToNextVariable();
+    ObjectUpdateView view;
+    if (!view.Parse(*data->message))
+    {
+        RexLogicModule::LogDebug("Malformed ObjectUpdate packet received, ignoring.");
+        return false;
+    }
 
-    if (msg.GetCurrentBlock() >= msg.GetBlockCount())
+    if (view.ObjectDataCount() == 0)
     {
         RexLogicModule::LogDebug("Empty ObjectUpdate packet received, ignoring.");
         return false;
     }
 
-    size_t instance_count = msg.ReadCurrentBlockInstanceCount();
     bool result = false;
-    if (instance_count > 0)
+    switch(view.ObjectData(0).PCode())
     {
-        msg.SkipToFirstVariableByName("PCode");
-        uint8_t pcode = msg.ReadU8();
-        switch(pcode)
-        {
-        case 0x09:
-            result = owner_->GetPrimitiveHandler()->HandleOSNE_ObjectUpdate(data);
-            break;
+    case 0x09:
+        result = owner_->GetPrimitiveHandler()->HandleOSNE_ObjectUpdate(data);
+        break;
 
-        case 0x2f:
-            result = owner_->GetAvatarHandler()->HandleOSNE_ObjectUpdate(data);
-            break;
-        }
+    case 0x2f:
+        result = owner_->GetAvatarHandler()->HandleOSNE_ObjectUpdate(data);
+        break;
     }
 
     return result;
@@ -291,40 +288,34 @@ bool NetworkEventHandler::HandleOSNE_AgentMovementComplete(NetworkEventInboundDa
 
 bool NetworkEventHandler::HandleOSNE_ImprovedTerseObjectUpdate(NetworkEventInboundData* data)
 {
-    NetInMessage &msg = *data->message;
-    msg.ResetReading();
-
-    uint64_t regionhandle = msg.ReadU64();
-    UNREFERENCED_PARAM(regionhandle);
-    msg.SkipToNextVariable(); // TimeDilation U16 ///\todo Unhandled inbound variable 'TimeDilation'.
-
-    if (msg.GetCurrentBlock() >= msg.GetBlockCount())
+    ///\todo Unhandled inbound variables 'RegionHandle' and 'TimeDilation'.
+    ImprovedTerseObjectUpdateView view;
+    if (!view.Parse(*data->message))
     {
-        RexLogicModule::LogDebug("Empty ImprovedTerseObjectUpdate packet received, ignoring.");
+        RexLogicModule::LogDebug("Malformed ImprovedTerseObjectUpdate packet received, ignoring.");
         return false;
     }
 
-    // Variable block
-    size_t instance_count = msg.ReadCurrentBlockInstanceCount();
-    for(size_t i = 0; i < instance_count; i++)
+    for(size_t i = 0; i < view.ObjectDataCount(); i++)
     {
-        size_t bytes_read = 0;
-        const uint8_t *bytes = msg.ReadBuffer(&bytes_read);
+        ///\todo Unhandled inbound variable 'TextureEntry'.
+        NetBufferRef objectData = view.ObjectData(i).Data();
+        const uint8_t *bytes = objectData.data;
 
         uint32_t localid = 0;
-        switch(bytes_read)
+        switch(objectData.size)
         {
         case 30:
             owner_->GetAvatarHandler()->HandleTerseObjectUpdate_30bytes(bytes); 
             break;
         case 44:
             //this size is only for prims
-            localid = *reinterpret_cast<uint32_t*>((uint32_t*)&bytes[0]);
+            localid = MessageView::Read<uint32_t>(bytes);
             if (owner_->GetPrimEntity(localid))
                 owner_->GetPrimitiveHandler()->HandleTerseObjectUpdateForPrim_44bytes(bytes);
             break;
         case 60:
-            localid = *reinterpret_cast<uint32_t*>((uint32_t*)&bytes[0]); 
+            localid = MessageView::Read<uint32_t>(bytes);
             if (owner_->GetPrimEntity(localid)) 
                 owner_->GetPrimitiveHandler()->HandleTerseObjectUpdateForPrim_60bytes(bytes);
             else if (owner_->GetAvatarEntity(localid))
@@ -332,12 +323,10 @@ bool NetworkEventHandler::HandleOSNE_ImprovedTerseObjectUpdate(NetworkEventInbou
             break;
         default:
             std::stringstream ss; 
-            ss << "Unhandled ImprovedTerseObjectUpdate block of size " << bytes_read << "!";
+            ss << "Unhandled ImprovedTerseObjectUpdate block of size " << objectData.size << "!";
             RexLogicModule::LogInfo(ss.str());
             break;
         }
-
-        msg.SkipToNextVariable(); ///\todo Unhandled inbound variable 'TextureEntry'.
     }
     return false;
 }
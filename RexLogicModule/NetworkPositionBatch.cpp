@@ -0,0 +1,252 @@
+/**
+ *  For conditions of distribution and use, see copyright notice in license.txt
+ *
+ *  @file   NetworkPositionBatch.cpp
+ *  @brief  Batched dead reckoning and smoothing of network positions.
+ */
+
+#include "StableHeaders.h"
+#include "NetworkPositionBatch.h"
+#include "EC_NetworkPosition.h"
+#include "EC_Placeable.h"
+#include "Entity.h"
+#include "Profiler.h"
+#include "CoreMath.h"
+
+namespace RexLogic
+{
+    NetworkPositionBatch::NetworkPositionBatch()
+    {
+    }
+
+    uint NetworkPositionBatch::Update(const Scene::SceneManager::EntityMap &entities, f64 frametime, float damping_constant, f64 dead_reckoning_time)
+    {
+        PROFILE(NetworkPositionBatch_Update);
+
+        if (!IsSameEntities(entities))
+            Rebuild(entities);
+
+        const uint n = entities_.size();
+        if (!n)
+            return 0;
+
+        // Damping interpolation factor, dependent on frame time
+        float factor = pow(2.0, -frametime * damping_constant);
+        factor = clamp(factor, 0.0f, 1.0f);
+        const float rev_factor = 1.0f - factor;
+        const f32 step = (f32)frametime;
+        const f32 tolerance = ROUNDING_ERROR_32;
+
+        // Pick up changes from the network, and placeables added after the network position
+        for(uint i = 0; i < n; ++i)
+        {
+            if (netpos_[i]->GetRevision() != revisions_[i])
+            {
+                Read(i);
+                placeable_dirty_[i] = 1;
+            }
+            if (!placeables_[i])
+            {
+                placeables_[i] = entities_[i]->GetComponent<EC_Placeable>();
+                placeable_dirty_[i] = 1;
+            }
+            active_[i] = (placeables_[i] && time_[i] <= dead_reckoning_time) ? 1.0f : 0.0f;
+        }
+
+        // Interpolate motion. Acceleration disabled until figured out what goes wrong, possibly mostly irrelevant with OpenSim server
+        for(uint i = 0; i < n; ++i)
+        {
+            time_[i] += frametime * active_[i];
+            const f32 dt = step * active_[i];
+            const f32 mx = vx_[i] * dt;
+            const f32 my = vy_[i] * dt;
+            const f32 mz = vz_[i] * dt;
+            px_[i] += mx;
+            py_[i] += my;
+            pz_[i] += mz;
+            moved_[i] = (mx != 0.0f) | (my != 0.0f) | (mz != 0.0f);
+        }
+
+        // Dampened (smooth) movement, for the entities whose damped position differs from the position
+        for(uint i = 0; i < n; ++i)
+        {
+            const u8 damp = (active_[i] != 0.0f) &
+                ((dx_[i] + tolerance < px_[i]) | (dx_[i] - tolerance > px_[i]) |
+                 (dy_[i] + tolerance < py_[i]) | (dy_[i] - tolerance > py_[i]) |
+                 (dz_[i] + tolerance < pz_[i]) | (dz_[i] - tolerance > pz_[i]));
+            dx_[i] = damp ? px_[i] * rev_factor + dx_[i] * factor : dx_[i];
+            dy_[i] = damp ? py_[i] * rev_factor + dy_[i] * factor : dy_[i];
+            dz_[i] = damp ? pz_[i] * rev_factor + dz_[i] * factor : dz_[i];
+            moved_[i] |= damp;
+            placeable_dirty_[i] |= damp;
+        }
+
+        // Interpolate rotation and dampen orientation. Few entities rotate, so this is done one entity at a time
+        for(uint i = 0; i < n; ++i)
+        {
+            if (active_[i] == 0.0f)
+                continue;
+
+            Quaternion orientation(ox_[i], oy_[i], oz_[i], ow_[i]);
+            if (rx_[i] * rx_[i] + ry_[i] * ry_[i] + rz_[i] * rz_[i] > 0.001f)
+            {
+                orientation = Rotate(orientation, rx_[i], ry_[i], rz_[i], frametime);
+                ox_[i] = orientation.x;
+                oy_[i] = orientation.y;
+                oz_[i] = orientation.z;
+                ow_[i] = orientation.w;
+                moved_[i] = 1;
+            }
+
+            Quaternion damped(dox_[i], doy_[i], doz_[i], dow_[i]);
+            if (damped != orientation)
+            {
+                damped.slerp(orientation, damped, factor);
+                dox_[i] = damped.x;
+                doy_[i] = damped.y;
+                doz_[i] = damped.z;
+                dow_[i] = damped.w;
+                moved_[i] = 1;
+                placeable_dirty_[i] = 1;
+            }
+        }
+
+        // Write back only what changed
+        uint num_placed = 0;
+        for(uint i = 0; i < n; ++i)
+        {
+            // Entities that keep moving on their own are not worth merging into static geometry
+            if (placeables_[i])
+                placeables_[i]->SetDynamic(active_[i] != 0.0f &&
+                    (vx_[i] != 0.0f || vy_[i] != 0.0f || vz_[i] != 0.0f || rx_[i] != 0.0f || ry_[i] != 0.0f || rz_[i] != 0.0f));
+
+            if (active_[i] == 0.0f)
+                continue;
+
+            netpos_[i]->time_since_update_ = time_[i];
+            if (moved_[i])
+                Write(i);
+
+            if (placeable_dirty_[i])
+            {
+                if (placeables_[i]->GetParentEntity() != entities_[i])
+                    placeables_[i] = entities_[i]->GetComponent<EC_Placeable>();
+                if (placeables_[i])
+                {
+                    placeables_[i]->SetPosition(Vector3df(dx_[i], dy_[i], dz_[i]));
+                    placeables_[i]->SetOrientation(Quaternion(dox_[i], doy_[i], doz_[i], dow_[i]));
+                    ++num_placed;
+                }
+                placeable_dirty_[i] = 0;
+            }
+        }
+
+        return num_placed;
+    }
+
+    Quaternion NetworkPositionBatch::Rotate(const Quaternion &orientation, f32 rx, f32 ry, f32 rz, f64 frametime)
+    {
+        // Rotation about x, then y, then z, by half the rotational velocity, combined into one quaternion. In Hamilton
+        // product terms this is orientation (x) qx (x) qy (x) qz, the same as orientation *= qx; *= qy; *= qz, as
+        // Quaternion's operator* multiplies in reverse order: a * b is b (x) a, and a *= b is a = b * a.
+        const f32 hx = 0.5f * (f32)(rx * 0.5 * frametime);
+        const f32 hy = 0.5f * (f32)(ry * 0.5 * frametime);
+        const f32 hz = 0.5f * (f32)(rz * 0.5 * frametime);
+        const f32 sx = sinf(hx), cx = cosf(hx);
+        const f32 sy = sinf(hy), cy = cosf(hy);
+        const f32 sz = sinf(hz), cz = cosf(hz);
+        Quaternion rotation(sx * cy * cz + cx * sy * sz,
+                            cx * sy * cz - sx * cy * sz,
+                            cx * cy * sz + sx * sy * cz,
+                            cx * cy * cz - sx * sy * sz);
+        return rotation * orientation;
+    }
+
+    void NetworkPositionBatch::Clear()
+    {
+        entities_.clear();
+        netpos_.clear();
+        placeables_.clear();
+        revisions_.clear();
+        time_.clear();
+        px_.clear(); py_.clear(); pz_.clear();
+        vx_.clear(); vy_.clear(); vz_.clear();
+        rx_.clear(); ry_.clear(); rz_.clear();
+        ox_.clear(); oy_.clear(); oz_.clear(); ow_.clear();
+        dx_.clear(); dy_.clear(); dz_.clear();
+        dox_.clear(); doy_.clear(); doz_.clear(); dow_.clear();
+        active_.clear();
+        moved_.clear();
+        placeable_dirty_.clear();
+    }
+
+    bool NetworkPositionBatch::IsSameEntities(const Scene::SceneManager::EntityMap &entities) const
+    {
+        if (entities.size() != entities_.size())
+            return false;
+
+        uint i = 0;
+        for(Scene::SceneManager::const_iterator iter = entities.begin(); iter != entities.end(); ++iter, ++i)
+        {
+            // A removed component is detached from its entity, even if the entity has got another one since
+            if (iter->second.get() != entities_[i] || netpos_[i]->GetParentEntity() != entities_[i])
+                return false;
+        }
+        return true;
+    }
+
+    void NetworkPositionBatch::Rebuild(const Scene::SceneManager::EntityMap &entities)
+    {
+        Clear();
+
+        for(Scene::SceneManager::const_iterator iter = entities.begin(); iter != entities.end(); ++iter)
+        {
+            boost::shared_ptr<EC_NetworkPosition> netpos = iter->second->GetComponent<EC_NetworkPosition>();
+            if (!netpos)
+                continue;
+            entities_.push_back(iter->second.get());
+            netpos_.push_back(netpos);
+            placeables_.push_back(iter->second->GetComponent<EC_Placeable>());
+        }
+
+        const uint n = entities_.size();
+        revisions_.resize(n);
+        time_.resize(n);
+        px_.resize(n); py_.resize(n); pz_.resize(n);
+        vx_.resize(n); vy_.resize(n); vz_.resize(n);
+        rx_.resize(n); ry_.resize(n); rz_.resize(n);
+        ox_.resize(n); oy_.resize(n); oz_.resize(n); ow_.resize(n);
+        dx_.resize(n); dy_.resize(n); dz_.resize(n);
+        dox_.resize(n); doy_.resize(n); doz_.resize(n); dow_.resize(n);
+        active_.resize(n);
+        moved_.resize(n);
+        placeable_dirty_.resize(n, 1);
+
+        // The components hold the latest state, as everything that changes is written back every frame
+        for(uint i = 0; i < n; ++i)
+            Read(i);
+    }
+
+    void NetworkPositionBatch::Read(uint i)
+    {
+        const EC_NetworkPosition &netpos = *netpos_[i];
+        revisions_[i] = netpos.GetRevision();
+        time_[i] = netpos.time_since_update_;
+        px_[i] = netpos.position_.x; py_[i] = netpos.position_.y; pz_[i] = netpos.position_.z;
+        vx_[i] = netpos.velocity_.x; vy_[i] = netpos.velocity_.y; vz_[i] = netpos.velocity_.z;
+        rx_[i] = netpos.rotvel_.x; ry_[i] = netpos.rotvel_.y; rz_[i] = netpos.rotvel_.z;
+        ox_[i] = netpos.orientation_.x; oy_[i] = netpos.orientation_.y; oz_[i] = netpos.orientation_.z; ow_[i] = netpos.orientation_.w;
+        dx_[i] = netpos.damped_position_.x; dy_[i] = netpos.damped_position_.y; dz_[i] = netpos.damped_position_.z;
+        dox_[i] = netpos.damped_orientation_.x; doy_[i] = netpos.damped_orientation_.y;
+        doz_[i] = netpos.damped_orientation_.z; dow_[i] = netpos.damped_orientation_.w;
+    }
+
+    void NetworkPositionBatch::Write(uint i)
+    {
+        EC_NetworkPosition &netpos = *netpos_[i];
+        netpos.position_ = Vector3df(px_[i], py_[i], pz_[i]);
+        netpos.orientation_ = Quaternion(ox_[i], oy_[i], oz_[i], ow_[i]);
+        netpos.damped_position_ = Vector3df(dx_[i], dy_[i], dz_[i]);
+        netpos.damped_orientation_ = Quaternion(dox_[i], doy_[i], doz_[i], dow_[i]);
+    }
+}
@@ -0,0 +1,108 @@
+/**
+ *  For conditions of distribution and use, see copyright notice in license.txt
+ *
+ *  @file   NetworkPositionBatch.h
+ *  @brief  Batched dead reckoning and smoothing of network positions.
+ */
+
+#ifndef incl_RexLogicModule_NetworkPositionBatch_h
+#define incl_RexLogicModule_NetworkPositionBatch_h
+
+#include "SceneManager.h"
+#include "Quaternion.h"
+
+class EC_NetworkPosition;
+class EC_Placeable;
+
+namespace RexLogic
+{
+    //! Interpolates the network positions of all entities of a scene at once
+    /*! Keeps the interpolation state of the EC_NetworkPosition components in contiguous arrays, one per scalar, so that
+        integration and damping run as tight loops the compiler can vectorize. The state is read from a component again
+        only when its revision changes, and written back to the component and its placeable only when it has changed.
+        Placeables of entities that have velocity are marked dynamic, so that the renderer does not batch them.
+     */
+    class NetworkPositionBatch
+    {
+    public:
+        //! Constructor
+        NetworkPositionBatch();
+
+        //! Advances dead reckoning and damping of the entities with network positions
+        /*! \param entities Entities with EC_NetworkPosition, from the scene's component type index
+            \param frametime Time since the previous update, in seconds
+            \param damping_constant Movement damping constant
+            \param dead_reckoning_time How long to keep extrapolating after an update from the network, in seconds
+            \return Number of entities whose placeables were moved
+         */
+        uint Update(const Scene::SceneManager::EntityMap &entities, f64 frametime, float damping_constant, f64 dead_reckoning_time);
+
+        //! Drops all entities
+        void Clear();
+
+        //! Returns number of entities
+        uint GetSize() const { return entities_.size(); }
+
+        //! Rotates an orientation about x, then y, then z by half the rotational velocity times the frame time
+        /*! Gives the same result as three Quaternion::fromAngleAxis rotations applied with operator*=, in that order.
+         */
+        static Quaternion Rotate(const Quaternion &orientation, f32 rx, f32 ry, f32 rz, f64 frametime);
+
+    private:
+        //! Returns whether the entities are still the same, in the same order, as when the arrays were filled
+        bool IsSameEntities(const Scene::SceneManager::EntityMap &entities) const;
+
+        //! Refills the arrays from the components of the entities
+        void Rebuild(const Scene::SceneManager::EntityMap &entities);
+
+        //! Reads the state of one entity from its component
+        void Read(uint i);
+
+        //! Writes the state of one entity back to its component
+        void Write(uint i);
+
+        //! Entities, in entity id order
+        std::vector<Scene::Entity*> entities_;
+
+        //! Network position components
+        std::vector<boost::shared_ptr<EC_NetworkPosition> > netpos_;
+
+        //! Placeable components, null if the entity has none
+        std::vector<boost::shared_ptr<EC_Placeable> > placeables_;
+
+        //! Component revision the state was last read at
+        std::vector<uint> revisions_;
+
+        //! Age of the current update from network
+        std::vector<f64> time_;
+
+        //! Position
+        std::vector<f32> px_, py_, pz_;
+
+        //! Velocity
+        std::vector<f32> vx_, vy_, vz_;
+
+        //! Rotational velocity
+        std::vector<f32> rx_, ry_, rz_;
+
+        //! Orientation
+        std::vector<f32> ox_, oy_, oz_, ow_;
+
+        //! Damped position
+        std::vector<f32> dx_, dy_, dz_;
+
+        //! Damped orientation
+        std::vector<f32> dox_, doy_, doz_, dow_;
+
+        //! 1 for entities still being extrapolated this frame, 0 for others
+        std::vector<f32> active_;
+
+        //! Nonzero when the network state changed this frame
+        std::vector<u8> moved_;
+
+        //! Nonzero when the damped state changed this frame, or has not been written to the placeable yet
+        std::vector<u8> placeable_dirty_;
+    };
+}
+
+#endif
@@ -62,6 +62,8 @@
 
 #include "RexMovementInput.h"
 #include "Environment/Primitive.h"
+#include "Environment/PrimMeshBuilder.h"
+#include "NetworkPositionBatch.h"
 #include "Camera/CameraControllable.h"
 #include "Communications/InWorldChat/Provider.h"
 #include "SceneInteract.h"
@@ -73,6 +75,7 @@
 #include "ConfigurationManager.h"
 #include "ModuleManager.h"
 #include "ConsoleCommand.h"
+#include "ThreadTaskManager.h"
 #include "ConsoleCommandServiceInterface.h"
 #include "ServiceManager.h"
 #include "ComponentManager.h"
@@ -267,6 +270,7 @@ void RexLogicModule::Initialize()
     framework_->GetEventManager()->RegisterEventCategory("Action");
 
     primitive_ = PrimitivePtr(new Primitive(this));
+    network_positions_ = NetworkPositionBatchPtr(new NetworkPositionBatch());
     world_stream_ = WorldStreamPtr(new ProtocolUtilities::WorldStream(framework_));
     network_handler_ = new NetworkEventHandler(this);
     network_state_handler_ = new NetworkStateEventHandler(this);
@@ -345,6 +349,12 @@ void RexLogicModule::PostInitialize()
     event_handlers_[eventcategoryid].push_back(
         boost::bind(&RexLogicModule::HandleResourceEvent, this, _1, _2));
 
+    // Task events, and the thread task that meshes the prims
+    eventcategoryid = eventMgr->QueryEventCategory("Task");
+    event_handlers_[eventcategoryid].push_back(
+        boost::bind(&Primitive::HandleTaskEvent, primitive_.get(), _1, _2));
+    framework_->GetThreadTaskManager()->AddThreadTask(Foundation::ThreadTaskPtr(new PrimMeshBuilder()));
+
     // Framework events
     eventcategoryid = eventMgr->QueryEventCategory("Framework");
     event_handlers_[eventcategoryid].push_back(boost::bind(
@@ -385,6 +395,10 @@ void RexLogicModule::PostInitialize()
         "Toggle flight mode.",
         Console::Bind(this, &RexLogicModule::ConsoleToggleFlyMode)));
 
+    RegisterConsoleCommand(Console::CreateCommand("netposcheck",
+        "Checks that the batched network position update rotates entities the same as rotating about x, y and z in turn.",
+        Console::Bind(this, &RexLogicModule::ConsoleCheckNetworkPositionRotation)));
+
 #ifdef EC_Highlight_ENABLED
     RegisterConsoleCommand(Console::CreateCommand("Highlight",
         "Adds/removes EC_Highlight for every prim and mesh. Usage: highlight(add|remove)."
@@ -486,7 +500,9 @@ void RexLogicModule::Uninitialize()
         LogoutAndDeleteWorld();
 
     world_stream_.reset();
+    framework_->GetThreadTaskManager()->RemoveThreadTask(PrimMeshBuilder::GetTaskDescriptionStatic());
     primitive_.reset();
+    network_positions_.reset();
     camera_controllable_.reset();
 
     event_handlers_.clear();
@@ -892,73 +908,35 @@ void RexLogicModule::UpdateObjects(f64 frametime)
     if (!scene)
         return;
 
-    // Damping interpolation factor, dependent on frame time
-    float factor = pow(2.0, -frametime * movement_damping_constant_);
-    clamp(factor, 0.0f, 1.0f);
-    float rev_factor = 1.0 - factor;
-
     found_avatars_.clear();
 
-    for(Scene::SceneManager::iterator iter = scene->begin(); iter != scene->end(); ++iter)
-    {
-        Scene::Entity &entity = *iter->second;
-
-        boost::shared_ptr<EC_Placeable> ogrepos = entity.GetComponent<EC_Placeable>();
-        boost::shared_ptr<EC_NetworkPosition> netpos = entity.GetComponent<EC_NetworkPosition>();
-        if (ogrepos && netpos)
-        {
-            if (netpos->time_since_update_ <= dead_reckoning_time_)
-            {
-                netpos->time_since_update_ += frametime; 
-
-                // Interpolate motion
-                // acceleration disabled until figured out what goes wrong. possibly mostly irrelevant with OpenSim server
-                // netpos->velocity_ += netpos->accel_ * frametime;
-                netpos->position_ += netpos->velocity_ * frametime;
-
-                // Interpolate rotation
-                if (netpos->rotvel_.getLengthSQ() > 0.001)
-                {
-                    Quaternion rot_quat1;
-                    Quaternion rot_quat2;
-                    Quaternion rot_quat3;
-
-                    rot_quat1.fromAngleAxis(netpos->rotvel_.x * 0.5 * frametime, Vector3df(1,0,0));
-                    rot_quat2.fromAngleAxis(netpos->rotvel_.y * 0.5 * frametime, Vector3df(0,1,0));
-                    rot_quat3.fromAngleAxis(netpos->rotvel_.z * 0.5 * frametime, Vector3df(0,0,1));
-
-                    netpos->orientation_ *= rot_quat1;
-                    netpos->orientation_ *= rot_quat2;
-                    netpos->orientation_ *= rot_quat3;
-                }
-
-                // Dampened (smooth) movement
-                if (netpos->damped_position_ != netpos->position_)
-                    netpos->damped_position_ = netpos->position_ * rev_factor + netpos->damped_position_ * factor;
-
-                if (netpos->damped_orientation_ != netpos->orientation_)
-                    netpos->damped_orientation_.slerp(netpos->orientation_, netpos->damped_orientation_, factor);
-
-                ogrepos->SetPosition(netpos->damped_position_);
-                ogrepos->SetOrientation(netpos->damped_orientation_);
-            }
-        }
+    // Visit only the entities that have the components each update needs, through the scene's component type index.
+    // Dead reckoning and damping of network positions runs in a batch over all of them at once
+    network_positions_->Update(scene->GetEntitiesWithComponent<EC_NetworkPosition>(), frametime, movement_damping_constant_, dead_reckoning_time_);
 
-        // If is an avatar, handle update for avatar animations
-        if (entity.GetComponent(EC_OpenSimAvatar::TypeNameStatic()))
-        {
-            found_avatars_.push_back(iter->second);
-            GetAvatarHandler()->UpdateAvatarAnimations(entity.GetId(), frametime);
-        }
+    // If is an avatar, handle update for avatar animations
+    const Scene::SceneManager::EntityMap &avatar_entities = scene->GetEntitiesWithComponent<EC_OpenSimAvatar>();
+    for(Scene::SceneManager::const_iterator iter = avatar_entities.begin(); iter != avatar_entities.end(); ++iter)
+    {
+        found_avatars_.push_back(iter->second);
+        GetAvatarHandler()->UpdateAvatarAnimations(iter->first, frametime);
+    }
 
-        // General animation controller update
-        boost::shared_ptr<EC_AnimationController> animctrl = entity.GetComponent<EC_AnimationController>();
+    // General animation controller update
+    const Scene::SceneManager::EntityMap &animated_entities = scene->GetEntitiesWithComponent<EC_AnimationController>();
+    for(Scene::SceneManager::const_iterator iter = animated_entities.begin(); iter != animated_entities.end(); ++iter)
+    {
+        boost::shared_ptr<EC_AnimationController> animctrl = iter->second->GetComponent<EC_AnimationController>();
         if (animctrl)
             animctrl->Update(frametime);
+    }
 
-        // Attached sound update
-        boost::shared_ptr<EC_Placeable> placeable = entity.GetComponent<EC_Placeable>();
-        boost::shared_ptr<EC_AttachedSound> sound = entity.GetComponent<EC_AttachedSound>();
+    // Attached sound update
+    const Scene::SceneManager::EntityMap &sound_entities = scene->GetEntitiesWithComponent<EC_AttachedSound>();
+    for(Scene::SceneManager::const_iterator iter = sound_entities.begin(); iter != sound_entities.end(); ++iter)
+    {
+        boost::shared_ptr<EC_Placeable> placeable = iter->second->GetComponent<EC_Placeable>();
+        boost::shared_ptr<EC_AttachedSound> sound = iter->second->GetComponent<EC_AttachedSound>();
         if (placeable && sound)
         {
             sound->Update(frametime);
@@ -1261,6 +1239,49 @@ Console::CommandResult RexLogicModule::ConsoleHighlightTest(const StringVector &
     return Console::ResultSuccess();
 }
 
+Console::CommandResult RexLogicModule::ConsoleCheckNetworkPositionRotation(const StringVector &params)
+{
+    const Quaternion orientations[] = { Quaternion::IDENTITY, Quaternion(0.5f, 0.5f, 0.5f, 0.5f),
+        Quaternion(0.3f, -1.2f, 0.8f), Quaternion(-2.5f, 0.4f, 3.0f) };
+    const Vector3df rotvels[] = { Vector3df(1.0f, 0.0f, 0.0f), Vector3df(0.0f, -2.0f, 0.0f), Vector3df(0.0f, 0.0f, 3.0f),
+        Vector3df(0.7f, -1.3f, 2.1f), Vector3df(-4.0f, 2.5f, -0.5f) };
+    const f64 frametimes[] = { 0.016, 0.1, 0.5 };
+
+    std::stringstream ss;
+    int failures = 0;
+    for(uint i = 0; i < sizeof(orientations) / sizeof(orientations[0]); ++i)
+        for(uint j = 0; j < sizeof(rotvels) / sizeof(rotvels[0]); ++j)
+            for(uint k = 0; k < sizeof(frametimes) / sizeof(frametimes[0]); ++k)
+            {
+                const Vector3df &rotvel = rotvels[j];
+                const f64 frametime = frametimes[k];
+
+                // The per-entity rotation before the batched update
+                Quaternion expected = orientations[i];
+                Quaternion rot_quat1;
+                Quaternion rot_quat2;
+                Quaternion rot_quat3;
+                rot_quat1.fromAngleAxis(rotvel.x * 0.5 * frametime, Vector3df(1,0,0));
+                rot_quat2.fromAngleAxis(rotvel.y * 0.5 * frametime, Vector3df(0,1,0));
+                rot_quat3.fromAngleAxis(rotvel.z * 0.5 * frametime, Vector3df(0,0,1));
+                expected *= rot_quat1;
+                expected *= rot_quat2;
+                expected *= rot_quat3;
+
+                Quaternion result = NetworkPositionBatch::Rotate(orientations[i], rotvel.x, rotvel.y, rotvel.z, frametime);
+                if (!result.equals(expected, 1e-5f))
+                {
+                    ss << "Orientation " << orientations[i] << ", rotational velocity " << rotvel.x << " " << rotvel.y << " "
+                       << rotvel.z << ", frame time " << frametime << ": " << result << ", expected " << expected << std::endl;
+                    ++failures;
+                }
+            }
+
+    if (failures > 0)
+        return Console::ResultFailure(ss.str());
+    return Console::ResultSuccess("All rotations match.");
+}
+
 void RexLogicModule::EmitIncomingEstateOwnerMessageEvent(QVariantList params)
 {
     emit OnIncomingEstateOwnerMessage(params);
@@ -78,6 +78,7 @@ namespace RexLogic
     class LoginHandler;
     class ObjectCameraController;
     class CameraControl;
+    class NetworkPositionBatch;
 
     namespace InWorldChat { class Provider; }
 
@@ -86,6 +87,7 @@ namespace RexLogic
     typedef boost::shared_ptr<CameraControllable> CameraControllablePtr;
     typedef boost::shared_ptr<ObjectCameraController> ObjectCameraControllerPtr;
     typedef boost::shared_ptr<CameraControl> CameraControlPtr;
+    typedef boost::shared_ptr<NetworkPositionBatch> NetworkPositionBatchPtr;
 
     //! Camera states handled by rex logic
     enum CameraState
@@ -263,6 +265,9 @@ namespace RexLogic
         //! Console command for test EC_Highlight. Adds EC_Highlight for every avatar.
         Console::CommandResult ConsoleHighlightTest(const StringVector &params);
 
+        //! Checks the batched network position rotation against rotating with three quaternions
+        Console::CommandResult ConsoleCheckNetworkPositionRotation(const StringVector &params);
+
         /// Returns Ogre renderer pointer. Convenience function for making code cleaner.
         OgreRenderer::RendererPtr GetOgreRendererPtr() const;
 
@@ -306,6 +311,9 @@ namespace RexLogic
         //! Primitive handler pointer.
         PrimitivePtr primitive_;
 
+        //! Dead reckoning and smoothing of network positions
+        NetworkPositionBatchPtr network_positions_;
+
         //! Current camera entity
         Scene::EntityWeakPtr camera_entity_;
 
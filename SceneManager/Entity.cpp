@@ -41,6 +41,7 @@ namespace Scene
             components_[i]->SetParentEntity(0);
         
         components_.clear();
+        component_type_ids_.clear();
         qDeleteAll(actions_);
     }
 
@@ -58,8 +59,14 @@ namespace Scene
                 setProperty(componentTypeName.toStdString().c_str(), var);
             }
 
+            uint type_id = GetComponentTypeId(component->TypeName());
+            bool new_type = !HasComponent(type_id);
+
             component->SetParentEntity(this);
             components_.push_back(component);
+            component_type_ids_.push_back(type_id);
+            if (new_type && scene_)
+                scene_->IndexComponentType(this, type_id);
             
             if (change != AttributeChange::Disconnected)
                 emit ComponentAdded(component.get(), change);
@@ -95,8 +102,12 @@ namespace Scene
                 if (scene_)
                     scene_->EmitComponentRemoved(this, (*iter).get(), change);
 
+                uint type_id = component_type_ids_[iter - components_.begin()];
+                component_type_ids_.erase(component_type_ids_.begin() + (iter - components_.begin()));
                 (*iter)->SetParentEntity(0);
                 components_.erase(iter);
+                if (scene_ && !HasComponent(type_id))
+                    scene_->UnindexComponentType(this, type_id);
             }
             else
             {
@@ -113,9 +124,9 @@ namespace Scene
 
     ComponentPtr Entity::GetOrCreateComponent(const QString &type_name, AttributeChange::Type change, bool syncEnabled)
     {
-        for (size_t i=0 ; i<components_.size() ; ++i)
-            if (components_[i]->TypeName() == type_name)
-                return components_[i];
+        ComponentPtr existing = GetComponent(type_name);
+        if (existing)
+            return existing;
 
         // If component was not found, try to create
         ComponentPtr new_comp = framework_->GetComponentManager()->CreateComponent(type_name);
@@ -133,9 +144,9 @@ namespace Scene
 
     ComponentPtr Entity::GetOrCreateComponent(const QString &type_name, const QString &name, AttributeChange::Type change, bool syncEnabled)
     {
-        for (size_t i=0 ; i<components_.size() ; ++i)
-            if (components_[i]->TypeName() == type_name && components_[i]->Name() == name)
-                return components_[i];
+        ComponentPtr existing = GetComponent(type_name, name);
+        if (existing)
+            return existing;
 
         // If component was not found, try to create
         ComponentPtr new_comp = framework_->GetComponentManager()->CreateComponent(type_name, name);
@@ -153,8 +164,16 @@ namespace Scene
     
     ComponentPtr Entity::GetComponent(const QString &type_name) const
     {
-        for (size_t i=0 ; i<components_.size() ; ++i)
-            if (components_[i]->TypeName() == type_name)
+        uint type_id = FindComponentTypeId(type_name);
+        if (!type_id)
+            return ComponentPtr();
+        return GetComponent(type_id);
+    }
+
+    ComponentPtr Entity::GetComponent(uint type_id) const
+    {
+        for (size_t i=0 ; i<component_type_ids_.size() ; ++i)
+            if (component_type_ids_[i] == type_id)
                 return components_[i];
 
         return ComponentPtr();
@@ -171,8 +190,11 @@ namespace Scene
 
     ComponentPtr Entity::GetComponent(const QString &type_name, const QString& name) const
     {
-        for (size_t i=0 ; i<components_.size() ; ++i)
-            if ((components_[i]->TypeName() == type_name) && (components_[i]->Name() == name))
+        uint type_id = FindComponentTypeId(type_name);
+        if (!type_id)
+            return ComponentPtr();
+        for (size_t i=0 ; i<component_type_ids_.size() ; ++i)
+            if ((component_type_ids_[i] == type_id) && (components_[i]->Name() == name))
                 return components_[i];
 
         return ComponentPtr();
@@ -180,12 +202,28 @@ namespace Scene
 
     bool Entity::HasComponent(const QString &type_name) const
     {
-        for(size_t i=0 ; i<components_.size() ; ++i)
-            if (components_[i]->TypeName() == type_name)
+        uint type_id = FindComponentTypeId(type_name);
+        return type_id && HasComponent(type_id);
+    }
+
+    bool Entity::HasComponent(uint type_id) const
+    {
+        for(size_t i=0 ; i<component_type_ids_.size() ; ++i)
+            if (component_type_ids_[i] == type_id)
                 return true;
         return false;
     }
 
+    uint Entity::GetComponentTypeId(const QString &type_name) const
+    {
+        return framework_->GetComponentManager()->GetComponentTypeId(type_name);
+    }
+
+    uint Entity::FindComponentTypeId(const QString &type_name) const
+    {
+        return framework_->GetComponentManager()->FindComponentTypeId(type_name);
+    }
+
     EntityPtr Entity::GetSharedPtr() const
     {
         EntityPtr ptr;
@@ -196,10 +234,7 @@ namespace Scene
 
     bool Entity::HasComponent(const QString &type_name, const QString& name) const
     {
-        for(size_t i=0 ; i<components_.size() ; ++i)
-            if ((components_[i]->TypeName() == type_name) && (components_[i]->Name() == name))
-                return true;
-        return false;
+        return GetComponent(type_name, name).get() != 0;
     }
 
     IAttribute *Entity::GetAttributeInterface(const std::string &name) const
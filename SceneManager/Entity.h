@@ -163,9 +163,35 @@ namespace Scene
         template <class T>
         boost::shared_ptr<T> GetComponent() const
         {
-            return boost::dynamic_pointer_cast<T>(GetComponent(T::TypeNameStatic()));
+            return boost::dynamic_pointer_cast<T>(GetComponent(GetComponentTypeId<T>()));
         }
 
+        //! Returns a component with a type id or empty pointer if component was not found
+        /*! If there are several components with the specified type, returns the first component found (arbitrary).
+            \param type_id type id of the component, from ComponentManager::GetComponentTypeId()
+        */
+        ComponentPtr GetComponent(uint type_id) const;
+
+        //! Returns whether or not this entity has a component with a type id
+        /*! \param type_id type id of the component, from ComponentManager::GetComponentTypeId()
+        */
+        bool HasComponent(uint type_id) const;
+
+        //! Returns the type id of a component class
+        /*! The id is looked up once per class and cached.
+        */
+        template <class T>
+        uint GetComponentTypeId() const
+        {
+            static uint type_id = 0;
+            if (!type_id)
+                type_id = GetComponentTypeId(T::TypeNameStatic());
+            return type_id;
+        }
+
+        //! Returns type ids of the components, in the same order as the component vector
+        const std::vector<uint> &GetComponentTypeIds() const { return component_type_ids_; }
+
         /*! Returns list of components with certain class type, already cast to correct type.
             \param T Component class type.
             \return List of components with certain class type, or empty list if no components was found.
@@ -400,9 +426,18 @@ namespace Scene
         */
         bool HasReceivers(EntityAction *action);
 
+        //! Returns the type id of a component type name, assigning one if needed
+        uint GetComponentTypeId(const QString &type_name) const;
+
+        //! Returns the type id of a component type name, or 0 if the type has no id yet
+        uint FindComponentTypeId(const QString &type_name) const;
+
         //! a list of all components
         ComponentVector components_;
 
+        //! Type ids of the components, parallel to components_
+        std::vector<uint> component_type_ids_;
+
         //! Unique id for this entity
         entity_id_t id_;
 
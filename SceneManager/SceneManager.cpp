@@ -23,14 +23,19 @@ namespace Scene
 {
     uint SceneManager::gid_ = 0;
 
-    SceneManager::SceneManager() : framework_(0)
+    SceneManager::SceneManager() :
+        name_type_id_(0),
+        framework_(0)
     {
     }
 
     SceneManager::SceneManager(const QString &name, Foundation::Framework *framework) :
+        name_type_id_(0),
         name_(name),
         framework_(framework)
     {
+        if (framework_)
+            name_type_id_ = GetComponentTypeId(EC_Name::TypeNameStatic());
     }
 
     SceneManager::~SceneManager()
@@ -67,6 +72,10 @@ namespace Scene
             }
         }
         entities_[entity->GetId()] = entity;
+        const std::vector<uint> &type_ids = entity->GetComponentTypeIds();
+        for (size_t i=0 ; i<type_ids.size() ; ++i)
+            IndexComponentType(entity.get(), type_ids[i]);
+        IndexName(entity.get());
 
         // Send event.
         Events::SceneEventData event_data(entity->GetId());
@@ -92,17 +101,70 @@ namespace Scene
 
     Scene::EntityPtr SceneManager::GetEntityByName(const QString& name) const
     {
-        EntityMap::const_iterator it = entities_.begin();
-        while(it != entities_.end())
+        const EntityMap &named = GetEntitiesWithName(name);
+        if (named.empty())
+            return Scene::EntityPtr();
+
+        return named.begin()->second;
+    }
+
+    const SceneManager::EntityMap &SceneManager::GetEntitiesWithName(const QString &name) const
+    {
+        static const EntityMap empty;
+        QHash<QString, EntityMap>::const_iterator it = entities_by_name_.find(name);
+        if (it == entities_by_name_.end())
+            return empty;
+        return it.value();
+    }
+
+    EntityList SceneManager::GetEntitiesByNamePrefix(const QString &prefix) const
+    {
+        EntityList entities;
+        for(std::set<QString>::const_iterator name = names_.lower_bound(prefix); name != names_.end() && name->startsWith(prefix); ++name)
         {
-            EntityPtr entity = it->second;
-            if (entity->HasComponent(EC_Name::TypeNameStatic()))
-                if (entity->GetComponent<EC_Name>()->name.Get() == name)
-                    return entity;
-            ++it;
+            const EntityMap &named = GetEntitiesWithName(*name);
+            for(EntityMap::const_iterator it = named.begin(); it != named.end(); ++it)
+                entities.push_back(it->second);
         }
 
-        return Scene::EntityPtr();
+        return entities;
+    }
+
+    EntityList SceneManager::GetEntitiesByNameRegExp(const QRegExp &regexp) const
+    {
+        EntityList entities;
+        for(std::set<QString>::const_iterator name = names_.begin(); name != names_.end(); ++name)
+        {
+            if (!regexp.exactMatch(*name))
+                continue;
+            const EntityMap &named = GetEntitiesWithName(*name);
+            for(EntityMap::const_iterator it = named.begin(); it != named.end(); ++it)
+                entities.push_back(it->second);
+        }
+
+        return entities;
+    }
+
+    QList<Scene::Entity*> SceneManager::GetEntitiesByNamePrefixRaw(const QString &prefix) const
+    {
+        QList<Scene::Entity*> ret;
+
+        EntityList entities = GetEntitiesByNamePrefix(prefix);
+        foreach(EntityPtr e, entities)
+            ret.append(e.get());
+
+        return ret;
+    }
+
+    QList<Scene::Entity*> SceneManager::GetEntitiesByNameRegExpRaw(const QString &pattern) const
+    {
+        QList<Scene::Entity*> ret;
+
+        EntityList entities = GetEntitiesByNameRegExp(QRegExp(pattern));
+        foreach(EntityPtr e, entities)
+            ret.append(e.get());
+
+        return ret;
     }
 
     entity_id_t SceneManager::GetNextFreeId()
@@ -128,6 +190,11 @@ namespace Scene
             framework_->GetEventManager()->SendEvent(cat_id, Events::EVENT_ENTITY_DELETED, &event_data);
             
             entities_.erase(it);
+            const std::vector<uint> &type_ids = del_entity->GetComponentTypeIds();
+            for (size_t i=0 ; i<type_ids.size() ; ++i)
+                if (type_ids[i] < entities_by_type_.size() && entities_by_type_[type_ids[i]])
+                    entities_by_type_[type_ids[i]]->erase(id);
+            UnindexName(id);
             // If entity somehow manages to live, at least it doesn't belong to the scene anymore
             del_entity->SetScene(0);
             del_entity.reset();
@@ -153,23 +220,121 @@ namespace Scene
             ++it;
         }
         entities_.clear();
+        for (size_t i=0 ; i<entities_by_type_.size() ; ++i)
+            if (entities_by_type_[i])
+                entities_by_type_[i]->clear();
+        entities_by_name_.clear();
+        entity_names_.clear();
+        names_.clear();
         emit SceneCleared();
     }
     
     EntityList SceneManager::GetEntitiesWithComponent(const QString &type_name) const
     {
         std::list<EntityPtr> entities;
-        EntityMap::const_iterator it = entities_.begin();
-        while(it != entities_.end())
+        uint type_id = framework_->GetComponentManager()->FindComponentTypeId(type_name);
+        if (!type_id)
+            return entities;
+
+        const EntityMap &typed_entities = GetEntitiesWithComponentType(type_id);
+        EntityMap::const_iterator it = typed_entities.begin();
+        while(it != typed_entities.end())
         {
-            EntityPtr entity = it->second;
-            if (entity->HasComponent(type_name))
-                entities.push_back(entity);
+            entities.push_back(it->second);
             ++it;
         }
 
         return entities;
     }
+
+    const SceneManager::EntityMap &SceneManager::GetEntitiesWithComponentType(uint type_id) const
+    {
+        static const EntityMap empty;
+        if (type_id >= entities_by_type_.size() || !entities_by_type_[type_id])
+            return empty;
+        return *entities_by_type_[type_id];
+    }
+
+    void SceneManager::IndexComponentType(Scene::Entity* entity, uint type_id)
+    {
+        EntityMap::const_iterator it = entities_.find(entity->GetId());
+        if (it == entities_.end() || it->second.get() != entity)
+            return;
+
+        if (type_id >= entities_by_type_.size())
+            entities_by_type_.resize(type_id + 1);
+        if (!entities_by_type_[type_id])
+            entities_by_type_[type_id] = boost::shared_ptr<EntityMap>(new EntityMap());
+        (*entities_by_type_[type_id])[entity->GetId()] = it->second;
+
+        if (type_id == name_type_id_)
+            IndexName(entity);
+    }
+
+    void SceneManager::UnindexComponentType(Scene::Entity* entity, uint type_id)
+    {
+        if (type_id >= entities_by_type_.size() || !entities_by_type_[type_id])
+            return;
+
+        EntityMap &typed_entities = *entities_by_type_[type_id];
+        EntityMap::iterator it = typed_entities.find(entity->GetId());
+        if (it != typed_entities.end() && it->second.get() == entity)
+        {
+            typed_entities.erase(it);
+            if (type_id == name_type_id_)
+                UnindexName(entity->GetId());
+        }
+    }
+
+    void SceneManager::IndexName(Scene::Entity* entity)
+    {
+        EntityMap::const_iterator it = entities_.find(entity->GetId());
+        if (it == entities_.end() || it->second.get() != entity)
+            return;
+
+        boost::shared_ptr<EC_Name> name_comp = entity->GetComponent<EC_Name>();
+        if (!name_comp)
+        {
+            UnindexName(entity->GetId());
+            return;
+        }
+
+        const QString &name = name_comp->name.Get();
+        std::map<entity_id_t, QString>::const_iterator old = entity_names_.find(entity->GetId());
+        if (old != entity_names_.end() && old->second == name)
+            return;
+
+        UnindexName(entity->GetId());
+        EntityMap &named = entities_by_name_[name];
+        if (named.empty())
+            names_.insert(name);
+        named[entity->GetId()] = it->second;
+        entity_names_[entity->GetId()] = name;
+    }
+
+    void SceneManager::UnindexName(entity_id_t id)
+    {
+        std::map<entity_id_t, QString>::iterator old = entity_names_.find(id);
+        if (old == entity_names_.end())
+            return;
+
+        QHash<QString, EntityMap>::iterator named = entities_by_name_.find(old->second);
+        if (named != entities_by_name_.end())
+        {
+            named.value().erase(id);
+            if (named.value().empty())
+            {
+                names_.erase(old->second);
+                entities_by_name_.erase(named);
+            }
+        }
+        entity_names_.erase(old);
+    }
+
+    uint SceneManager::GetComponentTypeId(const QString &type_name) const
+    {
+        return framework_->GetComponentManager()->GetComponentTypeId(type_name);
+    }
     
     void SceneManager::EmitComponentAdded(Scene::Entity* entity, IComponent* comp, AttributeChange::Type change)
     {
@@ -191,6 +356,10 @@ namespace Scene
 
     void SceneManager::EmitAttributeChanged(IComponent* comp, IAttribute* attribute, AttributeChange::Type change)
     {
+        // Keep the name index up to date
+        if (comp->TypeName() == EC_Name::TypeNameStatic() && attribute == &checked_static_cast<EC_Name*>(comp)->name && comp->GetParentEntity())
+            IndexName(comp->GetParentEntity());
+
         if (change == AttributeChange::Disconnected)
             return;
         if (change == AttributeChange::Default)
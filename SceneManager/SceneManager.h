@@ -11,6 +11,10 @@
 #include <QObject>
 #include <QVariant>
 #include <QStringList>
+#include <QHash>
+#include <QRegExp>
+
+#include <set>
 
 namespace Scene
 {
@@ -54,6 +58,8 @@ namespace Scene
         QList<Scene::Entity*> GetEntitiesWithComponentRaw(const QString &type_name) const;
 
         Scene::Entity* GetEntityByNameRaw(const QString& name) const;
+        QList<Scene::Entity*> GetEntitiesByNamePrefixRaw(const QString &prefix) const;
+        QList<Scene::Entity*> GetEntitiesByNameRegExpRaw(const QString &pattern) const;
 
         //! Return a scene document with just the desired entity
         QByteArray GetEntityXml(Scene::Entity *entity);
@@ -103,12 +109,30 @@ namespace Scene
         EntityPtr GetEntity(entity_id_t id) const;
 
         //! Returns entity with the specified name, searches through only those entities which has EC_Name-component.
-        /*!
+        /*! If several entities have the name, returns the one with the lowest id.
             \note Returns a shared pointer, but it is preferable to use a weak pointer, Scene::EntityWeakPtr,
                   to avoid dangling references that prevent entities from being properly destroyed.
         */
         EntityPtr GetEntityByName(const QString& name) const;
 
+        //! Returns entities with the specified name, without copying
+        /*! The name index follows the name attribute of the first EC_Name of each entity through attribute change
+            notifications, so names set with AttributeChange::Disconnected are seen only once the change is signaled.
+            The map must not be held over changes to the scene.
+            \param name Name
+         */
+        const EntityMap &GetEntitiesWithName(const QString &name) const;
+
+        //! Returns entities whose name starts with a prefix, in name order
+        /*! \param prefix Name prefix
+         */
+        EntityList GetEntitiesByNamePrefix(const QString &prefix) const;
+
+        //! Returns entities whose whole name matches a regular expression, in name order
+        /*! \param regexp Regular expression
+         */
+        EntityList GetEntitiesByNameRegExp(const QRegExp &regexp) const;
+
         //! Returns true if entity with the specified id exists in this scene, false otherwise
         bool HasEntity(entity_id_t id) const { return (entities_.find(id) != entities_.end()); }
 
@@ -146,6 +170,35 @@ namespace Scene
         //! Return list of entities with a spesific component present.
         //! \param type_name Type name of the component
         EntityList GetEntitiesWithComponent(const QString &type_name) const;
+
+        //! Returns entities with a component of a type id present, without copying
+        /*! The map is kept up to date as components are added and removed, so it must not be held over changes to the scene.
+            \param type_id Type id of the component, from ComponentManager::GetComponentTypeId()
+         */
+        const EntityMap &GetEntitiesWithComponentType(uint type_id) const;
+
+        //! Returns entities with a component of a certain class present, without copying
+        template <class T>
+        const EntityMap &GetEntitiesWithComponent() const
+        {
+            static uint type_id = 0;
+            if (!type_id)
+                type_id = GetComponentTypeId(T::TypeNameStatic());
+            return GetEntitiesWithComponentType(type_id);
+        }
+
+        //! Adds an entity to the entities of a component type. Called by the entity when the first component of the type is added
+        /*! Entities that are not in the scene yet are indexed when they are added to the scene.
+            \param entity Entity pointer
+            \param type_id Type id of the component
+         */
+        void IndexComponentType(Scene::Entity* entity, uint type_id);
+
+        //! Removes an entity from the entities of a component type. Called by the entity when the last component of the type is removed
+        /*! \param entity Entity pointer
+            \param type_id Type id of the component
+         */
+        void UnindexComponentType(Scene::Entity* entity, uint type_id);
         
         //! Emit notification of an attribute changing. Called by IComponent.
         /*! \param comp Component pointer
@@ -255,9 +308,35 @@ namespace Scene
     private:
         Q_DISABLE_COPY(SceneManager);
 
+        //! Returns the type id of a component type name, assigning one if needed
+        uint GetComponentTypeId(const QString &type_name) const;
+
+        //! Indexes an entity of the scene under its current name, or removes it from the name index if it has no EC_Name
+        void IndexName(Scene::Entity* entity);
+
+        //! Removes an entity from the name index
+        void UnindexName(entity_id_t id);
+
         //! Entities in a map
         EntityMap entities_;
 
+        //! Entities by the types of their components, indexed by component type id
+        /*! The maps are allocated separately, so that they stay in place while iterated even if new types get indexed.
+         */
+        std::vector<boost::shared_ptr<EntityMap> > entities_by_type_;
+
+        //! Entities by name
+        QHash<QString, EntityMap> entities_by_name_;
+
+        //! Names the entities are indexed under, by entity id
+        std::map<entity_id_t, QString> entity_names_;
+
+        //! Indexed names in order, for prefix queries
+        std::set<QString> names_;
+
+        //! Type id of EC_Name
+        uint name_type_id_;
+
         //! parent framework
         Foundation::Framework *framework_;
 
@@ -0,0 +1,442 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#include "StableHeaders.h"
+#include "CoreDefines.h"
+#include "DxtCompressor.h"
+#include "TextureResource.h"
+
+namespace TextureDecoder
+{
+    //! Ogre pixel formats of the images loaded with Qt, see OpenJpegDecoder
+    static const int OGRE_PF_R5G6B5 = 6;
+    static const int OGRE_PF_A8R8G8B8 = 12;
+    static const int OGRE_PF_X8R8G8B8 = 26;
+
+    //! Converts a decoded texture to RGBA, one byte per component
+    /*! \return false if the format is not supported
+     */
+    static bool ConvertToRgba(TextureResource& source, std::vector<u8>& rgba, bool& has_alpha)
+    {
+        const uint width = source.GetWidth();
+        const uint height = source.GetHeight();
+        const uint num_pixels = width * height;
+        const u8* src = source.GetData();
+        has_alpha = false;
+        if (!num_pixels || !src)
+            return false;
+
+        rgba.resize(num_pixels * 4);
+        u8* dest = &rgba[0];
+        // Images loaded with Qt may have padded rows
+        const uint stride = source.GetDataSize() / height;
+
+        switch (source.GetFormat())
+        {
+        case -1:
+            {
+                const uint comps = source.GetComponents();
+                if (comps < 1 || comps > 4 || source.GetDataSize() < num_pixels * comps)
+                    return false;
+                for(uint i = 0; i < num_pixels; ++i, src += comps, dest += 4)
+                {
+                    switch (comps)
+                    {
+                    case 1:
+                        dest[0] = dest[1] = dest[2] = src[0];
+                        dest[3] = 255;
+                        break;
+                    case 2:
+                        dest[0] = dest[1] = dest[2] = src[0];
+                        dest[3] = src[1];
+                        break;
+                    case 3:
+                        dest[0] = src[0];
+                        dest[1] = src[1];
+                        dest[2] = src[2];
+                        dest[3] = 255;
+                        break;
+                    default:
+                        dest[0] = src[0];
+                        dest[1] = src[1];
+                        dest[2] = src[2];
+                        dest[3] = src[3];
+                        break;
+                    }
+                    if (dest[3] != 255)
+                        has_alpha = true;
+                }
+            }
+            return true;
+
+        case OGRE_PF_A8R8G8B8:
+        case OGRE_PF_X8R8G8B8:
+            {
+                if (stride < width * 4)
+                    return false;
+                const bool use_alpha = source.GetFormat() == OGRE_PF_A8R8G8B8;
+                for(uint y = 0; y < height; ++y)
+                {
+                    const u8* row = src + y * stride;
+                    for(uint x = 0; x < width; ++x, dest += 4)
+                    {
+                        // Native endian packed pixels
+                        u32 pixel;
+                        memcpy(&pixel, row + x * 4, 4);
+                        dest[0] = (u8)(pixel >> 16);
+                        dest[1] = (u8)(pixel >> 8);
+                        dest[2] = (u8)pixel;
+                        dest[3] = use_alpha ? (u8)(pixel >> 24) : 255;
+                        if (dest[3] != 255)
+                            has_alpha = true;
+                    }
+                }
+            }
+            return true;
+
+        case OGRE_PF_R5G6B5:
+            {
+                if (stride < width * 2)
+                    return false;
+                for(uint y = 0; y < height; ++y)
+                {
+                    const u8* row = src + y * stride;
+                    for(uint x = 0; x < width; ++x, dest += 4)
+                    {
+                        u16 pixel;
+                        memcpy(&pixel, row + x * 2, 2);
+                        uint r = (pixel >> 11) & 31;
+                        uint g = (pixel >> 5) & 63;
+                        uint b = pixel & 31;
+                        dest[0] = (u8)((r << 3) | (r >> 2));
+                        dest[1] = (u8)((g << 2) | (g >> 4));
+                        dest[2] = (u8)((b << 3) | (b >> 2));
+                        dest[3] = 255;
+                    }
+                }
+            }
+            return true;
+
+        default:
+            return false;
+        }
+    }
+
+    //! Halves an RGBA image with a box filter
+    static void Downsample(const u8* src, uint width, uint height, u8* dest)
+    {
+        const uint dest_width = std::max(width / 2, 1u);
+        const uint dest_height = std::max(height / 2, 1u);
+        for(uint y = 0; y < dest_height; ++y)
+        {
+            const u8* row0 = src + (y * 2) * width * 4;
+            const u8* row1 = src + std::min(y * 2 + 1, height - 1) * width * 4;
+            for(uint x = 0; x < dest_width; ++x, dest += 4)
+            {
+                uint x0 = x * 2 * 4;
+                uint x1 = std::min(x * 2 + 1, width - 1) * 4;
+                for(uint c = 0; c < 4; ++c)
+                    dest[c] = (u8)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+            }
+        }
+    }
+
+    //! Packs a color to 5:6:5 bits
+    static inline u16 PackColor565(int r, int g, int b)
+    {
+        return (u16)(((r * 31 + 127) / 255) << 11 | ((g * 63 + 127) / 255) << 5 | ((b * 31 + 127) / 255));
+    }
+
+    //! Expands a 5:6:5 color to 8 bits per component
+    static inline void UnpackColor565(u16 color, int* rgb)
+    {
+        int r = (color >> 11) & 31;
+        int g = (color >> 5) & 63;
+        int b = color & 31;
+        rgb[0] = (r << 3) | (r >> 2);
+        rgb[1] = (g << 2) | (g >> 4);
+        rgb[2] = (b << 3) | (b >> 2);
+    }
+
+    static inline void WriteU16(u8* dest, u16 value)
+    {
+        dest[0] = (u8)value;
+        dest[1] = (u8)(value >> 8);
+    }
+
+    static inline void WriteU32(u8* dest, u32 value)
+    {
+        dest[0] = (u8)value;
+        dest[1] = (u8)(value >> 8);
+        dest[2] = (u8)(value >> 16);
+        dest[3] = (u8)(value >> 24);
+    }
+
+    //! Compresses the colors of a 4x4 block to 8 bytes of DXT1, in the four color mode
+    /*! Uses the bounding box of the colors, inset a little and flipped to follow their main diagonal, as the endpoints
+     */
+    static void CompressColorBlock(const u8* block, u8* dest)
+    {
+        int min[3] = { 255, 255, 255 };
+        int max[3] = { 0, 0, 0 };
+        for(uint i = 0; i < 16; ++i)
+            for(uint c = 0; c < 3; ++c)
+            {
+                min[c] = std::min(min[c], (int)block[i * 4 + c]);
+                max[c] = std::max(max[c], (int)block[i * 4 + c]);
+            }
+
+        // Choose the diagonal of the box whose direction the red and green components correlate with blue along
+        int cov_rb = 0;
+        int cov_gb = 0;
+        for(uint i = 0; i < 16; ++i)
+        {
+            int b = block[i * 4 + 2] * 2 - (min[2] + max[2]);
+            cov_rb += (block[i * 4] * 2 - (min[0] + max[0])) * b;
+            cov_gb += (block[i * 4 + 1] * 2 - (min[1] + max[1])) * b;
+        }
+        if (cov_rb < 0)
+            std::swap(min[0], max[0]);
+        if (cov_gb < 0)
+            std::swap(min[1], max[1]);
+
+        for(uint c = 0; c < 3; ++c)
+        {
+            int inset = (max[c] - min[c]) / 16;
+            max[c] -= inset;
+            min[c] += inset;
+        }
+
+        u16 color0 = PackColor565(max[0], max[1], max[2]);
+        u16 color1 = PackColor565(min[0], min[1], min[2]);
+        u32 indices = 0;
+
+        if (color0 != color1)
+        {
+            // The four color mode requires the first endpoint to be the greater one
+            if (color0 < color1)
+                std::swap(color0, color1);
+
+            int p0[3];
+            int p1[3];
+            UnpackColor565(color0, p0);
+            UnpackColor565(color1, p1);
+            int dir[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+            int length_sq = dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2];
+
+            // Project onto the line between the endpoints, and map the step from the first endpoint to the index
+            static const u32 step_to_index[4] = { 0, 2, 3, 1 };
+            for(uint i = 0; i < 16; ++i)
+            {
+                int dot = (block[i * 4] - p0[0]) * dir[0] + (block[i * 4 + 1] - p0[1]) * dir[1] + (block[i * 4 + 2] - p0[2]) * dir[2];
+                int step = (dot * 6 + length_sq) / (length_sq * 2);
+                step = step < 0 ? 0 : (step > 3 ? 3 : step);
+                indices |= step_to_index[step] << (i * 2);
+            }
+        }
+
+        WriteU16(dest, color0);
+        WriteU16(dest + 2, color1);
+        WriteU32(dest + 4, indices);
+    }
+
+    //! Compresses the alpha of a 4x4 block to 8 bytes of DXT5, in the eight value mode
+    static void CompressAlphaBlock(const u8* block, u8* dest)
+    {
+        int min = 255;
+        int max = 0;
+        for(uint i = 0; i < 16; ++i)
+        {
+            min = std::min(min, (int)block[i * 4 + 3]);
+            max = std::max(max, (int)block[i * 4 + 3]);
+        }
+
+        dest[0] = (u8)max;
+        dest[1] = (u8)min;
+        u8* bits = dest + 2;
+        memset(bits, 0, 6);
+        if (max == min)
+            return;
+
+        static const uint step_to_index[8] = { 0, 2, 3, 4, 5, 6, 7, 1 };
+        const int range = max - min;
+        for(uint i = 0; i < 16; ++i)
+        {
+            int step = ((max - block[i * 4 + 3]) * 14 + range) / (range * 2);
+            uint index = step_to_index[step < 0 ? 0 : (step > 7 ? 7 : step)];
+            uint bit = i * 3;
+            bits[bit >> 3] |= (u8)(index << (bit & 7));
+            if ((bit & 7) > 5)
+                bits[(bit >> 3) + 1] |= (u8)(index >> (8 - (bit & 7)));
+        }
+    }
+
+    //! Compresses one RGBA mipmap level. Pixels of the edge blocks outside the image repeat the edge pixels
+    static void CompressLevel(const u8* rgba, uint width, uint height, bool dxt5, u8* dest)
+    {
+        u8 block[16 * 4];
+        for(uint by = 0; by < height; by += 4)
+            for(uint bx = 0; bx < width; bx += 4)
+            {
+                for(uint y = 0; y < 4; ++y)
+                {
+                    const u8* row = rgba + std::min(by + y, height - 1) * width * 4;
+                    for(uint x = 0; x < 4; ++x)
+                        memcpy(block + (y * 4 + x) * 4, row + std::min(bx + x, width - 1) * 4, 4);
+                }
+
+                if (dxt5)
+                {
+                    CompressAlphaBlock(block, dest);
+                    dest += 8;
+                }
+                CompressColorBlock(block, dest);
+                dest += 8;
+            }
+    }
+
+    //! Returns the size of a compressed mipmap level
+    static inline uint GetCompressedSize(uint width, uint height, bool dxt5)
+    {
+        return ((width + 3) / 4) * ((height + 3) / 4) * (dxt5 ? 16 : 8);
+    }
+
+    bool IsCompressedFormat(int format)
+    {
+        return format == OGRE_PF_DXT1 || format == OGRE_PF_DXT5;
+    }
+
+    Foundation::ResourcePtr CompressTexture(TextureResource& source)
+    {
+        const uint width = source.GetWidth();
+        const uint height = source.GetHeight();
+        // Graphics APIs require the full size image of a compressed texture to consist of whole blocks
+        if (!width || !height || (width & 3) || (height & 3) || IsCompressedFormat(source.GetFormat()))
+            return Foundation::ResourcePtr();
+
+        std::vector<u8> rgba;
+        bool has_alpha;
+        if (!ConvertToRgba(source, rgba, has_alpha))
+            return Foundation::ResourcePtr();
+
+        uint num_mipmaps = 0;
+        uint data_size = 0;
+        for(uint w = width, h = height; ; w = std::max(w / 2, 1u), h = std::max(h / 2, 1u))
+        {
+            data_size += GetCompressedSize(w, h, has_alpha);
+            if (w == 1 && h == 1)
+                break;
+            ++num_mipmaps;
+        }
+
+        Foundation::ResourcePtr resource(new TextureResource(source.GetId()));
+        TextureResource* texture = checked_static_cast<TextureResource*>(resource.get());
+        texture->SetWidth(width);
+        texture->SetHeight(height);
+        texture->SetComponents(has_alpha ? 4 : 3);
+        texture->SetLevel(source.GetLevel());
+        texture->SetFormat(has_alpha ? OGRE_PF_DXT5 : OGRE_PF_DXT1);
+        texture->SetNumMipmaps(num_mipmaps);
+        texture->ResizeData(data_size);
+
+        u8* dest = texture->GetData();
+        std::vector<u8> smaller;
+        uint w = width;
+        uint h = height;
+        for(uint level = 0; ; ++level)
+        {
+            CompressLevel(&rgba[0], w, h, has_alpha, dest);
+            dest += GetCompressedSize(w, h, has_alpha);
+            if (level == num_mipmaps)
+                break;
+
+            smaller.resize(std::max(w / 2, 1u) * std::max(h / 2, 1u) * 4);
+            Downsample(&rgba[0], w, h, &smaller[0]);
+            rgba.swap(smaller);
+            w = std::max(w / 2, 1u);
+            h = std::max(h / 2, 1u);
+        }
+
+        return resource;
+    }
+
+    Foundation::ResourcePtr DecompressTexture(TextureResource& source)
+    {
+        const int format = source.GetFormat();
+        const uint width = source.GetWidth();
+        const uint height = source.GetHeight();
+        const bool dxt5 = format == OGRE_PF_DXT5;
+        if (!IsCompressedFormat(format) || !width || !height || source.GetDataSize() < GetCompressedSize(width, height, dxt5))
+            return Foundation::ResourcePtr();
+
+        Foundation::ResourcePtr resource(new TextureResource(source.GetId(), width, height, 4));
+        TextureResource* texture = checked_static_cast<TextureResource*>(resource.get());
+        texture->SetLevel(source.GetLevel());
+
+        const u8* src = source.GetData();
+        u8* dest = texture->GetData();
+        for(uint by = 0; by < height; by += 4)
+            for(uint bx = 0; bx < width; bx += 4)
+            {
+                int alpha[8];
+                u64 alpha_bits = 0;
+                if (dxt5)
+                {
+                    alpha[0] = src[0];
+                    alpha[1] = src[1];
+                    if (alpha[0] > alpha[1])
+                    {
+                        for(int i = 1; i < 7; ++i)
+                            alpha[i + 1] = ((7 - i) * alpha[0] + i * alpha[1]) / 7;
+                    }
+                    else
+                    {
+                        for(int i = 1; i < 5; ++i)
+                            alpha[i + 1] = ((5 - i) * alpha[0] + i * alpha[1]) / 5;
+                        alpha[6] = 0;
+                        alpha[7] = 255;
+                    }
+                    for(int i = 5; i >= 0; --i)
+                        alpha_bits = (alpha_bits << 8) | src[2 + i];
+                    src += 8;
+                }
+
+                u16 color0 = (u16)(src[0] | (src[1] << 8));
+                u16 color1 = (u16)(src[2] | (src[3] << 8));
+                u32 indices = (u32)src[4] | ((u32)src[5] << 8) | ((u32)src[6] << 16) | ((u32)src[7] << 24);
+                src += 8;
+
+                int palette[4][4];
+                UnpackColor565(color0, palette[0]);
+                UnpackColor565(color1, palette[1]);
+                for(uint c = 0; c < 3; ++c)
+                {
+                    if (color0 > color1 || dxt5)
+                    {
+                        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+                    }
+                    else
+                    {
+                        palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+                        palette[3][c] = 0;
+                    }
+                }
+                palette[0][3] = palette[1][3] = palette[2][3] = 255;
+                palette[3][3] = (color0 > color1 || dxt5) ? 255 : 0;
+
+                for(uint y = 0; y < 4 && by + y < height; ++y)
+                    for(uint x = 0; x < 4 && bx + x < width; ++x)
+                    {
+                        uint i = y * 4 + x;
+                        const int* color = palette[(indices >> (i * 2)) & 3];
+                        u8* pixel = dest + ((by + y) * width + bx + x) * 4;
+                        pixel[0] = (u8)color[0];
+                        pixel[1] = (u8)color[1];
+                        pixel[2] = (u8)color[2];
+                        pixel[3] = dxt5 ? (u8)alpha[(alpha_bits >> (i * 3)) & 7] : (u8)color[3];
+                    }
+            }
+
+        return resource;
+    }
+}
@@ -0,0 +1,35 @@
+// For conditions of distribution and use, see copyright notice in license.txt
+
+#ifndef incl_TextureDecoder_DxtCompressor_h
+#define incl_TextureDecoder_DxtCompressor_h
+
+#include "ResourceInterface.h"
+
+namespace TextureDecoder
+{
+    class TextureResource;
+
+    //! Ogre pixel format of DXT1 compressed textures. This module does not depend on Ogre, so the value is repeated here
+    const int OGRE_PF_DXT1 = 17;
+
+    //! Ogre pixel format of DXT5 compressed textures
+    const int OGRE_PF_DXT5 = 21;
+
+    //! Returns whether a texture format is DXT compressed
+    bool IsCompressedFormat(int format);
+
+    //! Compresses a decoded texture to DXT1, or to DXT5 if it has alpha, with a full mipmap chain
+    /*! Used to store textures to the texture cache in a form that can be uploaded as is. Thread-safe.
+        \param source Decoded texture, with format -1 (components in order) or one of the formats of images loaded with Qt
+        \return Compressed texture, or null if the format is not supported or the dimensions are not multiples of 4
+     */
+    Foundation::ResourcePtr CompressTexture(TextureResource& source);
+
+    //! Decompresses the full size image of a DXT compressed texture
+    /*! \param source Compressed texture
+        \return Texture with 4 components in RGBA order and format -1, or null if the source is not DXT compressed
+     */
+    Foundation::ResourcePtr DecompressTexture(TextureResource& source);
+}
+
+#endif
@@ -40,58 +40,111 @@
 #include "TextureDecoderModule.h"
 #include "ThreadTaskManager.h"
 #include "OpenJpegDecoder.h"
+#include "DxtCompressor.h"
 #include "Profiler.h"
 
 #include <openjpeg.h>
 
 #include <QImage>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OPENJPEGDECODER_SSE2
+#include <emmintrin.h>
+#endif
+
 namespace TextureDecoder
 {
-    OpenJpegDecoder::OpenJpegDecoder() :
-        Foundation::ThreadTask("TextureDecoder"),
-        decodes_per_frame_(1)
+    //! Clamps a decoded sample to a byte
+    static inline u8 ClampSample(int value)
+    {
+        return (u8)(value < 0 ? 0 : (value > 255 ? 255 : value));
+    }
+
+    //! Converts the planar components of a decoded image to packed pixels, one byte per component
+    /*! \param image Decoded image. All the components must be width x height samples
+        \param dest Destination, width * height * image->numcomps bytes
+     */
+    static void PackComponents(const opj_image_t* image, u8* dest, int width, int height)
+    {
+        const int num_pixels = width * height;
+        const int num_comps = image->numcomps;
+        int i = 0;
+
+        if (num_comps == 4)
+        {
+            const int* r = image->comps[0].data;
+            const int* g = image->comps[1].data;
+            const int* b = image->comps[2].data;
+            const int* a = image->comps[3].data;
+#ifdef OPENJPEGDECODER_SSE2
+            // Eight pixels at a time: saturate the samples to bytes, then interleave the bytes of the four planes
+            for(; i + 8 <= num_pixels; i += 8)
+            {
+                __m128i r16 = _mm_packs_epi32(_mm_loadu_si128((const __m128i*)(r + i)), _mm_loadu_si128((const __m128i*)(r + i + 4)));
+                __m128i g16 = _mm_packs_epi32(_mm_loadu_si128((const __m128i*)(g + i)), _mm_loadu_si128((const __m128i*)(g + i + 4)));
+                __m128i b16 = _mm_packs_epi32(_mm_loadu_si128((const __m128i*)(b + i)), _mm_loadu_si128((const __m128i*)(b + i + 4)));
+                __m128i a16 = _mm_packs_epi32(_mm_loadu_si128((const __m128i*)(a + i)), _mm_loadu_si128((const __m128i*)(a + i + 4)));
+                __m128i rb = _mm_packus_epi16(r16, b16); // r0..r7 b0..b7
+                __m128i ga = _mm_packus_epi16(g16, a16); // g0..g7 a0..a7
+                __m128i rg = _mm_unpacklo_epi8(rb, ga); // r0 g0 r1 g1 ... r7 g7
+                __m128i ba = _mm_unpackhi_epi8(rb, ga); // b0 a0 b1 a1 ... b7 a7
+                _mm_storeu_si128((__m128i*)(dest + i * 4), _mm_unpacklo_epi16(rg, ba));
+                _mm_storeu_si128((__m128i*)(dest + i * 4 + 16), _mm_unpackhi_epi16(rg, ba));
+            }
+#endif
+            for(; i < num_pixels; ++i)
+            {
+                dest[i * 4] = ClampSample(r[i]);
+                dest[i * 4 + 1] = ClampSample(g[i]);
+                dest[i * 4 + 2] = ClampSample(b[i]);
+                dest[i * 4 + 3] = ClampSample(a[i]);
+            }
+        }
+        else if (num_comps == 3)
+        {
+            const int* r = image->comps[0].data;
+            const int* g = image->comps[1].data;
+            const int* b = image->comps[2].data;
+            for(; i < num_pixels; ++i)
+            {
+                dest[i * 3] = ClampSample(r[i]);
+                dest[i * 3 + 1] = ClampSample(g[i]);
+                dest[i * 3 + 2] = ClampSample(b[i]);
+            }
+        }
+        else
+        {
+            for(int c = 0; c < num_comps; ++c)
+            {
+                const int* src = image->comps[c].data;
+                u8* out = dest + c;
+                for(i = 0; i < num_pixels; ++i, out += num_comps)
+                    *out = ClampSample(src[i]);
+            }
+        }
+    }
+
+    OpenJpegDecoder::OpenJpegDecoder(uint max_concurrency) :
+        Foundation::ThreadTask("TextureDecoder", max_concurrency)
     {
+        SetMaxQueuedResults(1);
     }
     
     void OpenJpegDecoder::SetDecodesPerFrame(uint decodes) 
     { 
+        // Pause if "too many" results already produced, to prevent slowing down the main thread with 
+        // too many texture creations per frame
         if (decodes)
-            decodes_per_frame_ = decodes;
+            SetMaxQueuedResults(decodes);
     }
     
-    void OpenJpegDecoder::Work()
+    void OpenJpegDecoder::ProcessRequest(Foundation::ThreadTaskRequestPtr request)
     {
-        while (ShouldRun())
+        DecodeRequestPtr decode_request = boost::dynamic_pointer_cast<DecodeRequest>(request);
+        if (decode_request)
         {
-            WaitForRequests();
-            
-            DecodeRequestPtr request = GetNextRequest<DecodeRequest>();
-            if (request)
-            {
-                // Wait if "too many" results already produced, to prevent slowing down the main thread with 
-                // too many texture creations per frame
-                Foundation::ThreadTaskManager* manager = GetThreadTaskManager();
-                if (manager)
-                {
-                    for (;;)
-                    {
-                        uint results = manager->GetNumResults(GetTaskDescription());
-                        if (results < decodes_per_frame_)
-                            break;
-                        if (!ShouldRun())
-                            return;
-                        boost::this_thread::sleep(boost::posix_time::milliseconds(20));
-                    }
-                }
-                
-                {
-                    PROFILE(OpenJpegDecoder_Decode);
-                    PerformDecode(request);
-                }
-            }
-
-            RESETPROFILER
+            PROFILE(OpenJpegDecoder_Decode);
+            PerformDecode(decode_request);
         }
     }
 
@@ -124,6 +177,7 @@ namespace TextureDecoder
         result->original_width_ = 0;
         result->original_height_ = 0;
         result->components_ = 0;
+        result->is_jpeg2000_ = false;
         result->tag_ = request->tag_;
 
         if (!texture_id_is_url)
@@ -175,6 +229,15 @@ namespace TextureDecoder
                 // Assume all components are same size
                 int actual_width = image->comps[0].w;
                 int actual_height = image->comps[0].h;
+                for (int c = 1; c < image->numcomps; ++c)
+                    if (image->comps[c].w != image->comps[0].w || image->comps[c].h != image->comps[0].h)
+                    {
+                        TextureDecoderModule::LogError("Texture " + request->id_ + " has subsampled components, which are not supported");
+                        result->level_ = -1;
+                        opj_image_destroy(image);
+                        QueueResult<DecodeResult>(result);
+                        return;
+                    }
 
                 // Create a (possibly temporary, if no-one stores the pointer) raw texture resource
                 Foundation::ResourcePtr resource(new TextureResource(request->source_->GetId(), actual_width, actual_height, image->numcomps));
@@ -183,17 +246,7 @@ namespace TextureDecoder
                 texture->SetLevel(request->level_);
                 texture->SetDataSize(actual_width * actual_height * image->numcomps);
 
-                for (int y = 0; y < actual_height; ++y)
-                {
-                    for (int x = 0; x < actual_width; ++x)
-                    {
-                        for (int c = 0; c < image->numcomps; ++c)
-                        {
-                            *data = image->comps[c].data[y * actual_width + x];
-                            data++;
-                        }
-                    }
-                }
+                PackComponents(image, data, actual_width, actual_height);
          
                 result->texture_ = resource;
                 result->is_jpeg2000_ = true;
@@ -271,6 +324,19 @@ namespace TextureDecoder
 
         }
 
+        // Prepare the version of a fully decoded texture to store to the cache here, so that compressing it
+        // does not take time from the main thread
+        if ((result->texture_) && (result->level_ == 0) && ((result->is_jpeg2000_) || (request->cache_everything_)))
+        {
+            if (request->compress_for_cache_)
+            {
+                PROFILE(OpenJpegDecoder_CompressForCache);
+                result->cache_texture_ = CompressTexture(*checked_static_cast<TextureResource*>(result->texture_.get()));
+            }
+            if (!result->cache_texture_)
+                result->cache_texture_ = result->texture_;
+        }
+
         QueueResult<DecodeResult>(result);
     }
 }
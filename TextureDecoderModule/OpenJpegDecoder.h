@@ -11,28 +11,30 @@
 
 namespace TextureDecoder
 {
-    //! OpenJpeg decoder that runs in a thread and serves decode requests, used internally by TextureService
+    //! OpenJpeg decoder that serves decode requests in the thread pool, used internally by TextureService
     class OpenJpegDecoder : public Foundation::ThreadTask
     {
     public:
         //! Constructor
-        OpenJpegDecoder();
-        
-        //! Work function
-        virtual void Work();
+        /*! \param max_concurrency Maximum amount of textures to decode at the same time
+         */
+        explicit OpenJpegDecoder(uint max_concurrency);
         
         //! Set maximum amount of decodes to perform per frame
-        /*! \param decodes Amount of decodes per frame
+        /*! Decoding pauses while this many decoded textures wait to be handled by the main thread.
+            \param decodes Amount of decodes per frame
          */
         void SetDecodesPerFrame(uint decodes);
         
+    protected:
+        //! Decodes a texture. Called from the thread pool.
+        virtual void ProcessRequest(Foundation::ThreadTaskRequestPtr request);
+
     private:
         //! perform a decode & queue result
         /*! \param request decode request to serve
          */
         void PerformDecode(DecodeRequestPtr request);
-        
-        uint decodes_per_frame_;
     };
 }
 #endif
\ No newline at end of file
@@ -55,6 +55,67 @@ namespace TextureDecoder
     {
     }
 
+    //! Identifies the texture cache file format, "TXC2"
+    static const quint32 TEXTURE_CACHE_MAGIC = 0x54584332;
+
+    bool TextureCache::WriteTexture(QIODevice& device, Foundation::TextureInterface* texture)
+    {
+        // Write metadata
+        QDataStream data_stream(&device);
+        data_stream << TEXTURE_CACHE_MAGIC
+                    << texture->GetComponents()
+                    << texture->GetWidth()
+                    << texture->GetHeight()
+                    << texture->GetLevel()
+                    << texture->GetFormat()
+                    << texture->GetNumMipmaps()
+                    << (int)texture->GetDataSize();
+
+        // Write data
+        data_stream.writeRawData((const char *)texture->GetData(), texture->GetDataSize());
+        return data_stream.status() == QDataStream::Ok;
+    }
+
+    TextureResource* TextureCache::ReadTexture(QIODevice& device, const std::string& texture_id)
+    {
+        quint32 magic;
+        int data_length, format, level;
+        uint components, width, height, num_mipmaps;
+
+        // Read metadata
+        QDataStream data_stream(&device);
+        data_stream >> magic;
+        if (magic != TEXTURE_CACHE_MAGIC)
+            return 0;
+        data_stream >> components;
+        data_stream >> width;
+        data_stream >> height;
+        data_stream >> level;
+        data_stream >> format;
+        data_stream >> num_mipmaps;
+        data_stream >> data_length;
+        if (data_stream.status() != QDataStream::Ok || data_length <= 0 || data_length > device.bytesAvailable())
+            return 0;
+
+        // Init TextureResource with metadata
+        TextureResource *texture = new TextureResource(texture_id);
+        texture->SetWidth(width);
+        texture->SetHeight(height);
+        texture->SetComponents(components);
+        texture->SetLevel(level);
+        texture->SetFormat(format);
+        texture->SetNumMipmaps(num_mipmaps);
+        texture->ResizeData(data_length);
+
+        // Read data
+        if (data_stream.readRawData((char*)texture->GetData(), data_length) != data_length)
+        {
+            delete texture;
+            return 0;
+        }
+        return texture;
+    }
+
     void TextureCache::StoreTexture(Foundation::TextureInterface *texture)
     {
         QString id = GetHash(texture->GetId());
@@ -64,18 +125,12 @@ namespace TextureDecoder
             if (!decoded_texture.open(QIODevice::ReadWrite))
                 return;
 
-            // Write metadata
-            QDataStream data_stream(&decoded_texture);
-            data_stream << texture->GetComponents()
-                        << texture->GetWidth()
-                        << texture->GetHeight()
-                        << texture->GetLevel()
-                        << texture->GetFormat()
-                        << (int)texture->GetDataSize();
-
-            // Write data
-            data_stream.writeRawData((const char *)texture->GetData(), texture->GetDataSize());
-      
+            if (!WriteTexture(decoded_texture, texture))
+            {
+                decoded_texture.remove();
+                return;
+            }
+
             decoded_texture.close();
             current_cache_size_ += decoded_texture.size();
 
@@ -98,28 +153,17 @@ namespace TextureDecoder
             if (!decoded_texture.open(QIODevice::ReadOnly))
                 return 0;
 
-            int data_length, format, level;
-            uint components, width, height;
-
-            // Read metadata
-            QDataStream data_stream(&decoded_texture);
-            data_stream >> components;
-            data_stream >> width;
-            data_stream >> height;
-            data_stream >> level;
-            data_stream >> format;
-            data_stream >> data_length;
-
-            // Init TextureResource with metadata
-            TextureResource *texture = new TextureResource(texture_id, width, height, components);
-            texture->SetLevel(level);
-            texture->SetFormat(format);
-
-            // Read data
-            char *data_str_ptr = (char*)texture->GetData();
-            data_stream.readRawData(data_str_ptr, data_length);
-
+            TextureResource *texture = ReadTexture(decoded_texture, texture_id);
             decoded_texture.close();
+            if (!texture)
+            {
+                // Written by an older version, or incompletely. Remove, so that the texture is decoded and stored again
+                qint64 file_size = decoded_texture.size();
+                if (decoded_texture.remove())
+                    current_cache_size_ -= file_size;
+                return 0;
+            }
+
             TextureDecoderModule::LogDebug("Found decoded texture " + id.left(7).toStdString() + "... from cache");
             return texture;
         }
@@ -6,6 +6,8 @@
 #include <QObject>
 #include <QDir>
 
+class QIODevice;
+
 #include "Foundation.h"
 #include "TextureResource.h"
 
@@ -18,6 +20,8 @@ namespace TextureDecoder
     {
         Foundation::ResourcePtr resource;
         RequestTagVector tags;   
+        //! Tags of requests that need uncompressed data
+        RequestTagVector raw_tags;
     };
 
     class TextureCache : public QObject
@@ -28,6 +32,16 @@ namespace TextureDecoder
             TextureCache(Foundation::Framework* framework);
             virtual ~TextureCache();
 
+            //! Writes a texture in the texture cache file format
+            /*! \return true if successful
+             */
+            static bool WriteTexture(QIODevice& device, Foundation::TextureInterface* texture);
+
+            //! Reads a texture in the texture cache file format
+            /*! \return Texture, or null if the data is in an older format or truncated
+             */
+            static TextureResource* ReadTexture(QIODevice& device, const std::string& texture_id);
+
         public slots:
             //! Store a texture to disk cache
             //! @param TextureInterface implementing pointer
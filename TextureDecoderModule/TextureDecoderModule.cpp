@@ -4,9 +4,18 @@
 #include "ConsoleCommandServiceInterface.h"
 #include "TextureService.h"
 #include "TextureDecoderModule.h"
+#include "OpenJpegDecoder.h"
 #include "Framework.h"
 #include "EventManager.h"
 #include "ServiceManager.h"
+#include "ThreadTaskManager.h"
+#include "HighPerfClock.h"
+#include "TextureCache.h"
+
+#include <QDir>
+#include <QFile>
+
+#include <sstream>
 
 namespace TextureDecoder
 {
@@ -33,6 +42,18 @@ namespace TextureDecoder
         EventManagerPtr event_manager = framework_->GetEventManager();
         asset_event_category_ = event_manager->QueryEventCategory("Asset");
         task_event_category_ = event_manager->QueryEventCategory("Task");
+        event_manager->SubscribeToEventCategory(this, asset_event_category_);
+        event_manager->SubscribeToEventCategory(this, task_event_category_);
+
+        RegisterConsoleCommand(Console::CreateCommand("texturedecodebench",
+            "Decodes the JPEG2000 files in a directory on 1, 2, 4... threads and reports the speedup. "
+            "Usage: \"texturedecodebench(directory, maxthreads)\"",
+            Console::Bind(this, &TextureDecoderModule::RunDecodeBenchmark)));
+
+        RegisterConsoleCommand(Console::CreateCommand("texturecachebench",
+            "Decodes the JPEG2000 files in a directory and stores them in the texture cache format, uncompressed and DXT compressed, "
+            "then loads them back, and reports the times and sizes. Usage: \"texturecachebench(directory)\"",
+            Console::Bind(this, &TextureDecoderModule::RunCacheBenchmark)));
     }
     
     // virtual
@@ -71,6 +92,191 @@ namespace TextureDecoder
         }
         return false;
     }
+
+    namespace
+    {
+        //! A JPEG2000 stream read from a file, for the decode benchmark
+        class BenchmarkAsset : public Foundation::AssetInterface
+        {
+        public:
+            BenchmarkAsset(const std::string& id, const QByteArray& data) : id_(id), type_("Texture"), data_(data) {}
+
+            virtual const std::string& GetId() const { return id_; }
+            virtual const std::string& GetType() const { return type_; }
+            virtual uint GetSize() const { return data_.size(); }
+            virtual const u8* GetData() const { return (const u8*)data_.constData(); }
+            virtual Foundation::AssetMetadataInterface* GetMetadata() const { return 0; }
+
+        private:
+            std::string id_;
+            std::string type_;
+            QByteArray data_;
+        };
+
+        //! Reads the files that begin with the JPEG2000 codestream marker from a directory
+        void LoadBenchmarkAssets(const std::string& path, std::vector<Foundation::AssetPtr>& assets)
+        {
+            QDir dir(QString::fromStdString(path));
+            QStringList files = dir.entryList(QDir::Files);
+            for(int i = 0; i < files.size(); ++i)
+            {
+                QFile file(dir.filePath(files[i]));
+                if (!file.open(QIODevice::ReadOnly))
+                    continue;
+                QByteArray data = file.readAll();
+                if (data.size() > 2 && (u8)data[0] == 0xFF && (u8)data[1] == 0x4F)
+                    assets.push_back(Foundation::AssetPtr(new BenchmarkAsset(files[i].toStdString(), data)));
+            }
+        }
+    }
+
+    Console::CommandResult TextureDecoderModule::RunDecodeBenchmark(const StringVector &params)
+    {
+        if (params.empty())
+            return Console::ResultFailure("Usage: \"texturedecodebench(directory, maxthreads)\"");
+
+        uint max_threads = params.size() > 1 ? ParseString<uint>(params[1], 0) : 0;
+        if (!max_threads)
+            max_threads = std::max(boost::thread::hardware_concurrency(), 1u);
+
+        std::vector<Foundation::AssetPtr> assets;
+        LoadBenchmarkAssets(params[0], assets);
+        if (assets.empty())
+            return Console::ResultFailure("No JPEG2000 files found in " + params[0]);
+
+        std::stringstream ss;
+        ss << "Decoding " << assets.size() << " textures" << std::endl;
+        double single_thread_seconds = 0.0;
+        for(uint threads = 1; ; threads = std::min(threads * 2, max_threads))
+        {
+            // A manager of our own, so that the results do not go to the texture service
+            Foundation::ThreadTaskManager manager(framework_, threads);
+            manager.AddThreadTask(Foundation::ThreadTaskPtr(new OpenJpegDecoder(threads)));
+
+            tick_t start_time = GetCurrentClockTime();
+            for(uint i = 0; i < assets.size(); ++i)
+            {
+                DecodeRequestPtr request(new DecodeRequest());
+                request->id_ = assets[i]->GetId();
+                request->source_ = assets[i];
+                request->level_ = 0;
+                manager.AddRequest<DecodeRequest>("TextureDecoder", request);
+            }
+
+            uint decoded = 0;
+            while(decoded < assets.size())
+            {
+                decoded += manager.GetResults().size();
+                if (decoded < assets.size())
+                    boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+            }
+            double seconds = (double)(GetCurrentClockTime() - start_time) / GetCurrentClockFreq();
+
+            if (threads == 1)
+                single_thread_seconds = seconds;
+            ss << threads << " threads: " << seconds * 1000.0 << " ms, speedup " << (seconds > 0.0 ? single_thread_seconds / seconds : 0.0) << std::endl;
+
+            if (threads == max_threads)
+                break;
+        }
+
+        return Console::ResultSuccess(ss.str());
+    }
+
+    Console::CommandResult TextureDecoderModule::RunCacheBenchmark(const StringVector &params)
+    {
+        if (params.empty())
+            return Console::ResultFailure("Usage: \"texturecachebench(directory)\"");
+
+        std::vector<Foundation::AssetPtr> assets;
+        LoadBenchmarkAssets(params[0], assets);
+        if (assets.empty())
+            return Console::ResultFailure("No JPEG2000 files found in " + params[0]);
+
+        QDir cache_dir = QDir::temp();
+        cache_dir.mkdir("texturecachebench");
+        if (!cache_dir.cd("texturecachebench"))
+            return Console::ResultFailure("Could not create a temporary directory");
+
+        uint threads = std::max(boost::thread::hardware_concurrency(), 1u);
+        // A manager of our own, so that the results do not go to the texture service
+        Foundation::ThreadTaskManager manager(framework_, threads);
+        manager.AddThreadTask(Foundation::ThreadTaskPtr(new OpenJpegDecoder(threads)));
+
+        std::stringstream ss;
+        ss << "Loading " << assets.size() << " textures on " << threads << " threads" << std::endl;
+        const char* variants[2] = { "uncompressed", "DXT compressed" };
+        std::vector<QString> stored_files[2];
+
+        // Cold: decode, prepare the cache version in the decode threads, and write it
+        for(uint compress = 0; compress < 2; ++compress)
+        {
+            tick_t start_time = GetCurrentClockTime();
+            for(uint i = 0; i < assets.size(); ++i)
+            {
+                DecodeRequestPtr request(new DecodeRequest());
+                request->id_ = assets[i]->GetId();
+                request->source_ = assets[i];
+                request->level_ = 0;
+                request->cache_everything_ = true;
+                request->compress_for_cache_ = compress != 0;
+                manager.AddRequest<DecodeRequest>("TextureDecoder", request);
+            }
+
+            uint decoded = 0;
+            u64 stored_bytes = 0;
+            while(decoded < assets.size())
+            {
+                std::vector<Foundation::ThreadTaskResultPtr> results = manager.GetResults();
+                for(uint i = 0; i < results.size(); ++i)
+                {
+                    DecodeResultPtr result = boost::dynamic_pointer_cast<DecodeResult>(results[i]);
+                    if (!result || !result->cache_texture_)
+                        continue;
+                    QString path = cache_dir.filePath(QString::number(stored_files[compress].size()) + (compress ? ".dxt" : ".raw"));
+                    QFile file(path);
+                    if (!file.open(QIODevice::WriteOnly))
+                        continue;
+                    if (TextureCache::WriteTexture(file, checked_static_cast<TextureResource*>(result->cache_texture_.get())))
+                    {
+                        stored_bytes += file.size();
+                        stored_files[compress].push_back(path);
+                    }
+                }
+                decoded += results.size();
+                if (decoded < assets.size())
+                    boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+            }
+            double seconds = (double)(GetCurrentClockTime() - start_time) / GetCurrentClockFreq();
+            ss << "Cold, " << variants[compress] << ": " << seconds * 1000.0 << " ms, " << stored_bytes << " bytes stored" << std::endl;
+        }
+
+        // Warm: read back from the cache files
+        for(uint compress = 0; compress < 2; ++compress)
+        {
+            tick_t start_time = GetCurrentClockTime();
+            uint loaded = 0;
+            for(uint i = 0; i < stored_files[compress].size(); ++i)
+            {
+                QFile file(stored_files[compress][i]);
+                if (!file.open(QIODevice::ReadOnly))
+                    continue;
+                TextureResource* texture = TextureCache::ReadTexture(file, file.fileName().toStdString());
+                if (texture)
+                    ++loaded;
+                delete texture;
+            }
+            double seconds = (double)(GetCurrentClockTime() - start_time) / GetCurrentClockFreq();
+            ss << "Warm, " << variants[compress] << ": " << seconds * 1000.0 << " ms, " << loaded << " textures" << std::endl;
+        }
+
+        for(uint compress = 0; compress < 2; ++compress)
+            for(uint i = 0; i < stored_files[compress].size(); ++i)
+                QFile::remove(stored_files[compress][i]);
+        QDir::temp().rmdir("texturecachebench");
+
+        return Console::ResultSuccess(ss.str());
+    }
 }
 
 extern "C" void POCO_LIBRARY_API SetProfiler(Foundation::Profiler *profiler);
@@ -35,6 +35,13 @@ namespace TextureDecoder
         //! returns name of this module. Needed for logging.
         static const std::string &NameStatic() { return type_name_static_; }
 
+        //! Console command: decodes the JPEG2000 files in a directory with a growing number of threads and reports the speedup.
+        Console::CommandResult RunDecodeBenchmark(const StringVector &params);
+
+        //! Console command: compares loading the JPEG2000 files in a directory through the texture cache format, cold and warm,
+        //! stored uncompressed and DXT compressed
+        Console::CommandResult RunCacheBenchmark(const StringVector &params);
+
     private:
         //! Type name of the module.
         static std::string type_name_static_;
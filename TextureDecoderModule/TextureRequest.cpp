@@ -7,6 +7,8 @@ namespace TextureDecoder
     TextureRequest::TextureRequest() :
         requested_(false),
         decode_requested_(false),
+        decode_tag_(0),
+        priority_(0.0f),
         size_(0),
         received_(0),
         width_(0),
@@ -21,6 +23,8 @@ namespace TextureDecoder
         id_(id),
         requested_(false),
         decode_requested_(false),
+        decode_tag_(0),
+        priority_(0.0f),
         size_(0),
         received_(0),
         width_(0),
@@ -81,6 +85,7 @@ namespace TextureDecoder
         {
             // Decode no longer pending
             decode_requested_ = false;
+            decode_tag_ = 0;
 
             // Update amount of quality levels, should now be known
             levels_ = result->max_levels_;
@@ -13,6 +13,8 @@ namespace TextureDecoder
     class DecodeRequest : public Foundation::ThreadTaskRequest
     {
     public:
+        DecodeRequest() : level_(0), cache_everything_(false), compress_for_cache_(false) {}
+
         //! Texture asset ID
         std::string id_;
 
@@ -21,6 +23,12 @@ namespace TextureDecoder
 
         //! Quality level to decode, 0 = highest
         int level_;
+
+        //! Whether to prepare the texture for the cache even if it is not JPEG2000
+        bool cache_everything_;
+
+        //! Whether to DXT compress the texture for the cache
+        bool compress_for_cache_;
     };
 
     typedef boost::shared_ptr<DecodeRequest> DecodeRequestPtr;
@@ -51,6 +59,11 @@ namespace TextureDecoder
         uint components_;
 
         bool is_jpeg2000_;
+
+        //! Texture to store to the texture cache, null if it should not be stored
+        /*! DXT compressed with mipmaps if requested and possible, otherwise the same as texture_
+         */
+        Foundation::ResourcePtr cache_texture_;
     };
     
     typedef boost::shared_ptr<DecodeResult> DecodeResultPtr;
@@ -74,7 +87,13 @@ namespace TextureDecoder
         void SetRequested(bool requested) { requested_ = requested; }
 
         //! Sets decode request status
-        void SetDecodeRequested(bool requested) { decode_requested_ = requested; }
+        /*! \param requested Whether a decode request is pending
+            \param tag Thread task request tag of the pending decode request
+         */
+        void SetDecodeRequested(bool requested, request_tag_t tag = 0) { decode_requested_ = requested; decode_tag_ = tag; }
+
+        //! Sets screen relevance, from 0 to 1
+        void SetPriority(f32 priority) { priority_ = priority; }
 
         //! Updates size & received count
         /*! \param size Total size of asset (from asset service)
@@ -112,6 +131,12 @@ namespace TextureDecoder
         //! Returns decode request status
         bool IsDecodeRequested() const { return decode_requested_; }
 
+        //! Returns thread task request tag of the pending decode request
+        request_tag_t GetDecodeTag() const { return decode_tag_; }
+
+        //! Returns screen relevance
+        f32 GetPriority() const { return priority_; }
+
         //! Returns total data size, 0 if unknown
         uint GetSize() const { return size_; }
         
@@ -154,6 +179,12 @@ namespace TextureDecoder
         //! whether decode request has been queued
         bool decode_requested_;
 
+        //! Thread task request tag of the pending decode request
+        request_tag_t decode_tag_;
+
+        //! Screen relevance, from 0 to 1
+        f32 priority_;
+
         //! Total data size, 0 if unknown
         uint size_;
 
@@ -11,8 +11,10 @@ namespace TextureDecoder
         width_(0),
         height_(0),
         components_(0),
+        data_size_(0),
+        format_(-1),
         level_(-1),
-        format_(-1)
+        num_mipmaps_(0)
     {
     }
 
@@ -21,8 +23,9 @@ namespace TextureDecoder
         width_(width),
         height_(height),
         components_(components),
+        format_(-1),
         level_(-1),
-        format_(-1)
+        num_mipmaps_(0)
     {
         data_.resize(width * height * components);
         data_size_ = width * height * components;
@@ -42,6 +45,12 @@ namespace TextureDecoder
         data_size_ = width * height * components;
     }
 
+    void TextureResource::ResizeData(uint data_size)
+    {
+        data_.resize(data_size);
+        data_size_ = data_size;
+    }
+
     static const std::string texture_resource_name("Texture");
 
     const std::string& TextureResource::GetType() const
@@ -22,6 +22,7 @@ namespace TextureDecoder
         virtual u8* GetData() { return &data_[0]; }
         virtual uint GetDataSize() { return data_size_; }
         virtual int GetFormat() { return format_; }
+        virtual uint GetNumMipmaps() { return num_mipmaps_; }
         virtual const std::string& GetType() const;
         static const std::string& GetTypeStatic();
 
@@ -31,6 +32,11 @@ namespace TextureDecoder
         void SetHeight(uint height) { height_ = height; }
         void SetLevel(int level) { level_ = level; }
         void SetFormat(int format) { format_ = format; }
+        void SetComponents(uint components) { components_ = components; }
+        void SetNumMipmaps(uint num_mipmaps) { num_mipmaps_ = num_mipmaps; }
+
+        //! Resizes the data buffer, for formats whose data size does not follow from the dimensions
+        void ResizeData(uint data_size);
 
     private:
         uint width_;
@@ -39,6 +45,7 @@ namespace TextureDecoder
         uint data_size_;
         int format_;
         int level_;
+        uint num_mipmaps_;
         std::vector<u8> data_;
     };
 }
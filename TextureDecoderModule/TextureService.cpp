@@ -16,12 +16,16 @@
 #include "ThreadTaskManager.h"
 #include "ConfigurationManager.h"
 #include "TextureCache.h"
+#include "DxtCompressor.h"
 
 #include <QStringList>
 
 namespace TextureDecoder
 {
     static const int DEFAULT_MAX_DECODES = 4;
+
+    //! Decode priority added per quality level below full quality, so that coarse levels go before the screen relevance is considered
+    static const f32 LEVEL_PRIORITY = 2.0f;
     
     TextureService::TextureService(Foundation::Framework* framework) : 
         framework_(framework),
@@ -35,8 +39,16 @@ namespace TextureDecoder
         if (max_decodes_per_frame_ <= 0) 
             max_decodes_per_frame_ = 1;
 
+        // Store fully decoded textures to the cache DXT compressed with mipmaps, so that they can be uploaded without conversion
+        compress_cache_ = framework_->GetDefaultConfig().DeclareSetting("TextureDecoder", "compress_cached_textures", true);
+
+        // Decode in the thread pool of the framework thread task manager, by default on as many threads as there are cores
+        int max_decode_threads = framework_->GetDefaultConfig().DeclareSetting("TextureDecoder", "max_decode_threads", 0);
+        if (max_decode_threads <= 0)
+            max_decode_threads = std::max(boost::thread::hardware_concurrency(), 1u);
+
         // Create decoder thread task and let the framework thread task manager handle it
-        OpenJpegDecoder* decoder = new OpenJpegDecoder();
+        OpenJpegDecoder* decoder = new OpenJpegDecoder(max_decode_threads);
         decoder->SetDecodesPerFrame(max_decodes_per_frame_);
 
         framework_->GetThreadTaskManager()->AddThreadTask(Foundation::ThreadTaskPtr(decoder));
@@ -46,7 +58,7 @@ namespace TextureDecoder
     {
     }
 
-    request_tag_t TextureService::RequestTexture(const std::string& asset_id)
+    request_tag_t TextureService::RequestTexture(const std::string& asset_id, bool allow_compressed)
     {
         request_tag_t tag = framework_->GetEventManager()->GetNextRequestTag();
     
@@ -60,7 +72,11 @@ namespace TextureDecoder
         if (cache_replys_.find(asset_id) != cache_replys_.end())
         {
             // Already requested and found from cache, just add request tag
-            cache_replys_.find(asset_id)->second.tags.push_back(tag);
+            CacheReply& reply = cache_replys_.find(asset_id)->second;
+            if (allow_compressed)
+                reply.tags.push_back(tag);
+            else
+                reply.raw_tags.push_back(tag);
             return tag;
         }
 
@@ -69,7 +85,10 @@ namespace TextureDecoder
         if (texture)
         {
             CacheReply reply;
-            reply.tags.push_back(tag);
+            if (allow_compressed)
+                reply.tags.push_back(tag);
+            else
+                reply.raw_tags.push_back(tag);
             reply.resource = Foundation::ResourcePtr(texture);
             cache_replys_[asset_id] = reply;
             return tag;
@@ -83,12 +102,57 @@ namespace TextureDecoder
         return tag;
     }
 
+    void TextureService::SetTexturePriority(const std::string& asset_id, f32 priority)
+    {
+        TextureRequestMap::iterator i = requests_.find(asset_id);
+        if (i == requests_.end())
+            return;
+
+        TextureRequest& request = i->second;
+        request.SetPriority(priority);
+
+        // The texture may still be waiting for its download
+        if (request.IsRequested())
+        {
+            boost::shared_ptr<Foundation::AssetServiceInterface> asset_service = framework_->GetServiceManager()->
+                GetService<Foundation::AssetServiceInterface>(Service::ST_Asset).lock();
+            if (asset_service)
+                asset_service->SetAssetPriority(asset_id, priority);
+        }
+
+        if (request.IsDecodeRequested())
+            framework_->GetThreadTaskManager()->SetRequestPriority("TextureDecoder", request.GetDecodeTag(), GetDecodePriority(request));
+    }
+
+    f32 TextureService::GetDecodePriority(const TextureRequest& request)
+    {
+        f32 relevance = request.GetPriority();
+        if (relevance < 0.0f)
+            relevance = 0.0f;
+        if (relevance > 1.0f)
+            relevance = 1.0f;
+        return request.GetNextLevel() * LEVEL_PRIORITY + relevance;
+    }
+
     TextureResource *TextureService::GetFromCache(const std::string &texture_id)
     {
-        if (cache_)
-            return cache_->GetTexture(texture_id);
-        else
+        if (!cache_)
             return 0;
+
+        TextureResource *texture = cache_->GetTexture(texture_id);
+        if (texture && IsCompressedFormat(texture->GetFormat()))
+        {
+            Foundation::ResourcePtr decompressed = DecompressTexture(*texture);
+            delete texture;
+            if (!decompressed)
+                return 0;
+            // The caller takes ownership of a raw pointer, so copy out of the shared one
+            TextureResource* source = checked_static_cast<TextureResource*>(decompressed.get());
+            texture = new TextureResource(texture_id, source->GetWidth(), source->GetHeight(), source->GetComponents());
+            texture->SetLevel(source->GetLevel());
+            memcpy(texture->GetData(), source->GetData(), source->GetDataSize());
+        }
+        return texture;
     }
 
     void TextureService::DeleteFromCache(const std::string &texture_id)
@@ -135,6 +199,22 @@ namespace TextureDecoder
                 Resource::Events::ResourceReady event_data(id, reply_data.resource, tags[j]);
                 event_manager->SendEvent(resource_event_category_, Resource::Events::RESOURCE_READY, &event_data);    
             }
+
+            // Requesters that can not use compressed data get a decompressed copy
+            if (!reply_data.raw_tags.empty())
+            {
+                Foundation::ResourcePtr raw_resource = reply_data.resource;
+                TextureResource* texture = checked_static_cast<TextureResource*>(raw_resource.get());
+                if (IsCompressedFormat(texture->GetFormat()))
+                    raw_resource = DecompressTexture(*texture);
+
+                const RequestTagVector& raw_tags = reply_data.raw_tags;
+                for (uint j = 0; raw_resource && j < raw_tags.size(); ++j)
+                {
+                    Resource::Events::ResourceReady event_data(id, raw_resource, raw_tags[j]);
+                    event_manager->SendEvent(resource_event_category_, Resource::Events::RESOURCE_READY, &event_data);
+                }
+            }
             cache_iter++;
         }
         foreach(QString sent, sent_replys)
@@ -159,6 +239,8 @@ namespace TextureDecoder
         if (!request.IsRequested())
         {
             asset_service->RequestAsset(request.GetId(), "Texture");
+            if (request.GetPriority() > 0.0f)
+                asset_service->SetAssetPriority(request.GetId(), request.GetPriority());
             request.SetRequested(true);
         }
 
@@ -181,9 +263,12 @@ namespace TextureDecoder
                 new_decode_request->id_ = request.GetId();
                 new_decode_request->level_ = request.GetNextLevel();
                 new_decode_request->source_ = asset;
-                framework_->GetThreadTaskManager()->AddRequest<DecodeRequest>("TextureDecoder", new_decode_request);
+                new_decode_request->priority_ = GetDecodePriority(request);
+                new_decode_request->cache_everything_ = cache_->CacheEverything();
+                new_decode_request->compress_for_cache_ = compress_cache_;
+                request_tag_t decode_tag = framework_->GetThreadTaskManager()->AddRequest<DecodeRequest>("TextureDecoder", new_decode_request);
                 
-                request.SetDecodeRequested(true);
+                request.SetDecodeRequested(true, decode_tag);
             }
         }
     }  
@@ -216,14 +301,9 @@ namespace TextureDecoder
                     event_manager->SendEvent(resource_event_category_, Resource::Events::RESOURCE_READY, &event_data);    
                 }
 
-                // Store to cache if decoding is complete
-                if (result->level_ == 0)
-                {
-                    if (cache_->CacheEverything())
-                        cache_->StoreTexture(texture);
-                    else if (result->is_jpeg2000_)
-                        cache_->StoreTexture(texture);
-                }
+                // Store to cache if decoding is complete. The decode thread has prepared the version to store
+                if (result->cache_texture_)
+                    cache_->StoreTexture(checked_static_cast<TextureResource*>(result->cache_texture_.get()));
             }   
             
             // Remove request if final quality level was decoded
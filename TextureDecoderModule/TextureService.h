@@ -29,13 +29,20 @@ namespace TextureDecoder
 
         //! Queues a texture request
         /*! \param asset_id asset ID of texture
+            \param allow_compressed Whether a DXT compressed texture from the cache may be returned
             \return request tag, will be used in eventual RESOURCE_READY event
          */
-        virtual request_tag_t RequestTexture(const std::string& asset_id);
+        virtual request_tag_t RequestTexture(const std::string& asset_id, bool allow_compressed = false);
+
+        //! Sets the screen relevance of a texture request, reprioritizing a pending decode
+        /*! \param asset_id asset ID of texture
+            \param priority Approximate fraction of the screen the texture covers, from 0 to 1
+         */
+        virtual void SetTexturePriority(const std::string& asset_id, f32 priority);
 
         //! Gets a texture rousource from cache
         //! @param texture_id as std::string
-        //! @return valid ptr if found, 0 ptr if not
+        //! @return valid ptr if found, 0 ptr if not. Decompressed if stored compressed
         virtual TextureResource *GetFromCache(const std::string &texture_id);
 
         //! Removes a texture from the disk cache with the texture id
@@ -57,6 +64,9 @@ namespace TextureDecoder
          */
         void UpdateRequest(TextureRequest& request, Foundation::AssetServiceInterface* asset_service);
 
+        //! Returns the decode priority of the next quality level of a texture request
+        static f32 GetDecodePriority(const TextureRequest& request);
+
         typedef std::map<std::string, TextureRequest> TextureRequestMap;
 
         typedef std::map<std::string, CacheReply> CacheReplys;
@@ -77,6 +87,9 @@ namespace TextureDecoder
 
         //! Max decodes per frame
         int max_decodes_per_frame_;
+
+        //! Whether to store textures DXT compressed to the cache
+        bool compress_cache_;
     };
 }
 
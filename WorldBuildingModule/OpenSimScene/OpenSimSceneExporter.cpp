@@ -11,6 +11,7 @@
 
 #include "TextureServiceInterface.h"
 #include "TextureResource.h"
+#include "AssetServiceInterface.h"
 
 #include "OgreImage.h"
 
@@ -643,8 +644,7 @@ namespace WorldBuilding
                     old_ref = QString(material_ref_b);
                     
 
-                    QString cache_file = GetCacheFilename(old_ref, "MaterialScript");
-                    QString file_only = cache_file.split("/").last().toLower();
+                    QString file_only = GetExportFilename(old_ref, "MaterialScript");
                     file_only.replace(".materialscript", ".material");
 
 
@@ -659,7 +659,8 @@ namespace WorldBuilding
                     //    we have to replace the textures and move it to our scripts location
                     else
                     {
-                        if (QFile::exists(cache_file))
+                        QString cache_file = GetCacheFilename(old_ref, "MaterialScript");
+                        if (!cache_file.isEmpty() && QFile::exists(cache_file))
                         {
                             QString new_material_path = store_location_particles.absoluteFilePath(file_only);
                             if (QFile::copy(cache_file, new_material_path))
@@ -804,6 +805,16 @@ namespace WorldBuilding
     }
 
     QString SceneExporter::GetCacheFilename(const QString &asset_id, const QString &type)
+    {
+        // The disk cache stores assets in pack files, ask the asset service to write the asset to a file of its own
+        Foundation::AssetServiceInterface *asset_service = framework_->GetService<Foundation::AssetServiceInterface>();
+        if (!asset_service)
+            return QString();
+        QString cache_path = asset_service->GetAbsoluteAssetPath(asset_id.toStdString(), type.toStdString());
+        return QDir::fromNativeSeparators(cache_path);
+    }
+
+    QString SceneExporter::GetExportFilename(const QString &asset_id, const QString &type)
     {
         std::string temp = asset_id.toStdString();
         QCryptographicHash md5_engine(QCryptographicHash::Md5);
@@ -811,11 +822,6 @@ namespace WorldBuilding
         QString md5_hash(md5_engine.result().toHex());
         md5_engine.reset();
 
-        QString cache_path = framework_->GetPlatform()->GetApplicationDataDirectory().c_str();
-        cache_path.append("/assetcache/");
-        cache_path.append(md5_hash);
-        cache_path.append(".");
-        cache_path.append(type);
-        return cache_path;
+        return (md5_hash + "." + type).toLower();
     }
 }
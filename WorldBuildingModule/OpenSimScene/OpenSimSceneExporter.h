@@ -44,6 +44,7 @@ namespace WorldBuilding
         int ReplaceParticleMaterialRefs(const QDir store_location_particles, const QString &asset_base_url, const QString &particle_file_path);
         QString TryStoreTexture(const QString &original_ref, const QDir &store_location, const QString &base_url);
         QString GetCacheFilename(const QString &asset_id, const QString &type);
+        QString GetExportFilename(const QString &asset_id, const QString &type);
         void CleanLocalDir(QDir dir);
         void LogHeadline(const QString &bold, const QString &msg = QString());
         void Log(const QString &message);
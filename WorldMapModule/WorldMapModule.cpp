@@ -56,6 +56,8 @@ namespace WorldMap
     {
         frameworkEventCategory_ = framework_->GetEventManager()->QueryEventCategory("Framework");
         resource_event_category_ = framework_->GetEventManager()->QueryEventCategory("Resource");
+        framework_->GetEventManager()->SubscribeToEventCategory(this, frameworkEventCategory_);
+        framework_->GetEventManager()->SubscribeToEventCategory(this, resource_event_category_);
         
         Foundation::UiSettingsServiceInterface *ui_settings_service = framework_->GetService<Foundation::UiSettingsServiceInterface>();
         if (ui_settings_service)
@@ -90,6 +92,8 @@ namespace WorldMap
                 {
                     networkStateEventCategory_ = framework_->GetEventManager()->QueryEventCategory("NetworkState");
                     networkInEventCategory_ = framework_->GetEventManager()->QueryEventCategory("NetworkIn");
+                    framework_->GetEventManager()->SubscribeToEventCategory(this, networkStateEventCategory_);
+                    framework_->GetEventManager()->SubscribeToEventCategory(this, networkInEventCategory_);
                     return false;
                 }
             }